@@ -41,6 +41,22 @@
  */
 #define OPENSSH_V1_UNENCRYPTED_KEY "AAAABG5vbmUAAAAEbm9uZQAAAAAAAAAB"
 
+/**
+ * The number of host key verifications remembered by the process-local
+ * verified-host cache. Processes rarely connect to more than one or two
+ * distinct hosts (an SSH session plus its accompanying SFTP session being the
+ * common case), so the cache can be small.
+ */
+#define GUAC_COMMON_SSH_VERIFIED_HOST_CACHE_SIZE 4
+
+/**
+ * The maximum age of an entry within the process-local verified-host cache,
+ * in milliseconds. Entries older than this are ignored, such that changes
+ * made to the system-wide known_hosts file are eventually picked up even by
+ * long-lived processes.
+ */
+#define GUAC_COMMON_SSH_VERIFIED_HOST_CACHE_TTL 300000
+
 /**
  * Abstraction of a key used for SSH authentication.
  */
@@ -38,6 +38,45 @@
  */
 #define GUAC_COMMON_SSH_SFTP_MAX_DEPTH 1024
 
+/**
+ * The number of bytes to read from a file and send per "blob" instruction
+ * during an SFTP download.
+ */
+#define GUAC_COMMON_SSH_SFTP_BLOB_SIZE 4096
+
+/**
+ * The maximum number of blobs that may be awaiting acknowledgement at any
+ * given time during an SFTP download. The window of unacknowledged blobs
+ * grows toward this limit as acknowledgements are received, keeping the
+ * transfer pipelined rather than bounded by one blob per round trip.
+ */
+#define GUAC_COMMON_SSH_SFTP_MAX_WINDOW 16
+
+/**
+ * The maximum directory nesting depth of a recursive directory download.
+ * Directories nested more deeply than this limit are skipped (and logged)
+ * rather than downloaded.
+ */
+#define GUAC_COMMON_SSH_SFTP_MAX_WALK_DEPTH 8
+
+/**
+ * The maximum number of file streams that may be in flight at any given time
+ * during a recursive directory download. Keeping several small files in
+ * flight at once overlaps the per-stream setup and acknowledgement latency
+ * which would otherwise dominate transfers of large trees of small files.
+ */
+#define GUAC_COMMON_SSH_SFTP_MAX_CONCURRENT_DOWNLOADS 4
+
+/**
+ * The number of bytes of received upload data that may be buffered before
+ * being written to the SFTP server. Writing in large chunks allows libssh2 to
+ * pipeline multiple SFTP write packets per call rather than paying a full
+ * round trip per received blob, and acknowledging each blob before its data
+ * has actually been written keeps receipt of further blobs overlapped with
+ * the writes themselves.
+ */
+#define GUAC_COMMON_SSH_SFTP_WRITE_BUFFER_SIZE 32768
+
 /**
  * Representation of an SFTP-driven filesystem object. Unlike guac_object, this
  * structure is not tied to any particular user.
@@ -82,6 +121,92 @@ typedef struct guac_common_ssh_sftp_filesystem {
 
 } guac_common_ssh_sftp_filesystem;
 
+/**
+ * The current state of a recursive directory download. The directory tree is
+ * walked depth-first, with each regular file pushed to the user as its own
+ * stream and up to GUAC_COMMON_SSH_SFTP_MAX_CONCURRENT_DOWNLOADS such streams
+ * in flight at any given time. This structure is opaque outside of the SFTP
+ * implementation.
+ */
+typedef struct guac_common_ssh_sftp_recursive_download_state
+        guac_common_ssh_sftp_recursive_download_state;
+
+/**
+ * The current state of an SFTP download (an outbound file transfer from the
+ * SFTP server to the Guacamole user).
+ */
+typedef struct guac_common_ssh_sftp_download_state {
+
+    /**
+     * Reference to the file currently being downloaded over SFTP. This file
+     * must already be open from a call to libssh2_sftp_open().
+     */
+    LIBSSH2_SFTP_HANDLE* file;
+
+    /**
+     * The number of blobs that have been sent to the user but not yet
+     * acknowledged.
+     */
+    int outstanding;
+
+    /**
+     * The maximum number of unacknowledged blobs that may currently be
+     * outstanding. This window starts at one blob and grows with each
+     * received acknowledgement, up to GUAC_COMMON_SSH_SFTP_MAX_WINDOW.
+     */
+    int window;
+
+    /**
+     * Whether the download has finished reading from the file, whether due
+     * to end-of-file or a read error. Once set, no further blobs will be
+     * sent, and the stream will be ended once all outstanding blobs have
+     * been acknowledged.
+     */
+    int complete;
+
+    /**
+     * The recursive directory download that this download is part of, or NULL
+     * if this is a standalone file download. If non-NULL, completion of this
+     * download continues the walk of the directory tree.
+     */
+    guac_common_ssh_sftp_recursive_download_state* recursive;
+
+} guac_common_ssh_sftp_download_state;
+
+/**
+ * The current state of an SFTP upload (an inbound file transfer from the
+ * Guacamole user to the SFTP server).
+ */
+typedef struct guac_common_ssh_sftp_upload_state {
+
+    /**
+     * Reference to the file currently being uploaded over SFTP. This file
+     * must already be open from a call to libssh2_sftp_open().
+     */
+    LIBSSH2_SFTP_HANDLE* file;
+
+    /**
+     * Buffer of received upload data that has been acknowledged but not yet
+     * written to the SFTP server. Buffered data is written out once the
+     * buffer cannot accommodate further blobs and when the upload ends.
+     */
+    char buffer[GUAC_COMMON_SSH_SFTP_WRITE_BUFFER_SIZE];
+
+    /**
+     * The number of bytes currently stored within buffer.
+     */
+    int length;
+
+    /**
+     * Whether a write to the SFTP server has failed. As blobs are
+     * acknowledged before their data is written, write errors surface on a
+     * later blob or when the upload ends. Once set, all received data is
+     * discarded and further blobs are refused.
+     */
+    int failed;
+
+} guac_common_ssh_sftp_upload_state;
+
 /**
  * The current state of a directory listing operation.
  */
@@ -207,7 +332,9 @@ void* guac_common_ssh_expose_sftp_filesystem(guac_user* user, void* data);
  * Initiates an SFTP file download to the user via the Guacamole "file"
  * instruction. The download will be automatically monitored and continued
  * after this function terminates in response to "ack" instructions received by
- * the user.
+ * the user. If the given path refers to a directory rather than a regular
+ * file, the directory tree is instead walked recursively, with each regular
+ * file within the tree downloaded as its own stream.
  *
  * @param filesystem
  *     The filesystem containing the file to be downloaded.
@@ -220,7 +347,9 @@ void* guac_common_ssh_expose_sftp_filesystem(guac_user* user, void* data);
  *
  * @return
  *     The file stream created for the file download, already configured to
- *     properly handle "ack" responses, etc. from the user.
+ *     properly handle "ack" responses, etc. from the user, or NULL if the
+ *     requested path is a directory (whose contents are downloaded as
+ *     multiple independent streams) or if the download could not be started.
  */
 guac_stream* guac_common_ssh_sftp_download_file(
         guac_common_ssh_sftp_filesystem* filesystem, guac_user* user,
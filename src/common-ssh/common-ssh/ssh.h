@@ -103,6 +103,14 @@ void guac_common_ssh_uninit();
  * not be destroyed until this session is destroyed, assuming the session is
  * successfully created.
  *
+ * Each session returned by this function is backed by its own TCP connection
+ * and SSH transport. Sessions are NOT shared between connections (guacd runs
+ * each connection in its own process), nor may a single session be used
+ * concurrently from multiple threads, as libssh2 sessions are not
+ * thread-safe. Callers needing SSH functionality on an independent thread
+ * (such as SFTP alongside an interactive terminal) must create a separate
+ * session.
+ *
  * @param client
  *     The Guacamole client that will be using SSH.
  *
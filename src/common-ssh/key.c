@@ -24,6 +24,7 @@
 
 #include <guacamole/mem.h>
 #include <guacamole/string.h>
+#include <guacamole/timestamp.h>
 
 #include <openssl/bio.h>
 #include <openssl/bn.h>
@@ -34,6 +35,7 @@
 #include <openssl/pem.h>
 #include <openssl/rsa.h>
 
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
@@ -170,10 +172,203 @@ void guac_common_ssh_key_free(guac_common_ssh_key* key) {
     guac_mem_free(key);
 }
 
+/**
+ * A host key verification that has already succeeded within this process,
+ * remembered such that further sessions to the same host (such as the SFTP
+ * session accompanying an SSH session) need not re-parse the known_hosts
+ * data and re-check the key.
+ */
+typedef struct guac_common_ssh_verified_host {
+
+    /**
+     * The time that verification succeeded, or zero if this entry is unused.
+     */
+    guac_timestamp verified;
+
+    /**
+     * The hostname or IP that was verified.
+     */
+    char* hostname;
+
+    /**
+     * The port of the server that was verified.
+     */
+    int port;
+
+    /**
+     * The known host entry that was provided by the client at the time of
+     * verification, or an empty string if verification was performed against
+     * the system-wide known_hosts file.
+     */
+    char* host_key;
+
+    /**
+     * The raw host key that the remote server presented and that matched the
+     * known_hosts data.
+     */
+    char* remote_hostkey;
+
+    /**
+     * The length of remote_hostkey, in bytes.
+     */
+    size_t remote_hostkey_len;
+
+} guac_common_ssh_verified_host;
+
+/**
+ * Process-local cache of host key verifications that have already succeeded.
+ * Access to this cache must be synchronized using
+ * guac_common_ssh_verified_hosts_lock.
+ */
+static guac_common_ssh_verified_host
+    guac_common_ssh_verified_hosts[GUAC_COMMON_SSH_VERIFIED_HOST_CACHE_SIZE] = { { 0 } };
+
+/**
+ * The index of the cache entry that will be replaced by the next verification
+ * to be remembered once all entries are in use.
+ */
+static int guac_common_ssh_verified_hosts_next = 0;
+
+/**
+ * Lock which synchronizes access to the process-local cache of host key
+ * verifications.
+ */
+static pthread_mutex_t guac_common_ssh_verified_hosts_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Tests whether a verification of the given host and raw host key, using the
+ * same known_hosts data, has already succeeded within this process recently
+ * enough that the result may be reused.
+ *
+ * @param host_key
+ *     The known host entry provided by the client, or NULL or an empty
+ *     string if verification is performed against the system-wide
+ *     known_hosts file.
+ *
+ * @param hostname
+ *     The hostname or IP of the server being verified.
+ *
+ * @param port
+ *     The port number of the server being verified.
+ *
+ * @param remote_hostkey
+ *     The raw host key presented by the remote server.
+ *
+ * @param remote_hostkey_len
+ *     The length of the presented host key, in bytes.
+ *
+ * @return
+ *     Non-zero if an identical verification already succeeded within this
+ *     process and has not yet expired, zero otherwise.
+ */
+static int guac_common_ssh_verified_host_check(const char* host_key,
+        const char* hostname, int port, const char* remote_hostkey,
+        const size_t remote_hostkey_len) {
+
+    if (host_key == NULL)
+        host_key = "";
+
+    int found = 0;
+    guac_timestamp now = guac_timestamp_current();
+
+    pthread_mutex_lock(&guac_common_ssh_verified_hosts_lock);
+
+    for (int i = 0; i < GUAC_COMMON_SSH_VERIFIED_HOST_CACHE_SIZE; i++) {
+
+        guac_common_ssh_verified_host* entry = &guac_common_ssh_verified_hosts[i];
+        if (entry->verified == 0
+                || now - entry->verified > GUAC_COMMON_SSH_VERIFIED_HOST_CACHE_TTL)
+            continue;
+
+        if (entry->port == port
+                && strcmp(entry->hostname, hostname) == 0
+                && strcmp(entry->host_key, host_key) == 0
+                && entry->remote_hostkey_len == remote_hostkey_len
+                && memcmp(entry->remote_hostkey, remote_hostkey, remote_hostkey_len) == 0) {
+            found = 1;
+            break;
+        }
+
+    }
+
+    pthread_mutex_unlock(&guac_common_ssh_verified_hosts_lock);
+    return found;
+
+}
+
+/**
+ * Remembers that verification of the given host and raw host key succeeded,
+ * such that further sessions to the same host within this process may skip
+ * re-parsing the known_hosts data. If the cache is full, the oldest-stored
+ * entry is replaced.
+ *
+ * @param host_key
+ *     The known host entry provided by the client, or NULL or an empty
+ *     string if verification was performed against the system-wide
+ *     known_hosts file.
+ *
+ * @param hostname
+ *     The hostname or IP of the server that was verified.
+ *
+ * @param port
+ *     The port number of the server that was verified.
+ *
+ * @param remote_hostkey
+ *     The raw host key presented by the remote server.
+ *
+ * @param remote_hostkey_len
+ *     The length of the presented host key, in bytes.
+ */
+static void guac_common_ssh_verified_host_store(const char* host_key,
+        const char* hostname, int port, const char* remote_hostkey,
+        const size_t remote_hostkey_len) {
+
+    if (host_key == NULL)
+        host_key = "";
+
+    pthread_mutex_lock(&guac_common_ssh_verified_hosts_lock);
+
+    guac_common_ssh_verified_host* entry =
+        &guac_common_ssh_verified_hosts[guac_common_ssh_verified_hosts_next];
+
+    guac_common_ssh_verified_hosts_next =
+        (guac_common_ssh_verified_hosts_next + 1)
+            % GUAC_COMMON_SSH_VERIFIED_HOST_CACHE_SIZE;
+
+    /* Release any data from a previously-stored verification */
+    guac_mem_free(entry->hostname);
+    guac_mem_free(entry->host_key);
+    guac_mem_free(entry->remote_hostkey);
+
+    entry->hostname = guac_strdup(hostname);
+    entry->port = port;
+    entry->host_key = guac_strdup(host_key);
+
+    entry->remote_hostkey = guac_mem_alloc(remote_hostkey_len);
+    memcpy(entry->remote_hostkey, remote_hostkey, remote_hostkey_len);
+    entry->remote_hostkey_len = remote_hostkey_len;
+
+    entry->verified = guac_timestamp_current();
+
+    pthread_mutex_unlock(&guac_common_ssh_verified_hosts_lock);
+
+}
+
 int guac_common_ssh_verify_host_key(LIBSSH2_SESSION* session, guac_client* client,
         const char* host_key, const char* hostname, int port, const char* remote_hostkey,
         const size_t remote_hostkey_len) {
 
+    /* Skip re-parsing the known_hosts data entirely if an identical
+     * verification has already succeeded within this process (further
+     * sessions to the same host, such as the SFTP session accompanying an
+     * SSH session, would otherwise each pay that cost) */
+    if (guac_common_ssh_verified_host_check(host_key, hostname, port,
+                remote_hostkey, remote_hostkey_len)) {
+        guac_client_log(client, GUAC_LOG_DEBUG,
+            "Host key for %s was already verified within this process", hostname);
+        return 0;
+    }
+
     LIBSSH2_KNOWNHOSTS* ssh_known_hosts = libssh2_knownhost_init(session);
     int known_hosts = 0;
 
@@ -231,6 +426,11 @@ int guac_common_ssh_verify_host_key(LIBSSH2_SESSION* session, guac_client* clien
         case LIBSSH2_KNOWNHOST_CHECK_MATCH:
             guac_client_log(client, GUAC_LOG_DEBUG,
                 "Host key match found for %s", hostname);
+
+            /* Remember the successful verification such that further
+             * sessions to the same host need not repeat it */
+            guac_common_ssh_verified_host_store(host_key, hostname, port,
+                    remote_hostkey, remote_hostkey_len);
             break;
         case LIBSSH2_KNOWNHOST_CHECK_NOTFOUND:
             guac_client_log(client, GUAC_LOG_ERROR,
@@ -284,11 +284,105 @@ static int guac_ssh_append_path(char* fullpath, const char* path_a,
 
 }
 
+/**
+ * Allocates and initializes the state of a new SFTP upload to the given open
+ * file. If no file is given (the file could not be opened), NULL is returned.
+ *
+ * @param file
+ *     The file to which the upload will write, already open from a call to
+ *     libssh2_sftp_open(), or NULL if the file could not be opened.
+ *
+ * @return
+ *     A newly-allocated upload state, or NULL if no file was given.
+ */
+static guac_common_ssh_sftp_upload_state* guac_common_ssh_sftp_upload_alloc(
+        LIBSSH2_SFTP_HANDLE* file) {
+
+    if (file == NULL)
+        return NULL;
+
+    guac_common_ssh_sftp_upload_state* upload =
+        guac_mem_zalloc(sizeof(guac_common_ssh_sftp_upload_state));
+
+    upload->file = file;
+    return upload;
+
+}
+
+/**
+ * Writes the given data to the file of the given upload state in full. If any
+ * write fails, the failed flag of the upload state is set and the remaining
+ * data is discarded.
+ *
+ * @param user
+ *     The user performing the upload, for logging purposes.
+ *
+ * @param upload
+ *     The state of the upload being written to.
+ *
+ * @param buffer
+ *     The data to write.
+ *
+ * @param length
+ *     The number of bytes to write.
+ */
+static void guac_common_ssh_sftp_write_all(guac_user* user,
+        guac_common_ssh_sftp_upload_state* upload, const char* buffer,
+        int length) {
+
+    int remaining = length;
+
+    /* Write until all data has been consumed (libssh2 may consume only part
+     * of the buffer per call) */
+    while (remaining > 0) {
+
+        ssize_t written = libssh2_sftp_write(upload->file, buffer, remaining);
+        if (written < 0) {
+            guac_user_log(user, GUAC_LOG_INFO, "Unable to write to file");
+            upload->failed = 1;
+            break;
+        }
+
+        buffer += written;
+        remaining -= written;
+
+    }
+
+    guac_user_log(user, GUAC_LOG_DEBUG, "%i bytes written",
+            length - remaining);
+
+}
+
+/**
+ * Writes all data buffered within the given upload state to the SFTP server,
+ * emptying the buffer. If any write fails, the failed flag of the upload
+ * state is set and all buffered data is discarded.
+ *
+ * @param user
+ *     The user performing the upload, for logging purposes.
+ *
+ * @param upload
+ *     The state of the upload whose buffered data should be written.
+ */
+static void guac_common_ssh_sftp_flush_upload(guac_user* user,
+        guac_common_ssh_sftp_upload_state* upload) {
+
+    if (upload->length > 0 && !upload->failed)
+        guac_common_ssh_sftp_write_all(user, upload, upload->buffer,
+                upload->length);
+
+    upload->length = 0;
+
+}
+
 /**
  * Handler for blob messages which continue an inbound SFTP data transfer
  * (upload). The data associated with the given stream is expected to be a
- * pointer to an open LIBSSH2_SFTP_HANDLE for the file to which the data
- * should be written.
+ * pointer to a guac_common_ssh_sftp_upload_state describing the upload in
+ * progress. Received data is acknowledged immediately and buffered, being
+ * written to the SFTP server in larger aggregated writes once the buffer
+ * fills; write errors therefore surface on a later blob or when the upload
+ * ends.
  *
  * @param user
  *     The user receiving the blob message.
@@ -308,23 +402,38 @@ static int guac_ssh_append_path(char* fullpath, const char* path_a,
 static int guac_common_ssh_sftp_blob_handler(guac_user* user,
         guac_stream* stream, void* data, int length) {
 
-    /* Pull file from stream */
-    LIBSSH2_SFTP_HANDLE* file = (LIBSSH2_SFTP_HANDLE*) stream->data;
+    /* Pull upload state from stream */
+    guac_common_ssh_sftp_upload_state* upload =
+        (guac_common_ssh_sftp_upload_state*) stream->data;
 
-    /* Attempt write */
-    if (libssh2_sftp_write(file, data, length) == length) {
-        guac_user_log(user, GUAC_LOG_DEBUG, "%i bytes written", length);
-        guac_protocol_send_ack(user->socket, stream, "SFTP: OK",
-                GUAC_PROTOCOL_STATUS_SUCCESS);
-        guac_socket_flush(user->socket);
-    }
-
-    /* Inform of any errors */
-    else {
-        guac_user_log(user, GUAC_LOG_INFO, "Unable to write to file");
+    /* Refuse further data if a deferred write has since failed */
+    if (upload == NULL || upload->failed) {
         guac_protocol_send_ack(user->socket, stream, "SFTP: Write failed",
                 GUAC_PROTOCOL_STATUS_SERVER_ERROR);
         guac_socket_flush(user->socket);
+        return 0;
+    }
+
+    /* Acknowledge receipt before actually writing, such that the next blob
+     * is already in transit while buffered data is written out */
+    guac_protocol_send_ack(user->socket, stream, "SFTP: OK",
+            GUAC_PROTOCOL_STATUS_SUCCESS);
+    guac_socket_flush(user->socket);
+
+    /* Flush early if the received data cannot fit within the buffer */
+    if (upload->length + length > sizeof(upload->buffer))
+        guac_common_ssh_sftp_flush_upload(user, upload);
+
+    /* Write blobs that cannot fit within the buffer at all directly */
+    if (length > sizeof(upload->buffer)) {
+        if (!upload->failed)
+            guac_common_ssh_sftp_write_all(user, upload, data, length);
+    }
+
+    /* Otherwise, aggregate received data into larger SFTP writes */
+    else if (!upload->failed) {
+        memcpy(upload->buffer + upload->length, data, length);
+        upload->length += length;
     }
 
     return 0;
@@ -334,8 +443,9 @@ static int guac_common_ssh_sftp_blob_handler(guac_user* user,
 /**
  * Handler for end messages which terminate an inbound SFTP data transfer
  * (upload). The data associated with the given stream is expected to be a
- * pointer to an open LIBSSH2_SFTP_HANDLE for the file to which the data
- * has been written and which should now be closed.
+ * pointer to a guac_common_ssh_sftp_upload_state describing the upload, whose
+ * remaining buffered data should now be written and whose file should now be
+ * closed.
  *
  * @param user
  *     The user receiving the end message.
@@ -349,11 +459,19 @@ static int guac_common_ssh_sftp_blob_handler(guac_user* user,
 static int guac_common_ssh_sftp_end_handler(guac_user* user,
         guac_stream* stream) {
 
-    /* Pull file from stream */
-    LIBSSH2_SFTP_HANDLE* file = (LIBSSH2_SFTP_HANDLE*) stream->data;
+    /* Pull upload state from stream */
+    guac_common_ssh_sftp_upload_state* upload =
+        (guac_common_ssh_sftp_upload_state*) stream->data;
+
+    if (upload == NULL)
+        return 0;
+
+    /* Write any data that remains buffered */
+    guac_common_ssh_sftp_flush_upload(user, upload);
 
-    /* Attempt to close file */
-    if (libssh2_sftp_close(file) == 0) {
+    /* Attempt to close file, reporting any deferred write failure in
+     * preference to the result of the close itself */
+    if (libssh2_sftp_close(upload->file) == 0 && !upload->failed) {
         guac_user_log(user, GUAC_LOG_DEBUG, "File closed");
         guac_protocol_send_ack(user->socket, stream, "SFTP: OK",
                 GUAC_PROTOCOL_STATUS_SUCCESS);
@@ -366,6 +484,9 @@ static int guac_common_ssh_sftp_end_handler(guac_user* user,
         guac_socket_flush(user->socket);
     }
 
+    guac_mem_free(upload);
+    stream->data = NULL;
+
     return 0;
 
 }
@@ -434,17 +555,166 @@ int guac_common_ssh_sftp_handle_file_stream(
     stream->blob_handler = guac_common_ssh_sftp_blob_handler;
     stream->end_handler = guac_common_ssh_sftp_end_handler;
 
-    /* Store file within stream */
-    stream->data = file;
+    /* Store upload state within stream */
+    stream->data = guac_common_ssh_sftp_upload_alloc(file);
     return 0;
 
 }
 
+/**
+ * The current state of a recursive directory download. The directory tree is
+ * walked depth-first, with each regular file pushed to the user as its own
+ * stream. Completion of each file stream continues the walk, such that at
+ * most GUAC_COMMON_SSH_SFTP_MAX_CONCURRENT_DOWNLOADS file streams are in
+ * flight at any given time.
+ */
+struct guac_common_ssh_sftp_recursive_download_state {
+
+    /**
+     * The filesystem whose directory tree is being downloaded.
+     */
+    guac_common_ssh_sftp_filesystem* filesystem;
+
+    /**
+     * The stack of directories currently being walked, from the root of the
+     * requested tree to the directory whose entries are currently being
+     * read.
+     */
+    struct {
+
+        /**
+         * The open handle of this directory.
+         */
+        LIBSSH2_SFTP_HANDLE* directory;
+
+        /**
+         * The absolute path of this directory.
+         */
+        char path[GUAC_COMMON_SSH_SFTP_MAX_PATH];
+
+    } stack[GUAC_COMMON_SSH_SFTP_MAX_WALK_DEPTH];
+
+    /**
+     * The number of directories currently on the stack. Once this reaches
+     * zero, the walk is complete.
+     */
+    int depth;
+
+    /**
+     * The number of file streams currently in flight.
+     */
+    int active;
+
+};
+
+/**
+ * Continues the walk of the directory tree associated with the given
+ * recursive directory download, starting further file streams until the
+ * concurrency limit is reached or the walk completes. Once the walk has
+ * completed and all file streams have finished, the download state is freed.
+ *
+ * @param user
+ *     The user receiving the downloaded directory tree.
+ *
+ * @param recursive
+ *     The state of the recursive directory download to continue.
+ */
+static void guac_common_ssh_sftp_advance_recursive_download(guac_user* user,
+        guac_common_ssh_sftp_recursive_download_state* recursive);
+
+/**
+ * Reads from the file associated with the given SFTP download and sends blobs
+ * to the user until the window of unacknowledged blobs is full, the file has
+ * been fully read, or a read error occurs. Once the file has been fully read
+ * (or a read error has occurred) and all sent blobs have been acknowledged,
+ * the stream is ended and the file and download state are freed.
+ *
+ * @param user
+ *     The user receiving the downloaded file.
+ *
+ * @param stream
+ *     The Guacamole protocol stream along which the file is being sent. The
+ *     data associated with this stream must be a pointer to a
+ *     guac_common_ssh_sftp_download_state.
+ */
+static void guac_common_ssh_sftp_fill_download_window(guac_user* user,
+        guac_stream* stream) {
+
+    guac_common_ssh_sftp_download_state* download =
+        (guac_common_ssh_sftp_download_state*) stream->data;
+
+    /* Keep the window of unacknowledged blobs full */
+    while (!download->complete
+            && download->outstanding < download->window) {
+
+        /* Attempt read into buffer */
+        char buffer[GUAC_COMMON_SSH_SFTP_BLOB_SIZE];
+        int bytes_read = libssh2_sftp_read(download->file, buffer,
+                sizeof(buffer));
+
+        /* If bytes read, send as blob */
+        if (bytes_read > 0) {
+
+            guac_protocol_send_blob(user->socket, stream,
+                    buffer, bytes_read);
+
+            download->outstanding++;
+
+            guac_user_log(user, GUAC_LOG_DEBUG, "%i bytes sent to user",
+                    bytes_read);
+
+        }
+
+        /* If bytes could not be read, note EOF or error condition (the
+         * stream is ended only once all sent blobs have been acknowledged) */
+        else {
+
+            if (bytes_read == 0)
+                guac_user_log(user, GUAC_LOG_DEBUG, "File sent");
+            else
+                guac_user_log(user, GUAC_LOG_INFO, "Error reading file");
+
+            download->complete = 1;
+
+        }
+
+    }
+
+    /* End stream once all data has been read and acknowledged */
+    if (download->complete && download->outstanding == 0) {
+
+        guac_common_ssh_sftp_recursive_download_state* recursive =
+            download->recursive;
+
+        guac_protocol_send_end(user->socket, stream);
+        guac_user_free_stream(user, stream);
+
+        /* Close file */
+        if (libssh2_sftp_close(download->file) == 0)
+            guac_user_log(user, GUAC_LOG_DEBUG, "File closed");
+        else
+            guac_user_log(user, GUAC_LOG_INFO, "Unable to close file");
+
+        guac_mem_free(download);
+
+        /* Continue walking the directory tree, if any */
+        if (recursive != NULL) {
+            recursive->active--;
+            guac_common_ssh_sftp_advance_recursive_download(user, recursive);
+        }
+
+    }
+
+    guac_socket_flush(user->socket);
+
+}
+
 /**
  * Handler for ack messages which continue an outbound SFTP data transfer
  * (download), signaling the current status and requesting additional data.
- * The data associated with the given stream is expected to be a pointer to an
- * open LIBSSH2_SFTP_HANDLE for the file from which the data is to be read.
+ * The data associated with the given stream is expected to be a pointer to a
+ * guac_common_ssh_sftp_download_state describing the file from which the
+ * data is to be read.
  *
  * @param user
  *     The user receiving the ack message.
@@ -466,91 +736,103 @@ int guac_common_ssh_sftp_handle_file_stream(
 static int guac_common_ssh_sftp_ack_handler(guac_user* user,
         guac_stream* stream, char* message, guac_protocol_status status) {
 
-    /* Pull file from stream */
-    LIBSSH2_SFTP_HANDLE* file = (LIBSSH2_SFTP_HANDLE*) stream->data;
+    /* Pull download state from stream */
+    guac_common_ssh_sftp_download_state* download =
+        (guac_common_ssh_sftp_download_state*) stream->data;
 
-    /* If successful, read data */
+    /* If successful, read and send more data */
     if (status == GUAC_PROTOCOL_STATUS_SUCCESS) {
 
-        /* Attempt read into buffer */
-        char buffer[4096];
-        int bytes_read = libssh2_sftp_read(file, buffer, sizeof(buffer)); 
+        if (download->outstanding > 0)
+            download->outstanding--;
 
-        /* If bytes read, send as blob */
-        if (bytes_read > 0) {
-            guac_protocol_send_blob(user->socket, stream,
-                    buffer, bytes_read);
+        /* Widen the window of unacknowledged blobs with each received
+         * acknowledgement, up to the maximum */
+        if (download->window < GUAC_COMMON_SSH_SFTP_MAX_WINDOW)
+            download->window++;
 
-            guac_user_log(user, GUAC_LOG_DEBUG, "%i bytes sent to user",
-                    bytes_read);
+        guac_common_ssh_sftp_fill_download_window(user, stream);
 
-        }
+    }
 
-        /* If bytes could not be read, handle EOF or error condition */
-        else {
+    /* Otherwise, abort transfer and return stream to user */
+    else {
 
-            /* If EOF, send end */
-            if (bytes_read == 0) {
-                guac_user_log(user, GUAC_LOG_DEBUG, "File sent");
-                guac_protocol_send_end(user->socket, stream);
-                guac_user_free_stream(user, stream);
-            }
+        guac_common_ssh_sftp_recursive_download_state* recursive =
+            download->recursive;
 
-            /* Otherwise, fail stream */
-            else {
-                guac_user_log(user, GUAC_LOG_INFO, "Error reading file");
-                guac_protocol_send_end(user->socket, stream);
-                guac_user_free_stream(user, stream);
-            }
+        if (libssh2_sftp_close(download->file) != 0)
+            guac_user_log(user, GUAC_LOG_INFO, "Unable to close file");
 
-            /* Close file */
-            if (libssh2_sftp_close(file) == 0)
-                guac_user_log(user, GUAC_LOG_DEBUG, "File closed");
-            else
-                guac_user_log(user, GUAC_LOG_INFO, "Unable to close file");
+        guac_mem_free(download);
+        guac_user_free_stream(user, stream);
 
-        }
+        /* Abandon any in-progress directory walk (a user refusing one file
+         * stream will refuse the rest) */
+        if (recursive != NULL) {
 
-        guac_socket_flush(user->socket);
+            while (recursive->depth > 0)
+                libssh2_sftp_closedir(
+                        recursive->stack[--recursive->depth].directory);
 
-    }
+            recursive->active--;
+            if (recursive->active == 0)
+                guac_mem_free(recursive);
 
-    /* Otherwise, return stream to user */
-    else
-        guac_user_free_stream(user, stream);
+        }
+
+    }
 
     return 0;
 }
 
-guac_stream* guac_common_ssh_sftp_download_file(
+/**
+ * Begins a download of the given regular file to the user via the Guacamole
+ * "file" instruction, returning the stream allocated for the download. Unlike
+ * guac_common_ssh_sftp_download_file(), this function does not check whether
+ * downloads have been disabled (the caller must have already done so), nor
+ * does it handle directories.
+ *
+ * @param filesystem
+ *     The filesystem containing the file to be downloaded.
+ *
+ * @param user
+ *     The user that should receive the file (via a "file" instruction).
+ *
+ * @param filename
+ *     The filename of the file to download, relative to the given filesystem.
+ *
+ * @return
+ *     The file stream created for the file download, or NULL if the file
+ *     could not be opened.
+ */
+static guac_stream* guac_common_ssh_sftp_begin_download(
         guac_common_ssh_sftp_filesystem* filesystem, guac_user* user,
         char* filename) {
 
     guac_stream* stream;
     LIBSSH2_SFTP_HANDLE* file;
 
-    /* Ignore download if downloads have been disabled */
-    if (filesystem->disable_download) {
-        guac_user_log(user, GUAC_LOG_WARNING, "A download attempt has "
-                "been blocked due to downloads being disabled, however it "
-                "should have been blocked at a higher level. This is likely "
-                "a bug.");
-        return NULL;
-    }
-
     /* Attempt to open file for reading */
     file = libssh2_sftp_open(filesystem->sftp_session, filename,
             LIBSSH2_FXF_READ, 0);
     if (file == NULL) {
-        guac_user_log(user, GUAC_LOG_INFO, 
+        guac_user_log(user, GUAC_LOG_INFO,
                 "Unable to read file \"%s\"", filename);
         return NULL;
     }
 
+    /* Init download state */
+    guac_common_ssh_sftp_download_state* download =
+        guac_mem_zalloc(sizeof(guac_common_ssh_sftp_download_state));
+
+    download->file = file;
+    download->window = 1;
+
     /* Allocate stream */
     stream = guac_user_alloc_stream(user);
     stream->ack_handler = guac_common_ssh_sftp_ack_handler;
-    stream->data = file;
+    stream->data = download;
 
     /* Send stream start, strip name */
     filename = basename(filename);
@@ -563,6 +845,164 @@ guac_stream* guac_common_ssh_sftp_download_file(
 
 }
 
+static void guac_common_ssh_sftp_advance_recursive_download(guac_user* user,
+        guac_common_ssh_sftp_recursive_download_state* recursive) {
+
+    LIBSSH2_SFTP* sftp = recursive->filesystem->sftp_session;
+
+    /* Start further file streams until the concurrency limit is reached or
+     * the walk completes */
+    while (recursive->active < GUAC_COMMON_SSH_SFTP_MAX_CONCURRENT_DOWNLOADS
+            && recursive->depth > 0) {
+
+        char filename[GUAC_COMMON_SSH_SFTP_MAX_PATH];
+        char absolute_path[GUAC_COMMON_SSH_SFTP_MAX_PATH];
+        LIBSSH2_SFTP_ATTRIBUTES attributes;
+
+        /* Pop directories off the stack as their entries are exhausted */
+        if (libssh2_sftp_readdir(
+                    recursive->stack[recursive->depth - 1].directory,
+                    filename, sizeof(filename), &attributes) <= 0) {
+            libssh2_sftp_closedir(
+                    recursive->stack[--recursive->depth].directory);
+            continue;
+        }
+
+        /* Skip current and parent directory entries */
+        if (strcmp(filename, ".") == 0 || strcmp(filename, "..") == 0)
+            continue;
+
+        /* Skip symbolic links (following them could loop indefinitely) */
+        if (LIBSSH2_SFTP_S_ISLNK(attributes.permissions)) {
+            guac_user_log(user, GUAC_LOG_DEBUG,
+                    "Skipping symbolic link \"%s\"", filename);
+            continue;
+        }
+
+        /* Concatenate into absolute path - skip if invalid */
+        if (!guac_ssh_append_filename(absolute_path,
+                    recursive->stack[recursive->depth - 1].path, filename)) {
+
+            guac_user_log(user, GUAC_LOG_DEBUG,
+                    "Skipping filename \"%s\" - filename is invalid or "
+                    "resulting path is too long", filename);
+
+            continue;
+        }
+
+        /* Descend into directories, within the depth limit */
+        if (LIBSSH2_SFTP_S_ISDIR(attributes.permissions)) {
+
+            if (recursive->depth == GUAC_COMMON_SSH_SFTP_MAX_WALK_DEPTH) {
+                guac_user_log(user, GUAC_LOG_INFO, "Skipping directory "
+                        "\"%s\" - maximum directory depth reached",
+                        absolute_path);
+                continue;
+            }
+
+            LIBSSH2_SFTP_HANDLE* dir = libssh2_sftp_opendir(sftp,
+                    absolute_path);
+            if (dir == NULL) {
+                guac_user_log(user, GUAC_LOG_INFO,
+                        "Unable to read directory \"%s\"", absolute_path);
+                continue;
+            }
+
+            recursive->stack[recursive->depth].directory = dir;
+            guac_strlcpy(recursive->stack[recursive->depth].path,
+                    absolute_path, GUAC_COMMON_SSH_SFTP_MAX_PATH);
+            recursive->depth++;
+
+        }
+
+        /* Push regular files to the user as individual streams */
+        else if (LIBSSH2_SFTP_S_ISREG(attributes.permissions)) {
+
+            guac_stream* stream = guac_common_ssh_sftp_begin_download(
+                    recursive->filesystem, user, absolute_path);
+
+            if (stream != NULL) {
+                ((guac_common_ssh_sftp_download_state*) stream->data)
+                    ->recursive = recursive;
+                recursive->active++;
+            }
+
+        }
+
+    }
+
+    /* Clean up once the walk has completed and all streams have finished */
+    if (recursive->depth == 0 && recursive->active == 0) {
+        guac_user_log(user, GUAC_LOG_DEBUG, "Directory download complete");
+        guac_mem_free(recursive);
+    }
+
+}
+
+guac_stream* guac_common_ssh_sftp_download_file(
+        guac_common_ssh_sftp_filesystem* filesystem, guac_user* user,
+        char* filename) {
+
+    LIBSSH2_SFTP_ATTRIBUTES attributes;
+
+    /* Ignore download if downloads have been disabled */
+    if (filesystem->disable_download) {
+        guac_user_log(user, GUAC_LOG_WARNING, "A download attempt has "
+                "been blocked due to downloads being disabled, however it "
+                "should have been blocked at a higher level. This is likely "
+                "a bug.");
+        return NULL;
+    }
+
+    /* If the requested path is a directory, walk its tree recursively,
+     * downloading each regular file as its own stream (the Guacamole
+     * protocol has no representation for a directory as a single stream) */
+    if (libssh2_sftp_stat(filesystem->sftp_session, filename,
+                &attributes) == 0
+            && LIBSSH2_SFTP_S_ISDIR(attributes.permissions)) {
+
+        /* Open as directory */
+        LIBSSH2_SFTP_HANDLE* dir = libssh2_sftp_opendir(
+                filesystem->sftp_session, filename);
+        if (dir == NULL) {
+            guac_user_log(user, GUAC_LOG_INFO,
+                    "Unable to read directory \"%s\"", filename);
+            return NULL;
+        }
+
+        /* Init recursive download state with the requested directory as the
+         * root of the walk */
+        guac_common_ssh_sftp_recursive_download_state* recursive =
+            guac_mem_zalloc(
+                    sizeof(guac_common_ssh_sftp_recursive_download_state));
+
+        recursive->filesystem = filesystem;
+        recursive->stack[0].directory = dir;
+        recursive->depth = 1;
+
+        /* Bail out if directory name is too long to store */
+        if (guac_strlcpy(recursive->stack[0].path, filename,
+                    sizeof(recursive->stack[0].path))
+                >= sizeof(recursive->stack[0].path)) {
+            guac_user_log(user, GUAC_LOG_INFO, "Unable to read directory "
+                    "\"%s\": Path too long", filename);
+            libssh2_sftp_closedir(dir);
+            guac_mem_free(recursive);
+            return NULL;
+        }
+
+        guac_user_log(user, GUAC_LOG_DEBUG,
+                "Recursively downloading directory \"%s\"", filename);
+
+        guac_common_ssh_sftp_advance_recursive_download(user, recursive);
+        return NULL;
+
+    }
+
+    return guac_common_ssh_sftp_begin_download(filesystem, user, filename);
+
+}
+
 void guac_common_ssh_sftp_set_upload_path(
         guac_common_ssh_sftp_filesystem* filesystem, const char* path) {
 
@@ -825,10 +1265,17 @@ static int guac_common_ssh_sftp_get_handler(guac_user* user,
             return 0;
         }
 
+        /* Init download state */
+        guac_common_ssh_sftp_download_state* download =
+            guac_mem_zalloc(sizeof(guac_common_ssh_sftp_download_state));
+
+        download->file = file;
+        download->window = 1;
+
         /* Allocate stream for body */
         guac_stream* stream = guac_user_alloc_stream(user);
         stream->ack_handler = guac_common_ssh_sftp_ack_handler;
-        stream->data = file;
+        stream->data = download;
 
         /* Associate new stream with get request */
         guac_protocol_send_body(user->socket, object, stream,
@@ -917,8 +1364,8 @@ static int guac_common_ssh_sftp_put_handler(guac_user* user,
     stream->blob_handler = guac_common_ssh_sftp_blob_handler;
     stream->end_handler = guac_common_ssh_sftp_end_handler;
 
-    /* Store file within stream */
-    stream->data = file;
+    /* Store upload state within stream */
+    stream->data = guac_common_ssh_sftp_upload_alloc(file);
 
     guac_socket_flush(user->socket);
     return 0;
@@ -40,6 +40,11 @@ guac_common_clipboard* guac_common_clipboard_alloc() {
     clipboard->available = GUAC_COMMON_CLIPBOARD_MAX_LENGTH;
     clipboard->length = 0;
 
+    /* No clipboard data has yet been hashed or sent to any user */
+    clipboard->hash_valid = 0;
+    memset(clipboard->user_hashes, 0, sizeof(clipboard->user_hashes));
+    clipboard->next_user_hash = 0;
+
     pthread_mutex_init(&(clipboard->lock), NULL);
 
     return clipboard;
@@ -59,6 +64,67 @@ void guac_common_clipboard_free(guac_common_clipboard* clipboard) {
 
 }
 
+/**
+ * Computes a 64-bit FNV-1a hash of the current contents and mimetype of the
+ * given clipboard. The clipboard's lock must already be held.
+ *
+ * @param clipboard
+ *     The clipboard whose contents and mimetype should be hashed.
+ *
+ * @return
+ *     A 64-bit hash of the clipboard contents and mimetype.
+ */
+static uint64_t __hash_clipboard(guac_common_clipboard* clipboard) {
+
+    uint64_t hash = 0xCBF29CE484222325;
+    int i;
+
+    /* Include mimetype in hash, such that identical data re-announced with a
+     * different mimetype is still sent */
+    for (i = 0; clipboard->mimetype[i] != '\0'; i++) {
+        hash ^= (unsigned char) clipboard->mimetype[i];
+        hash *= 0x100000001B3;
+    }
+
+    /* Hash clipboard contents */
+    for (i = 0; i < clipboard->length; i++) {
+        hash ^= (unsigned char) clipboard->buffer[i];
+        hash *= 0x100000001B3;
+    }
+
+    return hash;
+
+}
+
+/**
+ * Returns the entry within the given clipboard's user_hashes array which
+ * tracks the given user, or NULL if the user is not yet tracked. The
+ * clipboard's lock must already be held.
+ *
+ * @param clipboard
+ *     The clipboard to search.
+ *
+ * @param user
+ *     The user whose entry should be located.
+ *
+ * @return
+ *     The entry tracking the given user, or NULL if no such entry exists.
+ */
+static guac_common_clipboard_user_hash* __get_user_hash(
+        guac_common_clipboard* clipboard, guac_user* user) {
+
+    int i;
+
+    for (i = 0; i < GUAC_COMMON_CLIPBOARD_MAX_TRACKED_USERS; i++) {
+        guac_common_clipboard_user_hash* entry = &(clipboard->user_hashes[i]);
+        if (strcmp(entry->user_id, user->user_id) == 0)
+            return entry;
+    }
+
+    return NULL;
+
+}
+
 /**
  * Callback for guac_client_foreach_user() which sends clipboard data to each
  * connected client.
@@ -80,6 +146,16 @@ static void* __send_user_clipboard(guac_user* user, void* data) {
     char* current = clipboard->buffer;
     int remaining = clipboard->length;
 
+    /* Skip users which have already received the current contents, such that
+     * applications which re-announce an unchanged clipboard (as some do
+     * several times per second) cost no traffic */
+    guac_common_clipboard_user_hash* entry = __get_user_hash(clipboard, user);
+    if (entry != NULL && entry->hash == clipboard->hash) {
+        guac_user_log(user, GUAC_LOG_DEBUG, "Not sending clipboard data: "
+                "contents are unchanged since last send.");
+        return NULL;
+    }
+
     /* Begin stream */
     guac_stream* stream = guac_user_alloc_stream(user);
     guac_protocol_send_clipboard(user->socket, stream, clipboard->mimetype);
@@ -117,6 +193,17 @@ static void* __send_user_clipboard(guac_user* user, void* data) {
     guac_socket_flush(user->socket);
     guac_user_free_stream(user, stream);
 
+    /* Record hash of contents just sent, claiming the next available entry
+     * if the user is not yet tracked */
+    if (entry == NULL) {
+        entry = &(clipboard->user_hashes[clipboard->next_user_hash]);
+        clipboard->next_user_hash = (clipboard->next_user_hash + 1)
+            % GUAC_COMMON_CLIPBOARD_MAX_TRACKED_USERS;
+        guac_strlcpy(entry->user_id, user->user_id, sizeof(entry->user_id));
+    }
+
+    entry->hash = clipboard->hash;
+
     return NULL;
 
 }
@@ -125,6 +212,13 @@ void guac_common_clipboard_send(guac_common_clipboard* clipboard, guac_client* c
 
     pthread_mutex_lock(&(clipboard->lock));
 
+    /* Update hash of current contents if the clipboard has changed since the
+     * last broadcast */
+    if (!clipboard->hash_valid) {
+        clipboard->hash = __hash_clipboard(clipboard);
+        clipboard->hash_valid = 1;
+    }
+
     guac_client_log(client, GUAC_LOG_DEBUG, "Broadcasting clipboard to all connected users.");
     guac_client_foreach_user(client, __send_user_clipboard, clipboard);
     guac_client_log(client, GUAC_LOG_DEBUG, "Broadcast of clipboard complete.");
@@ -140,6 +234,7 @@ void guac_common_clipboard_reset(guac_common_clipboard* clipboard,
 
     /* Clear clipboard contents */
     clipboard->length = 0;
+    clipboard->hash_valid = 0;
 
     /* Assign given mimetype */
     guac_strlcpy(clipboard->mimetype, mimetype, sizeof(clipboard->mimetype));
@@ -162,6 +257,7 @@ void guac_common_clipboard_append(guac_common_clipboard* clipboard, const char*
 
     /* Update length */
     clipboard->length += length;
+    clipboard->hash_valid = 0;
 
     pthread_mutex_unlock(&(clipboard->lock));
 
@@ -24,6 +24,7 @@
 
 #include <guacamole/client.h>
 #include <pthread.h>
+#include <stdint.h>
 
 /**
  * The maximum number of bytes to send in an individual blob when
@@ -31,11 +32,39 @@
  */
 #define GUAC_COMMON_CLIPBOARD_BLOCK_SIZE 4096
 
+/**
+ * The maximum number of users for which the hash of the most recently sent
+ * clipboard contents will be tracked.
+ */
+#define GUAC_COMMON_CLIPBOARD_MAX_TRACKED_USERS 64
+
 /**
  * The maximum number of bytes to allow within the clipboard.
  */
 #define GUAC_COMMON_CLIPBOARD_MAX_LENGTH 262144
 
+/**
+ * The hash of the clipboard contents most recently sent to a particular
+ * user, used to suppress rebroadcasts of unchanged clipboard data.
+ */
+typedef struct guac_common_clipboard_user_hash {
+
+    /**
+     * The unique ID of the user to which clipboard contents were sent, or an
+     * empty string if this entry is unused. As users may leave and their
+     * guac_user structures be freed (and possibly reused) at any time, users
+     * are tracked by ID rather than by pointer.
+     */
+    char user_id[64];
+
+    /**
+     * The hash of the clipboard contents (and mimetype) most recently sent
+     * to the user.
+     */
+    uint64_t hash;
+
+} guac_common_clipboard_user_hash;
+
 /**
  * Generic clipboard structure.
  */
@@ -68,6 +97,34 @@ typedef struct guac_common_clipboard {
      */
     int available;
 
+    /**
+     * The hash of the current clipboard contents and mimetype. This value is
+     * meaningful only if hash_valid is non-zero.
+     */
+    uint64_t hash;
+
+    /**
+     * Whether the hash member reflects the current clipboard contents. The
+     * hash is invalidated whenever the clipboard is reset or appended to,
+     * and recalculated only when the clipboard is next sent.
+     */
+    int hash_valid;
+
+    /**
+     * The hashes of the clipboard contents most recently sent to each user.
+     * Unused entries have an empty user ID. If more than
+     * GUAC_COMMON_CLIPBOARD_MAX_TRACKED_USERS users are connected, the
+     * least-recently-added entries are reused, which may merely result in
+     * redundant sends to the affected users.
+     */
+    guac_common_clipboard_user_hash user_hashes[GUAC_COMMON_CLIPBOARD_MAX_TRACKED_USERS];
+
+    /**
+     * The index of the next entry within user_hashes to use when a user
+     * without an existing entry receives clipboard data.
+     */
+    int next_user_hash;
+
 } guac_common_clipboard;
 
 /**
@@ -84,7 +141,12 @@ void guac_common_clipboard_free(guac_common_clipboard* clipboard);
 
 /**
  * Sends the contents of the clipboard along the given client, splitting
- * the contents as necessary.
+ * the contents as necessary. Users which have already received the current
+ * clipboard contents are skipped, such that applications which repeatedly
+ * re-announce identical clipboard data do not multiply the data sent by the
+ * number of connected users. Users which have not yet received any clipboard
+ * data, such as users which have only just joined, always receive the
+ * current contents.
  *
  * @param clipboard The clipboard whose contents should be sent.
  * @param client The client to send the clipboard contents on.
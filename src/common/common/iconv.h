@@ -56,6 +56,39 @@ typedef void guac_iconv_write(char** output, int remaining, int value);
 int guac_iconv(guac_iconv_read* reader, const char** input, int in_remaining,
                guac_iconv_write* writer, char** output, int out_remaining);
 
+/**
+ * The maximum number of bytes that any single character may occupy in the
+ * output of any guac_iconv_write implementation, including any additional
+ * characters introduced by newline normalization.
+ */
+#define GUAC_ICONV_MAX_CHARACTER_BYTES 8
+
+/**
+ * Converts characters within a given string from one encoding to another,
+ * exactly as guac_iconv(), except that conversion additionally stops before
+ * reading a character which may not fit within the space remaining in the
+ * output string. Unlike guac_iconv(), which may silently drop characters
+ * read near the end of the output string, conversion that has stopped for
+ * lack of output space may simply be resumed with a fresh output buffer, as
+ * the updated input string pointer is guaranteed to point to the character
+ * that would be converted next. This allows arbitrarily large strings to be
+ * converted in bounded chunks.
+ *
+ * @param reader The reader function to use when reading the input string.
+ * @param input Pointer to the beginning of the input string.
+ * @param in_remaining The number of bytes remaining after the pointer to the
+ *                     input string.
+ * @param writer The writer function to use when writing the output string.
+ * @param output Pointer to the beginning of the output string.
+ * @param out_remaining The number of bytes remaining after the pointer to the
+ *                      output string.
+ * @return Non-zero if the NULL terminator of the input string was read and
+ *         copied into the destination string, zero otherwise.
+ */
+int guac_iconv_partial(guac_iconv_read* reader, const char** input,
+        int in_remaining, guac_iconv_write* writer, char** output,
+        int out_remaining);
+
 /**
  * Read function for UTF8.
  */
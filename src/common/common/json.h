@@ -22,6 +22,7 @@
 
 #include "config.h"
 
+#include <guacamole/protocol-constants.h>
 #include <guacamole/stream.h>
 #include <guacamole/user.h>
 
@@ -34,9 +35,11 @@ typedef struct guac_common_json_state {
     /**
      * Buffer of partial JSON data. The individual blobs which make up the JSON
      * body of the object being sent over the Guacamole protocol will be
-     * built here.
+     * built here. The buffer is sized to exactly fill the largest blob that
+     * can be sent in a single instruction, as the consumers of this state
+     * (directory listings) are paced at one blob per received ack.
      */
-    char buffer[4096];
+    char buffer[GUAC_PROTOCOL_BLOB_MAX_LENGTH];
 
     /**
      * The number of bytes currently used within the JSON buffer.
@@ -60,11 +60,18 @@ typedef struct guac_common_list {
     guac_common_list_element* head;
 
     /**
-     * Mutex which is locked when exclusive access to the list is required.
-     * Possession of the lock is not enforced outside the
-     * guac_common_list_lock() function.
+     * Pool of elements which have been removed from the list and may be
+     * reused by future calls to guac_common_list_add() without allocation.
+     * Elements within this pool are chained through their next pointers.
      */
-    pthread_mutex_t _lock;
+    guac_common_list_element* _unused;
+
+    /**
+     * Lock which is acquired when access to the list is required. Possession
+     * of the lock is not enforced outside the guac_common_list_lock() and
+     * guac_common_list_lock_read() functions.
+     */
+    pthread_rwlock_t _lock;
 
 } guac_common_list;
 
@@ -119,16 +126,29 @@ void guac_common_list_remove(guac_common_list* list,
 /**
  * Acquires exclusive access to the list. No list functions implicitly lock or
  * unlock the list, so any list access which must be threadsafe must use
- * guac_common_list_lock() and guac_common_list_unlock() manually.
+ * guac_common_list_lock() and guac_common_list_unlock() manually. Exclusive
+ * access is required by any use of guac_common_list_add() or
+ * guac_common_list_remove().
  *
  * @param list The list to acquire exclusive access to.
  */
 void guac_common_list_lock(guac_common_list* list);
 
 /**
- * Releases exclusive access to the list.
+ * Acquires shared (read-only) access to the list. Multiple threads may hold
+ * shared access simultaneously, and no thread can hold exclusive access while
+ * any thread holds shared access. Shared access is sufficient for iterating
+ * the list and reading element data, but the list may not be modified while
+ * it is held.
+ *
+ * @param list The list to acquire shared access to.
+ */
+void guac_common_list_lock_read(guac_common_list* list);
+
+/**
+ * Releases access to the list, whether exclusive or shared.
  *
- * @param list The list to release from exclusive access.
+ * @param list The list to release access to.
  */
 void guac_common_list_unlock(guac_common_list* list);
 
@@ -79,6 +79,26 @@ typedef struct guac_common_surface_heat_cell {
      */
     int oldest_entry;
 
+    /**
+     * Non-zero if the cached PNG optimality counts below reflect the current
+     * contents of the area associated with this cell, zero if they must be
+     * recalculated before use. Any modification of pixels within the cell
+     * invalidates these counts.
+     */
+    int optimality_valid;
+
+    /**
+     * The number of sampled pixels within the area associated with this cell
+     * that were identical to the pixel immediately to their left.
+     */
+    unsigned int num_same;
+
+    /**
+     * The number of sampled pixels within the area associated with this cell
+     * that differed from the pixel immediately to their left.
+     */
+    unsigned int num_different;
+
 } guac_common_surface_heat_cell;
 
 /**
@@ -312,6 +332,31 @@ void guac_common_surface_resize(guac_common_surface* surface, int w, int h);
 void guac_common_surface_draw(guac_common_surface* surface, int x, int y,
         cairo_surface_t* src);
 
+/**
+ * Draws the given data to the server-side copy of the given
+ * guac_common_surface without producing any update for connected clients.
+ * This is intended for callers which have already conveyed the drawn content
+ * to all clients through some other means (such as a protocol instruction
+ * describing the content at a higher level), but which must keep the
+ * server-side copy of the surface consistent for the sake of future
+ * operations, such as sending a copy of the surface to users which join
+ * later. Compositing behaves identically to guac_common_surface_draw().
+ *
+ * @param surface
+ *     The surface to draw to.
+ *
+ * @param x
+ *     The X coordinate of the draw location.
+ *
+ * @param y
+ *     The Y coordinate of the draw location.
+ *
+ * @param src
+ *     The Cairo surface to retrieve data from.
+ */
+void guac_common_surface_draw_local(guac_common_surface* surface, int x, int y,
+        cairo_surface_t* src);
+
 /**
  * Paints to the given guac_common_surface using the given data as a stencil,
  * filling opaque regions with the specified color, and leaving transparent
@@ -61,6 +61,175 @@ const static int __GUAC_RDP_CP1252_CODEPOINT[32] = {
     0x0178, /* 0x9F */
 };
 
+/**
+ * Returns the fixed number of bytes consumed by the given reader for each
+ * character in the ASCII range, or zero if the reader is not recognized as
+ * having such a fixed width.
+ *
+ * @param reader
+ *     The reader to determine the ASCII character width of.
+ *
+ * @return
+ *     The number of bytes consumed by the given reader for each ASCII
+ *     character, or zero if the reader is not recognized.
+ */
+static int guac_iconv_read_unit(guac_iconv_read* reader) {
+
+    if (reader == GUAC_READ_UTF8       || reader == GUAC_READ_UTF8_NORMALIZED
+     || reader == GUAC_READ_CP1252     || reader == GUAC_READ_CP1252_NORMALIZED
+     || reader == GUAC_READ_ISO8859_1  || reader == GUAC_READ_ISO8859_1_NORMALIZED)
+        return 1;
+
+    if (reader == GUAC_READ_UTF16 || reader == GUAC_READ_UTF16_NORMALIZED)
+        return 2;
+
+    return 0;
+
+}
+
+/**
+ * Returns the fixed number of bytes produced by the given writer for each
+ * character in the ASCII range, or zero if the writer is not recognized as
+ * having such a fixed width.
+ *
+ * @param writer
+ *     The writer to determine the ASCII character width of.
+ *
+ * @return
+ *     The number of bytes produced by the given writer for each ASCII
+ *     character, or zero if the writer is not recognized.
+ */
+static int guac_iconv_write_unit(guac_iconv_write* writer) {
+
+    if (writer == GUAC_WRITE_UTF8       || writer == GUAC_WRITE_UTF8_CRLF
+     || writer == GUAC_WRITE_CP1252     || writer == GUAC_WRITE_CP1252_CRLF
+     || writer == GUAC_WRITE_ISO8859_1  || writer == GUAC_WRITE_ISO8859_1_CRLF)
+        return 1;
+
+    if (writer == GUAC_WRITE_UTF16 || writer == GUAC_WRITE_UTF16_CRLF)
+        return 2;
+
+    return 0;
+
+}
+
+/**
+ * Returns whether the given character value can be converted by the
+ * fixed-width bulk conversion loop. Only printable ASCII is converted in
+ * bulk: every supported encoding represents these characters identically (as
+ * a single byte, or as a single 16-bit unit for UTF-16), and none of them
+ * receive special treatment from newline normalization or CRLF expansion.
+ *
+ * @param value
+ *     The character value to test.
+ *
+ * @return
+ *     Non-zero if the character can be converted in bulk, zero otherwise.
+ */
+#define GUAC_ICONV_IS_BULK(value) ((value) >= 0x20 && (value) < 0x80)
+
+/**
+ * Converts the longest possible leading run of printable ASCII characters
+ * from the given input buffer to the given output buffer in bulk, advancing
+ * the input/output pointers and adjusting the remaining byte counts
+ * accordingly. Conversion stops at the first character outside the printable
+ * ASCII range (including any control character, newline, or null terminator),
+ * which is left for the caller's generic per-character loop to process.
+ *
+ * Processing runs in bulk avoids the two indirect function calls that the
+ * generic loop otherwise performs per character, and each fixed-width
+ * conversion loop below is simple enough for compilers to vectorize.
+ *
+ * @param reader
+ *     The reader which will be used to read any characters not converted by
+ *     this function.
+ *
+ * @param input
+ *     Pointer to the location within the input buffer that conversion should
+ *     begin.
+ *
+ * @param in_remaining
+ *     Pointer to the number of bytes remaining in the input buffer.
+ *
+ * @param writer
+ *     The writer which will be used to write any characters not converted by
+ *     this function.
+ *
+ * @param output
+ *     Pointer to the location within the output buffer that converted
+ *     characters should be written.
+ *
+ * @param out_remaining
+ *     Pointer to the number of bytes remaining in the output buffer.
+ */
+static void guac_iconv_bulk_ascii(guac_iconv_read* reader, const char** input,
+        int* in_remaining, guac_iconv_write* writer, char** output,
+        int* out_remaining) {
+
+    int in_unit = guac_iconv_read_unit(reader);
+    int out_unit = guac_iconv_write_unit(writer);
+
+    /* Leave all conversion to the generic loop if either side lacks a
+     * fixed-width representation of ASCII */
+    if (in_unit == 0 || out_unit == 0)
+        return;
+
+    /* Maximum number of characters that can be converted without exhausting
+     * either buffer */
+    int count = *in_remaining / in_unit;
+    if (count > *out_remaining / out_unit)
+        count = *out_remaining / out_unit;
+
+    int converted = 0;
+
+    /* Single byte to single byte (UTF-8, CP-1252, and ISO 8859-1 are all
+     * identical within the ASCII range) */
+    if (in_unit == 1 && out_unit == 1) {
+        const unsigned char* in = (const unsigned char*) *input;
+        unsigned char* out = (unsigned char*) *output;
+        while (converted < count && GUAC_ICONV_IS_BULK(in[converted])) {
+            out[converted] = in[converted];
+            converted++;
+        }
+    }
+
+    /* Single byte to UTF-16LE */
+    else if (in_unit == 1 && out_unit == 2) {
+        const unsigned char* in = (const unsigned char*) *input;
+        uint16_t* out = (uint16_t*) *output;
+        while (converted < count && GUAC_ICONV_IS_BULK(in[converted])) {
+            out[converted] = in[converted];
+            converted++;
+        }
+    }
+
+    /* UTF-16LE to single byte */
+    else if (in_unit == 2 && out_unit == 1) {
+        const uint16_t* in = (const uint16_t*) *input;
+        unsigned char* out = (unsigned char*) *output;
+        while (converted < count && GUAC_ICONV_IS_BULK(in[converted])) {
+            out[converted] = (unsigned char) in[converted];
+            converted++;
+        }
+    }
+
+    /* UTF-16LE to UTF-16LE */
+    else {
+        const uint16_t* in = (const uint16_t*) *input;
+        uint16_t* out = (uint16_t*) *output;
+        while (converted < count && GUAC_ICONV_IS_BULK(in[converted])) {
+            out[converted] = in[converted];
+            converted++;
+        }
+    }
+
+    *input += converted * in_unit;
+    *in_remaining -= converted * in_unit;
+    *output += converted * out_unit;
+    *out_remaining -= converted * out_unit;
+
+}
+
 int guac_iconv(guac_iconv_read* reader, const char** input, int in_remaining,
                guac_iconv_write* writer, char** output, int out_remaining) {
 
@@ -70,6 +239,57 @@ int guac_iconv(guac_iconv_read* reader, const char** input, int in_remaining,
         const char* read_start;
         char* write_start;
 
+        /* Convert any leading run of printable ASCII in bulk, leaving the
+         * next character (if any) for the generic loop below */
+        guac_iconv_bulk_ascii(reader, input, &in_remaining,
+                writer, output, &out_remaining);
+
+        if (in_remaining <= 0 || out_remaining <= 0)
+            break;
+
+        /* Read character */
+        read_start = *input;
+        value = reader(input, in_remaining);
+        in_remaining -= *input - read_start;
+
+        /* Write character */
+        write_start = *output;
+        writer(output, out_remaining, value);
+        out_remaining -= *output - write_start;
+
+        /* Stop if null terminator reached */
+        if (value == 0)
+            return 1;
+
+    }
+
+    /* Null terminator not reached */
+    return 0;
+
+}
+
+int guac_iconv_partial(guac_iconv_read* reader, const char** input,
+        int in_remaining, guac_iconv_write* writer, char** output,
+        int out_remaining) {
+
+    /* Stop before reading any character which may not fit within the output,
+     * such that conversion can be safely resumed with a fresh output buffer */
+    while (in_remaining > 0 && out_remaining >= GUAC_ICONV_MAX_CHARACTER_BYTES) {
+
+        int value;
+        const char* read_start;
+        char* write_start;
+
+        /* Convert any leading run of printable ASCII in bulk, leaving the
+         * next character (if any) for the generic loop below (the bulk
+         * conversion only ever writes complete characters, so conversion
+         * remains resumable at the point it stops) */
+        guac_iconv_bulk_ascii(reader, input, &in_remaining,
+                writer, output, &out_remaining);
+
+        if (in_remaining <= 0 || out_remaining < GUAC_ICONV_MAX_CHARACTER_BYTES)
+            break;
+
         /* Read character */
         read_start = *input;
         value = reader(input, in_remaining);
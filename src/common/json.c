@@ -165,8 +165,13 @@ void guac_common_json_begin_object(guac_user* user, guac_stream* stream,
     json_state->size = 0;
     json_state->properties_written = 0;
 
-    /* Write leading brace - no blob can possibly be written by this */
-    assert(!guac_common_json_write(user, stream, json_state, "{", 1));
+    /* Write leading brace - no blob can possibly be written by this, as the
+     * buffer was just emptied (NOTE: The write must not occur within the
+     * assert() itself, as it would then be omitted entirely if NDEBUG is
+     * defined) */
+    int blob_written = guac_common_json_write(user, stream, json_state, "{", 1);
+    assert(!blob_written);
+    (void) blob_written;
 
 }
 
@@ -29,8 +29,9 @@ guac_common_list* guac_common_list_alloc() {
 
     guac_common_list* list = guac_mem_alloc(sizeof(guac_common_list));
 
-    pthread_mutex_init(&list->_lock, NULL);
+    pthread_rwlock_init(&list->_lock, NULL);
     list->head = NULL;
+    list->_unused = NULL;
 
     return list;
 
@@ -53,7 +54,16 @@ void guac_common_list_free(
         element = next;
     }
 
+    /* Free every pooled (removed and not yet reused) element */
+    element = list->_unused;
+    while (element != NULL) {
+        guac_common_list_element* next = element->next;
+        guac_mem_free(element);
+        element = next;
+    }
+
     /* Free the list itself */
+    pthread_rwlock_destroy(&list->_lock);
     guac_mem_free(list);
 
 }
@@ -61,9 +71,19 @@ void guac_common_list_free(
 guac_common_list_element* guac_common_list_add(guac_common_list* list,
         void* data) {
 
-    /* Allocate element, initialize as new head */
-    guac_common_list_element* element =
-        guac_mem_alloc(sizeof(guac_common_list_element));
+    guac_common_list_element* element;
+
+    /* Reuse a pooled element if available, avoiding allocation */
+    if (list->_unused != NULL) {
+        element = list->_unused;
+        list->_unused = element->next;
+    }
+
+    /* Otherwise, allocate a new element */
+    else
+        element = guac_mem_alloc(sizeof(guac_common_list_element));
+
+    /* Initialize element as new head */
     element->data = data;
     element->next = list->head;
     element->_ptr = &(list->head);
@@ -87,15 +107,21 @@ void guac_common_list_remove(guac_common_list* list,
     if (element->next != NULL)
         element->next->_ptr = element->_ptr;
 
-    guac_mem_free(element);
+    /* Return element to the pool for reuse by future adds */
+    element->next = list->_unused;
+    list->_unused = element;
 
 }
 
 void guac_common_list_lock(guac_common_list* list) {
-    pthread_mutex_lock(&list->_lock);
+    pthread_rwlock_wrlock(&list->_lock);
+}
+
+void guac_common_list_lock_read(guac_common_list* list) {
+    pthread_rwlock_rdlock(&list->_lock);
 }
 
 void guac_common_list_unlock(guac_common_list* list) {
-    pthread_mutex_unlock(&list->_lock);
+    pthread_rwlock_unlock(&list->_lock);
 }
 
@@ -31,9 +31,19 @@
 #include <guacamole/user.h>
 
 #include <pthread.h>
+#include <sched.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <unistd.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define GUAC_COMMON_SURFACE_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define GUAC_COMMON_SURFACE_NEON 1
+#include <arm_neon.h>
+#endif
 
 /**
  * The width of an update which should be considered negible and thus
@@ -74,6 +84,19 @@
  */
 #define GUAC_SURFACE_FILL_PATTERN_FACTOR 3
 
+/**
+ * The maximum number of worker threads to create for encoding queued bitmap
+ * updates in parallel.
+ */
+#define GUAC_COMMON_SURFACE_MAX_WORKERS 4
+
+/**
+ * The initial size of the buffer used to capture the output of each bitmap
+ * update encoded by a worker thread, in bytes. The buffer will grow beyond
+ * this size as needed.
+ */
+#define GUAC_COMMON_SURFACE_ENCODE_BUFFER_SIZE 8192
+
 /* Define cairo_format_stride_for_width() if missing */
 #ifndef HAVE_CAIRO_FORMAT_STRIDE_FOR_WIDTH
 #define cairo_format_stride_for_width(format, width) (width*4)
@@ -97,6 +120,13 @@
  */
 #define GUAC_SURFACE_JPEG_BLOCK_SIZE 16
 
+/**
+ * The vertical distance between the rows sampled when estimating how well the
+ * contents of a heat map cell would compress as PNG. Only one row in this many
+ * is examined.
+ */
+#define GUAC_SURFACE_PNG_OPTIMALITY_ROW_STEP 4
+
 /**
  * The WebP compression min block size. This defines the optimal rectangle block
  * size factor for WebP compression. WebP does utilize variable block size, but
@@ -352,6 +382,69 @@ static int __guac_common_should_combine(guac_common_surface* surface, const guac
 
 }
 
+/**
+ * Attempts to merge the given rectangle into one of the updates already
+ * within the bitmap update queue of the given surface, leaving the current
+ * dirty rectangle untouched. The rectangle will only be merged into a queued
+ * update if the cost estimate of the merged update is more favorable than
+ * tracking and later flushing the rectangle independently.
+ *
+ * @param surface
+ *     The surface being updated.
+ *
+ * @param rect
+ *     The bounding rectangle of the update being made to the surface.
+ *
+ * @return
+ *     Non-zero if the rectangle was merged into a queued update, zero
+ *     otherwise.
+ */
+static int __guac_common_merge_queued_rect(guac_common_surface* surface,
+        const guac_common_rect* rect) {
+
+    int i;
+
+    for (i = 0; i < surface->bitmap_queue_length; i++) {
+
+        guac_common_surface_bitmap_rect* queued = &surface->bitmap_queue[i];
+
+        int combined_cost, queued_cost, update_cost;
+
+        /* Simulate combination */
+        guac_common_rect combined = queued->rect;
+        guac_common_rect_extend(&combined, rect);
+
+        /* Merge if result is still small */
+        if (combined.width <= GUAC_SURFACE_NEGLIGIBLE_WIDTH
+                && combined.height <= GUAC_SURFACE_NEGLIGIBLE_HEIGHT) {
+            queued->rect = combined;
+            return 1;
+        }
+
+        /* Estimate costs of the queued update, new update, and both combined */
+        combined_cost = GUAC_SURFACE_BASE_COST + combined.width * combined.height;
+        queued_cost   = GUAC_SURFACE_BASE_COST + queued->rect.width * queued->rect.height;
+        update_cost   = GUAC_SURFACE_BASE_COST + rect->width * rect->height;
+
+        /* Merge if cost estimate shows benefit */
+        if (combined_cost <= update_cost + queued_cost) {
+            queued->rect = combined;
+            return 1;
+        }
+
+        /* Merge if increase in cost is negligible */
+        if (combined_cost - queued_cost <= queued_cost / GUAC_SURFACE_NEGLIGIBLE_INCREASE) {
+            queued->rect = combined;
+            return 1;
+        }
+
+    }
+
+    /* No queued update can cheaply contain the rectangle */
+    return 0;
+
+}
+
 /**
  * Expands the dirty rect of the given surface to contain the rect described by the given
  * coordinates.
@@ -455,13 +548,134 @@ static unsigned int __guac_common_surface_calculate_framerate(
 
     return 0;
 
+}
+
+ /**
+ * Recalculates the cached PNG optimality counts of the given heat map cell,
+ * sampling a subset of the rows of the area of the surface associated with
+ * that cell.
+ *
+ * @param surface
+ *     The surface containing the image data to sample.
+ *
+ * @param cell
+ *     The heat map cell whose cached counts should be recalculated.
+ *
+ * @param cell_x
+ *     The X coordinate of the cell within the heat map.
+ *
+ * @param cell_y
+ *     The Y coordinate of the cell within the heat map.
+ */
+static void __guac_common_surface_update_cell_optimality(
+        guac_common_surface* surface, guac_common_surface_heat_cell* cell,
+        int cell_x, int cell_y) {
+
+    int x, y;
+
+    unsigned int num_same = 0;
+    unsigned int num_different = 0;
+
+    /* Determine pixel area covered by cell, clipped to surface bounds */
+    int left = cell_x * GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+    int top = cell_y * GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+
+    int width = surface->width - left;
+    if (width > GUAC_COMMON_SURFACE_HEAT_CELL_SIZE)
+        width = GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+
+    int height = surface->height - top;
+    if (height > GUAC_COMMON_SURFACE_HEAT_CELL_SIZE)
+        height = GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+
+    int stride = surface->stride;
+    unsigned char* buffer = surface->buffer + top * stride + left * 4;
+
+    /* Sample a subset of the rows covered by the cell */
+    for (y = 0; y < height; y += GUAC_SURFACE_PNG_OPTIMALITY_ROW_STEP) {
+
+        uint32_t* row = (uint32_t*) (buffer + y * stride);
+        uint32_t last_pixel = *(row++) | 0xFF000000;
+
+        /* For each remaining pixel in sampled row */
+        for (x = 1; x < width; x++) {
+
+            /* Get next pixel */
+            uint32_t current_pixel = *(row++) | 0xFF000000;
+
+            /* Update same/different counts according to pixel value */
+            if (current_pixel == last_pixel)
+                num_same++;
+            else
+                num_different++;
+
+            last_pixel = current_pixel;
+
+        }
+
+    }
+
+    /* Counts are now current */
+    cell->num_same = num_same;
+    cell->num_different = num_different;
+    cell->optimality_valid = 1;
+
+}
+
+/**
+ * Invalidates the cached PNG optimality counts of all heat map cells
+ * intersecting the given rectangle. The counts of each invalidated cell will
+ * be recalculated the next time they are needed.
+ *
+ * @param surface
+ *     The surface that was modified.
+ *
+ * @param rect
+ *     The rectangle of the surface containing modified pixels.
+ */
+static void __guac_common_surface_invalidate_optimality(
+        guac_common_surface* surface, const guac_common_rect* rect) {
+
+    int x, y;
+
+    /* Ignore empty rects */
+    if (rect->width < 1 || rect->height < 1)
+        return;
+
+    /* Calculate heat map dimensions */
+    size_t heat_width = GUAC_COMMON_SURFACE_HEAT_DIMENSION(surface->width);
+
+    /* Calculate minimum/maximum cell coordinates intersecting given rect */
+    int min_x = rect->x / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+    int min_y = rect->y / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+    int max_x = (rect->x + rect->width - 1)
+        / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+    int max_y = (rect->y + rect->height - 1)
+        / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+
+    /* Invalidate all intersecting cells */
+    for (y = min_y; y <= max_y; y++) {
+
+        guac_common_surface_heat_cell* heat_cell =
+            surface->heat_map + y * heat_width + min_x;
+
+        for (x = min_x; x <= max_x; x++) {
+            heat_cell->optimality_valid = 0;
+            heat_cell++;
+        }
+
+    }
+
 }
 
  /**
  * Guesses whether a rectangle within a particular surface would be better
  * compressed as PNG or using a lossy format like JPEG. Positive values
  * indicate PNG is likely to be superior, while negative values indicate the
- * opposite.
+ * opposite. The estimate is derived from per-cell counts of identical
+ * adjacent pixels which are sampled rather than exhaustive, and which are
+ * cached within the heat map until the contents of the corresponding cell
+ * change.
  *
  * @param surface
  *     The surface containing the image data to check.
@@ -479,50 +693,49 @@ static int __guac_common_surface_png_optimality(guac_common_surface* surface,
 
     int x, y;
 
-    int num_same = 0;
-    int num_different = 1;
-
-    /* Get image/buffer metrics */
-    int width = rect->width;
-    int height = rect->height;
-    int stride = surface->stride;
-
-    /* Get buffer from surface */
-    unsigned char* buffer = surface->buffer + rect->y * stride + rect->x * 4;
+    unsigned int num_same = 0;
+    unsigned int num_different = 1;
 
     /* Image must be at least 1x1 */
-    if (width < 1 || height < 1)
+    if (rect->width < 1 || rect->height < 1)
         return 0;
 
-    /* For each row */
-    for (y = 0; y < height; y++) {
+    /* Calculate heat map dimensions */
+    size_t heat_width = GUAC_COMMON_SURFACE_HEAT_DIMENSION(surface->width);
 
-        uint32_t* row = (uint32_t*) buffer;
-        uint32_t last_pixel = *(row++) | 0xFF000000;
+    /* Calculate minimum/maximum cell coordinates intersecting given rect */
+    int min_x = rect->x / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+    int min_y = rect->y / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+    int max_x = (rect->x + rect->width - 1)
+        / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+    int max_y = (rect->y + rect->height - 1)
+        / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+
+    /* Aggregate the cached counts of all intersecting cells, recalculating
+     * the counts of any cell whose contents have changed since its counts
+     * were last cached */
+    for (y = min_y; y <= max_y; y++) {
 
-        /* For each pixel in current row */
-        for (x = 1; x < width; x++) {
+        guac_common_surface_heat_cell* heat_cell =
+            surface->heat_map + y * heat_width + min_x;
 
-            /* Get next pixel */
-            uint32_t current_pixel = *(row++) | 0xFF000000;
+        for (x = min_x; x <= max_x; x++) {
 
-            /* Update same/different counts according to pixel value */
-            if (current_pixel == last_pixel)
-                num_same++;
-            else
-                num_different++;
+            if (!heat_cell->optimality_valid)
+                __guac_common_surface_update_cell_optimality(surface,
+                        heat_cell, x, y);
 
-            last_pixel = current_pixel;
+            num_same += heat_cell->num_same;
+            num_different += heat_cell->num_different;
 
-        }
+            heat_cell++;
 
-        /* Advance to next row */
-        buffer += stride;
+        }
 
     }
 
     /* Return rough approximation of optimality for PNG compression */
-    return 0x100 * num_same / num_different - 0x400;
+    return (int) (0x100L * num_same / num_different - 0x400);
 
 }
 
@@ -718,6 +931,38 @@ static void __guac_common_surface_flush_deferred(guac_common_surface* surface) {
 
 }
 
+/**
+ * Defers the bitmap update described by the given rectangle, tracking it
+ * within the dirty region of the given surface. The update is combined with
+ * the current dirty rectangle if doing so is cost-effective, merged into an
+ * update already within the bitmap update queue if not, and otherwise
+ * tracked as a new, independent update, with the current dirty rectangle
+ * flushed to the queue.
+ *
+ * @param surface The surface being updated.
+ * @param rect The bounding rectangle of the update being deferred.
+ */
+static void __guac_common_surface_defer_draw(guac_common_surface* surface,
+        const guac_common_rect* rect) {
+
+    /* Combine with the current dirty rect if cost-effective */
+    if (__guac_common_should_combine(surface, rect, 0)) {
+        __guac_common_mark_dirty(surface, rect);
+        return;
+    }
+
+    /* Merge into an already-queued update if cost-effective, leaving the
+     * current dirty rect untouched */
+    if (__guac_common_merge_queued_rect(surface, rect))
+        return;
+
+    /* Otherwise, flush the current dirty rect to the queue and track the
+     * update independently */
+    __guac_common_surface_flush_deferred(surface);
+    __guac_common_mark_dirty(surface, rect);
+
+}
+
 /**
  * Transfers a single uint32_t using the given transfer function.
  *
@@ -802,91 +1047,6 @@ static int __guac_common_surface_transfer_int(guac_transfer_function op, uint32_
 
 }
 
-/**
- * Assigns the given value to all pixels within a rectangle of the backing
- * surface of the given destination surface. The color of all pixels within the
- * rectangle, including the alpha component, is entirely replaced.
- *
- * @param dst
- *     The destination surface.
- *
- * @param rect
- *     The rectangle to draw.
- *
- * @param red
- *     The red component of the color value to assign to all pixels within the
- *     rectangle.
- *
- * @param green
- *     The green component of the color value to assign to all pixels within
- *     the rectangle.
- *
- * @param blue 
- *     The blue component of the color value to assign to all pixels within the
- *     rectangle.
- *
- * @param alpha 
- *     The alpha component of the color value to assign to all pixels within
- *     the rectangle.
- */
-static void __guac_common_surface_set(guac_common_surface* dst,
-        guac_common_rect* rect, int red, int green, int blue, int alpha) {
-
-    int x, y;
-
-    int dst_stride;
-    unsigned char* dst_buffer;
-
-    uint32_t color = (alpha << 24) | (red << 16) | (green << 8) | blue;
-
-    int min_x = rect->width - 1;
-    int min_y = rect->height - 1;
-    int max_x = 0;
-    int max_y = 0;
-
-    dst_stride = dst->stride;
-    dst_buffer = dst->buffer + (dst_stride * rect->y) + (4 * rect->x);
-
-    /* For each row */
-    for (y=0; y < rect->height; y++) {
-
-        uint32_t* dst_current = (uint32_t*) dst_buffer;
-
-        /* Set row */
-        for (x=0; x < rect->width; x++) {
-
-            uint32_t old_color = *dst_current;
-
-            if (old_color != color) {
-                if (x < min_x) min_x = x;
-                if (y < min_y) min_y = y;
-                if (x > max_x) max_x = x;
-                if (y > max_y) max_y = y;
-                *dst_current = color;
-            }
-
-            dst_current++;
-        }
-
-        /* Next row */
-        dst_buffer += dst_stride;
-
-    }
-
-    /* Restrict destination rect to only updated pixels */
-    if (max_x >= min_x && max_y >= min_y) {
-        rect->x += min_x;
-        rect->y += min_y;
-        rect->width = max_x - min_x + 1;
-        rect->height = max_y - min_y + 1;
-    }
-    else {
-        rect->width = 0;
-        rect->height = 0;
-    }
-
-}
-
 /**
  * Applies the Porter-Duff "over" composite operator, blending the two given
  * color components using the given alpha value.
@@ -964,6 +1124,1008 @@ static uint32_t guac_common_surface_argb_blend(uint32_t dst, uint32_t src) {
 
 }
 
+/**
+ * Row kernel which assigns the value (*src | or_mask) ^ xor_mask to each pixel
+ * of a row of 32-bit ARGB image data, determining the range of pixels whose
+ * values actually changed. Setting both masks to zero produces a simple copy,
+ * while an or_mask of 0xFF000000 copies ignoring the source alpha channel and
+ * an xor_mask of 0x00FFFFFF copies inverting the source color.
+ *
+ * @param src
+ *     The row of pixels to copy.
+ *
+ * @param dst
+ *     The row of pixels that the copy will be stored within. This row may
+ *     overlap the source row, but only such that each destination pixel is
+ *     located at or before its corresponding source pixel in memory.
+ *
+ * @param width
+ *     The number of pixels in each row.
+ *
+ * @param or_mask
+ *     The value to bitwise-OR with each source pixel prior to storing it
+ *     within the destination row.
+ *
+ * @param xor_mask
+ *     The value to bitwise-XOR with each source pixel prior to storing it
+ *     within the destination row.
+ *
+ * @param first
+ *     A pointer to an int that should receive the offset of the first pixel
+ *     within the destination row whose value changed. The value of the int
+ *     will only be modified if at least one pixel changed.
+ *
+ * @param last
+ *     A pointer to an int that should receive the offset of the last pixel
+ *     within the destination row whose value changed (which may be identical
+ *     to the first). The value of the int will only be modified if at least
+ *     one pixel changed.
+ *
+ * @return
+ *     Non-zero if at least one pixel within the destination row was changed,
+ *     zero otherwise.
+ */
+static int guac_common_surface_copy_row_scalar(const uint32_t* src,
+        uint32_t* dst, int width, uint32_t or_mask, uint32_t xor_mask,
+        int* first, int* last) {
+
+    int x;
+    int min = width;
+    int max = -1;
+
+    for (x = 0; x < width; x++) {
+
+        uint32_t color = (src[x] | or_mask) ^ xor_mask;
+        if (dst[x] != color) {
+            if (x < min) min = x;
+            max = x;
+            dst[x] = color;
+        }
+
+    }
+
+    if (max < 0)
+        return 0;
+
+    *first = min;
+    *last = max;
+    return 1;
+
+}
+
+/**
+ * Row kernel which assigns the given value to each pixel of a row of 32-bit
+ * ARGB image data, determining the range of pixels whose values actually
+ * changed.
+ *
+ * @param dst
+ *     The row of pixels to fill.
+ *
+ * @param width
+ *     The number of pixels in the row.
+ *
+ * @param color
+ *     The ARGB color value to assign to each pixel.
+ *
+ * @param first
+ *     A pointer to an int that should receive the offset of the first pixel
+ *     within the row whose value changed. The value of the int will only be
+ *     modified if at least one pixel changed.
+ *
+ * @param last
+ *     A pointer to an int that should receive the offset of the last pixel
+ *     within the row whose value changed (which may be identical to the
+ *     first). The value of the int will only be modified if at least one
+ *     pixel changed.
+ *
+ * @return
+ *     Non-zero if at least one pixel within the row was changed, zero
+ *     otherwise.
+ */
+static int guac_common_surface_fill_row_scalar(uint32_t* dst, int width,
+        uint32_t color, int* first, int* last) {
+
+    int x;
+    int min = width;
+    int max = -1;
+
+    for (x = 0; x < width; x++) {
+
+        if (dst[x] != color) {
+            if (x < min) min = x;
+            max = x;
+            dst[x] = color;
+        }
+
+    }
+
+    if (max < 0)
+        return 0;
+
+    *first = min;
+    *last = max;
+    return 1;
+
+}
+
+/**
+ * Row kernel which blends each pixel of a row of 32-bit ARGB image data over
+ * the corresponding pixel of a destination row using the Porter-Duff "over"
+ * composite operator, determining the range of pixels whose values actually
+ * changed.
+ *
+ * @param src
+ *     The row of pixels to blend over the destination row.
+ *
+ * @param dst
+ *     The row of pixels that the blended result will be stored within.
+ *
+ * @param width
+ *     The number of pixels in each row.
+ *
+ * @param first
+ *     A pointer to an int that should receive the offset of the first pixel
+ *     within the destination row whose value changed. The value of the int
+ *     will only be modified if at least one pixel changed.
+ *
+ * @param last
+ *     A pointer to an int that should receive the offset of the last pixel
+ *     within the destination row whose value changed (which may be identical
+ *     to the first). The value of the int will only be modified if at least
+ *     one pixel changed.
+ *
+ * @return
+ *     Non-zero if at least one pixel within the destination row was changed,
+ *     zero otherwise.
+ */
+static int guac_common_surface_blend_row_scalar(const uint32_t* src,
+        uint32_t* dst, int width, int* first, int* last) {
+
+    int x;
+    int min = width;
+    int max = -1;
+
+    for (x = 0; x < width; x++) {
+
+        uint32_t color = guac_common_surface_argb_blend(dst[x], src[x]);
+        if (dst[x] != color) {
+            if (x < min) min = x;
+            max = x;
+            dst[x] = color;
+        }
+
+    }
+
+    if (max < 0)
+        return 0;
+
+    *first = min;
+    *last = max;
+    return 1;
+
+}
+
+/**
+ * The copy kernel most appropriate for the current CPU. This value defaults
+ * to the scalar implementation and is assigned exactly once by
+ * guac_common_surface_kernels_select(). Each implementation is semantically
+ * identical to guac_common_surface_copy_row_scalar().
+ */
+static int (*guac_common_surface_copy_row)(const uint32_t* src, uint32_t* dst,
+        int width, uint32_t or_mask, uint32_t xor_mask, int* first,
+        int* last) = guac_common_surface_copy_row_scalar;
+
+/**
+ * The fill kernel most appropriate for the current CPU. This value defaults
+ * to the scalar implementation and is assigned exactly once by
+ * guac_common_surface_kernels_select(). Each implementation is semantically
+ * identical to guac_common_surface_fill_row_scalar().
+ */
+static int (*guac_common_surface_fill_row)(uint32_t* dst, int width,
+        uint32_t color, int* first, int* last) =
+    guac_common_surface_fill_row_scalar;
+
+/**
+ * The blend kernel most appropriate for the current CPU. This value defaults
+ * to the scalar implementation and is assigned exactly once by
+ * guac_common_surface_kernels_select(). Each implementation is semantically
+ * identical to guac_common_surface_blend_row_scalar().
+ */
+static int (*guac_common_surface_blend_row)(const uint32_t* src, uint32_t* dst,
+        int width, int* first, int* last) =
+    guac_common_surface_blend_row_scalar;
+
+/**
+ * Pthread initialization routine which selects the row kernels to use for all
+ * surface drawing operations. Invoked via pthread_once().
+ */
+static pthread_once_t guac_common_surface_kernels_selected = PTHREAD_ONCE_INIT;
+
+#ifdef GUAC_COMMON_SURFACE_X86
+
+/**
+ * SSE2 variant of guac_common_surface_copy_row_scalar(), copying four pixels
+ * at a time and locating changed pixels within each 16-byte block using
+ * comparison bitmasks.
+ *
+ * @param src
+ *     The row of pixels to copy.
+ *
+ * @param dst
+ *     The row of pixels that the copy will be stored within.
+ *
+ * @param width
+ *     The number of pixels in each row.
+ *
+ * @param or_mask
+ *     The value to bitwise-OR with each source pixel prior to storing it
+ *     within the destination row.
+ *
+ * @param xor_mask
+ *     The value to bitwise-XOR with each source pixel prior to storing it
+ *     within the destination row.
+ *
+ * @param first
+ *     A pointer to an int that should receive the offset of the first pixel
+ *     within the destination row whose value changed.
+ *
+ * @param last
+ *     A pointer to an int that should receive the offset of the last pixel
+ *     within the destination row whose value changed.
+ *
+ * @return
+ *     Non-zero if at least one pixel within the destination row was changed,
+ *     zero otherwise.
+ */
+static int guac_common_surface_copy_row_sse2(const uint32_t* src,
+        uint32_t* dst, int width, uint32_t or_mask, uint32_t xor_mask,
+        int* first, int* last) {
+
+    __m128i vec_or = _mm_set1_epi32(or_mask);
+    __m128i vec_xor = _mm_set1_epi32(xor_mask);
+
+    int x;
+    int min = width;
+    int max = -1;
+
+    /* Copy blocks of four pixels at a time, storing each block only if it
+     * differs from the destination */
+    for (x = 0; x + 4 <= width; x += 4) {
+
+        __m128i color = _mm_xor_si128(_mm_or_si128(
+                    _mm_loadu_si128((const __m128i*) (src + x)), vec_or),
+                vec_xor);
+
+        __m128i cmp = _mm_cmpeq_epi32(color,
+                _mm_loadu_si128((const __m128i*) (dst + x)));
+
+        int diff = ~_mm_movemask_ps(_mm_castsi128_ps(cmp)) & 0xF;
+        if (diff) {
+            _mm_storeu_si128((__m128i*) (dst + x), color);
+            if (min == width) min = x + __builtin_ctz(diff);
+            max = x + (31 - __builtin_clz(diff));
+        }
+
+    }
+
+    /* Copy the remaining tail pixels individually */
+    for (; x < width; x++) {
+
+        uint32_t color = (src[x] | or_mask) ^ xor_mask;
+        if (dst[x] != color) {
+            if (x < min) min = x;
+            max = x;
+            dst[x] = color;
+        }
+
+    }
+
+    if (max < 0)
+        return 0;
+
+    *first = min;
+    *last = max;
+    return 1;
+
+}
+
+/**
+ * AVX2 variant of guac_common_surface_copy_row_scalar(), copying eight pixels
+ * at a time and locating changed pixels within each 32-byte block using
+ * comparison bitmasks.
+ *
+ * @param src
+ *     The row of pixels to copy.
+ *
+ * @param dst
+ *     The row of pixels that the copy will be stored within.
+ *
+ * @param width
+ *     The number of pixels in each row.
+ *
+ * @param or_mask
+ *     The value to bitwise-OR with each source pixel prior to storing it
+ *     within the destination row.
+ *
+ * @param xor_mask
+ *     The value to bitwise-XOR with each source pixel prior to storing it
+ *     within the destination row.
+ *
+ * @param first
+ *     A pointer to an int that should receive the offset of the first pixel
+ *     within the destination row whose value changed.
+ *
+ * @param last
+ *     A pointer to an int that should receive the offset of the last pixel
+ *     within the destination row whose value changed.
+ *
+ * @return
+ *     Non-zero if at least one pixel within the destination row was changed,
+ *     zero otherwise.
+ */
+__attribute__((target("avx2")))
+static int guac_common_surface_copy_row_avx2(const uint32_t* src,
+        uint32_t* dst, int width, uint32_t or_mask, uint32_t xor_mask,
+        int* first, int* last) {
+
+    __m256i vec_or = _mm256_set1_epi32(or_mask);
+    __m256i vec_xor = _mm256_set1_epi32(xor_mask);
+
+    int x;
+    int min = width;
+    int max = -1;
+
+    /* Copy blocks of eight pixels at a time, storing each block only if it
+     * differs from the destination */
+    for (x = 0; x + 8 <= width; x += 8) {
+
+        __m256i color = _mm256_xor_si256(_mm256_or_si256(
+                    _mm256_loadu_si256((const __m256i*) (src + x)), vec_or),
+                vec_xor);
+
+        __m256i cmp = _mm256_cmpeq_epi32(color,
+                _mm256_loadu_si256((const __m256i*) (dst + x)));
+
+        int diff = ~_mm256_movemask_ps(_mm256_castsi256_ps(cmp)) & 0xFF;
+        if (diff) {
+            _mm256_storeu_si256((__m256i*) (dst + x), color);
+            if (min == width) min = x + __builtin_ctz(diff);
+            max = x + (31 - __builtin_clz(diff));
+        }
+
+    }
+
+    /* Copy the remaining tail pixels individually */
+    for (; x < width; x++) {
+
+        uint32_t color = (src[x] | or_mask) ^ xor_mask;
+        if (dst[x] != color) {
+            if (x < min) min = x;
+            max = x;
+            dst[x] = color;
+        }
+
+    }
+
+    if (max < 0)
+        return 0;
+
+    *first = min;
+    *last = max;
+    return 1;
+
+}
+
+/**
+ * SSE2 variant of guac_common_surface_fill_row_scalar(), comparing four
+ * pixels at a time against the fill color and locating changed pixels within
+ * each 16-byte block using comparison bitmasks.
+ *
+ * @param dst
+ *     The row of pixels to fill.
+ *
+ * @param width
+ *     The number of pixels in the row.
+ *
+ * @param color
+ *     The ARGB color value to assign to each pixel.
+ *
+ * @param first
+ *     A pointer to an int that should receive the offset of the first pixel
+ *     within the row whose value changed.
+ *
+ * @param last
+ *     A pointer to an int that should receive the offset of the last pixel
+ *     within the row whose value changed.
+ *
+ * @return
+ *     Non-zero if at least one pixel within the row was changed, zero
+ *     otherwise.
+ */
+static int guac_common_surface_fill_row_sse2(uint32_t* dst, int width,
+        uint32_t color, int* first, int* last) {
+
+    __m128i vec_color = _mm_set1_epi32(color);
+
+    int x;
+    int min = width;
+    int max = -1;
+
+    /* Fill blocks of four pixels at a time, storing each block only if it
+     * differs from the fill color */
+    for (x = 0; x + 4 <= width; x += 4) {
+
+        __m128i cmp = _mm_cmpeq_epi32(vec_color,
+                _mm_loadu_si128((const __m128i*) (dst + x)));
+
+        int diff = ~_mm_movemask_ps(_mm_castsi128_ps(cmp)) & 0xF;
+        if (diff) {
+            _mm_storeu_si128((__m128i*) (dst + x), vec_color);
+            if (min == width) min = x + __builtin_ctz(diff);
+            max = x + (31 - __builtin_clz(diff));
+        }
+
+    }
+
+    /* Fill the remaining tail pixels individually */
+    for (; x < width; x++) {
+
+        if (dst[x] != color) {
+            if (x < min) min = x;
+            max = x;
+            dst[x] = color;
+        }
+
+    }
+
+    if (max < 0)
+        return 0;
+
+    *first = min;
+    *last = max;
+    return 1;
+
+}
+
+/**
+ * AVX2 variant of guac_common_surface_fill_row_scalar(), comparing eight
+ * pixels at a time against the fill color and locating changed pixels within
+ * each 32-byte block using comparison bitmasks.
+ *
+ * @param dst
+ *     The row of pixels to fill.
+ *
+ * @param width
+ *     The number of pixels in the row.
+ *
+ * @param color
+ *     The ARGB color value to assign to each pixel.
+ *
+ * @param first
+ *     A pointer to an int that should receive the offset of the first pixel
+ *     within the row whose value changed.
+ *
+ * @param last
+ *     A pointer to an int that should receive the offset of the last pixel
+ *     within the row whose value changed.
+ *
+ * @return
+ *     Non-zero if at least one pixel within the row was changed, zero
+ *     otherwise.
+ */
+__attribute__((target("avx2")))
+static int guac_common_surface_fill_row_avx2(uint32_t* dst, int width,
+        uint32_t color, int* first, int* last) {
+
+    __m256i vec_color = _mm256_set1_epi32(color);
+
+    int x;
+    int min = width;
+    int max = -1;
+
+    /* Fill blocks of eight pixels at a time, storing each block only if it
+     * differs from the fill color */
+    for (x = 0; x + 8 <= width; x += 8) {
+
+        __m256i cmp = _mm256_cmpeq_epi32(vec_color,
+                _mm256_loadu_si256((const __m256i*) (dst + x)));
+
+        int diff = ~_mm256_movemask_ps(_mm256_castsi256_ps(cmp)) & 0xFF;
+        if (diff) {
+            _mm256_storeu_si256((__m256i*) (dst + x), vec_color);
+            if (min == width) min = x + __builtin_ctz(diff);
+            max = x + (31 - __builtin_clz(diff));
+        }
+
+    }
+
+    /* Fill the remaining tail pixels individually */
+    for (; x < width; x++) {
+
+        if (dst[x] != color) {
+            if (x < min) min = x;
+            max = x;
+            dst[x] = color;
+        }
+
+    }
+
+    if (max < 0)
+        return 0;
+
+    *first = min;
+    *last = max;
+    return 1;
+
+}
+
+/**
+ * SSE2 variant of guac_common_surface_blend_row_scalar(), handling blocks of
+ * four fully-opaque source pixels (the common case for image data received
+ * from legacy protocol layers) as simple copies and blending individual
+ * pixels only within blocks that are not fully opaque.
+ *
+ * @param src
+ *     The row of pixels to blend over the destination row.
+ *
+ * @param dst
+ *     The row of pixels that the blended result will be stored within.
+ *
+ * @param width
+ *     The number of pixels in each row.
+ *
+ * @param first
+ *     A pointer to an int that should receive the offset of the first pixel
+ *     within the destination row whose value changed.
+ *
+ * @param last
+ *     A pointer to an int that should receive the offset of the last pixel
+ *     within the destination row whose value changed.
+ *
+ * @return
+ *     Non-zero if at least one pixel within the destination row was changed,
+ *     zero otherwise.
+ */
+static int guac_common_surface_blend_row_sse2(const uint32_t* src,
+        uint32_t* dst, int width, int* first, int* last) {
+
+    __m128i vec_alpha = _mm_set1_epi32(0xFF000000);
+
+    int x;
+    int min = width;
+    int max = -1;
+
+    for (x = 0; x + 4 <= width; x += 4) {
+
+        __m128i color = _mm_loadu_si128((const __m128i*) (src + x));
+
+        /* Blocks of fully-opaque source pixels blend to exactly the source
+         * pixels and may be handled as a simple copy */
+        __m128i opaque = _mm_cmpeq_epi32(
+                _mm_and_si128(color, vec_alpha), vec_alpha);
+
+        if (_mm_movemask_ps(_mm_castsi128_ps(opaque)) == 0xF) {
+
+            __m128i cmp = _mm_cmpeq_epi32(color,
+                    _mm_loadu_si128((const __m128i*) (dst + x)));
+
+            int diff = ~_mm_movemask_ps(_mm_castsi128_ps(cmp)) & 0xF;
+            if (diff) {
+                _mm_storeu_si128((__m128i*) (dst + x), color);
+                if (min == width) min = x + __builtin_ctz(diff);
+                max = x + (31 - __builtin_clz(diff));
+            }
+
+        }
+
+        /* Blend all other blocks pixel-by-pixel */
+        else {
+
+            int i;
+            for (i = x; i < x + 4; i++) {
+
+                uint32_t blended = guac_common_surface_argb_blend(dst[i],
+                        src[i]);
+
+                if (dst[i] != blended) {
+                    if (i < min) min = i;
+                    max = i;
+                    dst[i] = blended;
+                }
+
+            }
+
+        }
+
+    }
+
+    /* Blend the remaining tail pixels individually */
+    for (; x < width; x++) {
+
+        uint32_t blended = guac_common_surface_argb_blend(dst[x], src[x]);
+        if (dst[x] != blended) {
+            if (x < min) min = x;
+            max = x;
+            dst[x] = blended;
+        }
+
+    }
+
+    if (max < 0)
+        return 0;
+
+    *first = min;
+    *last = max;
+    return 1;
+
+}
+
+#endif /* GUAC_COMMON_SURFACE_X86 */
+
+#ifdef GUAC_COMMON_SURFACE_NEON
+
+/**
+ * NEON variant of guac_common_surface_copy_row_scalar(), testing four pixels
+ * at a time for differences and falling back to individual copies only within
+ * blocks known to contain a difference.
+ *
+ * @param src
+ *     The row of pixels to copy.
+ *
+ * @param dst
+ *     The row of pixels that the copy will be stored within.
+ *
+ * @param width
+ *     The number of pixels in each row.
+ *
+ * @param or_mask
+ *     The value to bitwise-OR with each source pixel prior to storing it
+ *     within the destination row.
+ *
+ * @param xor_mask
+ *     The value to bitwise-XOR with each source pixel prior to storing it
+ *     within the destination row.
+ *
+ * @param first
+ *     A pointer to an int that should receive the offset of the first pixel
+ *     within the destination row whose value changed.
+ *
+ * @param last
+ *     A pointer to an int that should receive the offset of the last pixel
+ *     within the destination row whose value changed.
+ *
+ * @return
+ *     Non-zero if at least one pixel within the destination row was changed,
+ *     zero otherwise.
+ */
+static int guac_common_surface_copy_row_neon(const uint32_t* src,
+        uint32_t* dst, int width, uint32_t or_mask, uint32_t xor_mask,
+        int* first, int* last) {
+
+    uint32x4_t vec_or = vdupq_n_u32(or_mask);
+    uint32x4_t vec_xor = vdupq_n_u32(xor_mask);
+
+    int x;
+    int min = width;
+    int max = -1;
+
+    /* Test blocks of four pixels at a time, copying individual pixels only
+     * within blocks that differ from the destination */
+    for (x = 0; x + 4 <= width; x += 4) {
+
+        uint32x4_t color = veorq_u32(vorrq_u32(vld1q_u32(src + x), vec_or),
+                vec_xor);
+
+        uint32x4_t cmp = vceqq_u32(color, vld1q_u32(dst + x));
+        if (vminvq_u32(cmp) != 0xFFFFFFFF) {
+
+            int i;
+            for (i = x; i < x + 4; i++) {
+
+                uint32_t value = (src[i] | or_mask) ^ xor_mask;
+                if (dst[i] != value) {
+                    if (i < min) min = i;
+                    max = i;
+                    dst[i] = value;
+                }
+
+            }
+
+        }
+
+    }
+
+    /* Copy the remaining tail pixels individually */
+    for (; x < width; x++) {
+
+        uint32_t value = (src[x] | or_mask) ^ xor_mask;
+        if (dst[x] != value) {
+            if (x < min) min = x;
+            max = x;
+            dst[x] = value;
+        }
+
+    }
+
+    if (max < 0)
+        return 0;
+
+    *first = min;
+    *last = max;
+    return 1;
+
+}
+
+/**
+ * NEON variant of guac_common_surface_fill_row_scalar(), testing four pixels
+ * at a time against the fill color and falling back to individual fills only
+ * within blocks known to contain a difference.
+ *
+ * @param dst
+ *     The row of pixels to fill.
+ *
+ * @param width
+ *     The number of pixels in the row.
+ *
+ * @param color
+ *     The ARGB color value to assign to each pixel.
+ *
+ * @param first
+ *     A pointer to an int that should receive the offset of the first pixel
+ *     within the row whose value changed.
+ *
+ * @param last
+ *     A pointer to an int that should receive the offset of the last pixel
+ *     within the row whose value changed.
+ *
+ * @return
+ *     Non-zero if at least one pixel within the row was changed, zero
+ *     otherwise.
+ */
+static int guac_common_surface_fill_row_neon(uint32_t* dst, int width,
+        uint32_t color, int* first, int* last) {
+
+    uint32x4_t vec_color = vdupq_n_u32(color);
+
+    int x;
+    int min = width;
+    int max = -1;
+
+    /* Test blocks of four pixels at a time, filling individual pixels only
+     * within blocks that differ from the fill color */
+    for (x = 0; x + 4 <= width; x += 4) {
+
+        uint32x4_t cmp = vceqq_u32(vec_color, vld1q_u32(dst + x));
+        if (vminvq_u32(cmp) != 0xFFFFFFFF) {
+
+            int i;
+            for (i = x; i < x + 4; i++) {
+
+                if (dst[i] != color) {
+                    if (i < min) min = i;
+                    max = i;
+                    dst[i] = color;
+                }
+
+            }
+
+        }
+
+    }
+
+    /* Fill the remaining tail pixels individually */
+    for (; x < width; x++) {
+
+        if (dst[x] != color) {
+            if (x < min) min = x;
+            max = x;
+            dst[x] = color;
+        }
+
+    }
+
+    if (max < 0)
+        return 0;
+
+    *first = min;
+    *last = max;
+    return 1;
+
+}
+
+/**
+ * NEON variant of guac_common_surface_blend_row_scalar(), skipping blocks of
+ * four fully-opaque source pixels that are already identical to the
+ * destination and blending individual pixels within all other blocks.
+ *
+ * @param src
+ *     The row of pixels to blend over the destination row.
+ *
+ * @param dst
+ *     The row of pixels that the blended result will be stored within.
+ *
+ * @param width
+ *     The number of pixels in each row.
+ *
+ * @param first
+ *     A pointer to an int that should receive the offset of the first pixel
+ *     within the destination row whose value changed.
+ *
+ * @param last
+ *     A pointer to an int that should receive the offset of the last pixel
+ *     within the destination row whose value changed.
+ *
+ * @return
+ *     Non-zero if at least one pixel within the destination row was changed,
+ *     zero otherwise.
+ */
+static int guac_common_surface_blend_row_neon(const uint32_t* src,
+        uint32_t* dst, int width, int* first, int* last) {
+
+    uint32x4_t vec_alpha = vdupq_n_u32(0xFF000000);
+
+    int x;
+    int min = width;
+    int max = -1;
+
+    for (x = 0; x + 4 <= width; x += 4) {
+
+        uint32x4_t color = vld1q_u32(src + x);
+
+        /* Blocks of fully-opaque source pixels blend to exactly the source
+         * pixels and may be skipped entirely if already identical to the
+         * destination */
+        uint32x4_t opaque = vceqq_u32(vandq_u32(color, vec_alpha), vec_alpha);
+        if (vminvq_u32(opaque) == 0xFFFFFFFF
+                && vminvq_u32(vceqq_u32(color, vld1q_u32(dst + x)))
+                    == 0xFFFFFFFF)
+            continue;
+
+        /* Blend all other blocks pixel-by-pixel */
+        int i;
+        for (i = x; i < x + 4; i++) {
+
+            uint32_t blended = guac_common_surface_argb_blend(dst[i], src[i]);
+            if (dst[i] != blended) {
+                if (i < min) min = i;
+                max = i;
+                dst[i] = blended;
+            }
+
+        }
+
+    }
+
+    /* Blend the remaining tail pixels individually */
+    for (; x < width; x++) {
+
+        uint32_t blended = guac_common_surface_argb_blend(dst[x], src[x]);
+        if (dst[x] != blended) {
+            if (x < min) min = x;
+            max = x;
+            dst[x] = blended;
+        }
+
+    }
+
+    if (max < 0)
+        return 0;
+
+    *first = min;
+    *last = max;
+    return 1;
+
+}
+
+#endif /* GUAC_COMMON_SURFACE_NEON */
+
+/**
+ * Selects the row kernels to use for all surface drawing operations based on
+ * the capabilities of the current CPU. If the CPU supports none of the
+ * available vector implementations, the scalar implementations are retained.
+ */
+static void guac_common_surface_kernels_select(void) {
+
+#if defined(GUAC_COMMON_SURFACE_X86)
+    if (__builtin_cpu_supports("avx2")) {
+        guac_common_surface_copy_row = guac_common_surface_copy_row_avx2;
+        guac_common_surface_fill_row = guac_common_surface_fill_row_avx2;
+    }
+    else {
+        guac_common_surface_copy_row = guac_common_surface_copy_row_sse2;
+        guac_common_surface_fill_row = guac_common_surface_fill_row_sse2;
+    }
+    guac_common_surface_blend_row = guac_common_surface_blend_row_sse2;
+#elif defined(GUAC_COMMON_SURFACE_NEON)
+    guac_common_surface_copy_row = guac_common_surface_copy_row_neon;
+    guac_common_surface_fill_row = guac_common_surface_fill_row_neon;
+    guac_common_surface_blend_row = guac_common_surface_blend_row_neon;
+#endif
+
+}
+
+/**
+ * Assigns the given value to all pixels within a rectangle of the backing
+ * surface of the given destination surface. The color of all pixels within the
+ * rectangle, including the alpha component, is entirely replaced.
+ *
+ * @param dst
+ *     The destination surface.
+ *
+ * @param rect
+ *     The rectangle to draw.
+ *
+ * @param red
+ *     The red component of the color value to assign to all pixels within the
+ *     rectangle.
+ *
+ * @param green
+ *     The green component of the color value to assign to all pixels within
+ *     the rectangle.
+ *
+ * @param blue 
+ *     The blue component of the color value to assign to all pixels within the
+ *     rectangle.
+ *
+ * @param alpha 
+ *     The alpha component of the color value to assign to all pixels within
+ *     the rectangle.
+ */
+static void __guac_common_surface_set(guac_common_surface* dst,
+        guac_common_rect* rect, int red, int green, int blue, int alpha) {
+
+    int y;
+
+    int dst_stride;
+    unsigned char* dst_buffer;
+
+    uint32_t color = (alpha << 24) | (red << 16) | (green << 8) | blue;
+
+    int min_x = rect->width - 1;
+    int min_y = rect->height - 1;
+    int max_x = 0;
+    int max_y = 0;
+
+    /* Fill rows with vector instructions where the CPU supports doing so */
+    pthread_once(&guac_common_surface_kernels_selected,
+            guac_common_surface_kernels_select);
+
+    dst_stride = dst->stride;
+    dst_buffer = dst->buffer + (dst_stride * rect->y) + (4 * rect->x);
+
+    /* For each row */
+    for (y=0; y < rect->height; y++) {
+
+        int first, last;
+
+        /* Set row */
+        if (guac_common_surface_fill_row((uint32_t*) dst_buffer, rect->width,
+                    color, &first, &last)) {
+            if (first < min_x) min_x = first;
+            if (y < min_y) min_y = y;
+            if (last > max_x) max_x = last;
+            if (y > max_y) max_y = y;
+        }
+
+        /* Next row */
+        dst_buffer += dst_stride;
+
+    }
+
+    /* Restrict destination rect to only updated pixels */
+    if (max_x >= min_x && max_y >= min_y) {
+        rect->x += min_x;
+        rect->y += min_y;
+        rect->width = max_x - min_x + 1;
+        rect->height = max_y - min_y + 1;
+    }
+    else {
+        rect->width = 0;
+        rect->height = 0;
+    }
+
+}
+
 /**
  * Copies data from the given buffer to the surface at the given coordinates.
  * The dimensions and location of the destination rectangle will be altered
@@ -986,7 +2148,7 @@ static void __guac_common_surface_put(unsigned char* src_buffer, int src_stride,
     unsigned char* dst_buffer = dst->buffer;
     int dst_stride = dst->stride;
 
-    int x, y;
+    int y;
 
     int min_x = rect->width;
     int min_y = rect->height;
@@ -996,46 +2158,39 @@ static void __guac_common_surface_put(unsigned char* src_buffer, int src_stride,
     int orig_x = rect->x;
     int orig_y = rect->y;
 
+    /* Copy/blend rows with vector instructions where the CPU supports doing
+     * so */
+    pthread_once(&guac_common_surface_kernels_selected,
+            guac_common_surface_kernels_select);
+
     src_buffer += src_stride * (*sy) + 4 * (*sx);
     dst_buffer += (dst_stride * rect->y) + (4 * rect->x);
 
     /* For each row */
     for (y=0; y < rect->height; y++) {
 
-        uint32_t* src_current = (uint32_t*) src_buffer;
+        const uint32_t* src_current = (const uint32_t*) src_buffer;
         uint32_t* dst_current = (uint32_t*) dst_buffer;
 
-        /* Copy row */
-        for (x=0; x < rect->width; x++) {
-
-            uint32_t color;
-
-            /* Get source and destination color values */
-            uint32_t src_color = *src_current;
-            uint32_t dst_color = *dst_current;
-
-            /* Ignore alpha channel if opaque */
-            if (opaque)
-                color = src_color | 0xFF000000;
-
-            /* Otherwise, perform alpha blending operation */
-            else
-                color = guac_common_surface_argb_blend(dst_color, src_color);
-
-            /* If the destination color is changing, update rectangle bounds
-             * and store the new color */
-            if (dst_color != color) {
-                if (x < min_x) min_x = x;
-                if (y < min_y) min_y = y;
-                if (x > max_x) max_x = x;
-                if (y > max_y) max_y = y;
-                *dst_current = color;
-            }
+        int first, last;
+        int changed;
 
-            /* Advance to next pixel */
-            src_current++;
-            dst_current++;
+        /* Ignore alpha channel if opaque */
+        if (opaque)
+            changed = guac_common_surface_copy_row(src_current, dst_current,
+                    rect->width, 0xFF000000, 0x00000000, &first, &last);
 
+        /* Otherwise, perform alpha blending operation */
+        else
+            changed = guac_common_surface_blend_row(src_current, dst_current,
+                    rect->width, &first, &last);
+
+        /* If any destination colors changed, update rectangle bounds */
+        if (changed) {
+            if (first < min_x) min_x = first;
+            if (y < min_y) min_y = y;
+            if (last > max_x) max_x = last;
+            if (y > max_y) max_y = y;
         }
 
         /* Next row */
@@ -1147,6 +2302,10 @@ static void __guac_common_surface_transfer(guac_common_surface* src, int* sx, in
     int orig_x = rect->x;
     int orig_y = rect->y;
 
+    /* Copy rows with vector instructions where the CPU supports doing so */
+    pthread_once(&guac_common_surface_kernels_selected,
+            guac_common_surface_kernels_select);
+
     /* Copy forwards only if destination is in a different surface or is before source */
     if (src != dst || rect->y < *sy || (rect->y == *sy && rect->x < *sx)) {
         src_buffer += src->stride * (*sy) + 4 * (*sx);
@@ -1171,18 +2330,42 @@ static void __guac_common_surface_transfer(guac_common_surface* src, int* sx, in
         uint32_t* src_current = (uint32_t*) src_buffer;
         uint32_t* dst_current = (uint32_t*) dst_buffer;
 
-        /* Transfer each pixel in row */
-        for (x=0; x < rect->width; x++) {
+        /* Simple copies (and inverted copies) moving forwards through memory
+         * can be handled with a whole-row kernel */
+        if (step == 1 && (op == GUAC_TRANSFER_BINARY_SRC
+                    || op == GUAC_TRANSFER_BINARY_NSRC)) {
 
-            if (__guac_common_surface_transfer_int(op, src_current, dst_current)) {
-                if (x < min_x) min_x = x;
+            uint32_t xor_mask = (op == GUAC_TRANSFER_BINARY_NSRC)
+                ? 0x00FFFFFF : 0x00000000;
+
+            int first, last;
+            if (guac_common_surface_copy_row(src_current, dst_current,
+                        rect->width, 0x00000000, xor_mask, &first, &last)) {
+                if (first < min_x) min_x = first;
                 if (y < min_y) min_y = y;
-                if (x > max_x) max_x = x;
+                if (last > max_x) max_x = last;
                 if (y > max_y) max_y = y;
             }
 
-            src_current += step;
-            dst_current += step;
+        }
+
+        /* Transfer each pixel in row individually for all other transfer
+         * functions */
+        else {
+
+            for (x=0; x < rect->width; x++) {
+
+                if (__guac_common_surface_transfer_int(op, src_current, dst_current)) {
+                    if (x < min_x) min_x = x;
+                    if (y < min_y) min_y = y;
+                    if (x > max_x) max_x = x;
+                    if (y > max_y) max_y = y;
+                }
+
+                src_current += step;
+                dst_current += step;
+            }
+
         }
 
         /* Next row */
@@ -1246,6 +2429,11 @@ guac_common_surface* guac_common_surface_alloc(guac_client* client,
     surface->stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, w);
     surface->buffer = guac_mem_zalloc(h, surface->stride);
 
+    /* Request huge page backing for the surface, if enabled (large surfaces
+     * are long-lived and benefit from reduced TLB pressure) */
+    guac_mem_advise_huge_pages(surface->buffer,
+            guac_mem_ckd_mul_or_die(h, surface->stride));
+
     /* Create corresponding heat map */
     surface->heat_map = guac_mem_zalloc(heat_width, heat_height,
             sizeof(guac_common_surface_heat_cell));
@@ -1312,6 +2500,8 @@ void guac_common_surface_resize(guac_common_surface* surface, int w, int h) {
     surface->height = h;
     surface->stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, w);
     surface->buffer = guac_mem_zalloc(h, surface->stride);
+    guac_mem_advise_huge_pages(surface->buffer,
+            guac_mem_ckd_mul_or_die(h, surface->stride));
     __guac_common_bound_rect(surface, &surface->clip_rect, NULL, NULL);
 
     /* Copy relevant old data */
@@ -1368,16 +2558,55 @@ void guac_common_surface_draw(guac_common_surface* surface, int x, int y, cairo_
     if (rect.width <= 0 || rect.height <= 0)
         goto complete;
 
+    /* Invalidate cached compressibility of updated area */
+    __guac_common_surface_invalidate_optimality(surface, &rect);
+
     /* Update the heat map for the update rectangle. */
     guac_timestamp time = guac_timestamp_current();
     __guac_common_surface_touch_rect(surface, &rect, time);
 
-    /* Flush if not combining */
-    if (!__guac_common_should_combine(surface, &rect, 0))
-        __guac_common_surface_flush_deferred(surface);
+    /* Always defer draws, tracking the update within the dirty region */
+    __guac_common_surface_defer_draw(surface, &rect);
+
+complete:
+    pthread_mutex_unlock(&surface->_lock);
+
+}
+
+void guac_common_surface_draw_local(guac_common_surface* surface, int x, int y,
+        cairo_surface_t* src) {
+
+    pthread_mutex_lock(&surface->_lock);
+
+    unsigned char* buffer = cairo_image_surface_get_data(src);
+    cairo_format_t format = cairo_image_surface_get_format(src);
+    int stride = cairo_image_surface_get_stride(src);
+    int w = cairo_image_surface_get_width(src);
+    int h = cairo_image_surface_get_height(src);
+
+    int sx = 0;
+    int sy = 0;
+
+    guac_common_rect rect;
+    guac_common_rect_init(&rect, x, y, w, h);
+
+    /* Clip operation */
+    __guac_common_clip_rect(surface, &rect, &sx, &sy);
+    if (rect.width <= 0 || rect.height <= 0)
+        goto complete;
+
+    /* Update backing surface */
+    __guac_common_surface_put(buffer, stride, &sx, &sy, surface, &rect, format != CAIRO_FORMAT_ARGB32);
+    if (rect.width <= 0 || rect.height <= 0)
+        goto complete;
+
+    /* Invalidate cached compressibility of updated area (the contents have
+     * changed even though no update will be sent for this draw) */
+    __guac_common_surface_invalidate_optimality(surface, &rect);
 
-    /* Always defer draws */
-    __guac_common_mark_dirty(surface, &rect);
+    /* Unlike guac_common_surface_draw(), the update is NOT tracked within
+     * the dirty region, as the drawn content has already been conveyed to
+     * all connected clients by the caller */
 
 complete:
     pthread_mutex_unlock(&surface->_lock);
@@ -1408,12 +2637,11 @@ void guac_common_surface_paint(guac_common_surface* surface, int x, int y,
     /* Update backing surface */
     __guac_common_surface_fill_mask(buffer, stride, sx, sy, surface, &rect, red, green, blue);
 
-    /* Flush if not combining */
-    if (!__guac_common_should_combine(surface, &rect, 0))
-        __guac_common_surface_flush_deferred(surface);
+    /* Invalidate cached compressibility of updated area */
+    __guac_common_surface_invalidate_optimality(surface, &rect);
 
-    /* Always defer draws */
-    __guac_common_mark_dirty(surface, &rect);
+    /* Always defer draws, tracking the update within the dirty region */
+    __guac_common_surface_defer_draw(surface, &rect);
 
 complete:
     pthread_mutex_unlock(&surface->_lock);
@@ -1458,14 +2686,16 @@ void guac_common_surface_copy(guac_common_surface* src, int sx, int sy,
                 GUAC_TRANSFER_BINARY_SRC, dst, &drect);
         if (drect.width <= 0 || drect.height <= 0)
             goto complete;
+        __guac_common_surface_invalidate_optimality(dst, &drect);
     }
 
     /* Defer if combining */
     if (__guac_common_should_combine(dst, &drect, 1))
         __guac_common_mark_dirty(dst, &drect);
 
-    /* Otherwise, flush and draw immediately */
-    else {
+    /* Otherwise, flush and draw immediately, unless the update can be
+     * cheaply merged into an already-queued update */
+    else if (!__guac_common_merge_queued_rect(dst, &drect)) {
         __guac_common_surface_flush(dst);
         __guac_common_surface_flush(src);
         guac_protocol_send_copy(socket, src_layer, srect.x, srect.y,
@@ -1475,9 +2705,11 @@ void guac_common_surface_copy(guac_common_surface* src, int sx, int sy,
     }
 
     /* Update backing surface last if drect can intersect srect */
-    if (src == dst)
+    if (src == dst) {
         __guac_common_surface_transfer(src, &srect.x, &srect.y,
                 GUAC_TRANSFER_BINARY_SRC, dst, &drect);
+        __guac_common_surface_invalidate_optimality(dst, &drect);
+    }
 
 complete:
 
@@ -1525,14 +2757,16 @@ void guac_common_surface_transfer(guac_common_surface* src, int sx, int sy, int
         __guac_common_surface_transfer(src, &srect.x, &srect.y, op, dst, &drect);
         if (drect.width <= 0 || drect.height <= 0)
             goto complete;
+        __guac_common_surface_invalidate_optimality(dst, &drect);
     }
 
     /* Defer if combining */
     if (__guac_common_should_combine(dst, &drect, 1))
         __guac_common_mark_dirty(dst, &drect);
 
-    /* Otherwise, flush and draw immediately */
-    else {
+    /* Otherwise, flush and draw immediately, unless the update can be
+     * cheaply merged into an already-queued update */
+    else if (!__guac_common_merge_queued_rect(dst, &drect)) {
         __guac_common_surface_flush(dst);
         __guac_common_surface_flush(src);
         guac_protocol_send_transfer(socket, src_layer, srect.x, srect.y,
@@ -1541,8 +2775,10 @@ void guac_common_surface_transfer(guac_common_surface* src, int sx, int sy, int
     }
 
     /* Update backing surface last if drect can intersect srect */
-    if (src == dst)
+    if (src == dst) {
         __guac_common_surface_transfer(src, &srect.x, &srect.y, op, dst, &drect);
+        __guac_common_surface_invalidate_optimality(dst, &drect);
+    }
 
 complete:
 
@@ -1574,15 +2810,14 @@ void guac_common_surface_set(guac_common_surface* surface,
     if (rect.width <= 0 || rect.height <= 0)
         goto complete;
 
+    /* Invalidate cached compressibility of updated area */
+    __guac_common_surface_invalidate_optimality(surface, &rect);
+
     /* Handle as normal draw if non-opaque */
     if (alpha != 0xFF) {
 
-        /* Flush if not combining */
-        if (!__guac_common_should_combine(surface, &rect, 0))
-            __guac_common_surface_flush_deferred(surface);
-
-        /* Always defer draws */
-        __guac_common_mark_dirty(surface, &rect);
+        /* Always defer draws, tracking the update within the dirty region */
+        __guac_common_surface_defer_draw(surface, &rect);
 
     }
 
@@ -1590,8 +2825,9 @@ void guac_common_surface_set(guac_common_surface* surface,
     else if (__guac_common_should_combine(surface, &rect, 1))
         __guac_common_mark_dirty(surface, &rect);
 
-    /* Otherwise, flush and draw immediately */
-    else {
+    /* Otherwise, flush and draw immediately, unless the update can be
+     * cheaply merged into an already-queued update */
+    else if (!__guac_common_merge_queued_rect(surface, &rect)) {
         __guac_common_surface_flush(surface);
         guac_protocol_send_rect(socket, layer, rect.x, rect.y, rect.width, rect.height);
         guac_protocol_send_cfill(socket, GUAC_COMP_OVER, layer, red, green, blue, alpha);
@@ -1629,65 +2865,61 @@ void guac_common_surface_reset_clip(guac_common_surface* surface) {
 }
 
 /**
- * Flushes the bitmap update currently described by the dirty rectangle within
- * the given surface directly via an "img" instruction as PNG data. The
- * resulting instructions will be sent over the socket associated with the
- * given surface.
+ * Flushes the bitmap update described by the given dirty rectangle within the
+ * given surface directly via an "img" instruction as PNG data. The resulting
+ * instructions will be sent over the given socket.
  *
  * @param surface
  *     The surface to flush.
  *
+ * @param dirty_rect
+ *     The rectangle of the surface to flush.
+ *
+ * @param socket
+ *     The socket over which the resulting instructions should be sent.
+ *
  * @param opaque
  *     Whether the rectangle being flushed contains only fully-opaque pixels.
  */
 static void __guac_common_surface_flush_to_png(guac_common_surface* surface,
-        int opaque) {
-
-    if (surface->dirty) {
-
-        guac_socket* socket = surface->socket;
-        const guac_layer* layer = surface->layer;
+        const guac_common_rect* dirty_rect, guac_socket* socket, int opaque) {
 
-        /* Get Cairo surface for specified rect */
-        unsigned char* buffer = surface->buffer
-                              + surface->dirty_rect.y * surface->stride
-                              + surface->dirty_rect.x * 4;
-
-        cairo_surface_t* rect;
+    const guac_layer* layer = surface->layer;
 
-        /* Use RGB24 if the image is fully opaque */
-        if (opaque)
-            rect = cairo_image_surface_create_for_data(buffer,
-                    CAIRO_FORMAT_RGB24, surface->dirty_rect.width,
-                    surface->dirty_rect.height, surface->stride);
+    /* Get Cairo surface for specified rect */
+    unsigned char* buffer = surface->buffer
+                          + dirty_rect->y * surface->stride
+                          + dirty_rect->x * 4;
 
-        /* Otherwise ARGB32 is needed */
-        else {
+    cairo_surface_t* rect;
 
-            rect = cairo_image_surface_create_for_data(buffer,
-                    CAIRO_FORMAT_ARGB32, surface->dirty_rect.width,
-                    surface->dirty_rect.height, surface->stride);
+    /* Use RGB24 if the image is fully opaque */
+    if (opaque)
+        rect = cairo_image_surface_create_for_data(buffer,
+                CAIRO_FORMAT_RGB24, dirty_rect->width,
+                dirty_rect->height, surface->stride);
 
-            /* Clear destination rect first */
-            guac_protocol_send_rect(socket, layer,
-                    surface->dirty_rect.x, surface->dirty_rect.y,
-                    surface->dirty_rect.width, surface->dirty_rect.height);
-            guac_protocol_send_cfill(socket, GUAC_COMP_ROUT, layer,
-                    0x00, 0x00, 0x00, 0xFF);
+    /* Otherwise ARGB32 is needed */
+    else {
 
-        }
+        rect = cairo_image_surface_create_for_data(buffer,
+                CAIRO_FORMAT_ARGB32, dirty_rect->width,
+                dirty_rect->height, surface->stride);
 
-        /* Send PNG for rect */
-        guac_client_stream_png(surface->client, socket, GUAC_COMP_OVER,
-                layer, surface->dirty_rect.x, surface->dirty_rect.y, rect);
+        /* Clear destination rect first */
+        guac_protocol_send_rect(socket, layer,
+                dirty_rect->x, dirty_rect->y,
+                dirty_rect->width, dirty_rect->height);
+        guac_protocol_send_cfill(socket, GUAC_COMP_ROUT, layer,
+                0x00, 0x00, 0x00, 0xFF);
 
-        cairo_surface_destroy(rect);
-        surface->realized = 1;
+    }
 
-        /* Surface is no longer dirty */
-        surface->dirty = 0;
+    /* Send PNG for rect */
+    guac_client_stream_png(surface->client, socket, GUAC_COMP_OVER,
+            layer, dirty_rect->x, dirty_rect->y, rect);
 
-    }
+    cairo_surface_destroy(rect);
 
 }
 
@@ -1722,111 +2954,537 @@ static int guac_common_surface_suggest_quality(guac_client* client) {
 }
 
 /**
- * Flushes the bitmap update currently described by the dirty rectangle within
- * the given surface directly via an "img" instruction as JPEG data. The
- * resulting instructions will be sent over the socket associated with the
- * given surface.
+ * Flushes the bitmap update described by the given dirty rectangle within the
+ * given surface directly via an "img" instruction as JPEG data. The resulting
+ * instructions will be sent over the given socket.
  *
  * @param surface
  *     The surface to flush.
+ *
+ * @param dirty_rect
+ *     The rectangle of the surface to flush.
+ *
+ * @param socket
+ *     The socket over which the resulting instructions should be sent.
  */
-static void __guac_common_surface_flush_to_jpeg(guac_common_surface* surface) {
-
-    if (surface->dirty) {
-
-        guac_socket* socket = surface->socket;
-        const guac_layer* layer = surface->layer;
+static void __guac_common_surface_flush_to_jpeg(guac_common_surface* surface,
+        const guac_common_rect* dirty_rect, guac_socket* socket) {
 
-        guac_common_rect max;
-        guac_common_rect_init(&max, 0, 0, surface->width, surface->height);
-
-        /* Expand the dirty rect size to fit in a grid with cells equal to the
-         * minimum JPEG block size */
-        guac_common_rect_expand_to_grid(GUAC_SURFACE_JPEG_BLOCK_SIZE,
-                                        &surface->dirty_rect, &max);
+    const guac_layer* layer = surface->layer;
 
-        /* Get Cairo surface for specified rect */
-        unsigned char* buffer = surface->buffer
-                              + surface->dirty_rect.y * surface->stride
-                              + surface->dirty_rect.x * 4;
+    guac_common_rect max;
+    guac_common_rect_init(&max, 0, 0, surface->width, surface->height);
 
-        cairo_surface_t* rect = cairo_image_surface_create_for_data(buffer,
-                CAIRO_FORMAT_RGB24, surface->dirty_rect.width,
-                surface->dirty_rect.height, surface->stride);
+    /* Expand the dirty rect size to fit in a grid with cells equal to the
+     * minimum JPEG block size */
+    guac_common_rect expanded_rect = *dirty_rect;
+    guac_common_rect_expand_to_grid(GUAC_SURFACE_JPEG_BLOCK_SIZE,
+                                    &expanded_rect, &max);
 
-        /* Send JPEG for rect */
-        guac_client_stream_jpeg(surface->client, socket, GUAC_COMP_OVER, layer,
-                surface->dirty_rect.x, surface->dirty_rect.y, rect,
-                guac_common_surface_suggest_quality(surface->client));
+    /* Get Cairo surface for specified rect */
+    unsigned char* buffer = surface->buffer
+                          + expanded_rect.y * surface->stride
+                          + expanded_rect.x * 4;
 
-        cairo_surface_destroy(rect);
-        surface->realized = 1;
+    cairo_surface_t* rect = cairo_image_surface_create_for_data(buffer,
+            CAIRO_FORMAT_RGB24, expanded_rect.width,
+            expanded_rect.height, surface->stride);
 
-        /* Surface is no longer dirty */
-        surface->dirty = 0;
+    /* Send JPEG for rect */
+    guac_client_stream_jpeg(surface->client, socket, GUAC_COMP_OVER, layer,
+            expanded_rect.x, expanded_rect.y, rect,
+            guac_common_surface_suggest_quality(surface->client));
 
-    }
+    cairo_surface_destroy(rect);
 
 }
 
 /**
- * Flushes the bitmap update currently described by the dirty rectangle within
- * the given surface directly via an "img" instruction as WebP data. The
- * resulting instructions will be sent over the socket associated with the
- * given surface.
+ * Flushes the bitmap update described by the given dirty rectangle within the
+ * given surface directly via an "img" instruction as WebP data. The resulting
+ * instructions will be sent over the given socket.
  *
  * @param surface
  *     The surface to flush.
  *
+ * @param dirty_rect
+ *     The rectangle of the surface to flush.
+ *
+ * @param socket
+ *     The socket over which the resulting instructions should be sent.
+ *
  * @param opaque
  *     Whether the rectangle being flushed contains only fully-opaque pixels.
  */
 static void __guac_common_surface_flush_to_webp(guac_common_surface* surface,
-        int opaque) {
+        const guac_common_rect* dirty_rect, guac_socket* socket, int opaque) {
 
-    if (surface->dirty) {
+    const guac_layer* layer = surface->layer;
 
-        guac_socket* socket = surface->socket;
-        const guac_layer* layer = surface->layer;
+    guac_common_rect max;
+    guac_common_rect_init(&max, 0, 0, surface->width, surface->height);
 
-        guac_common_rect max;
-        guac_common_rect_init(&max, 0, 0, surface->width, surface->height);
+    /* Expand the dirty rect size to fit in a grid with cells equal to the
+     * minimum WebP block size */
+    guac_common_rect expanded_rect = *dirty_rect;
+    guac_common_rect_expand_to_grid(GUAC_SURFACE_WEBP_BLOCK_SIZE,
+                                    &expanded_rect, &max);
 
-        /* Expand the dirty rect size to fit in a grid with cells equal to the
-         * minimum WebP block size */
-        guac_common_rect_expand_to_grid(GUAC_SURFACE_WEBP_BLOCK_SIZE,
-                                        &surface->dirty_rect, &max);
+    /* Get Cairo surface for specified rect */
+    unsigned char* buffer = surface->buffer
+                          + expanded_rect.y * surface->stride
+                          + expanded_rect.x * 4;
 
-        /* Get Cairo surface for specified rect */
-        unsigned char* buffer = surface->buffer
-                              + surface->dirty_rect.y * surface->stride
-                              + surface->dirty_rect.x * 4;
+    cairo_surface_t* rect;
 
-        cairo_surface_t* rect;
+    /* Use RGB24 if the image is fully opaque */
+    if (opaque)
+        rect = cairo_image_surface_create_for_data(buffer,
+                CAIRO_FORMAT_RGB24, expanded_rect.width,
+                expanded_rect.height, surface->stride);
 
-        /* Use RGB24 if the image is fully opaque */
-        if (opaque)
-            rect = cairo_image_surface_create_for_data(buffer,
-                    CAIRO_FORMAT_RGB24, surface->dirty_rect.width,
-                    surface->dirty_rect.height, surface->stride);
+    /* Otherwise ARGB32 is needed */
+    else
+        rect = cairo_image_surface_create_for_data(buffer,
+                CAIRO_FORMAT_ARGB32, expanded_rect.width,
+                expanded_rect.height, surface->stride);
 
-        /* Otherwise ARGB32 is needed */
-        else
-            rect = cairo_image_surface_create_for_data(buffer,
-                    CAIRO_FORMAT_ARGB32, surface->dirty_rect.width,
-                    surface->dirty_rect.height, surface->stride);
+    /* Send WebP for rect */
+    guac_client_stream_webp(surface->client, socket, GUAC_COMP_OVER, layer,
+            expanded_rect.x, expanded_rect.y, rect,
+            guac_common_surface_suggest_quality(surface->client),
+            surface->lossless ? 1 : 0);
 
-        /* Send WebP for rect */
-        guac_client_stream_webp(surface->client, socket, GUAC_COMP_OVER, layer,
-                surface->dirty_rect.x, surface->dirty_rect.y, rect,
-                guac_common_surface_suggest_quality(surface->client),
-                surface->lossless ? 1 : 0);
+    cairo_surface_destroy(rect);
 
-        cairo_surface_destroy(rect);
-        surface->realized = 1;
+}
+
+/**
+ * A single bitmap update to be encoded during a flush, along with the buffer
+ * which captures the encoded output when the update is encoded by a worker
+ * thread.
+ */
+typedef struct guac_common_surface_encode_task {
+
+    /**
+     * The surface being flushed.
+     */
+    guac_common_surface* surface;
+
+    /**
+     * The rectangle of the surface to encode.
+     */
+    guac_common_rect rect;
+
+    /**
+     * Whether the rectangle contains only fully-opaque pixels.
+     */
+    int opaque;
+
+    /**
+     * Whether the rectangle should be encoded as WebP data.
+     */
+    int use_webp;
+
+    /**
+     * Whether the rectangle should be encoded as JPEG data. Ignored if WebP
+     * is to be used.
+     */
+    int use_jpeg;
+
+    /**
+     * The buffer containing all instructions produced while encoding the
+     * rectangle, or NULL if the update was written directly to the surface
+     * socket.
+     */
+    char* buffer;
+
+    /**
+     * The number of bytes within buffer.
+     */
+    size_t length;
+
+    /**
+     * The number of bytes allocated for buffer.
+     */
+    size_t capacity;
+
+} guac_common_surface_encode_task;
+
+/**
+ * Socket write handler which appends all written data to the buffer of the
+ * guac_common_surface_encode_task associated with the given socket, growing
+ * that buffer as necessary.
+ *
+ * @param socket
+ *     The socket being written to.
+ *
+ * @param buf
+ *     The data being written.
+ *
+ * @param count
+ *     The number of bytes being written.
+ *
+ * @return
+ *     The number of bytes written, which is always the full requested count.
+ */
+static ssize_t __guac_common_surface_buffer_write_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    guac_common_surface_encode_task* task =
+        (guac_common_surface_encode_task*) socket->data;
+
+    /* Grow buffer to fit written data, if necessary */
+    size_t required = guac_mem_ckd_add_or_die(task->length, count);
+    if (required > task->capacity) {
+
+        size_t capacity = task->capacity;
+        if (capacity == 0)
+            capacity = GUAC_COMMON_SURFACE_ENCODE_BUFFER_SIZE;
+
+        while (capacity < required)
+            capacity = guac_mem_ckd_mul_or_die(capacity, 2);
+
+        task->buffer = guac_mem_realloc_or_die(task->buffer, capacity);
+        task->capacity = capacity;
+
+    }
+
+    /* Append written data */
+    memcpy(task->buffer + task->length, buf, count);
+    task->length = required;
+
+    return count;
+
+}
+
+/**
+ * Encodes the bitmap update described by the given task, sending the
+ * resulting instructions over the given socket using the image format
+ * already chosen for the task.
+ *
+ * @param task
+ *     The task describing the update to encode.
+ *
+ * @param socket
+ *     The socket over which the resulting instructions should be sent.
+ */
+static void __guac_common_surface_encode_rect(
+        guac_common_surface_encode_task* task, guac_socket* socket) {
+
+    /* Prefer WebP when reasonable */
+    if (task->use_webp)
+        __guac_common_surface_flush_to_webp(task->surface, &task->rect,
+                socket, task->opaque);
+
+    /* If not WebP, JPEG is the next best (lossy) choice */
+    else if (task->use_jpeg)
+        __guac_common_surface_flush_to_jpeg(task->surface, &task->rect,
+                socket);
+
+    /* Use PNG if no lossy formats are appropriate */
+    else
+        __guac_common_surface_flush_to_png(task->surface, &task->rect,
+                socket, task->opaque);
+
+}
+
+/**
+ * Encodes the bitmap update described by the given task, capturing the
+ * resulting instructions within the task's buffer rather than writing them
+ * to the surface socket. The captured instructions must later be written to
+ * the surface socket in queue order.
+ *
+ * @param task
+ *     The task describing the update to encode.
+ */
+static void __guac_common_surface_encode_task_run(
+        guac_common_surface_encode_task* task) {
+
+    /* Capture all encoded output within the task buffer */
+    guac_socket* socket = guac_socket_alloc();
+    if (socket == NULL)
+        return;
+
+    socket->write_handler = __guac_common_surface_buffer_write_handler;
+    socket->data = task;
+
+    __guac_common_surface_encode_rect(task, socket);
+
+    guac_socket_free(socket);
+
+}
+
+/**
+ * The pool of worker threads shared by all surfaces for encoding queued
+ * bitmap updates in parallel. Only one batch of tasks may be processed by
+ * the pool at any given time.
+ */
+typedef struct guac_common_surface_worker_pool {
+
+    /**
+     * Lock which protects all members of this pool.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Condition which is signalled when a batch of tasks has been posted to
+     * the pool.
+     */
+    pthread_cond_t posted;
+
+    /**
+     * Condition which is signalled when all tasks within the current batch
+     * have completed.
+     */
+    pthread_cond_t complete;
+
+    /**
+     * The batch of tasks currently being processed, or NULL if no batch is
+     * being processed.
+     */
+    guac_common_surface_encode_task* tasks;
+
+    /**
+     * The number of tasks within the current batch.
+     */
+    int task_count;
+
+    /**
+     * The index of the next task to be claimed by a worker.
+     */
+    int next_task;
+
+    /**
+     * The number of tasks within the current batch that have not yet
+     * completed.
+     */
+    int remaining;
+
+    /**
+     * The number of worker threads successfully created, or zero if parallel
+     * encoding is unavailable.
+     */
+    int worker_count;
+
+} guac_common_surface_worker_pool;
+
+/**
+ * The single, shared worker pool. Worker threads are created on first use by
+ * __guac_common_surface_create_workers().
+ */
+static guac_common_surface_worker_pool __guac_common_surface_workers = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .posted = PTHREAD_COND_INITIALIZER,
+    .complete = PTHREAD_COND_INITIALIZER
+};
+
+/**
+ * Pthread initialization routine which creates the shared worker pool.
+ * Invoked via pthread_once().
+ */
+static pthread_once_t __guac_common_surface_workers_created =
+    PTHREAD_ONCE_INIT;
+
+/**
+ * Returns the number of processors available to this process. If possible,
+ * limits on otherwise available processors like CPU affinity will be taken
+ * into account. If the number of available processors cannot be determined,
+ * zero is returned.
+ *
+ * @return
+ *     The number of available processors, or zero if this value cannot be
+ *     determined for any reason.
+ */
+static unsigned long __guac_common_surface_nproc() {
+
+#if defined(HAVE_SCHED_GETAFFINITY)
+
+    /* Linux, etc. implementation leveraging sched_getaffinity() (this is
+     * specific to glibc and MUSL libc and is non-portable) */
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+
+    if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0) {
+        long cpu_count = CPU_COUNT(&cpu_set);
+        if (cpu_count > 0)
+            return cpu_count;
+    }
+
+#elif defined(_SC_NPROCESSORS_ONLN)
+
+    /* Linux, etc. implementation leveraging sysconf() and _SC_NPROCESSORS_ONLN
+     * (which is also non-portable) */
+
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpu_count > 0)
+        return cpu_count;
+
+#endif
+
+    return 0;
+
+}
+
+/**
+ * The main loop of each encoding worker thread. Each worker repeatedly
+ * claims the next unclaimed task of the current batch, encoding the update
+ * described by that task into the task's buffer.
+ *
+ * @param data
+ *     Unused.
+ *
+ * @return
+ *     Always NULL (workers run for the lifetime of the process).
+ */
+static void* __guac_common_surface_worker_thread(void* data) {
+
+    guac_common_surface_worker_pool* pool = &__guac_common_surface_workers;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+
+        /* Wait for a task to be available */
+        while (pool->tasks == NULL || pool->next_task >= pool->task_count)
+            pthread_cond_wait(&pool->posted, &pool->lock);
+
+        /* Claim and run the next task */
+        guac_common_surface_encode_task* task =
+            &pool->tasks[pool->next_task++];
+
+        pthread_mutex_unlock(&pool->lock);
+        __guac_common_surface_encode_task_run(task);
+        pthread_mutex_lock(&pool->lock);
+
+        /* Notify the flushing thread once the batch is complete */
+        if (--pool->remaining == 0)
+            pthread_cond_signal(&pool->complete);
+
+    }
+
+    return NULL;
+
+}
+
+/**
+ * Creates the worker threads of the shared worker pool, with the number of
+ * workers depending on the number of available processors. No workers are
+ * created (and parallel encoding is left disabled) if only one processor is
+ * available. Invoked via pthread_once().
+ */
+static void __guac_common_surface_create_workers(void) {
+
+    guac_common_surface_worker_pool* pool = &__guac_common_surface_workers;
+
+    /* Determine number of workers to create, leaving parallel encoding
+     * disabled if there's no benefit to be had (or if the number of
+     * processors cannot be determined) */
+    unsigned long cpu_count = __guac_common_surface_nproc();
+    if (cpu_count < 2)
+        return;
+
+    int worker_count = GUAC_COMMON_SURFACE_MAX_WORKERS;
+    if (cpu_count < (unsigned long) worker_count)
+        worker_count = (int) cpu_count;
+
+    /* Create workers, which run detached for the lifetime of the process */
+    int i;
+    for (i = 0; i < worker_count; i++) {
+
+        pthread_t worker;
+        if (pthread_create(&worker, NULL,
+                    __guac_common_surface_worker_thread, NULL))
+            break;
+
+        pthread_detach(worker);
+        pool->worker_count++;
+
+    }
+
+}
+
+/**
+ * Encodes and sends all updates within the given batch of tasks. If worker
+ * threads are available and the batch contains multiple updates, the updates
+ * are encoded concurrently and their captured output is written to the
+ * surface socket in queue order. Updates are otherwise encoded serially,
+ * writing directly to the surface socket.
+ *
+ * @param surface
+ *     The surface being flushed.
+ *
+ * @param tasks
+ *     The batch of tasks to encode and send.
+ *
+ * @param task_count
+ *     The number of tasks within the batch.
+ */
+static void __guac_common_surface_flush_tasks(guac_common_surface* surface,
+        guac_common_surface_encode_task* tasks, int task_count) {
+
+    guac_common_surface_worker_pool* pool = &__guac_common_surface_workers;
+    int i;
+
+    pthread_once(&__guac_common_surface_workers_created,
+            __guac_common_surface_create_workers);
+
+    /* Encode serially if the batch is too small to benefit from the worker
+     * pool (or if no workers could be created) */
+    if (pool->worker_count == 0 || task_count < 2) {
+        for (i = 0; i < task_count; i++)
+            __guac_common_surface_encode_rect(&tasks[i], surface->socket);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+
+    /* Wait for the pool to be free (another surface may be flushing) */
+    while (pool->tasks != NULL)
+        pthread_cond_wait(&pool->complete, &pool->lock);
+
+    /* Post batch to pool */
+    pool->tasks = tasks;
+    pool->task_count = task_count;
+    pool->next_task = 0;
+    pool->remaining = task_count;
+    pthread_cond_broadcast(&pool->posted);
+
+    /* Contribute to encoding rather than sitting idle */
+    while (pool->next_task < pool->task_count) {
+
+        guac_common_surface_encode_task* task =
+            &pool->tasks[pool->next_task++];
 
-        /* Surface is no longer dirty */
-        surface->dirty = 0;
+        pthread_mutex_unlock(&pool->lock);
+        __guac_common_surface_encode_task_run(task);
+        pthread_mutex_lock(&pool->lock);
+
+        pool->remaining--;
+
+    }
+
+    /* Wait for any tasks still being encoded by workers */
+    while (pool->remaining > 0)
+        pthread_cond_wait(&pool->complete, &pool->lock);
+
+    /* Release pool, waking any flushing thread waiting for it */
+    pool->tasks = NULL;
+    pthread_cond_broadcast(&pool->complete);
+    pthread_mutex_unlock(&pool->lock);
+
+    /* Write captured output in queue order */
+    for (i = 0; i < task_count; i++) {
+
+        if (tasks[i].buffer != NULL) {
+
+            if (tasks[i].length > 0)
+                guac_socket_write(surface->socket, tasks[i].buffer,
+                        tasks[i].length);
+
+            guac_mem_free(tasks[i].buffer);
+
+        }
 
     }
 
@@ -1895,7 +3553,9 @@ static void __guac_common_surface_flush(guac_common_surface* surface) {
     guac_common_surface_bitmap_rect* current = surface->bitmap_queue;
     int i, j;
     int original_queue_length;
-    int flushed = 0;
+
+    guac_common_surface_encode_task tasks[GUAC_COMMON_SURFACE_QUEUE_SIZE];
+    int task_count = 0;
 
     original_queue_length = surface->bitmap_queue_length;
 
@@ -1940,27 +3600,32 @@ static void __guac_common_surface_flush(guac_common_surface* surface) {
                     && surface->bitmap_queue_length < GUAC_COMMON_SURFACE_QUEUE_SIZE)
                 __guac_common_surface_flush_to_queue(surface);
 
-            /* Flush as bitmap otherwise */
+            /* Queue for encoding otherwise */
             else if (surface->dirty) {
 
-                flushed++;
+                guac_common_surface_encode_task* task = &tasks[task_count++];
 
-                int opaque = __guac_common_surface_is_opaque(surface,
-                            &surface->dirty_rect);
+                task->surface = surface;
+                task->rect = surface->dirty_rect;
 
-                /* Prefer WebP when reasonable */
-                if (__guac_common_surface_should_use_webp(surface,
-                            &surface->dirty_rect))
-                    __guac_common_surface_flush_to_webp(surface, opaque);
+                /* Choose image format now, while the state informing that
+                 * choice (such as the refresh heat map) is settled */
+                task->opaque = __guac_common_surface_is_opaque(surface,
+                            &surface->dirty_rect);
+                task->use_webp = __guac_common_surface_should_use_webp(
+                            surface, &surface->dirty_rect);
+                task->use_jpeg = task->opaque
+                    && __guac_common_surface_should_use_jpeg(surface,
+                            &surface->dirty_rect);
 
-                /* If not WebP, JPEG is the next best (lossy) choice */
-                else if (opaque && __guac_common_surface_should_use_jpeg(
-                            surface, &surface->dirty_rect))
-                    __guac_common_surface_flush_to_jpeg(surface);
+                task->buffer = NULL;
+                task->length = 0;
+                task->capacity = 0;
 
-                /* Use PNG if no lossy formats are appropriate */
-                else
-                    __guac_common_surface_flush_to_png(surface, opaque);
+                /* Rect will be encoded and sent once all updates have been
+                 * collected */
+                surface->dirty = 0;
+                surface->realized = 1;
 
             }
 
@@ -1973,6 +3638,9 @@ static void __guac_common_surface_flush(guac_common_surface* surface) {
     /* Flush complete */
     surface->bitmap_queue_length = 0;
 
+    /* Encode and send all collected updates, in parallel if possible */
+    __guac_common_surface_flush_tasks(surface, tasks, task_count);
+
 }
 
 void guac_common_surface_flush(guac_common_surface* surface) {
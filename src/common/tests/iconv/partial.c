@@ -0,0 +1,135 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "common/iconv.h"
+#include "convert-test-data.h"
+
+#include <CUnit/CUnit.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Tests that converting the given input string in small, resumable chunks
+ * using guac_iconv_partial() produces exactly the same output as converting
+ * the entire string in one call to guac_iconv().
+ *
+ * @param reader
+ *     The guac_iconv_read implementation to use to read the input string.
+ *
+ * @param in_string
+ *     A pointer to the test_string structure describing the input string being
+ *     tested.
+ *
+ * @param writer
+ *     The guac_iconv_write implementation to use to write the output string
+ *     (the converted input string).
+ */
+static void verify_chunked_conversion(
+        guac_iconv_read* reader, test_string* in_string,
+        guac_iconv_write* writer) {
+
+    char expected[4096];
+    char output[4096];
+    char input[4096];
+
+    /* Convert the entire string in a single call for reference */
+    const char* current_input = input;
+    char* current_output = expected;
+
+    memcpy(input, in_string->buffer, in_string->size);
+    int expected_result = guac_iconv(reader, &current_input, sizeof(input),
+            writer, &current_output, sizeof(expected));
+
+    int expected_length = current_output - expected;
+
+    /* Repeat the same conversion through a chunk buffer which is far too
+     * small to hold the full result */
+    char chunk[GUAC_ICONV_MAX_CHARACTER_BYTES * 2];
+
+    current_input = input;
+    current_output = output;
+
+    int result = 0;
+    while (!result && in_string->size - (current_input - input) > 0) {
+
+        char* current_chunk = chunk;
+        result = guac_iconv_partial(reader,
+                &current_input, in_string->size - (current_input - input),
+                writer, &current_chunk, sizeof(chunk));
+
+        /* Conversion must always make forward progress */
+        CU_ASSERT(current_chunk - chunk > 0);
+
+        memcpy(current_output, chunk, current_chunk - chunk);
+        current_output += current_chunk - chunk;
+
+    }
+
+    /* Verify chunked conversion reached the same terminator */
+    CU_ASSERT_EQUAL(expected_result, result);
+
+    /* Verify chunked output is identical to single-call output */
+    CU_ASSERT_EQUAL(expected_length, current_output - output);
+    CU_ASSERT_EQUAL(0, memcmp(output, expected, expected_length));
+
+}
+
+/**
+ * Test which verifies that guac_iconv_partial() can convert every supported
+ * encoding to every other supported encoding in small, resumable chunks,
+ * producing output identical to a single call to guac_iconv().
+ */
+void test_iconv__partial_resumable() {
+    for (int i = 0; i < NUM_SUPPORTED_ENCODINGS; i++) {
+        for (int j = 0; j < NUM_SUPPORTED_ENCODINGS; j++) {
+
+            encoding_test_parameters* from = &test_params[i];
+            encoding_test_parameters* to = &test_params[j];
+
+            printf("# \"%s\" -> \"%s\" ...\n", from->name, to->name);
+            verify_chunked_conversion(from->reader, &from->test_mixed,
+                    to->writer);
+            verify_chunked_conversion(from->reader_normalized,
+                    &from->test_mixed, to->writer_crlf);
+
+        }
+    }
+}
+
+/**
+ * Test which verifies that guac_iconv_partial() stops without consuming any
+ * input if the output buffer lacks the headroom required to guarantee that
+ * the next character will fit.
+ */
+void test_iconv__partial_headroom() {
+
+    char output[GUAC_ICONV_MAX_CHARACTER_BYTES];
+
+    const char* current_input = "test";
+    char* current_output = output;
+
+    int result = guac_iconv_partial(GUAC_READ_UTF8, &current_input, 5,
+            GUAC_WRITE_UTF8, &current_output,
+            GUAC_ICONV_MAX_CHARACTER_BYTES - 1);
+
+    CU_ASSERT_EQUAL(0, result);
+    CU_ASSERT_EQUAL(0, current_output - output);
+    CU_ASSERT_STRING_EQUAL("test", current_input);
+
+}
@@ -0,0 +1,494 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "admission.h"
+#include "conf.h"
+#include "log.h"
+#include "proc.h"
+#include "proc-map.h"
+
+#include <guacamole/mem.h>
+#include <guacamole/string.h>
+#include <guacamole/timestamp.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+/**
+ * The number of slots within the table used to track per-source connection
+ * rates. Sources are assigned slots by hashing their addresses, and distinct
+ * sources that hash to the same slot share that slot's rate window. As the
+ * rate limit exists to shed connection storms rather than to provide exact
+ * per-source accounting, occasionally sharing a window between sources is
+ * acceptable.
+ */
+#define GUACD_ADMISSION_SOURCE_SLOTS 64
+
+/**
+ * The duration of the window over which per-source connection rates are
+ * measured, in milliseconds.
+ */
+#define GUACD_ADMISSION_RATE_WINDOW 1000
+
+/**
+ * The interval at which the status file is rewritten if the admission state
+ * has changed, in milliseconds. Rewriting on a fixed interval rather than on
+ * every admission decision bounds the filesystem overhead of status reporting
+ * during connection storms, precisely when admission decisions are most
+ * frequent.
+ */
+#define GUACD_ADMISSION_STATUS_INTERVAL 1000
+
+/**
+ * The recent connection rate observed for a single source address (or set of
+ * source addresses sharing a slot within the tracking table).
+ */
+typedef struct guacd_admission_source {
+
+    /**
+     * The address family of the tracked source, or AF_UNSPEC if this slot is
+     * not yet in use.
+     */
+    sa_family_t family;
+
+    /**
+     * The raw bytes of the tracked source address (4 bytes for IPv4, 16 bytes
+     * for IPv6).
+     */
+    unsigned char addr[16];
+
+    /**
+     * The number of meaningful bytes within addr.
+     */
+    int addr_len;
+
+    /**
+     * The time that the current rate window began.
+     */
+    guac_timestamp window_start;
+
+    /**
+     * The number of connections admitted from this source within the current
+     * rate window.
+     */
+    int count;
+
+} guacd_admission_source;
+
+/**
+ * The current admission control state. All members are protected by lock; the
+ * configured limits are written during init and whenever the configuration is
+ * reloaded via guacd_admission_update_limits().
+ */
+static struct {
+
+    /**
+     * Lock protecting all mutable admission state.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * The map of connection processes, consulted only to report the number of
+     * active connections within the status file.
+     */
+    guacd_proc_map* map;
+
+    /**
+     * The maximum number of connection handshakes that may be in progress at
+     * any given time, or zero if no limit should be enforced.
+     */
+    int max_concurrent_handshakes;
+
+    /**
+     * The maximum number of connections that may be admitted from any single
+     * source address per second, or zero if no limit should be enforced.
+     */
+    int source_connection_rate;
+
+    /**
+     * The path of the file to which load metrics should be written, or NULL
+     * if no status file should be maintained.
+     */
+    char* status_file;
+
+    /**
+     * The path of the temporary file written and then renamed over
+     * status_file, such that readers always observe a complete file.
+     */
+    char* status_temp_file;
+
+    /**
+     * The number of connection handshakes currently in progress.
+     */
+    int active_handshakes;
+
+    /**
+     * The total number of connections admitted since guacd started.
+     */
+    unsigned long accepted_total;
+
+    /**
+     * The total number of connections rejected since guacd started because
+     * the limit on concurrent handshakes had been reached.
+     */
+    unsigned long rejected_busy_total;
+
+    /**
+     * The total number of connections rejected since guacd started because
+     * their source exceeded the per-source connection rate limit.
+     */
+    unsigned long rejected_rate_total;
+
+    /**
+     * Whether connections are currently being shed. Used to log the
+     * transitions into and out of overload once, rather than logging every
+     * rejected connection during a storm.
+     */
+    int shedding;
+
+    /**
+     * Whether the admission state has changed since the status file was last
+     * rewritten.
+     */
+    int dirty;
+
+    /**
+     * The table tracking recent per-source connection rates.
+     */
+    guacd_admission_source sources[GUACD_ADMISSION_SOURCE_SLOTS];
+
+} guacd_admission_state = {
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+/**
+ * Callback for guacd_proc_map_foreach() which counts the processes within the
+ * map.
+ *
+ * @param proc
+ *     The process being counted.
+ *
+ * @param data
+ *     A pointer to the int serving as the running count.
+ */
+static void guacd_admission_count_callback(guacd_proc* proc, void* data) {
+    (*((int*) data))++;
+}
+
+/**
+ * Atomically rewrites the status file with the current load metrics. The
+ * admission lock must be held by the caller, and a status file must have been
+ * configured.
+ */
+static void guacd_admission_write_status(void) {
+
+    /* Count active connection processes */
+    int active_connections = 0;
+    guacd_proc_map_foreach(guacd_admission_state.map,
+            guacd_admission_count_callback, &active_connections);
+
+    /* Write metrics to temporary file */
+    FILE* status = fopen(guacd_admission_state.status_temp_file, "w");
+    if (status == NULL) {
+        guacd_log(GUAC_LOG_WARNING, "Unable to write status file \"%s\"",
+                guacd_admission_state.status_file);
+        return;
+    }
+
+    /* Whether new connections are currently being accepted, for the sake of
+     * simple balancer health checks that only care about a single value */
+    int accepting = guacd_admission_state.max_concurrent_handshakes == 0
+        || guacd_admission_state.active_handshakes
+            < guacd_admission_state.max_concurrent_handshakes;
+
+    fprintf(status,
+            "guacd_accepting %i\n"
+            "guacd_active_connections %i\n"
+            "guacd_active_handshakes %i\n"
+            "guacd_connections_accepted_total %lu\n"
+            "guacd_connections_rejected_busy_total %lu\n"
+            "guacd_connections_rejected_rate_total %lu\n",
+            accepting,
+            active_connections,
+            guacd_admission_state.active_handshakes,
+            guacd_admission_state.accepted_total,
+            guacd_admission_state.rejected_busy_total,
+            guacd_admission_state.rejected_rate_total);
+
+    fclose(status);
+
+    /* Atomically replace the status file such that readers never observe a
+     * partially-written file */
+    if (rename(guacd_admission_state.status_temp_file,
+                guacd_admission_state.status_file))
+        guacd_log(GUAC_LOG_WARNING, "Unable to replace status file \"%s\"",
+                guacd_admission_state.status_file);
+
+}
+
+/**
+ * Thread which periodically rewrites the status file for as long as guacd
+ * runs, whenever the admission state has changed since the last rewrite.
+ *
+ * @param data
+ *     Unused.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guacd_admission_status_thread(void* data) {
+
+    for (;;) {
+
+        guac_timestamp_msleep(GUACD_ADMISSION_STATUS_INTERVAL);
+
+        pthread_mutex_lock(&guacd_admission_state.lock);
+        if (guacd_admission_state.dirty) {
+            guacd_admission_state.dirty = 0;
+            guacd_admission_write_status();
+        }
+        pthread_mutex_unlock(&guacd_admission_state.lock);
+
+    }
+
+    return NULL;
+
+}
+
+void guacd_admission_init(guacd_proc_map* map, guacd_config* config) {
+
+    pthread_mutex_lock(&guacd_admission_state.lock);
+
+    guacd_admission_state.map = map;
+    guacd_admission_state.max_concurrent_handshakes =
+        config->max_concurrent_handshakes;
+    guacd_admission_state.source_connection_rate =
+        config->source_connection_rate;
+
+    /* Precompute status file paths, if a status file is configured */
+    if (config->status_file != NULL) {
+
+        guacd_admission_state.status_file = guac_strdup(config->status_file);
+
+        size_t temp_length = strlen(config->status_file) + sizeof(".tmp");
+        guacd_admission_state.status_temp_file = guac_mem_alloc(temp_length);
+        snprintf(guacd_admission_state.status_temp_file, temp_length,
+                "%s.tmp", config->status_file);
+
+        /* Write initial status such that health checks succeed before the
+         * first connection arrives, then continue rewriting periodically as
+         * the admission state changes */
+        guacd_admission_write_status();
+
+        pthread_t status_thread;
+        pthread_create(&status_thread, NULL,
+                guacd_admission_status_thread, NULL);
+        pthread_detach(status_thread);
+
+    }
+
+    pthread_mutex_unlock(&guacd_admission_state.lock);
+
+}
+
+void guacd_admission_update_limits(guacd_config* config) {
+
+    pthread_mutex_lock(&guacd_admission_state.lock);
+
+    guacd_admission_state.max_concurrent_handshakes =
+        config->max_concurrent_handshakes;
+    guacd_admission_state.source_connection_rate =
+        config->source_connection_rate;
+
+    /* The status file (if any) continues to reflect the new limits */
+    guacd_admission_state.dirty = 1;
+
+    pthread_mutex_unlock(&guacd_admission_state.lock);
+
+}
+
+/**
+ * Extracts the raw bytes of the given source address, if the address belongs
+ * to a family subject to per-source rate limiting.
+ *
+ * @param addr
+ *     The source address to extract.
+ *
+ * @param bytes
+ *     A pointer to the location which should receive a pointer to the raw
+ *     address bytes.
+ *
+ * @return
+ *     The number of raw address bytes, or zero if the address family is not
+ *     subject to rate limiting.
+ */
+static int guacd_admission_source_bytes(const struct sockaddr* addr,
+        const unsigned char** bytes) {
+
+    /* IPv4 */
+    if (addr->sa_family == AF_INET) {
+        *bytes = (const unsigned char*)
+            &((const struct sockaddr_in*) addr)->sin_addr;
+        return sizeof(struct in_addr);
+    }
+
+    /* IPv6 */
+    if (addr->sa_family == AF_INET6) {
+        *bytes = (const unsigned char*)
+            &((const struct sockaddr_in6*) addr)->sin6_addr;
+        return sizeof(struct in6_addr);
+    }
+
+    /* Other families (such as AF_UNIX) are not rate limited */
+    return 0;
+
+}
+
+/**
+ * Applies the per-source rate limit to a connection from the given source
+ * address, updating the rate tracking table. The admission lock must be held
+ * by the caller.
+ *
+ * @param addr
+ *     The source address of the new connection.
+ *
+ * @return
+ *     Zero if the connection is within the configured rate limit (or the
+ *     limit does not apply), non-zero if the connection should be rejected.
+ */
+static int guacd_admission_check_rate(const struct sockaddr* addr) {
+
+    const unsigned char* bytes;
+    int addr_len = guacd_admission_source_bytes(addr, &bytes);
+    if (addr_len == 0)
+        return 0;
+
+    /* Assign tracking slot by address hash */
+    unsigned int hash = 0;
+    for (int i = 0; i < addr_len; i++)
+        hash = hash * 31 + bytes[i];
+
+    guacd_admission_source* source =
+        &guacd_admission_state.sources[hash % GUACD_ADMISSION_SOURCE_SLOTS];
+
+    guac_timestamp now = guac_timestamp_current();
+
+    /* Continue the current window only if the slot tracks this same source
+     * and the window has not yet expired */
+    if (source->family == addr->sa_family
+            && source->addr_len == addr_len
+            && memcmp(source->addr, bytes, addr_len) == 0
+            && now - source->window_start < GUACD_ADMISSION_RATE_WINDOW) {
+
+        if (source->count >= guacd_admission_state.source_connection_rate)
+            return 1;
+
+        source->count++;
+        return 0;
+
+    }
+
+    /* Otherwise (re)claim the slot for this source, beginning a new window */
+    source->family = addr->sa_family;
+    memcpy(source->addr, bytes, addr_len);
+    source->addr_len = addr_len;
+    source->window_start = now;
+    source->count = 1;
+    return 0;
+
+}
+
+int guacd_admission_try_admit(const struct sockaddr* addr, socklen_t addrlen) {
+
+    pthread_mutex_lock(&guacd_admission_state.lock);
+
+    /* Reject outright if the limit on concurrent handshakes has been
+     * reached, such that overload degrades new connections rather than the
+     * sessions already established */
+    if (guacd_admission_state.max_concurrent_handshakes > 0
+            && guacd_admission_state.active_handshakes
+                >= guacd_admission_state.max_concurrent_handshakes) {
+
+        guacd_admission_state.rejected_busy_total++;
+
+        /* Log the transition into overload once rather than flooding the log
+         * with every rejected connection */
+        if (!guacd_admission_state.shedding) {
+            guacd_admission_state.shedding = 1;
+            guacd_log(GUAC_LOG_WARNING, "Limit of %i concurrent handshakes "
+                    "reached. New connections will be rejected until "
+                    "in-progress handshakes complete.",
+                    guacd_admission_state.max_concurrent_handshakes);
+        }
+
+        guacd_admission_state.dirty = 1;
+        pthread_mutex_unlock(&guacd_admission_state.lock);
+        return 1;
+
+    }
+
+    /* Reject connections from sources exceeding the per-source rate limit */
+    if (guacd_admission_state.source_connection_rate > 0
+            && guacd_admission_check_rate(addr)) {
+
+        guacd_admission_state.rejected_rate_total++;
+        guacd_log(GUAC_LOG_DEBUG, "Rejecting connection exceeding the "
+                "per-source rate limit of %i connection(s) per second.",
+                guacd_admission_state.source_connection_rate);
+
+        guacd_admission_state.dirty = 1;
+        pthread_mutex_unlock(&guacd_admission_state.lock);
+        return 1;
+
+    }
+
+    /* Note recovery from overload */
+    if (guacd_admission_state.shedding) {
+        guacd_admission_state.shedding = 0;
+        guacd_log(GUAC_LOG_INFO, "Accepting new connections again.");
+    }
+
+    /* Admit the connection, counting its handshake until
+     * guacd_admission_handshake_complete() is invoked */
+    guacd_admission_state.active_handshakes++;
+    guacd_admission_state.accepted_total++;
+
+    guacd_admission_state.dirty = 1;
+    pthread_mutex_unlock(&guacd_admission_state.lock);
+    return 0;
+
+}
+
+void guacd_admission_handshake_complete(void) {
+
+    pthread_mutex_lock(&guacd_admission_state.lock);
+
+    guacd_admission_state.active_handshakes--;
+
+    guacd_admission_state.dirty = 1;
+    pthread_mutex_unlock(&guacd_admission_state.lock);
+
+}
+
@@ -0,0 +1,92 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUACD_ADMISSION_H
+#define GUACD_ADMISSION_H
+
+#include "config.h"
+
+#include "conf.h"
+#include "proc-map.h"
+
+#include <sys/socket.h>
+
+/**
+ * Initializes connection admission control using the limits within the given
+ * configuration. If the configuration requests a status file, that file is
+ * immediately written and will be atomically rewritten as connections are
+ * admitted and rejected, such that external health checks always observe a
+ * complete and reasonably-current snapshot of load. This function must be
+ * invoked exactly once, prior to accepting any connections.
+ *
+ * @param map
+ *     The map of connection processes, used to report the number of active
+ *     connections within the status file.
+ *
+ * @param config
+ *     The configuration defining the admission limits to enforce. Limits
+ *     which are zero (or NULL, in the case of the status file) are not
+ *     enforced.
+ */
+void guacd_admission_init(guacd_proc_map* map, guacd_config* config);
+
+/**
+ * Updates the enforced admission limits to those within the given
+ * configuration, as when the configuration is reloaded. Connections already
+ * admitted are unaffected. The status file path cannot be changed after init
+ * and is ignored by this function.
+ *
+ * @param config
+ *     The configuration defining the admission limits to enforce. Limits
+ *     which are zero are not enforced.
+ */
+void guacd_admission_update_limits(guacd_config* config);
+
+/**
+ * Determines whether a newly-accepted connection from the given source
+ * address should be admitted, applying the configured limits on concurrent
+ * handshakes and per-source connection rate. If the connection is admitted,
+ * it is counted as an in-progress handshake until
+ * guacd_admission_handshake_complete() is invoked. If the connection is
+ * rejected, the caller is responsible for closing it; no handshake is
+ * counted.
+ *
+ * @param addr
+ *     The source address of the new connection, as reported by accept().
+ *
+ * @param addrlen
+ *     The length of the source address, in bytes.
+ *
+ * @return
+ *     Zero if the connection should be admitted, non-zero if the connection
+ *     should be rejected.
+ */
+int guacd_admission_try_admit(const struct sockaddr* addr, socklen_t addrlen);
+
+/**
+ * Marks the handshake of a previously-admitted connection as complete,
+ * regardless of whether that handshake succeeded. Each connection admitted by
+ * guacd_admission_try_admit() must result in exactly one invocation of this
+ * function once the connection has been routed to a connection process (or
+ * routing has failed), releasing its slot for future handshakes.
+ */
+void guacd_admission_handshake_complete(void);
+
+#endif
+
@@ -0,0 +1,919 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include <guacamole/error.h>
+#include <guacamole/mem.h>
+#include <guacamole/parser.h>
+#include <guacamole/socket.h>
+#include <guacamole/timestamp.h>
+#include <guacamole/unicode.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/**
+ * Replay driver which load-tests a running guacd using previously-captured
+ * session recordings (as written by guac_recording_create()). For each of N
+ * concurrent sessions, the driver connects to guacd through a real TCP
+ * socket, performs the client side of the Guacamole protocol handshake using
+ * connection parameters supplied in a separate file, and then replays the
+ * input events (key, mouse, and touch instructions) captured within a
+ * recording, paced by the frame timestamps recorded alongside them and
+ * optionally scaled in time. Frame boundaries received from guacd are
+ * acknowledged immediately, exactly as a well-behaved client would.
+ *
+ * Once all sessions have completed, the distributions of handshake latency
+ * and of the interval between received frame boundaries are reported on
+ * STDOUT as JSON, along with the total payload received, such that the
+ * behavior of the socket and display stacks under production-like traffic
+ * can be compared across changes:
+ *
+ *     guacd-replay -f connection.args -n 8 -s 2.0 session1.rec session2.rec
+ *
+ * The connection parameters file names the protocol on its first line,
+ * followed by one "name=value" connection parameter per line. Note that the
+ * recordings themselves contain only the traffic of the original session;
+ * the remote desktop that guacd is pointed at must be reachable for replayed
+ * sessions to connect, and the rendered output will be that of the current
+ * remote desktop, not of the original session.
+ */
+
+/**
+ * The maximum number of connection parameters that may be supplied within a
+ * connection parameters file.
+ */
+#define REPLAY_MAX_PARAMETERS 128
+
+/**
+ * The maximum amount of time to wait for any single instruction from guacd
+ * before considering a session to have failed, in microseconds.
+ */
+#define REPLAY_INSTRUCTION_TIMEOUT 15000000
+
+/**
+ * The display size requested by each replayed session during the handshake,
+ * and the DPI reported for that display.
+ */
+#define REPLAY_DISPLAY_WIDTH  1024
+#define REPLAY_DISPLAY_HEIGHT 768
+#define REPLAY_DISPLAY_DPI    96
+
+/**
+ * A single named connection parameter, as read from the connection
+ * parameters file.
+ */
+typedef struct replay_parameter {
+
+    /**
+     * The name of the parameter.
+     */
+    char* name;
+
+    /**
+     * The value of the parameter.
+     */
+    char* value;
+
+} replay_parameter;
+
+/**
+ * The protocol and connection parameters shared by all replayed sessions, as
+ * read from the connection parameters file.
+ */
+typedef struct replay_connection_args {
+
+    /**
+     * The name of the protocol to select, as would be given in the
+     * "protocol" connection parameter of the Guacamole client.
+     */
+    char* protocol;
+
+    /**
+     * All connection parameters supplied, in the order given. Parameters
+     * requested by guacd that are absent here are sent as empty values.
+     */
+    replay_parameter parameters[REPLAY_MAX_PARAMETERS];
+
+    /**
+     * The number of parameters within the parameters array.
+     */
+    int num_parameters;
+
+} replay_connection_args;
+
+/**
+ * A dynamically-growing set of measurement samples, safe for concurrent
+ * additions from multiple session threads.
+ */
+typedef struct replay_samples {
+
+    /**
+     * The collected samples, in the order added.
+     */
+    double* values;
+
+    /**
+     * The number of samples collected.
+     */
+    size_t length;
+
+    /**
+     * The number of samples that may be stored without growing the values
+     * array.
+     */
+    size_t capacity;
+
+    /**
+     * Lock which protects all members of this structure.
+     */
+    pthread_mutex_t lock;
+
+} replay_samples;
+
+/**
+ * The samples of handshake latency gathered across all sessions, in
+ * milliseconds (one sample per session).
+ */
+static replay_samples handshake_samples = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+/**
+ * The samples of the interval between consecutive frame boundaries received
+ * from guacd, gathered across all sessions, in milliseconds.
+ */
+static replay_samples frame_samples = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+/**
+ * The total number of payload bytes received across all sessions (the
+ * lengths of all received instruction elements, excluding protocol framing).
+ */
+static uint64_t total_received_bytes = 0;
+
+/**
+ * Lock which protects total_received_bytes.
+ */
+static pthread_mutex_t total_received_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Adds the given sample to the given sample set, growing the underlying
+ * storage as necessary.
+ *
+ * @param samples
+ *     The sample set to add the sample to.
+ *
+ * @param value
+ *     The sample to add.
+ */
+static void replay_samples_add(replay_samples* samples, double value) {
+
+    pthread_mutex_lock(&samples->lock);
+
+    if (samples->length == samples->capacity) {
+        samples->capacity = samples->capacity ? samples->capacity * 2 : 1024;
+        samples->values = guac_mem_realloc_or_die(samples->values,
+                samples->capacity, sizeof(double));
+    }
+
+    samples->values[samples->length++] = value;
+
+    pthread_mutex_unlock(&samples->lock);
+
+}
+
+/**
+ * Comparator for qsort() which sorts doubles in ascending order.
+ */
+static int replay_compare_samples(const void* a, const void* b) {
+    double value_a = *(const double*) a;
+    double value_b = *(const double*) b;
+    return (value_a > value_b) - (value_a < value_b);
+}
+
+/**
+ * Returns the sample at the given percentile of the given sorted sample set.
+ *
+ * @param sorted
+ *     The samples, sorted in ascending order.
+ *
+ * @param length
+ *     The number of samples.
+ *
+ * @param percentile
+ *     The percentile to return, between 0 and 100 inclusive.
+ *
+ * @return
+ *     The sample at the given percentile, or zero if there are no samples.
+ */
+static double replay_percentile(const double* sorted, size_t length,
+        double percentile) {
+
+    if (length == 0)
+        return 0;
+
+    size_t index = (size_t) (percentile / 100 * (length - 1) + 0.5);
+    return sorted[index];
+
+}
+
+/**
+ * Prints the distribution of the given sample set as a JSON object with the
+ * given key, sorting the sample set in place.
+ *
+ * @param name
+ *     The JSON key to print the distribution under.
+ *
+ * @param samples
+ *     The sample set to summarize.
+ */
+static void replay_report_samples(const char* name, replay_samples* samples) {
+
+    qsort(samples->values, samples->length, sizeof(double),
+            replay_compare_samples);
+
+    printf("  \"%s\": { \"samples\": %zu, \"min\": %.1f, \"p50\": %.1f, "
+            "\"p95\": %.1f, \"p99\": %.1f, \"max\": %.1f },\n",
+            name, samples->length,
+            replay_percentile(samples->values, samples->length, 0),
+            replay_percentile(samples->values, samples->length, 50),
+            replay_percentile(samples->values, samples->length, 95),
+            replay_percentile(samples->values, samples->length, 99),
+            replay_percentile(samples->values, samples->length, 100));
+
+}
+
+/**
+ * The state of a single replayed session.
+ */
+typedef struct replay_session {
+
+    /**
+     * The connection parameters shared by all sessions.
+     */
+    const replay_connection_args* args;
+
+    /**
+     * The host that guacd is listening on.
+     */
+    const char* host;
+
+    /**
+     * The port that guacd is listening on.
+     */
+    const char* port;
+
+    /**
+     * The path of the recording whose input events this session replays.
+     */
+    const char* recording_path;
+
+    /**
+     * The factor by which recorded time is compressed during replay. A value
+     * of 2 replays input at twice the original rate.
+     */
+    double time_scale;
+
+    /**
+     * The socket of the connection to guacd.
+     */
+    guac_socket* socket;
+
+    /**
+     * The parser reading instructions received from guacd. Used by the
+     * session thread during the handshake and by the reader thread
+     * thereafter.
+     */
+    guac_parser* parser;
+
+    /**
+     * Lock which serializes writes to the socket between the session thread
+     * (replayed input events) and the reader thread (frame acknowledgements).
+     */
+    pthread_mutex_t write_lock;
+
+    /**
+     * The thread which reads and acknowledges all instructions received from
+     * guacd while input events are being replayed.
+     */
+    pthread_t reader_thread;
+
+    /**
+     * Non-zero if this session failed at any stage, zero otherwise.
+     */
+    int failed;
+
+} replay_session;
+
+/**
+ * Sends a single Guacamole instruction consisting of the given elements over
+ * the given socket, where the first element is the opcode. The socket is not
+ * flushed.
+ *
+ * @param socket
+ *     The socket to send the instruction over.
+ *
+ * @param argc
+ *     The number of elements, including the opcode.
+ *
+ * @param argv
+ *     The elements of the instruction to send, beginning with the opcode.
+ *
+ * @return
+ *     Zero if the instruction was sent successfully, non-zero otherwise.
+ */
+static int replay_send_instruction(guac_socket* socket, int argc,
+        const char** argv) {
+
+    for (int i = 0; i < argc; i++) {
+
+        char prefix[32];
+        snprintf(prefix, sizeof(prefix), "%s%zu.", i ? "," : "",
+                guac_utf8_strlen(argv[i]));
+
+        if (guac_socket_write_string(socket, prefix)
+                || guac_socket_write_string(socket, argv[i]))
+            return 1;
+
+    }
+
+    return guac_socket_write_string(socket, ";") ? 1 : 0;
+
+}
+
+/**
+ * Sends a single Guacamole instruction under the write lock of the given
+ * session, flushing the socket such that the instruction is not delayed
+ * behind future writes.
+ *
+ * @param session
+ *     The session to send the instruction within.
+ *
+ * @param argc
+ *     The number of elements, including the opcode.
+ *
+ * @param argv
+ *     The elements of the instruction to send, beginning with the opcode.
+ *
+ * @return
+ *     Zero if the instruction was sent successfully, non-zero otherwise.
+ */
+static int replay_session_send(replay_session* session, int argc,
+        const char** argv) {
+
+    pthread_mutex_lock(&session->write_lock);
+
+    int result = replay_send_instruction(session->socket, argc, argv)
+        || guac_socket_flush(session->socket);
+
+    pthread_mutex_unlock(&session->write_lock);
+    return result;
+
+}
+
+/**
+ * Returns the value that should be sent for the connection parameter with
+ * the given name, as requested by guacd during the handshake. Parameter
+ * names beginning with "VERSION_" denote the protocol version negotiation
+ * added in protocol version 1.1.0 and are answered by mirroring the
+ * server's version, while all other names are resolved against the
+ * connection parameters file (absent parameters resolve to empty values).
+ *
+ * @param args
+ *     The connection parameters read from the connection parameters file.
+ *
+ * @param name
+ *     The name of the parameter requested by guacd.
+ *
+ * @return
+ *     The value to send for the requested parameter.
+ */
+static const char* replay_parameter_value(const replay_connection_args* args,
+        const char* name) {
+
+    if (strncmp(name, "VERSION_", 8) == 0)
+        return name;
+
+    for (int i = 0; i < args->num_parameters; i++) {
+        if (strcmp(args->parameters[i].name, name) == 0)
+            return args->parameters[i].value;
+    }
+
+    return "";
+
+}
+
+/**
+ * Performs the client side of the Guacamole protocol handshake for the given
+ * session, selecting the configured protocol and answering the parameters
+ * requested by guacd from the connection parameters file.
+ *
+ * @param session
+ *     The session to perform the handshake for.
+ *
+ * @return
+ *     Zero if the handshake completed successfully (the "ready" instruction
+ *     was received), non-zero otherwise.
+ */
+static int replay_handshake(replay_session* session) {
+
+    guac_socket* socket = session->socket;
+    guac_parser* parser = session->parser;
+
+    /* Select the configured protocol */
+    const char* select_args[] = { "select", session->args->protocol };
+    if (replay_session_send(session, 2, select_args))
+        return 1;
+
+    /* guacd responds with the names of the parameters it requires */
+    if (guac_parser_expect(parser, socket, REPLAY_INSTRUCTION_TIMEOUT, "args"))
+        return 1;
+
+    /* Answer each requested parameter in order, mirroring the protocol
+     * version (if negotiated) and resolving all other names against the
+     * connection parameters file. The requested names must be copied, as
+     * further parsing invalidates the parser's element storage. */
+    int connect_argc = parser->argc + 1;
+    char** connect_argv = guac_mem_alloc(connect_argc, sizeof(char*));
+    connect_argv[0] = strdup("connect");
+    for (int i = 0; i < parser->argc; i++)
+        connect_argv[i + 1] = strdup(replay_parameter_value(session->args,
+                    parser->argv[i]));
+
+    /* Declare the requested display size and supported image mimetypes
+     * before connecting (no audio or video mimetypes are claimed) */
+    const char* size_args[] = { "size", "1024", "768", "96" };
+    const char* audio_args[] = { "audio" };
+    const char* video_args[] = { "video" };
+    const char* image_args[] = { "image", "image/png", "image/jpeg" };
+
+    char size_width[8], size_height[8], size_dpi[8];
+    snprintf(size_width, sizeof(size_width), "%i", REPLAY_DISPLAY_WIDTH);
+    snprintf(size_height, sizeof(size_height), "%i", REPLAY_DISPLAY_HEIGHT);
+    snprintf(size_dpi, sizeof(size_dpi), "%i", REPLAY_DISPLAY_DPI);
+    size_args[1] = size_width;
+    size_args[2] = size_height;
+    size_args[3] = size_dpi;
+
+    int result = replay_session_send(session, 4, size_args)
+        || replay_session_send(session, 1, audio_args)
+        || replay_session_send(session, 1, video_args)
+        || replay_session_send(session, 3, image_args)
+        || replay_session_send(session, connect_argc,
+                (const char**) connect_argv);
+
+    for (int i = 0; i < connect_argc; i++)
+        free(connect_argv[i]);
+    guac_mem_free(connect_argv);
+
+    if (result)
+        return 1;
+
+    /* The handshake is complete once guacd declares the connection ready */
+    return guac_parser_expect(parser, socket, REPLAY_INSTRUCTION_TIMEOUT,
+            "ready") ? 1 : 0;
+
+}
+
+/**
+ * Thread which reads all instructions received from guacd for the given
+ * session, acknowledging each frame boundary immediately (as a well-behaved
+ * client would) and recording the interval between consecutive frame
+ * boundaries along with the volume of payload received. The thread exits
+ * when guacd closes the connection or an error occurs.
+ *
+ * @param data
+ *     The replay_session being read.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* replay_reader_thread(void* data) {
+
+    replay_session* session = (replay_session*) data;
+    guac_parser* parser = session->parser;
+
+    uint64_t received = 0;
+    guac_timestamp last_sync = 0;
+
+    while (guac_parser_read(parser, session->socket,
+                REPLAY_INSTRUCTION_TIMEOUT) == 0) {
+
+        /* Tally the payload of every received instruction */
+        received += strlen(parser->opcode);
+        for (int i = 0; i < parser->argc; i++)
+            received += strlen(parser->argv[i]);
+
+        /* Immediately acknowledge each frame boundary, recording the
+         * interval since the previous boundary */
+        if (strcmp(parser->opcode, "sync") == 0 && parser->argc >= 1) {
+
+            guac_timestamp now = guac_timestamp_current();
+            if (last_sync != 0)
+                replay_samples_add(&frame_samples, (double) (now - last_sync));
+            last_sync = now;
+
+            const char* sync_args[] = { "sync", parser->argv[0] };
+            if (replay_session_send(session, 2, sync_args))
+                break;
+
+        }
+
+        /* guacd will close the connection itself following a disconnect */
+        else if (strcmp(parser->opcode, "disconnect") == 0)
+            break;
+
+    }
+
+    pthread_mutex_lock(&total_received_lock);
+    total_received_bytes += received;
+    pthread_mutex_unlock(&total_received_lock);
+
+    return NULL;
+
+}
+
+/**
+ * Opens a TCP connection to guacd at the host and port configured for the
+ * given session.
+ *
+ * @param session
+ *     The session to open a connection for.
+ *
+ * @return
+ *     The file descriptor of the opened connection, or -1 if the connection
+ *     could not be established.
+ */
+static int replay_connect(replay_session* session) {
+
+    struct addrinfo hints = {
+        .ai_family   = AF_UNSPEC,
+        .ai_socktype = SOCK_STREAM,
+        .ai_protocol = IPPROTO_TCP
+    };
+
+    struct addrinfo* addresses;
+    if (getaddrinfo(session->host, session->port, &hints, &addresses))
+        return -1;
+
+    /* Attempt each resolved address until one connects */
+    int fd = -1;
+    for (struct addrinfo* current = addresses; current != NULL;
+            current = current->ai_next) {
+
+        fd = socket(current->ai_family, current->ai_socktype,
+                current->ai_protocol);
+        if (fd == -1)
+            continue;
+
+        if (connect(fd, current->ai_addr, current->ai_addrlen) == 0)
+            break;
+
+        close(fd);
+        fd = -1;
+
+    }
+
+    freeaddrinfo(addresses);
+    return fd;
+
+}
+
+/**
+ * Replays the input events of the recording configured for the given session
+ * against guacd, paced by the frame timestamps recorded alongside those
+ * events and compressed in time by the configured scale. All instructions of
+ * the recording that are not input events (the graphical output of the
+ * original session) drive only the replay clock.
+ *
+ * @param session
+ *     The session whose recording should be replayed.
+ *
+ * @return
+ *     Zero if the recording was replayed in full, non-zero otherwise.
+ */
+static int replay_input_events(replay_session* session) {
+
+    int result = 0;
+
+    int fd = open(session->recording_path, O_RDONLY);
+    if (fd == -1) {
+        fprintf(stderr, "%s: %s\n", session->recording_path, strerror(errno));
+        return 1;
+    }
+
+    guac_socket* recording = guac_socket_open(fd);
+    guac_parser* parser = guac_parser_alloc();
+
+    /* The recorded and replayed timelines are anchored at the first recorded
+     * frame timestamp */
+    guac_timestamp recording_epoch = 0;
+    guac_timestamp replay_epoch = 0;
+
+    while (guac_parser_read(parser, recording, 0) == 0) {
+
+        /* Recorded frame boundaries carry the timestamps that pace the
+         * replay: sleep until the scaled offset of each boundary */
+        if (strcmp(parser->opcode, "sync") == 0 && parser->argc >= 1) {
+
+            guac_timestamp recorded = atoll(parser->argv[0]);
+
+            if (recording_epoch == 0) {
+                recording_epoch = recorded;
+                replay_epoch = guac_timestamp_current();
+            }
+
+            else {
+
+                guac_timestamp target = replay_epoch + (guac_timestamp)
+                    ((recorded - recording_epoch) / session->time_scale);
+
+                int wait = (int) (target - guac_timestamp_current());
+                if (wait > 0)
+                    guac_timestamp_msleep(wait);
+
+            }
+
+        }
+
+        /* Forward recorded input events verbatim (guacd ignores the trailing
+         * timestamp element recorded with each event) */
+        else if (strcmp(parser->opcode, "key") == 0
+                || strcmp(parser->opcode, "mouse") == 0
+                || strcmp(parser->opcode, "touch") == 0) {
+
+            int argc = parser->argc + 1;
+            const char* argv[argc];
+            argv[0] = parser->opcode;
+            for (int i = 0; i < parser->argc; i++)
+                argv[i + 1] = parser->argv[i];
+
+            if (replay_session_send(session, argc, argv)) {
+                result = 1;
+                break;
+            }
+
+        }
+
+    }
+
+    guac_parser_free(parser);
+    guac_socket_free(recording);
+    return result;
+
+}
+
+/**
+ * Thread which runs a single replayed session from connection through
+ * disconnect, recording handshake latency and marking the session as failed
+ * if any stage does not complete.
+ *
+ * @param data
+ *     The replay_session to run.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* replay_session_thread(void* data) {
+
+    replay_session* session = (replay_session*) data;
+
+    int fd = replay_connect(session);
+    if (fd == -1) {
+        fprintf(stderr, "Unable to connect to guacd at %s, port %s\n",
+                session->host, session->port);
+        session->failed = 1;
+        return NULL;
+    }
+
+    session->socket = guac_socket_open(fd);
+    session->parser = guac_parser_alloc();
+    pthread_mutex_init(&session->write_lock, NULL);
+
+    /* Perform and time the handshake */
+    guac_timestamp handshake_start = guac_timestamp_current();
+    if (replay_handshake(session)) {
+        fprintf(stderr, "Handshake with guacd did not complete\n");
+        session->failed = 1;
+        goto cleanup;
+    }
+
+    replay_samples_add(&handshake_samples,
+            (double) (guac_timestamp_current() - handshake_start));
+
+    /* Read and acknowledge all output produced by guacd while input events
+     * are replayed */
+    pthread_create(&session->reader_thread, NULL, replay_reader_thread,
+            session);
+
+    if (replay_input_events(session))
+        session->failed = 1;
+
+    /* End the session; guacd closes the connection in response, which in
+     * turn ends the reader thread */
+    const char* disconnect_args[] = { "disconnect" };
+    replay_session_send(session, 1, disconnect_args);
+    shutdown(fd, SHUT_WR);
+
+    pthread_join(session->reader_thread, NULL);
+
+cleanup:
+    guac_parser_free(session->parser);
+    guac_socket_free(session->socket);
+    pthread_mutex_destroy(&session->write_lock);
+    return NULL;
+
+}
+
+/**
+ * Reads the protocol name and connection parameters from the file at the
+ * given path. The first line of the file names the protocol, and each
+ * following line supplies one "name=value" connection parameter.
+ *
+ * @param path
+ *     The path of the connection parameters file.
+ *
+ * @param args
+ *     The replay_connection_args to populate.
+ *
+ * @return
+ *     Zero if the file was read successfully, non-zero otherwise.
+ */
+static int replay_read_args(const char* path, replay_connection_args* args) {
+
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    char line[4096];
+    while (fgets(line, sizeof(line), file) != NULL) {
+
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#')
+            continue;
+
+        /* The first non-empty line names the protocol */
+        if (args->protocol == NULL) {
+            args->protocol = strdup(line);
+            continue;
+        }
+
+        char* equals = strchr(line, '=');
+        if (equals == NULL) {
+            fprintf(stderr, "%s: \"%s\" is not of the form name=value\n",
+                    path, line);
+            fclose(file);
+            return 1;
+        }
+
+        if (args->num_parameters == REPLAY_MAX_PARAMETERS) {
+            fprintf(stderr, "%s: too many parameters (maximum %i)\n", path,
+                    REPLAY_MAX_PARAMETERS);
+            fclose(file);
+            return 1;
+        }
+
+        *equals = '\0';
+        replay_parameter* parameter = &args->parameters[args->num_parameters++];
+        parameter->name = strdup(line);
+        parameter->value = strdup(equals + 1);
+
+    }
+
+    fclose(file);
+
+    if (args->protocol == NULL) {
+        fprintf(stderr, "%s: no protocol specified\n", path);
+        return 1;
+    }
+
+    return 0;
+
+}
+
+int main(int argc, char** argv) {
+
+    const char* host = "127.0.0.1";
+    const char* port = "4822";
+    const char* args_path = NULL;
+    int num_sessions = 1;
+    double time_scale = 1.0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "H:p:f:n:s:")) != -1) {
+        switch (opt) {
+
+            case 'H':
+                host = optarg;
+                break;
+
+            case 'p':
+                port = optarg;
+                break;
+
+            case 'f':
+                args_path = optarg;
+                break;
+
+            case 'n':
+                num_sessions = atoi(optarg);
+                break;
+
+            case 's':
+                time_scale = atof(optarg);
+                break;
+
+            default:
+                goto usage;
+
+        }
+    }
+
+    if (args_path == NULL || optind == argc || num_sessions < 1
+            || time_scale <= 0) {
+usage:
+        fprintf(stderr, "USAGE: %s [-H HOST] [-p PORT] [-n SESSIONS] "
+                "[-s TIME_SCALE] -f ARGS_FILE RECORDING...\n", argv[0]);
+        return 1;
+    }
+
+    replay_connection_args args = { 0 };
+    if (replay_read_args(args_path, &args))
+        return 1;
+
+    /* Run all sessions concurrently, cycling through the given recordings */
+    replay_session* sessions = guac_mem_zalloc(num_sessions,
+            sizeof(replay_session));
+    pthread_t* threads = guac_mem_alloc(num_sessions, sizeof(pthread_t));
+
+    guac_timestamp run_start = guac_timestamp_current();
+
+    for (int i = 0; i < num_sessions; i++) {
+
+        replay_session* session = &sessions[i];
+        session->args = &args;
+        session->host = host;
+        session->port = port;
+        session->recording_path = argv[optind + i % (argc - optind)];
+        session->time_scale = time_scale;
+
+        pthread_create(&threads[i], NULL, replay_session_thread, session);
+
+    }
+
+    int failed = 0;
+    for (int i = 0; i < num_sessions; i++) {
+        pthread_join(threads[i], NULL);
+        failed += sessions[i].failed;
+    }
+
+    double duration_s =
+        (double) (guac_timestamp_current() - run_start) / 1000;
+
+    /* Report latency distributions and overall throughput as JSON */
+    printf("{\n");
+    printf("  \"sessions\": %i,\n", num_sessions);
+    printf("  \"failed\": %i,\n", failed);
+    printf("  \"time_scale\": %.2f,\n", time_scale);
+    replay_report_samples("handshake_ms", &handshake_samples);
+    replay_report_samples("frame_interval_ms", &frame_samples);
+    printf("  \"received_payload_bytes\": %" PRIu64 ",\n",
+            total_received_bytes);
+    printf("  \"duration_s\": %.1f,\n", duration_s);
+    printf("  \"received_payload_bytes_per_s\": %.0f\n",
+            duration_s > 0 ? total_received_bytes / duration_s : 0);
+    printf("}\n");
+
+    guac_mem_free(threads);
+    guac_mem_free(sessions);
+
+    return failed ? 1 : 0;
+
+}
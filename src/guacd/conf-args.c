@@ -33,6 +33,10 @@
 
 int guacd_conf_parse_args(guacd_config* config, int argc, char** argv) {
 
+    /* Restart option scanning from the beginning, such that the arguments
+     * can be reparsed when the configuration is reloaded */
+    optind = 1;
+
     /* Parse arguments */
     int opt;
     while ((opt = getopt(argc, argv, "l:b:p:L:C:K:fv")) != -1) {
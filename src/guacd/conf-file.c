@@ -91,6 +91,146 @@ static int guacd_conf_callback(const char* section, const char* param, const cha
 
         }
 
+        /* Per-connection memory limit */
+        else if (strcmp(param, "connection_memory_limit") == 0) {
+
+            char* end;
+            long limit = strtol(value, &end, 10);
+
+            /* Invalid memory limit */
+            if (*end != '\0' || limit < 0) {
+                guacd_conf_parse_error = "Invalid memory limit. The limit must be a non-negative number of megabytes.";
+                return 1;
+            }
+
+            /* Valid memory limit */
+            config->connection_memory_limit = limit;
+            return 0;
+
+        }
+
+        /* Number of CPU affinity groups for connection processes */
+        else if (strcmp(param, "cpu_affinity_groups") == 0) {
+
+            char* end;
+            long groups = strtol(value, &end, 10);
+
+            /* Invalid group count */
+            if (*end != '\0' || groups < 0) {
+                guacd_conf_parse_error = "Invalid number of CPU affinity groups. The number of groups must be a non-negative integer.";
+                return 1;
+            }
+
+            /* Valid group count */
+            config->cpu_affinity_groups = groups;
+            return 0;
+
+        }
+
+        /* Niceness (scheduling priority) of connection processes */
+        else if (strcmp(param, "connection_niceness") == 0) {
+
+            char* end;
+            long niceness = strtol(value, &end, 10);
+
+            /* Invalid niceness */
+            if (*end != '\0' || niceness < -20 || niceness > 19) {
+                guacd_conf_parse_error = "Invalid niceness. The niceness of connection processes must be an integer between -20 and 19 inclusive.";
+                return 1;
+            }
+
+            /* Valid niceness */
+            config->connection_niceness = niceness;
+            return 0;
+
+        }
+
+        /* Huge page backing for large buffers */
+        else if (strcmp(param, "enable_huge_pages") == 0) {
+
+            if (strcmp(value, "true") == 0)
+                config->enable_huge_pages = 1;
+            else if (strcmp(value, "false") == 0)
+                config->enable_huge_pages = 0;
+
+            /* Invalid boolean value */
+            else {
+                guacd_conf_parse_error = "Invalid value. The enable_huge_pages parameter must be either \"true\" or \"false\".";
+                return 1;
+            }
+
+            return 0;
+
+        }
+
+        /* Linger time after the last user of a connection disconnects */
+        else if (strcmp(param, "connection_linger_timeout") == 0) {
+
+            char* end;
+            long linger = strtol(value, &end, 10);
+
+            /* Invalid linger timeout */
+            if (*end != '\0' || linger < 0) {
+                guacd_conf_parse_error = "Invalid linger timeout. The timeout must be a non-negative number of seconds.";
+                return 1;
+            }
+
+            /* Valid linger timeout */
+            config->connection_linger_timeout = linger;
+            return 0;
+
+        }
+
+        /* Limit on concurrent connection handshakes */
+        else if (strcmp(param, "max_concurrent_handshakes") == 0) {
+
+            char* end;
+            long handshakes = strtol(value, &end, 10);
+
+            /* Invalid handshake limit */
+            if (*end != '\0' || handshakes < 0) {
+                guacd_conf_parse_error = "Invalid handshake limit. The limit must be a non-negative number of handshakes.";
+                return 1;
+            }
+
+            /* Valid handshake limit */
+            config->max_concurrent_handshakes = handshakes;
+            return 0;
+
+        }
+
+        /* Per-source limit on connection rate */
+        else if (strcmp(param, "source_connection_rate") == 0) {
+
+            char* end;
+            long rate = strtol(value, &end, 10);
+
+            /* Invalid connection rate */
+            if (*end != '\0' || rate < 0) {
+                guacd_conf_parse_error = "Invalid connection rate. The rate must be a non-negative number of connections per second.";
+                return 1;
+            }
+
+            /* Valid connection rate */
+            config->source_connection_rate = rate;
+            return 0;
+
+        }
+
+        /* Load metrics status file */
+        else if (strcmp(param, "status_file") == 0) {
+            guac_mem_free(config->status_file);
+            config->status_file = guac_strdup(value);
+            return 0;
+        }
+
+        /* Protocol plugins to preload at startup */
+        else if (strcmp(param, "preload_protocols") == 0) {
+            guac_mem_free(config->preload_protocols);
+            config->preload_protocols = guac_strdup(value);
+            return 0;
+        }
+
     }
 
     /* SSL-specific options */
@@ -184,6 +324,15 @@ guacd_config* guacd_conf_load() {
     conf->foreground = 0;
     conf->print_version = 0;
     conf->max_log_level = GUAC_LOG_INFO;
+    conf->connection_memory_limit = 0;
+    conf->cpu_affinity_groups = 0;
+    conf->connection_niceness = 0;
+    conf->enable_huge_pages = 0;
+    conf->connection_linger_timeout = 0;
+    conf->max_concurrent_handshakes = 0;
+    conf->source_connection_rate = 0;
+    conf->status_file = NULL;
+    conf->preload_protocols = NULL;
 
 #ifdef ENABLE_SSL
     conf->cert_file = NULL;
@@ -216,3 +365,23 @@ guacd_config* guacd_conf_load() {
 
 }
 
+
+void guacd_conf_free(guacd_config* conf) {
+
+    if (conf == NULL)
+        return;
+
+    guac_mem_free(conf->bind_host);
+    guac_mem_free(conf->bind_port);
+    guac_mem_free(conf->pidfile);
+    guac_mem_free(conf->status_file);
+    guac_mem_free(conf->preload_protocols);
+
+#ifdef ENABLE_SSL
+    guac_mem_free(conf->cert_file);
+    guac_mem_free(conf->key_file);
+#endif
+
+    guac_mem_free(conf);
+
+}
@@ -37,5 +37,10 @@ int guacd_conf_parse_file(guacd_config* conf, int fd);
  */
 guacd_config* guacd_conf_load();
 
+/**
+ * Frees the given configuration and all memory associated with it.
+ */
+void guacd_conf_free(guacd_config* conf);
+
 #endif
 
@@ -83,6 +83,90 @@ typedef struct guacd_config {
      */
     guac_client_log_level max_log_level;
 
+    /**
+     * The maximum amount of memory that each connection process may allocate,
+     * in megabytes, or zero if no limit should be enforced.
+     */
+    size_t connection_memory_limit;
+
+    /**
+     * The number of groups that the CPUs available to guacd should be divided
+     * into for the sake of restricting the CPU affinity of connection
+     * processes, or zero if connection processes should simply inherit the
+     * CPU affinity of the main guacd process. When non-zero, each connection
+     * process is assigned one of the groups round-robin at fork time,
+     * restricting that connection (and the sizes of any thread pools it
+     * allocates relative to available processors) to a contiguous subset of
+     * CPUs. On multi-socket machines, dividing CPUs into one group per
+     * physical socket keeps each connection's threads and the memory they
+     * allocate local to a single socket.
+     */
+    int cpu_affinity_groups;
+
+    /**
+     * The niceness (scheduling priority adjustment) that connection processes
+     * should run with, or zero if their scheduling priority should be left
+     * unchanged (the default). Lower values denote higher priority; a
+     * negative niceness lets interactive connection handling win the CPU over
+     * batch workloads sharing the host, but typically requires elevated
+     * privileges to apply.
+     */
+    int connection_niceness;
+
+    /**
+     * Whether large, long-lived buffers allocated by connection processes
+     * (such as the framebuffers maintained for each layer of a display)
+     * should be backed by transparent huge pages where supported by the
+     * kernel, reducing TLB pressure for large displays.
+     */
+    int enable_huge_pages;
+
+    /**
+     * The amount of time that a connection process should continue running
+     * after its last user has disconnected, in seconds, or zero if connection
+     * processes should stop immediately when their last user disconnects.
+     * Lingering briefly allows users on unreliable networks to reconnect to
+     * their still-running remote desktop session, rehydrating their display
+     * from the state maintained by the connection process rather than
+     * establishing an entirely new connection.
+     */
+    int connection_linger_timeout;
+
+    /**
+     * The maximum number of connection handshakes that may be in progress at
+     * any given time, or zero if no limit should be enforced. Connections
+     * accepted beyond this limit are immediately rejected with a "server
+     * busy" protocol error, shedding overload onto new connections rather
+     * than degrading sessions that are already established.
+     */
+    int max_concurrent_handshakes;
+
+    /**
+     * The maximum number of connections that may be admitted from any single
+     * source address per second, or zero if no limit should be enforced.
+     * Connections exceeding this rate are immediately rejected with a
+     * "server busy" protocol error.
+     */
+    int source_connection_rate;
+
+    /**
+     * The path of a file to which guacd should periodically write load
+     * metrics (active connections, in-progress handshakes, and totals of
+     * accepted and rejected connections), or NULL if no such file should be
+     * maintained. The file is atomically replaced on each update such that
+     * external health checks always observe a complete snapshot.
+     */
+    char* status_file;
+
+    /**
+     * A comma-separated list of the names of protocols whose plugins should
+     * be loaded within the main guacd process at startup, or NULL if no
+     * plugins should be preloaded. Connection processes forked for a
+     * preloaded protocol inherit the already-resolved plugin mapping,
+     * skipping dynamic-linker work during connection setup.
+     */
+    char* preload_protocols;
+
 } guacd_config;
 
 #endif
@@ -19,6 +19,7 @@
 
 #include "config.h"
 
+#include "admission.h"
 #include "connection.h"
 #include "log.h"
 #include "move-fd.h"
@@ -40,11 +41,34 @@
 #endif
 
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
+/**
+ * The initial size of the buffer used when copying data between a user's
+ * guac_socket and the file descriptor leading to the connection-specific
+ * process, in bytes.
+ */
+#define GUACD_CONNECTION_BUFFER_SIZE 8192
+
+/**
+ * The maximum size that the buffer used when copying data between a user's
+ * guac_socket and the file descriptor leading to the connection-specific
+ * process may adaptively grow to, in bytes.
+ */
+#define GUACD_CONNECTION_BUFFER_MAX 131072
 
 /**
  * Behaves exactly as write(), but writes as much as possible, returning
@@ -84,6 +108,871 @@ static int __write_all(int fd, char* buffer, int length) {
 
 }
 
+#ifdef HAVE_SYS_EPOLL_H
+
+/**
+ * The minimum number of worker threads which service all multiplexed
+ * connections. As all transfers are performed non-blockingly, workers are
+ * occupied only while actually moving data, and the pool is sized relative to
+ * the number of processors available.
+ */
+#define GUACD_CONNECTION_IO_MIN_THREADS 2
+
+/**
+ * The maximum number of worker threads which service all multiplexed
+ * connections. Transfer work is bounded by memory bandwidth and system call
+ * overhead rather than by the number of connections, so there is no benefit to
+ * a pool larger than this even on very large machines.
+ */
+#define GUACD_CONNECTION_IO_MAX_THREADS 16
+
+typedef struct guacd_connection_io guacd_connection_io;
+
+/**
+ * One of the two file descriptors monitored on behalf of a multiplexed
+ * connection. A pointer to this structure is attached to the corresponding
+ * epoll registration, identifying both the connection and the direction of
+ * transfer when an event is received.
+ */
+typedef struct guacd_connection_io_endpoint {
+
+    /**
+     * The connection being monitored.
+     */
+    guacd_connection_io* connection;
+
+    /**
+     * The file descriptor being monitored.
+     */
+    int fd;
+
+    /**
+     * The pipe through which ready data is spliced in the direction handled
+     * by this endpoint, avoiding any copy through userspace. The read and
+     * write ends are stored at indices 0 and 1 respectively. Both will be -1
+     * if no pipe could be created.
+     */
+    int pipe_fds[2];
+
+    /**
+     * The events for which this endpoint is currently armed within the epoll
+     * instance, or zero if the endpoint is disarmed (whether dormant, pending
+     * service, or currently being serviced). Must only be accessed while
+     * holding the lock of guacd_connection_io_pool.
+     */
+    uint32_t armed;
+
+    /**
+     * Whether a worker thread is currently servicing this endpoint. Must only
+     * be accessed while holding the lock of guacd_connection_io_pool.
+     */
+    bool in_service;
+
+    /**
+     * Events which were delivered for this endpoint while it was already
+     * being serviced by another worker (possible if the endpoint is rearmed
+     * on behalf of its peer just as an earlier event is being delivered).
+     * These are serviced by the current worker before it finishes. Must only
+     * be accessed while holding the lock of guacd_connection_io_pool.
+     */
+    uint32_t deferred_events;
+
+    /**
+     * Whether the reference held by this endpoint against its connection has
+     * been released. Must only be accessed while holding the lock of
+     * guacd_connection_io_pool.
+     */
+    bool retired;
+
+    /**
+     * Buffer containing data which was read in the direction handled by this
+     * endpoint but could not yet be written to its destination without
+     * blocking. Applies only if pending_in_pipe is false.
+     */
+    char buffer[GUACD_CONNECTION_BUFFER_SIZE];
+
+    /**
+     * The offset of the first unwritten byte within the pending buffer.
+     */
+    int pending_offset;
+
+    /**
+     * The number of bytes which have been read in the direction handled by
+     * this endpoint but not yet written to its destination. While this is
+     * non-zero, no further data is read in this direction (providing natural
+     * backpressure), and the destination is monitored for writability.
+     */
+    int pending_length;
+
+    /**
+     * Whether the pending data resides within the pipe of this endpoint
+     * (having been spliced there) rather than within the pending buffer.
+     */
+    bool pending_in_pipe;
+
+} guacd_connection_io_endpoint;
+
+/**
+ * The current state of a user connection which is being serviced by the shared
+ * epoll worker pool rather than by a dedicated pair of I/O threads.
+ */
+struct guacd_connection_io {
+
+    /**
+     * The guac_socket which is directly handling I/O from the user's
+     * connection to guacd.
+     */
+    guac_socket* socket;
+
+    /**
+     * The guacd end of the socketpair whose other end is handled by a
+     * guac_socket within the connection-specific process.
+     */
+    int fd;
+
+    /**
+     * The two endpoints monitored for this connection: the socketpair end
+     * (data bound for the user) and the file descriptor underlying the
+     * guac_socket (data bound for the connection-specific process).
+     */
+    guacd_connection_io_endpoint endpoints[2];
+
+    /**
+     * Whether this connection has terminated (in either direction) and is in
+     * the process of being torn down. Once set, endpoints are no longer
+     * rearmed, and the connection is freed when the last endpoint retires.
+     */
+    bool closed;
+
+    /**
+     * The number of endpoints which have not yet retired. The connection is
+     * freed when this reaches zero.
+     */
+    int refs;
+
+    /**
+     * Whether data should be relayed with splice() rather than copied through
+     * a userspace buffer. This is cleared if either file descriptor turns out
+     * not to support splicing.
+     */
+    bool spliced;
+
+};
+
+/**
+ * The number of bytes requested per splice() call when relaying data through
+ * the pipe of an endpoint. This matches the default capacity of the pipe
+ * itself.
+ */
+#define GUACD_CONNECTION_PIPE_BUFFER_SIZE 65536
+
+/**
+ * The epoll instance and worker threads shared by all multiplexed
+ * connections. The worker pool is started lazily when the first connection is
+ * multiplexed.
+ */
+static struct {
+
+    /**
+     * Lock which protects the state of all multiplexed connections, as well
+     * as lazy startup of the worker pool itself.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * The file descriptor of the epoll instance monitored by all workers, or
+     * -1 if the worker pool has not yet been started.
+     */
+    int epoll_fd;
+
+} guacd_connection_io_pool = { PTHREAD_MUTEX_INITIALIZER, -1 };
+
+/**
+ * Closes the pipes of both endpoints of the given connection, if any were
+ * successfully created.
+ *
+ * @param connection
+ *     The connection whose pipes should be closed.
+ */
+static void guacd_connection_io_close_pipes(guacd_connection_io* connection) {
+
+    for (int i = 0; i < 2; i++) {
+        if (connection->endpoints[i].pipe_fds[0] != -1) {
+            close(connection->endpoints[i].pipe_fds[0]);
+            close(connection->endpoints[i].pipe_fds[1]);
+        }
+    }
+
+}
+
+/**
+ * Returns the peer of the given endpoint: the endpoint handling transfer in
+ * the opposite direction for the same connection. The destination of each
+ * endpoint's transfers is the file descriptor of its peer.
+ *
+ * @param endpoint
+ *     The endpoint whose peer should be returned.
+ *
+ * @return
+ *     The peer of the given endpoint.
+ */
+static guacd_connection_io_endpoint* guacd_connection_io_peer(
+        guacd_connection_io_endpoint* endpoint) {
+
+    guacd_connection_io* connection = endpoint->connection;
+
+    if (endpoint == &connection->endpoints[0])
+        return &connection->endpoints[1];
+
+    return &connection->endpoints[0];
+
+}
+
+/**
+ * Frees all resources associated with the given connection. Both endpoints
+ * must have retired (no worker may still be servicing the connection).
+ *
+ * @param connection
+ *     The connection to free.
+ */
+static void guacd_connection_io_free(guacd_connection_io* connection) {
+    guac_socket_free(connection->socket);
+    close(connection->fd);
+    guacd_connection_io_close_pipes(connection);
+    guac_mem_free(connection);
+}
+
+/**
+ * Begins tearing down the given connection, if teardown has not already
+ * begun. Shutting down both file descriptors guarantees that any endpoint
+ * still armed receives a final event (error/hangup conditions are reported by
+ * epoll regardless of the events requested) and retires itself. Endpoints
+ * which are disarmed and not being serviced must be retired by the caller, as
+ * they will receive no such event. The lock of guacd_connection_io_pool must
+ * be held by the caller.
+ *
+ * @param connection
+ *     The connection to tear down.
+ */
+static void guacd_connection_io_teardown(guacd_connection_io* connection) {
+
+    if (!connection->closed) {
+        connection->closed = true;
+        shutdown(connection->fd, SHUT_RDWR);
+        shutdown(connection->endpoints[1].fd, SHUT_RDWR);
+    }
+
+}
+
+/**
+ * Arms the given endpoint for the events it currently requires: readability
+ * if nothing is pending in its own direction (further reads would otherwise
+ * only grow the backlog), and writability if its peer has pending data bound
+ * for this endpoint's file descriptor. An endpoint requiring neither remains
+ * disarmed until the flushing of its pending data (by its peer) rearms it.
+ * Has no effect on endpoints currently being serviced, which rearm themselves
+ * with up-to-date interest when servicing completes. The lock of
+ * guacd_connection_io_pool must be held by the caller.
+ *
+ * @param endpoint
+ *     The endpoint to arm.
+ */
+static void guacd_connection_io_arm(guacd_connection_io_endpoint* endpoint) {
+
+    guacd_connection_io* connection = endpoint->connection;
+
+    if (connection->closed || endpoint->in_service)
+        return;
+
+    uint32_t interest = 0;
+    if (endpoint->pending_length == 0)
+        interest |= EPOLLIN;
+    if (guacd_connection_io_peer(endpoint)->pending_length > 0)
+        interest |= EPOLLOUT;
+
+    if (interest == endpoint->armed)
+        return;
+
+    struct epoll_event event = {
+        .events = interest | EPOLLONESHOT,
+        .data = { .ptr = endpoint }
+    };
+
+    /* Tear down connection if the endpoint cannot be rearmed */
+    if (epoll_ctl(guacd_connection_io_pool.epoll_fd, EPOLL_CTL_MOD,
+                endpoint->fd, &event))
+        guacd_connection_io_teardown(connection);
+    else
+        endpoint->armed = interest;
+
+}
+
+/**
+ * Writes as much pending data of the given endpoint to its destination as
+ * can be written without blocking. Any remainder is retained (in the pipe or
+ * pending buffer of the endpoint) for a later flush once the destination is
+ * again writable.
+ *
+ * @param endpoint
+ *     The endpoint whose pending data should be flushed.
+ *
+ * @return
+ *     true if the flush failed (and the connection should be torn down),
+ *     false otherwise, including when data remains pending because the
+ *     destination would block.
+ */
+static bool guacd_connection_io_flush(guacd_connection_io_endpoint* endpoint) {
+
+    int dest_fd = guacd_connection_io_peer(endpoint)->fd;
+
+#ifdef HAVE_SPLICE
+    if (endpoint->pending_in_pipe) {
+
+        while (endpoint->pending_length > 0) {
+
+            ssize_t written = splice(endpoint->pipe_fds[0], NULL, dest_fd,
+                    NULL, endpoint->pending_length, SPLICE_F_MOVE);
+
+            if (written < 0) {
+
+                if (errno == EINTR)
+                    continue;
+
+                /* The remainder stays within the pipe until the destination
+                 * is again writable */
+                if (errno == EAGAIN)
+                    return false;
+
+                return true;
+
+            }
+
+            if (written == 0)
+                return true;
+
+            endpoint->pending_length -= written;
+
+        }
+
+        return false;
+
+    }
+#endif
+
+    while (endpoint->pending_length > 0) {
+
+        int written = write(dest_fd,
+                endpoint->buffer + endpoint->pending_offset,
+                endpoint->pending_length);
+
+        if (written < 0) {
+
+            if (errno == EINTR)
+                continue;
+
+            /* The remainder stays within the pending buffer until the
+             * destination is again writable */
+            if (errno == EAGAIN)
+                return false;
+
+            return true;
+
+        }
+
+        endpoint->pending_offset += written;
+        endpoint->pending_length -= written;
+
+    }
+
+    endpoint->pending_offset = 0;
+    return false;
+
+}
+
+/**
+ * Transfers one buffer's worth of ready data in the direction handled by the
+ * given endpoint. Where both file descriptors support it, the data is spliced
+ * through the pipe of the endpoint, moving it entirely within the kernel.
+ * The data is otherwise copied through the pending buffer of the endpoint.
+ * All transfer is non-blocking: whatever cannot be written immediately
+ * remains pending within the endpoint.
+ *
+ * @param endpoint
+ *     The endpoint whose file descriptor is ready for reading.
+ *
+ * @return
+ *     true if the transfer failed or reached end-of-file (and the connection
+ *     should be torn down), false otherwise.
+ */
+static bool guacd_connection_io_relay(guacd_connection_io_endpoint* endpoint) {
+
+#ifdef HAVE_SPLICE
+    guacd_connection_io* connection = endpoint->connection;
+    if (connection->spliced && endpoint->pipe_fds[0] != -1) {
+
+        /* Move ready data into the pipe of this endpoint without copying it
+         * through userspace */
+        ssize_t moved = splice(endpoint->fd, NULL, endpoint->pipe_fds[1],
+                NULL, GUACD_CONNECTION_PIPE_BUFFER_SIZE, SPLICE_F_MOVE);
+
+        if (moved > 0) {
+            endpoint->pending_in_pipe = true;
+            endpoint->pending_length = moved;
+            return guacd_connection_io_flush(endpoint);
+        }
+
+        /* End-of-file */
+        if (moved == 0)
+            return true;
+
+        /* Readiness was spurious, or the transfer was interrupted */
+        if (errno == EAGAIN || errno == EINTR)
+            return false;
+
+        /* A genuine transfer error */
+        if (errno != EINVAL)
+            return true;
+
+        /* Splicing is not supported by these descriptors - copy through a
+         * userspace buffer from now on */
+        connection->spliced = false;
+
+    }
+#endif
+
+    int length = read(endpoint->fd, endpoint->buffer, sizeof(endpoint->buffer));
+    if (length == 0)
+        return true;
+
+    if (length < 0)
+        return !(errno == EAGAIN || errno == EINTR);
+
+    endpoint->pending_in_pipe = false;
+    endpoint->pending_offset = 0;
+    endpoint->pending_length = length;
+
+    return guacd_connection_io_flush(endpoint);
+
+}
+
+/**
+ * Services a single epoll event delivered for the given endpoint: flushing
+ * any data pending toward the endpoint's file descriptor if it has become
+ * writable, relaying newly ready data if it has become readable, and rearming
+ * both the endpoint and its peer per their resulting needs. If the connection
+ * has terminated (or terminates during servicing), the endpoint retires
+ * instead, and the connection is freed once both endpoints have retired.
+ *
+ * @param endpoint
+ *     The endpoint for which an event was received.
+ *
+ * @param events
+ *     The events which were received.
+ */
+static void guacd_connection_io_service(
+        guacd_connection_io_endpoint* endpoint, uint32_t events) {
+
+    guacd_connection_io* connection = endpoint->connection;
+    guacd_connection_io_endpoint* peer = guacd_connection_io_peer(endpoint);
+
+    bool free_connection = false;
+
+    pthread_mutex_lock(&guacd_connection_io_pool.lock);
+
+    /* If another worker is already servicing this endpoint (possible if the
+     * endpoint was rearmed on behalf of its peer just as an earlier event was
+     * being delivered), leave the event for that worker */
+    if (endpoint->in_service) {
+        endpoint->deferred_events |= events;
+        pthread_mutex_unlock(&guacd_connection_io_pool.lock);
+        return;
+    }
+
+    /* A final event following teardown simply retires the endpoint (oneshot
+     * registrations are disarmed upon delivery, and retired endpoints are
+     * never rearmed) */
+    if (connection->closed) {
+
+        if (!endpoint->retired) {
+            endpoint->retired = true;
+            if (--connection->refs == 0)
+                free_connection = true;
+        }
+
+        pthread_mutex_unlock(&guacd_connection_io_pool.lock);
+
+        if (free_connection)
+            guacd_connection_io_free(connection);
+
+        return;
+
+    }
+
+    endpoint->in_service = true;
+    endpoint->armed = 0;
+    pthread_mutex_unlock(&guacd_connection_io_pool.lock);
+
+    for (;;) {
+
+        bool error = false;
+
+        /* Flush data bound for this endpoint's file descriptor now that it
+         * has become writable (such data is pending within the peer, which
+         * reads in the direction this endpoint's file descriptor is the
+         * destination of) */
+        if (events & EPOLLOUT)
+            error = guacd_connection_io_flush(peer);
+
+        /* Relay newly ready data unless this direction is corked awaiting
+         * writability of its destination */
+        if (!error && (events & EPOLLIN) && endpoint->pending_length == 0)
+            error = guacd_connection_io_relay(endpoint);
+
+        /* Error/hangup conditions are reported by epoll regardless of the
+         * events requested; if neither transfer path above could run (and
+         * thereby observe the failure), tear down directly rather than rearm
+         * and spin on redeliveries of the same condition */
+        if (!error && (events & (EPOLLERR | EPOLLHUP))
+                && !(events & (EPOLLIN | EPOLLOUT)))
+            error = true;
+
+        pthread_mutex_lock(&guacd_connection_io_pool.lock);
+
+        if (error)
+            guacd_connection_io_teardown(connection);
+
+        /* Service any events which arrived while servicing was in progress */
+        if (!connection->closed && endpoint->deferred_events) {
+            events = endpoint->deferred_events;
+            endpoint->deferred_events = 0;
+            pthread_mutex_unlock(&guacd_connection_io_pool.lock);
+            continue;
+        }
+
+        endpoint->in_service = false;
+
+        /* Rearm both endpoints per their current needs (flushing pending
+         * data on behalf of the peer may require rearming the peer for
+         * readability, and leaving data pending may require arming the peer
+         * for writability) */
+        if (!connection->closed) {
+            guacd_connection_io_arm(endpoint);
+            if (!connection->closed)
+                guacd_connection_io_arm(peer);
+        }
+
+        if (connection->closed) {
+
+            /* Retire this endpoint */
+            if (!endpoint->retired) {
+                endpoint->retired = true;
+                if (--connection->refs == 0)
+                    free_connection = true;
+            }
+
+            /* Retire the peer on its behalf if it can never receive another
+             * event (it is disarmed and no worker is servicing it) */
+            if (!peer->retired && !peer->in_service && peer->armed == 0) {
+                peer->retired = true;
+                if (--connection->refs == 0)
+                    free_connection = true;
+            }
+
+        }
+
+        pthread_mutex_unlock(&guacd_connection_io_pool.lock);
+
+        if (free_connection)
+            guacd_connection_io_free(connection);
+
+        return;
+
+    }
+
+}
+
+/**
+ * Worker thread which services all multiplexed connections, performing the
+ * transfers indicated by each received epoll event. As all registrations are
+ * oneshot, each ready file descriptor is delivered to exactly one worker,
+ * which rearms that descriptor only after the transfer has completed. All
+ * transfers are non-blocking, so a worker is occupied only while actually
+ * moving data, never while waiting on a slow peer.
+ *
+ * @param data
+ *     Unused.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guacd_connection_io_worker(void* data) {
+
+    for (;;) {
+
+        /* Wait for the next connection requiring attention */
+        struct epoll_event event;
+        int result = epoll_wait(guacd_connection_io_pool.epoll_fd, &event, 1, -1);
+        if (result < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        if (result == 0)
+            continue;
+
+        guacd_connection_io_service(
+                (guacd_connection_io_endpoint*) event.data.ptr, event.events);
+
+    }
+
+    return NULL;
+
+}
+
+/**
+ * Starts the shared epoll worker pool if it is not already running. The lock
+ * of guacd_connection_io_pool must be held by the caller.
+ *
+ * @return
+ *     Zero if the worker pool is running, non-zero if the pool could not be
+ *     started.
+ */
+static int guacd_connection_io_pool_start(void) {
+
+    /* Nothing to do if the pool has already been started */
+    if (guacd_connection_io_pool.epoll_fd != -1)
+        return 0;
+
+    int epoll_fd = epoll_create1(0);
+    if (epoll_fd == -1) {
+        guacd_log(GUAC_LOG_WARNING, "Unable to create epoll instance for "
+                "I/O transfer: %s", strerror(errno));
+        return 1;
+    }
+
+    guacd_connection_io_pool.epoll_fd = epoll_fd;
+
+    /* Size the pool relative to the number of processors available (workers
+     * never block on any single connection, so transfer work is purely
+     * CPU-bound) */
+    int threads = GUACD_CONNECTION_IO_MIN_THREADS;
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    if (processors > threads)
+        threads = (processors <= GUACD_CONNECTION_IO_MAX_THREADS)
+            ? (int) processors : GUACD_CONNECTION_IO_MAX_THREADS;
+
+    /* Start pool of worker threads servicing the epoll instance */
+    for (int i = 0; i < threads; i++) {
+
+        pthread_t worker_thread;
+        if (pthread_create(&worker_thread, NULL,
+                    guacd_connection_io_worker, NULL)) {
+
+            /* Closing the epoll instance terminates any workers already
+             * started */
+            guacd_log(GUAC_LOG_WARNING, "Unable to start I/O transfer "
+                    "worker threads: %s", strerror(errno));
+            close(epoll_fd);
+            guacd_connection_io_pool.epoll_fd = -1;
+            return 1;
+
+        }
+
+        pthread_detach(worker_thread);
+
+    }
+
+    return 0;
+
+}
+
+/**
+ * Sets or clears the O_NONBLOCK flag of the given file descriptor.
+ *
+ * @param fd
+ *     The file descriptor to modify.
+ *
+ * @param nonblocking
+ *     Whether the file descriptor should be non-blocking.
+ *
+ * @return
+ *     Zero on success, non-zero on failure.
+ */
+static int guacd_connection_set_nonblocking(int fd, bool nonblocking) {
+
+    int flags = fcntl(fd, F_GETFL);
+    if (flags == -1)
+        return 1;
+
+    if (nonblocking)
+        flags |= O_NONBLOCK;
+    else
+        flags &= ~O_NONBLOCK;
+
+    return fcntl(fd, F_SETFL, flags) == -1;
+
+}
+
+/**
+ * Hands the given connection off to the shared epoll worker pool, which will
+ * transfer data back and forth between the guacd-side guac_socket and the
+ * file descriptor used by the process-side guac_socket without requiring
+ * dedicated threads. Upon success, the provided guac_parser is freed, and
+ * ownership of the guac_socket and file descriptor passes to the worker pool
+ * (both will be freed/closed once the connection terminates). Upon failure,
+ * ownership of all provided resources remains with the caller.
+ *
+ * @param parser
+ *     The guac_parser which may contain buffered, but unparsed, data from the
+ *     given guac_socket which must be transferred to the connection-specific
+ *     process.
+ *
+ * @param socket
+ *     The guac_socket which is directly handling I/O from a user's connection
+ *     to guacd.
+ *
+ * @param socket_fd
+ *     The file descriptor underlying the given guac_socket.
+ *
+ * @param fd
+ *     The file descriptor which is being handled by a guac_socket within the
+ *     connection-specific process.
+ *
+ * @return
+ *     Zero if the connection was successfully handed off to the worker pool,
+ *     non-zero if the connection must instead be serviced by a dedicated pair
+ *     of I/O threads.
+ */
+static int guacd_connection_multiplex(guac_parser* parser, guac_socket* socket,
+        int socket_fd, int fd) {
+
+    /* Ensure the shared worker pool is running */
+    pthread_mutex_lock(&guacd_connection_io_pool.lock);
+    if (guacd_connection_io_pool_start()) {
+        pthread_mutex_unlock(&guacd_connection_io_pool.lock);
+        return 1;
+    }
+    pthread_mutex_unlock(&guacd_connection_io_pool.lock);
+
+    /* Transfer all data buffered by the parser before monitoring the
+     * underlying file descriptor (such data would otherwise go unnoticed) */
+    char buffer[8192];
+    int length;
+    while ((length = guac_parser_shift(parser, buffer, sizeof(buffer))) > 0) {
+        if (__write_all(fd, buffer, length) < 0)
+            return 1;
+    }
+
+    /* All transfer performed by the worker pool is non-blocking, such that no
+     * worker can be monopolized by a connection whose peer has stopped
+     * reading. Both descriptors must be restored to blocking if the
+     * connection instead falls back to dedicated threads. */
+    if (guacd_connection_set_nonblocking(fd, true)
+            || guacd_connection_set_nonblocking(socket_fd, true)) {
+        guacd_connection_set_nonblocking(fd, false);
+        guacd_connection_set_nonblocking(socket_fd, false);
+        return 1;
+    }
+
+    guacd_connection_io* connection =
+        guac_mem_alloc(sizeof(guacd_connection_io));
+
+    connection->socket = socket;
+    connection->fd = fd;
+    connection->closed = false;
+    connection->refs = 2;
+
+    for (int i = 0; i < 2; i++) {
+        connection->endpoints[i].connection = connection;
+        connection->endpoints[i].armed = 0;
+        connection->endpoints[i].in_service = false;
+        connection->endpoints[i].deferred_events = 0;
+        connection->endpoints[i].retired = false;
+        connection->endpoints[i].pending_offset = 0;
+        connection->endpoints[i].pending_length = 0;
+        connection->endpoints[i].pending_in_pipe = false;
+    }
+
+    connection->endpoints[0].fd = fd;
+    connection->endpoints[1].fd = socket_fd;
+
+#ifdef HAVE_SPLICE
+    /* Each endpoint relays data through its own pipe where splice() is
+     * supported, falling back to userspace copies if pipes are unavailable */
+    connection->spliced = true;
+    for (int i = 0; i < 2; i++) {
+        if (pipe(connection->endpoints[i].pipe_fds)) {
+            connection->endpoints[i].pipe_fds[0] = -1;
+            connection->endpoints[i].pipe_fds[1] = -1;
+            connection->spliced = false;
+        }
+    }
+#else
+    connection->spliced = false;
+    connection->endpoints[0].pipe_fds[0] = -1;
+    connection->endpoints[0].pipe_fds[1] = -1;
+    connection->endpoints[1].pipe_fds[0] = -1;
+    connection->endpoints[1].pipe_fds[1] = -1;
+#endif
+
+    pthread_mutex_lock(&guacd_connection_io_pool.lock);
+
+    struct epoll_event event = {
+        .events = EPOLLIN | EPOLLONESHOT,
+        .data = { .ptr = &connection->endpoints[0] }
+    };
+
+    /* Nothing has yet been registered if monitoring of the first endpoint
+     * fails, and the caller may safely fall back to dedicated threads */
+    if (epoll_ctl(guacd_connection_io_pool.epoll_fd, EPOLL_CTL_ADD,
+                fd, &event)) {
+        pthread_mutex_unlock(&guacd_connection_io_pool.lock);
+        guacd_connection_io_close_pipes(connection);
+        guac_mem_free(connection);
+        guacd_connection_set_nonblocking(fd, false);
+        guacd_connection_set_nonblocking(socket_fd, false);
+        return 1;
+    }
+
+    connection->endpoints[0].armed = EPOLLIN;
+
+    event.data.ptr = &connection->endpoints[1];
+
+    bool free_connection = false;
+
+    /* The first endpoint may already have been delivered to a worker if
+     * monitoring of the second endpoint fails, so the connection cannot
+     * simply be unregistered and freed here. Tear it down through the normal
+     * path instead (the worker pool now owns the socket and descriptor),
+     * retiring the never-registered second endpoint on its behalf. */
+    if (epoll_ctl(guacd_connection_io_pool.epoll_fd, EPOLL_CTL_ADD,
+                socket_fd, &event)) {
+
+        guacd_connection_io_teardown(connection);
+
+        connection->endpoints[1].retired = true;
+        if (--connection->refs == 0)
+            free_connection = true;
+
+    }
+    else
+        connection->endpoints[1].armed = EPOLLIN;
+
+    pthread_mutex_unlock(&guacd_connection_io_pool.lock);
+
+    if (free_connection)
+        guacd_connection_io_free(connection);
+
+    /* Parser is no longer needed */
+    guac_parser_free(parser);
+
+    return 0;
+
+}
+
+#endif /* HAVE_SYS_EPOLL_H */
+
 /**
  * Continuously reads from a guac_socket, writing all data read to a file
  * descriptor. Any data already buffered from that guac_socket by a given
@@ -106,12 +995,14 @@ static int __write_all(int fd, char* buffer, int length) {
 static void* guacd_connection_write_thread(void* data) {
 
     guacd_connection_io_thread_params* params = (guacd_connection_io_thread_params*) data;
-    char buffer[8192];
+
+    int buffer_size = GUACD_CONNECTION_BUFFER_SIZE;
+    char* buffer = guac_mem_alloc(buffer_size);
 
     int length;
 
     /* Read all buffered data from parser first */
-    while ((length = guac_parser_shift(params->parser, buffer, sizeof(buffer))) > 0) {
+    while ((length = guac_parser_shift(params->parser, buffer, buffer_size)) > 0) {
         if (__write_all(params->fd, buffer, length) < 0)
             break;
     }
@@ -120,11 +1011,23 @@ static void* guacd_connection_write_thread(void* data) {
     guac_parser_free(params->parser);
 
     /* Transfer data from file descriptor to socket */
-    while ((length = guac_socket_read(params->socket, buffer, sizeof(buffer))) > 0) {
+    while ((length = guac_socket_read(params->socket, buffer, buffer_size)) > 0) {
+
         if (__write_all(params->fd, buffer, length) < 0)
             break;
+
+        /* Reads which fill the buffer entirely suggest more data is already
+         * pending - grow the buffer to move that data in fewer passes */
+        if (length == buffer_size
+                && buffer_size < GUACD_CONNECTION_BUFFER_MAX) {
+            guac_mem_free(buffer);
+            buffer_size *= 2;
+            buffer = guac_mem_alloc(buffer_size);
+        }
+
     }
 
+    guac_mem_free(buffer);
     return NULL;
 
 }
@@ -132,7 +1035,9 @@ static void* guacd_connection_write_thread(void* data) {
 void* guacd_connection_io_thread(void* data) {
 
     guacd_connection_io_thread_params* params = (guacd_connection_io_thread_params*) data;
-    char buffer[8192];
+
+    int buffer_size = GUACD_CONNECTION_BUFFER_SIZE;
+    char* buffer = guac_mem_alloc(buffer_size);
 
     int length;
 
@@ -140,12 +1045,25 @@ void* guacd_connection_io_thread(void* data) {
     pthread_create(&write_thread, NULL, guacd_connection_write_thread, params);
 
     /* Transfer data from file descriptor to socket */
-    while ((length = read(params->fd, buffer, sizeof(buffer))) > 0) {
+    while ((length = read(params->fd, buffer, buffer_size)) > 0) {
+
         if (guac_socket_write(params->socket, buffer, length))
             break;
         guac_socket_flush(params->socket);
+
+        /* Reads which fill the buffer entirely suggest more data is already
+         * pending - grow the buffer to move that data in fewer passes */
+        if (length == buffer_size
+                && buffer_size < GUACD_CONNECTION_BUFFER_MAX) {
+            guac_mem_free(buffer);
+            buffer_size *= 2;
+            buffer = guac_mem_alloc(buffer_size);
+        }
+
     }
 
+    guac_mem_free(buffer);
+
     /* Wait for write thread to die */
     pthread_join(write_thread, NULL);
 
@@ -178,10 +1096,17 @@ void* guacd_connection_io_thread(void* data) {
  *     The socket associated with the user to be added to the existing
  *     process.
  *
+ * @param socket_fd
+ *     The file descriptor underlying the given guac_socket, if that
+ *     descriptor may be monitored directly for readability, or -1 otherwise
+ *     (such as when I/O is encrypted and the socket may buffer data beyond
+ *     what the descriptor indicates).
+ *
  * @return
  *     Zero if the user was added successfully, non-zero if an error occurred.
  */
-static int guacd_add_user(guacd_proc* proc, guac_parser* parser, guac_socket* socket) {
+static int guacd_add_user(guacd_proc* proc, guac_parser* parser, guac_socket* socket,
+        int socket_fd) {
 
     int sockets[2];
 
@@ -203,6 +1128,14 @@ static int guacd_add_user(guacd_proc* proc, guac_parser* parser, guac_socket* so
     /* Close our end of the process file descriptor */
     close(proc_fd);
 
+#ifdef HAVE_SYS_EPOLL_H
+    /* Prefer servicing the connection via the shared epoll worker pool,
+     * which avoids dedicating a pair of threads to every connection */
+    if (socket_fd != -1
+            && !guacd_connection_multiplex(parser, socket, socket_fd, user_fd))
+        return 0;
+#endif
+
     guacd_connection_io_thread_params* params = guac_mem_alloc(sizeof(guacd_connection_io_thread_params));
     params->parser = parser;
     params->socket = socket;
@@ -233,11 +1166,16 @@ static int guacd_add_user(guacd_proc* proc, guac_parser* parser, guac_socket* so
  *     The socket associated with the new connection that must be routed to
  *     a new or existing process within the given map.
  *
+ * @param socket_fd
+ *     The file descriptor underlying the given guac_socket, if that
+ *     descriptor may be monitored directly for readability, or -1 otherwise.
+ *
  * @return
  *     Zero if the connection was successfully routed, non-zero if routing has
  *     failed.
  */
-static int guacd_route_connection(guacd_proc_map* map, guac_socket* socket) {
+static int guacd_route_connection(guacd_proc_map* map, guac_socket* socket,
+        int socket_fd) {
 
     guac_parser* parser = guac_parser_alloc();
 
@@ -253,6 +1191,7 @@ static int guacd_route_connection(guacd_proc_map* map, guac_socket* socket) {
         guacd_log_guac_error(GUAC_LOG_DEBUG,
                 "Error reading \"select\"");
 
+        guacd_admission_handshake_complete();
         guac_parser_free(parser);
         return 1;
     }
@@ -265,6 +1204,7 @@ static int guacd_route_connection(guacd_proc_map* map, guac_socket* socket) {
         guacd_log(GUAC_LOG_ERROR, "Bad number of arguments to \"select\" (%i)",
                 parser->argc);
 
+        guacd_admission_handshake_complete();
         guac_parser_free(parser);
         return 1;
     }
@@ -308,12 +1248,19 @@ static int guacd_route_connection(guacd_proc_map* map, guac_socket* socket) {
     /* Abort if no process exists for the requested connection */
     if (proc == NULL) {
         guacd_log_guac_error(GUAC_LOG_INFO, "Connection did not succeed");
+        guacd_admission_handshake_complete();
         guac_parser_free(parser);
         return 1;
     }
 
     /* Add new user (in the case of a new process, this will be the owner */
-    int add_user_failed = guacd_add_user(proc, parser, socket);
+    int add_user_failed = guacd_add_user(proc, parser, socket, socket_fd);
+
+    /* Whether or not the user could be added, the handshake phase of this
+     * connection is now over, and its slot should be released for future
+     * handshakes (this function continues to block for the lifetime of any
+     * newly-created process) */
+    guacd_admission_handshake_complete();
 
     /* If new process was created, manage that process */
     if (new_process) {
@@ -371,6 +1318,7 @@ void* guacd_connection_thread(void* data) {
     int connected_socket_fd = params->connected_socket_fd;
 
     guac_socket* socket;
+    int socket_fd = connected_socket_fd;
 
 #ifdef ENABLE_SSL
 
@@ -378,13 +1326,21 @@ void* guacd_connection_thread(void* data) {
 
     /* If SSL chosen, use it */
     if (ssl_context != NULL) {
+
         socket = guac_socket_open_secure(ssl_context, connected_socket_fd);
         if (socket == NULL) {
             guacd_log_guac_error(GUAC_LOG_ERROR, "Unable to set up SSL/TLS");
+            guacd_admission_handshake_complete();
             close(connected_socket_fd);
             guac_mem_free(params);
             return NULL;
         }
+
+        /* Decrypted data may remain buffered within the SSL layer beyond
+         * what the underlying file descriptor indicates, so the descriptor
+         * cannot be monitored directly for readability */
+        socket_fd = -1;
+
     }
     else
         socket = guac_socket_open(connected_socket_fd);
@@ -395,7 +1351,7 @@ void* guacd_connection_thread(void* data) {
 #endif
 
     /* Route connection according to Guacamole, creating a new process if needed */
-    if (guacd_route_connection(map, socket))
+    if (guacd_route_connection(map, socket, socket_fd))
         guac_socket_free(socket);
 
     guac_mem_free(params);
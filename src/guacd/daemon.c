@@ -19,14 +19,22 @@
 
 #include "config.h"
 
+#include "admission.h"
 #include "conf.h"
 #include "conf-args.h"
 #include "conf-file.h"
 #include "connection.h"
 #include "log.h"
+#include "proc.h"
 #include "proc-map.h"
 
+#include <guacamole/client.h>
+#include <guacamole/error.h>
 #include <guacamole/mem.h>
+#include <guacamole/protocol.h>
+#include <guacamole/socket.h>
+#include <guacamole/string.h>
+#include <guacamole/wol.h>
 
 #ifdef ENABLE_SSL
 #include <openssl/ssl.h>
@@ -37,6 +45,7 @@
 #include <libgen.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <pthread.h>
 #include <signal.h>
 #include <stdio.h>
@@ -52,6 +61,26 @@
 #define GUACD_DEV_NULL "/dev/null"
 #define GUACD_ROOT     "/"
 
+/**
+ * The maximum number of bytes of not-yet-sent data that may accumulate within
+ * the kernel send buffer of a client connection before further writes block.
+ * Bounding the unsent backlog keeps small, latency-critical instructions
+ * (sync, audio, cursor updates) from queueing behind megabytes of image data
+ * within the kernel, where no userspace reordering can reach them. The
+ * watermark only limits unsent data; the congestion window and data in flight
+ * are unaffected, so throughput on healthy links is unchanged.
+ */
+#define GUACD_TCP_NOTSENT_LOWAT 32768
+
+#ifdef ENABLE_SSL
+/**
+ * The session ID context used to scope TLS sessions cached by guacd. OpenSSL
+ * requires that a session ID context be assigned before server-side session
+ * caching may be enabled.
+ */
+#define GUACD_SSL_SESSION_ID_CONTEXT "guacd"
+#endif
+
 /**
  * Redirects the given file descriptor to /dev/null. The given flags must match
  * the read/write flags of the file descriptor given (if the given file
@@ -271,6 +300,54 @@ static void signal_stop_handler(int signal) {
 
 }
 
+/**
+ * A flag that, if non-zero, indicates that the configuration should be
+ * reloaded before the next connection is accepted.
+ */
+static int reload_config = 0;
+
+/**
+ * A signal handler that will set a flag telling the daemon to reload its
+ * configuration. The signal itself will cause any pending accept() call to be
+ * interrupted, such that the reload is applied promptly rather than only once
+ * the next connection arrives.
+ *
+ * @param signal
+ *     The signal that was received. Unused in this function since only
+ *     signals that should result in a configuration reload should invoke
+ *     this.
+ */
+static void signal_reload_handler(int signal) {
+
+    /* Instruct the daemon to reload its configuration */
+    reload_config = 1;
+
+}
+
+/**
+ * Returns whether the given pair of configuration strings are equal, either
+ * of which may be NULL.
+ *
+ * @param a
+ *     The first string to compare, which may be NULL.
+ *
+ * @param b
+ *     The second string to compare, which may be NULL.
+ *
+ * @return
+ *     Non-zero if the given strings are equal (or both NULL), zero
+ *     otherwise.
+ */
+static int guacd_conf_str_equal(const char* a, const char* b) {
+
+    if (a == NULL || b == NULL)
+        return a == b;
+
+    return strcmp(a, b) == 0;
+
+}
+
+
 /**
  * A callback for guacd_proc_map_foreach which will stop every process in the
  * map.
@@ -291,6 +368,120 @@ static void stop_process_callback(guacd_proc* proc, void* data) {
 
 }
 
+/**
+ * Loads the protocol plugin of each protocol named within the given
+ * comma-separated list into the main guacd process, resolving all plugin
+ * symbols immediately. Connection processes forked later inherit the loaded
+ * plugins copy-on-write, and their own loading of a preloaded plugin involves
+ * no dynamic-linker work. Failure to preload a plugin is logged but is not
+ * fatal, as the plugin may still load normally when first used.
+ *
+ * @param protocols
+ *     The comma-separated list of the names of the protocols whose plugins
+ *     should be preloaded.
+ */
+static void guacd_preload_plugins(const char* protocols) {
+
+    char* protocols_copy = guac_strdup(protocols);
+
+    char* strtok_state;
+    char* protocol = strtok_r(protocols_copy, ",", &strtok_state);
+    while (protocol != NULL) {
+
+        if (guac_client_preload_plugin(protocol))
+            guacd_log(GUAC_LOG_WARNING, "Unable to preload plugin for "
+                    "protocol \"%s\": %s", protocol, guac_error_message);
+        else
+            guacd_log(GUAC_LOG_INFO, "Preloaded plugin for protocol \"%s\"",
+                    protocol);
+
+        protocol = strtok_r(NULL, ",", &strtok_state);
+
+    }
+
+    guac_mem_free(protocols_copy);
+
+}
+
+/**
+ * Reloads the guacd configuration, reapplying all settings that can take
+ * effect without restarting guacd. The new settings affect only connections
+ * accepted after the reload; established sessions continue with the settings
+ * they started with. Settings that are fixed at startup (the bind address
+ * and port, SSL/TLS certificate and key, pidfile, foreground status, and the
+ * path of the load metrics status file) are left unchanged, with a warning
+ * logged if the reloaded configuration differs. If the new configuration
+ * cannot be parsed, the current configuration is kept in its entirety.
+ *
+ * @param config
+ *     The currently-applied configuration.
+ *
+ * @param argc
+ *     The number of arguments originally given on the guacd command line,
+ *     which take precedence over the configuration file and are reapplied on
+ *     reload.
+ *
+ * @param argv
+ *     The arguments originally given on the guacd command line.
+ *
+ * @return
+ *     The configuration now applied: the newly-loaded configuration on
+ *     success (the given configuration having been freed), or the given
+ *     configuration unchanged if the reload failed.
+ */
+static guacd_config* guacd_reload_config(guacd_config* config,
+        int argc, char* argv[]) {
+
+    guacd_config* new_config = guacd_conf_load();
+    if (new_config == NULL || guacd_conf_parse_args(new_config, argc, argv)) {
+        guacd_log(GUAC_LOG_ERROR, "Reloaded configuration could not be "
+                "parsed. The current configuration will remain in effect.");
+        guacd_conf_free(new_config);
+        return config;
+    }
+
+    /* Warn if the reloaded configuration attempts to change settings that
+     * are fixed once guacd has started */
+    if (!guacd_conf_str_equal(new_config->bind_host, config->bind_host)
+            || !guacd_conf_str_equal(new_config->bind_port, config->bind_port))
+        guacd_log(GUAC_LOG_WARNING, "The address and port that guacd listens "
+                "on cannot be changed without restarting guacd.");
+
+#ifdef ENABLE_SSL
+    if (!guacd_conf_str_equal(new_config->cert_file, config->cert_file)
+            || !guacd_conf_str_equal(new_config->key_file, config->key_file))
+        guacd_log(GUAC_LOG_WARNING, "The SSL/TLS certificate and key of "
+                "guacd cannot be changed without restarting guacd.");
+#endif
+
+    if (!guacd_conf_str_equal(new_config->status_file, config->status_file))
+        guacd_log(GUAC_LOG_WARNING, "The path of the load metrics status "
+                "file cannot be changed without restarting guacd.");
+
+    /* Apply all settings that affect subsequently-accepted connections. Each
+     * is applied unconditionally such that limits can be relaxed or removed,
+     * not just imposed. */
+    guacd_log_level = new_config->max_log_level;
+    guac_mem_set_limit(new_config->connection_memory_limit * 1024 * 1024);
+    guacd_proc_set_cpu_affinity_groups(new_config->cpu_affinity_groups);
+    guacd_proc_set_niceness(new_config->connection_niceness);
+    guac_mem_set_huge_pages(new_config->enable_huge_pages);
+    guacd_proc_set_linger_timeout(new_config->connection_linger_timeout);
+    guacd_admission_update_limits(new_config);
+
+    /* Plugins already preloaded remain loaded; any newly-listed protocols
+     * are preloaded in addition */
+    if (new_config->preload_protocols != NULL)
+        guacd_preload_plugins(new_config->preload_protocols);
+
+    guacd_conf_free(config);
+    guacd_log(GUAC_LOG_INFO, "Configuration reloaded. New settings apply to "
+            "connections accepted from this point on.");
+
+    return new_config;
+
+}
+
 int main(int argc, char* argv[]) {
 
     /* Server */
@@ -308,7 +499,7 @@ int main(int argc, char* argv[]) {
     };
 
     /* Client */
-    struct sockaddr_in client_addr;
+    struct sockaddr_storage client_addr;
     socklen_t client_addr_len;
     int connected_socket_fd;
 
@@ -345,6 +536,53 @@ int main(int argc, char* argv[]) {
     guacd_log_level = config->max_log_level;
     openlog(GUACD_LOG_NAME, LOG_PID, LOG_DAEMON);
 
+    /* Apply per-connection memory limit, if any. The limit applies to each
+     * forked connection process, which inherits it here. */
+    if (config->connection_memory_limit > 0)
+        guac_mem_set_limit(config->connection_memory_limit * 1024 * 1024);
+
+    /* Apply CPU affinity grouping, if any. Each forked connection process
+     * will be restricted to one of the configured groups of CPUs. */
+    if (config->cpu_affinity_groups > 0)
+        guacd_proc_set_cpu_affinity_groups(config->cpu_affinity_groups);
+
+    /* Apply niceness for connection processes, if any. Each forked connection
+     * process (and thus every thread it creates) will run with this
+     * scheduling priority. */
+    if (config->connection_niceness != 0)
+        guacd_proc_set_niceness(config->connection_niceness);
+
+    /* Enable huge page backing for large buffers, if configured. The setting
+     * applies to each forked connection process, which inherits it here. */
+    if (config->enable_huge_pages)
+        guac_mem_set_huge_pages(1);
+
+    /* Allow users to rejoin recently-abandoned connections, if configured.
+     * Each forked connection process inherits this setting and will continue
+     * running for the configured time after its last user disconnects. */
+    if (config->connection_linger_timeout > 0)
+        guacd_proc_set_linger_timeout(config->connection_linger_timeout);
+
+    /* Preload the plugins of any configured protocols, such that forked
+     * connection processes inherit the already-resolved plugin mappings and
+     * skip dynamic-linker work during connection setup */
+    if (config->preload_protocols != NULL)
+        guacd_preload_plugins(config->preload_protocols);
+
+    /* Initialize connection admission control. Any configured limits on
+     * concurrent handshakes and per-source connection rate will be applied as
+     * connections are accepted, and the status file (if configured) will be
+     * maintained from this point onward. */
+    guacd_admission_init(map, config);
+
+    /* Share Wake-on-LAN state across all forked connection processes, such
+     * that concurrent connections to a single parked host coalesce into one
+     * wake cycle rather than each sending packets and polling on their own */
+    if (guac_wol_init_registry())
+        guacd_log(GUAC_LOG_WARNING, "Unable to initialize shared Wake-on-LAN "
+                "registry. Concurrent connections waking the same host will "
+                "not be coalesced.");
+
     /* Log start */
     guacd_log(GUAC_LOG_INFO, "Guacamole proxy daemon (guacd) version " VERSION " started");
 
@@ -467,6 +705,25 @@ int main(int argc, char* argv[]) {
         else
             guacd_log(GUAC_LOG_WARNING, "No certificate file given - SSL/TLS may not work.");
 
+        /* Enable server-side caching of established sessions, such that
+         * clients reconnecting shortly after a network interruption can
+         * resume their previous TLS sessions with an abbreviated handshake
+         * rather than repeating the full key exchange. Stateless resumption
+         * via session tickets is independently enabled by default within
+         * OpenSSL, but the session cache additionally covers clients that do
+         * not support tickets. All handshakes are performed within the main
+         * guacd process (connection processes receive established sockets),
+         * so a process-local cache is sufficient. */
+        SSL_CTX_set_session_id_context(ssl_context,
+                (const unsigned char*) GUACD_SSL_SESSION_ID_CONTEXT,
+                strlen(GUACD_SSL_SESSION_ID_CONTEXT));
+        SSL_CTX_set_session_cache_mode(ssl_context, SSL_SESS_CACHE_SERVER);
+
+        /* Allow OpenSSL to release per-connection I/O buffers while they are
+         * idle, bounding memory usage during bursts of simultaneous
+         * handshakes */
+        SSL_CTX_set_mode(ssl_context, SSL_MODE_RELEASE_BUFFERS);
+
     }
 #endif
 
@@ -516,6 +773,11 @@ int main(int argc, char* argv[]) {
     sigaction(SIGINT, &signal_stop_action, NULL);
     sigaction(SIGTERM, &signal_stop_action, NULL);
 
+    /* Reload the configuration on SIGHUP, applying the new settings to
+     * subsequently-accepted connections */
+    struct sigaction signal_reload_action = { .sa_handler = signal_reload_handler };
+    sigaction(SIGHUP, &signal_reload_action, NULL);
+
     /* Log listening status */
     guacd_log(GUAC_LOG_INFO, "Listening on host %s, port %s", bound_address, bound_port);
 
@@ -533,6 +795,13 @@ int main(int argc, char* argv[]) {
 
         pthread_t child_thread;
 
+        /* Apply any configuration reload requested via SIGHUP before
+         * accepting further connections */
+        if (reload_config) {
+            reload_config = 0;
+            config = guacd_reload_config(config, argc, argv);
+        }
+
         /* Accept connection */
         client_addr_len = sizeof(client_addr);
         connected_socket_fd = accept(socket_fd,
@@ -546,10 +815,63 @@ int main(int argc, char* argv[]) {
             continue;
         }
 
+        /* Apply any configured admission limits before spending further
+         * per-connection effort, such that connection storms degrade new
+         * connections rather than the sessions already established */
+        if (guacd_admission_try_admit((struct sockaddr*) &client_addr,
+                    client_addr_len)) {
+
+#ifdef ENABLE_SSL
+            /* If SSL/TLS is required, the connection cannot be told why it
+             * was rejected without first performing the very handshake that
+             * admission control exists to avoid, so it is simply closed */
+            if (ssl_context != NULL) {
+                close(connected_socket_fd);
+                continue;
+            }
+#endif
+
+            /* Otherwise, ward off the client with a protocol-level error
+             * before closing (freeing the guac_socket closes the underlying
+             * file descriptor) */
+            guac_socket* rejected_socket = guac_socket_open(connected_socket_fd);
+            guac_protocol_send_error(rejected_socket,
+                    "Server busy. Please try again later.",
+                    GUAC_PROTOCOL_STATUS_SERVER_BUSY);
+            guac_socket_flush(rejected_socket);
+            guac_socket_free(rejected_socket);
+            continue;
+
+        }
+
+        /* Disable Nagle's algorithm such that small latency-critical
+         * instructions are transmitted immediately rather than held pending
+         * coalescing with future writes (libguac already batches writes into
+         * reasonably-sized buffers at the guac_socket level) */
+        int tcp_nodelay = 1;
+        if (setsockopt(connected_socket_fd, IPPROTO_TCP, TCP_NODELAY,
+                    &tcp_nodelay, sizeof(tcp_nodelay)) < 0)
+            guacd_log(GUAC_LOG_DEBUG, "Unable to disable Nagle's algorithm "
+                    "on client connection: %s", strerror(errno));
+
+#ifdef TCP_NOTSENT_LOWAT
+        /* Bound the amount of unsent data that may queue within the kernel
+         * such that instructions written after a burst of image data are not
+         * delayed behind the entire burst */
+        int notsent_lowat = GUACD_TCP_NOTSENT_LOWAT;
+        if (setsockopt(connected_socket_fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT,
+                    &notsent_lowat, sizeof(notsent_lowat)) < 0)
+            guacd_log(GUAC_LOG_DEBUG, "Unable to limit unsent kernel send "
+                    "buffer backlog on client connection: %s",
+                    strerror(errno));
+#endif
+
         /* Create parameters for connection thread */
         guacd_connection_thread_params* params = guac_mem_alloc(sizeof(guacd_connection_thread_params));
         if (params == NULL) {
             guacd_log(GUAC_LOG_ERROR, "Could not create connection thread: %s", strerror(errno));
+            guacd_admission_handshake_complete();
+            close(connected_socket_fd);
             continue;
         }
 
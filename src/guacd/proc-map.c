@@ -24,28 +24,11 @@
 
 #include <guacamole/client.h>
 #include <guacamole/mem.h>
+#include <guacamole/rwlock.h>
 
 #include <stdlib.h>
 #include <string.h>
 
-/**
- * A value to be stored in the buckets, containing the guacd proc itself,
- * as well as a link to the element in the list of all guacd processes.
- */
-typedef struct guacd_proc_map_entry {
-
-    /**
-     * The guacd process itself.
-     */
-    guacd_proc* proc;
-
-    /**
-     * A pointer to the corresponding entry in the list of all processes.
-     */
-    guac_common_list_element* element;
-
-} guacd_proc_map_entry;
-
 /**
  * Returns a hash code based on the given connection ID.
  *
@@ -69,62 +52,137 @@ static unsigned int __guacd_client_hash(const char* str) {
 }
 
 /**
- * Locates the bucket corresponding to the hash code indicated by the given id,
- * where the hash code is dictated by __guacd_client_hash().  Each bucket is an
- * instance of guac_common_list.
+ * Locates the shard responsible for the hash code indicated by the given id,
+ * where the hash code is dictated by __guacd_client_hash().
  *
  * @param map
- *     The map to retrieve the hash bucket from.
+ *     The map to retrieve the shard from.
+ *
+ * @param id
+ *     The ID whose hash code determines the shard being retrieved.
+ *
+ * @return
+ *     The shard corresponding to the hash code for the given ID.
+ */
+static guacd_proc_map_shard* __guacd_proc_find_shard(guacd_proc_map* map,
+        const char* id) {
+
+    const int index = __guacd_client_hash(id) % GUACD_PROC_MAP_SHARDS;
+    return &(map->__shards[index]);
+
+}
+
+/**
+ * Returns the slot at which the probe sequence for the given ID begins within
+ * the hash table of the given shard. As the low-order bits of the hash code
+ * select the shard itself, they are excluded here to avoid clustering keys of
+ * the same shard within a fraction of its slots.
+ *
+ * @param shard
+ *     The shard whose hash table is being probed.
  *
  * @param id
- *     The ID whose hash code determines the bucket being retrieved.
+ *     The ID whose hash code determines the starting slot.
  *
  * @return
- *     The bucket corresponding to the hash code for the given ID, represented
- *     by a guac_common_list.
+ *     The index of the slot at which probing for the given ID should begin.
  */
-static guac_common_list* __guacd_proc_find_bucket(guacd_proc_map* map,
+static size_t __guacd_proc_initial_slot(guacd_proc_map_shard* shard,
         const char* id) {
 
-    const int index = __guacd_client_hash(id) % GUACD_PROC_MAP_BUCKETS;
-    return map->__buckets[index];
+    const unsigned int hash_value =
+        __guacd_client_hash(id) / GUACD_PROC_MAP_SHARDS;
+
+    return hash_value & (shard->capacity - 1);
 
 }
 
 /**
- * Given a bucket of guacd_proc instances, returns the guacd_proc having the
- * guac_client with the given ID, or NULL if no such client is stored.
+ * Given a shard of guacd_proc instances, returns the slot containing the
+ * guacd_proc having the guac_client with the given ID, or NULL if no such
+ * client is stored. The lock of the given shard must be held by the caller,
+ * for either reading or writing.
  *
- * @param bucket
- *     The bucket of guacd_proc instances to search, represented as a
- *     guac_common_list.
+ * @param shard
+ *     The shard of guacd_proc instances to search.
  *
  * @param id
- *     The ID of the guac_client whose corresponding guacd_proc instance should
- *     be located within the bucket.
+ *     The ID of the guac_client whose corresponding guacd_proc instance
+ *     should be located within the shard.
  *
  * @return
- *     The guac_common_list_element containing the guacd_proc instance
- *     corresponding to the guac_client having the given ID, or NULL of no such
- *     element exists.
+ *     The slot containing the guacd_proc instance corresponding to the
+ *     guac_client having the given ID, or NULL if no such slot exists.
  */
-static guac_common_list_element* __guacd_proc_find(guac_common_list* bucket,
+static guacd_proc_map_slot* __guacd_proc_find(guacd_proc_map_shard* shard,
         const char* id) {
 
-    guac_common_list_element* current = bucket->head;
+    size_t index = __guacd_proc_initial_slot(shard, id);
+
+    /* Walk probe sequence until an empty slot proves absence */
+    for (size_t i = 0; i < shard->capacity; i++) {
+
+        guacd_proc_map_slot* slot = &(shard->slots[index]);
+
+        if (slot->state == GUACD_PROC_MAP_SLOT_EMPTY)
+            return NULL;
+
+        /* Check connection ID (deleted slots must be probed past) */
+        if (slot->state == GUACD_PROC_MAP_SLOT_OCCUPIED
+                && strcmp(slot->proc->client->connection_id, id) == 0)
+            return slot;
+
+        index = (index + 1) & (shard->capacity - 1);
+
+    }
+
+    return NULL;
+
+}
+
+/**
+ * Replaces the hash table of the given shard with a table of the given
+ * capacity, rehashing all occupied slots and discarding all deleted slots.
+ * The lock of the given shard must be held by the caller for writing.
+ *
+ * @param shard
+ *     The shard whose hash table should be rebuilt.
+ *
+ * @param new_capacity
+ *     The number of slots within the replacement hash table. This value must
+ *     be a power of two and must exceed the number of occupied slots.
+ */
+static void __guacd_proc_rehash(guacd_proc_map_shard* shard,
+        size_t new_capacity) {
+
+    guacd_proc_map_slot* old_slots = shard->slots;
+    size_t old_capacity = shard->capacity;
+
+    shard->slots = guac_mem_zalloc(new_capacity,
+            sizeof(guacd_proc_map_slot));
+    shard->capacity = new_capacity;
 
-    /* Search for matching element within bucket */
-    while (current != NULL) {
+    /* Reinsert all stored processes into the replacement table */
+    for (size_t i = 0; i < old_capacity; i++) {
 
-        /* Check connection ID */
-        guacd_proc* proc = ((guacd_proc_map_entry*) current->data)->proc;
-        if (strcmp(proc->client->connection_id, id) == 0)
-            break;
+        guacd_proc_map_slot* old_slot = &(old_slots[i]);
+        if (old_slot->state != GUACD_PROC_MAP_SLOT_OCCUPIED)
+            continue;
+
+        size_t index = __guacd_proc_initial_slot(shard,
+                old_slot->proc->client->connection_id);
+
+        while (shard->slots[index].state == GUACD_PROC_MAP_SLOT_OCCUPIED)
+            index = (index + 1) & (shard->capacity - 1);
+
+        shard->slots[index] = *old_slot;
 
-        current = current->next;
     }
 
-    return current;
+    /* All deleted slots have now been discarded */
+    shard->used = shard->count;
+
+    guac_mem_free(old_slots);
 
 }
 
@@ -132,16 +190,19 @@ guacd_proc_map* guacd_proc_map_alloc() {
 
     guacd_proc_map* map = guac_mem_alloc(sizeof(guacd_proc_map));
     map->processes = guac_common_list_alloc();
-    guac_common_list** current;
 
-    int i;
+    /* Init all shards */
+    for (int i = 0; i < GUACD_PROC_MAP_SHARDS; i++) {
 
-    /* Init all buckets */
-    current = map->__buckets;
+        guacd_proc_map_shard* shard = &(map->__shards[i]);
+
+        guac_rwlock_init(&(shard->lock));
+        shard->slots = guac_mem_zalloc(GUACD_PROC_MAP_INITIAL_SLOTS,
+                sizeof(guacd_proc_map_slot));
+        shard->capacity = GUACD_PROC_MAP_INITIAL_SLOTS;
+        shard->count = 0;
+        shard->used = 0;
 
-    for (i=0; i<GUACD_PROC_MAP_BUCKETS; i++) {
-        *current = guac_common_list_alloc();
-        current++;
     }
 
     return map;
@@ -151,56 +212,67 @@ guacd_proc_map* guacd_proc_map_alloc() {
 int guacd_proc_map_add(guacd_proc_map* map, guacd_proc* proc) {
 
     const char* identifier = proc->client->connection_id;
-    guac_common_list* bucket = __guacd_proc_find_bucket(map, identifier);
-    guac_common_list_element* found;
-
-    /* Retrieve corresponding element, if any */
-    guac_common_list_lock(bucket);
-    found = __guacd_proc_find(bucket, identifier);
+    guacd_proc_map_shard* shard = __guacd_proc_find_shard(map, identifier);
 
-    /* If no such element, we can add the new client successfully */
-    if (found == NULL) {
+    guac_rwlock_acquire_write_lock(&(shard->lock));
 
-        guacd_proc_map_entry* entry = guac_mem_alloc(sizeof(guacd_proc_map_entry));
+    /* Fail if a process with the given ID already exists */
+    if (__guacd_proc_find(shard, identifier) != NULL) {
+        guac_rwlock_release_lock(&(shard->lock));
+        return 1;
+    }
 
-        guac_common_list_lock(map->processes);
-        entry->element = guac_common_list_add(map->processes, proc);
-        guac_common_list_unlock(map->processes);
+    /* Rebuild the hash table before probe sequences grow long, growing it
+     * only if occupancy (rather than accumulated deleted slots) is to blame */
+    if ((shard->used + 1) * 4 > shard->capacity * 3) {
 
-        entry->proc = proc;
+        size_t new_capacity = shard->capacity;
+        if ((shard->count + 1) * 2 > shard->capacity)
+            new_capacity = guac_mem_ckd_mul_or_die(shard->capacity, 2);
 
-        guac_common_list_add(bucket, entry);
-        guac_common_list_unlock(bucket);
+        __guacd_proc_rehash(shard, new_capacity);
 
-        return 0;
     }
 
-    /* Otherwise, fail - already exists */
-    guac_common_list_unlock(bucket);
-    return 1;
+    /* Insert at the first reusable slot along the probe sequence */
+    size_t index = __guacd_proc_initial_slot(shard, identifier);
+    while (shard->slots[index].state == GUACD_PROC_MAP_SLOT_OCCUPIED)
+        index = (index + 1) & (shard->capacity - 1);
+
+    guacd_proc_map_slot* slot = &(shard->slots[index]);
+
+    /* Inserting into a never-used slot lengthens probe sequences */
+    if (slot->state == GUACD_PROC_MAP_SLOT_EMPTY)
+        shard->used++;
+
+    guac_common_list_lock(map->processes);
+    slot->element = guac_common_list_add(map->processes, proc);
+    guac_common_list_unlock(map->processes);
+
+    slot->state = GUACD_PROC_MAP_SLOT_OCCUPIED;
+    slot->proc = proc;
+    shard->count++;
+
+    guac_rwlock_release_lock(&(shard->lock));
+    return 0;
 
 }
 
 guacd_proc* guacd_proc_map_retrieve(guacd_proc_map* map, const char* id) {
 
-    guacd_proc* proc;
+    guacd_proc* proc = NULL;
 
-    guac_common_list* bucket = __guacd_proc_find_bucket(map, id);
-    guac_common_list_element* found;
+    guacd_proc_map_shard* shard = __guacd_proc_find_shard(map, id);
 
-    /* Retrieve corresponding element, if any */
-    guac_common_list_lock(bucket);
-    found = __guacd_proc_find(bucket, id);
+    /* Lookups require no allocation and proceed concurrently with all other
+     * lookups against this shard */
+    guac_rwlock_acquire_read_lock(&(shard->lock));
 
-    /* If no such element, fail */
-    if (found == NULL) {
-        guac_common_list_unlock(bucket);
-        return NULL;
-    }
+    guacd_proc_map_slot* slot = __guacd_proc_find(shard, id);
+    if (slot != NULL)
+        proc = slot->proc;
 
-    proc = ((guacd_proc_map_entry*) found->data)->proc;
-
-    guac_common_list_unlock(bucket);
+    guac_rwlock_release_lock(&(shard->lock));
     return proc;
 
 }
@@ -209,32 +281,34 @@ guacd_proc* guacd_proc_map_remove(guacd_proc_map* map, const char* id) {
 
     guacd_proc* proc;
 
-    guac_common_list* bucket = __guacd_proc_find_bucket(map, id);
-    guac_common_list_element* found;
+    guacd_proc_map_shard* shard = __guacd_proc_find_shard(map, id);
+
+    guac_rwlock_acquire_write_lock(&(shard->lock));
 
-    /* Retrieve corresponding element, if any */
-    guac_common_list_lock(bucket);
-    found = __guacd_proc_find(bucket, id);
+    /* Retrieve corresponding slot, if any */
+    guacd_proc_map_slot* slot = __guacd_proc_find(shard, id);
 
-    /* If no such element, fail */
-    if (found == NULL) {
-        guac_common_list_unlock(bucket);
+    /* If no such slot, fail */
+    if (slot == NULL) {
+        guac_rwlock_release_lock(&(shard->lock));
         return NULL;
     }
 
-    guacd_proc_map_entry* entry = (guacd_proc_map_entry*) found->data;
-
     /* Find and remove the key from the process list */
     guac_common_list_lock(map->processes);
-    guac_common_list_remove(map->processes, entry->element);
+    guac_common_list_remove(map->processes, slot->element);
     guac_common_list_unlock(map->processes);
 
-    proc = entry->proc;
-    guac_common_list_remove(bucket, found);
+    proc = slot->proc;
 
-    free (entry);
+    /* Mark the slot as deleted (it remains part of any probe sequence
+     * passing through it until the table is next rebuilt) */
+    slot->state = GUACD_PROC_MAP_SLOT_DELETED;
+    slot->proc = NULL;
+    slot->element = NULL;
+    shard->count--;
 
-    guac_common_list_unlock(bucket);
+    guac_rwlock_release_lock(&(shard->lock));
     return proc;
 
 }
@@ -244,7 +318,9 @@ void guacd_proc_map_foreach(guacd_proc_map* map,
 
     guac_common_list* list = map->processes;
 
-    guac_common_list_lock(list);
+    /* Iteration requires only shared access, allowing concurrent foreach
+     * calls and lookups */
+    guac_common_list_lock_read(list);
 
     /* Invoke the callback for every element in the list */
     guac_common_list_element* element;
@@ -260,12 +336,13 @@ void guacd_proc_map_free(guacd_proc_map* map) {
     /* Free the list of all processes */
     guac_common_list_free(map->processes, NULL);
 
-    /* Free each bucket */
-    guac_common_list** buckets = map->__buckets;
-    int i;
-    for (i = 0; i < GUACD_PROC_MAP_BUCKETS; i++) {
-        guac_common_list_free(*(buckets + i), free);
+    /* Free each shard */
+    for (int i = 0; i < GUACD_PROC_MAP_SHARDS; i++) {
+        guacd_proc_map_shard* shard = &(map->__shards[i]);
+        guac_rwlock_destroy(&(shard->lock));
+        guac_mem_free(shard->slots);
     }
 
-}
+    guac_mem_free(map);
 
+}
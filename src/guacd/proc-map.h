@@ -25,6 +25,9 @@
 #include "proc.h"
 
 #include <guacamole/client.h>
+#include <guacamole/rwlock.h>
+
+#include <stddef.h>
 
 /**
  * The maximum number of concurrent connections to a single instance
@@ -38,9 +41,102 @@
 #define GUACD_THREAD_STACK_SIZE 8388608
 
 /**
- * The number of hash buckets in each process map.
+ * The number of independently-locked shards which make up each process map.
+ * Each connection ID is deterministically assigned to exactly one shard, and
+ * operations against distinct shards proceed without contending at all.
+ */
+#define GUACD_PROC_MAP_SHARDS 16
+
+/**
+ * The initial number of slots in the hash table of each shard. Shards grow
+ * automatically as processes are added. This value must be a power of two.
+ */
+#define GUACD_PROC_MAP_INITIAL_SLOTS 32
+
+/**
+ * The state of a single slot within the hash table of a shard.
  */
-#define GUACD_PROC_MAP_BUCKETS GUACD_CLIENT_MAX_CONNECTIONS*2
+typedef enum guacd_proc_map_slot_state {
+
+    /**
+     * The slot has never held a process. A probe sequence encountering this
+     * slot may stop searching.
+     */
+    GUACD_PROC_MAP_SLOT_EMPTY = 0,
+
+    /**
+     * The slot currently holds a process.
+     */
+    GUACD_PROC_MAP_SLOT_OCCUPIED,
+
+    /**
+     * The slot previously held a process which has since been removed. A
+     * probe sequence encountering this slot must continue searching.
+     */
+    GUACD_PROC_MAP_SLOT_DELETED
+
+} guacd_proc_map_slot_state;
+
+/**
+ * A single slot within the open-addressing hash table of a shard, containing
+ * the guacd proc itself, as well as a link to the element in the list of all
+ * guacd processes.
+ */
+typedef struct guacd_proc_map_slot {
+
+    /**
+     * The current state of this slot.
+     */
+    guacd_proc_map_slot_state state;
+
+    /**
+     * The guacd process itself. Meaningful only if this slot is occupied.
+     */
+    guacd_proc* proc;
+
+    /**
+     * A pointer to the corresponding entry in the list of all processes.
+     * Meaningful only if this slot is occupied.
+     */
+    guac_common_list_element* element;
+
+} guacd_proc_map_slot;
+
+/**
+ * One independently-locked shard of a process map: an open-addressing hash
+ * table of processes, protected by a reader-writer lock such that any number
+ * of lookups may proceed concurrently.
+ */
+typedef struct guacd_proc_map_shard {
+
+    /**
+     * Reader-writer lock protecting all other members of this shard.
+     */
+    guac_rwlock lock;
+
+    /**
+     * The hash table of this shard, resolving collisions through linear
+     * probing. The number of slots is always a power of two.
+     */
+    guacd_proc_map_slot* slots;
+
+    /**
+     * The total number of slots within the hash table of this shard.
+     */
+    size_t capacity;
+
+    /**
+     * The number of occupied slots within the hash table of this shard.
+     */
+    size_t count;
+
+    /**
+     * The number of slots within the hash table of this shard which are not
+     * empty (occupied or deleted), and which thus lengthen probe sequences.
+     */
+    size_t used;
+
+} guacd_proc_map_shard;
 
 /**
  * Set of all active connections to guacd, indexed by connection ID.
@@ -48,10 +144,10 @@
 typedef struct guacd_proc_map {
 
     /**
-     * Internal hash buckets. Each bucket is a linked list containing all
-     * guac_client instances which hash to this bucket location.
+     * Internal hash table shards. Each connection ID maps to exactly one
+     * shard. For internal use only.
      */
-    guac_common_list* __buckets[GUACD_PROC_MAP_BUCKETS];
+    guacd_proc_map_shard __shards[GUACD_PROC_MAP_SHARDS];
 
     /**
      * All processes present in the map. For internal use only. To operate on these
@@ -31,19 +31,147 @@
 #include <guacamole/plugin.h>
 #include <guacamole/protocol.h>
 #include <guacamole/socket.h>
+#include <guacamole/socket-queued.h>
+#include <guacamole/string.h>
+#include <guacamole/timestamp.h>
 #include <guacamole/user.h>
 
 #include <errno.h>
 #include <pthread.h>
+#include <sched.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/resource.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/wait.h>
 
+/**
+ * The "nice" value applied to a connection process once its last user has
+ * disconnected and only teardown remains. All remaining work within the
+ * process (the client free handler, display destruction, plugin unload) only
+ * releases resources and will never be observed by any user, while a mass
+ * disconnect causes many processes to tear down at the very moment that
+ * reconnecting users need CPU for handshakes and fresh connections. Lowering
+ * the priority of doomed processes keeps that teardown work off the critical
+ * path without deferring it.
+ */
+#define GUACD_TEARDOWN_NICE 10
+
+/**
+ * The interval at which a lingering connection process polls for users
+ * having rejoined the connection, in milliseconds.
+ */
+#define GUACD_PROC_LINGER_POLL_INTERVAL 250
+
+/**
+ * The amount of time that a connection process should continue running after
+ * its last user disconnects, in seconds, as set by
+ * guacd_proc_set_linger_timeout(). If zero, connection processes stop
+ * immediately when their last user disconnects.
+ */
+static int guacd_proc_linger_timeout = 0;
+
+void guacd_proc_set_linger_timeout(int seconds) {
+    guacd_proc_linger_timeout = seconds;
+}
+
+/**
+ * The number of groups that the CPUs available to guacd should be divided
+ * into when restricting the CPU affinity of connection processes, as set by
+ * guacd_proc_set_cpu_affinity_groups(). If zero, the CPU affinity of
+ * connection processes is not restricted.
+ */
+static int guacd_cpu_affinity_groups = 0;
+
+void guacd_proc_set_cpu_affinity_groups(int groups) {
+    guacd_cpu_affinity_groups = groups;
+}
+
+/**
+ * The niceness (scheduling priority adjustment) that connection processes
+ * should run with, as set by guacd_proc_set_niceness(). If zero, the
+ * scheduling priority of connection processes is left unchanged.
+ */
+static int guacd_niceness = 0;
+
+void guacd_proc_set_niceness(int niceness) {
+    guacd_niceness = niceness;
+}
+
+/**
+ * Restricts the CPU affinity of the current process to the given group, where
+ * the CPUs currently available to the process are divided into
+ * guacd_cpu_affinity_groups roughly-equal, contiguous groups. If the CPU
+ * affinity cannot be determined or applied, or if there are too few CPUs
+ * available for the configured number of groups, the affinity of the current
+ * process is left unchanged.
+ *
+ * This function does nothing on platforms lacking sched_getaffinity(), as the
+ * availability of sched_setaffinity() cannot then be assumed.
+ *
+ * @param group
+ *     The index of the CPU affinity group to restrict the current process to,
+ *     where 0 is the first group.
+ */
+static void guacd_proc_apply_cpu_affinity(int group) {
+
+#ifdef HAVE_SCHED_GETAFFINITY
+
+    cpu_set_t available;
+    CPU_ZERO(&available);
+
+    /* Determine which CPUs are actually available to this process (the
+     * affinity inherited from the main guacd process) */
+    if (sched_getaffinity(0, sizeof(available), &available))
+        return;
+
+    /* Refuse to restrict affinity further if there are fewer CPUs than
+     * groups (each group must receive at least one CPU) */
+    int available_count = CPU_COUNT(&available);
+    if (available_count < guacd_cpu_affinity_groups)
+        return;
+
+    /* Divide available CPUs into contiguous groups of roughly equal size,
+     * distributing any remainder across the leading groups */
+    int group_size = available_count / guacd_cpu_affinity_groups;
+    int remainder = available_count % guacd_cpu_affinity_groups;
+
+    /* Determine the indices (relative to the set of available CPUs) of the
+     * first and last CPUs in the requested group */
+    int first = group * group_size + (group < remainder ? group : remainder);
+    int last = first + group_size + (group < remainder ? 1 : 0) - 1;
+
+    cpu_set_t assigned;
+    CPU_ZERO(&assigned);
+
+    /* Add the requested group's contiguous range of available CPUs to the
+     * set of CPUs this process may use */
+    int cpu_index = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE && cpu_index <= last; cpu++) {
+        if (CPU_ISSET(cpu, &available)) {
+            if (cpu_index >= first)
+                CPU_SET(cpu, &assigned);
+            cpu_index++;
+        }
+    }
+
+    if (sched_setaffinity(0, sizeof(assigned), &assigned)) {
+        guacd_log(GUAC_LOG_WARNING, "Unable to restrict CPU affinity of "
+                "connection process: %s", strerror(errno));
+        return;
+    }
+
+    guacd_log(GUAC_LOG_DEBUG, "Restricted connection process to CPU "
+            "affinity group %i of %i.", group + 1, guacd_cpu_affinity_groups);
+
+#endif
+
+}
+
 /**
  * Parameters for the user thread.
  */
@@ -89,6 +217,25 @@ static void* guacd_user_thread(void* data) {
     if (socket == NULL)
         return NULL;
 
+    /* Queue all output in memory, such that one user on a slow connection
+     * cannot stall broadcast of frames to the other users of a shared
+     * connection. Users which lag too far behind are disconnected. */
+    guac_socket* queued_socket = guac_socket_queued(socket);
+    if (queued_socket == NULL) {
+        guac_socket_free(socket);
+        return NULL;
+    }
+    socket = queued_socket;
+
+    /* A non-owner joining a connection which currently has no users is
+     * adopting a parked (lingering) connection, reusing the established and
+     * already-authenticated remote desktop session rather than redoing DNS,
+     * TCP, and TLS/NLA or SSH key exchange from scratch */
+    if (!params->owner && client->connected_users == 0)
+        guacd_log(GUAC_LOG_INFO, "Parked connection \"%s\" is being adopted. "
+                "The established remote desktop session will be reused.",
+                client->connection_id);
+
     /* Create skeleton user */
     guac_user* user = guac_user_alloc();
     user->socket = socket;
@@ -98,6 +245,33 @@ static void* guacd_user_thread(void* data) {
     /* Handle user connection from handshake until disconnect/completion */
     guac_user_handle_connection(user, GUACD_USEC_TIMEOUT);
 
+    /* If configured, continue running for a short while after the last user
+     * disconnects, such that users on unreliable networks can rejoin the
+     * still-established connection (receiving the current display state upon
+     * rejoining) rather than suffer a full reconnect */
+    if (client->connected_users == 0 && guacd_proc_linger_timeout > 0
+            && client->state == GUAC_CLIENT_RUNNING) {
+
+        guacd_log(GUAC_LOG_INFO, "Last user of connection \"%s\" "
+                "disconnected. Connection will remain available for rejoin "
+                "for up to %i second(s).", client->connection_id,
+                guacd_proc_linger_timeout);
+
+        int linger_ms = guacd_proc_linger_timeout * 1000;
+        for (int elapsed = 0; elapsed < linger_ms; elapsed += GUACD_PROC_LINGER_POLL_INTERVAL) {
+
+            /* Stop lingering early if a user has rejoined or the client has
+             * stopped of its own accord */
+            if (client->connected_users > 0
+                    || client->state != GUAC_CLIENT_RUNNING)
+                break;
+
+            guac_timestamp_msleep(GUACD_PROC_LINGER_POLL_INTERVAL);
+
+        }
+
+    }
+
     /* Stop client and prevent future users if all users are disconnected */
     if (client->connected_users == 0) {
         guacd_log(GUAC_LOG_INFO, "Last user of connection \"%s\" disconnected", client->connection_id);
@@ -374,6 +548,14 @@ static void guacd_exec_proc(guacd_proc* proc, const char* protocol) {
     
 cleanup_client:
 
+    /* This process is now doomed and all remaining work is teardown that no
+     * user will ever observe. Deprioritize it such that mass disconnects do
+     * not steal CPU from the handshakes of replacement connections. */
+    errno = 0;
+    if (nice(GUACD_TEARDOWN_NICE) == -1 && errno != 0)
+        guacd_log(GUAC_LOG_DEBUG, "Unable to lower priority of connection "
+                "process for teardown: %s", strerror(errno));
+
     /* Request client to stop/disconnect */
     guac_client_stop(client);
 
@@ -408,6 +590,15 @@ cleanup_client:
 
 cleanup_process:
 
+    /* Surface the memory usage of this connection process, if tracked */
+    {
+        guac_mem_stats mem_stats;
+        guac_mem_get_stats(&mem_stats);
+        if (mem_stats.peak > 0)
+            guacd_log(GUAC_LOG_INFO, "Connection process used a peak of "
+                    "%zu KB of memory", mem_stats.peak / 1024);
+    }
+
     /* Free up all internal resources outside the client */
     close(proc->fd_socket);
     guac_mem_free(proc);
@@ -416,7 +607,22 @@ cleanup_process:
 
 }
 
-guacd_proc* guacd_create_proc(const char* protocol) {
+/**
+ * Forks and initializes a new background process for handling the given
+ * protocol, regardless of any pool of pre-forked processes. This is the
+ * "cold" creation path underlying guacd_create_proc(), which prefers handing
+ * out an already-warm process. Within the child process, this function does
+ * not return - the entire child process simply terminates instead.
+ *
+ * @param protocol
+ *     The protocol for which this process is being created.
+ *
+ * @return
+ *     A newly-allocated process structure pointing to the file descriptor of
+ *     the background process specific to the specified protocol, or NULL if
+ *     the process could not be created.
+ */
+static guacd_proc* guacd_proc_spawn(const char* protocol) {
 
     int sockets[2];
 
@@ -450,6 +656,16 @@ guacd_proc* guacd_create_proc(const char* protocol) {
     /* Init logging */
     proc->client->log_handler = guacd_client_log;
 
+    /* Assign CPU affinity groups round-robin across spawned processes. The
+     * counter is advanced here, within the parent, such that it persists
+     * across forks. */
+    static int next_affinity_group = 0;
+    int affinity_group = 0;
+    if (guacd_cpu_affinity_groups > 0) {
+        affinity_group = next_affinity_group;
+        next_affinity_group = (next_affinity_group + 1) % guacd_cpu_affinity_groups;
+    }
+
     /* Fork */
     proc->pid = fork();
     if (proc->pid < 0) {
@@ -468,6 +684,25 @@ guacd_proc* guacd_create_proc(const char* protocol) {
         proc->fd_socket = parent_socket;
         close(child_socket);
 
+        /* Restrict this connection process to its assigned group of CPUs, if
+         * affinity groups are configured. Any thread pools later sized
+         * relative to available processors (such as the worker threads of
+         * guac_display) will then be sized relative to the assigned group,
+         * and first-touch allocation will keep the memory used by those
+         * threads local to the CPUs actually running them. */
+        if (guacd_cpu_affinity_groups > 0)
+            guacd_proc_apply_cpu_affinity(affinity_group);
+
+        /* Adjust the scheduling priority of this connection process, if
+         * configured. All threads later created within the connection process
+         * (including the render, encoding, and diff threads of guac_display)
+         * inherit this niceness. */
+        if (guacd_niceness != 0
+                && setpriority(PRIO_PROCESS, 0, guacd_niceness) == -1)
+            guacd_log(GUAC_LOG_WARNING, "Unable to set niceness of "
+                    "connection process to %i: %s", guacd_niceness,
+                    strerror(errno));
+
         /* Start protocol-specific handling */
         guacd_exec_proc(proc, protocol);
 
@@ -486,6 +721,230 @@ guacd_proc* guacd_create_proc(const char* protocol) {
 
 }
 
+/**
+ * The number of warm, plugin-preloaded processes to keep forked and waiting
+ * for each protocol that has been requested at least once. Handing an
+ * accepted connection to a warm process skips the fork() and plugin load
+ * otherwise performed on the connection path.
+ */
+#define GUACD_PROC_POOL_SIZE 2
+
+/**
+ * A pool of warm processes for a single protocol. Each pooled process has
+ * already forked and loaded its protocol plugin, and is waiting to receive
+ * the file descriptors of users over its fd_socket.
+ */
+typedef struct guacd_proc_pool guacd_proc_pool;
+
+struct guacd_proc_pool {
+
+    /**
+     * The name of the protocol served by the processes of this pool.
+     */
+    char* protocol;
+
+    /**
+     * All warm processes currently available within this pool.
+     */
+    guacd_proc* procs[GUACD_PROC_POOL_SIZE];
+
+    /**
+     * The number of warm processes currently available within this pool.
+     */
+    int count;
+
+    /**
+     * Whether a background thread is currently replenishing this pool.
+     */
+    int refilling;
+
+    /**
+     * The next pool within the overall set of per-protocol pools, or NULL if
+     * this is the last pool.
+     */
+    guacd_proc_pool* next;
+
+};
+
+/**
+ * Lock which protects the set of all per-protocol pools, including the
+ * contents of each pool. Pools are created on first use of their protocol
+ * and persist for the life of guacd.
+ */
+static pthread_mutex_t guacd_proc_pools_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * The set of all per-protocol pools of warm processes.
+ */
+static guacd_proc_pool* guacd_proc_pools = NULL;
+
+/**
+ * Releases all resources held within the parent process for the given warm
+ * process, which is known to have terminated before it could be handed a
+ * connection (such as if its protocol plugin is not actually installed).
+ *
+ * @param proc
+ *     The terminated process to discard.
+ */
+static void guacd_proc_discard(guacd_proc* proc) {
+    close(proc->fd_socket);
+    guac_client_free(proc->client);
+    guac_mem_free(proc);
+}
+
+/**
+ * Removes any processes which have terminated while waiting within the given
+ * pool, reaping them and releasing their resources. The pool lock must be
+ * held by the caller.
+ *
+ * @param pool
+ *     The pool to remove terminated processes from.
+ */
+static void guacd_proc_pool_sweep(guacd_proc_pool* pool) {
+
+    int live = 0;
+
+    for (int i = 0; i < pool->count; i++) {
+
+        guacd_proc* proc = pool->procs[i];
+
+        /* Discard the process if it has terminated while pooled */
+        if (waitpid(proc->pid, NULL, WNOHANG) != 0) {
+            guacd_log(GUAC_LOG_DEBUG, "Discarding terminated pooled process "
+                    "for protocol \"%s\"", pool->protocol);
+            guacd_proc_discard(proc);
+        }
+
+        else
+            pool->procs[live++] = proc;
+
+    }
+
+    pool->count = live;
+
+}
+
+/**
+ * Thread which replenishes the given pool until it again contains
+ * GUACD_PROC_POOL_SIZE warm processes (or until a process cannot be
+ * created). Exactly one such thread runs per pool at any given time.
+ *
+ * @param data
+ *     A pointer to the guacd_proc_pool to replenish.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guacd_proc_pool_refill_thread(void* data) {
+
+    guacd_proc_pool* pool = (guacd_proc_pool*) data;
+
+    pthread_mutex_lock(&guacd_proc_pools_lock);
+    guacd_proc_pool_sweep(pool);
+
+    while (pool->count < GUACD_PROC_POOL_SIZE) {
+
+        /* Fork outside the lock (lookups against other pools need not wait
+         * on plugin load) */
+        pthread_mutex_unlock(&guacd_proc_pools_lock);
+        guacd_proc* proc = guacd_proc_spawn(pool->protocol);
+        pthread_mutex_lock(&guacd_proc_pools_lock);
+
+        if (proc == NULL)
+            break;
+
+        pool->procs[pool->count++] = proc;
+
+    }
+
+    pool->refilling = 0;
+    pthread_mutex_unlock(&guacd_proc_pools_lock);
+
+    return NULL;
+
+}
+
+/**
+ * Starts a background thread replenishing the given pool, if no such thread
+ * is already running. The pool lock must be held by the caller.
+ *
+ * @param pool
+ *     The pool to replenish.
+ */
+static void guacd_proc_pool_refill(guacd_proc_pool* pool) {
+
+    if (pool->refilling)
+        return;
+
+    pthread_t refill_thread;
+    if (pthread_create(&refill_thread, NULL,
+                guacd_proc_pool_refill_thread, pool))
+        return;
+
+    pthread_detach(refill_thread);
+    pool->refilling = 1;
+
+}
+
+/**
+ * Returns the pool of warm processes for the given protocol, creating that
+ * pool if it does not yet exist. The pool lock must be held by the caller.
+ *
+ * @param protocol
+ *     The name of the protocol to retrieve the pool for.
+ *
+ * @return
+ *     The pool of warm processes for the given protocol.
+ */
+static guacd_proc_pool* guacd_proc_pool_find(const char* protocol) {
+
+    /* Use existing pool, if any */
+    guacd_proc_pool* pool;
+    for (pool = guacd_proc_pools; pool != NULL; pool = pool->next) {
+        if (strcmp(pool->protocol, protocol) == 0)
+            return pool;
+    }
+
+    /* Create pool on first use of a protocol */
+    pool = guac_mem_zalloc(sizeof(guacd_proc_pool));
+    pool->protocol = guac_strdup(protocol);
+    pool->next = guacd_proc_pools;
+    guacd_proc_pools = pool;
+
+    return pool;
+
+}
+
+guacd_proc* guacd_create_proc(const char* protocol) {
+
+    guacd_proc* proc = NULL;
+
+    pthread_mutex_lock(&guacd_proc_pools_lock);
+
+    /* Prefer a warm process which has already forked and loaded its plugin,
+     * discarding any which have terminated while pooled */
+    guacd_proc_pool* pool = guacd_proc_pool_find(protocol);
+    guacd_proc_pool_sweep(pool);
+    if (pool->count > 0)
+        proc = pool->procs[--pool->count];
+
+    /* Begin restoring the pool for future connections (including the very
+     * first connection of a protocol, which is necessarily cold) */
+    guacd_proc_pool_refill(pool);
+
+    pthread_mutex_unlock(&guacd_proc_pools_lock);
+
+    if (proc != NULL) {
+        guacd_log(GUAC_LOG_DEBUG, "Using pre-forked process for protocol "
+                "\"%s\"", protocol);
+        return proc;
+    }
+
+    /* Fall back to creating the process on demand */
+    return guacd_proc_spawn(protocol);
+
+}
+
 /**
  * Kill the provided child guacd process. This function must be called by the
  * parent process, and will block until all processes associated with the
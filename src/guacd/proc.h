@@ -81,10 +81,12 @@ typedef struct guacd_proc {
 } guacd_proc;
 
 /**
- * Creates a new background process for handling the given protocol, returning
- * a structure allowing communication with and monitoring of the process
- * created. Within the child process, this function does not return - the
- * entire child process simply terminates instead.
+ * Returns a background process for handling the given protocol, returning a
+ * structure allowing communication with and monitoring of that process. A
+ * warm, pre-forked process which has already loaded the plugin for the given
+ * protocol is used if available, and a new process is forked otherwise. In
+ * the case that a new process is forked, this function does not return within
+ * the child process - the entire child process simply terminates instead.
  *
  * @param protocol
  *     The protocol for which this process is client being created.
@@ -96,6 +98,66 @@ typedef struct guacd_proc {
  */
 guacd_proc* guacd_create_proc(const char* protocol);
 
+/**
+ * Sets the number of groups that the CPUs available to guacd should be
+ * divided into for the sake of restricting the CPU affinity of future
+ * connection processes. Each process subsequently forked by
+ * guacd_create_proc() will be assigned one of these groups round-robin,
+ * restricting that process to a contiguous subset of the CPUs that guacd
+ * itself may use. If the number of groups is zero (the default), connection
+ * processes simply inherit the CPU affinity of the main guacd process.
+ *
+ * This has no effect on platforms lacking sched_setaffinity().
+ *
+ * @param groups
+ *     The number of CPU affinity groups to divide available CPUs into, or
+ *     zero if the CPU affinity of connection processes should not be
+ *     restricted.
+ */
+void guacd_proc_set_cpu_affinity_groups(int groups);
+
+/**
+ * Sets the niceness (scheduling priority adjustment) that future connection
+ * processes should run with. Each process subsequently forked by
+ * guacd_create_proc() will apply this niceness to itself immediately after
+ * forking, and all threads later created within that process inherit it. As
+ * lower niceness values denote higher priority, a negative value prioritizes
+ * interactive connection handling over other workloads sharing the host,
+ * while a positive value deprioritizes it. If the given niceness is zero (the
+ * default), the scheduling priority of connection processes is left
+ * unchanged.
+ *
+ * Note that negative niceness values typically require elevated privileges
+ * (CAP_SYS_NICE on Linux). If the configured niceness cannot be applied, a
+ * warning is logged and the connection process continues with its inherited
+ * priority.
+ *
+ * @param niceness
+ *     The niceness that connection processes should run with, where -20 is
+ *     the highest possible priority and 19 is the lowest, or zero if the
+ *     scheduling priority of connection processes should not be changed.
+ */
+void guacd_proc_set_niceness(int niceness);
+
+/**
+ * Sets the amount of time that connection processes should continue running
+ * after their last user disconnects, in seconds. While a process lingers, its
+ * remote desktop session remains established and users may rejoin using the
+ * existing connection ID, receiving the current display state rather than
+ * waiting for an entirely new connection. If the given timeout is zero (the
+ * default), connection processes stop immediately when their last user
+ * disconnects.
+ *
+ * As with all process-wide settings, this must be set before connection
+ * processes are forked in order to have any effect on those processes.
+ *
+ * @param seconds
+ *     The number of seconds that connection processes should continue
+ *     running after their last user disconnects, or zero if they should stop
+ *     immediately.
+ */
+void guacd_proc_set_linger_timeout(int seconds);
+
 /**
  * Signals the given process to stop accepting new users and clean up. This
  * will eventually cause the child process to exit.
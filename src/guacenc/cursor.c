@@ -39,8 +39,17 @@ guacenc_cursor* guacenc_cursor_alloc() {
         return NULL;
     }
 
+    /* Allocate buffer preserving the frame contents beneath the cursor */
+    cursor->under = guacenc_buffer_alloc();
+    if (cursor->under == NULL) {
+        guacenc_buffer_free(cursor->buffer);
+        guac_mem_free(cursor);
+        return NULL;
+    }
+
     /* Do not initially render cursor, unless it moves */
     cursor->x = cursor->y = -1;
+    cursor->under_captured = 0;
 
     return cursor;
 
@@ -52,8 +61,9 @@ void guacenc_cursor_free(guacenc_cursor* cursor) {
     if (cursor == NULL)
         return;
 
-    /* Free underlying buffer */
+    /* Free underlying buffers */
     guacenc_buffer_free(cursor->buffer);
+    guacenc_buffer_free(cursor->under);
 
     guac_mem_free(cursor);
 
@@ -63,6 +63,35 @@ typedef struct guacenc_cursor {
      */
     guacenc_buffer* buffer;
 
+    /**
+     * The contents of the composited frame beneath the cursor, as captured
+     * immediately before the cursor was last rendered. Restoring this region
+     * and re-rendering the cursor allows frames which differ only in mouse
+     * state to be recomposited without flattening the entire display.
+     */
+    guacenc_buffer* under;
+
+    /**
+     * The X coordinate of the upper-left corner of the region captured
+     * within the under buffer, in pixels. Valid only if under_captured is
+     * non-zero.
+     */
+    int under_x;
+
+    /**
+     * The Y coordinate of the upper-left corner of the region captured
+     * within the under buffer, in pixels. Valid only if under_captured is
+     * non-zero.
+     */
+    int under_y;
+
+    /**
+     * Non-zero if the under buffer currently contains the frame contents
+     * beneath the rendered cursor, zero if no cursor has been rendered since
+     * the buffer was last restored.
+     */
+    int under_captured;
+
 } guacenc_cursor;
 
 /**
@@ -78,6 +78,60 @@ static int guacenc_display_layer_comparator(const void* a, const void* b) {
 
 }
 
+/**
+ * Extracts the configured crop region from the composited frame of the given
+ * display, replacing the contents of the crop buffer. The extracted region is
+ * what is handed to the encoder, such that only the region of interest is
+ * scaled and encoded. If no crop region is configured, this function has no
+ * effect.
+ *
+ * @param display
+ *     The display whose crop region should be extracted.
+ *
+ * @return
+ *     Zero if extraction succeeds or no crop region is configured, non-zero
+ *     otherwise.
+ */
+static int guacenc_display_extract_crop(guacenc_display* display) {
+
+    /* Nothing to do if no crop region is configured */
+    if (display->crop_width <= 0)
+        return 0;
+
+    /* Retrieve default layer (guaranteed to not be NULL) */
+    guacenc_layer* def_layer = guacenc_display_get_layer(display, 0);
+    assert(def_layer != NULL);
+
+    /* Lazily allocate the buffer receiving the cropped frame */
+    if (display->crop_buffer == NULL) {
+        display->crop_buffer = guacenc_buffer_alloc();
+        if (display->crop_buffer == NULL)
+            return 1;
+    }
+
+    guacenc_buffer* crop = display->crop_buffer;
+
+    /* The cropped frame always has the dimensions of the crop region; any
+     * portion of the region lying outside the composited frame is simply
+     * left blank */
+    if (guacenc_buffer_resize(crop, display->crop_width,
+                display->crop_height))
+        return 1;
+
+    /* Replace the contents of the crop buffer with the crop region of the
+     * composited frame */
+    cairo_t* cairo = crop->cairo;
+    cairo_reset_clip(cairo);
+    cairo_set_operator(cairo, CAIRO_OPERATOR_SOURCE);
+    cairo_set_source_surface(cairo, def_layer->frame->surface,
+            -display->crop_x, -display->crop_y);
+    cairo_paint(cairo);
+    cairo_set_operator(cairo, CAIRO_OPERATOR_OVER);
+
+    return 0;
+
+}
+
 /**
  * Renders the mouse cursor on top of the frame buffer of the default layer of
  * the given display.
@@ -93,6 +147,10 @@ static int guacenc_display_render_cursor(guacenc_display* display) {
 
     guacenc_cursor* cursor = display->cursor;
 
+    /* Whatever was previously captured beneath the cursor is no longer
+     * applicable to the current frame */
+    cursor->under_captured = 0;
+
     /* Do not render cursor if coordinates are negative */
     if (cursor->x < 0 || cursor->y < 0)
         return 0;
@@ -106,15 +164,33 @@ static int guacenc_display_render_cursor(guacenc_display* display) {
     guacenc_buffer* dst = def_layer->frame;
 
     /* Render cursor to layer */
-    if (src->width > 0 && src->height > 0) {
-        cairo_set_source_surface(dst->cairo, src->surface,
-                cursor->x - cursor->hotspot_x,
-                cursor->y - cursor->hotspot_y);
-        cairo_rectangle(dst->cairo,
-                cursor->x - cursor->hotspot_x,
-                cursor->y - cursor->hotspot_y,
-                src->width, src->height);
+    if (src->width > 0 && src->height > 0 && dst->cairo != NULL) {
+
+        int x = cursor->x - cursor->hotspot_x;
+        int y = cursor->y - cursor->hotspot_y;
+
+        /* Preserve the frame contents about to be covered by the cursor,
+         * such that later frames which differ only in mouse state can
+         * restore this region rather than flattening the entire display */
+        guacenc_buffer* under = cursor->under;
+        if (guacenc_buffer_resize(under, src->width, src->height))
+            return 1;
+
+        if (under->cairo != NULL && dst->surface != NULL) {
+            cairo_set_operator(under->cairo, CAIRO_OPERATOR_SOURCE);
+            cairo_set_source_surface(under->cairo, dst->surface, -x, -y);
+            cairo_paint(under->cairo);
+            cairo_set_operator(under->cairo, CAIRO_OPERATOR_OVER);
+            cursor->under_x = x;
+            cursor->under_y = y;
+            cursor->under_captured = 1;
+        }
+
+        cairo_reset_clip(dst->cairo);
+        cairo_set_source_surface(dst->cairo, src->surface, x, y);
+        cairo_rectangle(dst->cairo, x, y, src->width, src->height);
         cairo_fill(dst->cairo);
+
     }
 
     /* Always succeeds */
@@ -199,7 +275,53 @@ int guacenc_display_flatten(guacenc_display* display) {
     }
 
     /* Render cursor on top of everything else */
-    return guacenc_display_render_cursor(display);
+    if (guacenc_display_render_cursor(display))
+        return 1;
+
+    /* Extract the configured crop region from the composited frame, if any */
+    return guacenc_display_extract_crop(display);
+
+}
+
+int guacenc_display_flatten_cursor(guacenc_display* display) {
+
+    guacenc_cursor* cursor = display->cursor;
+
+    /* Retrieve default layer (guaranteed to not be NULL) */
+    guacenc_layer* def_layer = guacenc_display_get_layer(display, 0);
+    assert(def_layer != NULL);
+
+    /* Fall back to fully flattening the display if no frame has yet been
+     * composited for the cursor to be rendered on top of */
+    guacenc_buffer* frame = def_layer->frame;
+    if (frame->cairo == NULL || frame->surface == NULL)
+        return guacenc_display_flatten(display);
+
+    /* Restore the frame contents beneath the cursor's previous position */
+    guacenc_buffer* under = cursor->under;
+    if (cursor->under_captured && under->surface != NULL) {
+
+        cairo_t* cairo = frame->cairo;
+        cairo_reset_clip(cairo);
+        cairo_set_operator(cairo, CAIRO_OPERATOR_SOURCE);
+        cairo_set_source_surface(cairo, under->surface,
+                cursor->under_x, cursor->under_y);
+        cairo_rectangle(cairo, cursor->under_x, cursor->under_y,
+                under->width, under->height);
+        cairo_fill(cairo);
+        cairo_set_operator(cairo, CAIRO_OPERATOR_OVER);
+
+        cursor->under_captured = 0;
+
+    }
+
+    /* Re-render the cursor at its current position, capturing the frame
+     * contents beneath it */
+    if (guacenc_display_render_cursor(display))
+        return 1;
+
+    /* Re-extract the configured crop region from the updated frame, if any */
+    return guacenc_display_extract_crop(display);
 
 }
 
@@ -31,6 +31,8 @@
 
 int guacenc_display_sync(guacenc_display* display, guac_timestamp timestamp) {
 
+    int i;
+
     /* Verify timestamp is not decreasing */
     if (timestamp < display->last_sync) {
         guacenc_log(GUAC_LOG_WARNING, "Decreasing sync timestamp");
@@ -40,20 +42,70 @@ int guacenc_display_sync(guacenc_display* display, guac_timestamp timestamp) {
     /* Update timestamp of display */
     display->last_sync = timestamp;
 
-    /* Flatten display to default layer */
-    if (guacenc_display_flatten(display))
+    /* Note timestamp of first frame for relative offset calculations */
+    if (display->first_sync == 0)
+        display->first_sync = timestamp;
+
+    /* Replay without writing frames until the requested beginning offset is
+     * reached, such that re-encoding a portion of a recording costs only
+     * instruction parsing for the skipped portion */
+    if (timestamp - display->first_sync < display->begin_offset)
+        return 0;
+
+    /* If the display is unchanged since the last composited frame, simply
+     * extend the video timelines; the encoders will duplicate the
+     * previously-prepared frame without recompositing */
+    if (!display->dirty && !display->cursor_dirty) {
+        for (i = 0; i < display->num_outputs; i++) {
+            if (guacenc_video_advance_timeline(display->outputs[i], timestamp))
+                return 1;
+        }
+        return 0;
+    }
+
+    /* Any images still being decoded must be drawn before the display can be
+     * flattened (failed decodes are logged and skipped; the frame remains
+     * encodable regardless) */
+    guacenc_display_flush_decodes(display);
+
+    /* Next composited frame will account for all changes to date */
+    int cursor_only = !display->dirty;
+    display->dirty = 0;
+    display->cursor_dirty = 0;
+
+    /* If only the mouse cursor has changed, recomposite just the cursor
+     * rectangle on top of the still-valid composited frame */
+    if (cursor_only) {
+        if (guacenc_display_flatten_cursor(display))
+            return 1;
+    }
+
+    /* Otherwise, flatten display to default layer */
+    else if (guacenc_display_flatten(display))
         return 1;
 
     /* Retrieve default layer (guaranteed to not be NULL) */
     guacenc_layer* def_layer = guacenc_display_get_layer(display, 0);
     assert(def_layer != NULL);
 
-    /* Update video timeline */
-    if (guacenc_video_advance_timeline(display->output, timestamp))
-        return 1;
+    /* Use the cropped frame produced during flattening, if cropping is
+     * enabled, otherwise the full composited frame */
+    guacenc_buffer* frame = def_layer->frame;
+    if (display->crop_width > 0 && display->crop_buffer != NULL)
+        frame = display->crop_buffer;
+
+    /* The same composited frame is scaled and encoded once per output */
+    for (i = 0; i < display->num_outputs; i++) {
+
+        /* Update video timeline */
+        if (guacenc_video_advance_timeline(display->outputs[i], timestamp))
+            return 1;
+
+        /* Prepare frame for write upon next flush */
+        guacenc_video_prepare_frame(display->outputs[i], frame);
+
+    }
 
-    /* Prepare frame for write upon next flush */
-    guacenc_video_prepare_frame(display->output, def_layer->frame);
     return 0;
 
 }
@@ -20,12 +20,15 @@
 #include "config.h"
 #include "cursor.h"
 #include "display.h"
+#include "image-decode.h"
+#include "log.h"
 #include "video.h"
 
 #include <cairo/cairo.h>
 #include <guacamole/mem.h>
 
 #include <stdlib.h>
+#include <string.h>
 
 cairo_operator_t guacenc_display_cairo_operator(guac_composite_mode mask) {
 
@@ -84,28 +87,62 @@ cairo_operator_t guacenc_display_cairo_operator(guac_composite_mode mask) {
 
 }
 
-guacenc_display* guacenc_display_alloc(const char* path, const char* codec,
-        int width, int height, int bitrate) {
+guacenc_display* guacenc_display_alloc(const char* const* paths,
+        const int* widths, const int* heights, int num_outputs,
+        const char* codec, int bitrate) {
 
-    /* Prepare video encoding */
-    guacenc_video* video = guacenc_video_alloc(path, codec, width, height, bitrate);
-    if (video == NULL)
+    int i;
+
+    /* Refuse to allocate more outputs than supported */
+    if (num_outputs < 1 || num_outputs > GUACENC_DISPLAY_MAX_OUTPUTS)
         return NULL;
 
+    /* Prepare video encoding of each output */
+    guacenc_video* outputs[GUACENC_DISPLAY_MAX_OUTPUTS];
+    for (i = 0; i < num_outputs; i++) {
+
+        outputs[i] = guacenc_video_alloc(paths[i], codec, widths[i],
+                heights[i], bitrate);
+
+        /* Free any already-created videos if a video cannot be created */
+        if (outputs[i] == NULL) {
+            while (--i >= 0)
+                guacenc_video_free(outputs[i]);
+            return NULL;
+        }
+
+    }
+
     /* Allocate display */
     guacenc_display* display =
         (guacenc_display*) guac_mem_zalloc(sizeof(guacenc_display));
 
-    /* Associate display with video output */
-    display->output = video;
+    /* Associate display with video outputs */
+    memcpy(display->outputs, outputs, sizeof(outputs));
+    display->num_outputs = num_outputs;
+
+    /* The first frame must always be composited and encoded */
+    display->dirty = 1;
 
     /* Allocate special-purpose cursor layer */
     display->cursor = guacenc_cursor_alloc();
 
+    /* Decode received images in parallel with instruction interpretation
+     * where possible (images are decoded synchronously if the pool cannot be
+     * created) */
+    display->decode_pool = guacenc_decode_pool_alloc();
+    if (display->decode_pool == NULL)
+        guacenc_log(GUAC_LOG_WARNING, "Unable to create image decode "
+                "thread pool. Images will be decoded synchronously.");
+
     return display;
 
 }
 
+int guacenc_display_flush_decodes(guacenc_display* display) {
+    return guacenc_decode_pool_flush(display->decode_pool);
+}
+
 int guacenc_display_free(guacenc_display* display) {
 
     int i;
@@ -114,8 +151,19 @@ int guacenc_display_free(guacenc_display* display) {
     if (display == NULL)
         return 0;
 
-    /* Finalize video */
-    int retval = guacenc_video_free(display->output);
+    /* Complete any in-flight image decodes before the buffers they draw to
+     * are freed */
+    guacenc_decode_pool_free(display->decode_pool);
+
+    /* Finalize all videos */
+    int retval = 0;
+    for (i = 0; i < display->num_outputs; i++) {
+        if (guacenc_video_free(display->outputs[i]))
+            retval = 1;
+    }
+
+    /* Free buffer backing the crop region, if allocated */
+    guacenc_buffer_free(display->crop_buffer);
 
     /* Free all buffers */
     for (i = 0; i < GUACENC_DISPLAY_MAX_BUFFERS; i++)
@@ -23,6 +23,7 @@
 #include "config.h"
 #include "buffer.h"
 #include "cursor.h"
+#include "image-decode.h"
 #include "image-stream.h"
 #include "layer.h"
 #include "video.h"
@@ -49,6 +50,12 @@
  */
 #define GUACENC_DISPLAY_MAX_STREAMS 64
 
+/**
+ * The maximum number of videos that the Guacamole video encoder will produce
+ * in a single pass over a Guacamole protocol dump.
+ */
+#define GUACENC_DISPLAY_MAX_OUTPUTS 8
+
 /**
  * The current state of the Guacamole video encoder's internal display.
  */
@@ -90,9 +97,90 @@ typedef struct guacenc_display {
     guac_timestamp last_sync;
 
     /**
-     * The video that this display is recording to.
+     * The timestamp of the first sync instruction handled, or 0 if no sync
+     * has yet been read.
+     */
+    guac_timestamp first_sync;
+
+    /**
+     * The offset into the recording at which writing of video frames should
+     * begin, in milliseconds relative to the first sync instruction. All
+     * instructions are replayed regardless of this offset (display state
+     * must be tracked from the beginning of the recording), but frames
+     * whose timestamps precede this offset are not written to the video. If
+     * zero, all frames are written.
+     */
+    guac_timestamp begin_offset;
+
+    /**
+     * Non-zero if the display may have visibly changed since the last frame
+     * was composited and handed to the encoder, zero otherwise. Syncs
+     * received while the display is unchanged simply extend the video
+     * timeline, duplicating the previously-prepared frame rather than
+     * recompositing and re-encoding identical contents.
+     */
+    int dirty;
+
+    /**
+     * Non-zero if the mouse cursor (its position, image, or hotspot) may
+     * have changed since the last frame was composited, zero otherwise.
+     * Syncs received while only the cursor has changed recomposite just the
+     * cursor rectangle on top of the still-valid composited frame rather
+     * than flattening the entire display.
+     */
+    int cursor_dirty;
+
+    /**
+     * The X coordinate of the upper-left corner of the region of the display
+     * to encode, if encoding has been restricted to a crop region.
+     */
+    int crop_x;
+
+    /**
+     * The Y coordinate of the upper-left corner of the region of the display
+     * to encode, if encoding has been restricted to a crop region.
+     */
+    int crop_y;
+
+    /**
+     * The width of the region of the display to encode, in pixels, or zero
+     * if the entire display should be encoded.
      */
-    guacenc_video* output;
+    int crop_width;
+
+    /**
+     * The height of the region of the display to encode, in pixels, if
+     * encoding has been restricted to a crop region.
+     */
+    int crop_height;
+
+    /**
+     * The buffer receiving the cropped contents of each composited frame, if
+     * encoding has been restricted to a crop region, or NULL if no frame has
+     * yet been composited or no crop region is set. This buffer is allocated
+     * lazily by guacenc_display_flatten() and is reused for each frame.
+     */
+    guacenc_buffer* crop_buffer;
+
+    /**
+     * All videos that this display is recording to. Each video receives the
+     * same composited frames, scaled to its own dimensions, such that
+     * several resolutions can be produced in a single pass over the
+     * recording.
+     */
+    guacenc_video* outputs[GUACENC_DISPLAY_MAX_OUTPUTS];
+
+    /**
+     * The number of videos within the outputs array.
+     */
+    int num_outputs;
+
+    /**
+     * The pool of worker threads decoding received images in parallel with
+     * instruction interpretation, or NULL if the pool could not be created
+     * (in which case images are decoded synchronously as their streams end).
+     */
+    guacenc_decode_pool* decode_pool;
 
 } guacenc_display;
 
@@ -112,6 +200,23 @@ typedef struct guacenc_display {
  */
 int guacenc_display_sync(guacenc_display* display, guac_timestamp timestamp);
 
+/**
+ * Waits for any images still being decoded by the decode pool of the given
+ * display and replays their deferred draw operations, in the order that the
+ * corresponding "end" instructions were received. This must occur before
+ * anything that reads or modifies the contents of a destination buffer. If
+ * the display has no decode pool, this function has no effect.
+ *
+ * @param display
+ *     The display whose in-flight image decodes should be completed.
+ *
+ * @return
+ *     Zero if all in-flight images were successfully decoded and drawn,
+ *     non-zero if any decode failed (failed decodes are logged and their
+ *     draws skipped; all other draws are still performed).
+ */
+int guacenc_display_flush_decodes(guacenc_display* display);
+
 /**
  * Flattens the given display, rendering all child layers to the frame buffers
  * of their parent layers. The frame buffer of the default layer of the display
@@ -128,34 +233,60 @@ int guacenc_display_sync(guacenc_display* display, guac_timestamp timestamp);
  */
 int guacenc_display_flatten(guacenc_display* display);
 
+/**
+ * Updates only the mouse cursor within the composited frame of the given
+ * display, restoring the frame contents beneath the cursor's previous
+ * position and re-rendering the cursor at its current position. This is
+ * valid only if nothing but the cursor has changed since the display was
+ * last flattened; if no frame has yet been composited, the entire display is
+ * flattened instead.
+ *
+ * @param display
+ *     The display whose composited frame should be updated.
+ *
+ * @return
+ *     Zero if the update succeeds, non-zero if an error occurs preventing
+ *     proper rendering.
+ */
+int guacenc_display_flatten_cursor(guacenc_display* display);
+
 /**
  * Allocates a new Guacamole video encoder display. This display serves as the
  * representation of encoding state, as well as the state of the Guacamole
  * display as instructions are read and handled.
  *
- * @param path
- *     The full path to the file in which encoded video should be written.
+ * @param paths
+ *     The full paths to the files in which encoded video should be written,
+ *     one per output.
+ *
+ * @param widths
+ *     The width of each desired video, in pixels, in the same order as the
+ *     given paths.
+ *
+ * @param heights
+ *     The height of each desired video, in pixels, in the same order as the
+ *     given paths.
+ *
+ * @param num_outputs
+ *     The number of videos to produce (the number of entries within the
+ *     paths, widths, and heights arrays), which must not exceed
+ *     GUACENC_DISPLAY_MAX_OUTPUTS.
  *
  * @param codec
  *     The name of the codec to use for the video encoding, as defined by
  *     ffmpeg / libavcodec.
  *
- * @param width
- *     The width of the desired video, in pixels.
- *
- * @param height
- *     The height of the desired video, in pixels.
- *
  * @param bitrate
- *     The desired overall bitrate of the resulting encoded video, in bits per
- *     second.
+ *     The desired overall bitrate of each resulting encoded video, in bits
+ *     per second.
  *
  * @return
  *     The newly-allocated Guacamole video encoder display, or NULL if the
  *     display could not be allocated.
  */
-guacenc_display* guacenc_display_alloc(const char* path, const char* codec,
-        int width, int height, int bitrate);
+guacenc_display* guacenc_display_alloc(const char* const* paths,
+        const int* widths, const int* heights, int num_outputs,
+        const char* codec, int bitrate);
 
 /**
  * Frees all memory associated with the given Guacamole video encoder display,
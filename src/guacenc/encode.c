@@ -27,10 +27,12 @@
 #include <guacamole/parser.h>
 #include <guacamole/socket.h>
 
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <string.h>
 #include <unistd.h>
@@ -84,8 +86,81 @@ static int guacenc_read_instructions(guacenc_display* display,
 
 }
 
-int guacenc_encode(const char* path, const char* out_path, const char* codec,
-        int width, int height, int bitrate, bool force) {
+/**
+ * Handles all Guacamole instructions within the given buffer, which contains
+ * the full contents of a recording. Instruction elements are parsed in place,
+ * directly referencing (and modifying) the buffer contents, rather than being
+ * copied through the parser's internal buffer.
+ *
+ * @param display
+ *     The current internal display of the Guacamole video encoder.
+ *
+ * @param path
+ *     The name of the file being parsed (for logging purposes).
+ *
+ * @param buffer
+ *     The buffer containing the contents of the recording. The contents of
+ *     this buffer will be modified during parsing.
+ *
+ * @param length
+ *     The number of bytes within the buffer.
+ *
+ * @return
+ *     Zero on success, non-zero if parsing of Guacamole protocol data within
+ *     the given buffer fails.
+ */
+static int guacenc_read_instructions_buffer(guacenc_display* display,
+        const char* path, char* buffer, size_t length) {
+
+    /* Obtain Guacamole protocol parser */
+    guac_parser* parser = guac_parser_alloc();
+    if (parser == NULL)
+        return 1;
+
+    size_t offset = 0;
+    while (offset < length) {
+
+        /* Parse as much of the remaining data as possible */
+        size_t remaining = length - offset;
+        int parsed = guac_parser_append(parser, buffer + offset,
+                remaining > INT_MAX ? INT_MAX : (int) remaining);
+
+        /* Fail on parse error */
+        if (parser->state == GUAC_PARSE_ERROR) {
+            guacenc_log(GUAC_LOG_ERROR, "%s: Invalid instruction.", path);
+            guac_parser_free(parser);
+            return 1;
+        }
+
+        offset += parsed;
+
+        /* Handle instruction once complete */
+        if (parser->state == GUAC_PARSE_COMPLETE) {
+            if (guacenc_handle_instruction(display, parser->opcode,
+                        parser->argc, parser->argv)) {
+                guacenc_log(GUAC_LOG_DEBUG, "Handling of \"%s\" instruction "
+                        "failed.", parser->opcode);
+            }
+            guac_parser_reset(parser);
+        }
+
+        /* Stop at a truncated trailing instruction (no further data will
+         * become available) */
+        else if (parsed == 0)
+            break;
+
+    }
+
+    /* Parse complete */
+    guac_parser_free(parser);
+    return 0;
+
+}
+
+int guacenc_encode(const char* path, const char* const* out_paths,
+        const int* widths, const int* heights, int num_outputs,
+        const char* codec, int bitrate, bool force, int begin,
+        const int* crop) {
 
     /* Open input file */
     int fd = open(path, O_RDONLY);
@@ -122,13 +197,64 @@ int guacenc_encode(const char* path, const char* out_path, const char* codec,
     }
 
     /* Allocate display for encoding process */
-    guacenc_display* display = guacenc_display_alloc(out_path, codec,
-            width, height, bitrate);
+    guacenc_display* display = guacenc_display_alloc(out_paths, widths,
+            heights, num_outputs, codec, bitrate);
     if (display == NULL) {
         close(fd);
         return 1;
     }
 
+    /* Skip writing of video frames prior to the requested beginning offset */
+    display->begin_offset = begin;
+
+    /* Restrict encoding to the requested crop region, if any */
+    if (crop[2] > 0) {
+        display->crop_x = crop[0];
+        display->crop_y = crop[1];
+        display->crop_width = crop[2];
+        display->crop_height = crop[3];
+    }
+
+    /* Prefer parsing the recording in place via a private mapping, avoiding
+     * buffering every byte through read() and the parser's internal buffer.
+     * The mapping must be writable (copy-on-write), as elements are
+     * terminated in place during parsing. */
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == 0 && S_ISREG(file_stat.st_mode)
+            && file_stat.st_size > 0) {
+
+        char* buffer = mmap(NULL, file_stat.st_size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE, fd, 0);
+
+        if (buffer != MAP_FAILED) {
+
+#ifdef MADV_SEQUENTIAL
+            /* Advise the kernel of the strictly sequential read pattern */
+            madvise(buffer, file_stat.st_size, MADV_SEQUENTIAL);
+#endif
+
+            guacenc_log(GUAC_LOG_INFO, "Encoding \"%s\" to \"%s\" ...",
+                    path, out_paths[0]);
+
+            /* Attempt to read all instructions within the mapping */
+            int retval = guacenc_read_instructions_buffer(display, path,
+                    buffer, file_stat.st_size);
+
+            munmap(buffer, file_stat.st_size);
+            close(fd);
+
+            if (retval) {
+                guacenc_display_free(display);
+                return retval;
+            }
+
+            /* Finish encoding process */
+            return guacenc_display_free(display);
+
+        }
+
+    }
+
     /* Obtain guac_socket wrapping file descriptor */
     guac_socket* socket = guac_socket_open(fd);
     if (socket == NULL) {
@@ -139,7 +265,8 @@ int guacenc_encode(const char* path, const char* out_path, const char* codec,
         return 1;
     }
 
-    guacenc_log(GUAC_LOG_INFO, "Encoding \"%s\" to \"%s\" ...", path, out_path);
+    guacenc_log(GUAC_LOG_INFO, "Encoding \"%s\" to \"%s\" ...", path,
+            out_paths[0]);
 
     /* Attempt to read all instructions in the file */
     if (guacenc_read_instructions(display, path, socket)) {
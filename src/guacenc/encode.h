@@ -33,33 +33,55 @@
  * @param path
  *     The path to the file containing the raw Guacamole protocol dump.
  *
- * @param out_path
- *     The full path to the file in which encoded video should be written.
+ * @param out_paths
+ *     An array of the full paths to the files in which encoded video should
+ *     be written, one per output.
+ *
+ * @param widths
+ *     An array of the widths of the desired videos, in pixels, one per
+ *     output.
+ *
+ * @param heights
+ *     An array of the heights of the desired videos, in pixels, one per
+ *     output.
+ *
+ * @param num_outputs
+ *     The number of output videos to produce. The recording is parsed and
+ *     composited only once regardless of the number of outputs; each
+ *     composited frame is scaled and encoded once per output.
  *
  * @param codec
  *     The name of the codec to use for the video encoding, as defined by
  *     ffmpeg / libavcodec.
  *
- * @param width
- *     The width of the desired video, in pixels.
- *
- * @param height
- *     The height of the desired video, in pixels.
- *
  * @param bitrate
- *     The desired overall bitrate of the resulting encoded video, in bits per
- *     second.
+ *     The desired overall bitrate of each resulting encoded video, in bits
+ *     per second.
  *
  * @param force
  *     Perform the encoding, even if the input file appears to be an
  *     in-progress recording (has an associated lock).
  *
+ * @param begin
+ *     The offset into the recording at which the resulting video should
+ *     begin, in milliseconds relative to the first frame of the recording.
+ *     All instructions prior to this offset are still replayed to maintain
+ *     display state, but no video frames are written for them. If zero, the
+ *     video will contain the entire recording.
+ *
+ * @param crop
+ *     An array of four integers (X, Y, WIDTH, HEIGHT) describing the region
+ *     of the display to encode, or an array whose WIDTH element is zero if
+ *     the entire display should be encoded.
+ *
  * @return
  *     Zero on success, non-zero if an error prevented successful encoding of
- *     the video.
+ *     the videos.
  */
-int guacenc_encode(const char* path, const char* out_path, const char* codec,
-        int width, int height, int bitrate, bool force);
+int guacenc_encode(const char* path, const char* const* out_paths,
+        const int* widths, const int* heights, int num_outputs,
+        const char* codec, int bitrate, bool force, int begin,
+        const int* crop);
 
 #endif
 
@@ -227,6 +227,11 @@ AVCodecContext* guacenc_build_avcodeccontext(AVStream* stream, const AVCodec* co
     stream->codec->qmin = qmin;
     stream->codec->pix_fmt = pix_fmt;
     stream->codec->time_base = time_base;
+
+    /* Use as many encoding threads as the codec supports (0 = automatically
+     * match the number of available processors) */
+    stream->codec->thread_count = 0;
+
 #if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(55, 44, 100)
     stream->time_base = time_base;
 #endif
@@ -243,6 +248,11 @@ AVCodecContext* guacenc_build_avcodeccontext(AVStream* stream, const AVCodec* co
         context->pix_fmt = pix_fmt;
         context->time_base = time_base;
         stream->time_base = time_base;
+
+        /* Use as many encoding threads as the codec supports (0 =
+         * automatically match the number of available processors) */
+        context->thread_count = 0;
+
     }
     return context;
 #endif
@@ -68,6 +68,14 @@
 #define AV_PIX_FMT_YUV420P PIX_FMT_YUV420P
 #endif
 
+/* The portions of the hwcontext API needed for hardware-accelerated encoding
+ * (avcodec_get_hw_config(), AVHWFramesContext, av_hwframe_transfer_data())
+ * are all present as of libavcodec 58.18.100 (FFmpeg 4.0). Older versions
+ * simply encode in software, as before. */
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(58,18,100)
+#define GUACENC_HAVE_AVCODEC_HWACCEL
+#endif
+
 /**
  * Writes the specified frame as a new frame of video. If pending frames of the
  * video are being flushed, the given frame may be NULL (as required by
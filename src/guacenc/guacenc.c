@@ -19,6 +19,7 @@
 
 #include "config.h"
 
+#include "display.h"
 #include "encode.h"
 #include "guacenc.h"
 #include "log.h"
@@ -28,29 +29,210 @@
 #include <libavformat/avformat.h>
 
 #include <getopt.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
 
+/**
+ * The current state of a batch of encoding jobs, shared by all worker
+ * threads. Each worker repeatedly claims the next unclaimed input file and
+ * encodes it until no files remain.
+ */
+typedef struct guacenc_batch {
+
+    /**
+     * Array of the paths of all input files to be encoded.
+     */
+    char** paths;
+
+    /**
+     * The total number of input files within the paths array.
+     */
+    int total;
+
+    /**
+     * The index within the paths array of the next file that has not yet
+     * been claimed by a worker thread.
+     */
+    int next;
+
+    /**
+     * The number of files for which encoding has failed so far.
+     */
+    int failures;
+
+    /**
+     * Lock which protects the next and failures members against concurrent
+     * modification by worker threads.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Array of the widths of each desired output video, in pixels.
+     */
+    const int* widths;
+
+    /**
+     * Array of the heights of each desired output video, in pixels.
+     */
+    const int* heights;
+
+    /**
+     * The number of output videos to produce for each input file.
+     */
+    int num_outputs;
+
+    /**
+     * The desired overall bitrate of each resulting encoded video, in bits
+     * per second.
+     */
+    int bitrate;
+
+    /**
+     * The region of the display to encode, as four integers (X, Y, WIDTH,
+     * HEIGHT). If the WIDTH element is zero, the entire display is encoded.
+     */
+    const int* crop;
+
+    /**
+     * The name of the libavcodec encoder to encode with. Hardware encoders
+     * (such as "h264_vaapi" or "h264_nvenc") may be named here to move
+     * encoding off the CPU.
+     */
+    const char* codec;
+
+    /**
+     * Whether encoding should be attempted even for files which appear to be
+     * in-progress recordings.
+     */
+    bool force;
+
+    /**
+     * The offset into each recording at which the resulting video should
+     * begin, in milliseconds.
+     */
+    int begin;
+
+} guacenc_batch;
+
+/**
+ * Worker thread which continuously claims and encodes input files from the
+ * given batch until no unclaimed files remain.
+ *
+ * @param data
+ *     A pointer to the guacenc_batch describing the overall encoding job.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guacenc_batch_worker(void* data) {
+
+    guacenc_batch* batch = (guacenc_batch*) data;
+
+    for (;;) {
+
+        /* Claim next input file, if any */
+        pthread_mutex_lock(&(batch->lock));
+        int current = batch->next++;
+        pthread_mutex_unlock(&(batch->lock));
+
+        /* Terminate once all files have been claimed */
+        if (current >= batch->total)
+            break;
+
+        /* Get current filename */
+        const char* path = batch->paths[current];
+
+        /* Generate output filenames. The first output is named FILE.m4v as
+         * always; any additional outputs are named FILE-WIDTHxHEIGHT.m4v to
+         * distinguish each member of the resolution ladder. */
+        char out_path_storage[GUACENC_DISPLAY_MAX_OUTPUTS][4096];
+        const char* out_paths[GUACENC_DISPLAY_MAX_OUTPUTS];
+        int j;
+        int len = 0;
+        for (j = 0; j < batch->num_outputs; j++) {
+
+            if (j == 0)
+                len = snprintf(out_path_storage[j],
+                        sizeof(out_path_storage[j]), "%s.m4v", path);
+            else
+                len = snprintf(out_path_storage[j],
+                        sizeof(out_path_storage[j]), "%s-%ix%i.m4v", path,
+                        batch->widths[j], batch->heights[j]);
+
+            /* Do not write if filename exceeds maximum length */
+            if (len >= sizeof(out_path_storage[j]))
+                break;
+
+            out_paths[j] = out_path_storage[j];
+
+        }
+
+        if (len >= sizeof(out_path_storage[0])) {
+            guacenc_log(GUAC_LOG_ERROR, "Cannot write output file for \"%s\": "
+                    "Name too long", path);
+            continue;
+        }
+
+        /* Attempt encoding, log granular success/failure at debug level */
+        if (guacenc_encode(path, out_paths, batch->widths, batch->heights,
+                    batch->num_outputs, batch->codec, batch->bitrate,
+                    batch->force, batch->begin, batch->crop)) {
+
+            pthread_mutex_lock(&(batch->lock));
+            batch->failures++;
+            pthread_mutex_unlock(&(batch->lock));
+
+            guacenc_log(GUAC_LOG_DEBUG,
+                    "%s was NOT successfully encoded.", path);
+
+        }
+        else
+            guacenc_log(GUAC_LOG_DEBUG, "%s was successfully encoded.", path);
+
+    }
+
+    return NULL;
+
+}
+
 int main(int argc, char* argv[]) {
 
     int i;
 
     /* Load defaults */
     bool force = false;
-    int width = GUACENC_DEFAULT_WIDTH;
-    int height = GUACENC_DEFAULT_HEIGHT;
+    int widths[GUACENC_DISPLAY_MAX_OUTPUTS];
+    int heights[GUACENC_DISPLAY_MAX_OUTPUTS];
+    int num_outputs = 0;
+    int crop[4] = { 0, 0, 0, 0 };
     int bitrate = GUACENC_DEFAULT_BITRATE;
+    int begin = 0;
+    int jobs = GUACENC_DEFAULT_JOBS;
+    const char* codec = GUACENC_DEFAULT_CODEC;
 
     /* Parse arguments */
     int opt;
-    while ((opt = getopt(argc, argv, "s:r:f")) != -1) {
+    while ((opt = getopt(argc, argv, "s:r:b:j:c:x:f")) != -1) {
 
-        /* -s: Dimensions (WIDTHxHEIGHT) */
+        /* -s: Dimensions (WIDTHxHEIGHT), repeatable for multiple outputs */
         if (opt == 's') {
-            if (guacenc_parse_dimensions(optarg, &width, &height)) {
+
+            if (num_outputs == GUACENC_DISPLAY_MAX_OUTPUTS) {
+                guacenc_log(GUAC_LOG_ERROR, "No more than %i output "
+                        "resolutions may be specified.",
+                        GUACENC_DISPLAY_MAX_OUTPUTS);
+                goto invalid_options;
+            }
+
+            if (guacenc_parse_dimensions(optarg, &widths[num_outputs],
+                        &heights[num_outputs])) {
                 guacenc_log(GUAC_LOG_ERROR, "Invalid dimensions.");
                 goto invalid_options;
             }
+
+            num_outputs++;
+
         }
 
         /* -r: Bitrate (bits per second) */
@@ -61,6 +243,36 @@ int main(int argc, char* argv[]) {
             }
         }
 
+        /* -b: Beginning offset (milliseconds) */
+        else if (opt == 'b') {
+            if (guacenc_parse_int(optarg, &begin) || begin < 0) {
+                guacenc_log(GUAC_LOG_ERROR, "Invalid beginning offset.");
+                goto invalid_options;
+            }
+        }
+
+        /* -j: Number of files to encode concurrently */
+        else if (opt == 'j') {
+            if (guacenc_parse_int(optarg, &jobs) || jobs < 1
+                    || jobs > GUACENC_MAX_JOBS) {
+                guacenc_log(GUAC_LOG_ERROR, "Invalid number of jobs.");
+                goto invalid_options;
+            }
+        }
+
+        /* -c: Codec (libavcodec encoder name) */
+        else if (opt == 'c')
+            codec = optarg;
+
+        /* -x: Crop region (X,Y,WIDTHxHEIGHT) */
+        else if (opt == 'x') {
+            if (guacenc_parse_region(optarg, &crop[0], &crop[1], &crop[2],
+                        &crop[3])) {
+                guacenc_log(GUAC_LOG_ERROR, "Invalid crop region.");
+                goto invalid_options;
+            }
+        }
+
         /* -f: Force */
         else if (opt == 'f')
             force = true;
@@ -72,6 +284,14 @@ int main(int argc, char* argv[]) {
 
     }
 
+    /* If no resolution was given, produce a single output at the default
+     * resolution */
+    if (num_outputs == 0) {
+        widths[0] = GUACENC_DEFAULT_WIDTH;
+        heights[0] = GUACENC_DEFAULT_HEIGHT;
+        num_outputs = 1;
+    }
+
     /* Log start */
     guacenc_log(GUAC_LOG_INFO, "Guacamole video encoder (guacenc) "
             "version " VERSION);
@@ -87,7 +307,6 @@ int main(int argc, char* argv[]) {
 
     /* Track number of overall failures */
     int total_files = argc - optind;
-    int failures = 0;
 
     /* Abort if no files given */
     if (total_files <= 0) {
@@ -97,42 +316,67 @@ int main(int argc, char* argv[]) {
 
     guacenc_log(GUAC_LOG_INFO, "%i input file(s) provided.", total_files);
 
-    guacenc_log(GUAC_LOG_INFO, "Video will be encoded at %ix%i "
-            "and %i bps.", width, height, bitrate);
-
-    /* Encode all input files */
-    for (i = optind; i < argc; i++) {
-
-        /* Get current filename */
-        const char* path = argv[i];
-
-        /* Generate output filename */
-        char out_path[4096];
-        int len = snprintf(out_path, sizeof(out_path), "%s.m4v", path);
-
-        /* Do not write if filename exceeds maximum length */
-        if (len >= sizeof(out_path)) {
-            guacenc_log(GUAC_LOG_ERROR, "Cannot write output file for \"%s\": "
-                    "Name too long", path);
-            continue;
+    for (i = 0; i < num_outputs; i++)
+        guacenc_log(GUAC_LOG_INFO, "Video will be encoded with \"%s\" at "
+                "%ix%i and %i bps.", codec, widths[i], heights[i], bitrate);
+
+    if (crop[2] > 0)
+        guacenc_log(GUAC_LOG_INFO, "Only the %ix%i region at %i,%i will be "
+                "encoded.", crop[2], crop[3], crop[0], crop[1]);
+
+    if (begin > 0)
+        guacenc_log(GUAC_LOG_INFO, "Video will begin %i ms into each "
+                "recording.", begin);
+
+    /* No more workers than files are needed */
+    if (jobs > total_files)
+        jobs = total_files;
+
+    /* Describe overall batch of encoding jobs */
+    guacenc_batch batch = {
+        .paths    = &(argv[optind]),
+        .total    = total_files,
+        .next     = 0,
+        .failures = 0,
+        .widths   = widths,
+        .heights  = heights,
+        .num_outputs = num_outputs,
+        .bitrate  = bitrate,
+        .crop     = crop,
+        .codec    = codec,
+        .force    = force,
+        .begin    = begin
+    };
+
+    pthread_mutex_init(&(batch.lock), NULL);
+
+    /* Encode all input files, spreading files across the requested number of
+     * worker threads */
+    pthread_t workers[GUACENC_MAX_JOBS];
+    for (i = 0; i < jobs; i++) {
+        if (pthread_create(&(workers[i]), NULL, guacenc_batch_worker,
+                    &batch)) {
+            guacenc_log(GUAC_LOG_WARNING, "Unable to create worker thread. "
+                    "Files will be encoded using %i worker(s).", i);
+            jobs = i;
+            break;
         }
+    }
 
-        /* Attempt encoding, log granular success/failure at debug level */
-        if (guacenc_encode(path, out_path, "mpeg4",
-                    width, height, bitrate, force)) {
-            failures++;
-            guacenc_log(GUAC_LOG_DEBUG,
-                    "%s was NOT successfully encoded.", path);
-        }
-        else
-            guacenc_log(GUAC_LOG_DEBUG, "%s was successfully encoded.", path);
+    /* If no workers could be created at all, run the batch directly */
+    if (jobs == 0)
+        guacenc_batch_worker(&batch);
 
-    }
+    /* Wait for all workers to finish */
+    for (i = 0; i < jobs; i++)
+        pthread_join(workers[i], NULL);
+
+    pthread_mutex_destroy(&(batch.lock));
 
     /* Warn if at least one file failed */
-    if (failures != 0)
+    if (batch.failures != 0)
         guacenc_log(GUAC_LOG_WARNING, "Encoding failed for %i of %i file(s).",
-                failures, total_files);
+                batch.failures, total_files);
 
     /* Notify of success */
     else
@@ -147,6 +391,10 @@ invalid_options:
     fprintf(stderr, "USAGE: %s"
             " [-s WIDTHxHEIGHT]"
             " [-r BITRATE]"
+            " [-b BEGIN_MS]"
+            " [-j JOBS]"
+            " [-c CODEC]"
+            " [-x X,Y,WIDTHxHEIGHT]"
             " [-f]"
             " [FILE]...\n", argv[0]);
 
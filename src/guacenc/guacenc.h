@@ -44,10 +44,27 @@
  */
 #define GUACENC_DEFAULT_BITRATE 2000000
 
+/**
+ * The name of the libavcodec encoder with which video should be encoded, if
+ * no other encoder is given on the command line.
+ */
+#define GUACENC_DEFAULT_CODEC "mpeg4"
+
 /**
  * The default log level below which no messages should be logged.
  */
 #define GUACENC_DEFAULT_LOG_LEVEL GUAC_LOG_INFO
 
+/**
+ * The number of input files to encode concurrently, if no other number is
+ * given on the command line.
+ */
+#define GUACENC_DEFAULT_JOBS 1
+
+/**
+ * The maximum number of input files that may be encoded concurrently.
+ */
+#define GUACENC_MAX_JOBS 64
+
 #endif
 
@@ -0,0 +1,275 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+#include "buffer.h"
+#include "display.h"
+#include "image-decode.h"
+#include "log.h"
+
+#include <cairo/cairo.h>
+#include <guacamole/mem.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * Worker thread which continuously claims and decodes submitted jobs from the
+ * given pool until the pool is freed. Decoding is the only work performed by
+ * these threads; the deferred draw of each decoded image is replayed later by
+ * guacenc_decode_pool_flush(), on the thread interpreting instructions, such
+ * that draws occur in instruction order.
+ *
+ * @param data
+ *     A pointer to the guacenc_decode_pool to decode jobs from.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guacenc_decode_pool_worker(void* data) {
+
+    guacenc_decode_pool* pool = (guacenc_decode_pool*) data;
+
+    pthread_mutex_lock(&(pool->lock));
+    for (;;) {
+
+        /* Wait for an unclaimed job (or for the pool to be freed) */
+        while (pool->next_undecoded == NULL && !pool->stopping)
+            pthread_cond_wait(&(pool->modified), &(pool->lock));
+
+        /* Terminate once the pool is being freed and no unclaimed jobs
+         * remain */
+        guacenc_decode_job* job = pool->next_undecoded;
+        if (job == NULL)
+            break;
+
+        /* Claim job, leaving it within the ordered queue for the later
+         * in-order replay of its draw operation */
+        pool->next_undecoded = job->next;
+
+        /* Decode outside the lock, such that other workers can proceed with
+         * their own decodes in parallel */
+        pthread_mutex_unlock(&(pool->lock));
+        cairo_surface_t* surface = job->decoder(job->data, job->length);
+        pthread_mutex_lock(&(pool->lock));
+
+        /* Publish result and wake any thread waiting within
+         * guacenc_decode_pool_flush() */
+        job->surface = surface;
+        job->completed = 1;
+        pthread_cond_broadcast(&(pool->modified));
+
+    }
+    pthread_mutex_unlock(&(pool->lock));
+
+    return NULL;
+
+}
+
+/**
+ * Replays the deferred draw operation of the given completed job, drawing its
+ * decoded image to the destination buffer recorded at submission. The decoded
+ * surface is destroyed regardless of whether the draw succeeds.
+ *
+ * @param job
+ *     The completed job whose draw operation should be replayed.
+ *
+ * @return
+ *     Zero if the image was successfully decoded and drawn, non-zero if the
+ *     decode had failed.
+ */
+static int guacenc_decode_job_draw(guacenc_decode_job* job) {
+
+    /* Nothing to draw if the decode failed */
+    cairo_surface_t* surface = job->surface;
+    if (surface == NULL) {
+        guacenc_log(GUAC_LOG_WARNING, "Image decode failed. The "
+                "corresponding draw operation will be skipped.");
+        return 1;
+    }
+
+    /* Get surface dimensions */
+    int width = cairo_image_surface_get_width(surface);
+    int height = cairo_image_surface_get_height(surface);
+
+    /* Expand the buffer as necessary to fit the draw operation */
+    guacenc_buffer* buffer = job->buffer;
+    if (buffer->autosize)
+        guacenc_buffer_fit(buffer, job->x + width, job->y + height);
+
+    /* Draw surface to buffer */
+    if (buffer->cairo != NULL) {
+        cairo_set_operator(buffer->cairo, guacenc_display_cairo_operator(job->mask));
+        cairo_set_source_surface(buffer->cairo, surface, job->x, job->y);
+        cairo_rectangle(buffer->cairo, job->x, job->y, width, height);
+        cairo_fill(buffer->cairo);
+    }
+
+    cairo_surface_destroy(surface);
+    return 0;
+
+}
+
+guacenc_decode_pool* guacenc_decode_pool_alloc() {
+
+    guacenc_decode_pool* pool =
+        (guacenc_decode_pool*) guac_mem_zalloc(sizeof(guacenc_decode_pool));
+    if (pool == NULL)
+        return NULL;
+
+    pthread_mutex_init(&(pool->lock), NULL);
+    pthread_cond_init(&(pool->modified), NULL);
+
+    /* Use no more threads than processors (decoding overlaps with the thread
+     * interpreting instructions regardless) */
+    long num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_threads < 1)
+        num_threads = 1;
+    if (num_threads > GUACENC_DECODE_POOL_MAX_THREADS)
+        num_threads = GUACENC_DECODE_POOL_MAX_THREADS;
+
+    /* Create worker threads, continuing with however many could be created */
+    int i;
+    for (i = 0; i < num_threads; i++) {
+        if (pthread_create(&(pool->threads[i]), NULL,
+                    guacenc_decode_pool_worker, pool))
+            break;
+    }
+    pool->num_threads = i;
+
+    /* Without any workers at all, the pool cannot function */
+    if (pool->num_threads == 0) {
+        pthread_cond_destroy(&(pool->modified));
+        pthread_mutex_destroy(&(pool->lock));
+        guac_mem_free(pool);
+        return NULL;
+    }
+
+    return pool;
+
+}
+
+int guacenc_decode_pool_submit(guacenc_decode_pool* pool,
+        guacenc_decoder* decoder, unsigned char* data, int length,
+        guacenc_buffer* buffer, int mask, int x, int y) {
+
+    guacenc_decode_job* job =
+        (guacenc_decode_job*) guac_mem_alloc(sizeof(guacenc_decode_job));
+    if (job == NULL)
+        return 1;
+
+    /* Record data to decode and the draw operation to later replay */
+    job->decoder = decoder;
+    job->data = data;
+    job->length = length;
+    job->buffer = buffer;
+    job->mask = mask;
+    job->x = x;
+    job->y = y;
+
+    job->surface = NULL;
+    job->completed = 0;
+    job->next = NULL;
+
+    /* Append job to ordered queue, handing it to the workers */
+    pthread_mutex_lock(&(pool->lock));
+
+    if (pool->last != NULL)
+        pool->last->next = job;
+    else
+        pool->first = job;
+    pool->last = job;
+
+    if (pool->next_undecoded == NULL)
+        pool->next_undecoded = job;
+
+    pthread_cond_broadcast(&(pool->modified));
+    pthread_mutex_unlock(&(pool->lock));
+
+    return 0;
+
+}
+
+int guacenc_decode_pool_flush(guacenc_decode_pool* pool) {
+
+    int failed = 0;
+
+    /* Ignore NULL pool */
+    if (pool == NULL)
+        return 0;
+
+    pthread_mutex_lock(&(pool->lock));
+
+    guacenc_decode_job* job;
+    while ((job = pool->first) != NULL) {
+
+        /* Wait for the oldest outstanding decode to complete (later jobs may
+         * well complete first, but draws must be replayed in order) */
+        while (!job->completed)
+            pthread_cond_wait(&(pool->modified), &(pool->lock));
+
+        /* Remove job from queue */
+        pool->first = job->next;
+        if (pool->first == NULL)
+            pool->last = NULL;
+
+        /* Draw outside the lock, such that workers are not stalled by the
+         * draws of already-completed jobs */
+        pthread_mutex_unlock(&(pool->lock));
+
+        if (guacenc_decode_job_draw(job))
+            failed = 1;
+
+        guac_mem_free(job->data);
+        guac_mem_free(job);
+
+        pthread_mutex_lock(&(pool->lock));
+
+    }
+
+    pthread_mutex_unlock(&(pool->lock));
+    return failed;
+
+}
+
+void guacenc_decode_pool_free(guacenc_decode_pool* pool) {
+
+    /* Ignore NULL pool */
+    if (pool == NULL)
+        return;
+
+    /* Complete any remaining draws before tearing down the workers */
+    guacenc_decode_pool_flush(pool);
+
+    /* Signal workers to terminate, and wait for them to do so */
+    pthread_mutex_lock(&(pool->lock));
+    pool->stopping = 1;
+    pthread_cond_broadcast(&(pool->modified));
+    pthread_mutex_unlock(&(pool->lock));
+
+    int i;
+    for (i = 0; i < pool->num_threads; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_cond_destroy(&(pool->modified));
+    pthread_mutex_destroy(&(pool->lock));
+    guac_mem_free(pool);
+
+}
@@ -0,0 +1,261 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUACENC_IMAGE_DECODE_H
+#define GUACENC_IMAGE_DECODE_H
+
+#include "config.h"
+#include "buffer.h"
+#include "image-stream.h"
+
+#include <cairo/cairo.h>
+
+#include <pthread.h>
+#include <stddef.h>
+
+/**
+ * The maximum number of worker threads that a decode pool will create,
+ * regardless of the number of processors available. Image decoding overlaps
+ * with instruction interpretation (and with the file-level worker threads of
+ * a batch encoding job), so a small number of threads is sufficient to keep
+ * decoding off the critical path.
+ */
+#define GUACENC_DECODE_POOL_MAX_THREADS 4
+
+/**
+ * A single image decode that has been handed off to the decode pool. Each job
+ * records both the encoded image data to decode and the draw operation that
+ * must eventually be performed with the decoded result, such that the draw
+ * can be replayed in its original position within the instruction stream once
+ * the decode completes.
+ */
+typedef struct guacenc_decode_job guacenc_decode_job;
+
+struct guacenc_decode_job {
+
+    /**
+     * The decoder to use to decode the image data.
+     */
+    guacenc_decoder* decoder;
+
+    /**
+     * The raw encoded image data. Ownership of this data is transferred to
+     * the job upon submission, and the data is freed once the job has been
+     * drawn (or discarded).
+     */
+    unsigned char* data;
+
+    /**
+     * The length of the encoded image data, in bytes.
+     */
+    int length;
+
+    /**
+     * The buffer that the decoded image must be drawn to.
+     */
+    guacenc_buffer* buffer;
+
+    /**
+     * The Guacamole protocol compositing operation (channel mask) to apply
+     * when drawing the image.
+     */
+    int mask;
+
+    /**
+     * The X coordinate of the upper-left corner of the rectangle within the
+     * destination buffer that the decoded image should be drawn to.
+     */
+    int x;
+
+    /**
+     * The Y coordinate of the upper-left corner of the rectangle within the
+     * destination buffer that the decoded image should be drawn to.
+     */
+    int y;
+
+    /**
+     * The result of the decode, if the decode has completed, or NULL if the
+     * decode has not yet completed or failed. This member may only be
+     * accessed while the lock of the decode pool is held.
+     */
+    cairo_surface_t* surface;
+
+    /**
+     * Non-zero if the decode has completed (successfully or not), zero
+     * otherwise. This member may only be accessed while the lock of the
+     * decode pool is held.
+     */
+    int completed;
+
+    /**
+     * The next job submitted after this job, or NULL if this is the most
+     * recently submitted job. Jobs are kept strictly in submission order, as
+     * their draw operations must be replayed in the order that the
+     * corresponding "end" instructions were received.
+     */
+    guacenc_decode_job* next;
+
+};
+
+/**
+ * A pool of worker threads that decode images in parallel with instruction
+ * interpretation. Jobs are submitted in instruction order and their draw
+ * operations are later replayed in that same order by
+ * guacenc_decode_pool_flush(), preserving the semantics of a strictly
+ * sequential interpretation while allowing the decodes themselves to proceed
+ * concurrently.
+ */
+typedef struct guacenc_decode_pool {
+
+    /**
+     * Lock which protects the job queue and the completion state of each job
+     * against concurrent modification.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Condition signalled whenever a job is submitted to the pool or
+     * completed by a worker thread.
+     */
+    pthread_cond_t modified;
+
+    /**
+     * The least recently submitted job that has not yet been drawn, or NULL
+     * if no jobs are outstanding.
+     */
+    guacenc_decode_job* first;
+
+    /**
+     * The most recently submitted job that has not yet been drawn, or NULL if
+     * no jobs are outstanding.
+     */
+    guacenc_decode_job* last;
+
+    /**
+     * The least recently submitted job that has not yet been claimed by a
+     * worker thread, or NULL if all outstanding jobs have been claimed.
+     */
+    guacenc_decode_job* next_undecoded;
+
+    /**
+     * Non-zero if the pool is being freed and the worker threads should
+     * terminate once no unclaimed jobs remain, zero otherwise.
+     */
+    int stopping;
+
+    /**
+     * The number of worker threads successfully created for this pool.
+     */
+    int num_threads;
+
+    /**
+     * The worker threads decoding submitted jobs. Only the first num_threads
+     * entries are valid.
+     */
+    pthread_t threads[GUACENC_DECODE_POOL_MAX_THREADS];
+
+} guacenc_decode_pool;
+
+/**
+ * Allocates a new decode pool, creating its worker threads. The number of
+ * threads created depends on the number of processors available, capped at
+ * GUACENC_DECODE_POOL_MAX_THREADS.
+ *
+ * @return
+ *     A newly-allocated decode pool, or NULL if the pool could not be
+ *     allocated or no worker threads could be created (in which case the
+ *     caller should fall back to decoding images synchronously).
+ */
+guacenc_decode_pool* guacenc_decode_pool_alloc(void);
+
+/**
+ * Submits an image decode to the given pool. Ownership of the given data is
+ * transferred to the pool, which will free it once the decoded image has been
+ * drawn. The draw operation described by the given buffer, mask, and
+ * coordinates is deferred until guacenc_decode_pool_flush() is invoked, at
+ * which point all deferred draws are replayed in submission order.
+ *
+ * @param pool
+ *     The pool that should decode the image.
+ *
+ * @param decoder
+ *     The decoder to use to decode the image data.
+ *
+ * @param data
+ *     The raw encoded image data. This data MUST have been allocated via
+ *     guac_mem_alloc() or an equivalent, as the pool will free it via
+ *     guac_mem_free().
+ *
+ * @param length
+ *     The length of the encoded image data, in bytes.
+ *
+ * @param buffer
+ *     The buffer that the decoded image must eventually be drawn to. This
+ *     buffer MUST remain valid until the pool has been flushed.
+ *
+ * @param mask
+ *     The Guacamole protocol compositing operation (channel mask) to apply
+ *     when drawing the image.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the destination rectangle.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the destination rectangle.
+ *
+ * @return
+ *     Zero if the job was successfully submitted (in which case the pool has
+ *     assumed ownership of the given data), non-zero if submission failed (in
+ *     which case ownership of the data remains with the caller, who should
+ *     decode synchronously instead).
+ */
+int guacenc_decode_pool_submit(guacenc_decode_pool* pool,
+        guacenc_decoder* decoder, unsigned char* data, int length,
+        guacenc_buffer* buffer, int mask, int x, int y);
+
+/**
+ * Waits for all outstanding decodes within the given pool to complete and
+ * replays their deferred draw operations in submission order. This function
+ * must be invoked before anything that depends on the contents of a
+ * destination buffer (direct drawing, copies, flattening to a frame, etc.)
+ * and before any destination buffer is resized or freed. If the given pool is
+ * NULL, this function has no effect.
+ *
+ * @param pool
+ *     The pool to flush, which may be NULL.
+ *
+ * @return
+ *     Zero if all outstanding images were successfully decoded and drawn,
+ *     non-zero if any decode failed. Failed decodes are logged and skipped;
+ *     all remaining draws are still performed.
+ */
+int guacenc_decode_pool_flush(guacenc_decode_pool* pool);
+
+/**
+ * Flushes and frees the given decode pool, terminating its worker threads. If
+ * the given pool is NULL, this function has no effect. The destination
+ * buffers of any outstanding jobs must still be valid when this function is
+ * invoked.
+ *
+ * @param pool
+ *     The pool to free, which may be NULL.
+ */
+void guacenc_decode_pool_free(guacenc_decode_pool* pool);
+
+#endif
@@ -65,6 +65,10 @@ int guacenc_handle_cursor(guacenc_display* display, int argc, char** argv) {
         cairo_paint(dst->cairo);
     }
 
+    /* Only the cursor has changed; the next frame can be recomposited
+     * without flattening the entire display */
+    display->cursor_dirty = 1;
+
     return 0;
 
 }
@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "display.h"
+#include "image-decode.h"
 #include "image-stream.h"
 #include "log.h"
 
@@ -49,7 +50,23 @@ int guacenc_handle_end(guacenc_display* display, int argc, char** argv) {
     if (buffer == NULL)
         return 1;
 
-    /* End image stream, drawing final image to the buffer */
+    /* Hand the received image off to the decode pool where possible,
+     * deferring the draw until the buffer contents are actually needed */
+    if (display->decode_pool != NULL && stream->decoder != NULL
+            && guacenc_decode_pool_submit(display->decode_pool,
+                stream->decoder, stream->buffer, stream->length, buffer,
+                stream->mask, stream->x, stream->y) == 0) {
+
+        /* Ownership of the encoded data has passed to the pool */
+        stream->buffer = NULL;
+        stream->length = 0;
+        stream->max_length = 0;
+
+        return 0;
+
+    }
+
+    /* Otherwise, end image stream, drawing final image to the buffer */
     return guacenc_image_stream_end(stream, buffer);
 
 }
@@ -44,6 +44,10 @@ int guacenc_handle_mouse(guacenc_display* display, int argc, char** argv) {
     cursor->x = x;
     cursor->y = y;
 
+    /* Only the cursor has changed; the next frame can be recomposited
+     * without flattening the entire display */
+    display->cursor_dirty = 1;
+
     /* If no timestamp provided, nothing further to do */
     if (argc < 4)
         return 0;
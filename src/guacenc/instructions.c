@@ -27,21 +27,21 @@
 #include <string.h>
 
 guacenc_instruction_handler_mapping guacenc_instruction_handler_map[] = {
-    {"blob",     guacenc_handle_blob},
-    {"img",      guacenc_handle_img},
-    {"end",      guacenc_handle_end},
-    {"mouse",    guacenc_handle_mouse},
-    {"sync",     guacenc_handle_sync},
-    {"cursor",   guacenc_handle_cursor},
-    {"copy",     guacenc_handle_copy},
-    {"transfer", guacenc_handle_transfer},
-    {"size",     guacenc_handle_size},
-    {"rect",     guacenc_handle_rect},
-    {"cfill",    guacenc_handle_cfill},
-    {"move",     guacenc_handle_move},
-    {"shade",    guacenc_handle_shade},
-    {"dispose",  guacenc_handle_dispose},
-    {NULL,       NULL}
+    {"blob",     guacenc_handle_blob,     0, 0},
+    {"img",      guacenc_handle_img,      0, 0},
+    {"end",      guacenc_handle_end,      1, 0},
+    {"mouse",    guacenc_handle_mouse,    0, 0},
+    {"sync",     guacenc_handle_sync,     0, 0},
+    {"cursor",   guacenc_handle_cursor,   0, 1},
+    {"copy",     guacenc_handle_copy,     1, 1},
+    {"transfer", guacenc_handle_transfer, 1, 1},
+    {"size",     guacenc_handle_size,     1, 1},
+    {"rect",     guacenc_handle_rect,     0, 1},
+    {"cfill",    guacenc_handle_cfill,    1, 1},
+    {"move",     guacenc_handle_move,     1, 0},
+    {"shade",    guacenc_handle_shade,    1, 0},
+    {"dispose",  guacenc_handle_dispose,  1, 1},
+    {NULL,       NULL,                    0, 0}
 };
 
 int guacenc_handle_instruction(guacenc_display* display, const char* opcode,
@@ -54,6 +54,20 @@ int guacenc_handle_instruction(guacenc_display* display, const char* opcode,
         /* Invoke handler if opcode matches (if defined) */
         if (strcmp(current->opcode, opcode) == 0) {
 
+            /* Note that the next frame will differ from the last if this
+             * instruction is capable of altering the display (marked prior
+             * to invoking the handler, as handlers may themselves advance
+             * the frame timeline) */
+            if (current->modifies_display)
+                display->dirty = 1;
+
+            /* Handlers that depend on the contents of a buffer or layer must
+             * first observe the draws of any images still being decoded
+             * (failed decodes are logged and skipped; the instruction is
+             * still handled) */
+            if (current->requires_decoded_images)
+                guacenc_display_flush_decodes(display);
+
             /* Invoke defined handler */
             guacenc_instruction_handler* handler = current->handler;
             if (handler != NULL)
@@ -65,6 +65,29 @@ typedef struct guacenc_instruction_handler_mapping {
      */
     guacenc_instruction_handler* handler;
 
+    /**
+     * Non-zero if instructions having the associated opcode may alter the
+     * rendered display (drawing, moving layers, etc.), or zero if they
+     * cannot. Instructions which cannot alter the display need not result in
+     * a new frame being composited and encoded. Instructions affecting only
+     * the mouse cursor are not marked here; their handlers instead set the
+     * cursor_dirty flag of the display, allowing cursor-only frames to be
+     * recomposited without flattening the entire display.
+     */
+    int modifies_display;
+
+    /**
+     * Non-zero if the handler for the associated opcode directly reads,
+     * modifies, resizes, or frees the contents of a buffer or layer, or zero
+     * if it does not. Handlers which do must first wait for any
+     * asynchronously-decoded images to be drawn, such that draws occur in
+     * instruction order. Image stream instructions themselves ("img", "blob",
+     * "end") are not marked here, as their draws are what the decode pool
+     * defers, nor is "sync", which flushes pending decodes itself prior to
+     * flattening.
+     */
+    int requires_decoded_images;
+
 } guacenc_instruction_handler_mapping;
 
 /**
@@ -26,38 +26,17 @@
 
 #include <cairo/cairo.h>
 #include <guacamole/mem.h>
+#include <guacamole/pixel.h>
 #include <jpeglib.h>
 
 #include <stdlib.h>
 
-/**
- * Translates libjpeg's 24-bit RGB format into Cairo's 32-bit ARGB32 / RGB24
- * format. The red, green, and blue components from the libjpeg pixel are
- * copied verbatim, while the extra high byte used within Cairo is set to 0xFF.
- *
- * @param src
- *     A pointer to the first byte of the 24-bit RGB pixel within a libjpeg
- *     scanline buffer.
- *
- * @return
- *     A 32-bit Cairo ARGB32 / RGB24 pixel value equivalent to the libjpeg
- *     pixel at the given pointer.
- */
-static uint32_t guacenc_jpeg_translate_rgb(const unsigned char* src) {
-
-    /* Pull components from source */
-    int r = *(src++);
-    int g = *(src++);
-    int b = *(src++);
-
-    /* Translate to 32-bit integer compatible with Cairo */
-    return 0xFF000000 | (r << 16) | (g << 8) | b;
-
-}
-
 /**
  * Copies the data from a libjpeg scanline buffer into a row of image data
- * within a Cairo surface, translating each pixel as necessary.
+ * within a Cairo surface, translating each pixel from libjpeg's 24-bit RGB
+ * format into Cairo's 32-bit ARGB32 / RGB24 format. The red, green, and blue
+ * components from each libjpeg pixel are copied verbatim, while the extra
+ * high byte used within Cairo is set to 0xFF.
  *
  * @param dst
  *     The destination buffer into which the scanline should be copied.
@@ -73,12 +52,7 @@ static uint32_t guacenc_jpeg_translate_rgb(const unsigned char* src) {
 static void guacenc_jpeg_copy_scanline(unsigned char* dst,
         const unsigned char* src, int width) {
 
-    uint32_t* current = (uint32_t*) dst;
-
-    /* Copy all pixels from source to destination, translating for Cairo */
-    for (; width > 0; width--, src += 3) {
-        *(current++) = guacenc_jpeg_translate_rgb(src);
-    }
+    guac_pixel_unpack_rgb((uint32_t*) dst, src, width);
 
 }
 
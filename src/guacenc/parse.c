@@ -69,6 +69,83 @@ int guacenc_parse_dimensions(char* arg, int* width, int* height) {
 
 }
 
+/**
+ * Parses a string into a single integer, as guacenc_parse_int() would, except
+ * that zero is additionally accepted. The input string may be modified during
+ * parsing. A value will be stored in the provided int pointer only if valid.
+ *
+ * @param arg
+ *     The string to parse.
+ *
+ * @param i
+ *     A pointer to the integer in which the parsed value of the given string
+ *     should be stored.
+ *
+ * @return
+ *     Zero if parsing was successful, non-zero if the provided string was
+ *     invalid.
+ */
+static int guacenc_parse_nonnegative_int(char* arg, int* i) {
+
+    char* end;
+
+    /* Parse string as an integer */
+    errno = 0;
+    long int value = strtol(arg, &end, 10);
+
+    /* Ignore number if invalid / negative */
+    if (errno != 0 || value < 0 || value > INT_MAX || *end != '\0'
+            || end == arg)
+        return 1;
+
+    /* Store value */
+    *i = value;
+
+    /* Parsing successful */
+    return 0;
+
+}
+
+int guacenc_parse_region(char* arg, int* x, int* y, int* width, int* height) {
+
+    /* Locate the comma separating the X coordinate from the remainder */
+    char* comma = strchr(arg, ',');
+    if (comma == NULL)
+        return 1;
+
+    /* Replace first comma with a null terminator */
+    *comma = '\0';
+    char* rest = comma + 1;
+
+    /* Locate the comma separating the Y coordinate from the dimensions */
+    comma = strchr(rest, ',');
+    if (comma == NULL)
+        return 1;
+
+    /* Replace second comma with a null terminator */
+    *comma = '\0';
+
+    /* Parse X and Y coordinates (which, unlike dimensions, may be zero) */
+    int parsed_x, parsed_y;
+    if (guacenc_parse_nonnegative_int(arg, &parsed_x)
+            || guacenc_parse_nonnegative_int(rest, &parsed_y))
+        return 1;
+
+    /* Parse dimensions of region */
+    int w, h;
+    if (guacenc_parse_dimensions(comma + 1, &w, &h))
+        return 1;
+
+    /* All components of the region are valid */
+    *x = parsed_x;
+    *y = parsed_y;
+    *width = w;
+    *height = h;
+
+    return 0;
+
+}
+
 guac_timestamp guacenc_parse_timestamp(const char* str) {
 
     int sign = 1;
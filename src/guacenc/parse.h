@@ -65,6 +65,37 @@ int guacenc_parse_int(char* arg, int* i);
  */
 int guacenc_parse_dimensions(char* arg, int* width, int* height);
 
+/**
+ * Parses a string of the form X,Y,WIDTHxHEIGHT into the individual X and Y
+ * coordinates and width and height of a rectangular region. The input string
+ * may be modified during parsing. Values will be stored in the provided
+ * pointers only if the given region is valid.
+ *
+ * @param arg
+ *     The string to parse.
+ *
+ * @param x
+ *     A pointer to the integer in which the parsed X coordinate of the
+ *     region should be stored.
+ *
+ * @param y
+ *     A pointer to the integer in which the parsed Y coordinate of the
+ *     region should be stored.
+ *
+ * @param width
+ *     A pointer to the integer in which the parsed width of the region
+ *     should be stored.
+ *
+ * @param height
+ *     A pointer to the integer in which the parsed height of the region
+ *     should be stored.
+ *
+ * @return
+ *     Zero if parsing was successful, non-zero if the provided string was
+ *     invalid.
+ */
+int guacenc_parse_region(char* arg, int* x, int* y, int* width, int* height);
+
 /**
  * Parses a guac_timestamp from the given string. The string is assumed to
  * consist solely of decimal digits with an optional leading minus sign. If the
@@ -31,6 +31,10 @@
 #include <libavutil/common.h>
 #include <libavutil/imgutils.h>
 #include <libswscale/swscale.h>
+
+#ifdef GUACENC_HAVE_AVCODEC_HWACCEL
+#include <libavutil/hwcontext.h>
+#endif
 #include <guacamole/client.h>
 #include <guacamole/mem.h>
 #include <guacamole/timestamp.h>
@@ -54,6 +58,14 @@ guacenc_video* guacenc_video_alloc(const char* path, const char* codec_name,
     int ret;
     int failed_header = 0;
 
+    /* Frames are composed in system memory in this format. If encoding is
+     * performed on a hardware device, composed frames are uploaded to the
+     * device in this format and converted there. */
+    enum AVPixelFormat sw_format = AV_PIX_FMT_YUV420P;
+
+    /* The hardware device performing the encoding, if any */
+    AVBufferRef* hwdevice = NULL;
+
     /* allocate the output media context */
     avformat_alloc_output_context2(&container_format_context, NULL, NULL, path);
     if (container_format_context == NULL) {
@@ -71,6 +83,40 @@ guacenc_video* guacenc_video_alloc(const char* path, const char* codec_name,
         goto fail_codec;
     }
 
+#ifdef GUACENC_HAVE_AVCODEC_HWACCEL
+    /* The pixel format of surfaces on the hardware device, if the chosen
+     * encoder requires one (VAAPI, NVENC, etc. consume frames residing on
+     * the device rather than in system memory) */
+    enum AVPixelFormat hw_format = AV_PIX_FMT_NONE;
+
+    /* Open the hardware device required by the chosen encoder, if any */
+    const AVCodecHWConfig* hw_config;
+    for (int i = 0; (hw_config = avcodec_get_hw_config(codec, i)) != NULL;
+            i++) {
+
+        if (!(hw_config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_FRAMES_CTX))
+            continue;
+
+        if (av_hwdevice_ctx_create(&hwdevice, hw_config->device_type,
+                    NULL, NULL, 0) < 0) {
+            guacenc_log(GUAC_LOG_ERROR, "Failed to open %s device required "
+                    "by encoder \"%s\".",
+                    av_hwdevice_get_type_name(hw_config->device_type),
+                    codec_name);
+            goto fail_codec;
+        }
+
+        hw_format = hw_config->pix_fmt;
+        sw_format = AV_PIX_FMT_NV12;
+
+        guacenc_log(GUAC_LOG_INFO, "Encoding will be performed in hardware "
+                "(%s).", av_hwdevice_get_type_name(hw_config->device_type));
+
+        break;
+
+    }
+#endif
+
     /* create stream */
     video_stream = NULL;
     video_stream = avformat_new_stream(container_format_context, codec);
@@ -93,6 +139,40 @@ guacenc_video* guacenc_video_alloc(const char* path, const char* codec_name,
         goto fail_context;
     }
 
+#ifdef GUACENC_HAVE_AVCODEC_HWACCEL
+    /* Encoders tied to a hardware device consume frames from a pool of
+     * surfaces residing on that device */
+    if (hwdevice != NULL) {
+
+        AVBufferRef* hwframe_ctx = av_hwframe_ctx_alloc(hwdevice);
+        if (hwframe_ctx == NULL) {
+            guacenc_log(GUAC_LOG_ERROR, "Failed to allocate hardware frame "
+                    "pool for codec \"%s\".", codec_name);
+            goto fail_codec_open;
+        }
+
+        AVHWFramesContext* hwframes = (AVHWFramesContext*) hwframe_ctx->data;
+        hwframes->format = hw_format;
+        hwframes->sw_format = sw_format;
+        hwframes->width = width;
+        hwframes->height = height;
+        hwframes->initial_pool_size = 8;
+
+        if (av_hwframe_ctx_init(hwframe_ctx) < 0) {
+            guacenc_log(GUAC_LOG_ERROR, "Failed to initialize hardware "
+                    "frame pool for codec \"%s\".", codec_name);
+            av_buffer_unref(&hwframe_ctx);
+            goto fail_codec_open;
+        }
+
+        /* The encoder receives frames in the hardware surface format; the
+         * frame pool reference is owned by the codec context from here on */
+        avcodec_context->hw_frames_ctx = hwframe_ctx;
+        avcodec_context->pix_fmt = hw_format;
+
+    }
+#endif
+
     /* If format needs global headers, write them */
     if (container_format_context->oformat->flags & AVFMT_GLOBALHEADER) {
         avcodec_context->flags |= GUACENC_FLAG_GLOBAL_HEADER;
@@ -110,8 +190,12 @@ guacenc_video* guacenc_video_alloc(const char* path, const char* codec_name,
         goto fail_frame;
     }
 
-    /* Copy necessary data for frame from context */
-    frame->format = avcodec_context->pix_fmt;
+    /* Copy necessary data for frame from context. The frame itself always
+     * resides in system memory: when encoding on a hardware device, it is
+     * the staging buffer uploaded to the device at encode time, and its
+     * format is the surface pool's software format rather than the
+     * encoder's. */
+    frame->format = sw_format;
     frame->width = avcodec_context->width;
     frame->height = avcodec_context->height;
 
@@ -147,6 +231,7 @@ guacenc_video* guacenc_video_alloc(const char* path, const char* codec_name,
     video->output_stream = video_stream;
     video->context = avcodec_context;
     video->container_format_context = container_format_context;
+    video->hwdevice = hwdevice;
     video->next_frame = frame;
     video->width = width;
     video->height = height;
@@ -186,10 +271,53 @@ fail_format_context:
 
 fail_context:
 fail_codec:
+    av_buffer_unref(&hwdevice);
     return NULL;
 
 }
 
+#ifdef GUACENC_HAVE_AVCODEC_HWACCEL
+/**
+ * Uploads the given software frame to a surface drawn from the hardware
+ * frame pool of the given video's encoder, submitting the uploaded surface
+ * to the encoder in its place.
+ *
+ * @param video
+ *     The video whose encoder resides on a hardware device.
+ *
+ * @param frame
+ *     The staged software frame to upload and encode.
+ *
+ * @return
+ *     A positive value if the frame was successfully written, zero if the
+ *     frame has been saved for later writing / reordering, negative if an
+ *     error occurs.
+ */
+static int guacenc_video_encode_hw_frame(guacenc_video* video,
+        AVFrame* frame) {
+
+    AVFrame* hwframe = av_frame_alloc();
+    if (hwframe == NULL)
+        return -1;
+
+    /* Pull surface from pool and upload staged frame contents */
+    if (av_hwframe_get_buffer(video->context->hw_frames_ctx, hwframe, 0) < 0
+            || av_hwframe_transfer_data(hwframe, frame, 0) < 0) {
+        guacenc_log(GUAC_LOG_WARNING, "Failed to upload frame #%" PRId64
+                " to hardware device.", video->next_pts);
+        av_frame_free(&hwframe);
+        return -1;
+    }
+
+    hwframe->pts = frame->pts;
+
+    int got_data = guacenc_avcodec_encode_video(video, hwframe);
+    av_frame_free(&hwframe);
+    return got_data;
+
+}
+#endif
+
 /**
  * Flushes the specified frame as a new frame of video, updating the internal
  * video timestamp by one frame's worth of time. The pts member of the given
@@ -215,8 +343,19 @@ static int guacenc_video_write_frame(guacenc_video* video, AVFrame* frame) {
     if (frame != NULL)
         frame->pts = video->next_pts;
 
-    /* Write frame to video */
-    int got_data = guacenc_avcodec_encode_video(video, frame);
+    /* Write frame to video, uploading it to the hardware device first if
+     * encoding is being performed there */
+    int got_data;
+
+#ifdef GUACENC_HAVE_AVCODEC_HWACCEL
+    if (frame != NULL && video->context->hw_frames_ctx != NULL)
+        got_data = guacenc_video_encode_hw_frame(video, frame);
+    else
+        got_data = guacenc_avcodec_encode_video(video, frame);
+#else
+    got_data = guacenc_avcodec_encode_video(video, frame);
+#endif
+
     if (got_data < 0)
         return -1;
 
@@ -441,7 +580,7 @@ void guacenc_video_prepare_frame(guacenc_video* video, guacenc_buffer* buffer) {
 
     /* Prepare scaling context */
     struct SwsContext* sws = sws_getContext(src->width, src->height,
-            AV_PIX_FMT_RGB32, dst->width, dst->height, AV_PIX_FMT_YUV420P,
+            AV_PIX_FMT_RGB32, dst->width, dst->height, dst->format,
             SWS_BICUBIC, NULL, NULL, NULL);
 
     /* Abort if scaling context could not be created */
@@ -506,6 +645,9 @@ int guacenc_video_free(guacenc_video* video) {
         avcodec_free_context(&(video->context));
     }
 
+    /* Release hardware device, if any */
+    av_buffer_unref(&video->hwdevice);
+
     guac_mem_free(video);
     return 0;
 
@@ -83,10 +83,19 @@ typedef struct guacenc_video {
      */
     int bitrate;
 
+    /**
+     * A reference to the hardware device performing the encoding, or NULL if
+     * encoding is performed entirely in software. Frames are uploaded to
+     * surfaces on this device as they are encoded.
+     */
+    AVBufferRef* hwdevice;
+
     /**
      * An image data area containing the next frame to be written, encoded as
      * YCbCr image data in the format required by avcodec_encode_video2(), for
-     * use and re-use as frames are rendered.
+     * use and re-use as frames are rendered. If encoding is performed on a
+     * hardware device, this frame is the staging buffer whose contents are
+     * uploaded to that device as each frame is encoded.
      */
     AVFrame* next_frame;
 
@@ -24,8 +24,120 @@
 #include "log.h"
 
 #include <getopt.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * The current state of a batch of interpreting jobs, shared by all worker
+ * threads. Each worker repeatedly claims the next unclaimed input file and
+ * interprets it until no files remain.
+ */
+typedef struct guaclog_batch {
+
+    /**
+     * Array of the paths of all input files to be interpreted.
+     */
+    char** paths;
+
+    /**
+     * The total number of input files within the paths array.
+     */
+    int total;
+
+    /**
+     * The index within the paths array of the next file that has not yet
+     * been claimed by a worker thread.
+     */
+    int next;
+
+    /**
+     * The number of files for which interpreting has failed so far.
+     */
+    int failures;
+
+    /**
+     * Lock which protects the next and failures members against concurrent
+     * modification by worker threads.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Whether interpreting should be attempted even for files which appear
+     * to be in-progress recordings.
+     */
+    bool force;
+
+    /**
+     * Whether output should be written as fixed-size binary event records
+     * rather than human-readable text.
+     */
+    bool binary;
+
+} guaclog_batch;
+
+/**
+ * Worker thread which continuously claims and interprets input files from
+ * the given batch until no unclaimed files remain.
+ *
+ * @param data
+ *     A pointer to the guaclog_batch describing the overall interpreting
+ *     job.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guaclog_batch_worker(void* data) {
+
+    guaclog_batch* batch = (guaclog_batch*) data;
+
+    for (;;) {
+
+        /* Claim next input file, if any */
+        pthread_mutex_lock(&(batch->lock));
+        int current = batch->next++;
+        pthread_mutex_unlock(&(batch->lock));
+
+        /* Terminate once all files have been claimed */
+        if (current >= batch->total)
+            break;
+
+        /* Get current filename */
+        const char* path = batch->paths[current];
+
+        /* Generate output filename */
+        char out_path[4096];
+        int len = snprintf(out_path, sizeof(out_path), "%s.%s", path,
+                batch->binary ? "glog" : "txt");
+
+        /* Do not write if filename exceeds maximum length */
+        if (len >= sizeof(out_path)) {
+            guaclog_log(GUAC_LOG_ERROR, "Cannot write output file for \"%s\": "
+                    "Name too long", path);
+            continue;
+        }
+
+        /* Attempt interpreting, log granular success/failure at debug level */
+        if (guaclog_interpret(path, out_path, batch->force, batch->binary)) {
+
+            pthread_mutex_lock(&(batch->lock));
+            batch->failures++;
+            pthread_mutex_unlock(&(batch->lock));
+
+            guaclog_log(GUAC_LOG_DEBUG,
+                    "%s was NOT successfully interpreted.", path);
+
+        }
+        else
+            guaclog_log(GUAC_LOG_DEBUG, "%s was successfully "
+                    "interpreted.", path);
+
+    }
+
+    return NULL;
+
+}
 
 int main(int argc, char* argv[]) {
 
@@ -33,13 +145,29 @@ int main(int argc, char* argv[]) {
 
     /* Load defaults */
     bool force = false;
+    bool binary = false;
+    int jobs = GUACLOG_DEFAULT_JOBS;
 
     /* Parse arguments */
     int opt;
-    while ((opt = getopt(argc, argv, "s:r:f")) != -1) {
+    while ((opt = getopt(argc, argv, "j:bf")) != -1) {
+
+        /* -j: Number of files to interpret concurrently */
+        if (opt == 'j') {
+            char* end;
+            jobs = strtol(optarg, &end, 10);
+            if (*end != '\0' || jobs < 1 || jobs > GUACLOG_MAX_JOBS) {
+                guaclog_log(GUAC_LOG_ERROR, "Invalid number of jobs.");
+                goto invalid_options;
+            }
+        }
+
+        /* -b: Binary output */
+        else if (opt == 'b')
+            binary = true;
 
         /* -f: Force */
-        if (opt == 'f')
+        else if (opt == 'f')
             force = true;
 
         /* Invalid option */
@@ -55,7 +183,6 @@ int main(int argc, char* argv[]) {
 
     /* Track number of overall failures */
     int total_files = argc - optind;
-    int failures = 0;
 
     /* Abort if no files given */
     if (total_files <= 0) {
@@ -65,39 +192,49 @@ int main(int argc, char* argv[]) {
 
     guaclog_log(GUAC_LOG_INFO, "%i input file(s) provided.", total_files);
 
-    /* Interpret all input files */
-    for (i = optind; i < argc; i++) {
+    /* No more workers than files are needed */
+    if (jobs > total_files)
+        jobs = total_files;
 
-        /* Get current filename */
-        const char* path = argv[i];
+    /* Describe overall batch of interpreting jobs */
+    guaclog_batch batch = {
+        .paths    = &(argv[optind]),
+        .total    = total_files,
+        .next     = 0,
+        .failures = 0,
+        .force    = force,
+        .binary   = binary
+    };
 
-        /* Generate output filename */
-        char out_path[4096];
-        int len = snprintf(out_path, sizeof(out_path), "%s.txt", path);
+    pthread_mutex_init(&(batch.lock), NULL);
 
-        /* Do not write if filename exceeds maximum length */
-        if (len >= sizeof(out_path)) {
-            guaclog_log(GUAC_LOG_ERROR, "Cannot write output file for \"%s\": "
-                    "Name too long", path);
-            continue;
+    /* Interpret all input files, spreading files across the requested number
+     * of worker threads */
+    pthread_t workers[GUACLOG_MAX_JOBS];
+    for (i = 0; i < jobs; i++) {
+        if (pthread_create(&(workers[i]), NULL, guaclog_batch_worker,
+                    &batch)) {
+            guaclog_log(GUAC_LOG_WARNING, "Unable to create worker thread. "
+                    "Files will be interpreted using %i worker(s).", i);
+            jobs = i;
+            break;
         }
+    }
 
-        /* Attempt interpreting, log granular success/failure at debug level */
-        if (guaclog_interpret(path, out_path, force)) {
-            failures++;
-            guaclog_log(GUAC_LOG_DEBUG,
-                    "%s was NOT successfully interpreted.", path);
-        }
-        else
-            guaclog_log(GUAC_LOG_DEBUG, "%s was successfully "
-                    "interpreted.", path);
+    /* If no workers could be created at all, run the batch directly */
+    if (jobs == 0)
+        guaclog_batch_worker(&batch);
 
-    }
+    /* Wait for all workers to finish */
+    for (i = 0; i < jobs; i++)
+        pthread_join(workers[i], NULL);
+
+    pthread_mutex_destroy(&(batch.lock));
 
     /* Warn if at least one file failed */
-    if (failures != 0)
+    if (batch.failures != 0)
         guaclog_log(GUAC_LOG_WARNING, "Interpreting failed for %i of %i "
-                "file(s).", failures, total_files);
+                "file(s).", batch.failures, total_files);
 
     /* Notify of success */
     else
@@ -110,6 +247,8 @@ int main(int argc, char* argv[]) {
 invalid_options:
 
     fprintf(stderr, "USAGE: %s"
+            " [-j JOBS]"
+            " [-b]"
             " [-f]"
             " [FILE]...\n", argv[0]);
 
@@ -27,5 +27,15 @@
  */
 #define GUACLOG_DEFAULT_LOG_LEVEL GUAC_LOG_INFO
 
+/**
+ * The default number of input files to interpret concurrently.
+ */
+#define GUACLOG_DEFAULT_JOBS 1
+
+/**
+ * The maximum number of input files which may be interpreted concurrently.
+ */
+#define GUACLOG_MAX_JOBS 64
+
 #endif
 
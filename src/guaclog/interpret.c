@@ -27,10 +27,12 @@
 #include <guacamole/parser.h>
 #include <guacamole/socket.h>
 
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <string.h>
 #include <unistd.h>
@@ -81,7 +83,76 @@ static int guaclog_read_instructions(guaclog_state* state,
 
 }
 
-int guaclog_interpret(const char* path, const char* out_path, bool force) {
+/**
+ * Handles all Guacamole instructions within the given buffer, which contains
+ * the full contents of a recording. Instruction elements are parsed in place,
+ * directly referencing (and modifying) the buffer contents, rather than being
+ * copied through the parser's internal buffer.
+ *
+ * @param state
+ *     The current state of the Guacamole input log interpreter.
+ *
+ * @param path
+ *     The name of the file being parsed (for logging purposes).
+ *
+ * @param buffer
+ *     The buffer containing the contents of the recording. The contents of
+ *     this buffer will be modified during parsing.
+ *
+ * @param length
+ *     The number of bytes within the buffer.
+ *
+ * @return
+ *     Zero on success, non-zero if parsing of Guacamole protocol data within
+ *     the given buffer fails.
+ */
+static int guaclog_read_instructions_buffer(guaclog_state* state,
+        const char* path, char* buffer, size_t length) {
+
+    /* Obtain Guacamole protocol parser */
+    guac_parser* parser = guac_parser_alloc();
+    if (parser == NULL)
+        return 1;
+
+    size_t offset = 0;
+    while (offset < length) {
+
+        /* Parse as much of the remaining data as possible */
+        size_t remaining = length - offset;
+        int parsed = guac_parser_append(parser, buffer + offset,
+                remaining > INT_MAX ? INT_MAX : (int) remaining);
+
+        /* Fail on parse error */
+        if (parser->state == GUAC_PARSE_ERROR) {
+            guaclog_log(GUAC_LOG_ERROR, "%s: Invalid instruction.", path);
+            guac_parser_free(parser);
+            return 1;
+        }
+
+        offset += parsed;
+
+        /* Handle instruction once complete */
+        if (parser->state == GUAC_PARSE_COMPLETE) {
+            guaclog_handle_instruction(state, parser->opcode,
+                    parser->argc, parser->argv);
+            guac_parser_reset(parser);
+        }
+
+        /* Stop at a truncated trailing instruction (no further data will
+         * become available) */
+        else if (parsed == 0)
+            break;
+
+    }
+
+    /* Parse complete */
+    guac_parser_free(parser);
+    return 0;
+
+}
+
+int guaclog_interpret(const char* path, const char* out_path, bool force,
+        bool binary) {
 
     /* Open input file */
     int fd = open(path, O_RDONLY);
@@ -118,12 +189,52 @@ int guaclog_interpret(const char* path, const char* out_path, bool force) {
     }
 
     /* Allocate input state for interpreting process */
-    guaclog_state* state = guaclog_state_alloc(out_path);
+    guaclog_state* state = guaclog_state_alloc(out_path, binary);
     if (state == NULL) {
         close(fd);
         return 1;
     }
 
+    /* Prefer parsing the recording in place via a private mapping, avoiding
+     * buffering every byte through read() and the parser's internal buffer.
+     * The mapping must be writable (copy-on-write), as elements are
+     * terminated in place during parsing. */
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == 0 && S_ISREG(file_stat.st_mode)
+            && file_stat.st_size > 0) {
+
+        char* buffer = mmap(NULL, file_stat.st_size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE, fd, 0);
+
+        if (buffer != MAP_FAILED) {
+
+#ifdef MADV_SEQUENTIAL
+            /* Advise the kernel of the strictly sequential read pattern */
+            madvise(buffer, file_stat.st_size, MADV_SEQUENTIAL);
+#endif
+
+            guaclog_log(GUAC_LOG_INFO, "Writing input events from \"%s\" "
+                    "to \"%s\" ...", path, out_path);
+
+            /* Attempt to read all instructions within the mapping */
+            int retval = guaclog_read_instructions_buffer(state, path,
+                    buffer, file_stat.st_size);
+
+            munmap(buffer, file_stat.st_size);
+            close(fd);
+
+            if (retval) {
+                guaclog_state_free(state);
+                return retval;
+            }
+
+            /* Finish interpreting process */
+            return guaclog_state_free(state);
+
+        }
+
+    }
+
     /* Obtain guac_socket wrapping file descriptor */
     guac_socket* socket = guac_socket_open(fd);
     if (socket == NULL) {
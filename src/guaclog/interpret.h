@@ -41,11 +41,16 @@
  *     Interpret even if the input file appears to be an in-progress log (has
  *     an associated lock).
  *
+ * @param binary
+ *     Write output as fixed-size binary event records ordered by timestamp,
+ *     rather than human-readable text.
+ *
  * @return
  *     Zero on success, non-zero if an error prevented successful
  *     interpretation of the log.
  */
-int guaclog_interpret(const char* path, const char* out_path, bool force);
+int guaclog_interpret(const char* path, const char* out_path, bool force,
+        bool binary);
 
 #endif
 
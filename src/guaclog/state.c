@@ -29,12 +29,51 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
-guaclog_state* guaclog_state_alloc(const char* path) {
+/**
+ * Writes the given value to the given stream as a little-endian unsigned
+ * 32-bit integer.
+ *
+ * @param output
+ *     The stream to write to.
+ *
+ * @param value
+ *     The value to write.
+ */
+static void guaclog_write_uint32(FILE* output, uint32_t value) {
+
+    unsigned char buffer[4] = {
+         value        & 0xFF,
+        (value >> 8)  & 0xFF,
+        (value >> 16) & 0xFF,
+        (value >> 24) & 0xFF
+    };
+
+    fwrite(buffer, 1, sizeof(buffer), output);
+
+}
+
+/**
+ * Writes the given value to the given stream as a little-endian unsigned
+ * 64-bit integer.
+ *
+ * @param output
+ *     The stream to write to.
+ *
+ * @param value
+ *     The value to write.
+ */
+static void guaclog_write_uint64(FILE* output, uint64_t value) {
+    guaclog_write_uint32(output, (uint32_t) (value & 0xFFFFFFFF));
+    guaclog_write_uint32(output, (uint32_t) (value >> 32));
+}
+
+guaclog_state* guaclog_state_alloc(const char* path, bool binary) {
 
     /* Open output file */
     int fd = open(path, O_CREAT | O_EXCL | O_WRONLY, S_IRUSR | S_IWUSR);
@@ -60,6 +99,16 @@ guaclog_state* guaclog_state_alloc(const char* path) {
 
     /* Associate state with output file */
     state->output = output;
+    state->binary = binary;
+
+    /* Binary output begins with a fixed header identifying the format and
+     * the version and size of the records which follow */
+    if (binary) {
+        fwrite(GUACLOG_BINARY_MAGIC, 1, 4, output);
+        guaclog_write_uint32(output, GUACLOG_BINARY_VERSION);
+        guaclog_write_uint32(output, GUACLOG_BINARY_RECORD_SIZE);
+        guaclog_write_uint32(output, 0); /* Reserved */
+    }
 
     /* No keys are initially tracked */
     state->active_keys = 0;
@@ -211,10 +260,21 @@ static bool guaclog_state_is_shortcut(guaclog_state* state) {
 
 }
 
-int guaclog_state_update_key(guaclog_state* state, int keysym, bool pressed) {
+int guaclog_state_update_key(guaclog_state* state, int keysym, bool pressed,
+        guac_timestamp timestamp) {
 
     int i;
 
+    /* Binary output consists solely of fixed-size, timestamp-ordered event
+     * records; no key state needs to be tracked, as no translation to
+     * human-readable shortcut names is performed */
+    if (state->binary) {
+        guaclog_write_uint64(state->output, (uint64_t) timestamp);
+        guaclog_write_uint32(state->output, (uint32_t) keysym);
+        guaclog_write_uint32(state->output, pressed ? 1 : 0);
+        return 0;
+    }
+
     /* Determine nature of key */
     guaclog_keydef* keydef = guaclog_keydef_alloc(keysym);
     if (keydef == NULL)
@@ -23,6 +23,8 @@
 #include "config.h"
 #include "keydef.h"
 
+#include <guacamole/timestamp.h>
+
 #include <stdbool.h>
 #include <stdio.h>
 
@@ -32,6 +34,21 @@
  */
 #define GUACLOG_MAX_KEYS 256
 
+/**
+ * The four bytes of magic identifying a file as a binary guaclog event log.
+ */
+#define GUACLOG_BINARY_MAGIC "GLOG"
+
+/**
+ * The version of the binary event log format written by this build of guaclog.
+ */
+#define GUACLOG_BINARY_VERSION 1
+
+/**
+ * The size of each event record within a binary guaclog event log, in bytes.
+ */
+#define GUACLOG_BINARY_RECORD_SIZE 16
+
 /**
  * The current state of a single key.
  */
@@ -59,6 +76,12 @@ typedef struct guaclog_state {
      */
     FILE* output;
 
+    /**
+     * Whether output should be written as fixed-size binary event records
+     * rather than human-readable text.
+     */
+    bool binary;
+
     /**
      * The number of keys currently being tracked within the key_states array.
      */
@@ -82,11 +105,15 @@ typedef struct guaclog_state {
  *     The full path to the file in which interpreted, human-readable should be
  *     written.
  *
+ * @param binary
+ *     Whether output should be written as fixed-size binary event records
+ *     rather than human-readable text.
+ *
  * @return
  *     The newly-allocated Guacamole input log interpreter state, or NULL if
  *     the state could not be allocated.
  */
-guaclog_state* guaclog_state_alloc(const char* path);
+guaclog_state* guaclog_state_alloc(const char* path, bool binary);
 
 /**
  * Frees all memory associated with the given Guacamole input log interpreter
@@ -115,11 +142,17 @@ int guaclog_state_free(guaclog_state* state);
  * @param pressed
  *     true if the key is being pressed, false if the key is being released.
  *
+ * @param timestamp
+ *     The timestamp of the key event, as recorded within the protocol dump,
+ *     or zero if the recording does not include timestamps. This value is
+ *     used only by binary output.
+ *
  * @return
  *     Zero if the interpreter state was updated successfully, non-zero
  *     otherwise.
  */
-int guaclog_state_update_key(guaclog_state* state, int keysym, bool pressed);
+int guaclog_state_update_key(guaclog_state* state, int keysym, bool pressed,
+        guac_timestamp timestamp);
 
 #endif
 
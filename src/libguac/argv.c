@@ -29,6 +29,7 @@
 #include "guacamole/user.h"
 
 #include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -69,6 +70,13 @@ typedef struct guac_argv_state {
      */
     void* data;
 
+    /**
+     * A 64-bit hash of the mimetype and value most recently accepted for this
+     * argument. This value is meaningful only if at least one value has been
+     * received and only if the GUAC_ARGV_OPTION_IF_CHANGED flag is set.
+     */
+    uint64_t value_hash;
+
 } guac_argv_state;
 
 /**
@@ -212,6 +220,38 @@ int guac_argv_await(const char** args) {
 
 }
 
+/**
+ * Returns a 64-bit hash (FNV-1a) of the given mimetype and value, suitable
+ * for detecting whether a newly-received argument value differs from the
+ * value most recently accepted. The null terminator of the mimetype is
+ * included in the hash, separating the mimetype from the value.
+ *
+ * @param mimetype
+ *     The mimetype of the received argument value.
+ *
+ * @param value
+ *     The received argument value.
+ *
+ * @return
+ *     A 64-bit hash of the given mimetype and value.
+ */
+static uint64_t guac_argv_hash(const char* mimetype, const char* value) {
+
+    uint64_t hash = UINT64_C(0xCBF29CE484222325);
+
+    /* Hash mimetype, including its null terminator as a separator */
+    do {
+        hash = (hash ^ (unsigned char) *mimetype) * UINT64_C(0x100000001B3);
+    } while (*(mimetype++) != '\0');
+
+    /* Hash value */
+    for (; *value != '\0'; value++)
+        hash = (hash ^ (unsigned char) *value) * UINT64_C(0x100000001B3);
+
+    return hash;
+
+}
+
 /**
  * Handler for "blob" instructions which appends the data from received blobs
  * to the end of the in-progress argument value buffer.
@@ -253,9 +293,25 @@ static int guac_argv_end_handler(guac_user* user, guac_stream* stream) {
 
     pthread_mutex_lock(&await_state.lock);
 
+    guac_argv_state* state = argv->state;
+
+    /* If only actual changes in value should be processed, ignore any
+     * received value that is identical to the most recently accepted value,
+     * invoking neither the callback nor the echo below */
+    uint64_t value_hash = 0;
+    if (state->options & GUAC_ARGV_OPTION_IF_CHANGED) {
+
+        value_hash = guac_argv_hash(argv->mimetype, argv->buffer);
+        if (state->received && value_hash == state->value_hash) {
+            pthread_mutex_unlock(&await_state.lock);
+            guac_mem_free(argv);
+            return 0;
+        }
+
+    }
+
     /* Invoke callback, limiting to a single invocation if
      * GUAC_ARGV_OPTION_ONCE applies */
-    guac_argv_state* state = argv->state;
     if (!(state->options & GUAC_ARGV_OPTION_ONCE) || !state->received) {
         if (state->callback != NULL)
             result = state->callback(user, argv->mimetype, state->name, argv->buffer, state->data);
@@ -268,9 +324,18 @@ static int guac_argv_end_handler(guac_user* user, guac_stream* stream) {
         guac_client_stream_argv(client, client->socket, argv->mimetype, state->name, argv->buffer);
     }
 
-    /* Notify that argument has been received */
-    state->received = 1;
-    pthread_cond_broadcast(&await_state.changed);
+    /* Note the hash of the now-accepted value such that future identical
+     * values can be recognized and ignored */
+    state->value_hash = value_hash;
+
+    /* Notify that argument has been received, waking any threads blocked
+     * within guac_argv_await() only if this is the first received value (the
+     * received flag never transitions back to zero, so repeated updates
+     * cannot affect the result of any pending wait) */
+    if (!state->received) {
+        state->received = 1;
+        pthread_cond_broadcast(&await_state.changed);
+    }
 
     pthread_mutex_unlock(&await_state.lock);
 
@@ -27,6 +27,10 @@
 #include "guacamole/user.h"
 #include "raw_encoder.h"
 
+#ifdef ENABLE_OPUS
+#include "opus_encoder.h"
+#endif
+
 #include <stdlib.h>
 #include <string.h>
 
@@ -89,6 +93,16 @@ static void* guac_audio_assign_encoder(guac_user* user, void* data) {
 
         const char* mimetype = user->info.audio_mimetypes[i];
 
+#ifdef ENABLE_OPUS
+        /* If Opus is supported, and the PCM format is one Opus accepts,
+         * done. */
+        if (opus_encoder_supports(audio->rate, audio->channels, bps)
+                && strcmp(mimetype, opus_encoder->mimetype) == 0) {
+            guac_audio_stream_set_encoder(audio, opus_encoder);
+            break;
+        }
+#endif
+
         /* If 16-bit raw audio is supported, done. */
         if (bps == 16 && strcmp(mimetype, raw16_encoder->mimetype) == 0) {
             guac_audio_stream_set_encoder(audio, raw16_encoder);
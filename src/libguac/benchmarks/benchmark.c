@@ -0,0 +1,550 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "display-plan.h"
+#include "display-priv.h"
+#include "encode-jpeg.h"
+#include "encode-png.h"
+
+#ifdef ENABLE_WEBP
+#include "encode-webp.h"
+#endif
+
+#include "guacamole/client.h"
+#include "guacamole/display.h"
+#include "guacamole/hash.h"
+#include "guacamole/mem.h"
+#include "guacamole/parser.h"
+#include "guacamole/protocol.h"
+#include "guacamole/rect.h"
+#include "guacamole/rwlock.h"
+#include "guacamole/socket.h"
+#include "guacamole/stream.h"
+#include "guacamole/timestamp.h"
+
+#include <cairo/cairo.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * Microbenchmark suite for the hot paths of libguac. Each benchmark runs a
+ * fixed number of iterations of a single operation against a monotonic clock
+ * and reports its results as one entry of a JSON array on STDOUT, such that
+ * results can be archived and compared across releases:
+ *
+ *     [
+ *       { "name": "...", "iterations": N, "total_ns": T, "ns_per_op": T/N },
+ *       ...
+ *     ]
+ *
+ * Absolute numbers are only meaningful on a quiet machine, and only relative
+ * to other runs on the same machine; the intent is to catch order-of-
+ * magnitude regressions in serialization, parsing, plan construction, and
+ * image encoding before they ship, not to serve as a precise profiler.
+ */
+
+/**
+ * The number of results that have been reported so far, used to emit JSON
+ * separators correctly.
+ */
+static int reported = 0;
+
+/**
+ * Returns the current value of a monotonic clock, in nanoseconds.
+ *
+ * @return
+ *     The current value of a monotonic clock, in nanoseconds.
+ */
+static int64_t benchmark_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/**
+ * Reports the result of a single benchmark as one entry of the overall JSON
+ * array being written to STDOUT.
+ *
+ * @param name
+ *     The name of the benchmark.
+ *
+ * @param iterations
+ *     The number of iterations that were performed.
+ *
+ * @param total_ns
+ *     The total number of nanoseconds that elapsed across all iterations.
+ */
+static void benchmark_report(const char* name, long iterations,
+        int64_t total_ns) {
+
+    printf("%s\n  { \"name\": \"%s\", \"iterations\": %ld, "
+            "\"total_ns\": %" PRId64 ", \"ns_per_op\": %.1f }",
+            reported ? "," : "[", name, iterations, total_ns,
+            (double) total_ns / iterations);
+
+    reported++;
+
+}
+
+/**
+ * Returns a guac_socket which writes to /dev/null, for benchmarking
+ * serialization without measuring any actual transport.
+ *
+ * @return
+ *     A newly-allocated guac_socket writing to /dev/null.
+ */
+static guac_socket* benchmark_null_socket(void) {
+    return guac_socket_open(open("/dev/null", O_WRONLY));
+}
+
+/**
+ * Returns a newly-allocated Cairo image surface of the given dimensions,
+ * filled with a synthetic gradient with moderate spatial detail (neither
+ * trivially compressible nor pure noise).
+ *
+ * @param width
+ *     The width of the surface to allocate, in pixels.
+ *
+ * @param height
+ *     The height of the surface to allocate, in pixels.
+ *
+ * @return
+ *     A newly-allocated Cairo image surface.
+ */
+static cairo_surface_t* benchmark_surface(int width, int height) {
+
+    int stride = cairo_format_stride_for_width(CAIRO_FORMAT_RGB24, width);
+
+    /* NOTE: This buffer is intentionally never freed. It must outlive the
+     * surface wrapping it, and benchmark fixtures live for the duration of
+     * the process anyway. */
+    unsigned char* data = guac_mem_alloc(guac_mem_ckd_mul_or_die(height, stride));
+
+    for (int y = 0; y < height; y++) {
+        uint32_t* row = (uint32_t*) (data + y * stride);
+        for (int x = 0; x < width; x++)
+            row[x] = (uint32_t) ((x * 7) ^ (y * 13)) * 2654435761u;
+    }
+
+    return cairo_image_surface_create_for_data(data, CAIRO_FORMAT_RGB24,
+            width, height, stride);
+
+}
+
+/**
+ * Benchmarks serialization and flush of small instructions through
+ * guac_socket, as performed for every sync and cursor update.
+ */
+static void benchmark_socket_flush(void) {
+
+    const long iterations = 200000;
+
+    guac_socket* socket = benchmark_null_socket();
+
+    int64_t start = benchmark_now();
+    for (long i = 0; i < iterations; i++) {
+        guac_protocol_send_sync(socket, (guac_timestamp) i, 1);
+        guac_socket_flush(socket);
+    }
+
+    benchmark_report("socket_send_sync_flush", iterations,
+            benchmark_now() - start);
+
+    guac_socket_free(socket);
+
+}
+
+/**
+ * Benchmarks base64 encoding of binary blobs through guac_socket, as
+ * performed for every image and audio blob sent to users.
+ */
+static void benchmark_base64_encode(void) {
+
+    const long iterations = 50000;
+    char blob[8192];
+
+    for (size_t i = 0; i < sizeof(blob); i++)
+        blob[i] = (char) (i * 31);
+
+    guac_socket* socket = benchmark_null_socket();
+
+    int64_t start = benchmark_now();
+    for (long i = 0; i < iterations; i++) {
+        guac_socket_write_base64(socket, blob, sizeof(blob));
+        guac_socket_flush_base64(socket);
+        guac_socket_flush(socket);
+    }
+
+    benchmark_report("socket_write_base64_8k", iterations,
+            benchmark_now() - start);
+
+    guac_socket_free(socket);
+
+}
+
+/**
+ * Benchmarks in-place decoding of base64 data, as performed for every blob
+ * received from users.
+ */
+static void benchmark_base64_decode(void) {
+
+    const long iterations = 200000;
+
+    /* Arbitrary valid base64 (48 decoded bytes) */
+    const char template[] =
+        "QXBhY2hlIEd1YWNhbW9sZSBpcyBhIGNsaWVudGxlc3MgcmVtb3Rl";
+
+    char encoded[sizeof(template)];
+
+    int64_t start = benchmark_now();
+    for (long i = 0; i < iterations; i++) {
+        memcpy(encoded, template, sizeof(template));
+        guac_protocol_decode_base64(encoded);
+    }
+
+    benchmark_report("protocol_decode_base64", iterations,
+            benchmark_now() - start);
+
+}
+
+/**
+ * The remaining number of times that the read handler of the parser
+ * benchmark's socket will provide instruction data before reporting
+ * end-of-stream.
+ */
+static long parser_reads_remaining = 0;
+
+/**
+ * Read handler which serves copies of a prepared Guacamole instruction until
+ * parser_reads_remaining is exhausted.
+ *
+ * @param socket
+ *     The socket being read from.
+ *
+ * @param buf
+ *     The buffer to fill with instruction data.
+ *
+ * @param count
+ *     The maximum number of bytes to write to the buffer.
+ *
+ * @return
+ *     The number of bytes written, or zero once the configured number of
+ *     reads has been exhausted.
+ */
+static ssize_t parser_benchmark_read(guac_socket* socket, void* buf,
+        size_t count) {
+
+    /* Representative mix of short and long elements */
+    const char instruction[] =
+        "3.key,5.65307,1.1,9.123456789,24.abcdefghijklmnopqrstuvwx;";
+
+    if (parser_reads_remaining <= 0)
+        return 0;
+    parser_reads_remaining--;
+
+    size_t length = sizeof(instruction) - 1;
+    if (length > count)
+        length = count;
+
+    memcpy(buf, instruction, length);
+    return (ssize_t) length;
+
+}
+
+/**
+ * Benchmarks parsing of complete instructions through guac_parser_read(), as
+ * performed for every instruction received from every user.
+ */
+static void benchmark_parser(void) {
+
+    const long iterations = 200000;
+
+    guac_socket* socket = guac_socket_alloc();
+    socket->read_handler = parser_benchmark_read;
+    parser_reads_remaining = iterations;
+
+    guac_parser* parser = guac_parser_alloc();
+
+    int64_t start = benchmark_now();
+    long parsed = 0;
+    while (guac_parser_read(parser, socket, 0) == 0)
+        parsed++;
+
+    benchmark_report("parser_read_instruction", parsed,
+            benchmark_now() - start);
+
+    guac_parser_free(parser);
+    guac_socket_free(socket);
+
+}
+
+/**
+ * Benchmarks the primitive rectangle operations used throughout dirty-rect
+ * tracking and display plan construction.
+ */
+static void benchmark_rect_ops(void) {
+
+    const long iterations = 1000000;
+
+    guac_rect bounds;
+    guac_rect_init(&bounds, 0, 0, 1024, 768);
+
+    volatile int sink = 0;
+
+    int64_t start = benchmark_now();
+    for (long i = 0; i < iterations; i++) {
+
+        guac_rect rect;
+        guac_rect_init(&rect, (int) (i % 991), (int) (i % 733), 64, 64);
+        guac_rect_align(&rect, 4);
+        guac_rect_constrain(&rect, &bounds);
+
+        guac_rect other;
+        guac_rect_init(&other, 512, 384, 128, 128);
+        guac_rect_extend(&other, &rect);
+
+        sink += guac_rect_intersects(&rect, &other);
+
+    }
+
+    benchmark_report("rect_init_align_constrain_extend", iterations,
+            benchmark_now() - start);
+
+    (void) sink;
+
+}
+
+/**
+ * Benchmarks the batch rectangle operations that process whole arrays of
+ * rectangles at once, as used when folding per-job dirty rects back into
+ * layer-level state during display plan construction.
+ */
+static void benchmark_rect_batch_ops(void) {
+
+    const long iterations = 10000;
+    enum { batch_size = 256 };
+
+    guac_rect bounds;
+    guac_rect_init(&bounds, 0, 0, 1024, 768);
+
+    guac_rect rects[batch_size];
+    for (int i = 0; i < batch_size; i++)
+        guac_rect_init(&rects[i], (i % 991) - 32, (i % 733) - 32, 64, 64);
+
+    volatile int sink = 0;
+
+    int64_t start = benchmark_now();
+    for (long i = 0; i < iterations; i++) {
+
+        guac_rect_constrain_all(rects, batch_size, &bounds);
+
+        guac_rect region = { 0 };
+        guac_rect_extend_all(&region, rects, batch_size);
+        sink += region.right;
+
+    }
+
+    benchmark_report("rect_batch_constrain_extend_256", iterations * batch_size,
+            benchmark_now() - start);
+
+    (void) sink;
+
+}
+
+/**
+ * Benchmarks hashing of image data, as used to detect scroll/copy
+ * opportunities during display plan construction.
+ */
+static void benchmark_hash_surface(void) {
+
+    const long iterations = 10000;
+
+    cairo_surface_t* surface = benchmark_surface(64, 64);
+
+    volatile unsigned int sink = 0;
+
+    int64_t start = benchmark_now();
+    for (long i = 0; i < iterations; i++)
+        sink += guac_hash_surface(surface);
+
+    benchmark_report("hash_surface_64x64", iterations,
+            benchmark_now() - start);
+
+    (void) sink;
+    cairo_surface_destroy(surface);
+
+}
+
+/**
+ * Benchmarks construction of a display plan for a synthetic frame in which
+ * the entire 1024x768 default layer is dirty, exercising the indexing,
+ * hashing, and operation staging performed for every rendered frame.
+ */
+static void benchmark_display_plan(void) {
+
+    const long iterations = 100;
+
+    guac_client* client = guac_client_alloc();
+    guac_display* display = guac_display_alloc(client);
+
+    guac_display_layer* default_layer = guac_display_default_layer(display);
+    guac_display_layer_resize(default_layer, 1024, 768);
+
+    int64_t total = 0;
+    for (long i = 0; i < iterations; i++) {
+
+        /* Touch every pixel of the pending frame so that each constructed
+         * plan covers the full display (the varying fill avoids any
+         * unchanged-frame shortcuts) */
+        guac_display_layer_raw_context* context =
+            guac_display_layer_open_raw(default_layer);
+
+        memset(context->buffer, (int) (i + 1), context->stride * 768);
+        guac_rect_init(&context->dirty, 0, 0, 1024, 768);
+
+        guac_display_layer_close_raw(default_layer, context);
+
+        /* Measure only the plan construction itself */
+        int64_t start = benchmark_now();
+
+        guac_rwlock_acquire_write_lock(&display->pending_frame.lock);
+        guac_rwlock_acquire_read_lock(&display->last_frame.lock);
+
+        guac_display_plan* plan = PFW_LFR_guac_display_plan_create(display);
+
+        guac_rwlock_release_lock(&display->last_frame.lock);
+        guac_rwlock_release_lock(&display->pending_frame.lock);
+
+        total += benchmark_now() - start;
+
+        if (plan != NULL)
+            guac_display_plan_free(plan);
+
+    }
+
+    benchmark_report("display_plan_create_1024x768", iterations, total);
+
+    guac_display_free(display);
+    guac_client_free(client);
+
+}
+
+/**
+ * Benchmarks encoding of a 256x256 synthetic image as a stream of JPEG
+ * blobs.
+ */
+static void benchmark_encode_jpeg(void) {
+
+    const long iterations = 500;
+
+    cairo_surface_t* surface = benchmark_surface(256, 256);
+    guac_socket* socket = benchmark_null_socket();
+    guac_stream stream = { .index = 1 };
+
+    int64_t start = benchmark_now();
+    for (long i = 0; i < iterations; i++)
+        guac_jpeg_write(socket, &stream, surface, 80);
+
+    benchmark_report("encode_jpeg_256x256_q80", iterations,
+            benchmark_now() - start);
+
+    guac_socket_free(socket);
+    cairo_surface_destroy(surface);
+
+}
+
+/**
+ * Benchmarks encoding of a 256x256 synthetic image as a stream of PNG
+ * blobs.
+ */
+static void benchmark_encode_png(void) {
+
+    const long iterations = 100;
+
+    cairo_surface_t* surface = benchmark_surface(256, 256);
+    guac_socket* socket = benchmark_null_socket();
+    guac_stream stream = { .index = 1 };
+
+    int64_t start = benchmark_now();
+    for (long i = 0; i < iterations; i++)
+        guac_png_write(socket, &stream, surface);
+
+    benchmark_report("encode_png_256x256", iterations,
+            benchmark_now() - start);
+
+    guac_socket_free(socket);
+    cairo_surface_destroy(surface);
+
+}
+
+#ifdef ENABLE_WEBP
+/**
+ * Benchmarks encoding of a 256x256 synthetic image as a stream of WebP
+ * blobs.
+ */
+static void benchmark_encode_webp(void) {
+
+    const long iterations = 100;
+
+    cairo_surface_t* surface = benchmark_surface(256, 256);
+    guac_socket* socket = benchmark_null_socket();
+    guac_stream stream = { .index = 1 };
+
+    int64_t start = benchmark_now();
+    for (long i = 0; i < iterations; i++)
+        guac_webp_write(socket, &stream, surface, 80, 0);
+
+    benchmark_report("encode_webp_256x256_q80", iterations,
+            benchmark_now() - start);
+
+    guac_socket_free(socket);
+    cairo_surface_destroy(surface);
+
+}
+#endif
+
+int main(void) {
+
+    benchmark_socket_flush();
+    benchmark_base64_encode();
+    benchmark_base64_decode();
+    benchmark_parser();
+    benchmark_rect_ops();
+    benchmark_rect_batch_ops();
+    benchmark_hash_surface();
+    benchmark_display_plan();
+    benchmark_encode_jpeg();
+    benchmark_encode_png();
+
+#ifdef ENABLE_WEBP
+    benchmark_encode_webp();
+#endif
+
+    printf("\n]\n");
+    return 0;
+
+}
@@ -34,6 +34,7 @@
 #include "guacamole/stream.h"
 #include "guacamole/string.h"
 #include "guacamole/timestamp.h"
+#include "guacamole/unicode.h"
 #include "guacamole/user.h"
 #include "id.h"
 
@@ -268,7 +269,7 @@ guac_client* guac_client_alloc() {
 
     client->args = __GUAC_CLIENT_NO_ARGS;
     client->state = GUAC_CLIENT_RUNNING;
-    client->last_sent_timestamp = guac_timestamp_current();
+    client->last_sent_timestamp = guac_timestamp_current_coarse();
 
     /* Generate ID */
     client->connection_id = guac_generate_id(GUAC_CLIENT_ID_PREFIX);
@@ -360,6 +361,7 @@ void guac_client_free(guac_client* client) {
     guac_rwlock_destroy(&(client->__users_lock));
     guac_rwlock_destroy(&(client->__pending_users_lock));
 
+    guac_mem_free(client->__cached_args);
     guac_mem_free(client->connection_id);
     guac_mem_free(client);
 }
@@ -625,8 +627,11 @@ int guac_client_end_frame(guac_client* client) {
 
 int guac_client_end_multiple_frames(guac_client* client, int frames) {
 
-    /* Update and send timestamp */
-    client->last_sent_timestamp = guac_timestamp_current();
+    /* Update and send timestamp (the coarse time source suffices here, as
+     * this timestamp merely identifies the frame within "sync" exchanges and
+     * feeds processing lag estimates with thresholds of tens of
+     * milliseconds) */
+    client->last_sent_timestamp = guac_timestamp_current_coarse();
 
     /* Log received timestamp and calculated lag (at TRACE level only) */
     guac_client_log(client, GUAC_LOG_TRACE, "Server completed "
@@ -636,30 +641,142 @@ int guac_client_end_multiple_frames(guac_client* client, int frames) {
 
 }
 
+/**
+ * Renders the "args" instruction advertising the arguments accepted by the
+ * given client, storing the rendered instruction within the client such that
+ * each subsequent handshake can reuse it verbatim. The argument list declared
+ * by a client plugin is static once guac_client_init has completed, so the
+ * instruction is identical for every user that joins the connection. If the
+ * client declares no arguments, this function has no effect, and the
+ * handshake will fall back to building the instruction directly.
+ *
+ * @param client
+ *     The client whose "args" instruction should be rendered.
+ */
+static void __guac_client_render_cached_args(guac_client* client) {
+
+    const char** arg;
+
+    /* Nothing to render if the plugin declares no arguments */
+    if (client->args == NULL)
+        return;
+
+    /* Calculate space required by the opcode and protocol version element */
+    size_t length = snprintf(NULL, 0, "4.args,%i.%s",
+            (int) guac_utf8_strlen(GUACAMOLE_PROTOCOL_VERSION),
+            GUACAMOLE_PROTOCOL_VERSION);
+
+    /* Add space required by each declared argument (lengths within the
+     * instruction count characters, not bytes) */
+    for (arg = client->args; *arg != NULL; arg++)
+        length += snprintf(NULL, 0, ",%i.%s",
+                (int) guac_utf8_strlen(*arg), *arg);
+
+    /* Render instruction, leaving room for the terminator and NUL byte */
+    char* rendered = guac_mem_alloc(guac_mem_ckd_add_or_die(length, 2));
+    char* current = rendered + sprintf(rendered, "4.args,%i.%s",
+            (int) guac_utf8_strlen(GUACAMOLE_PROTOCOL_VERSION),
+            GUACAMOLE_PROTOCOL_VERSION);
+
+    for (arg = client->args; *arg != NULL; arg++)
+        current += sprintf(current, ",%i.%s",
+                (int) guac_utf8_strlen(*arg), *arg);
+
+    *(current++) = ';';
+    *current = '\0';
+
+    client->__cached_args = rendered;
+    client->__cached_args_length = (size_t) (current - rendered);
+
+}
+
+/**
+ * Renders the filename of the shared library providing support for the given
+ * protocol into the given buffer, which must be at least
+ * GUAC_PROTOCOL_LIBRARY_LIMIT bytes in length. If the name of the protocol is
+ * too long to produce a valid library filename, guac_error is set
+ * appropriately.
+ *
+ * @param protocol
+ *     The name of the protocol.
+ *
+ * @param protocol_lib
+ *     The buffer that should receive the library filename.
+ *
+ * @return
+ *     Zero if the library filename was successfully rendered, non-zero if the
+ *     protocol name is too long.
+ */
+static int __guac_client_get_protocol_library(const char* protocol,
+        char* protocol_lib) {
+
+    /* Add prefix, protocol, and .so suffix to protocol_lib */
+    guac_strlcpy(protocol_lib, GUAC_PROTOCOL_LIBRARY_PREFIX,
+            GUAC_PROTOCOL_LIBRARY_LIMIT);
+    guac_strlcat(protocol_lib, protocol, GUAC_PROTOCOL_LIBRARY_LIMIT);
+    if (guac_strlcat(protocol_lib, GUAC_PROTOCOL_LIBRARY_SUFFIX,
+                GUAC_PROTOCOL_LIBRARY_LIMIT) >= GUAC_PROTOCOL_LIBRARY_LIMIT) {
+        guac_error = GUAC_STATUS_NO_MEMORY;
+        guac_error_message = "Protocol name is too long";
+        return -1;
+    }
+
+    return 0;
+
+}
+
+int guac_client_preload_plugin(const char* protocol) {
+
+    /* Pluggable client */
+    char protocol_lib[GUAC_PROTOCOL_LIBRARY_LIMIT];
+    if (__guac_client_get_protocol_library(protocol, protocol_lib))
+        return -1;
+
+    /* Load the plugin with all symbols resolved immediately, such that
+     * processes forked later inherit the fully-relocated mapping and their
+     * own dlopen() of the same plugin reduces to a reference count bump */
+    void* client_plugin_handle = dlopen(protocol_lib, RTLD_NOW);
+    if (!client_plugin_handle) {
+        guac_error = GUAC_STATUS_NOT_FOUND;
+        guac_error_message = dlerror();
+        return -1;
+    }
+
+    dlerror(); /* Clear errors */
+
+    /* Verify the plugin provides guac_client_init, as will be required when
+     * the plugin is actually used */
+    dlsym(client_plugin_handle, "guac_client_init");
+    if (dlerror() != NULL) {
+        guac_error = GUAC_STATUS_INTERNAL_ERROR;
+        guac_error_message = "Plugin does not provide guac_client_init";
+        dlclose(client_plugin_handle);
+        return -1;
+    }
+
+    /* The handle is intentionally never closed - the plugin must remain
+     * mapped for the life of the process for preloading to have any effect */
+    return 0;
+
+}
+
 int guac_client_load_plugin(guac_client* client, const char* protocol) {
 
     /* Reference to dlopen()'d plugin */
     void* client_plugin_handle;
 
     /* Pluggable client */
-    char protocol_lib[GUAC_PROTOCOL_LIBRARY_LIMIT] =
-        GUAC_PROTOCOL_LIBRARY_PREFIX;
+    char protocol_lib[GUAC_PROTOCOL_LIBRARY_LIMIT];
 
     /* Type-pun for the sake of dlsym() - cannot typecast a void* to a function
-     * pointer otherwise */ 
+     * pointer otherwise */
     union {
         guac_client_init_handler* client_init;
         void* obj;
     } alias;
 
-    /* Add protocol and .so suffix to protocol_lib */
-    guac_strlcat(protocol_lib, protocol, sizeof(protocol_lib));
-    if (guac_strlcat(protocol_lib, GUAC_PROTOCOL_LIBRARY_SUFFIX,
-                sizeof(protocol_lib)) >= sizeof(protocol_lib)) {
-        guac_error = GUAC_STATUS_NO_MEMORY;
-        guac_error_message = "Protocol name is too long";
+    if (__guac_client_get_protocol_library(protocol, protocol_lib))
         return -1;
-    }
 
     /* Load client plugin */
     client_plugin_handle = dlopen(protocol_lib, RTLD_LAZY);
@@ -685,7 +802,15 @@ int guac_client_load_plugin(guac_client* client, const char* protocol) {
     /* Init client */
     client->__plugin_handle = client_plugin_handle;
 
-    return alias.client_init(client);
+    int retval = alias.client_init(client);
+
+    /* Render the static "args" instruction once, now that the plugin has
+     * declared its argument list, rather than rebuilding the instruction for
+     * every handshake */
+    if (retval == 0)
+        __guac_client_render_cached_args(client);
+
+    return retval;
 
 }
 
@@ -1076,3 +1201,106 @@ int guac_client_supports_webp(guac_client* client) {
 
 }
 
+/**
+ * Callback which is invoked for each user of a client to determine whether
+ * that user supports the cells instruction, clearing the flag provided via
+ * data if any user lacks support.
+ *
+ * @param user
+ *     The user to check for cells instruction support.
+ *
+ * @param data
+ *     A pointer to an int containing a non-zero value if all users checked
+ *     thus far support the cells instruction.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* __cell_run_support_callback(guac_user* user, void* data) {
+
+    int* cell_runs_supported = (int*) data;
+
+    /* Check whether current user supports the cells instruction */
+    if (*cell_runs_supported)
+        *cell_runs_supported = guac_user_supports_cell_runs(user);
+
+    return NULL;
+
+}
+
+int guac_client_supports_cell_runs(guac_client* client) {
+
+    int cell_runs_supported = 1;
+
+    /* The cells instruction may be broadcast only if each user supports
+     * it */
+    guac_client_foreach_user(client, __cell_run_support_callback,
+            &cell_runs_supported);
+
+    return cell_runs_supported;
+
+}
+
+/**
+ * The current state of a search for support of a particular video mimetype
+ * across all users of a client, as performed by
+ * guac_client_supports_video().
+ */
+typedef struct guac_client_video_support_search {
+
+    /**
+     * The video mimetype being searched for.
+     */
+    const char* mimetype;
+
+    /**
+     * Whether all users checked so far support the mimetype. This flag will
+     * be 0 if any user already checked has lacked support, or 1 otherwise.
+     */
+    int supported;
+
+} guac_client_video_support_search;
+
+/**
+ * Callback which is invoked by guac_client_supports_video() for each user
+ * associated with the given client, thus updating an overall support flag
+ * describing the video support state for the client as a whole.
+ *
+ * @param user
+ *     The user to check for support of the video mimetype in question.
+ *
+ * @param data
+ *     Pointer to the guac_client_video_support_search state of the search
+ *     being performed.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* __video_support_callback(guac_user* user, void* data) {
+
+    guac_client_video_support_search* search =
+        (guac_client_video_support_search*) data;
+
+    /* Check whether current user supports the mimetype in question */
+    if (search->supported)
+        search->supported = guac_user_supports_video(user, search->mimetype);
+
+    return NULL;
+
+}
+
+int guac_client_supports_video(guac_client* client, const char* mimetype) {
+
+    guac_client_video_support_search search = {
+        .mimetype = mimetype,
+        .supported = 1
+    };
+
+    /* A video mimetype is supported for the entire client only if each user
+     * supports it */
+    guac_client_foreach_user(client, __video_support_callback, &search);
+
+    return search.supported;
+
+}
+
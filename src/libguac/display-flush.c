@@ -140,6 +140,7 @@ static int PFW_LFW_guac_display_frame_complete(guac_display* display) {
 
             guac_mem_free(current->last_frame.buffer);
             current->last_frame.buffer = guac_mem_zalloc(buffer_size);
+            guac_mem_advise_huge_pages(current->last_frame.buffer, buffer_size);
             memcpy(current->last_frame.buffer, current->pending_frame.buffer, buffer_size);
 
             current->last_frame.buffer_stride = current->pending_frame.buffer_stride;
@@ -149,6 +150,10 @@ static int PFW_LFW_guac_display_frame_complete(guac_display* display) {
             current->last_frame.dirty = current->pending_frame.dirty;
             current->pending_frame.dirty = (guac_rect) { 0 };
 
+            /* Invalidate any cached encoding of the previous frame */
+            guac_mem_free(current->last_frame_png);
+            current->last_frame_png_size = 0;
+
             retval = 1;
 
         }
@@ -156,14 +161,21 @@ static int PFW_LFW_guac_display_frame_complete(guac_display* display) {
         /* Copy over pending frame contents if actually changed (this is not
          * necessary if the last_frame buffer was resized to match
          * pending_frame, as a copy from pending_frame to last_frame is
-         * inherently part of that) */
+         * inherently part of that). The dirty rect will have been refined by
+         * the earlier search for modified regions and covers all remaining
+         * differences between the two buffers, so only that region need be
+         * copied. This is particularly relevant for large displays backed by
+         * external buffers, where a small update would otherwise incur a
+         * full-frame copy. */
         else if (!guac_rect_is_empty(&current->pending_frame.dirty)) {
 
-            unsigned char* pending_frame = current->pending_frame.buffer;
-            unsigned char* last_frame = current->last_frame.buffer;
-            size_t row_length = guac_mem_ckd_mul_or_die(current->pending_frame.width, 4);
+            guac_rect dirty = current->pending_frame.dirty;
+
+            const unsigned char* pending_frame = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(current->pending_frame, dirty);
+            unsigned char* last_frame = GUAC_DISPLAY_LAYER_STATE_MUTABLE_BUFFER(current->last_frame, dirty);
+            size_t row_length = guac_mem_ckd_mul_or_die(guac_rect_width(&dirty), 4);
 
-            for (int y = 0; y < current->pending_frame.height; y++) {
+            for (int y = dirty.top; y < dirty.bottom; y++) {
                 memcpy(last_frame, pending_frame, row_length);
                 last_frame += current->last_frame.buffer_stride;
                 pending_frame += current->pending_frame.buffer_stride;
@@ -172,10 +184,23 @@ static int PFW_LFW_guac_display_frame_complete(guac_display* display) {
             current->last_frame.dirty = current->pending_frame.dirty;
             current->pending_frame.dirty = (guac_rect) { 0 };
 
+            /* Invalidate any cached encoding of the previous frame */
+            guac_mem_free(current->last_frame_png);
+            current->last_frame_png_size = 0;
+
             retval = 1;
 
         }
 
+        /* Restore any dirty region that was deferred by the occlusion culling
+         * pass. Such regions were neither diffed nor copied above and remain
+         * pending, such that they will be re-examined (and finally sent, if
+         * revealed) as part of future frames. */
+        if (!guac_rect_is_empty(&current->pending_frame.occluded_dirty)) {
+            current->pending_frame.dirty = current->pending_frame.occluded_dirty;
+            current->pending_frame.occluded_dirty = (guac_rect) { 0 };
+        }
+
         /* Commit any change in layer size */
         if (current->pending_frame.width != current->last_frame.width
                 || current->pending_frame.height != current->last_frame.height) {
@@ -186,6 +211,10 @@ static int PFW_LFW_guac_display_frame_complete(guac_display* display) {
             current->last_frame.width = current->pending_frame.width;
             current->last_frame.height = current->pending_frame.height;
 
+            /* Invalidate any cached encoding of the previous frame */
+            guac_mem_free(current->last_frame_png);
+            current->last_frame_png_size = 0;
+
             retval = 1;
 
         }
@@ -239,6 +268,10 @@ static int PFW_LFW_guac_display_frame_complete(guac_display* display) {
         current->last_frame.search_for_copies = current->pending_frame.search_for_copies;
         current->pending_frame.search_for_copies = 0;
 
+        /* Explicit copy hints apply only to the frame that was just flushed
+         * (they reference the contents of what is now the last frame) */
+        current->pending_frame.num_copy_hints = 0;
+
         /* Commit any change in lossless setting (no need to synchronize this
          * to the client - it affects only how last_frame is interpreted) */
         current->last_frame.lossless = current->pending_frame.lossless;
@@ -280,6 +313,156 @@ static int PFW_LFW_guac_display_frame_complete(guac_display* display) {
 
 }
 
+/**
+ * The amount of time that a region sent using lossy encoding must remain
+ * unchanged before it is re-encoded losslessly, in milliseconds. Regions
+ * still being updated will be resent shortly anyway and gain nothing from
+ * refinement, while a region that has held still this long has likely reached
+ * the end of its burst of updates.
+ */
+#define GUAC_DISPLAY_REFINE_DELAY 500
+
+/**
+ * The client-reported processing lag beyond which lossless refinement is
+ * deferred, in milliseconds. Refinement is purely an improvement in quality
+ * over content the client has already received, and should not compete for
+ * bandwidth while the client is struggling to keep up with the frames that
+ * actually carry new content.
+ */
+#define GUAC_DISPLAY_REFINE_LAG 30
+
+/**
+ * The maximum total area that will be refined losslessly in a single frame,
+ * in pixels. Stabilized regions larger than this budget are refined in
+ * slices, one budget's worth per frame, such that the bandwidth consumed by
+ * refinement traffic remains bounded regardless of how much of the display
+ * went lossy during the preceding burst of updates.
+ */
+#define GUAC_DISPLAY_REFINE_BUDGET (512 * 512)
+
+/**
+ * Records the regions of the given plan that are eligible for lossy encoding
+ * against their corresponding layers, and losslessly re-encodes any
+ * previously-recorded regions that have since stabilized. A region qualifies
+ * for refinement once it has remained unchanged for
+ * GUAC_DISPLAY_REFINE_DELAY milliseconds while the client-reported processing
+ * lag is healthy. Refinement operations are enqueued directly for the worker
+ * threads rather than replanned: the refined content is already identical
+ * within the pending and last frames, so a diff would produce nothing. At
+ * most GUAC_DISPLAY_REFINE_BUDGET pixels are refined per frame, with any
+ * remainder carried forward to subsequent frames.
+ *
+ * @param display
+ *     The display whose stabilized lossy regions should be refined.
+ *
+ * @param plan
+ *     The plan for the frame that was just committed, or NULL if the frame
+ *     produced no graphical operations.
+ *
+ * @return
+ *     The number of refinement operations enqueued.
+ */
+static int LFW_guac_display_refine_lossy_regions(guac_display* display,
+        guac_display_plan* plan) {
+
+    guac_timestamp now = guac_timestamp_current();
+
+    /* Note the regions that the workers may choose to encode lossily. Rather
+     * than duplicate the content heuristics of the workers here, the recorded
+     * region is a superset (refining a region that was actually sent
+     * losslessly is wasteful but harmless). Regions still receiving updates
+     * have their timestamps refreshed, restarting the stability clock. */
+    if (plan != NULL) {
+        guac_display_plan_operation* op = plan->ops;
+        for (int i = 0; i < plan->length; i++, op++) {
+            if (op->type == GUAC_DISPLAY_PLAN_OPERATION_IMG
+                    && op->framerate >= GUAC_DISPLAY_JPEG_FRAMERATE) {
+                guac_rect_extend(&op->layer->lossy_dirty, &op->dest);
+                op->layer->lossy_dirty_time = now;
+            }
+        }
+    }
+
+    /* Leave regions at their current quality while the client is struggling
+     * to keep up (refinement is deferred, not lost - recorded regions persist
+     * until actually refined) */
+    if (guac_client_get_processing_lag(display->client)
+            > GUAC_DISPLAY_REFINE_LAG)
+        return 0;
+
+    int refined = 0;
+    int budget = GUAC_DISPLAY_REFINE_BUDGET;
+    guac_display_layer* current = display->last_frame.layers;
+    while (current != NULL && budget > 0) {
+
+        guac_rect* lossy_dirty = &current->lossy_dirty;
+        if (!guac_rect_is_empty(lossy_dirty)
+                && now - current->lossy_dirty_time >= GUAC_DISPLAY_REFINE_DELAY
+                && current->last_frame.buffer != NULL) {
+
+            /* The layer may have shrunk since the region was recorded */
+            guac_rect bounds = {
+                .left   = 0,
+                .top    = 0,
+                .right  = current->last_frame.width,
+                .bottom = current->last_frame.height
+            };
+            guac_rect_constrain(lossy_dirty, &bounds);
+
+            if (!guac_rect_is_empty(lossy_dirty)) {
+
+                guac_rect refine_rect = *lossy_dirty;
+
+                /* Refine only as many rows as fit within the remaining
+                 * budget, leaving the rest of the region recorded (with its
+                 * stability timestamp intact) for the frames that follow */
+                int width = guac_rect_width(&refine_rect);
+                int height = guac_rect_height(&refine_rect);
+                if (width * height > budget) {
+                    int budgeted_rows = budget / width;
+                    if (budgeted_rows < 1)
+                        budgeted_rows = 1;
+                    if (budgeted_rows < height)
+                        refine_rect.bottom = refine_rect.top + budgeted_rows;
+                }
+
+                /* A framerate of zero guarantees that the workers will choose
+                 * lossless encoding for this operation */
+                guac_display_plan_operation refine_op = {
+                    .layer = current,
+                    .type = GUAC_DISPLAY_PLAN_OPERATION_IMG,
+                    .dest = refine_rect,
+                    .framerate = 0,
+                    .refinement = 1
+                };
+
+                guac_fifo_enqueue(&display->ops, &refine_op);
+                refined++;
+
+                budget -= guac_rect_width(&refine_rect)
+                    * guac_rect_height(&refine_rect);
+
+                /* Trim the refined slice from the recorded region, clearing
+                 * the region entirely if it has now been fully refined */
+                if (refine_rect.bottom < lossy_dirty->bottom)
+                    lossy_dirty->top = refine_rect.bottom;
+                else
+                    *lossy_dirty = (guac_rect) { 0 };
+
+            }
+            else
+                *lossy_dirty = (guac_rect) { 0 };
+
+        }
+
+        current = current->last_frame.next;
+
+    }
+
+    return refined;
+
+}
+
 void guac_display_end_mouse_frame(guac_display* display) {
 
     guac_rwlock_acquire_write_lock(&display->pending_frame.lock);
@@ -294,6 +477,8 @@ void guac_display_end_mouse_frame(guac_display* display) {
 void guac_display_end_multiple_frames(guac_display* display, int frames) {
 
     guac_display_plan* plan = NULL;
+    guac_timestamp plan_start = 0;
+    int frame_dispatched = 0;
 
     guac_rwlock_acquire_write_lock(&display->pending_frame.lock);
     display->pending_frame.frames += frames;
@@ -303,6 +488,14 @@ void guac_display_end_multiple_frames(guac_display* display, int frames) {
      * the pending frame. */
 
     guac_fifo_lock(&display->ops);
+
+    /* Stamp the time that the end of this frame was first requested, such
+     * that time spent waiting behind an in-progress frame is visible as its
+     * own stage within per-frame trace output (requests deferred below retain
+     * their original timestamp) */
+    if (display->frame_trace_requested == 0)
+        display->frame_trace_requested = guac_timestamp_current();
+
     int defer_frame = display->frame_deferred =
         (display->ops.state.value & GUAC_FIFO_STATE_NONEMPTY) || display->active_workers;
     guac_fifo_unlock(&display->ops);
@@ -311,9 +504,20 @@ void guac_display_end_multiple_frames(guac_display* display, int frames) {
         goto finished_with_pending_frame_lock;
 
     guac_rwlock_acquire_write_lock(&display->last_frame.lock);
+    plan_start = guac_timestamp_current();
+
+    /* PASS 0 (part 1): Subtract regions hidden behind opaque layers from the
+     * dirty rect of each layer, such that updates to entirely obscured
+     * regions (such as windows covered by other windows in multi-layer
+     * sessions) are neither diffed nor encoded. The subtracted regions are
+     * deferred rather than discarded, and are restored to each layer's dirty
+     * rect when the frame is completed below. */
+    GUAC_DISPLAY_PLAN_BEGIN_PHASE();
+    PFW_guac_display_plan_cull_occluded(display);
+    GUAC_DISPLAY_PLAN_END_PHASE(display, "occlusion", 1, 7);
 
-    /* PASS 0: Create naive plan, identify minimal dirty rects by comparing the
-     * changes between the pending and last frames.
+    /* PASS 0 (part 2): Create naive plan, identify minimal dirty rects by
+     * comparing the changes between the pending and last frames.
      *
      * This plan will contain operations covering only the minimal parts of the
      * display that have changed, but is naive in the sense that it only
@@ -322,7 +526,7 @@ void guac_display_end_multiple_frames(guac_display* display, int frames) {
      * passes. */
     GUAC_DISPLAY_PLAN_BEGIN_PHASE();
     plan = PFW_LFR_guac_display_plan_create(display);
-    GUAC_DISPLAY_PLAN_END_PHASE(display, "draft", 1, 5);
+    GUAC_DISPLAY_PLAN_END_PHASE(display, "draft", 2, 7);
 
     if (plan != NULL) {
 
@@ -332,16 +536,23 @@ void guac_display_end_multiple_frames(guac_display* display, int frames) {
          * replace those operations with simple rectangle draws. */
         GUAC_DISPLAY_PLAN_BEGIN_PHASE();
         PFR_guac_display_plan_rewrite_as_rects(plan);
-        GUAC_DISPLAY_PLAN_END_PHASE(display, "rects", 2, 5);
-
-        /* PASS 2 (and 3): Index all modified cells by their graphical contents and
-         * search the previous frame for occurrences of the same content. Where any
-         * draws could instead be represented as copies from the previous frame, do
-         * so instead of sending new image data. */
+        GUAC_DISPLAY_PLAN_END_PHASE(display, "rects", 3, 7);
+
+        /* PASS 2 (and 3): Apply any explicit copy hints provided by the
+         * protocol implementation and detect any unhinted vertical shifts
+         * (scrolls), then index all remaining modified cells by their
+         * graphical contents and search the previous frame (and the
+         * longer-lived tile cache) for occurrences of the same content. Where
+         * any draws could instead be represented as copies, do so instead of
+         * sending new image data. */
         GUAC_DISPLAY_PLAN_BEGIN_PHASE();
+        PFR_LFR_guac_display_plan_apply_copy_hints(plan);
+        PFR_LFR_guac_display_plan_detect_scrolls(plan);
         PFR_guac_display_plan_index_dirty_cells(plan);
         PFR_LFR_guac_display_plan_rewrite_as_copies(plan);
-        GUAC_DISPLAY_PLAN_END_PHASE(display, "search", 3, 5);
+        PFR_guac_display_plan_recall_cached_tiles(plan);
+        PFR_guac_display_plan_recall_cached_cursor(plan);
+        GUAC_DISPLAY_PLAN_END_PHASE(display, "search", 4, 7);
 
         /* PASS 4 (and 5): Combine adjacent updates in horizontal and vertical
          * directions where doing so would be more efficient. The goal of these
@@ -351,7 +562,14 @@ void guac_display_end_multiple_frames(guac_display* display, int frames) {
         GUAC_DISPLAY_PLAN_BEGIN_PHASE();
         PFW_guac_display_plan_combine_horizontally(plan);
         PFW_guac_display_plan_combine_vertically(plan);
-        GUAC_DISPLAY_PLAN_END_PHASE(display, "combine", 4, 5);
+        GUAC_DISPLAY_PLAN_END_PHASE(display, "combine", 5, 7);
+
+        /* PASS 6: Sort operations by their distance from the mouse cursor,
+         * such that the regions the user is most likely paying attention to
+         * are encoded and sent with the least latency. */
+        GUAC_DISPLAY_PLAN_BEGIN_PHASE();
+        PFR_guac_display_plan_prioritize(plan);
+        GUAC_DISPLAY_PLAN_END_PHASE(display, "prioritize", 6, 7);
 
     }
 
@@ -366,18 +584,30 @@ void guac_display_end_multiple_frames(guac_display* display, int frames) {
 
     GUAC_DISPLAY_PLAN_BEGIN_PHASE();
     frame_nonempty = PFW_LFW_guac_display_frame_complete(display);
-    GUAC_DISPLAY_PLAN_END_PHASE(display, "commit", 5, 5);
+    GUAC_DISPLAY_PLAN_END_PHASE(display, "commit", 7, 7);
+
+    /* Record the regions of this frame that may be encoded lossily, and
+     * losslessly re-encode any previously-recorded regions that have since
+     * stabilized. Without this, the final frame of any burst of updates would
+     * remain at reduced quality indefinitely. */
+    int refined = LFW_guac_display_refine_lossy_regions(display, plan);
 
     /* Not all frames are graphical. If we end up with a frame containing
-     * nothing but layer property changes, then we must still send a frame
-     * boundary even though there is no display plan to optimize. */
-    if (plan == NULL && frame_nonempty) {
+     * nothing but layer property changes (or only refinements of
+     * already-stable regions), then we must still send a frame boundary even
+     * though there is no display plan to optimize. */
+    if (plan == NULL && (frame_nonempty || refined)) {
         guac_display_plan_operation end_frame_op = {
             .type = GUAC_DISPLAY_PLAN_END_FRAME
         };
         guac_fifo_enqueue(&display->ops, &end_frame_op);
     }
 
+    /* Note whether the frame was actually dispatched for encoding (a frame
+     * boundary will reach connected users, and trace output should be
+     * produced when it does) */
+    frame_dispatched = (plan != NULL || frame_nonempty || refined);
+
     guac_rwlock_release_lock(&display->last_frame.lock);
 
 finished_with_pending_frame_lock:
@@ -388,4 +618,32 @@ finished_with_pending_frame_lock:
         guac_display_plan_free(plan);
     }
 
+    /* Attribute all time spent planning and dispatching the frame (including
+     * sending of any non-image operations) to the planning phase of the
+     * overall rendering statistics. Frames deferred above are instead
+     * accounted for when they are later flushed. */
+    if (plan_start != 0) {
+
+        guac_timestamp plan_end = guac_timestamp_current();
+
+        guac_fifo_lock(&display->ops);
+        display->stats.plan_duration_ms += plan_end - plan_start;
+
+        /* Record the per-stage timestamps of the now in-flight frame, to be
+         * emitted as a trace span by the worker that ultimately flushes the
+         * frame. Frames that turn out to be empty produce no output (and
+         * thus no trace), so any pending request timestamp is simply
+         * discarded. */
+        if (frame_dispatched) {
+            display->frame_trace_id++;
+            display->frame_trace_start = display->frame_trace_requested;
+            display->frame_trace_plan_start = plan_start;
+            display->frame_trace_dispatched = plan_end;
+        }
+
+        display->frame_trace_requested = 0;
+        guac_fifo_unlock(&display->ops);
+
+    }
+
 }
@@ -117,9 +117,26 @@ static void guac_imgcpy(void* dst, size_t dst_stride, int dst_width, int dst_hei
  *
  * @param height
  *     The new height, in pixels.
+ *
+ * @param prepared
+ *     A buffer that was allocated in advance by the caller (before acquiring
+ *     the display lock) for use as the replacement image buffer, or NULL if
+ *     no buffer was prepared. If the prepared buffer does not match the
+ *     dimensions actually required, or turns out not to be needed at all, it
+ *     is simply freed.
+ *
+ * @param prepared_width
+ *     The width of the prepared buffer, in pixels.
+ *
+ * @param prepared_height
+ *     The height of the prepared buffer, in pixels.
+ *
+ * @param prepared_stride
+ *     The number of bytes in each row of image data in the prepared buffer.
  */
 static void XFW_guac_display_layer_buffer_resize(guac_display_layer_state* frame_state,
-        int width, int height) {
+        int width, int height, unsigned char* prepared,
+        int prepared_width, int prepared_height, int prepared_stride) {
 
     /* We should never be trying to resize an externally-maintained buffer */
     GUAC_ASSERT(!frame_state->buffer_is_external);
@@ -130,11 +147,37 @@ static void XFW_guac_display_layer_buffer_resize(guac_display_layer_state* frame
 
     /* Do nothing if size isn't actually changing */
     if (width == frame_state->buffer_width
-            && height == frame_state->buffer_height)
+            && height == frame_state->buffer_height) {
+        guac_mem_free(prepared);
         return;
+    }
+
+    int stride;
+    unsigned char* buffer;
+
+    /* Use the buffer prepared by the caller if it matches the required
+     * dimensions (it may not if another thread has resized the layer since
+     * the buffer was prepared) */
+    if (prepared != NULL && prepared_width == width
+            && prepared_height == height) {
+        buffer = prepared;
+        stride = prepared_stride;
+    }
+
+    /* Otherwise, allocate the replacement buffer here and now */
+    else {
 
-    int stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, width);
-    unsigned char* buffer = guac_mem_zalloc(height, stride);
+        guac_mem_free(prepared);
+
+        stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, width);
+        buffer = guac_mem_zalloc(height, stride);
+
+        /* Request huge page backing for the framebuffer, if enabled (large
+         * framebuffers are long-lived and benefit from reduced TLB pressure) */
+        guac_mem_advise_huge_pages(buffer,
+                guac_mem_ckd_mul_or_die(height, stride));
+
+    }
 
     /* Copy over data from old shared buffer, if that data exists and is
      * relevant */
@@ -187,10 +230,10 @@ static void PFW_LFW_guac_display_layer_state_init(guac_display_layer_state* last
     last_frame->parent = pending_frame->parent = GUAC_DEFAULT_LAYER;
 
     XFW_guac_display_layer_buffer_resize(last_frame,
-            last_frame->width, last_frame->height);
+            last_frame->width, last_frame->height, NULL, 0, 0, 0);
 
     XFW_guac_display_layer_buffer_resize(pending_frame,
-            pending_frame->width, pending_frame->height);
+            pending_frame->width, pending_frame->height, NULL, 0, 0, 0);
 
 }
 
@@ -362,13 +405,16 @@ void guac_display_remove_layer(guac_display_layer* display_layer) {
         guac_mem_free(display_layer->pending_frame.buffer);
 
     guac_mem_free(display_layer->last_frame.buffer);
+    guac_mem_free(display_layer->last_frame_png);
     guac_mem_free(display_layer->pending_frame_cells);
 
     guac_mem_free(display_layer);
 
 }
 
-void PFW_guac_display_layer_resize(guac_display_layer* layer, int width, int height) {
+void PFW_guac_display_layer_resize_prepared(guac_display_layer* layer,
+        int width, int height, unsigned char* prepared,
+        int prepared_width, int prepared_height, int prepared_stride) {
 
     /* Flush and destroy any cached Cairo context */
     guac_display_layer_cairo_context* cairo_context = &(layer->pending_frame_cairo_context);
@@ -386,7 +432,14 @@ void PFW_guac_display_layer_resize(guac_display_layer* layer, int width, int hei
     /* Skip resizing underlying buffer if it's the caller that's responsible
      * for resizing the buffer */
     if (!layer->pending_frame.buffer_is_external)
-        XFW_guac_display_layer_buffer_resize(&layer->pending_frame, width, height);
+        XFW_guac_display_layer_buffer_resize(&layer->pending_frame, width,
+                height, prepared, prepared_width, prepared_height,
+                prepared_stride);
+
+    /* An externally-maintained buffer cannot make use of any prepared
+     * replacement buffer */
+    else
+        guac_mem_free(prepared);
 
     PFW_guac_display_layer_pending_frame_cells_resize(layer, width, height);
 
@@ -394,3 +447,7 @@ void PFW_guac_display_layer_resize(guac_display_layer* layer, int width, int hei
     layer->pending_frame.height = height;
 
 }
+
+void PFW_guac_display_layer_resize(guac_display_layer* layer, int width, int height) {
+    PFW_guac_display_layer_resize_prepared(layer, width, height, NULL, 0, 0, 0);
+}
@@ -20,6 +20,7 @@
 #include "display-priv.h"
 #include "guacamole/assert.h"
 #include "guacamole/display.h"
+#include "guacamole/mem.h"
 #include "guacamole/rect.h"
 #include "guacamole/rwlock.h"
 
@@ -45,6 +46,52 @@ static void PFW_guac_display_layer_touch(guac_display_layer* layer) {
 
 }
 
+/**
+ * Marks all pending frame cells of the given layer that intersect the given
+ * rect as touched. Only touched cells are compared against the last frame
+ * when changes are searched for, ensuring that two small changes at opposite
+ * corners of a layer do not force the full bounding rectangle to be diffed.
+ *
+ * @param layer
+ *     The layer whose cells should be marked as touched.
+ *
+ * @param dirty
+ *     The modified region being reported by the caller.
+ */
+static void PFW_guac_display_layer_mark_touched(guac_display_layer* layer,
+        const guac_rect* dirty) {
+
+    if (guac_rect_is_empty(dirty))
+        return;
+
+    /* Constrain region to the bounds of the cells array (anything outside
+     * those bounds is outside the layer and is not tracked) */
+    int cell_left = dirty->left / GUAC_DISPLAY_CELL_SIZE;
+    int cell_top  = dirty->top  / GUAC_DISPLAY_CELL_SIZE;
+    int cell_right  = (dirty->right  - 1) / GUAC_DISPLAY_CELL_SIZE;
+    int cell_bottom = (dirty->bottom - 1) / GUAC_DISPLAY_CELL_SIZE;
+
+    if (cell_left < 0) cell_left = 0;
+    if (cell_top < 0) cell_top = 0;
+
+    if (cell_right >= (int) layer->pending_frame_cells_width)
+        cell_right = layer->pending_frame_cells_width - 1;
+
+    if (cell_bottom >= (int) layer->pending_frame_cells_height)
+        cell_bottom = layer->pending_frame_cells_height - 1;
+
+    for (int cell_y = cell_top; cell_y <= cell_bottom; cell_y++) {
+
+        guac_display_layer_cell* cell = layer->pending_frame_cells
+            + cell_y * layer->pending_frame_cells_width + cell_left;
+
+        for (int cell_x = cell_left; cell_x <= cell_right; cell_x++)
+            (cell++)->touched = 1;
+
+    }
+
+}
+
 void guac_display_layer_get_bounds(guac_display_layer* layer, guac_rect* bounds) {
 
     guac_display* display = layer->display;
@@ -122,6 +169,15 @@ void guac_display_layer_set_lossless(guac_display_layer* layer, int lossless) {
 
 }
 
+void guac_display_layer_set_content_hint(guac_display_layer* layer, int hint) {
+
+    layer->content_hint = hint;
+
+    /* Any classification obtained by sampling no longer applies */
+    layer->content_classified = 0;
+
+}
+
 void guac_display_layer_set_multitouch(guac_display_layer* layer, int touches) {
 
     guac_display* display = layer->display;
@@ -137,9 +193,51 @@ void guac_display_layer_set_multitouch(guac_display_layer* layer, int touches) {
 void guac_display_layer_resize(guac_display_layer* layer, int width, int height) {
 
     guac_display* display = layer->display;
+
+    /* Round up to the dimensions that the underlying buffer would need to
+     * have, exactly as the buffer resize itself will */
+    int buffer_width  = ((width  + GUAC_DISPLAY_RESIZE_FACTOR - 1) / GUAC_DISPLAY_RESIZE_FACTOR) * GUAC_DISPLAY_RESIZE_FACTOR;
+    int buffer_height = ((height + GUAC_DISPLAY_RESIZE_FACTOR - 1) / GUAC_DISPLAY_RESIZE_FACTOR) * GUAC_DISPLAY_RESIZE_FACTOR;
+
+    /* Determine whether this resize will actually need a replacement buffer,
+     * releasing the lock again before performing any expensive preparation */
+    guac_rwlock_acquire_read_lock(&display->pending_frame.lock);
+    int needs_buffer = !layer->pending_frame.buffer_is_external
+        && (buffer_width != layer->pending_frame.buffer_width
+                || buffer_height != layer->pending_frame.buffer_height);
+    guac_rwlock_release_lock(&display->pending_frame.lock);
+
+    unsigned char* prepared = NULL;
+    int prepared_stride = 0;
+
+    /* Allocate and pre-fault the replacement buffer before acquiring the
+     * display lock, such that other threads can continue rendering and
+     * flushing frames while the bulk of the resize work takes place. Only the
+     * copy of the existing image into the replacement buffer then remains to
+     * be performed under the lock. */
+    if (needs_buffer) {
+
+        prepared_stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32,
+                buffer_width);
+
+        size_t length = guac_mem_ckd_mul_or_die(buffer_height, prepared_stride);
+        prepared = guac_mem_zalloc(buffer_height, prepared_stride);
+
+        /* Request huge page backing for the framebuffer, if enabled (large
+         * framebuffers are long-lived and benefit from reduced TLB pressure) */
+        guac_mem_advise_huge_pages(prepared, length);
+
+        /* Touch every page of the buffer now so that the copy performed
+         * under the lock does not stall on demand faults */
+        if (prepared != NULL)
+            memset(prepared, 0, length);
+
+    }
+
     guac_rwlock_acquire_write_lock(&display->pending_frame.lock);
 
-    PFW_guac_display_layer_resize(layer, width, height);
+    PFW_guac_display_layer_resize_prepared(layer, width, height, prepared,
+            buffer_width, buffer_height, prepared_stride);
     PFW_guac_display_layer_touch(layer);
 
     guac_rwlock_release_lock(&display->pending_frame.lock);
@@ -186,6 +284,37 @@ void guac_display_layer_raw_context_put(guac_display_layer_raw_context* context,
 
 }
 
+void guac_display_layer_raw_context_hint_copy(guac_display_layer_raw_context* context,
+        const guac_rect* src, const guac_rect* dst) {
+
+    /* Ignore hints beyond the maximum that can be stored (the heuristic
+     * scroll/copy search can still discover such copies) */
+    if (context->num_copy_hints >= GUAC_DISPLAY_MAX_COPY_HINTS)
+        return;
+
+    guac_display_copy_hint* hint = &(context->copy_hints[context->num_copy_hints++]);
+    hint->src = *src;
+    hint->dest = *dst;
+    hint->layer = NULL;
+
+}
+
+void guac_display_layer_raw_context_hint_copy_from(
+        guac_display_layer_raw_context* context, guac_display_layer* src_layer,
+        const guac_rect* src, const guac_rect* dst) {
+
+    /* Ignore hints beyond the maximum that can be stored (the heuristic
+     * scroll/copy search can still discover such copies) */
+    if (context->num_copy_hints >= GUAC_DISPLAY_MAX_COPY_HINTS)
+        return;
+
+    guac_display_copy_hint* hint = &(context->copy_hints[context->num_copy_hints++]);
+    hint->src = *src;
+    hint->dest = *dst;
+    hint->layer = src_layer;
+
+}
+
 guac_display_layer_raw_context* guac_display_layer_open_raw(guac_display_layer* layer) {
 
     guac_display* display = layer->display;
@@ -258,12 +387,25 @@ void guac_display_layer_close_raw(guac_display_layer* layer, guac_display_layer_
     }
 
     guac_rect_extend(&layer->pending_frame.dirty, &context->dirty);
+    PFW_guac_display_layer_mark_touched(layer, &context->dirty);
     PFW_guac_display_layer_touch(layer);
 
     /* Apply any hinting regarding scroll/copy optimization */
     if (context->hint_from != NULL)
         context->hint_from->pending_frame.search_for_copies = 1;
 
+    /* Commit any explicit copy hints for consideration by the scroll/copy
+     * optimization when the pending frame is next flushed */
+    for (int i = 0; i < context->num_copy_hints; i++) {
+
+        if (layer->pending_frame.num_copy_hints >= GUAC_DISPLAY_MAX_COPY_HINTS)
+            break;
+
+        layer->pending_frame.copy_hints[layer->pending_frame.num_copy_hints++] =
+            context->copy_hints[i];
+
+    }
+
     guac_rwlock_release_lock(&display->pending_frame.lock);
 
 }
@@ -313,6 +455,7 @@ void guac_display_layer_close_cairo(guac_display_layer* layer, guac_display_laye
     guac_display* display = layer->display;
 
     guac_rect_extend(&layer->pending_frame.dirty, &context->dirty);
+    PFW_guac_display_layer_mark_touched(layer, &context->dirty);
     PFW_guac_display_layer_touch(layer);
 
     /* Apply any hinting regarding scroll/copy optimization */
@@ -24,8 +24,8 @@
 
 /**
  * Returns whether the given rectangle crosses the boundaries of any two
- * adjacent cells in a grid, where each cell in the grid is
- * 2^GUAC_DISPLAY_MAX_COMBINED_SIZE pixels on each side.
+ * adjacent cells in a grid, where each cell in the grid is 2^size pixels on
+ * each side.
  *
  * This function exists because combination of adjacent image updates is
  * intentionally limited to a certain size in order to favor parallelism.
@@ -37,21 +37,26 @@
  * @param rect
  *     The rectangle to test.
  *
+ * @param size
+ *     The size of each cell in the grid, in pixels, as the exponent of a
+ *     power of two.
+ *
  * @return
  *     Non-zero if the rectangle crosses the boundary of any adjacent pair of
- *     cells in a grid, where each cell is 2^GUAC_DISPLAY_MAX_COMBINED_SIZE
- *     pixels on each side, zero otherwise.
+ *     cells in a grid, where each cell is 2^size pixels on each side, zero
+ *     otherwise.
  */
-static int guac_display_plan_rect_crosses_boundary(const guac_rect* rect) {
+static int guac_display_plan_rect_crosses_boundary(const guac_rect* rect,
+        int size) {
 
     /* A particular rectangle crosses a grid boundary if and only if expanding
      * that rectangle to fit the grid would mean increasing the size of that
      * rectangle beyond a single grid cell */
 
     guac_rect rect_copy = *rect;
-    guac_rect_align(&rect_copy, GUAC_DISPLAY_MAX_COMBINED_SIZE);
+    guac_rect_align(&rect_copy, size);
 
-    const int max_size_pixels = 1 << GUAC_DISPLAY_MAX_COMBINED_SIZE;
+    const int max_size_pixels = 1 << size;
     return guac_rect_width(&rect_copy) > max_size_pixels
         || guac_rect_height(&rect_copy) > max_size_pixels;
 
@@ -120,6 +125,21 @@ static int guac_display_plan_should_combine(const guac_display_plan_operation* o
     if (op_a->layer != op_b->layer)
         return 0;
 
+    /* The size limit applied to combined operations adapts per display
+     * according to measured encoding costs (this unlocked read follows the
+     * same convention as lossy_quality - a stale value merely applies the
+     * previous limit to one more frame) */
+    int max_combined_size = op_a->layer->display->max_combined_size;
+
+    /* Regions in sustained motion are re-encoded every frame regardless of
+     * how they are split, so the parallelism favored by the smaller limit
+     * yields little benefit there, while the per-update overhead of
+     * additional rectangles recurs with every frame. Such regions are
+     * permitted to combine one step further. */
+    int max_combined_motion_size = max_combined_size + 1;
+    if (max_combined_motion_size > GUAC_DISPLAY_COMBINED_SIZE_MAX)
+        max_combined_motion_size = GUAC_DISPLAY_COMBINED_SIZE_MAX;
+
     /* Simulate combination */
     guac_rect combined = op_a->dest;
     guac_rect_extend(&combined, &op_b->dest);
@@ -143,7 +163,8 @@ static int guac_display_plan_should_combine(const guac_display_plan_operation* o
 
                     return delta_xa == delta_xb
                         && delta_ya == delta_yb
-                        && !guac_display_plan_rect_crosses_boundary(&combined);
+                        && !guac_display_plan_rect_crosses_boundary(&combined,
+                                max_combined_size);
 
                 }
                 break;
@@ -154,13 +175,24 @@ static int guac_display_plan_should_combine(const guac_display_plan_operation* o
             case GUAC_DISPLAY_PLAN_OPERATION_RECT:
                 return op_a->src.color == op_b->src.color
                     && guac_display_plan_has_common_edge(op_a, op_b)
-                    && !guac_display_plan_rect_crosses_boundary(&combined);
+                    && !guac_display_plan_rect_crosses_boundary(&combined,
+                            max_combined_size);
 
             /* Image-drawing operations can be combined if doing so wouldn't
              * exceed the size limits for images (we enforce size limits here
-             * to promote parallelism) */
+             * to promote parallelism). Regions in sustained motion, as
+             * measured by the same per-cell update history that drives JPEG
+             * selection, are permitted to combine into larger updates: they
+             * are re-encoded every frame regardless, so cutting the number of
+             * rectangles there saves more than the parallelism lost. */
             case GUAC_DISPLAY_PLAN_OPERATION_IMG:
-                return !guac_display_plan_rect_crosses_boundary(&combined);
+                if (op_a->framerate > GUAC_DISPLAY_JPEG_FRAMERATE
+                        && op_b->framerate > GUAC_DISPLAY_JPEG_FRAMERATE)
+                    return !guac_display_plan_rect_crosses_boundary(&combined,
+                            max_combined_motion_size);
+
+                return !guac_display_plan_rect_crosses_boundary(&combined,
+                        max_combined_size);
 
             /* Other combinations require more complex logic... (see below) */
             default:
@@ -236,8 +268,12 @@ static int guac_display_plan_combine_if_improved(guac_display_plan_operation* op
 
         op_a->dirty_size += op_b->dirty_size;
 
-        if (op_b->last_frame > op_a->last_frame)
-            op_a->last_frame = op_b->last_frame;
+        if (op_b->framerate > op_a->framerate)
+            op_a->framerate = op_b->framerate;
+
+        /* The content hash of either original operation no longer describes
+         * the combined region */
+        op_a->hash = 0;
 
         op_b->type = GUAC_DISPLAY_PLAN_OPERATION_NOP;
 
@@ -0,0 +1,229 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "display-plan.h"
+#include "display-priv.h"
+#include "guacamole/display.h"
+#include "guacamole/layer.h"
+#include "guacamole/rect.h"
+
+/**
+ * Determines whether the given layer can hide the content of layers beneath
+ * it. Only visible, non-default layers that were allocated as opaque and are
+ * not currently shaded with partial opacity can do so.
+ *
+ * @param layer
+ *     The layer to test.
+ *
+ * @return
+ *     Non-zero if the given layer completely hides the content of any layer
+ *     region beneath it, zero otherwise.
+ */
+static int PFW_guac_display_layer_is_occluder(guac_display_layer* layer) {
+
+    /* Only visible, non-default layers are composited above other layers
+     * (buffers have negative indices and are never composited at all) */
+    if (layer->layer->index <= 0)
+        return 0;
+
+    /* The image content of the layer must be free of transparency, and the
+     * layer itself must not be shaded */
+    return layer->opaque && layer->pending_frame.opacity == 0xFF;
+
+}
+
+/**
+ * Determines the region of the given layer that is covered by the given
+ * occluding layer, in the coordinate space of the given layer. An occluding
+ * layer covers part of another layer only if it is a direct child of that
+ * layer or if it shares the same parent and is stacked above it.
+ *
+ * @param layer
+ *     The layer being occluded.
+ *
+ * @param occluder
+ *     The layer that may hide part of the given layer.
+ *
+ * @param covered
+ *     A pointer to the guac_rect that should receive the covered region, in
+ *     the coordinate space of the layer being occluded. If the occluding
+ *     layer cannot cover any part of the given layer, this rect will be left
+ *     unmodified.
+ *
+ * @return
+ *     Non-zero if the occluding layer covers the given layer in a way that
+ *     this pass understands (in which case the covered region has been
+ *     assigned), zero otherwise.
+ */
+static int PFW_guac_display_layer_get_covered_rect(guac_display_layer* layer,
+        guac_display_layer* occluder, guac_rect* covered) {
+
+    /* A child layer is always composited above its parent, directly covering
+     * the region it is positioned over */
+    if (occluder->pending_frame.parent == layer->layer) {
+        guac_rect_init(covered,
+                occluder->pending_frame.x,
+                occluder->pending_frame.y,
+                occluder->pending_frame.width,
+                occluder->pending_frame.height);
+        return 1;
+    }
+
+    /* A sibling layer covers this layer only if stacked above it */
+    if (occluder->pending_frame.parent == layer->pending_frame.parent
+            && occluder->pending_frame.z > layer->pending_frame.z) {
+        guac_rect_init(covered,
+                occluder->pending_frame.x - layer->pending_frame.x,
+                occluder->pending_frame.y - layer->pending_frame.y,
+                occluder->pending_frame.width,
+                occluder->pending_frame.height);
+        return 1;
+    }
+
+    /* Any other stacking relationship (including more distant ancestry) is
+     * not considered by this pass */
+    return 0;
+
+}
+
+/**
+ * Subtracts the given covered region from the given dirty rect, deferring the
+ * subtracted region by extending the given deferred rect. As both the dirty
+ * rect and the deferred region must remain simple rects, the subtraction is
+ * performed only if the result is itself a rect: when the covered region
+ * contains the dirty rect entirely, or when it spans the dirty rect
+ * edge-to-edge such that a side of the dirty rect can be trimmed away.
+ *
+ * @param dirty
+ *     The dirty rect to subtract the covered region from.
+ *
+ * @param covered
+ *     The covered region to subtract.
+ *
+ * @param deferred
+ *     The rect to extend with whatever portion of the dirty rect was
+ *     removed.
+ */
+static void guac_display_plan_subtract_rect(guac_rect* dirty,
+        const guac_rect* covered, guac_rect* deferred) {
+
+    if (!guac_rect_intersects(dirty, covered))
+        return;
+
+    /* Defer the entire dirty rect if completely covered */
+    if (covered->left <= dirty->left && covered->right >= dirty->right
+            && covered->top <= dirty->top && covered->bottom >= dirty->bottom) {
+        guac_rect_extend(deferred, dirty);
+        *dirty = (guac_rect) { 0 };
+        return;
+    }
+
+    /* Trim away the top or bottom of the dirty rect if the covered region
+     * spans it horizontally */
+    if (covered->left <= dirty->left && covered->right >= dirty->right) {
+
+        if (covered->top <= dirty->top) {
+            guac_rect removed = *dirty;
+            removed.bottom = covered->bottom;
+            guac_rect_extend(deferred, &removed);
+            dirty->top = covered->bottom;
+        }
+
+        else if (covered->bottom >= dirty->bottom) {
+            guac_rect removed = *dirty;
+            removed.top = covered->top;
+            guac_rect_extend(deferred, &removed);
+            dirty->bottom = covered->top;
+        }
+
+    }
+
+    /* Trim away the left or right of the dirty rect if the covered region
+     * spans it vertically */
+    else if (covered->top <= dirty->top && covered->bottom >= dirty->bottom) {
+
+        if (covered->left <= dirty->left) {
+            guac_rect removed = *dirty;
+            removed.right = covered->right;
+            guac_rect_extend(deferred, &removed);
+            dirty->left = covered->right;
+        }
+
+        else if (covered->right >= dirty->right) {
+            guac_rect removed = *dirty;
+            removed.left = covered->left;
+            guac_rect_extend(deferred, &removed);
+            dirty->right = covered->left;
+        }
+
+    }
+
+}
+
+void PFW_guac_display_plan_cull_occluded(guac_display* display) {
+
+    guac_display_layer* current = display->pending_frame.layers;
+    while (current != NULL) {
+
+        /* Only visible layers can be hidden behind other layers (buffers
+         * have negative indices and are never composited) */
+        if (current->layer->index < 0 || current->pending_frame.buffer == NULL
+                || guac_rect_is_empty(&current->pending_frame.dirty)) {
+            current = current->pending_frame.next;
+            continue;
+        }
+
+        /* If the layer buffer has been resized, the entirety of its contents
+         * will be copied to the last frame regardless of the dirty rect, and
+         * deferring any occluded region would wrongly mark that region as
+         * already sent */
+        if (current->last_frame.buffer_stride != current->pending_frame.buffer_stride
+                || current->last_frame.buffer_width != current->pending_frame.buffer_width
+                || current->last_frame.buffer_height != current->pending_frame.buffer_height) {
+            current = current->pending_frame.next;
+            continue;
+        }
+
+        guac_rect dirty = current->pending_frame.dirty;
+        guac_rect deferred = { 0 };
+
+        /* Subtract the region covered by each opaque layer above this layer,
+         * stopping early if nothing dirty remains */
+        guac_display_layer* occluder = display->pending_frame.layers;
+        while (occluder != NULL && !guac_rect_is_empty(&dirty)) {
+
+            guac_rect covered;
+            if (occluder != current
+                    && PFW_guac_display_layer_is_occluder(occluder)
+                    && PFW_guac_display_layer_get_covered_rect(current, occluder, &covered))
+                guac_display_plan_subtract_rect(&dirty, &covered, &deferred);
+
+            occluder = occluder->pending_frame.next;
+
+        }
+
+        current->pending_frame.dirty = dirty;
+        current->pending_frame.occluded_dirty = deferred;
+
+        current = current->pending_frame.next;
+
+    }
+
+}
+
@@ -0,0 +1,131 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "display-plan.h"
+#include "display-priv.h"
+#include "guacamole/display.h"
+#include "guacamole/rect.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * Returns the squared distance between the given point and the closest point
+ * within the given rectangle. If the point lies within the rectangle, zero is
+ * returned.
+ *
+ * @param rect
+ *     The rectangle to measure the distance to.
+ *
+ * @param x
+ *     The X coordinate of the point.
+ *
+ * @param y
+ *     The Y coordinate of the point.
+ *
+ * @return
+ *     The squared distance between the given point and the closest point
+ *     within the given rectangle, or zero if the point lies within the
+ *     rectangle.
+ */
+static uint64_t guac_display_plan_rect_distance(const guac_rect* rect,
+        int x, int y) {
+
+    int dx = 0;
+    if (x < rect->left)
+        dx = rect->left - x;
+    else if (x >= rect->right)
+        dx = x - rect->right + 1;
+
+    int dy = 0;
+    if (y < rect->top)
+        dy = rect->top - y;
+    else if (y >= rect->bottom)
+        dy = y - rect->bottom + 1;
+
+    return (uint64_t) dx * dx + (uint64_t) dy * dy;
+
+}
+
+/**
+ * Comparator for the qsort() call within
+ * PFR_guac_display_plan_prioritize() which sorts operations by ascending
+ * distance from the mouse cursor.
+ *
+ * @param a
+ *     A pointer to the first guac_display_plan_operation being compared.
+ *
+ * @param b
+ *     A pointer to the second guac_display_plan_operation being compared.
+ *
+ * @return
+ *     A negative value if the first operation is closer to the cursor than
+ *     the second, a positive value if the second operation is closer, or zero
+ *     if both are equally distant.
+ */
+static int guac_display_plan_op_compare(const void* a, const void* b) {
+
+    const guac_display_plan_operation* op_a = (const guac_display_plan_operation*) a;
+    const guac_display_plan_operation* op_b = (const guac_display_plan_operation*) b;
+
+    if (op_a->cursor_distance < op_b->cursor_distance)
+        return -1;
+
+    if (op_a->cursor_distance > op_b->cursor_distance)
+        return 1;
+
+    return 0;
+
+}
+
+void PFR_guac_display_plan_prioritize(guac_display_plan* plan) {
+
+    guac_display* display = plan->display;
+
+    /* Measure distances relative to the most recently reported position of
+     * the mouse cursor (see guac_display_notify_user_moved_mouse()) */
+    int cursor_x = display->pending_frame.cursor_x;
+    int cursor_y = display->pending_frame.cursor_y;
+
+    /* The trailing operation of every plan is the end-of-frame marker, which
+     * must remain the final operation processed and is excluded from the
+     * sort */
+    size_t op_count = plan->length - 1;
+
+    guac_display_plan_operation* op = plan->ops;
+    for (size_t i = 0; i < op_count; i++) {
+
+        /* Translate cursor position into the coordinate space of the layer
+         * being drawn to (for off-screen buffers, this distance is
+         * meaningless but still provides a stable sort order) */
+        guac_display_layer* layer = op->layer;
+        op->cursor_distance = guac_display_plan_rect_distance(&op->dest,
+                cursor_x - layer->pending_frame.x,
+                cursor_y - layer->pending_frame.y);
+
+        op++;
+
+    }
+
+    /* Encode regions near the cursor first, such that the region the user is
+     * most likely paying attention to is updated with the least latency */
+    qsort(plan->ops, op_count, sizeof(guac_display_plan_operation),
+            guac_display_plan_op_compare);
+
+}
@@ -19,9 +19,13 @@
 
 #include "display-plan.h"
 #include "display-priv.h"
+#include "guacamole/client.h"
 #include "guacamole/display.h"
+#include "guacamole/protocol.h"
 #include "guacamole/rect.h"
+#include "guacamole/timestamp.h"
 
+#include <pthread.h>
 #include <string.h>
 #include <stdint.h>
 
@@ -51,6 +55,7 @@ static void guac_display_plan_store_indexed_op(guac_display_plan* plan, uint64_t
     if (entry->op == NULL) {
         entry->hash = hash;
         entry->op = op;
+        plan->indexed_ops++;
     }
 
 }
@@ -83,6 +88,7 @@ static guac_display_plan_operation* guac_display_plan_remove_indexed_op(guac_dis
     guac_display_plan_operation* op = entry->op;
     if (op != NULL && entry->hash == hash) {
         entry->op = NULL;
+        plan->indexed_ops--;
         return op;
     }
 
@@ -109,10 +115,14 @@ static guac_display_plan_operation* guac_display_plan_remove_indexed_op(guac_dis
  *     The hash value that applies to the current 64x64 rectangle.
  *
  * @param closure
- *     The closure value that was originally provided to the call to 
+ *     The closure value that was originally provided to the call to
  *     guac_hash_foreach_image_rect().
+ *
+ * @return
+ *     Non-zero if iteration should stop (no further rectangles need be
+ *     evaluated), zero if iteration should continue.
  */
-typedef void guac_hash_callback(guac_display_plan* plan, int x, int y, uint64_t hash, void* closure);
+typedef int guac_hash_callback(guac_display_plan* plan, int x, int y, uint64_t hash, void* closure);
 
 /**
  * Iterates through each 64x64 subrectangle within the given rectangular region
@@ -138,6 +148,10 @@ typedef void guac_hash_callback(guac_display_plan* plan, int x, int y, uint64_t
  * @param closure
  *     The arbitrary value to pass the given callback each time it is invoked
  *     through this function call.
+ *
+ * @return
+ *     Non-zero if iteration was stopped early at the request of the callback,
+ *     zero if all subrectangles of the given region were evaluated.
  */
 static int guac_hash_foreach_image_rect(guac_display_plan* plan,
         const guac_display_layer_state* layer_state, const guac_rect* rect,
@@ -146,8 +160,9 @@ static int guac_hash_foreach_image_rect(guac_display_plan* plan,
     size_t stride = layer_state->buffer_stride;
     const unsigned char* data = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(*layer_state, *rect);
 
-    int x, y;
+    int x, y, i;
     uint64_t cell_hash[GUAC_DISPLAY_MAX_WIDTH] = { 0 };
+    uint64_t row_hashes[GUAC_DISPLAY_MAX_WIDTH];
 
     /* NOTE: Because the hash value of the sliding 64x64 window is available
      * only upon reaching the bottom-right corner of that window, we offset the
@@ -165,33 +180,39 @@ static int guac_hash_foreach_image_rect(guac_display_plan* plan,
     int start_y = rect->top    - GUAC_DISPLAY_CELL_SIZE + 1;
     int end_y   = rect->bottom - GUAC_DISPLAY_CELL_SIZE + 1;
 
-    for (y = start_y; y < end_y; y++) {
+    int row_length = end_x - start_x;
 
-        uint64_t* current_cell_hash = cell_hash;
+    for (y = start_y; y < end_y; y++) {
 
         /* Get current row */
         uint32_t* row = (uint32_t*) data;
         data += stride;
 
-        /* Calculate row segment hashes for entire row */
+        /* Calculate row segment hashes for entire row. This recurrence is
+         * inherently serial (each hash builds on the previous), but consists
+         * of only a multiply and add per pixel. */
         uint64_t row_hash = 0;
-        for (x = start_x; x < end_x; x++) {
-
-            /* Get current pixel */
-            uint32_t pixel = *(row++);
-
-            /* Update hash value for current row segment */
-            row_hash = ((row_hash * 31) << 1) + pixel;
-
-            /* Incorporate row hash value into overall cell hash */
-            uint64_t cell_hash = ((*current_cell_hash * 31) << 1) + row_hash;
-            *(current_cell_hash++) = cell_hash;
-
-            /* Invoke callback for every hash generated, breaking out early if
-             * requested */
-            if (y >= rect->top && x >= rect->left)
-                callback(plan, x, y, cell_hash, closure);
+        for (i = 0; i < row_length; i++) {
+            row_hash = ((row_hash * 31) << 1) + row[i];
+            row_hashes[i] = row_hash;
+        }
 
+        /* Incorporate the row segment hashes into the overall cell hashes.
+         * Unlike the row hash recurrence, each element here depends only on
+         * its own previous value, so this whole-row pass is free of loop
+         * carried dependencies and branches and can be vectorized by the
+         * compiler. */
+        for (i = 0; i < row_length; i++)
+            cell_hash[i] = ((cell_hash[i] * 31) << 1) + row_hashes[i];
+
+        /* Invoke callback for every valid hash (every hash whose sliding
+         * window lies entirely within the region), breaking out early if
+         * requested */
+        if (y >= rect->top) {
+            for (x = rect->left; x < end_x; x++) {
+                if (callback(plan, x, y, cell_hash[x - start_x], closure))
+                    return 1;
+            }
         }
 
     } /* end for each row */
@@ -241,14 +262,27 @@ static void guac_display_cell_init_rect(guac_rect* rect, int x, int y) {
  * @param closure
  *     A pointer to the guac_display_plan_operation that should be stored
  *     within the ops_by_hash table of the given display plan.
+ *
+ * @return
+ *     Always zero (iteration should continue until all cells are indexed).
  */
-static void guac_display_plan_index_op_for_cell(guac_display_plan* plan, int x, int y, uint64_t hash, void* closure) {
-    guac_display_plan_store_indexed_op(plan, hash, (guac_display_plan_operation*) closure);
+static int guac_display_plan_index_op_for_cell(guac_display_plan* plan, int x, int y, uint64_t hash, void* closure) {
+
+    guac_display_plan_operation* op = (guac_display_plan_operation*) closure;
+
+    /* Note the content hash on the operation itself, such that the tile it
+     * draws can later be stored in (or recalled from) the tile cache */
+    op->hash = hash;
+
+    guac_display_plan_store_indexed_op(plan, hash, op);
+    return 0;
+
 }
 
 void PFR_guac_display_plan_index_dirty_cells(guac_display_plan* plan) {
 
     memset(plan->ops_by_hash, 0, sizeof(plan->ops_by_hash));
+    plan->indexed_ops = 0;
 
     guac_display_plan_operation* op = plan->ops;
     for (int i = 0; i < plan->length; i++) {
@@ -342,6 +376,265 @@ static int guac_image_cmp(const unsigned char* restrict data_a, int width_a, int
 
 }
 
+void PFR_LFR_guac_display_plan_apply_copy_hints(guac_display_plan* plan) {
+
+    guac_display_plan_operation* op = plan->ops;
+    for (int i = 0; i < plan->length; i++) {
+
+        if (op->type == GUAC_DISPLAY_PLAN_OPERATION_IMG) {
+
+            guac_display_layer* layer = op->layer;
+            const guac_display_copy_hint* hint = layer->pending_frame.copy_hints;
+
+            for (int j = 0; j < layer->pending_frame.num_copy_hints; j++, hint++) {
+
+                /* Consider only hints that fully cover the modified region */
+                if (op->dest.left < hint->dest.left || op->dest.top < hint->dest.top
+                        || op->dest.right > hint->dest.right
+                        || op->dest.bottom > hint->dest.bottom)
+                    continue;
+
+                /* The copy may be sourced from the previously-sent frame of a
+                 * different layer (as when blitting from an offscreen cache),
+                 * defaulting to the layer receiving the draw */
+                guac_display_layer* src_layer = hint->layer;
+                if (src_layer == NULL)
+                    src_layer = layer;
+
+                /* Translate the modified region to the corresponding source
+                 * region of the hinted copy */
+                int dx = hint->src.left - hint->dest.left;
+                int dy = hint->src.top - hint->dest.top;
+
+                guac_rect src_rect = op->dest;
+                src_rect.left   += dx;
+                src_rect.right  += dx;
+                src_rect.top    += dy;
+                src_rect.bottom += dy;
+
+                /* The source region is usable only if it lies entirely within
+                 * the previously-sent frame */
+                if (src_rect.left < 0 || src_rect.top < 0
+                        || src_rect.right > src_layer->last_frame.width
+                        || src_rect.bottom > src_layer->last_frame.height)
+                    continue;
+
+                const unsigned char* copy_from = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(src_layer->last_frame, src_rect);
+                const unsigned char* copy_to = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(layer->pending_frame, op->dest);
+
+                /* Only transform into a copy if the previous frame truly
+                 * contains the data being drawn (the hinted region may have
+                 * since been overdrawn) */
+                if (!guac_image_cmp(copy_from, guac_rect_width(&src_rect), guac_rect_height(&src_rect),
+                            src_layer->last_frame.buffer_stride, copy_to, guac_rect_width(&op->dest),
+                            guac_rect_height(&op->dest), layer->pending_frame.buffer_stride)) {
+                    op->type = GUAC_DISPLAY_PLAN_OPERATION_COPY;
+                    op->src.layer_rect.layer = src_layer->last_frame_buffer;
+                    op->src.layer_rect.rect = src_rect;
+                    break;
+                }
+
+            }
+
+        }
+
+        op++;
+
+    }
+
+}
+
+/**
+ * An entry within the table used to index the rows of the previous frame by
+ * their content hashes during vertical shift (scroll) detection.
+ */
+typedef struct guac_display_plan_row_index_entry {
+
+    /**
+     * The content hash of the indexed row.
+     */
+    uint64_t hash;
+
+    /**
+     * The Y coordinate of the indexed row, plus one (such that zero-initialized
+     * entries are recognizable as empty), or -1 if multiple rows share the
+     * same content hash. Rows with duplicated content (such as the blank rows
+     * of a terminal) cannot meaningfully vote for any particular shift and
+     * are excluded from consideration.
+     */
+    int row;
+
+} guac_display_plan_row_index_entry;
+
+/**
+ * Determines the vertical shift (scroll distance) that transforms the largest
+ * number of rows of the previous frame of the given layer into rows of the
+ * pending frame. Only the column strip covered by the dirty region of the
+ * pending frame is considered, as a scroll will have modified all rows it
+ * affects. Each row of the strip within the previous frame is indexed by a
+ * hash of its pixels, and each row of the same strip within the pending frame
+ * then votes for the shift that would map its previous position to its new
+ * position. The shift receiving the most votes wins.
+ *
+ * As with all hash-based matching within the display plan, a detected shift
+ * is only a candidate: any operation rewritten as a copy based on the shift
+ * is first verified against the actual underlying image data.
+ *
+ * @param layer
+ *     The layer to examine.
+ *
+ * @return
+ *     The number of pixels by which content within the dirty region of the
+ *     given layer appears to have shifted vertically (positive when content
+ *     has moved toward the top of the layer, as when scrolling down through a
+ *     document), or zero if no vertical shift could be detected.
+ */
+static int PFR_LFR_guac_display_plan_find_vertical_shift(guac_display_layer* layer) {
+
+    int y, i;
+
+    /* Consider only the column strip that lies within the dirty region of the
+     * pending frame and within the bounds of both frames */
+    guac_rect strip = layer->pending_frame.dirty;
+
+    guac_rect last_bounds;
+    guac_rect_init(&last_bounds, 0, 0, layer->last_frame.width, layer->last_frame.height);
+    guac_rect_constrain(&strip, &last_bounds);
+
+    guac_rect pending_bounds;
+    guac_rect_init(&pending_bounds, 0, 0, layer->pending_frame.width, layer->pending_frame.height);
+    guac_rect_constrain(&strip, &pending_bounds);
+
+    int width = guac_rect_width(&strip);
+    int height = guac_rect_height(&strip);
+
+    /* Regions with too few changed rows cannot receive enough votes for a
+     * shift to ever be accepted */
+    if (width <= 0 || height < GUAC_DISPLAY_SCROLL_MIN_MATCHED_ROWS)
+        return 0;
+
+    /* Index each row of the strip within the previous frame by its content
+     * hash, marking hashes shared by multiple rows as unusable */
+    guac_display_plan_row_index_entry row_index[GUAC_DISPLAY_SCROLL_ROW_INDEX_SIZE] = { 0 };
+
+    const unsigned char* data = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(layer->last_frame, strip);
+    for (y = strip.top; y < strip.bottom; y++) {
+
+        const uint32_t* row = (const uint32_t*) data;
+        data += layer->last_frame.buffer_stride;
+
+        uint64_t hash = 0;
+        for (i = 0; i < width; i++)
+            hash = ((hash * 31) << 1) + row[i];
+
+        guac_display_plan_row_index_entry* entry =
+            &row_index[hash & (GUAC_DISPLAY_SCROLL_ROW_INDEX_SIZE - 1)];
+
+        if (entry->row == 0) {
+            entry->hash = hash;
+            entry->row = y + 1;
+        }
+        else if (entry->hash == hash)
+            entry->row = -1;
+
+    }
+
+    /* Hash the same strip within the pending frame, with each row whose
+     * content is present in the previous frame voting for the shift that
+     * would map its previous position to its new position */
+    int votes[GUAC_DISPLAY_MAX_HEIGHT * 2 + 1] = { 0 };
+
+    data = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(layer->pending_frame, strip);
+    for (y = strip.top; y < strip.bottom; y++) {
+
+        const uint32_t* row = (const uint32_t*) data;
+        data += layer->pending_frame.buffer_stride;
+
+        uint64_t hash = 0;
+        for (i = 0; i < width; i++)
+            hash = ((hash * 31) << 1) + row[i];
+
+        guac_display_plan_row_index_entry* entry =
+            &row_index[hash & (GUAC_DISPLAY_SCROLL_ROW_INDEX_SIZE - 1)];
+
+        if (entry->row > 0 && entry->hash == hash)
+            votes[(entry->row - 1) - y + GUAC_DISPLAY_MAX_HEIGHT]++;
+
+    }
+
+    /* Accept the most widely agreed-upon shift, if any (a shift of zero is
+     * meaningless here, as all considered rows lie within the dirty region
+     * and have therefore changed) */
+    int best_shift = 0;
+    int best_votes = GUAC_DISPLAY_SCROLL_MIN_MATCHED_ROWS - 1;
+    for (i = 0; i <= GUAC_DISPLAY_MAX_HEIGHT * 2; i++) {
+        int shift = i - GUAC_DISPLAY_MAX_HEIGHT;
+        if (shift != 0 && votes[i] > best_votes) {
+            best_votes = votes[i];
+            best_shift = shift;
+        }
+    }
+
+    return best_shift;
+
+}
+
+void PFR_LFR_guac_display_plan_detect_scrolls(guac_display_plan* plan) {
+
+    guac_display* display = plan->display;
+
+    guac_display_layer* current = display->last_frame.layers;
+    for (; current != NULL; current = current->last_frame.next) {
+
+        /* Consider only the layers that are specifically noted as possible
+         * sources for copies */
+        if (!current->pending_frame.search_for_copies)
+            continue;
+
+        int shift = PFR_LFR_guac_display_plan_find_vertical_shift(current);
+        if (shift == 0)
+            continue;
+
+        /* Rewrite draws of shifted content as copies from the previous frame
+         * wherever the previous frame truly contains the data being drawn */
+        guac_display_plan_operation* op = plan->ops;
+        for (int i = 0; i < plan->length; i++, op++) {
+
+            if (op->type != GUAC_DISPLAY_PLAN_OPERATION_IMG
+                    || op->layer != current)
+                continue;
+
+            /* Translate the modified region by the detected shift */
+            guac_rect src_rect = op->dest;
+            src_rect.top    += shift;
+            src_rect.bottom += shift;
+
+            /* The source region is usable only if it lies entirely within
+             * the previously-sent frame */
+            if (src_rect.top < 0 || src_rect.bottom > current->last_frame.height
+                    || src_rect.right > current->last_frame.width)
+                continue;
+
+            const unsigned char* copy_from = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(current->last_frame, src_rect);
+            const unsigned char* copy_to = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(current->pending_frame, op->dest);
+
+            /* Only transform into a copy if the previous frame truly contains
+             * the data being drawn (the detected shift may not apply to all
+             * parts of the dirty region) */
+            if (!guac_image_cmp(copy_from, guac_rect_width(&src_rect), guac_rect_height(&src_rect),
+                        current->last_frame.buffer_stride, copy_to, guac_rect_width(&op->dest),
+                        guac_rect_height(&op->dest), current->pending_frame.buffer_stride)) {
+                op->type = GUAC_DISPLAY_PLAN_OPERATION_COPY;
+                op->src.layer_rect.layer = current->last_frame_buffer;
+                op->src.layer_rect.rect = src_rect;
+            }
+
+        }
+
+    }
+
+}
+
 /**
  * Callback for guac_hash_foreach_image_rect() which searches the ops_by_hash
  * table of the given display plan for occurrences of the given hash, replacing
@@ -370,8 +663,12 @@ static int guac_image_cmp(const unsigned char* restrict data_a, int width_a, int
  *
  * @param closure
  *     A pointer to the guac_display_layer that is being searched.
+ *
+ * @return
+ *     Non-zero if all indexed operations have now been matched and the search
+ *     may stop, zero if operations remain to be matched.
  */
-static void PFR_LFR_guac_display_plan_find_copies(guac_display_plan* plan,
+static int PFR_LFR_guac_display_plan_find_copies(guac_display_plan* plan,
         int x, int y, uint64_t hash, void* closure) {
 
     guac_display_layer* copy_from_layer = (guac_display_layer*) closure;
@@ -404,11 +701,21 @@ static void PFR_LFR_guac_display_plan_find_copies(guac_display_plan* plan,
 
     }
 
+    /* Stop searching as soon as every indexed operation has been matched.
+     * For pure scrolls, this means the sliding window typically stops after
+     * covering only the scroll distance rather than the full dirty region. */
+    return plan->indexed_ops == 0;
+
 }
 
 void PFR_LFR_guac_display_plan_rewrite_as_copies(guac_display_plan* plan) {
 
     guac_display* display = plan->display;
+
+    /* There is nothing to search for if no operations were indexed */
+    if (plan->indexed_ops == 0)
+        return;
+
     guac_display_layer* current = display->last_frame.layers;
     while (current != NULL) {
 
@@ -425,8 +732,11 @@ void PFR_LFR_guac_display_plan_rewrite_as_copies(guac_display_plan* plan) {
              * modified) */
             guac_rect_constrain(&search_region, &current->pending_frame.dirty);
 
-            guac_hash_foreach_image_rect(plan, &current->last_frame, &search_region,
-                    PFR_LFR_guac_display_plan_find_copies, current);
+            /* Skip any remaining layers if the search has already matched
+             * every indexed operation */
+            if (guac_hash_foreach_image_rect(plan, &current->last_frame, &search_region,
+                    PFR_LFR_guac_display_plan_find_copies, current))
+                break;
         }
 
         current = current->last_frame.next;
@@ -434,3 +744,476 @@ void PFR_LFR_guac_display_plan_rewrite_as_copies(guac_display_plan* plan) {
     }
 
 }
+
+/**
+ * Initializes the given rectangle with the bounds of the given slot within
+ * the client-side tile cache buffer.
+ *
+ * @param rect
+ *     The rectangle to initialize.
+ *
+ * @param slot
+ *     The index of the tile cache slot.
+ */
+static void guac_display_tile_cache_slot_rect(guac_rect* rect, int slot) {
+
+    int x = (slot % GUAC_DISPLAY_TILE_CACHE_COLUMNS) * GUAC_DISPLAY_CELL_SIZE;
+    int y = (slot / GUAC_DISPLAY_TILE_CACHE_COLUMNS) * GUAC_DISPLAY_CELL_SIZE;
+
+    guac_rect_init(rect, x, y, GUAC_DISPLAY_CELL_SIZE, GUAC_DISPLAY_CELL_SIZE);
+
+}
+
+/**
+ * Returns a pointer to the upper-left pixel of the given slot within the
+ * server-side mirror of the client-side tile cache buffer.
+ *
+ * @param display
+ *     The display whose tile cache mirror should be dereferenced.
+ *
+ * @param slot
+ *     The index of the tile cache slot.
+ *
+ * @return
+ *     A pointer to the upper-left pixel of the given slot.
+ */
+static unsigned char* guac_display_tile_cache_slot_data(guac_display* display,
+        int slot) {
+
+    guac_rect slot_rect;
+    guac_display_tile_cache_slot_rect(&slot_rect, slot);
+
+    return display->tile_cache_data
+        + slot_rect.top * GUAC_DISPLAY_TILE_CACHE_STRIDE
+        + slot_rect.left * 4;
+
+}
+
+void PFR_guac_display_plan_recall_cached_tiles(guac_display_plan* plan) {
+
+    guac_display* display = plan->display;
+    guac_timestamp now = guac_timestamp_current();
+
+    guac_display_plan_operation* op = plan->ops;
+    for (int i = 0; i < plan->length; i++, op++) {
+
+        /* Only draws of hashed (cell-aligned and fully in-bounds) content
+         * within opaque layers can be recalled from the tile cache */
+        if (op->type != GUAC_DISPLAY_PLAN_OPERATION_IMG || op->hash == 0
+                || !op->layer->opaque)
+            continue;
+
+        guac_display_layer* layer = op->layer;
+
+        guac_rect cell;
+        guac_display_cell_init_rect(&cell, op->dest.left, op->dest.top);
+
+        pthread_mutex_lock(&display->tile_cache_lock);
+
+        for (int slot = 0; slot < GUAC_DISPLAY_TILE_CACHE_SIZE; slot++) {
+
+            guac_display_tile_cache_entry* entry = &(display->tile_cache[slot]);
+            if (entry->last_use == 0 || entry->hash != op->hash)
+                continue;
+
+            const unsigned char* cached = guac_display_tile_cache_slot_data(display, slot);
+            const unsigned char* pending = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(layer->pending_frame, cell);
+
+            /* Only transform into a copy if the cached tile is truly
+             * identical to the content being drawn (not a collision) */
+            if (!guac_image_cmp(cached, GUAC_DISPLAY_CELL_SIZE, GUAC_DISPLAY_CELL_SIZE,
+                        GUAC_DISPLAY_TILE_CACHE_STRIDE, pending, GUAC_DISPLAY_CELL_SIZE,
+                        GUAC_DISPLAY_CELL_SIZE, layer->pending_frame.buffer_stride)) {
+
+                op->type = GUAC_DISPLAY_PLAN_OPERATION_COPY;
+                op->src.layer_rect.layer = display->tile_cache_buffer;
+                guac_display_tile_cache_slot_rect(&op->src.layer_rect.rect, slot);
+                op->dest = cell;
+
+                entry->last_use = now;
+
+            }
+
+            /* At most one slot can be associated with any given hash */
+            break;
+
+        }
+
+        pthread_mutex_unlock(&display->tile_cache_lock);
+
+    }
+
+}
+
+void LFR_guac_display_plan_cache_tile(guac_display* display,
+        const guac_display_plan_operation* op) {
+
+    guac_client* client = display->client;
+    guac_display_layer* layer = op->layer;
+
+    /* Only draws of hashed (cell-aligned and fully in-bounds) content within
+     * opaque layers are eligible for caching */
+    if (op->hash == 0 || !layer->opaque)
+        return;
+
+    guac_rect cell;
+    guac_display_cell_init_rect(&cell, op->dest.left, op->dest.top);
+
+    /* The hashed cell is usable only if it still lies entirely within the
+     * layer */
+    if (cell.right > layer->last_frame.width
+            || cell.bottom > layer->last_frame.height)
+        return;
+
+    guac_timestamp now = guac_timestamp_current();
+
+    pthread_mutex_lock(&display->tile_cache_lock);
+
+    /* Locate a free slot and the least-recently-used occupied slot, bailing
+     * out early if the tile is already cached */
+    int free_slot = -1;
+    int oldest_slot = -1;
+    for (int slot = 0; slot < GUAC_DISPLAY_TILE_CACHE_SIZE; slot++) {
+
+        guac_display_tile_cache_entry* entry = &(display->tile_cache[slot]);
+
+        if (entry->last_use == 0) {
+            if (free_slot == -1)
+                free_slot = slot;
+            continue;
+        }
+
+        /* Tile is already cached - simply refresh its position within the
+         * eviction order */
+        if (entry->hash == op->hash) {
+            entry->last_use = now;
+            pthread_mutex_unlock(&display->tile_cache_lock);
+            return;
+        }
+
+        if (oldest_slot == -1
+                || entry->last_use < display->tile_cache[oldest_slot].last_use)
+            oldest_slot = slot;
+
+    }
+
+    int slot = free_slot;
+    if (slot == -1) {
+
+        /* Evict the least-recently-used slot only if it has been idle long
+         * enough that no recently-planned frame can still reference it */
+        if (now - display->tile_cache[oldest_slot].last_use
+                < GUAC_DISPLAY_TILE_CACHE_MIN_IDLE_AGE) {
+            pthread_mutex_unlock(&display->tile_cache_lock);
+            return;
+        }
+
+        slot = oldest_slot;
+
+    }
+
+    /* Copy the tile contents into the server-side mirror */
+    const unsigned char* src = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(layer->last_frame, cell);
+    unsigned char* dst = guac_display_tile_cache_slot_data(display, slot);
+    for (int y = 0; y < GUAC_DISPLAY_CELL_SIZE; y++) {
+        memcpy(dst, src, GUAC_DISPLAY_CELL_SIZE * 4);
+        src += layer->last_frame.buffer_stride;
+        dst += GUAC_DISPLAY_TILE_CACHE_STRIDE;
+    }
+
+    guac_display_tile_cache_entry* entry = &(display->tile_cache[slot]);
+    entry->hash = op->hash;
+    entry->last_use = now;
+
+    /* Persist the freshly-drawn tile within the client-side tile cache
+     * buffer (this instruction follows the image data of the draw itself,
+     * and therefore copies exactly the content that was hashed) */
+    guac_rect slot_rect;
+    guac_display_tile_cache_slot_rect(&slot_rect, slot);
+    guac_protocol_send_copy(client->socket, layer->layer,
+            cell.left, cell.top, GUAC_DISPLAY_CELL_SIZE, GUAC_DISPLAY_CELL_SIZE,
+            GUAC_COMP_OVER, display->tile_cache_buffer,
+            slot_rect.left, slot_rect.top);
+
+    pthread_mutex_unlock(&display->tile_cache_lock);
+
+}
+
+/**
+ * Returns a hash of the given image data, covering the given width and height
+ * in full. Unlike the sliding-window hashing used to index 64x64 cells, this
+ * hash covers an entire image of arbitrary (small) dimensions and is intended
+ * for whole-image comparisons like those of the cursor cache.
+ *
+ * @param data
+ *     A pointer to the upper-left pixel of the image to hash.
+ *
+ * @param width
+ *     The width of the image, in pixels.
+ *
+ * @param height
+ *     The height of the image, in pixels.
+ *
+ * @param stride
+ *     The number of bytes in each row of image data.
+ *
+ * @return
+ *     A hash covering all pixels of the given image.
+ */
+static uint64_t guac_display_cursor_hash(const unsigned char* data,
+        int width, int height, size_t stride) {
+
+    uint64_t hash = 0;
+    for (int y = 0; y < height; y++) {
+
+        const uint32_t* row = (const uint32_t*) data;
+        for (int x = 0; x < width; x++)
+            hash = ((hash * 31) << 1) + row[x];
+
+        data += stride;
+
+    }
+
+    return hash;
+
+}
+
+/**
+ * Initializes the given rectangle with the bounds of the given slot within
+ * the client-side cursor cache buffer.
+ *
+ * @param rect
+ *     The rectangle to initialize.
+ *
+ * @param slot
+ *     The index of the cursor cache slot.
+ */
+static void guac_display_cursor_cache_slot_rect(guac_rect* rect, int slot) {
+    guac_rect_init(rect, slot * GUAC_DISPLAY_CURSOR_CACHE_SLOT_SIZE, 0,
+            GUAC_DISPLAY_CURSOR_CACHE_SLOT_SIZE,
+            GUAC_DISPLAY_CURSOR_CACHE_SLOT_SIZE);
+}
+
+/**
+ * Returns a pointer to the upper-left pixel of the given slot within the
+ * server-side mirror of the client-side cursor cache buffer.
+ *
+ * @param display
+ *     The display whose cursor cache mirror should be dereferenced.
+ *
+ * @param slot
+ *     The index of the cursor cache slot.
+ *
+ * @return
+ *     A pointer to the upper-left pixel of the given slot.
+ */
+static unsigned char* guac_display_cursor_cache_slot_data(guac_display* display,
+        int slot) {
+    return display->cursor_cache_data
+        + slot * GUAC_DISPLAY_CURSOR_CACHE_SLOT_SIZE * 4;
+}
+
+void PFR_guac_display_plan_recall_cached_cursor(guac_display_plan* plan) {
+
+    guac_display* display = plan->display;
+    guac_display_layer* cursor = display->cursor_buffer;
+
+    int width = cursor->pending_frame.width;
+    int height = cursor->pending_frame.height;
+
+    /* Cursor images larger than a cache slot bypass the cache */
+    if (width <= 0 || height <= 0
+            || width > GUAC_DISPLAY_CURSOR_CACHE_SLOT_SIZE
+            || height > GUAC_DISPLAY_CURSOR_CACHE_SLOT_SIZE)
+        return;
+
+    /* Proceed only if this frame updates the cursor image at all */
+    int cursor_op_count = 0;
+    guac_display_plan_operation* op = plan->ops;
+    for (int i = 0; i < plan->length; i++, op++) {
+        if (op->layer == cursor && op->type != GUAC_DISPLAY_PLAN_OPERATION_NOP)
+            cursor_op_count++;
+    }
+
+    if (cursor_op_count == 0)
+        return;
+
+    guac_rect cursor_rect;
+    guac_rect_init(&cursor_rect, 0, 0, width, height);
+
+    const unsigned char* pending = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(cursor->pending_frame, cursor_rect);
+    uint64_t hash = guac_display_cursor_hash(pending, width, height,
+            cursor->pending_frame.buffer_stride);
+
+    pthread_mutex_lock(&display->cursor_cache_lock);
+
+    for (int slot = 0; slot < GUAC_DISPLAY_CURSOR_CACHE_SIZE; slot++) {
+
+        guac_display_cursor_cache_entry* entry = &(display->cursor_cache[slot]);
+        if (entry->last_use == 0 || entry->hash != hash
+                || entry->width != width || entry->height != height)
+            continue;
+
+        const unsigned char* cached = guac_display_cursor_cache_slot_data(display, slot);
+
+        /* Only transform into a copy if the cached image is truly identical
+         * to the pending cursor (not a collision) */
+        if (!guac_image_cmp(cached, width, height, GUAC_DISPLAY_CURSOR_CACHE_STRIDE,
+                    pending, width, height, cursor->pending_frame.buffer_stride)) {
+
+            /* Replace all operations targeting the cursor with a single copy
+             * of the full cursor image from the cache slot (the cached image
+             * covers the entire cursor, and operations never overlap) */
+            guac_rect slot_rect;
+            guac_display_cursor_cache_slot_rect(&slot_rect, slot);
+
+            op = plan->ops;
+            for (int i = 0; i < plan->length; i++, op++) {
+
+                if (op->layer != cursor || op->type == GUAC_DISPLAY_PLAN_OPERATION_NOP)
+                    continue;
+
+                if (--cursor_op_count == 0) {
+                    op->type = GUAC_DISPLAY_PLAN_OPERATION_COPY;
+                    op->src.layer_rect.layer = display->cursor_cache_buffer;
+                    guac_rect_init(&op->src.layer_rect.rect,
+                            slot_rect.left, slot_rect.top, width, height);
+                    op->dest = cursor_rect;
+                }
+                else
+                    op->type = GUAC_DISPLAY_PLAN_OPERATION_NOP;
+
+            }
+
+            entry->last_use = guac_timestamp_current();
+
+        }
+
+        /* At most one slot can be associated with any given image */
+        break;
+
+    }
+
+    pthread_mutex_unlock(&display->cursor_cache_lock);
+
+}
+
+void LFR_guac_display_cursor_cache_store(guac_display* display) {
+
+    guac_client* client = display->client;
+    guac_display_layer* cursor = display->cursor_buffer;
+
+    int width = cursor->last_frame.width;
+    int height = cursor->last_frame.height;
+
+    /* Cursor images larger than a cache slot bypass the cache */
+    if (width <= 0 || height <= 0
+            || width > GUAC_DISPLAY_CURSOR_CACHE_SLOT_SIZE
+            || height > GUAC_DISPLAY_CURSOR_CACHE_SLOT_SIZE)
+        return;
+
+    guac_rect cursor_rect;
+    guac_rect_init(&cursor_rect, 0, 0, width, height);
+
+    const unsigned char* data = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(cursor->last_frame, cursor_rect);
+    uint64_t hash = guac_display_cursor_hash(data, width, height,
+            cursor->last_frame.buffer_stride);
+
+    guac_timestamp now = guac_timestamp_current();
+
+    pthread_mutex_lock(&display->cursor_cache_lock);
+
+    /* Locate a free slot and the least-recently-used occupied slot, bailing
+     * out early if the cursor image is already cached */
+    int free_slot = -1;
+    int oldest_slot = -1;
+    for (int slot = 0; slot < GUAC_DISPLAY_CURSOR_CACHE_SIZE; slot++) {
+
+        guac_display_cursor_cache_entry* entry = &(display->cursor_cache[slot]);
+
+        if (entry->last_use == 0) {
+            if (free_slot == -1)
+                free_slot = slot;
+            continue;
+        }
+
+        /* Cursor image is already cached - simply refresh its position
+         * within the eviction order (this is the common case whenever a
+         * cursor change was recalled from the cache) */
+        if (entry->hash == hash && entry->width == width
+                && entry->height == height
+                && !guac_image_cmp(guac_display_cursor_cache_slot_data(display, slot),
+                        width, height, GUAC_DISPLAY_CURSOR_CACHE_STRIDE,
+                        data, width, height, cursor->last_frame.buffer_stride)) {
+            entry->last_use = now;
+            pthread_mutex_unlock(&display->cursor_cache_lock);
+            return;
+        }
+
+        if (oldest_slot == -1
+                || entry->last_use < display->cursor_cache[oldest_slot].last_use)
+            oldest_slot = slot;
+
+    }
+
+    int slot = free_slot;
+    if (slot == -1) {
+
+        /* Evict the least-recently-used slot only if it has been idle long
+         * enough that no recently-planned frame can still reference it */
+        if (now - display->cursor_cache[oldest_slot].last_use
+                < GUAC_DISPLAY_TILE_CACHE_MIN_IDLE_AGE) {
+            pthread_mutex_unlock(&display->cursor_cache_lock);
+            return;
+        }
+
+        slot = oldest_slot;
+
+    }
+
+    /* Zero out the full slot within the server-side mirror (the slot may
+     * contain the remains of a larger previously-cached cursor) before
+     * copying in the image contents */
+    unsigned char* dst = guac_display_cursor_cache_slot_data(display, slot);
+    for (int y = 0; y < GUAC_DISPLAY_CURSOR_CACHE_SLOT_SIZE; y++) {
+        memset(dst, 0, GUAC_DISPLAY_CURSOR_CACHE_SLOT_SIZE * 4);
+        dst += GUAC_DISPLAY_CURSOR_CACHE_STRIDE;
+    }
+
+    dst = guac_display_cursor_cache_slot_data(display, slot);
+    const unsigned char* src = data;
+    for (int y = 0; y < height; y++) {
+        memcpy(dst, src, width * 4);
+        src += cursor->last_frame.buffer_stride;
+        dst += GUAC_DISPLAY_CURSOR_CACHE_STRIDE;
+    }
+
+    guac_display_cursor_cache_entry* entry = &(display->cursor_cache[slot]);
+    entry->hash = hash;
+    entry->width = width;
+    entry->height = height;
+    entry->last_use = now;
+
+    /* Clear the slot client-side (cursor images have alpha and would
+     * otherwise composite with stale slot contents), then persist the
+     * freshly-sent cursor image within the client-side cursor cache buffer
+     * (these instructions follow the image data of the cursor update itself,
+     * and therefore copy exactly the content that was hashed) */
+    guac_rect slot_rect;
+    guac_display_cursor_cache_slot_rect(&slot_rect, slot);
+
+    guac_protocol_send_rect(client->socket, display->cursor_cache_buffer,
+            slot_rect.left, slot_rect.top,
+            GUAC_DISPLAY_CURSOR_CACHE_SLOT_SIZE,
+            GUAC_DISPLAY_CURSOR_CACHE_SLOT_SIZE);
+
+    guac_protocol_send_cfill(client->socket, GUAC_COMP_ROUT,
+            display->cursor_cache_buffer, 0x00, 0x00, 0x00, 0xFF);
+
+    guac_protocol_send_copy(client->socket, cursor->layer,
+            0, 0, width, height, GUAC_COMP_OVER,
+            display->cursor_cache_buffer, slot_rect.left, slot_rect.top);
+
+    pthread_mutex_unlock(&display->cursor_cache_lock);
+
+}
@@ -28,9 +28,20 @@
 #include "guacamole/socket.h"
 #include "guacamole/timestamp.h"
 
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
 #include <string.h>
 #include <cairo/cairo.h>
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#define GUAC_DISPLAY_MEMCMP_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define GUAC_DISPLAY_MEMCMP_NEON 1
+#include <arm_neon.h>
+#endif
+
 /**
  * Updates the dirty rect in the given cell to note that a horizontal line of
  * image data at the given location and having the given width has changed
@@ -101,7 +112,7 @@ static void guac_display_plan_mark_dirty(guac_display_layer* layer,
  *     via pos that are different between buffer_a and buffer_b, or zero if
  *     there are no such differences.
  */
-static size_t guac_display_memcmp(const uint32_t* restrict buffer_a,
+static size_t guac_display_memcmp_scalar(const uint32_t* restrict buffer_a,
         const uint32_t* restrict buffer_b, size_t count, size_t* pos) {
 
     /* Locate first difference between the buffers, if any */
@@ -140,12 +151,536 @@ static size_t guac_display_memcmp(const uint32_t* restrict buffer_a,
 
 }
 
+/**
+ * The comparison implementation most appropriate for the current CPU. This
+ * value defaults to the scalar implementation and is assigned exactly once by
+ * guac_display_memcmp_select(). Each implementation is semantically identical
+ * to guac_display_memcmp_scalar().
+ */
+static size_t (*guac_display_memcmp)(const uint32_t* restrict buffer_a,
+        const uint32_t* restrict buffer_b, size_t count,
+        size_t* pos) = guac_display_memcmp_scalar;
+
+/**
+ * Pthread initialization routine which selects the comparison implementation
+ * to use for all frame diffs. Invoked via pthread_once().
+ */
+static pthread_once_t guac_display_memcmp_selected = PTHREAD_ONCE_INIT;
+
+#ifdef GUAC_DISPLAY_MEMCMP_X86
+
+/**
+ * SSE2 variant of guac_display_memcmp_scalar(), comparing four 32-bit
+ * quantities at a time and locating differences within each 16-byte block
+ * using comparison bitmasks.
+ *
+ * @param buffer_a
+ *     The first buffer to compare.
+ *
+ * @param buffer_b
+ *     The buffer to compare with buffer_a.
+ *
+ * @param count
+ *     The number of 32-bit quantities in each buffer.
+ *
+ * @param pos
+ *     A pointer to a size_t that should receive the offset of the difference,
+ *     if the two buffers turn out to contain different data.
+ *
+ * @return
+ *     The number of 32-bit quantities after and including the offset returned
+ *     via pos that are different between buffer_a and buffer_b, or zero if
+ *     there are no such differences.
+ */
+static size_t guac_display_memcmp_sse2(const uint32_t* restrict buffer_a,
+        const uint32_t* restrict buffer_b, size_t count, size_t* pos) {
+
+    /* Locate first difference between the buffers scanning forward four
+     * values at a time, bailing out of the vector loop as soon as any block
+     * contains a difference */
+    size_t first = 0;
+    int diff = 0;
+    while (first + 4 <= count) {
+
+        __m128i cmp = _mm_cmpeq_epi32(
+                _mm_loadu_si128((const __m128i*) (buffer_a + first)),
+                _mm_loadu_si128((const __m128i*) (buffer_b + first)));
+
+        diff = ~_mm_movemask_ps(_mm_castsi128_ps(cmp)) & 0xF;
+        if (diff) {
+            first += __builtin_ctz(diff);
+            break;
+        }
+
+        first += 4;
+
+    }
+
+    /* Check the remaining tail values individually if the vector loop found
+     * no differences */
+    if (!diff) {
+        while (first < count && buffer_a[first] == buffer_b[first])
+            first++;
+        if (first >= count)
+            return 0;
+    }
+
+    /* Locate last difference scanning backward from the end of the buffers,
+     * again four values at a time. Blocks may safely overlap values already
+     * scanned above, as those values are either equal or at offset first. */
+    size_t last = first;
+    size_t end = count;
+    while (end >= first + 4) {
+
+        __m128i cmp = _mm_cmpeq_epi32(
+                _mm_loadu_si128((const __m128i*) (buffer_a + end - 4)),
+                _mm_loadu_si128((const __m128i*) (buffer_b + end - 4)));
+
+        diff = ~_mm_movemask_ps(_mm_castsi128_ps(cmp)) & 0xF;
+        if (diff) {
+            last = end - 4 + (31 - __builtin_clz(diff));
+            break;
+        }
+
+        end -= 4;
+
+    }
+
+    /* Check any values between the first difference and the lowest block
+     * scanned by the backward loop individually */
+    if (last == first) {
+        for (size_t offset = end; offset > first; offset--) {
+            if (buffer_a[offset - 1] != buffer_b[offset - 1]) {
+                last = offset - 1;
+                break;
+            }
+        }
+    }
+
+    *pos = first;
+    return last - first + 1;
+
+}
+
+/**
+ * AVX2 variant of guac_display_memcmp_scalar(), comparing eight 32-bit
+ * quantities at a time and locating differences within each 32-byte block
+ * using comparison bitmasks.
+ *
+ * @param buffer_a
+ *     The first buffer to compare.
+ *
+ * @param buffer_b
+ *     The buffer to compare with buffer_a.
+ *
+ * @param count
+ *     The number of 32-bit quantities in each buffer.
+ *
+ * @param pos
+ *     A pointer to a size_t that should receive the offset of the difference,
+ *     if the two buffers turn out to contain different data.
+ *
+ * @return
+ *     The number of 32-bit quantities after and including the offset returned
+ *     via pos that are different between buffer_a and buffer_b, or zero if
+ *     there are no such differences.
+ */
+__attribute__((target("avx2")))
+static size_t guac_display_memcmp_avx2(const uint32_t* restrict buffer_a,
+        const uint32_t* restrict buffer_b, size_t count, size_t* pos) {
+
+    /* Locate first difference between the buffers scanning forward eight
+     * values at a time, bailing out of the vector loop as soon as any block
+     * contains a difference */
+    size_t first = 0;
+    int diff = 0;
+    while (first + 8 <= count) {
+
+        __m256i cmp = _mm256_cmpeq_epi32(
+                _mm256_loadu_si256((const __m256i*) (buffer_a + first)),
+                _mm256_loadu_si256((const __m256i*) (buffer_b + first)));
+
+        diff = ~_mm256_movemask_ps(_mm256_castsi256_ps(cmp)) & 0xFF;
+        if (diff) {
+            first += __builtin_ctz(diff);
+            break;
+        }
+
+        first += 8;
+
+    }
+
+    /* Check the remaining tail values individually if the vector loop found
+     * no differences */
+    if (!diff) {
+        while (first < count && buffer_a[first] == buffer_b[first])
+            first++;
+        if (first >= count)
+            return 0;
+    }
+
+    /* Locate last difference scanning backward from the end of the buffers,
+     * again eight values at a time. Blocks may safely overlap values already
+     * scanned above, as those values are either equal or at offset first. */
+    size_t last = first;
+    size_t end = count;
+    while (end >= first + 8) {
+
+        __m256i cmp = _mm256_cmpeq_epi32(
+                _mm256_loadu_si256((const __m256i*) (buffer_a + end - 8)),
+                _mm256_loadu_si256((const __m256i*) (buffer_b + end - 8)));
+
+        diff = ~_mm256_movemask_ps(_mm256_castsi256_ps(cmp)) & 0xFF;
+        if (diff) {
+            last = end - 8 + (31 - __builtin_clz(diff));
+            break;
+        }
+
+        end -= 8;
+
+    }
+
+    /* Check any values between the first difference and the lowest block
+     * scanned by the backward loop individually */
+    if (last == first) {
+        for (size_t offset = end; offset > first; offset--) {
+            if (buffer_a[offset - 1] != buffer_b[offset - 1]) {
+                last = offset - 1;
+                break;
+            }
+        }
+    }
+
+    *pos = first;
+    return last - first + 1;
+
+}
+
+#endif /* GUAC_DISPLAY_MEMCMP_X86 */
+
+#ifdef GUAC_DISPLAY_MEMCMP_NEON
+
+/**
+ * NEON variant of guac_display_memcmp_scalar(), testing four 32-bit
+ * quantities at a time for equality and falling back to individual
+ * comparisons only within blocks known to contain a difference.
+ *
+ * @param buffer_a
+ *     The first buffer to compare.
+ *
+ * @param buffer_b
+ *     The buffer to compare with buffer_a.
+ *
+ * @param count
+ *     The number of 32-bit quantities in each buffer.
+ *
+ * @param pos
+ *     A pointer to a size_t that should receive the offset of the difference,
+ *     if the two buffers turn out to contain different data.
+ *
+ * @return
+ *     The number of 32-bit quantities after and including the offset returned
+ *     via pos that are different between buffer_a and buffer_b, or zero if
+ *     there are no such differences.
+ */
+static size_t guac_display_memcmp_neon(const uint32_t* restrict buffer_a,
+        const uint32_t* restrict buffer_b, size_t count, size_t* pos) {
+
+    /* Locate the block containing the first difference between the buffers,
+     * scanning forward four values at a time */
+    size_t first = 0;
+    while (first + 4 <= count) {
+
+        uint32x4_t cmp = vceqq_u32(vld1q_u32(buffer_a + first),
+                vld1q_u32(buffer_b + first));
+
+        if (vminvq_u32(cmp) != 0xFFFFFFFF)
+            break;
+
+        first += 4;
+
+    }
+
+    /* Narrow down to the exact value that differs (which may be within the
+     * tail not covered by the vector loop) */
+    while (first < count && buffer_a[first] == buffer_b[first])
+        first++;
+
+    if (first >= count)
+        return 0;
+
+    /* Locate the block containing the last difference, scanning backward from
+     * the end of the buffers. Blocks may safely overlap values already
+     * scanned above, as those values are either equal or at offset first. */
+    size_t last = first;
+    size_t end = count;
+    while (end >= first + 4) {
+
+        uint32x4_t cmp = vceqq_u32(vld1q_u32(buffer_a + end - 4),
+                vld1q_u32(buffer_b + end - 4));
+
+        if (vminvq_u32(cmp) != 0xFFFFFFFF)
+            break;
+
+        end -= 4;
+
+    }
+
+    /* Narrow down to the exact last value that differs */
+    for (size_t offset = end; offset > first; offset--) {
+        if (buffer_a[offset - 1] != buffer_b[offset - 1]) {
+            last = offset - 1;
+            break;
+        }
+    }
+
+    *pos = first;
+    return last - first + 1;
+
+}
+
+#endif /* GUAC_DISPLAY_MEMCMP_NEON */
+
+/**
+ * Selects the comparison implementation to use for all frame diffs based on
+ * the capabilities of the current CPU. If the CPU supports none of the
+ * available vector implementations, the scalar implementation is retained.
+ */
+static void guac_display_memcmp_select(void) {
+
+#if defined(GUAC_DISPLAY_MEMCMP_X86)
+    if (__builtin_cpu_supports("avx2"))
+        guac_display_memcmp = guac_display_memcmp_avx2;
+    else
+        guac_display_memcmp = guac_display_memcmp_sse2;
+#elif defined(GUAC_DISPLAY_MEMCMP_NEON)
+    guac_display_memcmp = guac_display_memcmp_neon;
+#endif
+
+}
+
+/**
+ * Compares the pending frame contents of a layer against the last frame
+ * within the region covered by the given diff job, refining the dirty rects
+ * of each cell in that region to more accurately contain only what has
+ * actually changed since the last frame. The number of cells found to have
+ * changed and the bounding rectangle of all changes are stored within the
+ * job.
+ *
+ * The region covered by the job must span whole rows of cells (except
+ * possibly at the right and bottom edges of the layer) and must lie entirely
+ * within the bounds of the pending frame. As jobs covering disjoint rows of
+ * cells touch entirely disjoint state, multiple invocations of this function
+ * may safely proceed in parallel for the same layer. Threads invoking this
+ * function other than the thread that created the relevant plan do so on
+ * behalf of that thread, which must hold the required locks and must not
+ * return until all such invocations have completed.
+ *
+ * @param job
+ *     The job describing the layer and region to be compared.
+ */
+static void PFW_LFR_guac_display_plan_refine_region(
+        guac_display_plan_diff_job* job) {
+
+    guac_display_layer* current = job->layer;
+    guac_rect region = job->region;
+
+    job->op_count = 0;
+    job->dirty = (guac_rect) { 0 };
+
+    const unsigned char* flushed_row = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(current->last_frame, region);
+    unsigned char* buffer_row = GUAC_DISPLAY_LAYER_STATE_MUTABLE_BUFFER(current->pending_frame, region);
+
+    guac_display_layer_cell* cell_row = current->pending_frame_cells
+        + guac_mem_ckd_mul_or_die(region.top / GUAC_DISPLAY_CELL_SIZE, current->pending_frame_cells_width)
+        + region.left / GUAC_DISPLAY_CELL_SIZE;
+
+    /* Loop through the rough modified region, refining the dirty rects of
+     * each cell to more accurately contain only what has actually changed
+     * since last frame */
+    for (int corner_y = region.top; corner_y < region.bottom; corner_y += GUAC_DISPLAY_CELL_SIZE) {
+
+        int height = GUAC_DISPLAY_CELL_SIZE;
+        if (corner_y + height > region.bottom)
+            height = region.bottom - corner_y;
+
+        /* Iteration through the pending_frame_cells array and the image
+         * buffer is a bit complex here, as the pending_frame_cells array
+         * contains cells that represent 64x64 regions, while the image
+         * buffers contain absolutely all pixels. The outer loop goes
+         * through just the pending cells, while the following loop goes
+         * through the Y coordinates that make up that cell. */
+
+        for (int y_off = 0; y_off < height; y_off++) {
+
+            /* At this point, we need to loop through the horizontal
+             * dimension, comparing the 64-pixel rows of image data in the
+             * current line (corner_y + y_off) that are in each applicable
+             * cell. We jump forward by one cell for each comparison. */
+
+            int y = corner_y + y_off;
+
+            guac_display_layer_cell* current_cell = cell_row;
+            uint32_t* current_flushed = (uint32_t*) flushed_row;
+            uint32_t* current_buffer = (uint32_t*) buffer_row;
+            for (int corner_x = region.left; corner_x < region.right; corner_x += GUAC_DISPLAY_CELL_SIZE) {
+
+                int width = GUAC_DISPLAY_CELL_SIZE;
+                if (corner_x + width > region.right)
+                    width = region.right - corner_x;
+
+                /* This SHOULD be impossible, as corner_x would need to
+                 * somehow be outside the bounds of the job region, which
+                 * would have failed the loop condition earlier) */
+                GUAC_ASSERT(width >= 0);
+
+                /* Skip cells that no caller has reported as modified,
+                 * even if they lie within the bounding dirty rect (two
+                 * small changes at opposite corners of a layer need not
+                 * force the whole spanning rectangle to be compared) */
+                if (!current_cell->touched) {
+                    /* Nothing to compare */
+                }
+
+                /* Any line that is completely outside the bounds of the
+                 * previous frame is dirty (nothing to compare against) */
+                else if (y >= current->last_frame.height || corner_x >= current->last_frame.width) {
+                    guac_display_plan_mark_dirty(current, current_cell, &job->op_count, corner_x, y, width);
+                    guac_rect_extend(&job->dirty, &current_cell->dirty);
+                }
+
+                /* All other regions must be processed further to determine
+                 * what portion is dirty */
+                else {
+
+                    /* Only the pixels that are within the bounds of BOTH
+                     * the last_frame and pending_frame are directly
+                     * comparable. Others are inherently dirty by virtue of
+                     * being outside the bounds of last_frame */
+                    int comparable_width = width;
+                    if (corner_x + comparable_width > current->last_frame.width)
+                        comparable_width = current->last_frame.width - corner_x;
+
+                    /* It is impossible for this value to be negative
+                     * because of the last_frame bounds checks that occur
+                     * in the if block prior to this else block */
+                    GUAC_ASSERT(comparable_width >= 0);
+
+                    /* Any region outside the right edge of the previous frame is dirty */
+                    if (width > comparable_width) {
+                        guac_display_plan_mark_dirty(current, current_cell, &job->op_count, corner_x + comparable_width, y, width - comparable_width);
+                        guac_rect_extend(&job->dirty, &current_cell->dirty);
+                    }
+
+                    /* Mark the relevant region of the cell as dirty if the
+                     * current 64-pixel line has changed in any way */
+                    size_t length, pos;
+                    if ((length = guac_display_memcmp(current_buffer, current_flushed, comparable_width, &pos)) != 0) {
+                        guac_display_plan_mark_dirty(current, current_cell, &job->op_count, corner_x + pos, y, length);
+                        guac_rect_extend(&job->dirty, &current_cell->dirty);
+                    }
+
+                }
+
+                current_flushed += GUAC_DISPLAY_CELL_SIZE;
+                current_buffer += GUAC_DISPLAY_CELL_SIZE;
+                current_cell++;
+
+            }
+
+            flushed_row += current->last_frame.buffer_stride;
+            buffer_row += current->pending_frame.buffer_stride;
+
+        }
+
+        cell_row += current->pending_frame_cells_width;
+
+    }
+
+}
+
+/**
+ * Claims and processes as many jobs as possible from the current batch of
+ * diff jobs of the given display, returning once no jobs remain unclaimed.
+ * The thread that finishes the final job of the batch additionally reports
+ * completion of the batch as a whole via the diff_state flag of the display.
+ * Both the diff worker threads and the thread creating a plan use this
+ * function to process batches, ensuring progress does not depend on the
+ * worker threads being idle.
+ *
+ * @param display
+ *     The display whose current batch of diff jobs should be processed.
+ */
+static void PFW_LFR_guac_display_plan_claim_diff_jobs(guac_display* display) {
+
+    for (;;) {
+
+        /* Atomically claim the next job of the batch, bailing out once all
+         * jobs have been claimed. The total packed into the claimed value
+         * guarantees the claim is evaluated against the batch that value
+         * belongs to (see the documentation of the diff_claims member) */
+        uint64_t claim = __atomic_fetch_add(&display->diff_claims, 1, __ATOMIC_ACQUIRE);
+        if (GUAC_DISPLAY_DIFF_CLAIM_INDEX(claim) >= GUAC_DISPLAY_DIFF_CLAIM_TOTAL(claim))
+            return;
+
+        PFW_LFR_guac_display_plan_refine_region(
+                &display->diff_jobs[GUAC_DISPLAY_DIFF_CLAIM_INDEX(claim)]);
+
+        /* The thread that finishes the final job of the batch reports
+         * completion of the batch as a whole */
+        if (__atomic_sub_fetch(&display->diff_remaining_jobs, 1, __ATOMIC_ACQ_REL) == 0) {
+            guac_flag_set_and_lock(&display->diff_state, GUAC_DISPLAY_DIFF_STATE_COMPLETE);
+            guac_flag_clear(&display->diff_state, GUAC_DISPLAY_DIFF_STATE_JOBS_AVAILABLE);
+            guac_flag_unlock(&display->diff_state);
+        }
+
+    }
+
+}
+
+void* guac_display_diff_worker_thread(void* data) {
+
+    guac_display* display = (guac_display*) data;
+
+    for (;;) {
+
+        /* Wait for a batch of diff jobs to become available (or for the
+         * display to be freed) */
+        guac_flag_wait_and_lock(&display->diff_state,
+                GUAC_DISPLAY_DIFF_STATE_JOBS_AVAILABLE
+              | GUAC_DISPLAY_DIFF_STATE_STOPPING);
+
+        int stopping = display->diff_state.value & GUAC_DISPLAY_DIFF_STATE_STOPPING;
+        guac_flag_unlock(&display->diff_state);
+
+        if (stopping)
+            break;
+
+        PFW_LFR_guac_display_plan_claim_diff_jobs(display);
+
+        /* The JOBS_AVAILABLE flag is cleared by whichever thread finishes the
+         * final job of the batch. If this thread found no jobs left to claim
+         * while another thread is still finishing that final job, the flag
+         * may briefly remain set. Yield rather than spin aggressively for
+         * that short window. */
+        sched_yield();
+
+    }
+
+    return NULL;
+
+}
+
 guac_display_plan* PFW_LFR_guac_display_plan_create(guac_display* display) {
 
     guac_display_layer* current;
     guac_timestamp frame_end = guac_timestamp_current();
     size_t op_count = 0;
 
+    /* Compare buffers with vector instructions where the CPU supports doing
+     * so */
+    pthread_once(&guac_display_memcmp_selected, guac_display_memcmp_select);
+
     /* Loop through each layer, searching for modified regions */
     current = display->pending_frame.layers;
     while (current != NULL) {
@@ -156,6 +691,7 @@ guac_display_plan* PFW_LFR_guac_display_plan_create(guac_display* display) {
          * is freed) */
         if (current->pending_frame.buffer == NULL) {
             GUAC_ASSERT(current->pending_frame.buffer_is_external);
+            current = current->pending_frame.next;
             continue;
         }
 
@@ -192,107 +728,79 @@ guac_display_plan* PFW_LFR_guac_display_plan_create(guac_display* display) {
          * frame is considered dirty) */
         guac_rect_constrain(&dirty, &pending_frame_bounds);
 
-        const unsigned char* flushed_row = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(current->last_frame, dirty);
-        unsigned char* buffer_row = GUAC_DISPLAY_LAYER_STATE_MUTABLE_BUFFER(current->pending_frame, dirty);
-
-        guac_display_layer_cell* cell_row = current->pending_frame_cells
-            + guac_mem_ckd_mul_or_die(dirty.top / GUAC_DISPLAY_CELL_SIZE, current->pending_frame_cells_width)
-            + dirty.left / GUAC_DISPLAY_CELL_SIZE;
-
-        /* Loop through the rough modified region, refining the dirty rects of
-         * each cell to more accurately contain only what has actually changed
-         * since last frame */ 
+        /* The layer-level dirty rect will be recalculated from the refined
+         * per-cell dirty rects below */
         current->pending_frame.dirty = (guac_rect) { 0 };
-        for (int corner_y = dirty.top; corner_y < dirty.bottom; corner_y += GUAC_DISPLAY_CELL_SIZE) {
-
-            int height = GUAC_DISPLAY_CELL_SIZE;
-            if (corner_y + height > dirty.bottom)
-                height = dirty.bottom - corner_y;
-
-            /* Iteration through the pending_frame_cells array and the image
-             * buffer is a bit complex here, as the pending_frame_cells array
-             * contains cells that represent 64x64 regions, while the image
-             * buffers contain absolutely all pixels. The outer loop goes
-             * through just the pending cells, while the following loop goes
-             * through the Y coordinates that make up that cell. */
-
-            for (int y_off = 0; y_off < height; y_off++) {
-
-                /* At this point, we need to loop through the horizontal
-                 * dimension, comparing the 64-pixel rows of image data in the
-                 * current line (corner_y + y_off) that are in each applicable
-                 * cell. We jump forward by one cell for each comparison. */
-
-                int y = corner_y + y_off;
-
-                guac_display_layer_cell* current_cell = cell_row;
-                uint32_t* current_flushed = (uint32_t*) flushed_row;
-                uint32_t* current_buffer = (uint32_t*) buffer_row;
-                for (int corner_x = dirty.left; corner_x < dirty.right; corner_x += GUAC_DISPLAY_CELL_SIZE) {
-
-                    int width = GUAC_DISPLAY_CELL_SIZE;
-                    if (corner_x + width > dirty.right)
-                        width = dirty.right - corner_x;
-
-                    /* This SHOULD be impossible, as corner_x would need to
-                     * somehow be outside the bounds of the dirty rect, which
-                     * would have failed the loop condition earlier) */
-                    GUAC_ASSERT(width >= 0);
-
-                    /* Any line that is completely outside the bounds of the
-                     * previous frame is dirty (nothing to compare against) */
-                    if (y >= current->last_frame.height || corner_x >= current->last_frame.width) {
-                        guac_display_plan_mark_dirty(current, current_cell, &op_count, corner_x, y, width);
-                        guac_rect_extend(&current->pending_frame.dirty, &current_cell->dirty);
-                    }
 
-                    /* All other regions must be processed further to determine
-                     * what portion is dirty */
-                    else {
-
-                        /* Only the pixels that are within the bounds of BOTH
-                         * the last_frame and pending_frame are directly
-                         * comparable. Others are inherently dirty by virtue of
-                         * being outside the bounds of last_frame */
-                        int comparable_width = width;
-                        if (corner_x + comparable_width > current->last_frame.width)
-                            comparable_width = current->last_frame.width - corner_x;
-
-                        /* It is impossible for this value to be negative
-                         * because of the last_frame bounds checks that occur
-                         * in the if block prior to this else block */
-                        GUAC_ASSERT(comparable_width >= 0);
-
-                        /* Any region outside the right edge of the previous frame is dirty */
-                        if (width > comparable_width) {
-                            guac_display_plan_mark_dirty(current, current_cell, &op_count, corner_x + comparable_width, y, width - comparable_width);
-                            guac_rect_extend(&current->pending_frame.dirty, &current_cell->dirty);
-                        }
-
-                        /* Mark the relevant region of the cell as dirty if the
-                         * current 64-pixel line has changed in any way */
-                        size_t length, pos;
-                        if ((length = guac_display_memcmp(current_buffer, current_flushed, comparable_width, &pos)) != 0) {
-                            guac_display_plan_mark_dirty(current, current_cell, &op_count, corner_x + pos, y, length);
-                            guac_rect_extend(&current->pending_frame.dirty, &current_cell->dirty);
-                        }
+        /* Split the comparison into bands of cell rows that can be processed
+         * in parallel if the region is large enough to be worth splitting and
+         * there are diff worker threads available to assist. Each band covers
+         * whole rows of cells, and no two bands share any cells. */
+        int total_jobs = 0;
+        int cell_rows = (dirty.bottom - dirty.top + GUAC_DISPLAY_CELL_SIZE - 1) / GUAC_DISPLAY_CELL_SIZE;
+        size_t area = (size_t) guac_rect_width(&dirty) * guac_rect_height(&dirty);
 
-                    }
+        int max_jobs = display->diff_thread_count + 1;
+        if (max_jobs > GUAC_DISPLAY_MAX_DIFF_JOBS)
+            max_jobs = GUAC_DISPLAY_MAX_DIFF_JOBS;
+        if (max_jobs > cell_rows)
+            max_jobs = cell_rows;
 
-                    current_flushed += GUAC_DISPLAY_CELL_SIZE;
-                    current_buffer += GUAC_DISPLAY_CELL_SIZE;
-                    current_cell++;
+        if (max_jobs > 1 && area >= GUAC_DISPLAY_PARALLEL_DIFF_AREA) {
 
-                }
+            int band_rows = (cell_rows + max_jobs - 1) / max_jobs;
+            for (int row = 0; row < cell_rows; row += band_rows) {
 
-                flushed_row += current->last_frame.buffer_stride;
-                buffer_row += current->pending_frame.buffer_stride;
+                guac_display_plan_diff_job* job = &display->diff_jobs[total_jobs++];
+                job->layer = current;
+                job->region = dirty;
+                job->region.top = dirty.top + row * GUAC_DISPLAY_CELL_SIZE;
+                if (job->region.top + band_rows * GUAC_DISPLAY_CELL_SIZE < dirty.bottom)
+                    job->region.bottom = job->region.top + band_rows * GUAC_DISPLAY_CELL_SIZE;
 
             }
 
-            cell_row += current->pending_frame_cells_width;
+            /* Publish the batch to the diff worker threads. The job array and
+             * the count of remaining jobs must be fully written before the
+             * batch is made claimable via the atomic update of diff_claims */
+            __atomic_store_n(&display->diff_remaining_jobs, total_jobs, __ATOMIC_RELAXED);
+            __atomic_store_n(&display->diff_claims, GUAC_DISPLAY_DIFF_CLAIM(total_jobs), __ATOMIC_RELEASE);
+            guac_flag_set(&display->diff_state, GUAC_DISPLAY_DIFF_STATE_JOBS_AVAILABLE);
+
+            /* Participate in processing the batch rather than simply waiting,
+             * both so that this thread's core is put to use and so that
+             * completion of the batch does not depend on the worker threads
+             * being idle */
+            PFW_LFR_guac_display_plan_claim_diff_jobs(display);
+
+            /* All jobs have been claimed, but jobs claimed by worker threads
+             * may still be in progress. The final thread to finish a job sets
+             * the COMPLETE flag. */
+            guac_flag_wait_and_lock(&display->diff_state, GUAC_DISPLAY_DIFF_STATE_COMPLETE);
+            guac_flag_clear(&display->diff_state, GUAC_DISPLAY_DIFF_STATE_COMPLETE);
+            guac_flag_unlock(&display->diff_state);
+
+        }
+
+        /* Process smaller regions inline as a single job, avoiding the
+         * overhead of waking and coordinating the worker threads */
+        else {
+            guac_display_plan_diff_job* job = &display->diff_jobs[0];
+            job->layer = current;
+            job->region = dirty;
+            PFW_LFR_guac_display_plan_refine_region(job);
+            total_jobs = 1;
+        }
 
+        /* Fold the results of all jobs back into the layer-level dirty rect
+         * and the overall operation count */
+        guac_rect job_dirty[GUAC_DISPLAY_MAX_DIFF_JOBS];
+        for (int i = 0; i < total_jobs; i++) {
+            guac_display_plan_diff_job* job = &display->diff_jobs[i];
+            op_count += job->op_count;
+            job_dirty[i] = job->dirty;
         }
+        guac_rect_extend_all(&current->pending_frame.dirty, job_dirty, total_jobs);
 
         current = current->pending_frame.next;
 
@@ -302,11 +810,31 @@ guac_display_plan* PFW_LFR_guac_display_plan_create(guac_display* display) {
     if (!op_count)
         return NULL;
 
-    guac_display_plan* plan = guac_mem_alloc(sizeof(guac_display_plan));
+    /* Reuse the plan from a previous frame if available, avoiding repeated
+     * allocation and freeing of the relatively large plan structure with each
+     * rendered frame */
+    guac_fifo_lock(&display->ops);
+    guac_display_plan* plan = display->spare_plan;
+    display->spare_plan = NULL;
+    guac_fifo_unlock(&display->ops);
+
+    if (plan == NULL) {
+        plan = guac_mem_alloc(sizeof(guac_display_plan));
+        plan->ops = NULL;
+        plan->ops_capacity = 0;
+    }
+
     plan->display = display;
     plan->frame_end = frame_end;
     plan->length = guac_mem_ckd_add_or_die(op_count, 1);
-    plan->ops = guac_mem_alloc(plan->length, sizeof(guac_display_plan_operation));
+
+    /* Grow the ops array only if the reused plan cannot already hold all
+     * operations for the current frame */
+    if (plan->length > plan->ops_capacity) {
+        guac_mem_free(plan->ops);
+        plan->ops = guac_mem_alloc(plan->length, sizeof(guac_display_plan_operation));
+        plan->ops_capacity = plan->length;
+    }
 
     /* Convert the dirty rectangles stored in each layer's cells to individual
      * image operations for later optimization */
@@ -328,16 +856,34 @@ guac_display_plan* PFW_LFR_guac_display_plan_create(guac_display* display) {
                      * in the way the original operation count was calculated */
                     GUAC_ASSERT(added_ops < op_count);
 
+                    /* Record this frame within the cell's update history,
+                     * which now spans from the oldest remaining entry
+                     * through the current frame */
+                    cell->history[cell->oldest_entry] = frame_end;
+                    cell->oldest_entry = (cell->oldest_entry + 1)
+                        % GUAC_DISPLAY_CELL_HISTORY_SIZE;
+
+                    /* Derive the average rate at which this cell has been
+                     * updating over its recorded history (cells with no real
+                     * history yet will produce an elapsed time so large that
+                     * the resulting framerate is zero) */
+                    int framerate = INT_MAX;
+                    guac_timestamp elapsed = frame_end
+                        - cell->history[cell->oldest_entry];
+                    if (elapsed > 0)
+                        framerate = (int) (GUAC_DISPLAY_CELL_HISTORY_SIZE
+                                * 1000 / elapsed);
+
                     current_op->layer = current;
                     current_op->type = GUAC_DISPLAY_PLAN_OPERATION_IMG;
                     current_op->dest = cell->dirty;
                     current_op->dirty_size = cell->dirty_size;
-                    current_op->last_frame = cell->last_frame;
-                    current_op->current_frame = frame_end;
+                    current_op->framerate = framerate;
+                    current_op->hash = 0;
+                    current_op->refinement = 0;
 
                     cell->related_op = current_op;
                     cell->dirty_size = 0;
-                    cell->last_frame = frame_end;
 
                     current_op++;
                     added_ops++;
@@ -346,6 +892,9 @@ guac_display_plan* PFW_LFR_guac_display_plan_create(guac_display* display) {
                 else
                     cell->related_op = NULL;
 
+                /* All reported modifications have now been evaluated */
+                cell->touched = 0;
+
                 cell++;
 
             }
@@ -370,8 +919,24 @@ guac_display_plan* PFW_LFR_guac_display_plan_create(guac_display* display) {
 }
 
 void guac_display_plan_free(guac_display_plan* plan) {
-    guac_mem_free(plan->ops);
-    guac_mem_free(plan);
+
+    guac_display* display = plan->display;
+
+    /* Retain the plan for reuse by a future frame if no other plan has
+     * already been retained */
+    guac_fifo_lock(&display->ops);
+    if (display->spare_plan == NULL) {
+        display->spare_plan = plan;
+        plan = NULL;
+    }
+    guac_fifo_unlock(&display->ops);
+
+    /* Actually free the plan only if it could not be retained */
+    if (plan != NULL) {
+        guac_mem_free(plan->ops);
+        guac_mem_free(plan);
+    }
+
 }
 
 void guac_display_plan_apply(guac_display_plan* plan) {
@@ -394,6 +959,16 @@ void guac_display_plan_apply(guac_display_plan* plan) {
         switch (op->type) {
 
             case GUAC_DISPLAY_PLAN_OPERATION_COPY:
+
+                /* Clear destination before copying if the layer is not opaque
+                 * (the copied data would otherwise be composited together
+                 * with the old contents of the layer) */
+                if (!display_layer->opaque) {
+                    guac_protocol_send_rect(client->socket, display_layer->layer,
+                            op->dest.left, op->dest.top, guac_rect_width(&op->dest), guac_rect_height(&op->dest));
+                    guac_protocol_send_cfill(client->socket, GUAC_COMP_ROUT, display_layer->layer, 0x00, 0x00, 0x00, 0xFF);
+                }
+
                 guac_protocol_send_copy(client->socket, op->src.layer_rect.layer,
                         op->src.layer_rect.rect.left, op->src.layer_rect.rect.top,
                         guac_rect_width(&op->src.layer_rect.rect), guac_rect_height(&op->src.layer_rect.rect),
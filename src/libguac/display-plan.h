@@ -47,17 +47,39 @@
 #define GUAC_DISPLAY_DATA_FACTOR 128
 
 /**
- * The maximum width or height to allow when combining any pair of rendering
- * operations into a single operation, in pixels, as the exponent of a power of
- * two. This value is intended to be large enough to avoid unnecessarily
- * increasing the number of drawing operations, yet also small enough to allow
- * larger updates to be easily parallelized via the worker threads.
+ * The initial maximum width or height to allow when combining any pair of
+ * rendering operations into a single operation, in pixels, as the exponent of
+ * a power of two. This value is intended to be large enough to avoid
+ * unnecessarily increasing the number of drawing operations, yet also small
+ * enough to allow larger updates to be easily parallelized via the worker
+ * threads.
  *
- * The current value of 9 means that each encoded image will be no larger than
- * 512x512 pixels.
+ * The initial value of 9 means that each encoded image will start out no
+ * larger than 512x512 pixels. The limit actually applied is per-display and
+ * adapts within the bounds of GUAC_DISPLAY_COMBINED_SIZE_MIN and
+ * GUAC_DISPLAY_COMBINED_SIZE_MAX according to the realized encoding
+ * efficiency measured for each size of image produced, as the size at which
+ * per-rectangle overhead stops dominating encoding cost varies considerably
+ * between workloads (compare a full-screen CAD application against a
+ * terminal).
  */
 #define GUAC_DISPLAY_MAX_COMBINED_SIZE 9
 
+/**
+ * The smallest value that the adaptive per-display limit on the size of
+ * combined operations may reach, in pixels, as the exponent of a power of
+ * two.
+ */
+#define GUAC_DISPLAY_COMBINED_SIZE_MIN 8
+
+/**
+ * The largest value that the adaptive per-display limit on the size of
+ * combined operations may reach, in pixels, as the exponent of a power of
+ * two. Image updates for regions in sustained motion, which are allowed to
+ * combine one step beyond the adaptive limit, are also capped at this size.
+ */
+#define GUAC_DISPLAY_COMBINED_SIZE_MAX 11
+
 /**
  * The base cost of every update. Each update should be considered to have
  * this starting cost, plus any additional cost estimated from its
@@ -82,22 +104,6 @@
  */
 #define GUAC_DISPLAY_JPEG_MIN_BITMAP_SIZE 4096
 
-/**
- * The JPEG compression min block size, as the exponent of a power of two. This
- * defines the optimal rectangle block size factor for JPEG compression.
- * Usually 8x8 would suffice, but we use 16x16 here to reduce the occurrence of
- * ringing artifacts further.
- */
-#define GUAC_SURFACE_JPEG_BLOCK_SIZE 4
-
-/**
- * The WebP compression min block size, as the exponent of a power of two. This
- * defines the optimal rectangle block size factor for WebP compression. WebP
- * does utilize variable block size, but ensuring a block size factor reduces
- * any noise on the image edges.
- */
-#define GUAC_SURFACE_WEBP_BLOCK_SIZE 3
-
 /**
  * The number of hash buckets within each guac_display_plan.
  */
@@ -198,17 +204,41 @@ typedef struct guac_display_plan_operation {
     size_t dirty_size;
 
     /**
-     * The timestamp of the last frame that made any change within the
-     * destination rect of the destination layer.
+     * The approximate rate at which the region covered by the destination
+     * rect has been updating, in frames per second, averaged over the update
+     * history recorded for that region. Unlike a rate derived solely from
+     * the interval since the previous change, this value reflects persistent
+     * churn (spinners, animations, embedded video) rather than momentary
+     * bursts, and is used to decide whether lossy encoding is appropriate.
      */
-    guac_timestamp last_frame;
+    int framerate;
 
     /**
-     * The timestamp of the change being made. This will be the timestamp of
-     * the frame at the time the frame was ended, not the timestamp of the
-     * server at the time this operation was added to the plan.
+     * Non-zero if this operation is a lossless refinement of content that
+     * has already been sent to connected clients (rather than content that
+     * clients have yet to receive at all). Refinement operations improve
+     * quality only, and may therefore be safely dropped by workers if their
+     * destination region has been modified again since the operation was
+     * queued, as the pixels produced would be overwritten by the very next
+     * frame.
      */
-    guac_timestamp current_frame;
+    int refinement;
+
+    /**
+     * The squared distance between the destination rect of this operation and
+     * the position of the mouse cursor, as calculated the last time the plan
+     * was prioritized. Operations closer to the cursor are encoded first.
+     */
+    uint64_t cursor_distance;
+
+    /**
+     * The hash of the image contents of the cell-aligned 64x64 region
+     * containing the destination rect of this operation, as calculated when
+     * dirty cells were indexed, or zero if no hash has been calculated for
+     * this operation (or if any previously-calculated hash was invalidated
+     * by combining this operation with another).
+     */
+    uint64_t hash;
 
     union {
 
@@ -228,6 +258,47 @@ typedef struct guac_display_plan_operation {
 
 } guac_display_plan_operation;
 
+/**
+ * A single unit of frame diff work, covering a horizontal band of cells
+ * within the dirty region of a single layer. When the dirty region of a
+ * layer is large enough to be worth splitting, the per-frame comparison of
+ * pending and last frame contents is divided into several such bands, each
+ * of which may be processed independently by a diff worker thread (or by the
+ * thread creating the plan). Bands never share cells, so no synchronization
+ * of the per-cell dirty state is required between jobs.
+ */
+typedef struct guac_display_plan_diff_job {
+
+    /**
+     * The layer whose contents should be compared against the last frame.
+     */
+    guac_display_layer* layer;
+
+    /**
+     * The region of the layer covered by this job. The top edge of this
+     * region is always aligned with a cell boundary, and the region always
+     * spans whole rows of cells (except possibly at the right and bottom
+     * edges of the layer).
+     */
+    guac_rect region;
+
+    /**
+     * The number of cells within this job's region that were found to have
+     * changed since the last frame. This value is written by the thread that
+     * processes the job and read by the thread that created the plan, after
+     * all jobs have completed.
+     */
+    size_t op_count;
+
+    /**
+     * The bounding rectangle of all changes found within this job's region,
+     * or an empty rect if no changes were found. As with op_count, this value
+     * is read only after all jobs have completed.
+     */
+    guac_rect dirty;
+
+} guac_display_plan_diff_job;
+
 /**
  * A guac_display_plan_operation that has been hashed and stored within a
  * guac_display_plan.
@@ -283,12 +354,27 @@ typedef struct guac_display_plan {
      */
     size_t length;
 
+    /**
+     * The number of operations that the ops array can hold without being
+     * reallocated. As plans are retained and reused across frames, this value
+     * only ever grows, quickly converging on the maximum number of operations
+     * produced by any single frame.
+     */
+    size_t ops_capacity;
+
     /**
      * Index of operations in the plan by their image contents. Only operations
      * that can be easily stored without collisions will be represented here.
      */
     guac_display_plan_indexed_operation ops_by_hash[GUAC_DISPLAY_PLAN_OPERATION_INDEX_SIZE];
 
+    /**
+     * The number of operations currently stored within ops_by_hash. Searches
+     * that pull operations from the index can safely stop early once this
+     * value reaches zero.
+     */
+    size_t indexed_ops;
+
 } guac_display_plan;
 
 /**
@@ -324,10 +410,35 @@ typedef struct guac_display_plan {
 guac_display_plan* PFW_LFR_guac_display_plan_create(guac_display* display);
 
 /**
- * Frees all memory associated with the given guac_display_plan.
+ * Subtracts regions hidden behind opaque layers from the dirty rect of each
+ * visible layer of the given display, such that updates to entirely obscured
+ * regions are neither compared against the previous frame nor encoded. The
+ * subtracted regions are not discarded but deferred (stored within the
+ * occluded_dirty rect of each affected layer), and must be restored to the
+ * dirty rect of each layer once the frame being flushed is complete. They
+ * will then be re-examined as part of future frames and finally sent if
+ * revealed.
+ *
+ * This pass must run before PFW_LFR_guac_display_plan_create(), as it reduces
+ * the regions that the plan will consider.
+ *
+ * IMPORTANT: The calling thread must already hold the write lock for the
+ * display's pending_frame.lock.
+ *
+ * @param display
+ *     The guac_display whose layer dirty rects should be culled according to
+ *     layer occlusion.
+ */
+void PFW_guac_display_plan_cull_occluded(guac_display* display);
+
+/**
+ * Releases the given guac_display_plan. The plan will be retained by the
+ * associated guac_display for reuse by a future frame if possible, and will
+ * otherwise be freed. In either case, the plan may not be used further by the
+ * caller.
  *
  * @param plan
- *     The plan to free.
+ *     The plan to release.
  */
 void guac_display_plan_free(guac_display_plan* plan);
 
@@ -341,6 +452,37 @@ void guac_display_plan_free(guac_display_plan* plan);
  */
 void PFR_guac_display_plan_rewrite_as_rects(guac_display_plan* plan);
 
+/**
+ * Walks through all operations currently in the given guac_display_plan,
+ * replacing draw operations with simple copies wherever draws are covered by
+ * an explicit copy hint provided via
+ * guac_display_layer_raw_context_hint_copy() and the hinted source region of
+ * the previous frame truly contains the data being drawn. Unlike the
+ * hash-based search performed by guac_display_plan_rewrite_as_copies(), this
+ * pass requires no searching and is not restricted to cell-aligned regions,
+ * and should therefore be applied first.
+ *
+ * @param plan
+ *     The guac_display_plan to modify.
+ */
+void PFR_LFR_guac_display_plan_apply_copy_hints(guac_display_plan* plan);
+
+/**
+ * Detects vertical shifts (scrolls) of content between the previous and
+ * pending frames of each layer of the given guac_display_plan, replacing draw
+ * operations with simple copies wherever the shifted region of the previous
+ * frame truly contains the data being drawn. Unlike the hash-based search
+ * performed by guac_display_plan_rewrite_as_copies(), which matches only
+ * fully-covered 64x64 cells, detection here hashes entire rows of the changed
+ * column strip and is therefore effective for regions of any width,
+ * including the tall, narrow scrolls typical of terminal sessions whose
+ * protocol provides no copy hints.
+ *
+ * @param plan
+ *     The guac_display_plan to modify.
+ */
+void PFR_LFR_guac_display_plan_detect_scrolls(guac_display_plan* plan);
+
 /**
  * Walks through all operations currently in the given guac_display_plan,
  * storing the hashes of each outstanding draw operation within ops_by_hash.
@@ -364,6 +506,63 @@ void PFR_guac_display_plan_index_dirty_cells(guac_display_plan* plan);
  */
 void PFR_LFR_guac_display_plan_rewrite_as_copies(guac_display_plan* plan);
 
+/**
+ * Walks through all operations currently in the given guac_display_plan,
+ * replacing draw operations with copies from the client-side tile cache
+ * wherever the content being drawn is identical to a previously-cached tile.
+ * The display plan must first be indexed by
+ * guac_display_plan_index_dirty_cells(), as the content hashes calculated
+ * during indexing are used to locate matching tiles.
+ *
+ * @param plan
+ *     The guac_display_plan to modify.
+ */
+void PFR_guac_display_plan_recall_cached_tiles(guac_display_plan* plan);
+
+/**
+ * Stores the tile drawn by the given operation within the client-side tile
+ * cache of the given display, if that operation is eligible for caching
+ * (draws of hashed, cell-aligned content within opaque layers). A copy
+ * instruction persisting the freshly-drawn tile into the tile cache buffer
+ * is sent to connected users, and must therefore be sent after the image
+ * data of the operation itself. If the cache is full and no sufficiently old
+ * entry can be evicted, the tile is simply not cached.
+ *
+ * @param display
+ *     The display whose tile cache should receive the drawn tile.
+ *
+ * @param op
+ *     The draw operation that was just performed.
+ */
+void LFR_guac_display_plan_cache_tile(guac_display* display,
+        const guac_display_plan_operation* op);
+
+/**
+ * Replaces any draw operations targeting the mouse cursor within the given
+ * guac_display_plan with a single copy from the client-side cursor cache,
+ * if the pending cursor image is identical to a previously-cached cursor.
+ * Applications commonly toggle between a small set of cursors, and recalling
+ * those images from the cache avoids re-encoding and resending them.
+ *
+ * @param plan
+ *     The guac_display_plan to modify.
+ */
+void PFR_guac_display_plan_recall_cached_cursor(guac_display_plan* plan);
+
+/**
+ * Stores the current cursor image of the given display within the client-side
+ * cursor cache, if that image fits within a cache slot. Instructions
+ * persisting the cursor image into the cursor cache buffer are sent to
+ * connected users, and must therefore be sent after the image data of the
+ * cursor update itself. If the image is already cached, its position within
+ * the eviction order is simply refreshed. If the cache is full and no
+ * sufficiently old entry can be evicted, the image is simply not cached.
+ *
+ * @param display
+ *     The display whose cursor cache should receive the current cursor image.
+ */
+void LFR_guac_display_cursor_cache_store(guac_display* display);
+
 /**
  * Walks through all operations currently in the given guac_display_plan,
  * combining horizontally-adjacent operations wherever doing so appears to be
@@ -384,6 +583,18 @@ void PFW_guac_display_plan_combine_horizontally(guac_display_plan* plan);
  */
 void PFW_guac_display_plan_combine_vertically(guac_display_plan* plan);
 
+/**
+ * Sorts all operations currently in the given guac_display_plan by ascending
+ * distance from the current position of the mouse cursor, such that regions
+ * near the cursor are encoded and sent before more distant regions. The
+ * trailing end-of-frame operation is unaffected and remains the final
+ * operation of the plan.
+ *
+ * @param plan
+ *     The guac_display_plan to sort.
+ */
+void PFR_guac_display_plan_prioritize(guac_display_plan* plan);
+
 /**
  * Enqueues all operations from the given plan within the operation FIFO used
  * by the worker threads of the display associated with that plan. The
@@ -21,6 +21,7 @@
 #define GUAC_DISPLAY_PRIV_H
 
 #include "display-plan.h"
+#include "guacamole/align.h"
 #include "guacamole/client.h"
 #include "guacamole/display.h"
 #include "guacamole/fifo.h"
@@ -115,12 +116,135 @@
  */
 #define GUAC_DISPLAY_CELL_SIZE_EXPONENT 6
 
+/**
+ * The number of entries within the table used to index the rows of the
+ * previous frame by their content hashes during vertical shift (scroll)
+ * detection. This value MUST be a power of two and must be at least
+ * GUAC_DISPLAY_MAX_HEIGHT to keep the collision rate low.
+ */
+#define GUAC_DISPLAY_SCROLL_ROW_INDEX_SIZE 16384
+
+/**
+ * The minimum number of rows that must agree on the same vertical shift for
+ * that shift to be accepted as a scroll by vertical shift (scroll) detection.
+ * Smaller shifted regions are cheap enough to send as image data that the
+ * scroll optimization is not worthwhile.
+ */
+#define GUAC_DISPLAY_SCROLL_MIN_MATCHED_ROWS 16
+
+/**
+ * The number of columns of tile slots within the client-side tile cache
+ * buffer. Each slot is GUAC_DISPLAY_CELL_SIZE pixels on each side.
+ */
+#define GUAC_DISPLAY_TILE_CACHE_COLUMNS 16
+
+/**
+ * The number of rows of tile slots within the client-side tile cache buffer.
+ */
+#define GUAC_DISPLAY_TILE_CACHE_ROWS 8
+
+/**
+ * The total number of tile slots within the client-side tile cache buffer.
+ */
+#define GUAC_DISPLAY_TILE_CACHE_SIZE \
+    (GUAC_DISPLAY_TILE_CACHE_COLUMNS * GUAC_DISPLAY_TILE_CACHE_ROWS)
+
+/**
+ * The number of bytes in each row of the server-side mirror of the
+ * client-side tile cache buffer.
+ */
+#define GUAC_DISPLAY_TILE_CACHE_STRIDE \
+    (GUAC_DISPLAY_TILE_CACHE_COLUMNS * GUAC_DISPLAY_CELL_SIZE * 4)
+
+/**
+ * The minimum amount of time that must have elapsed since a tile cache entry
+ * was last used before that entry may be evicted to make room for a new
+ * tile, in milliseconds. This both avoids evicting entries that may still be
+ * referenced by copy operations of recently-planned frames and naturally
+ * limits cache churn to tiles that persist over time.
+ */
+#define GUAC_DISPLAY_TILE_CACHE_MIN_IDLE_AGE 1000
+
+/**
+ * The number of previously-sent cursor images retained within the client-side
+ * cursor cache buffer. Applications commonly toggle between a small set of
+ * cursors (pointer, I-beam, resize handles), and retaining those images
+ * client-side allows such toggles to be performed with a single copy rather
+ * than re-encoding and resending the cursor image.
+ */
+#define GUAC_DISPLAY_CURSOR_CACHE_SIZE 8
+
+/**
+ * The length of each side of a slot within the client-side cursor cache
+ * buffer, in pixels. Cursor images with any dimension exceeding this size
+ * simply bypass the cache.
+ */
+#define GUAC_DISPLAY_CURSOR_CACHE_SLOT_SIZE 64
+
+/**
+ * The number of bytes in each row of the server-side mirror of the
+ * client-side cursor cache buffer. Slots are arranged in a single horizontal
+ * row.
+ */
+#define GUAC_DISPLAY_CURSOR_CACHE_STRIDE \
+    (GUAC_DISPLAY_CURSOR_CACHE_SIZE * GUAC_DISPLAY_CURSOR_CACHE_SLOT_SIZE * 4)
+
+/**
+ * The lowest quality that will be used for lossy (JPEG/WebP) encoding,
+ * regardless of how constrained the connection appears to be.
+ */
+#define GUAC_DISPLAY_QUALITY_MIN 30
+
+/**
+ * The highest quality that will be used for lossy (JPEG/WebP) encoding.
+ */
+#define GUAC_DISPLAY_QUALITY_MAX 90
+
+/**
+ * The lossy (JPEG/WebP) encoding quality that newly-established connections
+ * start at. While TCP slow start is still probing the capacity of the
+ * connection, full-quality frames only deepen the initial backlog, so early
+ * frames are encoded aggressively and quality is ramped up as each completed
+ * flush proves the connection is keeping up.
+ */
+#define GUAC_DISPLAY_QUALITY_WARMUP_START 50
+
+/**
+ * The amount of time that must elapse without any frame activity before the
+ * reconstructible working memory of a display (cached frame encodings, the
+ * client-side tile and cursor caches, the spare plan retained between frames)
+ * is released, in milliseconds. Parked resources are rebuilt lazily and
+ * transparently by the paths that normally populate them, so parking trades a
+ * brief warm-up on the next frame for a much smaller resident footprint while
+ * a session sits idle overnight.
+ */
+#define GUAC_DISPLAY_PARK_TIMEOUT 300000
+
+/**
+ * The number of past updates recorded within each cell of a layer. The
+ * recorded history is used to determine the rate at which the region
+ * associated with a cell has been updating, averaged over the entire
+ * history rather than derived from any single pair of consecutive frames.
+ */
+#define GUAC_DISPLAY_CELL_HISTORY_SIZE 5
+
 /**
  * The amount that the width/height of internal storage for graphical data
  * should be rounded up to avoid unnecessary reallocations and copying.
  */
 #define GUAC_DISPLAY_RESIZE_FACTOR 64
 
+/**
+ * The number of buckets used to track realized encoding cost by image update
+ * size. Each bucket covers all updates whose longer edge rounds up to a
+ * particular power of two, with the first bucket covering updates no larger
+ * than a single cell (GUAC_DISPLAY_CELL_SIZE) and the last covering updates
+ * at the largest size that combined updates are ever allowed to reach
+ * (GUAC_DISPLAY_COMBINED_SIZE_MAX).
+ */
+#define GUAC_DISPLAY_ENCODE_COST_BUCKETS \
+    (GUAC_DISPLAY_COMBINED_SIZE_MAX - GUAC_DISPLAY_CELL_SIZE_EXPONENT + 1)
+
 /**
  * Given the width (or height) of a layer in pixels, calculates the width (or
  * height) of that layer's pending_frame_cells array in cells.
@@ -151,6 +275,74 @@
                 / GUAC_DISPLAY_CELL_SIZE                                      \
                 * 8)
 
+/**
+ * The maximum number of jobs that the per-frame diff may be split into. Each
+ * job covers a horizontal band of cells within the dirty region of a layer.
+ * If a frame is so large or touches so many layers that more jobs than this
+ * would be required, the regions that cannot be covered by jobs are simply
+ * processed by the thread creating the plan, exactly as they would be if
+ * parallel processing of frame diffs were not available.
+ */
+#define GUAC_DISPLAY_MAX_DIFF_JOBS 64
+
+/**
+ * The minimum area of the dirty region of a layer, in pixels, for the diff of
+ * that region to be split across multiple threads. Comparing image data is
+ * fast relative to the cost of waking and coordinating threads, and small
+ * regions are better processed inline by the thread creating the plan.
+ */
+#define GUAC_DISPLAY_PARALLEL_DIFF_AREA (512 * 512)
+
+/**
+ * Produces the packed representation of a newly-published batch of diff jobs
+ * having the given total number of jobs, for storage within the diff_claims
+ * member of guac_display. The index portion of the packed value is zero.
+ */
+#define GUAC_DISPLAY_DIFF_CLAIM(total) (((uint64_t) (total)) << 48)
+
+/**
+ * Extracts the index of the claimed job from the given packed claim value
+ * (the value of the diff_claims member of guac_display prior to the atomic
+ * increment that performed the claim). The claim is valid only if this index
+ * is less than the total extracted from that same value.
+ */
+#define GUAC_DISPLAY_DIFF_CLAIM_INDEX(claim) \
+    ((int64_t) ((claim) & 0xFFFFFFFFFFFF))
+
+/**
+ * Extracts the total number of jobs in the relevant batch from the given
+ * packed claim value.
+ */
+#define GUAC_DISPLAY_DIFF_CLAIM_TOTAL(claim) \
+    ((int64_t) ((claim) >> 48))
+
+/**
+ * Bitwise flag set on the diff_state flag in guac_display when diff jobs are
+ * available for processing by diff worker threads.
+ */
+#define GUAC_DISPLAY_DIFF_STATE_JOBS_AVAILABLE 1
+
+/**
+ * Bitwise flag set on the diff_state flag in guac_display when all diff jobs
+ * of the current batch have been processed.
+ */
+#define GUAC_DISPLAY_DIFF_STATE_COMPLETE 2
+
+/**
+ * Bitwise flag set on the diff_state flag in guac_display when the diff
+ * worker threads should terminate.
+ */
+#define GUAC_DISPLAY_DIFF_STATE_STOPPING 4
+
+/**
+ * The maximum number of operations that a display worker thread will claim
+ * from the operation FIFO per acquisition of the FIFO's lock. Claiming
+ * operations in batches keeps the FIFO's lock from becoming a point of
+ * contention when a burst of dirty rectangles (such as from a full-screen
+ * video frame) is spread across all workers.
+ */
+#define GUAC_DISPLAY_WORKER_MAX_BATCH_SIZE 16
+
 /**
  * Returns the memory address of the given rectangle within the mutable image
  * buffer of the given guac_display_layer_state, where the upper-left corner of
@@ -269,6 +461,95 @@ struct guac_display_render_thread {
 
 };
 
+/**
+ * A single slot within the client-side tile cache, associating the content
+ * hash of a previously-sent 64x64 tile with the location of that tile within
+ * the client-side tile cache buffer (as dictated by the slot's position
+ * within the tile_cache array of guac_display).
+ */
+typedef struct guac_display_tile_cache_entry {
+
+    /**
+     * The content hash of the tile stored within this slot, as calculated by
+     * the hashing performed during display plan indexing.
+     */
+    uint64_t hash;
+
+    /**
+     * The time that the tile stored within this slot was last sent or
+     * recalled, or zero if this slot is unused. Slots are evicted in
+     * least-recently-used order.
+     */
+    guac_timestamp last_use;
+
+} guac_display_tile_cache_entry;
+
+/**
+ * A single slot within the client-side cursor cache, associating the content
+ * hash and dimensions of a previously-sent cursor image with the location of
+ * that image within the client-side cursor cache buffer (as dictated by the
+ * slot's position within the cursor_cache array of guac_display).
+ */
+typedef struct guac_display_cursor_cache_entry {
+
+    /**
+     * The content hash of the cursor image stored within this slot, covering
+     * the full width and height of that image.
+     */
+    uint64_t hash;
+
+    /**
+     * The width of the cursor image stored within this slot, in pixels.
+     */
+    int width;
+
+    /**
+     * The height of the cursor image stored within this slot, in pixels.
+     */
+    int height;
+
+    /**
+     * The time that the cursor image stored within this slot was last sent or
+     * recalled, or zero if this slot is unused. Slots are evicted in
+     * least-recently-used order.
+     */
+    guac_timestamp last_use;
+
+} guac_display_cursor_cache_entry;
+
+/**
+ * The realized cost of encoding the image updates within a single rect-size
+ * bucket, accumulated since cost measurements were last decayed. The per-pixel
+ * cost derived from these counters is what ultimately drives the adaptive
+ * per-display limit on the size of combined operations: if larger updates
+ * prove no more expensive per pixel than smaller updates, per-rectangle
+ * overhead is dominating and updates should combine further, while the
+ * reverse indicates that the larger encodes themselves have become the
+ * bottleneck.
+ */
+typedef struct guac_display_encode_cost {
+
+    /**
+     * The number of image updates encoded within this bucket.
+     */
+    uint64_t rects;
+
+    /**
+     * The total number of pixels covered by the image updates encoded within
+     * this bucket.
+     */
+    uint64_t pixels;
+
+    /**
+     * The total amount of time spent encoding the image updates within this
+     * bucket, in milliseconds. Individual updates frequently encode in under
+     * a millisecond, so this value is meaningful only in aggregate, across
+     * the many updates accumulated between adjustments.
+     */
+    uint64_t duration_ms;
+
+} guac_display_encode_cost;
+
 /**
  * Approximation of how often a region of a layer is modified, as well as what
  * changes have been made to that region since the last frame. This information
@@ -279,10 +560,19 @@ struct guac_display_render_thread {
 typedef struct guac_display_layer_cell {
 
     /**
-     * The last time this particular cell was part of a frame (used to
-     * calculate framerate).
+     * Timestamps of each of the last GUAC_DISPLAY_CELL_HISTORY_SIZE frames
+     * that included changes to this cell, used to calculate the rate at
+     * which this cell has been updating. This array is structured as a ring
+     * buffer containing entries in chronologically-ascending order, starting
+     * at the entry pointed to by oldest_entry and wrapping around if the end
+     * of the array is reached.
      */
-    guac_timestamp last_frame;
+    guac_timestamp history[GUAC_DISPLAY_CELL_HISTORY_SIZE];
+
+    /**
+     * Index of the oldest entry within the history.
+     */
+    int oldest_entry;
 
     /**
      * The region of this cell that has been modified since the last frame was
@@ -297,6 +587,14 @@ typedef struct guac_display_layer_cell {
      */
     size_t dirty_size;
 
+    /**
+     * Non-zero if a caller-reported modification has intersected this cell
+     * since changes were last searched for, zero otherwise. Cells that have
+     * not been touched need not be compared against the last frame, even if
+     * they lie within the bounding dirty rect of the layer.
+     */
+    int touched;
+
     /**
      * The display plan operation that is associated with this cell. If a
      * display plan is not currently being created or optimized, this will be
@@ -423,12 +721,36 @@ typedef struct guac_display_layer_state {
      */
     guac_rect dirty;
 
+    /**
+     * The rectangular region of this layer whose processing was deferred
+     * during the current flush because that region is entirely hidden behind
+     * opaque layers. This region is carried back into the dirty rect once the
+     * frame is complete, such that it is re-examined (and finally sent, if
+     * revealed) as part of future frames. Only applicable to the pending
+     * frame, and only between the occlusion culling pass and completion of
+     * the frame being flushed.
+     */
+    guac_rect occluded_dirty;
+
     /**
      * Whether this layer should be searched for possible scroll/copy
      * optimizations.
      */
     int search_for_copies;
 
+    /**
+     * Explicit hints describing regions of this layer whose contents were
+     * copied from other regions of this same layer, as reported by the code
+     * drawing to the layer. Only applicable to the pending frame.
+     */
+    guac_display_copy_hint copy_hints[GUAC_DISPLAY_MAX_COPY_HINTS];
+
+    /**
+     * The number of explicit copy hints currently stored within copy_hints.
+     * Only applicable to the pending frame.
+     */
+    int num_copy_hints;
+
     /* ---------------- LAYER LIST POINTERS ---------------- */
 
     /**
@@ -468,6 +790,33 @@ struct guac_display_layer {
      */
     int opaque;
 
+    /**
+     * The type of graphical content expected to be drawn to this layer, one
+     * of the GUAC_DISPLAY_CONTENT_HINT_* constants. Layers with an explicit
+     * hint have their encoding strategy pinned accordingly; layers without
+     * (the default) are classified by sampling their image data. This value
+     * is typically set only during connection setup and may safely be read
+     * without acquiring the overall layer lock.
+     */
+    int content_hint;
+
+    /**
+     * Whether content sampling most recently classified this layer as better
+     * served by lossless PNG encoding. Meaningful only if content_classified
+     * is non-zero. This value is read and updated only by display worker
+     * threads; concurrent updates are benign (the classification is simply
+     * refreshed more than once).
+     */
+    int content_png_optimal;
+
+    /**
+     * The time at which this layer's content was last classified by sampling
+     * its image data, or zero if the layer's content has never been
+     * classified (or a newly-set content hint has invalidated the previous
+     * classification).
+     */
+    guac_timestamp content_classified;
+
     /* ---------------- LAYER PREVIOUS FRAME STATE ---------------- */
 
     /**
@@ -495,6 +844,53 @@ struct guac_display_layer {
      */
     guac_layer* last_frame_buffer;
 
+    /**
+     * Cached PNG encoding of the visible bounds of last_frame, used to
+     * synchronize layer contents to late-joining users without re-encoding
+     * the layer for each join. NULL if no cached encoding is currently
+     * available. This cache is populated lazily by guac_display_dup() and
+     * freed (invalidated) whenever the contents or dimensions of last_frame
+     * change.
+     *
+     * IMPORTANT: The display-level last_frame.lock MUST be acquired before
+     * modifying or reading this member. guac_display_dup() additionally
+     * holds the render_state lock while populating this cache, which
+     * excludes concurrent population attempts (frame flushes, and thus
+     * invalidation, cannot occur while that lock is held).
+     */
+    unsigned char* last_frame_png;
+
+    /**
+     * The number of bytes within last_frame_png, if last_frame_png is
+     * non-NULL.
+     *
+     * IMPORTANT: The display-level last_frame.lock MUST be acquired before
+     * modifying or reading this member.
+     */
+    size_t last_frame_png_size;
+
+    /**
+     * The region of last_frame that may have most recently been sent using
+     * lossy encoding. Once this region has remained unchanged for long enough
+     * (and the connection is keeping up), it is re-encoded losslessly, such
+     * that regions that have stopped updating do not remain at reduced
+     * quality indefinitely.
+     *
+     * IMPORTANT: The display-level last_frame.lock MUST be acquired before
+     * modifying or reading this member.
+     */
+    guac_rect lossy_dirty;
+
+    /**
+     * The time that lossy_dirty last grew. Lossless refinement of the
+     * recorded region is considered only once this time is sufficiently far
+     * in the past (the region has stabilized).
+     *
+     * IMPORTANT: The display-level last_frame.lock MUST be acquired before
+     * modifying or reading this member.
+     */
+    guac_timestamp lossy_dirty_time;
+
     /* ---------------- LAYER PENDING FRAME STATE ---------------- */
 
     /**
@@ -654,19 +1050,39 @@ struct guac_display {
      */
     guac_client* client;
 
+    /**
+     * Write-only socket which broadcasts instructions to the subset of
+     * connected users that support WebP. When connected users are split in
+     * their WebP support, frequently-updating regions are encoded once per
+     * capability tier (WebP for this socket, JPEG/PNG for non_webp_socket)
+     * rather than forcing the lowest common denominator on all users.
+     */
+    guac_socket* webp_socket;
+
+    /**
+     * Write-only socket which broadcasts instructions to the subset of
+     * connected users that do not support WebP.
+     *
+     * @see webp_socket
+     */
+    guac_socket* non_webp_socket;
+
     /* ---------------- DISPLAY FRAME STATES ---------------- */
 
     /**
      * The state of this display at the time the last frame was sent to
-     * connected users.
+     * connected users. This member is kept on its own cache line, as worker
+     * threads constantly acquire its lock while encoding and would otherwise
+     * contend with threads manipulating the pending frame.
      */
-    guac_display_state last_frame;
+    guac_display_state last_frame GUAC_ALIGNED_CACHE_LINE;
 
     /**
      * The pending state of this display that will become the next frame once
-     * it is sent to connected users.
+     * it is sent to connected users. This member is kept on its own cache
+     * line for the same reason as last_frame.
      */
-    guac_display_state pending_frame;
+    guac_display_state pending_frame GUAC_ALIGNED_CACHE_LINE;
 
     /**
      * Whether the pending frame has been modified in any way outside of
@@ -695,6 +1111,95 @@ struct guac_display {
      */
     guac_display_layer* cursor_buffer;
 
+    /* ---------------- CLIENT-SIDE TILE CACHE ---------------- */
+
+    /**
+     * Client-side buffer storing copies of recently-sent 64x64 tiles,
+     * arranged as a grid of GUAC_DISPLAY_TILE_CACHE_COLUMNS x
+     * GUAC_DISPLAY_TILE_CACHE_ROWS slots. Draws whose content matches a
+     * cached tile are rewritten as copies from this buffer, avoiding
+     * re-encoding and re-sending image data for content that reappears
+     * (menus, toolbars, etc.). Unlike the per-layer last_frame_buffer, the
+     * contents of this buffer persist beyond the most recent frame.
+     *
+     * NOTE: This value is set only during allocation and may safely be
+     * accessed without acquiring tile_cache_lock.
+     */
+    guac_layer* tile_cache_buffer;
+
+    /**
+     * Server-side mirror of the image contents of tile_cache_buffer, with
+     * rows of GUAC_DISPLAY_TILE_CACHE_STRIDE bytes. This mirror is used to
+     * verify that a hash match is not a collision before rewriting a draw as
+     * a copy, and to synchronize the tile cache to late-joining users.
+     *
+     * IMPORTANT: tile_cache_lock MUST be acquired before modifying or
+     * reading this member.
+     */
+    unsigned char* tile_cache_data;
+
+    /**
+     * All slots of the client-side tile cache, where the position of each
+     * slot within this array dictates the location of the corresponding tile
+     * within tile_cache_buffer.
+     *
+     * IMPORTANT: tile_cache_lock MUST be acquired before modifying or
+     * reading this member.
+     */
+    guac_display_tile_cache_entry tile_cache[GUAC_DISPLAY_TILE_CACHE_SIZE];
+
+    /**
+     * Lock that guards concurrent access to the tile cache. This lock must
+     * be acquired only while holding no other display lock or while
+     * following the established display lock acquisition order (the tile
+     * cache is accessed both by the thread planning a frame and by the
+     * worker threads encoding that frame).
+     */
+    pthread_mutex_t tile_cache_lock;
+
+    /* ---------------- CLIENT-SIDE CURSOR CACHE ---------------- */
+
+    /**
+     * Client-side buffer storing copies of recently-sent cursor images,
+     * arranged as a single row of GUAC_DISPLAY_CURSOR_CACHE_SIZE slots.
+     * Cursor updates whose content matches a cached image are rewritten as
+     * copies from this buffer, so applications toggling between a small set
+     * of cursors do not repeatedly re-encode and resend the same images.
+     *
+     * NOTE: This value is set only during allocation and may safely be
+     * accessed without acquiring cursor_cache_lock.
+     */
+    guac_layer* cursor_cache_buffer;
+
+    /**
+     * Server-side mirror of the image contents of cursor_cache_buffer, with
+     * rows of GUAC_DISPLAY_CURSOR_CACHE_STRIDE bytes. This mirror is used to
+     * verify that a hash match is not a collision before rewriting a cursor
+     * update as a copy, and to synchronize the cursor cache to late-joining
+     * users.
+     *
+     * IMPORTANT: cursor_cache_lock MUST be acquired before modifying or
+     * reading this member.
+     */
+    unsigned char* cursor_cache_data;
+
+    /**
+     * All slots of the client-side cursor cache, where the position of each
+     * slot within this array dictates the location of the corresponding
+     * cursor image within cursor_cache_buffer.
+     *
+     * IMPORTANT: cursor_cache_lock MUST be acquired before modifying or
+     * reading this member.
+     */
+    guac_display_cursor_cache_entry cursor_cache[GUAC_DISPLAY_CURSOR_CACHE_SIZE];
+
+    /**
+     * Lock that guards concurrent access to the cursor cache (the cache is
+     * accessed both by the thread planning a frame and by the worker thread
+     * that finalizes that frame).
+     */
+    pthread_mutex_t cursor_cache_lock;
+
     /* ---------------- FRAME ENCODING WORKER THREADS ---------------- */
 
     /**
@@ -712,9 +1217,11 @@ struct guac_display {
      * FIFO of all graphical operations required to transform the remote
      * display state from the previous frame to the next frame. Operations
      * added to this FIFO will automatically be pulled and processed by a
-     * worker thread.
+     * worker thread. This member is kept on its own cache line, as it is the
+     * busiest producer/consumer edge of the display and would otherwise
+     * falsely share a line with the cold members preceding it.
      */
-    guac_fifo ops;
+    guac_fifo ops GUAC_ALIGNED_CACHE_LINE;
 
     /**
      * Storage for any items within the ops fifo.
@@ -739,14 +1246,234 @@ struct guac_display {
      */
     int frame_deferred;
 
+    /**
+     * The plan used to render the most recently completed frame, if that plan
+     * has since been released and is available for reuse, or NULL if no such
+     * plan is available. Plans are large structures that would otherwise be
+     * allocated and freed with each rendered frame, and are instead retained
+     * here and reused wherever possible.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the ops
+     * FIFO is locked.
+     */
+    guac_display_plan* spare_plan;
+
+    /**
+     * The zlib compression level that should be used when encoding PNG
+     * images for this display, or -1 if the libpng default should be used.
+     */
+    int png_compression_level;
+
+    /**
+     * Cumulative rendering statistics for this display, as exposed to users
+     * of the guac_display API through guac_display_get_stats().
+     *
+     * IMPORTANT: This member must only be accessed or modified while the ops
+     * FIFO is locked.
+     */
+    guac_display_stats stats;
+
+    /**
+     * The timestamp of the most recent summary of rendering statistics
+     * logged at the "debug" log level, or zero if no summary has yet been
+     * logged.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the ops
+     * FIFO is locked.
+     */
+    guac_timestamp stats_logged;
+
+    /**
+     * The ID of the frame currently in flight (dispatched to the worker
+     * threads but not yet flushed), for the purposes of per-frame trace
+     * output. Frame IDs increase monotonically from 1 as frames are
+     * dispatched.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the ops
+     * FIFO is locked.
+     */
+    uint64_t frame_trace_id;
+
+    /**
+     * The time that an end-of-frame request was first received via
+     * guac_display_end_frame(), guac_display_end_mouse_frame(), etc. for the
+     * frame that has not yet been dispatched, or zero if no end-of-frame
+     * request is pending. Requests that arrive while an earlier frame is
+     * still being encoded retain their original timestamp, such that time
+     * spent deferred is visible in trace output.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the ops
+     * FIFO is locked.
+     */
+    guac_timestamp frame_trace_requested;
+
+    /**
+     * The time that the end of the frame currently in flight was first
+     * requested (the value of frame_trace_requested when the frame was
+     * dispatched). This is the start of the frame's overall trace span.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the ops
+     * FIFO is locked.
+     */
+    guac_timestamp frame_trace_start;
+
+    /**
+     * The time that planning of the frame currently in flight began.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the ops
+     * FIFO is locked.
+     */
+    guac_timestamp frame_trace_plan_start;
+
+    /**
+     * The time that the frame currently in flight finished planning and was
+     * dispatched to the worker threads for encoding.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the ops
+     * FIFO is locked.
+     */
+    guac_timestamp frame_trace_dispatched;
+
+    /**
+     * The realized cost of encoding image updates, by update size. These
+     * counters are periodically decayed so that the derived per-pixel costs
+     * track the session's current workload rather than its entire history.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the ops
+     * FIFO is locked.
+     */
+    guac_display_encode_cost encode_cost[GUAC_DISPLAY_ENCODE_COST_BUCKETS];
+
+    /**
+     * The current maximum width or height to allow when combining any pair of
+     * rendering operations into a single operation, in pixels, as the
+     * exponent of a power of two. This value is periodically adjusted between
+     * GUAC_DISPLAY_COMBINED_SIZE_MIN and GUAC_DISPLAY_COMBINED_SIZE_MAX
+     * according to the per-pixel encoding costs accumulated within
+     * encode_cost, growing while larger updates prove as cheap per pixel as
+     * smaller ones and shrinking while they prove markedly more expensive.
+     *
+     * This member is written only while the ops FIFO is locked and is read
+     * without locking by the thread combining operations within a plan (a
+     * stale value merely applies the previous limit to one more frame).
+     */
+    int max_combined_size;
+
+    /**
+     * The time that max_combined_size was last considered for adjustment,
+     * regardless of whether an adjustment was actually made.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the ops
+     * FIFO is locked.
+     */
+    guac_timestamp combined_size_adjusted;
+
+    /**
+     * The current baseline quality for lossy (JPEG/WebP) encoding, between
+     * GUAC_DISPLAY_QUALITY_MIN and GUAC_DISPLAY_QUALITY_MAX inclusive. This
+     * value is continuously adjusted by the worker thread that finalizes each
+     * frame, backing off quickly when the measured time spent flushing to
+     * connected users (or the client-reported processing lag) indicates that
+     * the connection cannot absorb the current quality, and recovering
+     * gradually while the connection is keeping up.
+     *
+     * This member is written only by the single worker thread finalizing a
+     * frame and is read without locking by the workers encoding image data (a
+     * stale value merely delays an adjustment by one frame).
+     */
+    int lossy_quality;
+
+    /**
+     * Non-zero if the connection is still within its initial warm-up period,
+     * during which lossy_quality ramps upward from
+     * GUAC_DISPLAY_QUALITY_WARMUP_START as completed flushes prove the
+     * connection can keep up. The warm-up ends once quality reaches
+     * GUAC_DISPLAY_QUALITY_MAX or at the first sign of congestion, whichever
+     * comes first. This member is accessed only by the single worker thread
+     * finalizing a frame.
+     */
+    int warming_up;
+
+    /**
+     * The time that the flush of the most recently completed frame finished,
+     * used to measure the interval between consecutive frames when adjusting
+     * lossy_quality. This member is accessed only by the single worker thread
+     * finalizing a frame.
+     */
+    guac_timestamp last_flush_end;
+
+    /**
+     * The time that lossy_quality was last adjusted in either direction. This
+     * member is accessed only by the single worker thread finalizing a frame.
+     */
+    guac_timestamp lossy_quality_adjusted;
+
     /**
      * The current state of the rendering process. Code that needs to be aware
      * of whether a frame is currently in the process of being rendered can
      * monitor the state of this flag, watching for either the
      * GUAC_DISPLAY_RENDER_STATE_FRAME_IN_PROGRESS or
-     * GUAC_DISPLAY_RENDER_STATE_FRAME_NOT_IN_PROGRESS values.
+     * GUAC_DISPLAY_RENDER_STATE_FRAME_NOT_IN_PROGRESS values. This member is
+     * kept on its own cache line, as it is flagged by every worker batch and
+     * would otherwise contend with the statistics members preceding it.
+     */
+    guac_flag render_state GUAC_ALIGNED_CACHE_LINE;
+
+    /* ---------------- FRAME DIFF WORKER THREADS ---------------- */
+
+    /**
+     * The number of diff worker threads in the diff_threads array. This may
+     * be zero, in which case all frame diffs are processed entirely by the
+     * thread creating the plan.
+     */
+    int diff_thread_count;
+
+    /**
+     * Pool of worker threads that assist with comparing the pending frame
+     * against the last frame whenever the region to be compared is large
+     * enough to be worth splitting across threads. These threads sleep except
+     * while a plan is being created.
+     */
+    pthread_t* diff_threads;
+
+    /**
+     * The current state of the frame diff process, as a combination of the
+     * GUAC_DISPLAY_DIFF_STATE_* flags. Diff worker threads sleep on this flag
+     * until jobs are available (or until the display is being freed), and the
+     * thread creating a plan sleeps on this flag until all jobs of the
+     * current batch have completed.
      */
-    guac_flag render_state;
+    guac_flag diff_state;
+
+    /**
+     * The jobs making up the current batch of frame diff work. Only the
+     * first diff_total_jobs entries are valid. This array is written only by
+     * the thread creating a plan, and only while no batch is in progress.
+     */
+    guac_display_plan_diff_job diff_jobs[GUAC_DISPLAY_MAX_DIFF_JOBS];
+
+    /**
+     * The total number of jobs in the current batch and the index of the next
+     * job to be claimed, packed into a single value as described by the
+     * GUAC_DISPLAY_DIFF_CLAIM* macros. Jobs are claimed by atomically
+     * incrementing the index portion of this value, with claims being valid
+     * only if the index obtained is less than the total packed into that same
+     * value. Packing both quantities into one atomically-updated value
+     * guarantees that a thread claiming a job has observed the batch that job
+     * belongs to in its entirety, even if that thread started searching for
+     * work before the batch was published (a new batch is only ever published
+     * after the index of the previous batch has permanently exceeded its
+     * total).
+     */
+    uint64_t diff_claims;
+
+    /**
+     * The number of jobs in the current batch that have not yet finished
+     * processing. This member is accessed and modified using atomic
+     * operations. The thread that decrements this value to zero sets the
+     * GUAC_DISPLAY_DIFF_STATE_COMPLETE flag on diff_state.
+     */
+    int diff_remaining_jobs;
 
 };
 
@@ -797,6 +1524,65 @@ void guac_display_remove_layer(guac_display_layer* display_layer);
 void PFW_guac_display_layer_resize(guac_display_layer* layer,
         int width, int height);
 
+/**
+ * Resizes the given layer to the given dimensions, including any underlying
+ * image buffers, using an image buffer that was allocated in advance by the
+ * caller (before acquiring the display lock) as the replacement buffer if
+ * possible. Allocating and pre-faulting the replacement buffer outside the
+ * lock keeps the locked portion of large resizes down to a single memcpy,
+ * rather than stalling all rendering on allocation and page faults.
+ *
+ * If the prepared buffer does not match the dimensions actually required
+ * (such as if another thread has resized the layer in the interim), or if no
+ * replacement buffer turns out to be necessary, ownership of the prepared
+ * buffer is still taken by this function and it is freed.
+ *
+ * @param layer
+ *     The layer to resize.
+ *
+ * @param width
+ *     The new width, in pixels.
+ *
+ * @param height
+ *     The new height, in pixels.
+ *
+ * @param prepared
+ *     A buffer allocated in advance by the caller for use as the replacement
+ *     image buffer, or NULL if no buffer was prepared.
+ *
+ * @param prepared_width
+ *     The width of the prepared buffer, in pixels.
+ *
+ * @param prepared_height
+ *     The height of the prepared buffer, in pixels.
+ *
+ * @param prepared_stride
+ *     The number of bytes in each row of image data in the prepared buffer.
+ */
+void PFW_guac_display_layer_resize_prepared(guac_display_layer* layer,
+        int width, int height, unsigned char* prepared,
+        int prepared_width, int prepared_height, int prepared_stride);
+
+/**
+ * Releases memory held by the given display that exists purely to accelerate
+ * future frames and can be reconstructed on demand, reducing the resident
+ * footprint of a session that has gone idle. This currently includes the
+ * cached PNG encodings of each layer's last frame (rebuilt lazily by
+ * guac_display_dup()), the spare plan retained for reuse between frames, and
+ * the server-side mirrors of the client-side tile and cursor caches (whose
+ * entries are invalidated, causing the caches to simply repopulate with
+ * use). The displayed frame itself is unaffected, and no instructions are
+ * sent to connected clients.
+ *
+ * This function is safe to call at any time and from any thread, including
+ * repeatedly, though it is only useful when the display is expected to remain
+ * idle for some time.
+ *
+ * @param display
+ *     The display whose reconstructible working memory should be released.
+ */
+void guac_display_park(guac_display* display);
+
 /**
  * Worker thread that continuously pulls operations from the operation FIFO of
  * the given guac_display, applying those operations by seding corresponding
@@ -810,4 +1596,20 @@ void PFW_guac_display_layer_resize(guac_display_layer* layer,
  */
 void* guac_display_worker_thread(void* data);
 
+/**
+ * Worker thread that assists with comparing the pending frame of the given
+ * guac_display against the last frame. Threads running this function sleep
+ * until a batch of diff jobs is published via the diff_state flag of the
+ * display, claim and process as many of those jobs as possible, and then
+ * return to sleep. The thread terminates when the
+ * GUAC_DISPLAY_DIFF_STATE_STOPPING flag is set.
+ *
+ * @param data
+ *     A pointer to the guac_display.
+ *
+ * @return
+ *     Always NULL.
+ */
+void* guac_display_diff_worker_thread(void* data);
+
 #endif
@@ -65,11 +65,17 @@ static void* guac_display_render_loop(void* data) {
 
     for (;;) {
 
-        /* Wait indefinitely for any change to the frame state */
-        guac_flag_wait_and_lock(&render_thread->state,
+        /* Wait for any change to the frame state, releasing working memory
+         * that exists only to accelerate future frames (and that will be
+         * rebuilt transparently on demand) if the session sits idle long
+         * enough. There is no benefit to keeping caches of recently-sent
+         * content resident while a session renders nothing overnight */
+        while (!guac_flag_timedwait_and_lock(&render_thread->state,
                   GUAC_DISPLAY_RENDER_THREAD_STATE_STOPPING
                 | GUAC_DISPLAY_RENDER_THREAD_STATE_FRAME_READY
-                | GUAC_DISPLAY_RENDER_THREAD_STATE_FRAME_MODIFIED);
+                | GUAC_DISPLAY_RENDER_THREAD_STATE_FRAME_MODIFIED,
+                GUAC_DISPLAY_PARK_TIMEOUT))
+            guac_display_park(display);
 
         /* Bail out immediately upon upcoming disconnect */
         if (render_thread->state.value & GUAC_DISPLAY_RENDER_THREAD_STATE_STOPPING) {
@@ -79,6 +85,16 @@ static void* guac_display_render_loop(void* data) {
 
         int rendered_frames = 0;
 
+        /* Pace frame generation according to how far behind connected clients
+         * are in processing the frames they have already received (as measured
+         * via their "sync" responses). There is no benefit to spending CPU
+         * planning and encoding frames faster than any receiver will consume
+         * them. Clients that are keeping up have negligible processing lag and
+         * are unaffected by this. */
+        int target_duration = guac_client_get_processing_lag(display->client);
+        if (target_duration > GUAC_DISPLAY_RENDER_THREAD_MAX_FRAME_DURATION)
+            target_duration = GUAC_DISPLAY_RENDER_THREAD_MAX_FRAME_DURATION;
+
         /* Lacking explicit frame boundaries, handle the change in frame state,
          * continuing to accumulate frame modifications while still within
          * heuristically determined frame boundaries */
@@ -98,27 +114,47 @@ static void* guac_display_render_loop(void* data) {
             /* Use explicit frame boundaries whenever available */
             if (render_thread->state.value & GUAC_DISPLAY_RENDER_THREAD_STATE_FRAME_READY) {
 
-                rendered_frames = render_thread->frames;
+                rendered_frames += render_thread->frames;
                 render_thread->frames = 0;
 
                 guac_flag_clear(&render_thread->state,
                           GUAC_DISPLAY_RENDER_THREAD_STATE_FRAME_READY
                         | GUAC_DISPLAY_RENDER_THREAD_STATE_FRAME_MODIFIED);
+
+                /* Flush immediately if clients are consuming frames as fast
+                 * as they are produced */
+                if (frame_duration >= target_duration) {
+                    guac_flag_unlock(&render_thread->state);
+                    break;
+                }
+
+                /* Otherwise, continue accumulating source frames until the
+                 * target interval has elapsed, producing a single combined
+                 * frame that lagging clients can actually consume */
+                allowed_wait = target_duration - frame_duration;
                 guac_flag_unlock(&render_thread->state);
-                break;
 
             }
 
-            /* Do not exceed a reasonable maximum framerate without an
-             * explicit frame boundary terminating the frame early */
-            allowed_wait = GUAC_DISPLAY_RENDER_THREAD_MIN_FRAME_DURATION - frame_duration;
-            if (allowed_wait < 0)
-                allowed_wait = 0;
+            else {
 
-            /* Wait for further modifications or other changes to frame state */
+                /* Do not exceed a reasonable maximum framerate without an
+                 * explicit frame boundary terminating the frame early, nor
+                 * the rate that connected clients are consuming frames */
+                int min_duration = target_duration;
+                if (min_duration < GUAC_DISPLAY_RENDER_THREAD_MIN_FRAME_DURATION)
+                    min_duration = GUAC_DISPLAY_RENDER_THREAD_MIN_FRAME_DURATION;
 
-            guac_flag_clear(&render_thread->state, GUAC_DISPLAY_RENDER_THREAD_STATE_FRAME_MODIFIED);
-            guac_flag_unlock(&render_thread->state);
+                allowed_wait = min_duration - frame_duration;
+                if (allowed_wait < 0)
+                    allowed_wait = 0;
+
+                /* Wait for further modifications or other changes to frame state */
+
+                guac_flag_clear(&render_thread->state, GUAC_DISPLAY_RENDER_THREAD_STATE_FRAME_MODIFIED);
+                guac_flag_unlock(&render_thread->state);
+
+            }
 
         } while (guac_flag_timedwait_and_lock(&render_thread->state,
                       GUAC_DISPLAY_RENDER_THREAD_STATE_STOPPING
@@ -19,6 +19,7 @@
 
 #include "display-plan.h"
 #include "display-priv.h"
+#include "encode-png.h"
 #include "guacamole/client.h"
 #include "guacamole/display.h"
 #include "guacamole/fifo.h"
@@ -29,6 +30,7 @@
 #include "guacamole/rwlock.h"
 #include "guacamole/socket.h"
 #include "guacamole/timestamp.h"
+#include "guacamole/user.h"
 
 #include <inttypes.h>
 #include <limits.h>
@@ -114,36 +116,391 @@ static void guac_display_layer_clear_non_opaque(guac_display_layer* display_laye
 
 }
 
+/**
+ * Streams the contents of the given Cairo surface over the given socket as a
+ * PNG image drawn to the given location of the given layer. This is identical
+ * to guac_client_stream_png() except that the PNG compression level
+ * configured for the display is honored.
+ *
+ * @param display
+ *     The display that the image is being encoded for.
+ *
+ * @param socket
+ *     The socket over which the image should be streamed.
+ *
+ * @param layer
+ *     The destination layer.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the destination rect
+ *     within the destination layer.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the destination rect
+ *     within the destination layer.
+ *
+ * @param surface
+ *     The Cairo surface to stream as a PNG image.
+ */
+static void guac_display_stream_png(guac_display* display, guac_socket* socket,
+        const guac_layer* layer, int x, int y, cairo_surface_t* surface) {
+
+    guac_client* client = display->client;
+
+    /* Allocate new stream for image */
+    guac_stream* stream = guac_client_alloc_stream(client);
+
+    /* Declare stream as containing image data */
+    guac_protocol_send_img(socket, stream, GUAC_COMP_OVER, layer,
+            "image/png", x, y);
+
+    /* Write PNG data at the compression level configured for the display */
+    guac_png_write_level(socket, stream, surface,
+            display->png_compression_level);
+
+    /* Terminate stream */
+    guac_protocol_send_end(socket, stream);
+
+    /* Free allocated stream */
+    guac_client_free_stream(client, stream);
+
+}
+
+/**
+ * Adds the values of all statistics counters in the given source
+ * guac_display_stats to the corresponding counters in the given destination
+ * guac_display_stats. This allows worker threads to cheaply gather statistics
+ * in thread-local storage, folding those values into the overall display
+ * statistics only once per batch of operations.
+ *
+ * @param dest
+ *     The guac_display_stats to add the gathered values to.
+ *
+ * @param src
+ *     The guac_display_stats containing the values to add.
+ */
+static void guac_display_stats_add(guac_display_stats* dest,
+        const guac_display_stats* src) {
+
+    dest->frames             += src->frames;
+    dest->plan_duration_ms   += src->plan_duration_ms;
+    dest->png_rects          += src->png_rects;
+    dest->png_pixels         += src->png_pixels;
+    dest->jpeg_rects         += src->jpeg_rects;
+    dest->jpeg_pixels        += src->jpeg_pixels;
+    dest->webp_rects         += src->webp_rects;
+    dest->webp_pixels        += src->webp_pixels;
+    dest->expired_rects      += src->expired_rects;
+    dest->encode_duration_ms += src->encode_duration_ms;
+    dest->flush_duration_ms  += src->flush_duration_ms;
+
+}
+
+/**
+ * The minimum amount of time that must elapse between considerations of
+ * whether the per-display limit on the size of combined operations should be
+ * adjusted, in milliseconds.
+ */
+#define GUAC_DISPLAY_COMBINE_ADJUST_INTERVAL 5000
+
+/**
+ * The minimum number of pixels that must have been encoded within a rect-size
+ * bucket before the per-pixel cost derived from that bucket is considered
+ * meaningful. Encode durations are measured with millisecond resolution, so
+ * per-pixel costs are reliable only in aggregate.
+ */
+#define GUAC_DISPLAY_COMBINE_MIN_SAMPLE_PIXELS (512 * 1024)
+
+/**
+ * The factor by which the per-pixel cost of the largest images currently
+ * being produced must exceed the per-pixel cost of images half that size
+ * before the limit on the size of combined operations is reduced.
+ */
+#define GUAC_DISPLAY_COMBINE_INEFFICIENCY_FACTOR 2
+
+/**
+ * Returns the index of the rect-size bucket covering image updates of the
+ * given size. Each bucket covers all updates whose longer edge rounds up to a
+ * particular power of two, with updates no larger than a single cell landing
+ * in the first bucket.
+ *
+ * @param rect
+ *     The rect covered by the image update.
+ *
+ * @return
+ *     The index of the rect-size bucket covering image updates of the given
+ *     size, between 0 and GUAC_DISPLAY_ENCODE_COST_BUCKETS - 1 inclusive.
+ */
+static int guac_display_encode_cost_bucket(const guac_rect* rect) {
+
+    int size = guac_rect_width(rect);
+    int height = guac_rect_height(rect);
+    if (height > size)
+        size = height;
+
+    int exponent = GUAC_DISPLAY_CELL_SIZE_EXPONENT;
+    while (exponent < GUAC_DISPLAY_COMBINED_SIZE_MAX && (1 << exponent) < size)
+        exponent++;
+
+    return exponent - GUAC_DISPLAY_CELL_SIZE_EXPONENT;
+
+}
+
+/**
+ * Adjusts the limit on the size of combined operations for the given display
+ * based on the per-pixel encoding costs accumulated since costs were last
+ * decayed. If the largest images currently being produced encode no more
+ * expensively per pixel than images half their size, per-rectangle overhead
+ * is dominating and the limit is raised; if they encode markedly more
+ * expensively per pixel, the larger encodes themselves have become the
+ * bottleneck (undermining parallelism across the worker threads) and the
+ * limit is lowered. Workloads differ enormously here: large applications
+ * repainting wide regions benefit from far larger updates than the small,
+ * scattered updates typical of a terminal.
+ *
+ * The accumulated costs are exponentially decayed with each call, such that
+ * the derived per-pixel costs track the session's current workload.
+ *
+ * IMPORTANT: This function may only be called while the ops FIFO of the
+ * given display is locked.
+ *
+ * @param display
+ *     The display whose limit on the size of combined operations should be
+ *     adjusted.
+ */
+static void guac_display_adjust_combined_size(guac_display* display) {
+
+    int limit = display->max_combined_size;
+
+    /* Compare the realized cost of the largest images currently produced
+     * against the cost of images half that size */
+    guac_display_encode_cost* large =
+        &display->encode_cost[limit - GUAC_DISPLAY_CELL_SIZE_EXPONENT];
+    guac_display_encode_cost* small =
+        &display->encode_cost[limit - 1 - GUAC_DISPLAY_CELL_SIZE_EXPONENT];
+
+    /* Leave the limit untouched until both buckets contain enough samples
+     * for their per-pixel costs to be meaningful */
+    if (large->pixels >= GUAC_DISPLAY_COMBINE_MIN_SAMPLE_PIXELS
+            && small->pixels >= GUAC_DISPLAY_COMBINE_MIN_SAMPLE_PIXELS) {
+
+        uint64_t large_cost = large->duration_ms * 0x100000 / large->pixels;
+        uint64_t small_cost = small->duration_ms * 0x100000 / small->pixels;
+
+        /* Per-rectangle overhead dominates - combine further */
+        if (large_cost <= small_cost
+                && limit < GUAC_DISPLAY_COMBINED_SIZE_MAX)
+            display->max_combined_size = limit + 1;
+
+        /* Encoding cost dominates - back off toward smaller, more readily
+         * parallelized updates */
+        else if (large_cost > small_cost * GUAC_DISPLAY_COMBINE_INEFFICIENCY_FACTOR
+                && limit > GUAC_DISPLAY_COMBINED_SIZE_MIN)
+            display->max_combined_size = limit - 1;
+
+        if (display->max_combined_size != limit)
+            guac_client_log(display->client, GUAC_LOG_DEBUG, "Limit on "
+                    "combined update size is now %ix%i pixels (measured "
+                    "encoding cost was %" PRIu64 "ms vs. %" PRIu64 "ms "
+                    "per Mpx)", 1 << display->max_combined_size,
+                    1 << display->max_combined_size, large_cost, small_cost);
+
+    }
+
+    /* Decay accumulated costs so that future adjustments reflect the current
+     * workload rather than the entire session history */
+    for (int i = 0; i < GUAC_DISPLAY_ENCODE_COST_BUCKETS; i++) {
+        display->encode_cost[i].rects /= 2;
+        display->encode_cost[i].pixels /= 2;
+        display->encode_cost[i].duration_ms /= 2;
+    }
+
+}
+
+/**
+ * The portion of the interval between consecutive frames which, if exceeded
+ * by the time spent flushing the frame to connected users, indicates that the
+ * connection cannot absorb the current lossy quality. Expressed as the
+ * divisor of the frame interval (a value of 4 means flushing must consume
+ * more than a quarter of the frame interval before quality is reduced).
+ */
+#define GUAC_DISPLAY_QUALITY_FLUSH_BUSY_DIVISOR 4
+
+/**
+ * The portion of the interval between consecutive frames which, if NOT
+ * reached by the time spent flushing the frame to connected users, indicates
+ * that the connection is comfortably absorbing the current lossy quality.
+ * Expressed as the divisor of the frame interval.
+ */
+#define GUAC_DISPLAY_QUALITY_FLUSH_IDLE_DIVISOR 8
+
+/**
+ * The client-reported processing lag beyond which the baseline lossy quality
+ * is reduced, in milliseconds. Sustained lag indicates that frames are
+ * arriving (or being processed) more slowly than they are being produced.
+ */
+#define GUAC_DISPLAY_QUALITY_LAG_THRESHOLD 80
+
+/**
+ * The client-reported processing lag below which the baseline lossy quality
+ * may be allowed to recover, in milliseconds.
+ */
+#define GUAC_DISPLAY_QUALITY_LAG_HEALTHY 30
+
+/**
+ * The amount that the baseline lossy quality is reduced by each frame while
+ * the connection appears unable to keep up. Quality is reduced quickly, as
+ * each overly-large frame actively worsens the backlog.
+ */
+#define GUAC_DISPLAY_QUALITY_DECREASE 10
+
+/**
+ * The amount that the baseline lossy quality is increased by while the
+ * connection is keeping up. Quality recovers slowly, avoiding oscillation
+ * between qualities the connection can and cannot absorb.
+ */
+#define GUAC_DISPLAY_QUALITY_INCREASE 2
+
+/**
+ * The minimum amount of time that must elapse between adjustments that
+ * increase the baseline lossy quality, in milliseconds.
+ */
+#define GUAC_DISPLAY_QUALITY_INCREASE_INTERVAL 500
+
+/**
+ * The amount that the baseline lossy quality is increased by after each
+ * healthy flush during the initial warm-up period. The warm-up ramp is
+ * deliberately much steeper than the steady-state recovery rate: it is pacing
+ * the first moments of a connection (alongside TCP slow start), not probing
+ * for the limits of a connection already in use.
+ */
+#define GUAC_DISPLAY_QUALITY_WARMUP_INCREASE 10
+
 /**
  * Returns an appropriate quality between 0 and 100 for lossy encoding
- * depending on the current processing lag calculated for the given client.
+ * depending on the baseline quality established from measured throughput and
+ * the current processing lag calculated for the client of the given display.
  *
- * @param client
- *     The client for which the lossy quality is being calculated.
+ * @param display
+ *     The display for which the lossy quality is being calculated.
  *
  * @return
  *     A value between 0 and 100 inclusive which seems appropriate for the
- *     client based on lag measurements.
+ *     client based on throughput and lag measurements.
  */
-static int guac_display_suggest_quality(guac_client* client) {
+static int guac_display_suggest_quality(guac_display* display) {
 
-    int lag = guac_client_get_processing_lag(client);
+    int lag = guac_client_get_processing_lag(display->client);
 
-    /* Scale quality linearly from 90 to 30 as lag varies from 20ms to 80ms */
-    int quality = 90 - (lag - 20);
+    /* Scale quality linearly from max to min as lag varies from 20ms to 80ms
+     * (this reacts immediately to momentary lag, while the baseline below
+     * remembers sustained throughput limits between lag samples) */
+    int quality = GUAC_DISPLAY_QUALITY_MAX - (lag - 20);
 
-    /* Do not exceed 90 for quality */
-    if (quality > 90)
-        return 90;
+    /* Never exceed the baseline established from measured throughput */
+    if (quality > display->lossy_quality)
+        quality = display->lossy_quality;
 
-    /* Do not go below 30 for quality */
-    if (quality < 30)
-        return 30;
+    if (quality < GUAC_DISPLAY_QUALITY_MIN)
+        return GUAC_DISPLAY_QUALITY_MIN;
 
     return quality;
 
 }
 
+/**
+ * Adjusts the baseline lossy quality of the given display based on the
+ * measured time spent flushing the frame that just completed and on the
+ * client-reported processing lag. The baseline backs off quickly while
+ * flushing dominates the interval between frames (or while lag is sustained)
+ * and recovers gradually while the connection is keeping up. This function
+ * may only be called by the single worker thread finalizing a frame.
+ *
+ * @param display
+ *     The display whose baseline lossy quality should be adjusted.
+ *
+ * @param flush_start
+ *     The time that the flush of the just-completed frame began.
+ *
+ * @param flush_end
+ *     The time that the flush of the just-completed frame finished.
+ */
+static void guac_display_adjust_quality(guac_display* display,
+        guac_timestamp flush_start, guac_timestamp flush_end) {
+
+    int flush_ms = (int) (flush_end - flush_start);
+    int interval_ms = (int) (flush_end - display->last_flush_end);
+    display->last_flush_end = flush_end;
+
+    if (interval_ms <= 0)
+        return;
+
+    int lag = guac_client_get_processing_lag(display->client);
+
+    /* During the initial warm-up period, ramp quality upward from its
+     * deliberately-reduced starting point after each healthy flush, ending
+     * the warm-up at the first sign of congestion (at which point the normal
+     * back-off logic below takes over) */
+    if (display->warming_up) {
+
+        if (flush_ms > interval_ms / GUAC_DISPLAY_QUALITY_FLUSH_BUSY_DIVISOR
+                || lag > GUAC_DISPLAY_QUALITY_LAG_THRESHOLD)
+            display->warming_up = 0;
+
+        else {
+
+            display->lossy_quality += GUAC_DISPLAY_QUALITY_WARMUP_INCREASE;
+            if (display->lossy_quality >= GUAC_DISPLAY_QUALITY_MAX) {
+                display->lossy_quality = GUAC_DISPLAY_QUALITY_MAX;
+                display->warming_up = 0;
+            }
+
+            display->lossy_quality_adjusted = flush_end;
+            return;
+
+        }
+
+    }
+
+    /* Back off quickly if writes dominate the frame interval or the client
+     * reports sustained lag - the connection cannot absorb frames of the
+     * current quality */
+    if (flush_ms > interval_ms / GUAC_DISPLAY_QUALITY_FLUSH_BUSY_DIVISOR
+            || lag > GUAC_DISPLAY_QUALITY_LAG_THRESHOLD) {
+
+        display->lossy_quality -= GUAC_DISPLAY_QUALITY_DECREASE;
+        if (display->lossy_quality < GUAC_DISPLAY_QUALITY_MIN)
+            display->lossy_quality = GUAC_DISPLAY_QUALITY_MIN;
+
+        display->lossy_quality_adjusted = flush_end;
+
+    }
+
+    /* Recover gradually while the connection is comfortably keeping up */
+    else if (flush_ms < interval_ms / GUAC_DISPLAY_QUALITY_FLUSH_IDLE_DIVISOR
+            && lag < GUAC_DISPLAY_QUALITY_LAG_HEALTHY
+            && flush_end - display->lossy_quality_adjusted
+                >= GUAC_DISPLAY_QUALITY_INCREASE_INTERVAL) {
+
+        display->lossy_quality += GUAC_DISPLAY_QUALITY_INCREASE;
+        if (display->lossy_quality > GUAC_DISPLAY_QUALITY_MAX)
+            display->lossy_quality = GUAC_DISPLAY_QUALITY_MAX;
+
+        display->lossy_quality_adjusted = flush_end;
+
+    }
+
+}
+
+/**
+ * The height, in pixels, above which the PNG optimality heuristic samples
+ * every other row of the rect being checked rather than every row. The
+ * same/different pixel ratio used by the heuristic is statistical, so
+ * sampling taller rects halves the cost of the check without meaningfully
+ * affecting the outcome.
+ */
+#define GUAC_DISPLAY_PNG_OPTIMALITY_SAMPLING_HEIGHT 32
+
 /**
  * Guesses whether a rectangle within a particular layer would be better
  * compressed as PNG or using a lossy format like JPEG. Positive values
@@ -177,8 +534,14 @@ static int LFR_guac_display_layer_png_optimality(guac_display_layer* layer,
     if (rect->right - rect->left < 1 || rect->bottom - rect->top< 1)
         return 0;
 
-    /* For each row */
-    for (y = rect->top; y < rect->bottom; y++) {
+    /* Sample every other row of tall rects (the resulting ratio is
+     * statistical and does not require that every pixel be checked) */
+    int row_step = 1;
+    if (rect->bottom - rect->top > GUAC_DISPLAY_PNG_OPTIMALITY_SAMPLING_HEIGHT)
+        row_step = 2;
+
+    /* For each sampled row */
+    for (y = rect->top; y < rect->bottom; y += row_step) {
 
         uint32_t* row = (uint32_t*) buffer;
         uint32_t last_pixel = *(row++) | 0xFF000000;
@@ -199,8 +562,8 @@ static int LFR_guac_display_layer_png_optimality(guac_display_layer* layer,
 
         }
 
-        /* Advance to next row */
-        buffer += stride;
+        /* Advance to next sampled row */
+        buffer += stride * row_step;
 
     }
 
@@ -214,8 +577,97 @@ static int LFR_guac_display_layer_png_optimality(guac_display_layer* layer,
 }
 
 /**
- * Returns whether the given rectangle would be optimally encoded as JPEG
- * rather than PNG.
+ * The image format that should be used to encode a given rect of a given
+ * layer.
+ */
+typedef enum guac_display_image_format {
+
+    /**
+     * Lossless PNG.
+     */
+    GUAC_DISPLAY_IMAGE_FORMAT_PNG,
+
+    /**
+     * JPEG, with quality adjusted according to current processing lag.
+     */
+    GUAC_DISPLAY_IMAGE_FORMAT_JPEG,
+
+    /**
+     * WebP (lossy or lossless, depending on the quality required by the
+     * layer), with quality adjusted according to current processing lag.
+     */
+    GUAC_DISPLAY_IMAGE_FORMAT_WEBP
+
+} guac_display_image_format;
+
+/**
+ * The WebP support of the connected users of a display, as gathered by
+ * guac_display_count_webp_users().
+ */
+typedef struct guac_display_webp_census {
+
+    /**
+     * The total number of connected, non-pending users.
+     */
+    int total;
+
+    /**
+     * The number of those users that declared support for WebP during the
+     * handshake.
+     */
+    int webp;
+
+} guac_display_webp_census;
+
+/**
+ * Callback invoked by guac_display_count_webp_users() for each connected
+ * user, tallying that user within the census.
+ *
+ * @param user
+ *     The user to tally.
+ *
+ * @param data
+ *     A pointer to the guac_display_webp_census being gathered.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guac_display_webp_census_callback(guac_user* user, void* data) {
+
+    guac_display_webp_census* census = (guac_display_webp_census*) data;
+
+    census->total++;
+    if (guac_user_supports_webp(user))
+        census->webp++;
+
+    return NULL;
+
+}
+
+/**
+ * Counts the connected, non-pending users of the given client, noting how
+ * many of those users support WebP. When users are split in their WebP
+ * support, frequently-updating regions are encoded once per capability tier
+ * rather than forcing the lowest common denominator on all users.
+ *
+ * @param client
+ *     The client whose users should be counted.
+ *
+ * @param census
+ *     The census that should receive the counts.
+ */
+static void guac_display_count_webp_users(guac_client* client,
+        guac_display_webp_census* census) {
+    census->total = census->webp = 0;
+    guac_client_foreach_user(client, guac_display_webp_census_callback,
+            census);
+}
+
+/**
+ * Returns the lossy image format that would best encode the given rectangle
+ * of the given layer for users having the given WebP support, assuming that
+ * a lossy format is appropriate at all. WebP is preferred where supported;
+ * JPEG and PNG serve as fallbacks for users lacking WebP support.
  *
  * @param layer
  *     The layer to be queried.
@@ -223,38 +675,101 @@ static int LFR_guac_display_layer_png_optimality(guac_display_layer* layer,
  * @param rect
  *     The rectangle to check.
  *
- * @param framerate
- *     The rate that the region covered by the given rectangle has historically
- *     been being updated within the given layer, in frames per second.
+ * @param webp_supported
+ *     Non-zero if the users receiving this encode support WebP, zero
+ *     otherwise.
  *
  * @return
- *     Non-zero if the rectangle would be optimally encoded as JPEG, zero
- *     otherwise.
+ *     The lossy (or fallback) image format that would best encode the given
+ *     rectangle for the described users.
  */
-static int LFR_guac_display_layer_should_use_jpeg(guac_display_layer* layer,
-        const guac_rect* rect, int framerate) {
+static guac_display_image_format LFR_guac_display_layer_pick_lossy_format(
+        guac_display_layer* layer, const guac_rect* rect, int webp_supported) {
 
-    /* Do not use JPEG if lossless quality is required */
-    if (layer->last_frame.lossless)
-        return 0;
+    /* Prefer WebP when supported by the users receiving the encode */
+    if (webp_supported)
+        return GUAC_DISPLAY_IMAGE_FORMAT_WEBP;
 
+    /* JPEG is the next best (lossy) choice, but cannot represent the alpha
+     * channel, never beats PNG for small images, and cannot be used if
+     * lossless quality is required */
     int rect_width = rect->right - rect->left;
     int rect_height = rect->bottom - rect->top;
     int rect_size = rect_width * rect_height;
+    if (layer->opaque && !layer->last_frame.lossless
+            && rect_size > GUAC_DISPLAY_JPEG_MIN_BITMAP_SIZE)
+        return GUAC_DISPLAY_IMAGE_FORMAT_JPEG;
 
-    /* JPEG is preferred if:
-     * - frame rate is high enough
-     * - image size is large enough
-     * - PNG is not more optimal based on image contents */
-    return framerate >= GUAC_DISPLAY_JPEG_FRAMERATE
-        && rect_size > GUAC_DISPLAY_JPEG_MIN_BITMAP_SIZE
-        && LFR_guac_display_layer_png_optimality(layer, rect) < 0;
+    /* Use PNG if no lossy formats are appropriate */
+    return GUAC_DISPLAY_IMAGE_FORMAT_PNG;
 
 }
 
 /**
- * Returns whether the given rectangle would be optimally encoded as WebP
- * rather than PNG.
+ * The minimum amount of time that must elapse between samplings of a layer's
+ * image data for content classification, in milliseconds. Between samplings,
+ * the layer's pinned classification is reused for every rect of every frame.
+ * The classification only chooses between lossless and lossy encodings of
+ * frequently-updating regions, so a stale classification costs some
+ * compression efficiency for at most this long, never correctness.
+ */
+#define GUAC_DISPLAY_CLASSIFY_INTERVAL 2000
+
+/**
+ * Returns whether lossless PNG encoding is preferred for the given rectangle
+ * of the given layer, based on the layer's declared content hint or (lacking
+ * a hint) on a pinned classification of the layer's image data. The
+ * classification is obtained by sampling at most once per classification
+ * interval, rather than sampling every rect of every frame, and naturally
+ * tracks gradual changes in what the layer displays.
+ *
+ * @param layer
+ *     The layer to be queried.
+ *
+ * @param rect
+ *     The rectangle to check.
+ *
+ * @return
+ *     Non-zero if PNG encoding is preferred for the given rectangle of the
+ *     given layer, zero if a lossy encoding is preferred.
+ */
+static int LFR_guac_display_layer_png_preferred(guac_display_layer* layer,
+        const guac_rect* rect) {
+
+    /* An explicit hint from the protocol implementation pins the decision
+     * outright (text-like content must never be smeared by lossy encoding,
+     * while photo- and video-like content compresses poorly as PNG) */
+    switch (layer->content_hint) {
+
+        case GUAC_DISPLAY_CONTENT_HINT_TEXT:
+            return 1;
+
+        case GUAC_DISPLAY_CONTENT_HINT_PHOTO:
+        case GUAC_DISPLAY_CONTENT_HINT_VIDEO:
+            return 0;
+
+    }
+
+    /* Otherwise, reuse the pinned classification of the layer's content,
+     * revalidating by sampling only periodically */
+    guac_timestamp now = guac_timestamp_current_coarse();
+    if (layer->content_classified == 0 || now - layer->content_classified
+            >= GUAC_DISPLAY_CLASSIFY_INTERVAL) {
+        layer->content_png_optimal =
+            LFR_guac_display_layer_png_optimality(layer, rect) >= 0;
+        layer->content_classified = now;
+    }
+
+    return layer->content_png_optimal;
+
+}
+
+/**
+ * Returns the image format that would optimally encode the given rectangle of
+ * the given layer. Lossy formats are considered only if the rectangle has
+ * been updating frequently enough, with the relatively expensive check of the
+ * image contents performed at most once per classification interval
+ * regardless of how many rects, frames, or lossy formats are involved.
  *
  * @param layer
  *     The layer to be queried.
@@ -266,36 +781,107 @@ static int LFR_guac_display_layer_should_use_jpeg(guac_display_layer* layer,
  *     The rate that the region covered by the given rectangle has historically
  *     been being updated within the given layer, in frames per second.
  *
- * @return
- *     Non-zero if the rectangle would be optimally encoded as WebP, zero
+ * @param webp_supported
+ *     Non-zero if the users receiving this encode support WebP, zero
  *     otherwise.
+ *
+ * @return
+ *     The image format that would optimally encode the given rectangle.
  */
-static int LFR_guac_display_layer_should_use_webp(guac_display_layer* layer,
-        const guac_rect* rect, int framerate) {
+static guac_display_image_format LFR_guac_display_layer_pick_format(
+        guac_display_layer* layer, const guac_rect* rect, int framerate,
+        int webp_supported) {
+
+    /* Lossy formats apply only to frequently-updating regions */
+    if (framerate < GUAC_DISPLAY_JPEG_FRAMERATE)
+        return GUAC_DISPLAY_IMAGE_FORMAT_PNG;
 
-    /* Do not use WebP if not supported */
-    if (!guac_client_supports_webp(layer->display->client))
+    /* Lossy formats are reasonable only if the layer's content is not better
+     * served by PNG, per its content hint or pinned classification */
+    if (LFR_guac_display_layer_png_preferred(layer, rect))
+        return GUAC_DISPLAY_IMAGE_FORMAT_PNG;
+
+    /* Use whichever lossy format best suits the receiving users */
+    return LFR_guac_display_layer_pick_lossy_format(layer, rect,
+            webp_supported);
+
+}
+
+/**
+ * Returns non-zero if any pending frame cell of the given layer intersecting
+ * the given rect has been touched since the last frame plan was created. The
+ * touched flags of all cells are cleared each time a plan is created, so a
+ * set flag indicates that the corresponding region has been modified again
+ * after the operations currently in the queue were produced.
+ *
+ * @param layer
+ *     The layer whose pending frame cells should be checked.
+ *
+ * @param rect
+ *     The region to check.
+ *
+ * @return
+ *     Non-zero if at least one intersecting cell has been touched since the
+ *     last plan was created, zero otherwise.
+ */
+static int PFR_guac_display_layer_region_touched(guac_display_layer* layer,
+        const guac_rect* rect) {
+
+    if (guac_rect_is_empty(rect))
         return 0;
 
-    /* WebP is preferred if:
-     * - frame rate is high enough
-     * - PNG is not more optimal based on image contents */
-    return framerate >= GUAC_DISPLAY_JPEG_FRAMERATE
-        && LFR_guac_display_layer_png_optimality(layer, rect) < 0;
+    /* Constrain region to the bounds of the cells array (anything outside
+     * those bounds is outside the layer and is not tracked) */
+    int cell_left = rect->left / GUAC_DISPLAY_CELL_SIZE;
+    int cell_top  = rect->top  / GUAC_DISPLAY_CELL_SIZE;
+    int cell_right  = (rect->right  - 1) / GUAC_DISPLAY_CELL_SIZE;
+    int cell_bottom = (rect->bottom - 1) / GUAC_DISPLAY_CELL_SIZE;
+
+    if (cell_left < 0) cell_left = 0;
+    if (cell_top < 0) cell_top = 0;
+
+    if (cell_right >= (int) layer->pending_frame_cells_width)
+        cell_right = layer->pending_frame_cells_width - 1;
+
+    if (cell_bottom >= (int) layer->pending_frame_cells_height)
+        cell_bottom = layer->pending_frame_cells_height - 1;
+
+    for (int cell_y = cell_top; cell_y <= cell_bottom; cell_y++) {
+
+        guac_display_layer_cell* cell = layer->pending_frame_cells
+            + cell_y * layer->pending_frame_cells_width + cell_left;
+
+        for (int cell_x = cell_left; cell_x <= cell_right; cell_x++) {
+            if ((cell++)->touched)
+                return 1;
+        }
+
+    }
+
+    return 0;
 
 }
 
 void* guac_display_worker_thread(void* data) {
 
-    int framerate;
     int has_outstanding_frames = 0;
 
     guac_display* display = (guac_display*) data;
     guac_client* client = display->client;
     guac_socket* socket = client->socket;
 
-    guac_display_plan_operation op;
-    while (guac_fifo_dequeue_and_lock(&display->ops, &op)) {
+    guac_display_plan_operation ops[GUAC_DISPLAY_WORKER_MAX_BATCH_SIZE];
+    int batch_size;
+    while ((batch_size = guac_fifo_dequeue_batch_and_lock(&display->ops, ops,
+                    GUAC_DISPLAY_WORKER_MAX_BATCH_SIZE)) > 0) {
+
+        /* Statistics gathered while processing this batch, folded into the
+         * overall display statistics once the batch is complete */
+        guac_display_stats batch_stats = { 0 };
+
+        /* Realized encoding costs gathered while processing this batch, by
+         * update size, likewise folded in once the batch is complete */
+        guac_display_encode_cost batch_cost[GUAC_DISPLAY_ENCODE_COST_BUCKETS] = {{ 0 }};
 
         /* Notify any watchers of render_state that a frame is now in progress */
         guac_flag_set_and_lock(&display->render_state, GUAC_DISPLAY_RENDER_STATE_FRAME_IN_PROGRESS);
@@ -308,206 +894,413 @@ void* guac_display_worker_thread(void* data) {
         display->active_workers++;
         guac_fifo_unlock(&display->ops);
 
-        guac_rwlock_acquire_read_lock(&display->last_frame.lock);
-        guac_display_layer* display_layer = op.layer;
-        switch (op.type) {
-
-            case GUAC_DISPLAY_PLAN_OPERATION_IMG:
-
-                framerate = INT_MAX;
-                if (op.current_frame > op.last_frame)
-                    framerate = 1000 / (op.current_frame - op.last_frame);
-
-                guac_rect* dirty = &op.dest;
-
-                /* TODO: Determine whether to use PNG/WebP/JPEG purely
-                 * based on whether lossless encoding is required, the
-                 * expected time until another frame is received (time
-                 * since last frame), and estimated encoding times. The
-                 * time allowed per update should be divided up
-                 * proportionately based on the dirty_size of the update. */
-
-                /* TODO: Stream PNG/WebP/JPEG using progressive encoding such
-                 * that a frame that is currently being encoded can be
-                 * preempted by the next frame, with the connected client then
-                 * simply receiving a lower-quality intermediate frame. If
-                 * necessary, progressive encoding can be achieved by manually
-                 * dividing images into multiple reduced-resolution stages,
-                 * such that each image streamed is actually only one quarter
-                 * the size of the original image. Compositing via Guacamole
-                 * protocol instructions can reassemble those stages. */
-
-                cairo_surface_t* rect = LFR_guac_display_layer_cairo_rect(display_layer, dirty);
-                const guac_layer* layer = display_layer->layer;
-
-                /* Clear relevant rect of destination layer if necessary to
-                 * ensure fresh data is not drawn on top of old data for layers
-                 * with alpha transparency */
-                guac_display_layer_clear_non_opaque(display_layer, dirty);
-
-                /* Prefer WebP when reasonable */
-                if (LFR_guac_display_layer_should_use_webp(display_layer, dirty, framerate))
-                    guac_client_stream_webp(client, socket, GUAC_COMP_OVER, layer,
-                            dirty->left, dirty->top, rect,
-                            guac_display_suggest_quality(client),
-                            display_layer->last_frame.lossless ? 1 : 0);
-
-                /* If not WebP, JPEG is the next best (lossy) choice */
-                else if (display_layer->opaque && LFR_guac_display_layer_should_use_jpeg(display_layer, dirty, framerate))
-                    guac_client_stream_jpeg(client, socket, GUAC_COMP_OVER, layer,
-                            dirty->left, dirty->top, rect,
-                            guac_display_suggest_quality(client));
-
-                /* Use PNG if no lossy formats are appropriate */
-                else
-                    guac_client_stream_png(client, socket, GUAC_COMP_OVER,
-                            layer, dirty->left, dirty->top, rect);
-
-                cairo_surface_destroy(rect);
-                break;
-
-            case GUAC_DISPLAY_PLAN_OPERATION_COPY:
-            case GUAC_DISPLAY_PLAN_OPERATION_RECT:
-            case GUAC_DISPLAY_PLAN_OPERATION_NOP:
-                guac_client_log(client, GUAC_LOG_DEBUG, "Operation type %i "
-                        "should NOT be present in the set of operations given "
-                        "to guac_display worker thread. All operations except "
-                        "IMG and END_FRAME are handled during the initial, "
-                        "single-threaded flush step. This is likely a bug.",
-                        op.type);
-                break;
-
-            case GUAC_DISPLAY_PLAN_END_FRAME:
-
-                guac_fifo_lock(&display->ops);
-                int other_workers_busy = (display->active_workers > 1);
-                guac_fifo_unlock(&display->ops);
-
-                /* If other workers are still busy, push the frame boundary
-                 * back on the queue so that it's picked up by one of those
-                 * workers */
-                if (other_workers_busy) {
-                    guac_fifo_enqueue(&display->ops, &op);
-                }
+        /* Process all operations claimed from the FIFO, in order */
+        for (int op_index = 0; op_index < batch_size; op_index++) {
 
-                /* Otherwise, we've reached the end of the frame, and this is
-                 * the worker that will be sending that boundary to connected
-                 * users */
-                else {
-
-                    /* Update the mouse cursor if it's been changed since the
-                     * last frame */
-                    guac_display_layer* cursor = display->cursor_buffer;
-                    if (!guac_rect_is_empty(&cursor->last_frame.dirty)) {
-                        guac_protocol_send_cursor(client->socket,
-                                display->last_frame.cursor_hotspot_x,
-                                display->last_frame.cursor_hotspot_y,
-                                cursor->layer, 0, 0,
-                                cursor->last_frame.width,
-                                cursor->last_frame.height);
-                    }
+            guac_display_plan_operation op = ops[op_index];
 
-                    /* Use the amount of time that the client has been waiting
-                     * for a frame vs. the amount of time that it took the
-                     * client to process the most recently acknowledged frame
-                     * to calculate the amount of additional delay required to
-                     * allow the client to catch up. This value is used later,
-                     * after everything else related to the frame has been
-                     * finalized. */
-                    int time_since_last_frame = guac_timestamp_current() - client->last_sent_timestamp;
-                    int processing_lag = guac_client_get_processing_lag(client);
-                    int required_wait = processing_lag - time_since_last_frame;
-
-                    /* Allow connected clients to move forward with rendering */
-                    guac_client_end_multiple_frames(client, display->last_frame.frames);
-
-                    /* While connected clients moves forward with rendering,
-                     * commit any changed contents to client-side backing buffer */
-                    guac_display_layer* current = display->last_frame.layers;
-                    while (current != NULL) {
-
-                        /* Save a copy of the changed region if the layer has
-                         * been modified since the last frame */
-                        guac_rect* dirty = &current->last_frame.dirty;
-                        if (!guac_rect_is_empty(dirty)) {
-
-                            int x = dirty->left;
-                            int y = dirty->top;
-                            int width = guac_rect_width(dirty);
-                            int height = guac_rect_height(dirty);
-
-                            /* Ensure destination region is cleared out first if the alpha channel need be considered,
-                             * as GUAC_COMP_OVER is significantly faster than GUAC_COMP_SRC on the browser side */
-                            if (!current->opaque) {
-                                guac_protocol_send_rect(client->socket, current->last_frame_buffer, x, y, width, height);
-                                guac_protocol_send_cfill(client->socket, GUAC_COMP_RATOP, current->last_frame_buffer,
-                                        0x00, 0x00, 0x00, 0x00);
-                            }
+            /* Drop queued refinements whose destination region has been
+             * modified again since they were queued, as the losslessly-encoded
+             * pixels they would produce would immediately be overwritten by
+             * the frame that follows. The touched flags of the pending frame
+             * cells are cleared each time a plan is created (just before any
+             * refinements are queued), so they serve as generation tags here.
+             * The dropped region is re-recorded as lossy so that it is
+             * refined again once it next settles. Operations from the plan
+             * itself are never dropped, as they carry content that connected
+             * clients have yet to receive at all. */
+            if (op.type == GUAC_DISPLAY_PLAN_OPERATION_IMG && op.refinement) {
 
-                            guac_protocol_send_copy(client->socket,
-                                    current->layer, x, y, width, height,
-                                    GUAC_COMP_OVER, current->last_frame_buffer, x, y);
+                guac_rwlock_acquire_read_lock(&display->pending_frame.lock);
+                int superseded = PFR_guac_display_layer_region_touched(
+                        op.layer, &op.dest);
+                guac_rwlock_release_lock(&display->pending_frame.lock);
 
-                        }
+                if (superseded) {
 
-                        current = current->last_frame.next;
+                    guac_rwlock_acquire_write_lock(&display->last_frame.lock);
+                    guac_rect_extend(&op.layer->lossy_dirty, &op.dest);
+                    op.layer->lossy_dirty_time = guac_timestamp_current();
+                    guac_rwlock_release_lock(&display->last_frame.lock);
 
-                    }
+                    batch_stats.expired_rects++;
+                    continue;
+
+                }
+
+            }
+
+            guac_rwlock_acquire_read_lock(&display->last_frame.lock);
+            guac_display_layer* display_layer = op.layer;
+            switch (op.type) {
+
+                case GUAC_DISPLAY_PLAN_OPERATION_IMG: {
+
+                    guac_rect* dirty = &op.dest;
+
+                    /* TODO: Determine whether to use PNG/WebP/JPEG purely
+                     * based on whether lossless encoding is required, the
+                     * expected time until another frame is received (time
+                     * since last frame), and estimated encoding times. The
+                     * time allowed per update should be divided up
+                     * proportionately based on the dirty_size of the update. */
+
+                    /* TODO: Stream PNG/WebP/JPEG using progressive encoding such
+                     * that a frame that is currently being encoded can be
+                     * preempted by the next frame, with the connected client then
+                     * simply receiving a lower-quality intermediate frame. If
+                     * necessary, progressive encoding can be achieved by manually
+                     * dividing images into multiple reduced-resolution stages,
+                     * such that each image streamed is actually only one quarter
+                     * the size of the original image. Compositing via Guacamole
+                     * protocol instructions can reassemble those stages. */
+
+                    cairo_surface_t* rect = LFR_guac_display_layer_cairo_rect(display_layer, dirty);
+                    const guac_layer* layer = display_layer->layer;
+
+                    /* Clear relevant rect of destination layer if necessary to
+                     * ensure fresh data is not drawn on top of old data for layers
+                     * with alpha transparency */
+                    guac_display_layer_clear_non_opaque(display_layer, dirty);
+
+                    uint64_t pixels = (uint64_t) guac_rect_width(dirty)
+                        * guac_rect_height(dirty);
+
+                    guac_timestamp encode_start = guac_timestamp_current();
+
+                    /* Determine how many connected users can accept WebP,
+                     * such that sessions mixing WebP-capable and legacy
+                     * clients can be served per capability tier rather than
+                     * all users receiving the lowest-common-denominator
+                     * format */
+                    guac_display_webp_census census;
+                    guac_display_count_webp_users(client, &census);
+
+                    guac_display_image_format format =
+                        LFR_guac_display_layer_pick_format(display_layer,
+                                dirty, op.framerate, census.webp > 0);
+
+                    /* If WebP is optimal but only some users support it,
+                     * encode the rect once per tier: WebP for WebP-capable
+                     * users, and whichever lossy format is next best for the
+                     * rest */
+                    if (format == GUAC_DISPLAY_IMAGE_FORMAT_WEBP
+                            && census.webp < census.total) {
+
+                        guac_client_stream_webp(client, display->webp_socket,
+                                GUAC_COMP_OVER, layer,
+                                dirty->left, dirty->top, rect,
+                                guac_display_suggest_quality(display),
+                                display_layer->last_frame.lossless ? 1 : 0);
+                        batch_stats.webp_rects++;
+                        batch_stats.webp_pixels += pixels;
+
+                        if (LFR_guac_display_layer_pick_lossy_format(display_layer,
+                                    dirty, 0) == GUAC_DISPLAY_IMAGE_FORMAT_JPEG) {
+                            guac_client_stream_jpeg(client, display->non_webp_socket,
+                                    GUAC_COMP_OVER, layer,
+                                    dirty->left, dirty->top, rect,
+                                    guac_display_suggest_quality(display));
+                            batch_stats.jpeg_rects++;
+                            batch_stats.jpeg_pixels += pixels;
+                        }
+                        else {
+                            guac_display_stream_png(display, display->non_webp_socket,
+                                    layer, dirty->left, dirty->top, rect);
+                            batch_stats.png_rects++;
+                            batch_stats.png_pixels += pixels;
+                        }
 
-                    /* Include an additional frame boundary to allow the client to also move forward with committing
-                     * changes to the backing buffer while the server is receiving and preparing the next frame */
-                    guac_client_end_multiple_frames(client, 0);
-
-                    /* This is now absolutely everything for the current frame,
-                     * and it's safe to flush any outstanding data */
-                    guac_socket_flush(client->socket);
-
-                    /* Notify any watchers of render_state that a frame is no longer in progress */
-                    guac_flag_set_and_lock(&display->render_state, GUAC_DISPLAY_RENDER_STATE_FRAME_NOT_IN_PROGRESS);
-                    guac_flag_clear(&display->render_state, GUAC_DISPLAY_RENDER_STATE_FRAME_IN_PROGRESS);
-                    guac_flag_unlock(&display->render_state);
-
-                    /* Exclude local, server-side frame processing latency from
-                     * waiting period */
-                    int latency = (int) (guac_timestamp_current() - display->last_frame.timestamp);
-                    if (latency >= 0) {
-                        guac_client_log(display->client, GUAC_LOG_TRACE,
-                                "Rendering latency: %ims (%i:1 frame)\n",
-                                latency, display->last_frame.frames);
-                        required_wait -= latency;
                     }
 
-                    /* Ensure we don't wait without bound when compensating for
-                     * client-side processing delays */
-                    if (required_wait > GUAC_DISPLAY_MAX_LAG_COMPENSATION)
-                        required_wait = GUAC_DISPLAY_MAX_LAG_COMPENSATION;
-
-                    /* Allow connected clients to catch up if they're taking
-                     * longer to process frames than the server is taking to
-                     * generate them */
-                    if (required_wait > 0) {
-                        guac_client_log(display->client, GUAC_LOG_TRACE,
-                                "Waiting %ims to compensate for client-side "
-                                "processing delays.\n", required_wait);
-                        guac_timestamp_msleep(required_wait);
+                    /* Otherwise, all users receive the same encoding */
+                    else switch (format) {
+
+                        case GUAC_DISPLAY_IMAGE_FORMAT_WEBP:
+                            guac_client_stream_webp(client, socket, GUAC_COMP_OVER, layer,
+                                    dirty->left, dirty->top, rect,
+                                    guac_display_suggest_quality(display),
+                                    display_layer->last_frame.lossless ? 1 : 0);
+                            batch_stats.webp_rects++;
+                            batch_stats.webp_pixels += pixels;
+                            break;
+
+                        case GUAC_DISPLAY_IMAGE_FORMAT_JPEG:
+                            guac_client_stream_jpeg(client, socket, GUAC_COMP_OVER, layer,
+                                    dirty->left, dirty->top, rect,
+                                    guac_display_suggest_quality(display));
+                            batch_stats.jpeg_rects++;
+                            batch_stats.jpeg_pixels += pixels;
+                            break;
+
+                        case GUAC_DISPLAY_IMAGE_FORMAT_PNG:
+                            guac_display_stream_png(display, socket, layer,
+                                    dirty->left, dirty->top, rect);
+                            batch_stats.png_rects++;
+                            batch_stats.png_pixels += pixels;
+                            break;
+
                     }
 
+                    guac_timestamp encode_duration =
+                        guac_timestamp_current() - encode_start;
+                    batch_stats.encode_duration_ms += encode_duration;
+
+                    /* Record the realized cost of this encode against the
+                     * bucket covering updates of this size, ultimately
+                     * driving the adaptive limit on combined update size */
+                    guac_display_encode_cost* cost =
+                        &batch_cost[guac_display_encode_cost_bucket(dirty)];
+                    cost->rects++;
+                    cost->pixels += pixels;
+                    cost->duration_ms += encode_duration;
+
+                    cairo_surface_destroy(rect);
+
+                    /* Remember the tile just sent, such that future draws of
+                     * identical content can be replaced with simple copies
+                     * from the client-side tile cache */
+                    LFR_guac_display_plan_cache_tile(display, &op);
+
+                    break;
+
+                }
+
+                case GUAC_DISPLAY_PLAN_OPERATION_COPY:
+                case GUAC_DISPLAY_PLAN_OPERATION_RECT:
+                case GUAC_DISPLAY_PLAN_OPERATION_NOP:
+                    guac_client_log(client, GUAC_LOG_DEBUG, "Operation type %i "
+                            "should NOT be present in the set of operations given "
+                            "to guac_display worker thread. All operations except "
+                            "IMG and END_FRAME are handled during the initial, "
+                            "single-threaded flush step. This is likely a bug.",
+                            op.type);
+                    break;
+
+                case GUAC_DISPLAY_PLAN_END_FRAME:
+
                     guac_fifo_lock(&display->ops);
-                    has_outstanding_frames = display->frame_deferred;
+                    int other_workers_busy = (display->active_workers > 1);
                     guac_fifo_unlock(&display->ops);
 
-                }
+                    /* If other workers are still busy, push the frame boundary
+                     * back on the queue so that it's picked up by one of those
+                     * workers */
+                    if (other_workers_busy) {
+                        guac_fifo_enqueue(&display->ops, &op);
+                    }
 
-                break;
+                    /* Otherwise, we've reached the end of the frame, and this is
+                     * the worker that will be sending that boundary to connected
+                     * users */
+                    else {
+
+                        /* From the perspective of per-frame trace output,
+                         * encoding of the frame is now complete (all that
+                         * remains is finalization of the frame and the flush
+                         * below) */
+                        guac_timestamp encode_end = guac_timestamp_current();
+
+                        /* Update the mouse cursor if it's been changed since the
+                         * last frame */
+                        guac_display_layer* cursor = display->cursor_buffer;
+                        if (!guac_rect_is_empty(&cursor->last_frame.dirty)) {
+
+                            /* Store (or refresh) the new cursor image within
+                             * the client-side cursor cache, such that future
+                             * toggles back to this cursor need not resend it */
+                            LFR_guac_display_cursor_cache_store(display);
+
+                            guac_protocol_send_cursor(client->socket,
+                                    display->last_frame.cursor_hotspot_x,
+                                    display->last_frame.cursor_hotspot_y,
+                                    cursor->layer, 0, 0,
+                                    cursor->last_frame.width,
+                                    cursor->last_frame.height);
+                        }
 
-        }
+                        /* Use the amount of time that the client has been waiting
+                         * for a frame vs. the amount of time that it took the
+                         * client to process the most recently acknowledged frame
+                         * to calculate the amount of additional delay required to
+                         * allow the client to catch up. This value is used later,
+                         * after everything else related to the frame has been
+                         * finalized. */
+                        int time_since_last_frame = guac_timestamp_current() - client->last_sent_timestamp;
+                        int processing_lag = guac_client_get_processing_lag(client);
+                        int required_wait = processing_lag - time_since_last_frame;
+
+                        /* Allow connected clients to move forward with rendering */
+                        guac_client_end_multiple_frames(client, display->last_frame.frames);
+
+                        /* While connected clients moves forward with rendering,
+                         * commit any changed contents to client-side backing buffer */
+                        guac_display_layer* current = display->last_frame.layers;
+                        while (current != NULL) {
+
+                            /* Save a copy of the changed region if the layer has
+                             * been modified since the last frame */
+                            guac_rect* dirty = &current->last_frame.dirty;
+                            if (!guac_rect_is_empty(dirty)) {
+
+                                int x = dirty->left;
+                                int y = dirty->top;
+                                int width = guac_rect_width(dirty);
+                                int height = guac_rect_height(dirty);
+
+                                /* Ensure destination region is cleared out first if the alpha channel need be considered,
+                                 * as GUAC_COMP_OVER is significantly faster than GUAC_COMP_SRC on the browser side */
+                                if (!current->opaque) {
+                                    guac_protocol_send_rect(client->socket, current->last_frame_buffer, x, y, width, height);
+                                    guac_protocol_send_cfill(client->socket, GUAC_COMP_RATOP, current->last_frame_buffer,
+                                            0x00, 0x00, 0x00, 0x00);
+                                }
+
+                                guac_protocol_send_copy(client->socket,
+                                        current->layer, x, y, width, height,
+                                        GUAC_COMP_OVER, current->last_frame_buffer, x, y);
+
+                            }
+
+                            current = current->last_frame.next;
+
+                        }
+
+                        /* Include an additional frame boundary to allow the client to also move forward with committing
+                         * changes to the backing buffer while the server is receiving and preparing the next frame */
+                        guac_client_end_multiple_frames(client, 0);
+
+                        /* This is now absolutely everything for the current frame,
+                         * and it's safe to flush any outstanding data */
+                        guac_timestamp flush_start = guac_timestamp_current();
+                        guac_socket_flush(client->socket);
+                        guac_timestamp flush_end = guac_timestamp_current();
+                        batch_stats.flush_duration_ms += flush_end - flush_start;
+                        batch_stats.frames++;
+
+                        /* Continuously adapt the baseline lossy quality to
+                         * what the connection is measurably absorbing */
+                        guac_display_adjust_quality(display, flush_start, flush_end);
+
+                        /* Emit a per-frame trace span breaking the frame's
+                         * overall latency down by pipeline stage. The "sync"
+                         * value is the timestamp by which connected users
+                         * will acknowledge the frame, joining this span with
+                         * the per-user confirmation logged when each "sync"
+                         * response is later received. */
+                        guac_fifo_lock(&display->ops);
+                        uint64_t trace_id = display->frame_trace_id;
+                        guac_timestamp trace_start = display->frame_trace_start;
+                        guac_timestamp trace_plan_start = display->frame_trace_plan_start;
+                        guac_timestamp trace_dispatched = display->frame_trace_dispatched;
+                        guac_fifo_unlock(&display->ops);
+
+                        if (trace_start != 0)
+                            guac_client_log(client, GUAC_LOG_TRACE,
+                                    "Frame trace: frame=%" PRIu64
+                                    " sync=%" PRIu64 " wait=%ims plan=%ims "
+                                    "encode=%ims flush=%ims total=%ims",
+                                    trace_id,
+                                    (uint64_t) client->last_sent_timestamp,
+                                    (int) (trace_plan_start - trace_start),
+                                    (int) (trace_dispatched - trace_plan_start),
+                                    (int) (encode_end - trace_dispatched),
+                                    (int) (flush_end - flush_start),
+                                    (int) (flush_end - trace_start));
+
+                        /* Notify any watchers of render_state that a frame is no longer in progress */
+                        guac_flag_set_and_lock(&display->render_state, GUAC_DISPLAY_RENDER_STATE_FRAME_NOT_IN_PROGRESS);
+                        guac_flag_clear(&display->render_state, GUAC_DISPLAY_RENDER_STATE_FRAME_IN_PROGRESS);
+                        guac_flag_unlock(&display->render_state);
+
+                        /* Exclude local, server-side frame processing latency from
+                         * waiting period */
+                        int latency = (int) (guac_timestamp_current() - display->last_frame.timestamp);
+                        if (latency >= 0) {
+                            guac_client_log(display->client, GUAC_LOG_TRACE,
+                                    "Rendering latency: %ims (%i:1 frame)\n",
+                                    latency, display->last_frame.frames);
+                            required_wait -= latency;
+                        }
+
+                        /* Ensure we don't wait without bound when compensating for
+                         * client-side processing delays */
+                        if (required_wait > GUAC_DISPLAY_MAX_LAG_COMPENSATION)
+                            required_wait = GUAC_DISPLAY_MAX_LAG_COMPENSATION;
+
+                        /* Allow connected clients to catch up if they're taking
+                         * longer to process frames than the server is taking to
+                         * generate them */
+                        if (required_wait > 0) {
+                            guac_client_log(display->client, GUAC_LOG_TRACE,
+                                    "Waiting %ims to compensate for client-side "
+                                    "processing delays.\n", required_wait);
+                            guac_timestamp_msleep(required_wait);
+                        }
+
+                        guac_fifo_lock(&display->ops);
+                        has_outstanding_frames = display->frame_deferred;
+                        guac_fifo_unlock(&display->ops);
+
+                    }
+
+                    break;
+
+            }
 
-        guac_rwlock_release_lock(&display->last_frame.lock);
+            guac_rwlock_release_lock(&display->last_frame.lock);
+
+        } /* end for each operation in batch */
 
         guac_fifo_lock(&display->ops);
         display->active_workers--;
+
+        /* Fold the statistics gathered for this batch into the overall
+         * display statistics, noting whether enough time has elapsed that a
+         * summary of those statistics should be logged */
+        guac_display_stats_add(&display->stats, &batch_stats);
+        guac_display_stats totals = display->stats;
+
+        /* Fold the per-size encoding costs gathered for this batch into the
+         * accumulated costs of the display */
+        for (int i = 0; i < GUAC_DISPLAY_ENCODE_COST_BUCKETS; i++) {
+            display->encode_cost[i].rects += batch_cost[i].rects;
+            display->encode_cost[i].pixels += batch_cost[i].pixels;
+            display->encode_cost[i].duration_ms += batch_cost[i].duration_ms;
+        }
+
+        guac_timestamp now = guac_timestamp_current();
+        int log_stats = (now - display->stats_logged >= GUAC_DISPLAY_STATS_LOG_INTERVAL);
+        if (log_stats)
+            display->stats_logged = now;
+
+        /* Periodically reconsider the limit on combined update size in light
+         * of the encoding costs accumulated since the last consideration */
+        if (now - display->combined_size_adjusted >= GUAC_DISPLAY_COMBINE_ADJUST_INTERVAL) {
+            guac_display_adjust_combined_size(display);
+            display->combined_size_adjusted = now;
+        }
+
         guac_fifo_unlock(&display->ops);
 
+        /* Periodically log overall rendering statistics, such that frame time
+         * can be broken down into planning, encoding, and socket flushing in
+         * production without attaching a profiler */
+        if (log_stats)
+            guac_client_log(client, GUAC_LOG_DEBUG, "Display render stats: "
+                    "%" PRIu64 " frames; %" PRIu64 "ms planning; "
+                    "%" PRIu64 "ms encoding; %" PRIu64 "ms flushing; "
+                    "PNG %" PRIu64 " rects / %" PRIu64 " px; "
+                    "JPEG %" PRIu64 " rects / %" PRIu64 " px; "
+                    "WebP %" PRIu64 " rects / %" PRIu64 " px; "
+                    "current processing lag %ims",
+                    totals.frames, totals.plan_duration_ms,
+                    totals.encode_duration_ms, totals.flush_duration_ms,
+                    totals.png_rects, totals.png_pixels,
+                    totals.jpeg_rects, totals.jpeg_pixels,
+                    totals.webp_rects, totals.webp_pixels,
+                    guac_client_get_processing_lag(client));
+
         /* Trigger additional flush if frames were completed while we were
          * still processing the previous frame */
         if (has_outstanding_frames) {
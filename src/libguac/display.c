@@ -20,6 +20,9 @@
 #include "config.h"
 #include "display-plan.h"
 #include "display-priv.h"
+#include "encode-png.h"
+#include "guacamole/align.h"
+#include "guacamole/assert.h"
 #include "guacamole/client.h"
 #include "guacamole/display.h"
 #include "guacamole/fifo.h"
@@ -29,6 +32,7 @@
 #include "guacamole/rect.h"
 #include "guacamole/rwlock.h"
 #include "guacamole/socket.h"
+#include "guacamole/string.h"
 #include "guacamole/timestamp.h"
 #include "guacamole/user.h"
 
@@ -39,8 +43,22 @@
 #include <cairo/cairo.h>
 #include <pthread.h>
 #include <sched.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
+/* The hot, independently-locked members of guac_display are deliberately kept
+ * on separate cache lines (see display-priv.h), such that worker threads
+ * encoding against last_frame do not falsely share lines with threads
+ * manipulating the pending frame, the ops FIFO, or the render state. Lock
+ * that layout in at compile time so that reordering or inserting members
+ * cannot silently reintroduce the sharing. */
+GUAC_STATIC_ASSERT(offsetof(guac_display, last_frame) % GUAC_CACHE_LINE_SIZE == 0);
+GUAC_STATIC_ASSERT(offsetof(guac_display, pending_frame) % GUAC_CACHE_LINE_SIZE == 0);
+GUAC_STATIC_ASSERT(offsetof(guac_display, ops) % GUAC_CACHE_LINE_SIZE == 0);
+GUAC_STATIC_ASSERT(offsetof(guac_display, render_state) % GUAC_CACHE_LINE_SIZE == 0);
+
 /**
  * The number of worker threads to create per processor.
  */
@@ -111,11 +129,124 @@ static unsigned long guac_display_nproc() {
 
 }
 
+#if defined(__linux__)
+
+/**
+ * The mount point of the cgroup v2 filesystem.
+ */
+#define GUAC_DISPLAY_CGROUP_ROOT "/sys/fs/cgroup"
+
+/**
+ * Returns the number of processors that this process can actually keep busy
+ * under the strictest CPU bandwidth limit (cgroup v2 quota) applied to its
+ * cgroup or any ancestor of its cgroup, rounding up where the quota is not a
+ * whole number of processors. Such limits are commonly applied by container
+ * runtimes and systemd slices, and cap achievable parallelism regardless of
+ * how many processors are nominally available. If no limit applies, or if the
+ * limit cannot be determined (including on systems not using cgroup v2), zero
+ * is returned.
+ *
+ * @return
+ *     The number of processors' worth of CPU bandwidth available to this
+ *     process, or zero if CPU bandwidth is unlimited or cannot be determined.
+ */
+static unsigned long guac_display_cgroup_quota_cpus() {
+
+    unsigned long quota_cpus = 0;
+
+    /* Locate this process within the cgroup v2 hierarchy (the entry with a
+     * hierarchy ID of zero and an empty controller list) */
+    FILE* proc_cgroup = fopen("/proc/self/cgroup", "r");
+    if (proc_cgroup == NULL)
+        return 0;
+
+    char cgroup_path[4096] = { '\0' };
+
+    char line[sizeof(cgroup_path)];
+    while (fgets(line, sizeof(line), proc_cgroup) != NULL) {
+        if (strncmp(line, "0::", 3) == 0) {
+            guac_strlcpy(cgroup_path, line + 3, sizeof(cgroup_path));
+            cgroup_path[strcspn(cgroup_path, "\n")] = '\0';
+            break;
+        }
+    }
+
+    fclose(proc_cgroup);
+
+    if (cgroup_path[0] != '/')
+        return 0;
+
+    /* The kernel does not aggregate limits downward through the "cpu.max" of
+     * each cgroup, so the strictest limit of the process's own cgroup and all
+     * ancestors is what actually applies */
+    for (;;) {
+
+        char cpu_max_path[sizeof(GUAC_DISPLAY_CGROUP_ROOT) + sizeof(cgroup_path) + 8];
+        snprintf(cpu_max_path, sizeof(cpu_max_path),
+                GUAC_DISPLAY_CGROUP_ROOT "%s/cpu.max", cgroup_path);
+
+        /* Each "cpu.max" contains a quota and period in microseconds, the
+         * quota being the literal string "max" if unlimited (in which case
+         * the fscanf() here will simply not match) */
+        FILE* cpu_max = fopen(cpu_max_path, "r");
+        if (cpu_max != NULL) {
+
+            long long quota, period;
+            if (fscanf(cpu_max, "%lld %lld", &quota, &period) == 2
+                    && quota > 0 && period > 0) {
+
+                /* A fractional quota still requires a whole processor to be
+                 * usable part of the time */
+                unsigned long limit = (unsigned long) ((quota + period - 1) / period);
+                if (quota_cpus == 0 || limit < quota_cpus)
+                    quota_cpus = limit;
+
+            }
+
+            fclose(cpu_max);
+
+        }
+
+        /* Continue with the parent cgroup, stopping once the root of the
+         * hierarchy (which cannot itself be limited) has been reached */
+        char* last_slash = strrchr(cgroup_path, '/');
+        if (last_slash == NULL || last_slash == cgroup_path)
+            break;
+
+        *last_slash = '\0';
+
+    }
+
+    return quota_cpus;
+
+}
+
+#endif
+
 guac_display* guac_display_alloc(guac_client* client) {
 
     /* Allocate and init core properties (really just the client pointer) */
     guac_display* display = guac_mem_zalloc(sizeof(guac_display));
     display->client = client;
+    display->png_compression_level = -1;
+
+    /* Per-capability-tier broadcast sockets, used to encode
+     * frequently-updating regions once per tier when connected users are
+     * split in their WebP support */
+    display->webp_socket = guac_socket_broadcast_webp(client);
+    display->non_webp_socket = guac_socket_broadcast_non_webp(client);
+
+    /* Start lossy encoding at reduced quality while TCP slow start is still
+     * probing the capacity of the connection, ramping up quickly as completed
+     * flushes prove the connection can keep up */
+    display->lossy_quality = GUAC_DISPLAY_QUALITY_WARMUP_START;
+    display->warming_up = 1;
+    display->last_flush_end = guac_timestamp_current();
+
+    /* Start combining operations at the default size limit, adjusting only
+     * as measurements of realized encoding cost accumulate */
+    display->max_combined_size = GUAC_DISPLAY_MAX_COMBINED_SIZE;
+    display->combined_size_adjusted = guac_timestamp_current();
 
     /* Init last frame and pending frame tracking */
     guac_rwlock_init(&display->last_frame.lock);
@@ -128,6 +259,20 @@ guac_display* guac_display_alloc(guac_client* client) {
     display->default_layer = guac_display_add_layer(display, (guac_layer*) GUAC_DEFAULT_LAYER, 1);
     display->cursor_buffer = guac_display_alloc_buffer(display, 0);
 
+    /* Init client-side tile cache (the client-side buffer will automatically
+     * grow to cover all slots as tiles are stored) */
+    display->tile_cache_buffer = guac_client_alloc_buffer(client);
+    display->tile_cache_data = guac_mem_zalloc(GUAC_DISPLAY_TILE_CACHE_ROWS,
+            GUAC_DISPLAY_CELL_SIZE, GUAC_DISPLAY_TILE_CACHE_STRIDE);
+    pthread_mutex_init(&display->tile_cache_lock, NULL);
+
+    /* Init client-side cursor cache (as with the tile cache, the client-side
+     * buffer will automatically grow as cursor images are stored) */
+    display->cursor_cache_buffer = guac_client_alloc_buffer(client);
+    display->cursor_cache_data = guac_mem_zalloc(GUAC_DISPLAY_CURSOR_CACHE_SLOT_SIZE,
+            GUAC_DISPLAY_CURSOR_CACHE_STRIDE);
+    pthread_mutex_init(&display->cursor_cache_lock, NULL);
+
     /* Init operation FIFO used by worker threads */
     guac_fifo_init(&display->ops, display->ops_items,
             GUAC_DISPLAY_WORKER_FIFO_SIZE, sizeof(guac_display_plan_operation));
@@ -148,16 +293,48 @@ guac_display* guac_display_alloc(guac_client* client) {
                 "processor(s) are available.", cpu_count);
     }
 
+#if defined(__linux__)
+    /* However many processors are nominally available, a CPU bandwidth limit
+     * caps how many of them can actually be kept busy. Threads beyond that
+     * cap only add context switching and throttling stalls. */
+    unsigned long quota_cpus = guac_display_cgroup_quota_cpus();
+    if (quota_cpus > 0 && quota_cpus < (unsigned long) cpu_count) {
+        guac_client_log(client, GUAC_LOG_INFO, "CPU bandwidth is limited by "
+                "cgroup quota to the equivalent of %lu processor(s). Thread "
+                "pools will be sized accordingly.", quota_cpus);
+        cpu_count = (int) quota_cpus;
+    }
+#endif
+
     display->worker_thread_count = cpu_count * GUAC_DISPLAY_CPU_THREAD_FACTOR;
     display->worker_threads = guac_mem_alloc(display->worker_thread_count, sizeof(pthread_t));
     guac_client_log(client, GUAC_LOG_INFO, "Graphical updates will be encoded "
             "using %i worker thread(s).", display->worker_thread_count);
 
+    /* Dedicate all remaining processors to assisting with frame diffs, which
+     * would otherwise be computed entirely by the single thread that flushes
+     * each frame. These threads sleep except while a frame diff is being
+     * split across threads, and so do not meaningfully compete with the
+     * encoding workers. */
+    display->diff_thread_count = cpu_count - 1;
+    if (display->diff_thread_count > 0) {
+        display->diff_threads = guac_mem_alloc(display->diff_thread_count, sizeof(pthread_t));
+        guac_client_log(client, GUAC_LOG_INFO, "Frame diffs will be "
+                "parallelized across %i additional thread(s).",
+                display->diff_thread_count);
+    }
+
+    /* Init flag used to coordinate splitting of frame diffs across threads */
+    guac_flag_init(&display->diff_state);
+
     /* Now that the core of the display has been fully initialized, it's safe
      * to start the worker threads */
     for (int i = 0; i < display->worker_thread_count; i++)
         pthread_create(&(display->worker_threads[i]), NULL, guac_display_worker_thread, display);
 
+    for (int i = 0; i < display->diff_thread_count; i++)
+        pthread_create(&(display->diff_threads[i]), NULL, guac_display_diff_worker_thread, display);
+
     return display;
 
 }
@@ -172,9 +349,23 @@ void guac_display_free(guac_display* display) {
     for (int i = 0; i < display->worker_thread_count; i++)
         pthread_join(display->worker_threads[i], NULL);
 
+    /* Stop and wait for the diff worker threads, as well. No frame diff can
+     * be in progress at this point, as the display may only be freed once all
+     * other use of the display has stopped. */
+    guac_flag_set(&display->diff_state, GUAC_DISPLAY_DIFF_STATE_STOPPING);
+    for (int i = 0; i < display->diff_thread_count; i++)
+        pthread_join(display->diff_threads[i], NULL);
+
     /* All locks, FIFOs, etc. are now unused and can be safely destroyed */
+    guac_flag_destroy(&display->diff_state);
     guac_flag_destroy(&display->render_state);
     guac_fifo_destroy(&display->ops);
+
+    /* Free any plan that was being retained for reuse by a future frame */
+    if (display->spare_plan != NULL) {
+        guac_mem_free(display->spare_plan->ops);
+        guac_mem_free(display->spare_plan);
+    }
     guac_rwlock_destroy(&display->last_frame.lock);
     guac_rwlock_destroy(&display->pending_frame.lock);
 
@@ -188,11 +379,51 @@ void guac_display_free(guac_display* display) {
     while (display->last_frame.layers != NULL)
         guac_display_free_layer(display->last_frame.layers);
 
+    /* Free client-side tile cache */
+    guac_protocol_send_dispose(display->client->socket, display->tile_cache_buffer);
+    guac_client_free_buffer(display->client, display->tile_cache_buffer);
+    guac_mem_free(display->tile_cache_data);
+    pthread_mutex_destroy(&display->tile_cache_lock);
+
+    /* Free client-side cursor cache */
+    guac_protocol_send_dispose(display->client->socket, display->cursor_cache_buffer);
+    guac_client_free_buffer(display->client, display->cursor_cache_buffer);
+    guac_mem_free(display->cursor_cache_data);
+    pthread_mutex_destroy(&display->cursor_cache_lock);
+
+    /* Free per-capability-tier broadcast sockets */
+    guac_socket_free(display->webp_socket);
+    guac_socket_free(display->non_webp_socket);
+
+    guac_mem_free(display->diff_threads);
     guac_mem_free(display->worker_threads);
     guac_mem_free(display);
 
 }
 
+void guac_display_set_png_compression_level(guac_display* display, int level) {
+
+    /* Clamp to the range meaningful to zlib, with all negative values
+     * interpreted as a request for the libpng default */
+    if (level > 9)
+        level = 9;
+    else if (level < 0)
+        level = -1;
+
+    display->png_compression_level = level;
+
+}
+
+void guac_display_get_stats(guac_display* display, guac_display_stats* stats) {
+
+    /* The statistics counters are protected by the ops FIFO lock, and locking
+     * here additionally guarantees the returned snapshot is consistent */
+    guac_fifo_lock(&display->ops);
+    *stats = display->stats;
+    guac_fifo_unlock(&display->ops);
+
+}
+
 void guac_display_dup(guac_display* display, guac_socket* socket) {
 
     guac_client* client = display->client;
@@ -222,22 +453,52 @@ void guac_display_dup(guac_display* display, guac_socket* socket) {
 
         if (width > 0 && height > 0) {
 
-            /* Get Cairo surface covering layer bounds */
-            unsigned char* buffer = GUAC_DISPLAY_LAYER_STATE_MUTABLE_BUFFER(current->last_frame, layer_bounds);
-            cairo_surface_t* rect = cairo_image_surface_create_for_data(buffer,
-                        current->opaque ? CAIRO_FORMAT_RGB24 : CAIRO_FORMAT_ARGB32,
-                        width, height, current->last_frame.buffer_stride);
+            /* Encode and cache the current layer contents if no cached
+             * encoding is available (writing the cache here is safe despite
+             * the read lock, as the render_state lock held above excludes
+             * both concurrent guac_display_dup() calls and the frame flushes
+             * that would invalidate the cache) */
+            if (current->last_frame_png == NULL) {
+
+                /* Get Cairo surface covering layer bounds */
+                unsigned char* buffer = GUAC_DISPLAY_LAYER_STATE_MUTABLE_BUFFER(current->last_frame, layer_bounds);
+                cairo_surface_t* rect = cairo_image_surface_create_for_data(buffer,
+                            current->opaque ? CAIRO_FORMAT_RGB24 : CAIRO_FORMAT_ARGB32,
+                            width, height, current->last_frame.buffer_stride);
+
+                if (guac_png_write_to_buffer(rect, display->png_compression_level,
+                            &current->last_frame_png, &current->last_frame_png_size)) {
 
-            /* Send PNG for rect */
-            guac_client_stream_png(client, socket, GUAC_COMP_OVER, layer, 0, 0, rect);
+                    /* Fall back to streaming an uncached encoding if the
+                     * cached encoding could not be produced */
+                    guac_client_stream_png(client, socket, GUAC_COMP_OVER,
+                            layer, 0, 0, rect);
+
+                }
+
+                cairo_surface_destroy(rect);
+
+            }
+
+            /* Send cached PNG for rect (further users joining before the next
+             * frame completes will reuse this same encoding) */
+            if (current->last_frame_png != NULL) {
+
+                guac_stream* stream = guac_client_alloc_stream(client);
+                guac_protocol_send_img(socket, stream, GUAC_COMP_OVER, layer,
+                        "image/png", 0, 0);
+                guac_protocol_send_blobs(socket, stream,
+                        current->last_frame_png, current->last_frame_png_size);
+                guac_protocol_send_end(socket, stream);
+                guac_client_free_stream(client, stream);
+
+            }
 
             /* Resync copy of previous frame */
             guac_protocol_send_copy(socket,
                     layer, 0, 0, width, height,
                     GUAC_COMP_OVER, current->last_frame_buffer, 0, 0);
 
-            cairo_surface_destroy(rect);
-
         }
 
         /* Resync any properties that are specific to non-buffer layers */
@@ -267,6 +528,68 @@ void guac_display_dup(guac_display* display, guac_socket* socket) {
 
     }
 
+    /* Resync the contents of the client-side tile cache buffer from the
+     * server-side mirror, such that copies recalling cached tiles remain
+     * meaningful for the new users (the mirror contains only opaque tiles,
+     * and can therefore be streamed as a single RGB24 image) */
+    pthread_mutex_lock(&display->tile_cache_lock);
+
+    int tile_cache_used = 0;
+    for (int i = 0; i < GUAC_DISPLAY_TILE_CACHE_SIZE; i++) {
+        if (display->tile_cache[i].last_use != 0) {
+            tile_cache_used = 1;
+            break;
+        }
+    }
+
+    if (tile_cache_used) {
+
+        cairo_surface_t* tiles = cairo_image_surface_create_for_data(
+                display->tile_cache_data, CAIRO_FORMAT_RGB24,
+                GUAC_DISPLAY_TILE_CACHE_COLUMNS * GUAC_DISPLAY_CELL_SIZE,
+                GUAC_DISPLAY_TILE_CACHE_ROWS * GUAC_DISPLAY_CELL_SIZE,
+                GUAC_DISPLAY_TILE_CACHE_STRIDE);
+
+        guac_client_stream_png(client, socket, GUAC_COMP_OVER,
+                display->tile_cache_buffer, 0, 0, tiles);
+
+        cairo_surface_destroy(tiles);
+
+    }
+
+    pthread_mutex_unlock(&display->tile_cache_lock);
+
+    /* Resync the contents of the client-side cursor cache buffer from the
+     * server-side mirror, such that copies recalling cached cursor images
+     * remain meaningful for the new users (cursor images have alpha, and so
+     * must be streamed as ARGB32) */
+    pthread_mutex_lock(&display->cursor_cache_lock);
+
+    int cursor_cache_used = 0;
+    for (int i = 0; i < GUAC_DISPLAY_CURSOR_CACHE_SIZE; i++) {
+        if (display->cursor_cache[i].last_use != 0) {
+            cursor_cache_used = 1;
+            break;
+        }
+    }
+
+    if (cursor_cache_used) {
+
+        cairo_surface_t* cursors = cairo_image_surface_create_for_data(
+                display->cursor_cache_data, CAIRO_FORMAT_ARGB32,
+                GUAC_DISPLAY_CURSOR_CACHE_SIZE * GUAC_DISPLAY_CURSOR_CACHE_SLOT_SIZE,
+                GUAC_DISPLAY_CURSOR_CACHE_SLOT_SIZE,
+                GUAC_DISPLAY_CURSOR_CACHE_STRIDE);
+
+        guac_client_stream_png(client, socket, GUAC_COMP_OVER,
+                display->cursor_cache_buffer, 0, 0, cursors);
+
+        cairo_surface_destroy(cursors);
+
+    }
+
+    pthread_mutex_unlock(&display->cursor_cache_lock);
+
     /* Synchronize mouse cursor */
     guac_display_layer* cursor = display->cursor_buffer;
     guac_protocol_send_cursor(socket,
@@ -291,6 +614,66 @@ void guac_display_dup(guac_display* display, guac_socket* socket) {
 
 }
 
+void guac_display_park(guac_display* display) {
+
+    /* Drop the cached PNG encodings of each layer's last frame. These exist
+     * only to accelerate synchronization of late-joining users and are
+     * rebuilt lazily by guac_display_dup() when next needed */
+    guac_rwlock_acquire_write_lock(&display->last_frame.lock);
+
+    guac_display_layer* current = display->last_frame.layers;
+    while (current != NULL) {
+
+        guac_mem_free(current->last_frame_png);
+        current->last_frame_png = NULL;
+        current->last_frame_png_size = 0;
+
+        current = current->last_frame.next;
+
+    }
+
+    guac_rwlock_release_lock(&display->last_frame.lock);
+
+    /* Free the plan retained for reuse between frames (the next frame will
+     * simply allocate a fresh plan) */
+    guac_fifo_lock(&display->ops);
+
+    guac_display_plan* spare_plan = display->spare_plan;
+    display->spare_plan = NULL;
+
+    guac_fifo_unlock(&display->ops);
+
+    if (spare_plan != NULL) {
+        guac_mem_free(spare_plan->ops);
+        guac_mem_free(spare_plan);
+    }
+
+    /* Invalidate all entries of the client-side tile cache and release the
+     * pages backing the server-side mirror. The cache will repopulate
+     * naturally as tiles are stored by future frames (the stale contents of
+     * the client-side buffer are harmless, as invalidated slots cannot be
+     * recalled and are fully overwritten before being stored to again) */
+    pthread_mutex_lock(&display->tile_cache_lock);
+
+    memset(display->tile_cache, 0, sizeof(display->tile_cache));
+    guac_mem_advise_unneeded(display->tile_cache_data,
+            GUAC_DISPLAY_TILE_CACHE_ROWS * GUAC_DISPLAY_CELL_SIZE
+                * GUAC_DISPLAY_TILE_CACHE_STRIDE);
+
+    pthread_mutex_unlock(&display->tile_cache_lock);
+
+    /* Invalidate the client-side cursor cache in the same way */
+    pthread_mutex_lock(&display->cursor_cache_lock);
+
+    memset(display->cursor_cache, 0, sizeof(display->cursor_cache));
+    guac_mem_advise_unneeded(display->cursor_cache_data,
+            GUAC_DISPLAY_CURSOR_CACHE_SLOT_SIZE
+                * GUAC_DISPLAY_CURSOR_CACHE_STRIDE);
+
+    pthread_mutex_unlock(&display->cursor_cache_lock);
+
+}
+
 void guac_display_notify_user_left(guac_display* display, guac_user* user) {
     guac_rwlock_acquire_write_lock(&display->pending_frame.lock);
 
@@ -301,6 +684,66 @@ void guac_display_notify_user_left(guac_display* display, guac_user* user) {
     guac_rwlock_release_lock(&display->pending_frame.lock);
 }
 
+/**
+ * A pending update to the position and button state of the mouse cursor, as
+ * reported by one of the users of the connection. Used to broadcast cursor
+ * state to all other users without waiting on the frame pipeline.
+ */
+typedef struct guac_display_cursor_update {
+
+    /**
+     * The user that moved the mouse cursor. This user is excluded from the
+     * broadcast, as they already know where their own cursor is.
+     */
+    guac_user* mover;
+
+    /**
+     * The X coordinate of the mouse cursor, in pixels.
+     */
+    int x;
+
+    /**
+     * The Y coordinate of the mouse cursor, in pixels.
+     */
+    int y;
+
+    /**
+     * An integer value representing the current state of each button, where
+     * the Nth bit within the integer is set to 1 if and only if the Nth mouse
+     * button is currently pressed.
+     */
+    int mask;
+
+} guac_display_cursor_update;
+
+/**
+ * Callback for guac_client_foreach_user() which immediately sends the given
+ * cursor state to any given user except the user that moved the cursor,
+ * flushing each user's socket such that the update is not held back by any
+ * frame currently being encoded.
+ *
+ * @param data
+ *     A pointer to the guac_display_cursor_update that should be broadcast
+ *     to all users except the user that moved the cursor.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guac_display_broadcast_cursor_update(guac_user* user, void* data) {
+
+    guac_display_cursor_update* update = (guac_display_cursor_update*) data;
+
+    /* Send cursor state only if the user is not moving the cursor */
+    if (user != update->mover) {
+        guac_protocol_send_mouse(user->socket, update->x, update->y,
+                update->mask, user->client->last_sent_timestamp);
+        guac_socket_flush(user->socket);
+    }
+
+    return NULL;
+
+}
+
 void guac_display_notify_user_moved_mouse(guac_display* display, guac_user* user, int x, int y, int mask) {
 
     guac_rwlock_acquire_write_lock(&display->pending_frame.lock);
@@ -308,9 +751,38 @@ void guac_display_notify_user_moved_mouse(guac_display* display, guac_user* user
     display->pending_frame.cursor_x = x;
     display->pending_frame.cursor_y = y;
     display->pending_frame.cursor_mask = mask;
+
+    /* Determine whether ending a mouse frame now would actually send the new
+     * cursor state promptly. If graphical changes are pending or the encode
+     * pipeline is busy, the resulting frame would be deferred until encoding
+     * catches up, delaying cursor feedback by however long the current frame
+     * takes to encode. */
+    guac_fifo_lock(&display->ops);
+    int frame_busy = (display->ops.state.value & GUAC_FIFO_STATE_NONEMPTY)
+        || display->active_workers || display->frame_deferred;
+    guac_fifo_unlock(&display->ops);
+
+    int bypass_frame = frame_busy || display->pending_frame_dirty_excluding_mouse;
+
     guac_rwlock_release_lock(&display->pending_frame.lock);
 
-    guac_display_end_mouse_frame(display);
+    /* Broadcast the new cursor state immediately if it would otherwise wait
+     * on the frame pipeline, keeping pointer latency flat even when encoding
+     * is saturated. The position remains part of the pending frame and will
+     * additionally be committed (and rebroadcast) by the next frame flush,
+     * keeping late joiners and the last_frame state consistent. */
+    if (bypass_frame) {
+        guac_display_cursor_update update = {
+            .mover = user,
+            .x = x,
+            .y = y,
+            .mask = mask
+        };
+        guac_client_foreach_user(display->client, guac_display_broadcast_cursor_update, &update);
+    }
+
+    else
+        guac_display_end_mouse_frame(display);
 
 }
 
@@ -22,6 +22,7 @@
 #include "encode-jpeg.h"
 #include "guacamole/mem.h"
 #include "guacamole/error.h"
+#include "guacamole/pixel.h"
 #include "guacamole/protocol.h"
 #include "guacamole/stream.h"
 #include "palette.h"
@@ -30,10 +31,112 @@
 #include <jpeglib.h>
 
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+/**
+ * Per-thread JPEG compression state. Creating and destroying a libjpeg
+ * compressor involves a non-trivial amount of setup and allocation, so each
+ * encoding thread instead creates its compressor once and reuses it for every
+ * image that thread encodes.
+ */
+typedef struct guac_jpeg_thread_state {
+
+    /**
+     * The libjpeg compression structure, created once per thread and reused
+     * for all JPEG images encoded by that thread.
+     */
+    struct jpeg_compress_struct cinfo;
+
+    /**
+     * The libjpeg error handler associated with cinfo.
+     */
+    struct jpeg_error_mgr jerr;
+
+#ifndef JCS_EXTENSIONS
+
+    /**
+     * Scratch buffer for converting scanlines from BGRx to RGB, grown as
+     * necessary to fit the widest image encoded by this thread so far. This
+     * buffer is needed only if the Turbo JPEG extensions are unavailable.
+     */
+    unsigned char* scanline_data;
+
+    /**
+     * The current size of the scanline_data buffer, in bytes.
+     */
+    size_t scanline_length;
+
+#endif
+
+} guac_jpeg_thread_state;
+
+/**
+ * Key for the thread-local guac_jpeg_thread_state of each thread that has
+ * encoded at least one JPEG image.
+ */
+static pthread_key_t  __guac_jpeg_state_key;
+static pthread_once_t __guac_jpeg_state_key_init = PTHREAD_ONCE_INIT;
+
+/**
+ * Destructor invoked at thread exit which frees all resources associated with
+ * the thread's JPEG compression state.
+ *
+ * @param pointer
+ *     The guac_jpeg_thread_state to free.
+ */
+static void __guac_jpeg_free_state(void* pointer) {
+
+    guac_jpeg_thread_state* state = (guac_jpeg_thread_state*) pointer;
+
+    jpeg_destroy_compress(&state->cinfo);
+
+#ifndef JCS_EXTENSIONS
+    guac_mem_free(state->scanline_data);
+#endif
+
+    guac_mem_free(state);
+
+}
+
+static void __guac_jpeg_alloc_state_key() {
+
+    /* Create key, destroying each thread's compression state on thread exit */
+    pthread_key_create(&__guac_jpeg_state_key, __guac_jpeg_free_state);
+
+}
+
+/**
+ * Returns the JPEG compression state of the current thread, creating and
+ * initializing that state (including the underlying libjpeg compressor) if
+ * the current thread has not yet encoded any JPEG images.
+ *
+ * @return
+ *     The JPEG compression state of the current thread.
+ */
+static guac_jpeg_thread_state* guac_jpeg_get_thread_state() {
+
+    /* Init state key, if not already initialized */
+    pthread_once(&__guac_jpeg_state_key_init, __guac_jpeg_alloc_state_key);
+
+    /* Retrieve thread-local compression state */
+    guac_jpeg_thread_state* state =
+        (guac_jpeg_thread_state*) pthread_getspecific(__guac_jpeg_state_key);
+
+    /* Create compressor for current thread if not already created */
+    if (state == NULL) {
+        state = guac_mem_zalloc(sizeof(guac_jpeg_thread_state));
+        state->cinfo.err = jpeg_std_error(&state->jerr);
+        jpeg_create_compress(&state->cinfo);
+        pthread_setspecific(__guac_jpeg_state_key, state);
+    }
+
+    return state;
+
+}
+
 /**
  * Extended version of the standard libjpeg jpeg_destination_mgr struct, which
  * provides access to the pointers to the output buffer and size. The values
@@ -186,46 +289,53 @@ int guac_jpeg_write(guac_socket* socket, guac_stream* stream,
     /* Flush pending operations to surface */
     cairo_surface_flush(surface);
 
-    /* Prepare JPEG bits */
-    struct jpeg_compress_struct cinfo;
-    struct jpeg_error_mgr jerr;
-    cinfo.err = jpeg_std_error(&jerr);
-    jpeg_create_compress(&cinfo);
+    /* Reuse the compressor already created for the current thread, creating
+     * it if this is the thread's first image */
+    guac_jpeg_thread_state* state = guac_jpeg_get_thread_state();
+    struct jpeg_compress_struct* cinfo = &state->cinfo;
 
     /* Write JPEG directly to given stream */
-    jpeg_guac_dest(&cinfo, socket, stream);
+    jpeg_guac_dest(cinfo, socket, stream);
 
-    cinfo.image_width = width; /* image width and height, in pixels */
-    cinfo.image_height = height;
-    cinfo.arith_code = TRUE;
+    cinfo->image_width = width; /* image width and height, in pixels */
+    cinfo->image_height = height;
+    cinfo->arith_code = TRUE;
 
 #ifdef JCS_EXTENSIONS
     /* The Turbo JPEG extensions allows us to use the Cairo surface
      * (BGRx) as input without converting it */
-    cinfo.input_components = 4;
-    cinfo.in_color_space = JCS_EXT_BGRX;
+    cinfo->input_components = 4;
+    cinfo->in_color_space = JCS_EXT_BGRX;
 #else
     /* Standard JPEG supports RGB as input so we will have to convert
      * the contents of the Cairo surface from (BGRx) to RGB */
-    cinfo.input_components = 3;
-    cinfo.in_color_space = JCS_RGB;
+    cinfo->input_components = 3;
+    cinfo->in_color_space = JCS_RGB;
+
+    /* Grow the cached scanline conversion buffer if it cannot hold a full
+     * row of converted pixels (BGRx -> RGB) */
+    size_t scanline_length = guac_mem_ckd_mul_or_die(cinfo->image_width,
+            cinfo->input_components);
+    if (state->scanline_length < scanline_length) {
+        guac_mem_free(state->scanline_data);
+        state->scanline_data = guac_mem_zalloc(scanline_length);
+        state->scanline_length = scanline_length;
+    }
 
-    /* Create a buffer for the write scan line which is where we will
-     * put the converted pixels (BGRx -> RGB) */
-    unsigned char *scanline_data = guac_mem_zalloc(cinfo.image_width, cinfo.input_components);
+    unsigned char *scanline_data = state->scanline_data;
 #endif
 
     /* Initialize the JPEG compressor */
-    jpeg_set_defaults(&cinfo);
-    jpeg_set_quality(&cinfo, quality, TRUE /* limit to baseline-JPEG values */);
-    jpeg_start_compress(&cinfo, TRUE);
+    jpeg_set_defaults(cinfo);
+    jpeg_set_quality(cinfo, quality, TRUE /* limit to baseline-JPEG values */);
+    jpeg_start_compress(cinfo, TRUE);
 
     JSAMPROW row_pointer[1]; /* pointer to a single row */
 
     /* Write scanlines to be used in JPEG compression */
-    while (cinfo.next_scanline < cinfo.image_height) {
+    while (cinfo->next_scanline < cinfo->image_height) {
 
-        int row_offset = stride * cinfo.next_scanline;
+        int row_offset = stride * cinfo->next_scanline;
 
 #ifdef JCS_EXTENSIONS
         /* In Turbo JPEG we can use the raw BGRx scanline  */
@@ -233,34 +343,18 @@ int guac_jpeg_write(guac_socket* socket, guac_stream* stream,
 #else
         /* For standard JPEG libraries we have to convert the
          * scanline from 24 bit (4 byte) BGRx to 24 bit (3 byte) RGB */
-        unsigned char *inptr = data + row_offset;
-        unsigned char *outptr = scanline_data;
-
-        for (int x = 0; x < width; ++x) {
-
-            outptr[2] = *inptr++; /* B */
-            outptr[1] = *inptr++; /* G */
-            outptr[0] = *inptr++; /* R */
-            inptr++; /* skip the upper byte (x/A) */
-            outptr += 3;
-
-        }
+        guac_pixel_pack_rgb(scanline_data,
+                (const uint32_t*) (data + row_offset), width);
 
         row_pointer[0] = scanline_data;
 #endif
 
-        jpeg_write_scanlines(&cinfo, row_pointer, 1);
+        jpeg_write_scanlines(cinfo, row_pointer, 1);
     }
 
-#ifndef JCS_EXTENSIONS
-    guac_mem_free(scanline_data);
-#endif
-
-    /* Finalize compression */
-    jpeg_finish_compress(&cinfo);
-
-    /* Clean up */
-    jpeg_destroy_compress(&cinfo);
+    /* Finalize compression, leaving the compressor ready for reuse by the
+     * next image encoded by this thread */
+    jpeg_finish_compress(cinfo);
     return 0;
 
 }
@@ -34,28 +34,128 @@
 #endif
 
 #include <inttypes.h>
+#include <pthread.h>
 #include <setjmp.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+/**
+ * Per-thread PNG encoding state. Building the color palette and the
+ * palette-indexed copy of the image otherwise requires several heap
+ * allocations for every image encoded, so each encoding thread instead
+ * maintains its own scratch storage, grown as necessary and reused for every
+ * image that thread encodes.
+ */
+typedef struct guac_png_thread_state {
+
+    /**
+     * The palette of the image currently being encoded, reused for all PNG
+     * images encoded by this thread.
+     */
+    guac_palette palette;
+
+    /**
+     * Contiguous storage for the palette-indexed rows of the image currently
+     * being encoded, reused for all PNG images encoded by this thread.
+     */
+    png_byte* row_data;
+
+    /**
+     * The current size of the row_data buffer, in bytes.
+     */
+    size_t row_data_length;
+
+    /**
+     * Array of pointers to the beginning of each image row within row_data,
+     * as required by png_set_rows().
+     */
+    png_byte** rows;
+
+    /**
+     * The current size of the rows array, in rows.
+     */
+    size_t rows_length;
+
+} guac_png_thread_state;
+
+/**
+ * Key for the thread-local guac_png_thread_state of each thread that has
+ * encoded at least one PNG image.
+ */
+static pthread_key_t  __guac_png_state_key;
+static pthread_once_t __guac_png_state_key_init = PTHREAD_ONCE_INIT;
+
+/**
+ * Destructor invoked at thread exit which frees all resources associated with
+ * the thread's PNG encoding state.
+ *
+ * @param pointer
+ *     The guac_png_thread_state to free.
+ */
+static void __guac_png_free_state(void* pointer) {
+
+    guac_png_thread_state* state = (guac_png_thread_state*) pointer;
+
+    guac_mem_free(state->row_data);
+    guac_mem_free(state->rows);
+    guac_mem_free(state);
+
+}
+
+static void __guac_png_alloc_state_key() {
+
+    /* Create key, destroying each thread's encoding state on thread exit */
+    pthread_key_create(&__guac_png_state_key, __guac_png_free_state);
+
+}
+
+/**
+ * Returns the PNG encoding state of the current thread, creating that state
+ * if the current thread has not yet encoded any PNG images.
+ *
+ * @return
+ *     The PNG encoding state of the current thread.
+ */
+static guac_png_thread_state* guac_png_get_thread_state() {
+
+    /* Init state key, if not already initialized */
+    pthread_once(&__guac_png_state_key_init, __guac_png_alloc_state_key);
+
+    /* Retrieve thread-local encoding state */
+    guac_png_thread_state* state =
+        (guac_png_thread_state*) pthread_getspecific(__guac_png_state_key);
+
+    /* Create encoding state for current thread if not already created */
+    if (state == NULL) {
+        state = guac_mem_zalloc(sizeof(guac_png_thread_state));
+        pthread_setspecific(__guac_png_state_key, state);
+    }
+
+    return state;
+
+}
+
 /**
  * Data describing the current write state of PNG data.
  */
 typedef struct guac_png_write_state {
 
     /**
-     * The socket over which all PNG blobs will be written.
+     * The socket over which all PNG blobs will be written, or NULL if the
+     * PNG data should instead be written to an in-memory buffer.
      */
     guac_socket* socket;
 
     /**
-     * The Guacamole stream to associate with each PNG blob.
+     * The Guacamole stream to associate with each PNG blob. This value is
+     * not used if writing to an in-memory buffer.
      */
     guac_stream* stream;
 
     /**
-     * Buffer of pending PNG data.
+     * Buffer of pending PNG data. This buffer is not used if writing to an
+     * in-memory buffer.
      */
     char buffer[GUAC_PROTOCOL_BLOB_MAX_LENGTH];
 
@@ -64,17 +164,39 @@ typedef struct guac_png_write_state {
      */
     int buffer_size;
 
+    /**
+     * The dynamically-allocated in-memory buffer receiving all PNG data, if
+     * the socket is NULL.
+     */
+    unsigned char* data;
+
+    /**
+     * The number of bytes of PNG data currently stored in the in-memory
+     * buffer.
+     */
+    size_t data_size;
+
+    /**
+     * The current size of the in-memory buffer, in bytes.
+     */
+    size_t data_allocated;
+
 } guac_png_write_state;
 
 /**
  * Writes the contents of the PNG write state as a blob to its associated
- * socket.
+ * socket. If the write state is writing to an in-memory buffer rather than
+ * a socket, this function has no effect.
  *
  * @param write_state
  *     The write state to flush.
  */
 static void guac_png_flush_data(guac_png_write_state* write_state) {
 
+    /* In-memory output requires no flushing */
+    if (write_state->socket == NULL)
+        return;
+
     /* Send blob */
     guac_protocol_send_blob(write_state->socket, write_state->stream,
             write_state->buffer, write_state->buffer_size);
@@ -103,6 +225,31 @@ static void guac_png_write_data(guac_png_write_state* write_state,
 
     const unsigned char* current = data;
 
+    /* Append directly to the in-memory buffer if writing to memory rather
+     * than to a socket, growing the buffer as necessary */
+    if (write_state->socket == NULL) {
+
+        size_t required = guac_mem_ckd_add_or_die(write_state->data_size,
+                (size_t) length);
+
+        if (required > write_state->data_allocated) {
+
+            size_t allocated = write_state->data_allocated;
+            while (allocated < required)
+                allocated = guac_mem_ckd_mul_or_die(allocated, 2);
+
+            write_state->data = guac_mem_realloc_or_die(write_state->data,
+                    allocated);
+            write_state->data_allocated = allocated;
+
+        }
+
+        memcpy(write_state->data + write_state->data_size, current, length);
+        write_state->data_size = required;
+        return;
+
+    }
+
     /* Append all data given */
     while (length > 0) {
 
@@ -169,39 +316,30 @@ static cairo_status_t guac_png_cairo_write_handler(void* closure,
  * Implementation of guac_png_write() which uses Cairo's own PNG encoder to
  * write PNG data, rather than using libpng directly.
  *
- * @param socket
- *     The socket to send PNG blobs over.
- *
- * @param stream
- *     The stream to associate with each blob.
+ * @param write_state
+ *     The write state describing the destination of the encoded PNG data.
  *
  * @param surface
- *     The Cairo surface to write to the given stream and socket as PNG blobs.
+ *     The Cairo surface to write to the destination described by the given
+ *     write state.
  *
  * @return
  *     Zero if the encoding operation is successful, non-zero otherwise.
  */
-static int guac_png_cairo_write(guac_socket* socket, guac_stream* stream,
+static int guac_png_cairo_write(guac_png_write_state* write_state,
         cairo_surface_t* surface) {
 
-    guac_png_write_state write_state;
-
-    /* Init write state */
-    write_state.socket = socket;
-    write_state.stream = stream;
-    write_state.buffer_size = 0;
-
     /* Write surface as PNG */
     if (cairo_surface_write_to_png_stream(surface,
                 guac_png_cairo_write_handler,
-                &write_state) != CAIRO_STATUS_SUCCESS) {
+                write_state) != CAIRO_STATUS_SUCCESS) {
         guac_error = GUAC_STATUS_INTERNAL_ERROR;
         guac_error_message = "Cairo PNG backend failed";
         return -1;
     }
 
     /* Flush remaining PNG data */
-    guac_png_flush_data(&write_state);
+    guac_png_flush_data(write_state);
     return 0;
 
 }
@@ -268,6 +406,31 @@ static void guac_png_flush_handler(png_structp png) {
 
 int guac_png_write(guac_socket* socket, guac_stream* stream,
         cairo_surface_t* surface) {
+    return guac_png_write_level(socket, stream, surface, -1);
+}
+
+/**
+ * Encodes the given surface as a PNG using the given zlib compression level,
+ * writing the encoded data to the destination described by the given write
+ * state. This is the common implementation underlying guac_png_write_level()
+ * and guac_png_write_to_buffer().
+ *
+ * @param write_state
+ *     The write state describing the destination of the encoded PNG data.
+ *
+ * @param surface
+ *     The Cairo surface to write to the destination described by the given
+ *     write state.
+ *
+ * @param compression_level
+ *     The zlib compression level to use, where 0 is no compression and 9 is
+ *     maximum compression, or -1 to use the libpng default.
+ *
+ * @return
+ *     Zero if the encoding operation is successful, non-zero otherwise.
+ */
+static int guac_png_write_state_write(guac_png_write_state* write_state,
+        cairo_surface_t* surface, int compression_level) {
 
     png_structp png;
     png_infop png_info;
@@ -276,8 +439,6 @@ int guac_png_write(guac_socket* socket, guac_stream* stream,
 
     int x, y;
 
-    guac_png_write_state write_state;
-
     /* Get image surface properties and data */
     cairo_format_t format = cairo_image_surface_get_format(surface);
     int width = cairo_image_surface_get_width(surface);
@@ -287,17 +448,18 @@ int guac_png_write(guac_socket* socket, guac_stream* stream,
 
     /* If not RGB24, use Cairo PNG writer */
     if (format != CAIRO_FORMAT_RGB24 || data == NULL)
-        return guac_png_cairo_write(socket, stream, surface);
+        return guac_png_cairo_write(write_state, surface);
 
     /* Flush pending operations to surface */
     cairo_surface_flush(surface);
 
-    /* Attempt to build palette */
-    guac_palette* palette = guac_palette_alloc(surface);
+    /* Attempt to build palette within this thread's cached encoding state */
+    guac_png_thread_state* state = guac_png_get_thread_state();
+    guac_palette* palette = &state->palette;
 
     /* If not possible, resort to Cairo PNG writer */
-    if (palette == NULL)
-        return guac_png_cairo_write(socket, stream, surface);
+    if (guac_palette_init(palette, surface))
+        return guac_png_cairo_write(write_state, surface);
 
     /* Calculate BPP from palette size */
     if      (palette->size <= 2)  bpp = 1;
@@ -308,7 +470,6 @@ int guac_png_write(guac_socket* socket, guac_stream* stream,
     /* Set up PNG writer */
     png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
     if (!png) {
-        guac_palette_free(palette);
         guac_error = GUAC_STATUS_INTERNAL_ERROR;
         guac_error_message = "libpng failed to create write structure";
         return -1;
@@ -317,7 +478,6 @@ int guac_png_write(guac_socket* socket, guac_stream* stream,
     png_info = png_create_info_struct(png);
     if (!png_info) {
         png_destroy_write_struct(&png, NULL);
-        guac_palette_free(palette);
         guac_error = GUAC_STATUS_INTERNAL_ERROR;
         guac_error_message = "libpng failed to create info structure";
         return -1;
@@ -326,28 +486,42 @@ int guac_png_write(guac_socket* socket, guac_stream* stream,
     /* Set error handler */
     if (setjmp(png_jmpbuf(png))) {
         png_destroy_write_struct(&png, &png_info);
-        guac_palette_free(palette);
         guac_error = GUAC_STATUS_IO_ERROR;
         guac_error_message = "libpng output error";
         return -1;
     }
 
-    /* Init write state */
-    write_state.socket = socket;
-    write_state.stream = stream;
-    write_state.buffer_size = 0;
-
     /* Set up writer */
-    png_set_write_fn(png, &write_state,
+    png_set_write_fn(png, write_state,
             guac_png_write_handler,
             guac_png_flush_handler);
 
+    /* Apply requested compression level, if any (retaining the libpng default
+     * otherwise) */
+    if (compression_level >= 0)
+        png_set_compression_level(png, compression_level);
+
+    /* Grow cached row storage if too small for this image */
+    size_t required_data = guac_mem_ckd_mul_or_die(width, height);
+    if (state->row_data_length < required_data) {
+        guac_mem_free(state->row_data);
+        state->row_data = guac_mem_alloc(required_data);
+        state->row_data_length = required_data;
+    }
+
+    /* Grow cached row pointer array if too small for this image */
+    if (state->rows_length < (size_t) height) {
+        guac_mem_free(state->rows);
+        state->rows = guac_mem_alloc(sizeof(png_byte*), height);
+        state->rows_length = height;
+    }
+
     /* Copy data from surface into PNG data */
-    png_rows = (png_byte**) guac_mem_alloc(sizeof(png_byte*), height);
+    png_rows = state->rows;
     for (y=0; y<height; y++) {
 
-        /* Allocate new PNG row */
-        png_byte* row = (png_byte*) guac_mem_alloc(sizeof(png_byte), width);
+        /* Point current row at its slice of the cached row storage */
+        png_byte* row = state->row_data + guac_mem_ckd_mul_or_die(y, width);
         png_rows[y] = row;
 
         /* Copy data from surface into current row */
@@ -386,19 +560,49 @@ int guac_png_write(guac_socket* socket, guac_stream* stream,
     png_set_rows(png, png_info, png_rows);
     png_write_png(png, png_info, PNG_TRANSFORM_PACKING, NULL);
 
-    /* Finish write */
+    /* Finish write (the palette and row storage are retained within the
+     * cached per-thread encoding state for reuse) */
     png_destroy_write_struct(&png, &png_info);
 
-    /* Free palette */
-    guac_palette_free(palette);
+    /* Ensure all data is written */
+    guac_png_flush_data(write_state);
+    return 0;
+
+}
 
-    /* Free PNG data */
-    for (y=0; y<height; y++)
-        guac_mem_free(png_rows[y]);
-    guac_mem_free(png_rows);
+int guac_png_write_level(guac_socket* socket, guac_stream* stream,
+        cairo_surface_t* surface, int compression_level) {
 
-    /* Ensure all data is written */
-    guac_png_flush_data(&write_state);
+    guac_png_write_state write_state = {
+        .socket = socket,
+        .stream = stream
+    };
+
+    return guac_png_write_state_write(&write_state, surface,
+            compression_level);
+
+}
+
+int guac_png_write_to_buffer(cairo_surface_t* surface, int compression_level,
+        unsigned char** data, size_t* length) {
+
+    /* Write to a dynamically-grown in-memory buffer (NULL socket) */
+    guac_png_write_state write_state = {
+        .data = guac_mem_alloc((size_t) GUAC_PROTOCOL_BLOB_MAX_LENGTH),
+        .data_allocated = GUAC_PROTOCOL_BLOB_MAX_LENGTH
+    };
+
+    if (write_state.data == NULL)
+        return -1;
+
+    if (guac_png_write_state_write(&write_state, surface,
+                compression_level)) {
+        guac_mem_free(write_state.data);
+        return -1;
+    }
+
+    *data = write_state.data;
+    *length = write_state.data_size;
     return 0;
 
 }
@@ -46,5 +46,61 @@
 int guac_png_write(guac_socket* socket, guac_stream* stream,
         cairo_surface_t* surface);
 
+/**
+ * Encodes the given surface as a PNG using the given zlib compression level,
+ * and sends the resulting data over the given stream and socket as blobs.
+ *
+ * The compression level applies only when the surface can be encoded using
+ * libguac's own palette-based encoder. Surfaces that cannot be encoded this
+ * way (non-opaque surfaces or surfaces with too many distinct colors) are
+ * instead written using Cairo's PNG writer, which provides no control over
+ * compression.
+ *
+ * @param socket
+ *     The socket to send PNG blobs over.
+ *
+ * @param stream
+ *     The stream to associate with each blob.
+ *
+ * @param surface
+ *     The Cairo surface to write to the given stream and socket as PNG blobs.
+ *
+ * @param compression_level
+ *     The zlib compression level to use, where 0 is no compression and 9 is
+ *     maximum compression, or -1 to use the libpng default.
+ *
+ * @return
+ *     Zero if the encoding operation is successful, non-zero otherwise.
+ */
+int guac_png_write_level(guac_socket* socket, guac_stream* stream,
+        cairo_surface_t* surface, int compression_level);
+
+/**
+ * Encodes the given surface as a PNG using the given zlib compression level,
+ * storing the resulting data in a newly-allocated buffer rather than sending
+ * it over a socket. The buffer must eventually be freed by the caller with
+ * guac_mem_free().
+ *
+ * @param surface
+ *     The Cairo surface to encode as PNG data.
+ *
+ * @param compression_level
+ *     The zlib compression level to use, where 0 is no compression and 9 is
+ *     maximum compression, or -1 to use the libpng default.
+ *
+ * @param data
+ *     A pointer that will receive the newly-allocated buffer of encoded PNG
+ *     data if encoding succeeds.
+ *
+ * @param length
+ *     A pointer that will receive the number of bytes of encoded PNG data if
+ *     encoding succeeds.
+ *
+ * @return
+ *     Zero if the encoding operation is successful, non-zero otherwise.
+ */
+int guac_png_write_to_buffer(cairo_surface_t* surface, int compression_level,
+        unsigned char** data, size_t* length);
+
 #endif
 
@@ -21,6 +21,8 @@
 
 #include "encode-webp.h"
 #include "guacamole/error.h"
+#include "guacamole/mem.h"
+#include "guacamole/pixel.h"
 #include "guacamole/protocol.h"
 #include "guacamole/stream.h"
 #include "palette.h"
@@ -30,10 +32,88 @@
 
 #include <assert.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+/**
+ * Per-thread WebP encoding state. WebPPictureAlloc() otherwise allocates and
+ * frees a full ARGB plane for every image encoded, so each encoding thread
+ * instead maintains its own input buffer, grown as necessary and reused for
+ * every image that thread encodes.
+ */
+typedef struct guac_webp_thread_state {
+
+    /**
+     * Buffer of ARGB image data serving as encoder input, reused for all WebP
+     * images encoded by this thread.
+     */
+    uint32_t* argb_buffer;
+
+    /**
+     * The current size of the argb_buffer, in pixels.
+     */
+    size_t argb_length;
+
+} guac_webp_thread_state;
+
+/**
+ * Key for the thread-local guac_webp_thread_state of each thread that has
+ * encoded at least one WebP image.
+ */
+static pthread_key_t  __guac_webp_state_key;
+static pthread_once_t __guac_webp_state_key_init = PTHREAD_ONCE_INIT;
+
+/**
+ * Destructor invoked at thread exit which frees all resources associated with
+ * the thread's WebP encoding state.
+ *
+ * @param pointer
+ *     The guac_webp_thread_state to free.
+ */
+static void __guac_webp_free_state(void* pointer) {
+
+    guac_webp_thread_state* state = (guac_webp_thread_state*) pointer;
+
+    guac_mem_free(state->argb_buffer);
+    guac_mem_free(state);
+
+}
+
+static void __guac_webp_alloc_state_key() {
+
+    /* Create key, destroying each thread's encoding state on thread exit */
+    pthread_key_create(&__guac_webp_state_key, __guac_webp_free_state);
+
+}
+
+/**
+ * Returns the WebP encoding state of the current thread, creating that state
+ * if the current thread has not yet encoded any WebP images.
+ *
+ * @return
+ *     The WebP encoding state of the current thread.
+ */
+static guac_webp_thread_state* guac_webp_get_thread_state() {
+
+    /* Init state key, if not already initialized */
+    pthread_once(&__guac_webp_state_key_init, __guac_webp_alloc_state_key);
+
+    /* Retrieve thread-local encoding state */
+    guac_webp_thread_state* state =
+        (guac_webp_thread_state*) pthread_getspecific(__guac_webp_state_key);
+
+    /* Create encoding state for current thread if not already created */
+    if (state == NULL) {
+        state = guac_mem_zalloc(sizeof(guac_webp_thread_state));
+        pthread_setspecific(__guac_webp_state_key, state);
+    }
+
+    return state;
+
+}
+
 /**
  * Structure which describes the current state of the WebP image writer.
  */
@@ -169,7 +249,7 @@ int guac_webp_write(guac_socket* socket, guac_stream* stream,
     WebPPicture picture;
     uint32_t* argb_output;
 
-    int x, y;
+    int y;
 
     int width = cairo_image_surface_get_width(surface);
     int height = cairo_image_surface_get_height(surface);
@@ -202,6 +282,16 @@ int guac_webp_write(guac_socket* socket, guac_stream* stream,
         return -1;
     }
 
+    /* Grow the current thread's cached input buffer if it cannot hold the
+     * image being encoded */
+    guac_webp_thread_state* state = guac_webp_get_thread_state();
+    size_t argb_length = guac_mem_ckd_mul_or_die(width, height);
+    if (state->argb_length < argb_length) {
+        guac_mem_free(state->argb_buffer);
+        state->argb_buffer = guac_mem_alloc(argb_length, sizeof(uint32_t));
+        state->argb_length = argb_length;
+    }
+
     /* Set up WebP picture */
     if (!WebPPictureInit(&picture)) {
         return -1;
@@ -210,38 +300,29 @@ int guac_webp_write(guac_socket* socket, guac_stream* stream,
     picture.width = width;
     picture.height = height;
 
-    /* Allocate and init writer */
-    if (!WebPPictureAlloc(&picture)) {
-        return -1;
-    }
+    /* Use the thread's cached buffer as encoder input rather than having
+     * libwebp allocate a fresh ARGB plane via WebPPictureAlloc(). As the
+     * buffer is externally owned, libwebp will not attempt to free it, and
+     * WebPPictureFree() releases only the internal planes allocated during
+     * encoding. */
+    picture.argb = state->argb_buffer;
+    picture.argb_stride = width;
+
+    /* Init writer */
     picture.writer = guac_webp_stream_write;
     picture.custom_ptr = &writer;
     guac_webp_stream_writer_init(&writer, socket, stream);
 
-    /* Copy image data into WebP picture */
+    /* Copy image data into WebP picture, forcing the alpha channel of each
+     * pixel to fully opaque if the source surface has no alpha channel (the
+     * high-order byte of an RGB24 surface is undefined) */
     argb_output = picture.argb;
     for (y = 0; y < height; y++) {
 
-        /* Get pixels at start of each row */
-        uint32_t* src = (uint32_t*) data;
-        uint32_t* dst = argb_output;
-
-        /* For each pixel in row */
-        for (x = 0; x < width; x++) {
-
-            /* Pull pixel data, removing alpha channel if necessary */
-            uint32_t src_pixel = *src;
-            if (format != CAIRO_FORMAT_ARGB32)
-                src_pixel |= 0xFF000000;
-
-            /* Store converted pixel data */
-            *dst = src_pixel;
-
-            /* Next pixel */
-            src++;
-            dst++;
-
-        }
+        if (format != CAIRO_FORMAT_ARGB32)
+            guac_pixel_fill_alpha(argb_output, (const uint32_t*) data, width);
+        else
+            memcpy(argb_output, data, width * sizeof(uint32_t));
 
         /* Next row */
         data += stride;
@@ -252,7 +333,8 @@ int guac_webp_write(guac_socket* socket, guac_stream* stream,
     /* Encode image */
     const int result = WebPEncode(&config, &picture) ? 0 : -1;
 
-    /* Free picture */
+    /* Free internal picture planes (the cached input buffer is externally
+     * owned and remains valid for the next image) */
     WebPPictureFree(&picture);
 
     /* Ensure all data is written */
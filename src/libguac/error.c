@@ -167,7 +167,35 @@ const char* guac_status_string(guac_status status) {
 
 }
 
-#ifdef HAVE_LIBPTHREAD
+#if defined(__GNUC__) || (defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L)
+
+/* Compiler thread-local implementation of __guac_error
+ *
+ * Where the compiler provides thread-local storage directly, guac_error and
+ * guac_error_message are backed by plain thread-local variables. Unlike the
+ * pthread key implementation below, reading or assigning guac_error then
+ * involves no pthread_getspecific() lookup and no heap allocation, which
+ * matters for hot paths like the instruction processing loops of the socket
+ * and parser, where guac_error is checked per operation. */
+
+#if defined(__GNUC__)
+#define GUAC_ERROR_THREAD_LOCAL __thread
+#else
+#define GUAC_ERROR_THREAD_LOCAL _Thread_local
+#endif
+
+static GUAC_ERROR_THREAD_LOCAL guac_status __guac_error_storage = GUAC_STATUS_SUCCESS;
+static GUAC_ERROR_THREAD_LOCAL const char* __guac_error_message_storage = NULL;
+
+guac_status* __guac_error() {
+    return &__guac_error_storage;
+}
+
+const char** __guac_error_message() {
+    return &__guac_error_message_storage;
+}
+
+#elif defined(HAVE_LIBPTHREAD)
 
 /* PThread implementation of __guac_error */
 
@@ -19,8 +19,11 @@
 
 #include "guacamole/fifo.h"
 #include "guacamole/flag.h"
+#include "guacamole/mem.h"
+#include "guacamole/timestamp.h"
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -38,12 +41,315 @@ void guac_fifo_init(guac_fifo* fifo, void* items,
     fifo->head = 0;
     fifo->item_count = 0;
 
+    /* Use the classic, lock-based implementation unless
+     * guac_fifo_init_lockfree() was invoked instead */
+    fifo->lockfree = 0;
+    fifo->ring_seq = NULL;
+
+}
+
+void guac_fifo_init_lockfree(guac_fifo* fifo, void* items,
+        size_t max_items, size_t item_size) {
+
+    guac_fifo_init(fifo, items, max_items, item_size);
+    fifo->lockfree = 1;
+
+    /* Each slot is initially ready to receive the item at its own position
+     * within the ring */
+    fifo->ring_seq = guac_mem_alloc(guac_mem_ckd_mul_or_die(max_items, sizeof(size_t)));
+    for (size_t i = 0; i < max_items; i++)
+        fifo->ring_seq[i] = i;
+
+    fifo->ring_head = 0;
+    fifo->ring_tail = 0;
+    fifo->waiting_consumers = 0;
+    fifo->waiting_producers = 0;
+
 }
 
 void guac_fifo_destroy(guac_fifo* fifo) {
+    guac_mem_free(fifo->ring_seq);
     guac_flag_destroy(&fifo->state);
 }
 
+/**
+ * Returns a pointer to the storage for the item at the given slot within the
+ * items array of the given guac_fifo.
+ *
+ * @param fifo
+ *     The guac_fifo to locate an item slot within.
+ *
+ * @param slot
+ *     The index of the slot within the items array.
+ *
+ * @return
+ *     A pointer to the storage for the item at the given slot.
+ */
+static void* guac_fifo_item(guac_fifo* fifo, size_t slot) {
+    return ((char*) fifo) + fifo->items_offset + fifo->item_size * slot;
+}
+
+/**
+ * Signals the given state flag bit of the given lock-free guac_fifo, but only
+ * if at least one thread is currently registered as waiting on that bit. The
+ * full fence guarantees that any thread which registered itself before this
+ * enqueue/dequeue completed will observe the signal, while threads that
+ * register afterwards will instead observe the completed operation when they
+ * retry prior to sleeping.
+ *
+ * @param fifo
+ *     The lock-free guac_fifo to signal.
+ *
+ * @param waiters
+ *     The count of threads currently waiting on the given bit (either
+ *     waiting_consumers or waiting_producers).
+ *
+ * @param flag
+ *     The state flag bit to set if any threads are waiting.
+ */
+static void guac_fifo_lockfree_wake(guac_fifo* fifo, int* waiters,
+        unsigned int flag) {
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(waiters, __ATOMIC_RELAXED) > 0)
+        guac_flag_set(&fifo->state, flag);
+
+}
+
+/**
+ * Attempts to add a copy of the given item to the end of the given lock-free
+ * guac_fifo without blocking, failing immediately if the ring is full.
+ *
+ * @param fifo
+ *     The lock-free guac_fifo to add an item to.
+ *
+ * @param item
+ *     The item to add.
+ *
+ * @return
+ *     Non-zero if the item was successfully added, zero if the ring is full.
+ */
+static int guac_fifo_lockfree_try_enqueue(guac_fifo* fifo, const void* item) {
+
+    size_t pos = __atomic_load_n(&fifo->ring_tail, __ATOMIC_RELAXED);
+    for (;;) {
+
+        size_t* seq = &fifo->ring_seq[pos % fifo->max_items];
+        intptr_t dif = (intptr_t) __atomic_load_n(seq, __ATOMIC_ACQUIRE)
+            - (intptr_t) pos;
+
+        /* Slot is ready to receive the item at this position; attempt to
+         * claim it, retrying from the updated tail if another producer claims
+         * it first */
+        if (dif == 0) {
+            if (__atomic_compare_exchange_n(&fifo->ring_tail, &pos, pos + 1,
+                        1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+
+                memcpy(guac_fifo_item(fifo, pos % fifo->max_items), item,
+                        fifo->item_size);
+
+                /* Mark the slot as containing a completed item */
+                __atomic_store_n(seq, pos + 1, __ATOMIC_RELEASE);
+
+                guac_fifo_lockfree_wake(fifo, &fifo->waiting_consumers,
+                        GUAC_FIFO_STATE_NONEMPTY);
+                return 1;
+
+            }
+        }
+
+        /* Slot still contains an item from the previous lap: the ring is
+         * full */
+        else if (dif < 0)
+            return 0;
+
+        /* Slot was claimed by another producer; retry from the updated
+         * tail */
+        else
+            pos = __atomic_load_n(&fifo->ring_tail, __ATOMIC_RELAXED);
+
+    }
+
+}
+
+/**
+ * Attempts to remove the oldest item from the given lock-free guac_fifo
+ * without blocking, failing immediately if the ring is empty.
+ *
+ * @param fifo
+ *     The lock-free guac_fifo to remove an item from.
+ *
+ * @param item
+ *     The buffer that should receive a copy of the removed item.
+ *
+ * @return
+ *     Non-zero if an item was successfully removed, zero if the ring is
+ *     empty.
+ */
+static int guac_fifo_lockfree_try_dequeue(guac_fifo* fifo, void* item) {
+
+    size_t pos = __atomic_load_n(&fifo->ring_head, __ATOMIC_RELAXED);
+    for (;;) {
+
+        size_t* seq = &fifo->ring_seq[pos % fifo->max_items];
+        intptr_t dif = (intptr_t) __atomic_load_n(seq, __ATOMIC_ACQUIRE)
+            - (intptr_t) (pos + 1);
+
+        /* Slot contains a completed item at this position; attempt to claim
+         * it, retrying from the updated head if another consumer claims it
+         * first */
+        if (dif == 0) {
+            if (__atomic_compare_exchange_n(&fifo->ring_head, &pos, pos + 1,
+                        1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+
+                memcpy(item, guac_fifo_item(fifo, pos % fifo->max_items),
+                        fifo->item_size);
+
+                /* Mark the slot as ready to receive the item at the same
+                 * position within the next lap */
+                __atomic_store_n(seq, pos + fifo->max_items, __ATOMIC_RELEASE);
+
+                guac_fifo_lockfree_wake(fifo, &fifo->waiting_producers,
+                        GUAC_FIFO_STATE_READY);
+                return 1;
+
+            }
+        }
+
+        /* Slot has not yet received an item for this lap: the ring is
+         * empty */
+        else if (dif < 0)
+            return 0;
+
+        /* Slot was claimed by another consumer; retry from the updated
+         * head */
+        else
+            pos = __atomic_load_n(&fifo->ring_head, __ATOMIC_RELAXED);
+
+    }
+
+}
+
+/**
+ * Adds a copy of the given item to the end of the given lock-free guac_fifo,
+ * blocking (sleeping on the FIFO's state flag) until space is available if
+ * the ring is full. If the FIFO is invalid or becomes invalid, this function
+ * returns immediately.
+ *
+ * @param fifo
+ *     The lock-free guac_fifo to add an item to.
+ *
+ * @param item
+ *     The item to add.
+ *
+ * @return
+ *     Non-zero if the item was successfully added, zero if items cannot be
+ *     added because the FIFO has been invalidated.
+ */
+static int guac_fifo_lockfree_enqueue(guac_fifo* fifo, const void* item) {
+
+    for (;;) {
+
+        if (!guac_fifo_is_valid(fifo))
+            return 0;
+
+        if (guac_fifo_lockfree_try_enqueue(fifo, item))
+            return 1;
+
+        /* Register as a waiting producer and retry once more before
+         * sleeping, such that a dequeue which completed too early to see the
+         * registration cannot be missed */
+        __atomic_fetch_add(&fifo->waiting_producers, 1, __ATOMIC_SEQ_CST);
+        if (guac_fifo_lockfree_try_enqueue(fifo, item)) {
+            __atomic_fetch_sub(&fifo->waiting_producers, 1, __ATOMIC_SEQ_CST);
+            return 1;
+        }
+
+        /* Sleep until some consumer signals that space may be available,
+         * consuming the signal such that future sleeps are not spurious */
+        guac_flag_wait_and_lock(&fifo->state,
+                GUAC_FIFO_STATE_READY | GUAC_FIFO_STATE_INVALID);
+        guac_flag_clear(&fifo->state, GUAC_FIFO_STATE_READY);
+        guac_flag_unlock(&fifo->state);
+
+        __atomic_fetch_sub(&fifo->waiting_producers, 1, __ATOMIC_SEQ_CST);
+
+    }
+
+}
+
+/**
+ * Removes the oldest item from the given lock-free guac_fifo, blocking
+ * (sleeping on the FIFO's state flag) until an item is available if the ring
+ * is empty. If the FIFO is invalid or becomes invalid, this function returns
+ * immediately.
+ *
+ * @param fifo
+ *     The lock-free guac_fifo to remove an item from.
+ *
+ * @param item
+ *     The buffer that should receive a copy of the removed item.
+ *
+ * @param msec_timeout
+ *     The maximum number of milliseconds to wait for an item to become
+ *     available, or a negative value to wait indefinitely.
+ *
+ * @return
+ *     Non-zero if an item was successfully removed, zero if the timeout
+ *     elapsed or the FIFO has been invalidated.
+ */
+static int guac_fifo_lockfree_dequeue(guac_fifo* fifo, void* item,
+        int msec_timeout) {
+
+    guac_timestamp deadline = 0;
+    if (msec_timeout >= 0)
+        deadline = guac_timestamp_current() + msec_timeout;
+
+    for (;;) {
+
+        if (!guac_fifo_is_valid(fifo))
+            return 0;
+
+        if (guac_fifo_lockfree_try_dequeue(fifo, item))
+            return 1;
+
+        /* Register as a waiting consumer and retry once more before
+         * sleeping, such that an enqueue which completed too early to see
+         * the registration cannot be missed */
+        __atomic_fetch_add(&fifo->waiting_consumers, 1, __ATOMIC_SEQ_CST);
+        if (guac_fifo_lockfree_try_dequeue(fifo, item)) {
+            __atomic_fetch_sub(&fifo->waiting_consumers, 1, __ATOMIC_SEQ_CST);
+            return 1;
+        }
+
+        /* Sleep until some producer signals that an item may be available,
+         * consuming the signal such that future sleeps are not spurious */
+        if (msec_timeout < 0)
+            guac_flag_wait_and_lock(&fifo->state,
+                    GUAC_FIFO_STATE_NONEMPTY | GUAC_FIFO_STATE_INVALID);
+
+        else {
+
+            int remaining = (int) (deadline - guac_timestamp_current());
+            if (remaining <= 0 || !guac_flag_timedwait_and_lock(&fifo->state,
+                        GUAC_FIFO_STATE_NONEMPTY | GUAC_FIFO_STATE_INVALID,
+                        remaining)) {
+                __atomic_fetch_sub(&fifo->waiting_consumers, 1,
+                        __ATOMIC_SEQ_CST);
+                return 0;
+            }
+
+        }
+
+        guac_flag_clear(&fifo->state, GUAC_FIFO_STATE_NONEMPTY);
+        guac_flag_unlock(&fifo->state);
+
+        __atomic_fetch_sub(&fifo->waiting_consumers, 1, __ATOMIC_SEQ_CST);
+
+    }
+
+}
+
 void guac_fifo_invalidate(guac_fifo* fifo) {
     guac_flag_set(&fifo->state, GUAC_FIFO_STATE_INVALID);
 }
@@ -66,6 +372,9 @@ int guac_fifo_is_valid(guac_fifo* fifo) {
 int guac_fifo_enqueue(guac_fifo* fifo,
         const void* item) {
 
+    if (fifo->lockfree)
+        return guac_fifo_lockfree_enqueue(fifo, item);
+
     if (!guac_fifo_enqueue_and_lock(fifo, item))
         return 0;
 
@@ -77,6 +386,19 @@ int guac_fifo_enqueue(guac_fifo* fifo,
 int guac_fifo_enqueue_and_lock(guac_fifo* fifo,
         const void* item) {
 
+    /* For lock-free fifos, the item is added without excluding other
+     * enqueue/dequeue operations, and the state flag is locked only for the
+     * caller's own use */
+    if (fifo->lockfree) {
+
+        if (!guac_fifo_lockfree_enqueue(fifo, item))
+            return 0;
+
+        guac_flag_lock(&fifo->state);
+        return 1;
+
+    }
+
     /* Block until fifo is ready for further items OR until the fifo is
      * invalidated */
     guac_flag_wait_and_lock(&fifo->state,
@@ -117,6 +439,50 @@ int guac_fifo_enqueue_and_lock(guac_fifo* fifo,
 
 }
 
+int guac_fifo_try_enqueue(guac_fifo* fifo, const void* item) {
+
+    /* For lock-free fifos, simply attempt the enqueue, failing immediately
+     * rather than sleeping if the ring is full */
+    if (fifo->lockfree) {
+
+        if (!guac_fifo_is_valid(fifo))
+            return 0;
+
+        return guac_fifo_lockfree_try_enqueue(fifo, item);
+
+    }
+
+    guac_flag_lock(&fifo->state);
+
+    /* Bail out immediately (rather than wait) if the fifo is invalid or
+     * lacks space for further items */
+    if ((fifo->state.value & GUAC_FIFO_STATE_INVALID)
+            || !(fifo->state.value & GUAC_FIFO_STATE_READY)) {
+        guac_flag_unlock(&fifo->state);
+        return 0;
+    }
+
+    /* Update count of items within the fifo, clearing the readiness flag if
+     * there is no longer any space for further items */
+    fifo->item_count++;
+    if (fifo->item_count == fifo->max_items)
+        guac_flag_clear(&fifo->state, GUAC_FIFO_STATE_READY);
+
+    /* Copy data of item buffer into last item in fifo */
+    size_t tail = (fifo->head + fifo->item_count - 1) % fifo->max_items;
+    void* tail_item = ((char*) fifo) + fifo->items_offset + fifo->item_size * tail;
+    memcpy(tail_item, item, fifo->item_size);
+
+    /* Advise any waiting threads that the fifo is now non-empty */
+    guac_flag_set(&fifo->state, GUAC_FIFO_STATE_NONEMPTY);
+
+    guac_flag_unlock(&fifo->state);
+
+    /* Item enqueued successfully */
+    return 1;
+
+}
+
 /**
  * Dequeues a single item from the given guac_fifo, storing a copy
  * of that item in the provided buffer. The event fifo MUST be non-empty. The
@@ -151,6 +517,9 @@ static void dequeue(guac_fifo* fifo, void* item) {
 
 int guac_fifo_dequeue(guac_fifo* fifo, void* item) {
 
+    if (fifo->lockfree)
+        return guac_fifo_lockfree_dequeue(fifo, item, -1);
+
     if (!guac_fifo_dequeue_and_lock(fifo, item))
         return 0;
 
@@ -162,6 +531,9 @@ int guac_fifo_dequeue(guac_fifo* fifo, void* item) {
 int guac_fifo_timed_dequeue(guac_fifo* fifo,
         void* item, int msec_timeout) {
 
+    if (fifo->lockfree)
+        return guac_fifo_lockfree_dequeue(fifo, item, msec_timeout);
+
     if (!guac_fifo_timed_dequeue_and_lock(fifo, item, msec_timeout))
         return 0;
 
@@ -172,6 +544,19 @@ int guac_fifo_timed_dequeue(guac_fifo* fifo,
 
 int guac_fifo_dequeue_and_lock(guac_fifo* fifo, void* item) {
 
+    /* For lock-free fifos, the item is removed without excluding other
+     * enqueue/dequeue operations, and the state flag is locked only for the
+     * caller's own use */
+    if (fifo->lockfree) {
+
+        if (!guac_fifo_lockfree_dequeue(fifo, item, -1))
+            return 0;
+
+        guac_flag_lock(&fifo->state);
+        return 1;
+
+    }
+
     /* Block indefinitely while waiting for an item to be added, but bail out
      * if the fifo becomes invalid */
     guac_flag_wait_and_lock(&fifo->state,
@@ -187,9 +572,76 @@ int guac_fifo_dequeue_and_lock(guac_fifo* fifo, void* item) {
 
 }
 
+int guac_fifo_dequeue_batch(guac_fifo* fifo, void* items, int max_items) {
+
+    int dequeued = guac_fifo_dequeue_batch_and_lock(fifo, items, max_items);
+    if (!dequeued)
+        return 0;
+
+    guac_flag_unlock(&fifo->state);
+    return dequeued;
+
+}
+
+int guac_fifo_dequeue_batch_and_lock(guac_fifo* fifo, void* items,
+        int max_items) {
+
+    /* For lock-free fifos, block only for the first item, then opportunistically
+     * claim any further items that are immediately available */
+    if (fifo->lockfree) {
+
+        if (!guac_fifo_lockfree_dequeue(fifo, items, -1))
+            return 0;
+
+        int dequeued = 1;
+        while (dequeued < max_items && guac_fifo_lockfree_try_dequeue(fifo,
+                    (char*) items + fifo->item_size * dequeued))
+            dequeued++;
+
+        guac_flag_lock(&fifo->state);
+        return dequeued;
+
+    }
+
+    /* Block indefinitely while waiting for an item to be added, but bail out
+     * if the fifo becomes invalid */
+    guac_flag_wait_and_lock(&fifo->state,
+            GUAC_FIFO_STATE_NONEMPTY | GUAC_FIFO_STATE_INVALID);
+
+    if (fifo->state.value & GUAC_FIFO_STATE_INVALID) {
+        guac_flag_unlock(&fifo->state);
+        return 0;
+    }
+
+    /* Remove all immediately-available items, up to the given limit (at
+     * least one item is necessarily present, as the fifo is locked and
+     * non-empty) */
+    int dequeued = 0;
+    while (dequeued < max_items && fifo->item_count > 0) {
+        dequeue(fifo, (char*) items + fifo->item_size * dequeued);
+        dequeued++;
+    }
+
+    return dequeued;
+
+}
+
 int guac_fifo_timed_dequeue_and_lock(guac_fifo* fifo,
         void* item, int msec_timeout) {
 
+    /* For lock-free fifos, the item is removed without excluding other
+     * enqueue/dequeue operations, and the state flag is locked only for the
+     * caller's own use */
+    if (fifo->lockfree) {
+
+        if (!guac_fifo_lockfree_dequeue(fifo, item, msec_timeout))
+            return 0;
+
+        guac_flag_lock(&fifo->state);
+        return 1;
+
+    }
+
     /* Wait up to timeout for an item to be present in the fifo, failing if no
      * items enter the fifo before the timeout lapses */
     if (!guac_flag_timedwait_and_lock(&fifo->state,
@@ -0,0 +1,55 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_ALIGN_H
+#define GUAC_ALIGN_H
+
+/**
+ * Provides alignment-related macros used to control the memory layout of
+ * structures that are shared between threads.
+ *
+ * @file align.h
+ */
+
+/**
+ * The assumed size of a CPU cache line, in bytes. This is used to separate
+ * members that are frequently modified by different threads, such that those
+ * modifications do not cause false sharing. A value of 64 bytes is correct
+ * for essentially all current x86_64 and ARM64 hardware; for hardware with
+ * larger cache lines, the separation is simply less than a full line, and
+ * behavior is otherwise unaffected.
+ */
+#define GUAC_CACHE_LINE_SIZE 64
+
+/**
+ * Declares that a structure member should be aligned to the beginning of its
+ * own cache line. Annotating a member with this macro guarantees that it will
+ * be separated from the members before it, and (if the following member is
+ * also annotated) that no other annotated member will share its line.
+ *
+ * Note that this guarantee is relative to the start of the containing
+ * structure. Allocations made with malloc() and friends are only guaranteed
+ * to be aligned for standard types, so an annotated member of a dynamically-
+ * allocated structure may still straddle a line boundary; members annotated
+ * with this macro are nonetheless always at least a full cache line apart
+ * from each other.
+ */
+#define GUAC_ALIGNED_CACHE_LINE __attribute__((aligned(GUAC_CACHE_LINE_SIZE)))
+
+#endif
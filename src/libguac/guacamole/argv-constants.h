@@ -41,6 +41,17 @@
  */
 #define GUAC_ARGV_OPTION_ECHO 2
 
+/**
+ * Option flag which declares to guac_argv_register() that values received for
+ * the associated argument should be processed only if they actually differ
+ * from the most recently accepted value. Received values that are identical
+ * to the current value are acknowledged but otherwise ignored, invoking
+ * neither the registered callback nor the echo requested via
+ * GUAC_ARGV_OPTION_ECHO. Changes are detected by comparing 64-bit hashes of
+ * the received mimetype and value.
+ */
+#define GUAC_ARGV_OPTION_IF_CHANGED 4
+
 /**
  * The maximum number of bytes to allow for any argument value received via an
  * argv stream and processed using guac_argv_received(), including null
@@ -44,6 +44,7 @@
  *
  * @see GUAC_ARGV_OPTION_ONCE
  * @see GUAC_ARGV_OPTION_ECHO
+ * @see GUAC_ARGV_OPTION_IF_CHANGED
  *
  * @param name
  *     The name of the argument that should be handled by the given callback.
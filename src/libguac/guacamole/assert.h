@@ -44,4 +44,17 @@
         }                                                                     \
     } while(0)
 
+/**
+ * Verifies that the given expression is true at compile time, failing the
+ * build with an error naming the expression if it is not. The expression must
+ * be an integer constant expression. This is primarily useful for locking in
+ * assumptions about structure layout, such as the cache-line separation of
+ * members that are modified by different threads.
+ *
+ * @param expression
+ *     The condition to test at compile time.
+ */
+#define GUAC_STATIC_ASSERT(expression) \
+    _Static_assert(expression, #expression)
+
 #endif
@@ -26,6 +26,7 @@
  * @file client.h
  */
 
+#include "align.h"
 #include "client-fntypes.h"
 #include "client-types.h"
 #include "client-constants.h"
@@ -170,9 +171,11 @@ struct guac_client {
 
     /**
      * Lock which is acquired when the users list is being manipulated, or when
-     * the users list is being iterated.
+     * the users list is being iterated. This member is kept on its own cache
+     * line, as it is acquired by every user's I/O threads and would otherwise
+     * contend with reads of neighboring members.
      */
-    guac_rwlock __users_lock;
+    guac_rwlock __users_lock GUAC_ALIGNED_CACHE_LINE;
 
     /**
      * The first user within the list of all connected users, or NULL if no
@@ -183,9 +186,11 @@ struct guac_client {
     /**
      * Lock which is acquired when the pending users list is being manipulated,
      * or iterated, or when checking/altering the
-     * __pending_users_thread_started flag.
+     * __pending_users_thread_started flag. This member is kept on its own
+     * cache line so that pending-user synchronization does not contend with
+     * the unrelated (and frequently acquired) __users_lock.
      */
-    guac_rwlock __pending_users_lock;
+    guac_rwlock __pending_users_lock GUAC_ALIGNED_CACHE_LINE;
 
     /**
      * A timer that will periodically synchronize the list of pending users,
@@ -304,6 +309,36 @@ struct guac_client {
      */
     const char** args;
 
+    /**
+     * Non-zero if runs of mouse events which report only movement (the
+     * button mask is unchanged) may be collapsed to the latest reported
+     * position before being dispatched to the mouse handler, rather than
+     * each being dispatched individually. Clients which treat mouse events
+     * purely as pointer state (forwarding the latest position to the remote
+     * desktop) should opt in by setting this flag within guac_client_init,
+     * avoiding redundant per-event dispatch overhead for users with
+     * high-frequency pointing devices. Clients which interpret the path of
+     * the pointer itself must leave this flag unset. Mouse events which
+     * change the button mask are never collapsed.
+     */
+    int coalesce_mouse_events;
+
+    /**
+     * The "args" instruction advertising the arguments accepted by this
+     * client, rendered once after the client plugin has been loaded and
+     * reused verbatim for the handshake of each user that joins the
+     * connection. This will be NULL if the instruction has not been rendered,
+     * in which case the instruction must be built from the args array
+     * directly. For internal use only.
+     */
+    char* __cached_args;
+
+    /**
+     * The length of the rendered "args" instruction, in bytes. This value is
+     * meaningful only if __cached_args is non-NULL. For internal use only.
+     */
+    size_t __cached_args_length;
+
     /**
      * Handle to the dlopen()'d plugin, which should be given to dlclose() when
      * this client is freed. This is only assigned if guac_client_load_plugin()
@@ -638,6 +673,24 @@ int guac_client_end_multiple_frames(guac_client* client, int frames);
  */
 int guac_client_load_plugin(guac_client* client, const char* protocol);
 
+/**
+ * Loads the plugin corresponding to the named protocol into the current
+ * process without initializing any client, resolving all of its symbols
+ * immediately. The plugin remains loaded for the life of the process.
+ *
+ * Preloading a plugin within a parent process ensures that any processes
+ * forked later inherit the fully-relocated plugin mapping copy-on-write,
+ * such that loading the plugin via guac_client_load_plugin() within those
+ * processes involves no dynamic-linker work beyond a reference count bump.
+ *
+ * @param protocol
+ *     The name of the protocol whose plugin should be preloaded.
+ *
+ * @return
+ *     Zero if the plugin was successfully preloaded, non-zero otherwise.
+ */
+int guac_client_preload_plugin(const char* protocol);
+
 /**
  * Calculates and returns the approximate processing lag experienced by the
  * pool of users. The processing lag is the difference in time between server
@@ -890,6 +943,40 @@ int guac_client_owner_notify_leave(guac_client* client, guac_user* quitter);
  */
 int guac_client_supports_webp(guac_client* client);
 
+/**
+ * Returns whether all users of the given client support the cells
+ * instruction, as declared by the presence of the
+ * GUAC_PROTOCOL_CELLS_MIMETYPE pseudo mimetype within the list of supported
+ * image mimetypes provided by each user during the connection handshake. If
+ * any user does not support the cells instruction, zero is returned.
+ *
+ * @param client
+ *     The Guacamole client whose users should be checked for cells
+ *     instruction support.
+ *
+ * @return
+ *     Non-zero if all users of the given client claim to support the cells
+ *     instruction, zero otherwise.
+ */
+int guac_client_supports_cell_runs(guac_client* client);
+
+/**
+ * Returns whether all users of the given client support receiving video
+ * streams of the given mimetype, as declared by the list of supported video
+ * mimetypes provided by each user during the connection handshake.
+ *
+ * @param client
+ *     The client to check.
+ *
+ * @param mimetype
+ *     The video mimetype to check for, such as "video/h264".
+ *
+ * @return
+ *     Non-zero if all users of the given client claim to support video
+ *     streams of the given mimetype, zero otherwise.
+ */
+int guac_client_supports_video(guac_client* client, const char* mimetype);
+
 /**
  * The default Guacamole client layer, layer 0.
  */
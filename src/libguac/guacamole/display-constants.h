@@ -49,6 +49,20 @@
  */
 #define GUAC_DISPLAY_LAYER_RAW_BPP 4
 
+/**
+ * The maximum number of explicit copy hints that may be associated with the
+ * pending frame of any single layer. Hints provided beyond this limit are
+ * ignored, with the affected regions instead being handled by the heuristic
+ * scroll/copy search or sent as image data.
+ */
+#define GUAC_DISPLAY_MAX_COPY_HINTS 16
+
+/**
+ * The minimum amount of time that must elapse between summaries of display
+ * rendering statistics logged at the "debug" log level, in milliseconds.
+ */
+#define GUAC_DISPLAY_STATS_LOG_INTERVAL 5000
+
 /**
  * @}
  */
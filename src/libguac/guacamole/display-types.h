@@ -69,6 +69,13 @@ typedef struct guac_display_layer_cairo_context guac_display_layer_cairo_context
  */
 typedef struct guac_display_layer_raw_context guac_display_layer_raw_context;
 
+/**
+ * A hint that the contents of one rectangular region of a layer have been
+ * copied from another region of that same layer, such as occurs when
+ * scrolling.
+ */
+typedef struct guac_display_copy_hint guac_display_copy_hint;
+
 /**
  * Pre-defined mouse cursor graphics.
  */
@@ -49,6 +49,7 @@
 #include "socket.h"
 
 #include <cairo/cairo.h>
+#include <stdint.h>
 #include <unistd.h>
 
 /**
@@ -74,6 +75,31 @@
 #define GUAC_DISPLAY_LAYER_RAW_BUFFER(context, rect) \
     GUAC_RECT_MUTABLE_BUFFER(rect, context->buffer, context->stride, GUAC_DISPLAY_LAYER_RAW_BPP)
 
+struct guac_display_copy_hint {
+
+    /**
+     * The rectangular region that served as the source of the copy. The
+     * contents of this region, as they existed when the previous frame was
+     * flushed, have been copied to the destination region.
+     */
+    guac_rect src;
+
+    /**
+     * The rectangular region that received the copied data. This region must
+     * have the same dimensions as the source region.
+     */
+    guac_rect dest;
+
+    /**
+     * The layer whose previously-flushed frame served as the source of the
+     * copy, or NULL if the source is the layer that received the copied data.
+     * If non-NULL, this layer must continue to exist at least until the frame
+     * containing the hinted copy has been flushed.
+     */
+    guac_display_layer* layer;
+
+};
+
 struct guac_display_layer_cairo_context {
 
     /**
@@ -187,6 +213,22 @@ struct guac_display_layer_raw_context {
      */
     guac_display_layer* hint_from;
 
+    /**
+     * Explicit hints describing regions of the layer whose contents have been
+     * copied from other regions of that same layer since the last frame, such
+     * as occurs when scrolling. These hints allow the scroll/copy optimization
+     * to translate the affected changes directly into copy instructions
+     * without searching, and without requiring that the copied regions align
+     * with the cells used by that search. Hints should be added only through
+     * calls to guac_display_layer_raw_context_hint_copy().
+     */
+    guac_display_copy_hint copy_hints[GUAC_DISPLAY_MAX_COPY_HINTS];
+
+    /**
+     * The number of explicit copy hints currently stored within copy_hints.
+     */
+    int num_copy_hints;
+
 };
 
 /**
@@ -443,6 +485,118 @@ void guac_display_set_cursor(guac_display* display,
  */
 void guac_display_set_cursor_hotspot(guac_display* display, int x, int y);
 
+/**
+ * Sets the zlib compression level used when encoding PNG images for the given
+ * guac_display. Lower levels spend less CPU time on lossless encoding at the
+ * cost of slightly larger output, which can be a worthwhile trade on fast
+ * networks. The level applies only where libguac performs PNG compression
+ * itself; images that can only be encoded through Cairo's PNG writer are
+ * unaffected.
+ *
+ * The change will take effect for images encoded after this function is
+ * called. Images already being encoded as part of an in-progress frame may
+ * still use the previous level.
+ *
+ * @param display
+ *     The guac_display to set the PNG compression level of.
+ *
+ * @param level
+ *     The zlib compression level to use, where 0 is no compression and 9 is
+ *     maximum compression, or -1 to use the libpng default.
+ */
+void guac_display_set_png_compression_level(guac_display* display, int level);
+
+/**
+ * Cumulative rendering statistics for a guac_display, covering the full
+ * lifetime of the display. All counters only ever increase; rates and
+ * averages over an interval can be calculated by sampling the statistics at
+ * the start and end of that interval and taking the difference. A summary of
+ * these statistics is additionally logged at the "debug" log level roughly
+ * every GUAC_DISPLAY_STATS_LOG_INTERVAL milliseconds while frames are being
+ * rendered.
+ */
+typedef struct guac_display_stats {
+
+    /**
+     * The total number of frames that have been flushed to connected clients.
+     */
+    uint64_t frames;
+
+    /**
+     * The total amount of time spent planning frames (determining the minimal
+     * set of operations required to transform the previously-sent frame into
+     * the pending frame) and sending any non-image operations, in
+     * milliseconds.
+     */
+    uint64_t plan_duration_ms;
+
+    /**
+     * The total number of image rects that have been encoded as PNG.
+     */
+    uint64_t png_rects;
+
+    /**
+     * The total number of pixels that have been encoded as PNG.
+     */
+    uint64_t png_pixels;
+
+    /**
+     * The total number of image rects that have been encoded as JPEG.
+     */
+    uint64_t jpeg_rects;
+
+    /**
+     * The total number of pixels that have been encoded as JPEG.
+     */
+    uint64_t jpeg_pixels;
+
+    /**
+     * The total number of image rects that have been encoded as WebP.
+     */
+    uint64_t webp_rects;
+
+    /**
+     * The total number of pixels that have been encoded as WebP.
+     */
+    uint64_t webp_pixels;
+
+    /**
+     * The total number of queued image rects that were dropped without being
+     * encoded because their destination region was modified again before a
+     * worker thread reached them (the pixels they would have produced having
+     * already been superseded by the frame that followed).
+     */
+    uint64_t expired_rects;
+
+    /**
+     * The total amount of time that worker threads have spent encoding and
+     * streaming image data, in milliseconds. As multiple worker threads may
+     * encode in parallel, this value may advance faster than wall-clock time.
+     */
+    uint64_t encode_duration_ms;
+
+    /**
+     * The total amount of time spent in the end-of-frame socket flush, in
+     * milliseconds. This approximates the time spent blocked on the
+     * underlying connection.
+     */
+    uint64_t flush_duration_ms;
+
+} guac_display_stats;
+
+/**
+ * Stores a snapshot of the current rendering statistics of the given display
+ * in the given guac_display_stats. The snapshot is internally consistent,
+ * even if the display is actively rendering frames in other threads.
+ *
+ * @param display
+ *     The display to retrieve rendering statistics for.
+ *
+ * @param stats
+ *     The guac_display_stats that should receive the current statistics.
+ */
+void guac_display_get_stats(guac_display* display, guac_display_stats* stats);
+
 /**
  * Stores the current bounding rectangle of the given layer in the given
  * guac_rect. The boundary stored will be the boundary of the current pending
@@ -533,6 +687,52 @@ void guac_display_layer_set_opacity(guac_display_layer* layer, int opacity);
  */
 void guac_display_layer_set_lossless(guac_display_layer* layer, int lossless);
 
+/**
+ * The graphical content of the layer is not known in advance. The optimal
+ * encoding for each region of the layer will be determined by sampling the
+ * image data. This is the default.
+ */
+#define GUAC_DISPLAY_CONTENT_HINT_NONE 0
+
+/**
+ * The layer is expected to contain text-like content (sharp edges and few
+ * distinct colors, as with terminals). Lossless encodings will be preferred
+ * without sampling the image data.
+ */
+#define GUAC_DISPLAY_CONTENT_HINT_TEXT 1
+
+/**
+ * The layer is expected to contain photo-like content (smooth gradients and
+ * many distinct colors). Lossy encodings will be preferred without sampling
+ * the image data.
+ */
+#define GUAC_DISPLAY_CONTENT_HINT_PHOTO 2
+
+/**
+ * The layer is expected to contain video-like content (photo-like content
+ * that additionally updates frequently). Lossy encodings will be preferred
+ * without sampling the image data.
+ */
+#define GUAC_DISPLAY_CONTENT_HINT_VIDEO 3
+
+/**
+ * Declares the type of graphical content expected to be drawn to the given
+ * layer, one of the GUAC_DISPLAY_CONTENT_HINT_* constants. Declaring a hint
+ * pins the encoding strategy of the layer accordingly, bypassing the content
+ * sampling that is otherwise used to choose between lossless and lossy
+ * encodings. Protocol implementations that know the nature of a layer's
+ * content in advance (a terminal, a mapped video region, etc.) should declare
+ * it here; all other layers are classified automatically.
+ *
+ * @param layer
+ *     The layer to declare the expected content type of.
+ *
+ * @param hint
+ *     The type of graphical content expected to be drawn to the given layer,
+ *     one of the GUAC_DISPLAY_CONTENT_HINT_* constants.
+ */
+void guac_display_layer_set_content_hint(guac_display_layer* layer, int hint);
+
 /**
  * Sets the level of multitouch support available for the given layer. The
  * change in layer multitouch support will be made as part of the current
@@ -667,6 +867,67 @@ void guac_display_layer_raw_context_set(guac_display_layer_raw_context* context,
 void guac_display_layer_raw_context_put(guac_display_layer_raw_context* context,
         const guac_rect* dst, const void* restrict buffer, size_t stride);
 
+/**
+ * Hints that the contents of the given destination rect within the layer
+ * associated with the given raw context have been copied from the given source
+ * rect of that same layer, as occurs when scrolling. This function does not
+ * itself copy any image data; it is expected that the underlying buffer
+ * already reflects the result of the copy. The dirty rect of the context must
+ * still be updated to include the destination region.
+ *
+ * Hinted copies will be sent to connected users as copy instructions rather
+ * than re-encoded image data, so long as the source region of the
+ * previously-sent frame truly contains the data now present in the
+ * destination region. Hints beyond GUAC_DISPLAY_MAX_COPY_HINTS per frame are
+ * ignored, with the affected regions instead handled by the heuristic
+ * scroll/copy search.
+ *
+ * @param context
+ *     The raw context of the layer that is being drawn to.
+ *
+ * @param src
+ *     The rectangular region that served as the source of the copy.
+ *
+ * @param dst
+ *     The rectangular region that received the copied data. This region must
+ *     have the same dimensions as the source region.
+ */
+void guac_display_layer_raw_context_hint_copy(guac_display_layer_raw_context* context,
+        const guac_rect* src, const guac_rect* dst);
+
+/**
+ * Hints that the contents of the given destination rect within the layer
+ * associated with the given raw context have been copied from the given
+ * source rect of a different layer, such as an offscreen buffer serving as a
+ * cache of frequently-reused image data. This function is otherwise identical
+ * to guac_display_layer_raw_context_hint_copy(): no image data is copied by
+ * the hint itself, the dirty rect of the context must still be updated, and
+ * the hint is honored only if the source region of the source layer's
+ * previously-sent frame truly contains the data now present in the
+ * destination region.
+ *
+ * The given source layer must continue to exist at least until the frame
+ * containing the hinted copy has been flushed.
+ *
+ * @param context
+ *     The raw context of the layer that is being drawn to.
+ *
+ * @param src_layer
+ *     The layer whose previously-flushed frame served as the source of the
+ *     copy.
+ *
+ * @param src
+ *     The rectangular region within the source layer that served as the
+ *     source of the copy.
+ *
+ * @param dst
+ *     The rectangular region that received the copied data. This region must
+ *     have the same dimensions as the source region.
+ */
+void guac_display_layer_raw_context_hint_copy_from(
+        guac_display_layer_raw_context* context, guac_display_layer* src_layer,
+        const guac_rect* src, const guac_rect* dst);
+
 /**
  * Begins a drawing operation for the given layer, returning a context that can
  * be used to draw to a Cairo surface containing the layer's current pending
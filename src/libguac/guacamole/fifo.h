@@ -20,6 +20,7 @@
 #ifndef GUAC_FIFO_H
 #define GUAC_FIFO_H
 
+#include "align.h"
 #include "fifo-constants.h"
 #include "fifo-types.h"
 #include "flag.h"
@@ -82,6 +83,58 @@ struct guac_fifo {
      */
     ssize_t items_offset;
 
+    /**
+     * Non-zero if this FIFO was initialized with guac_fifo_init_lockfree()
+     * and enqueue/dequeue operations should use the lock-free ring buffer
+     * implementation, zero otherwise.
+     */
+    int lockfree;
+
+    /**
+     * The sequence stamp of each slot within the lock-free ring buffer, used
+     * to determine whether a slot is ready to receive an item (stamp equal to
+     * the claimed position), contains a completed item (stamp equal to the
+     * claimed position plus one), or is still being processed by another
+     * thread (any other value). Used only if this FIFO is lock-free.
+     */
+    size_t* ring_seq;
+
+    /**
+     * The number of threads currently blocked waiting for the lock-free ring
+     * buffer to become non-empty. Enqueue operations signal the state flag
+     * only when this is non-zero. Accessed only via atomic operations. Used
+     * only if this FIFO is lock-free.
+     */
+    int waiting_consumers;
+
+    /**
+     * The number of threads currently blocked waiting for space within the
+     * lock-free ring buffer. Dequeue operations signal the state flag only
+     * when this is non-zero. Accessed only via atomic operations. Used only
+     * if this FIFO is lock-free.
+     */
+    int waiting_producers;
+
+    /**
+     * The position of the oldest item within the lock-free ring buffer. This
+     * value increases monotonically and is reduced modulo max_items to locate
+     * the corresponding slot. Accessed only via atomic operations. Used only
+     * if this FIFO is lock-free. This member is kept on its own cache line,
+     * as consumers update it constantly and would otherwise contend with
+     * reads of the configuration members above.
+     */
+    size_t ring_head GUAC_ALIGNED_CACHE_LINE;
+
+    /**
+     * The position at which the next item will be added to the lock-free ring
+     * buffer. This value increases monotonically and is reduced modulo
+     * max_items to locate the corresponding slot. Accessed only via atomic
+     * operations. Used only if this FIFO is lock-free. This member is kept on
+     * its own cache line, as producers update it constantly and would
+     * otherwise contend with consumers advancing ring_head.
+     */
+    size_t ring_tail GUAC_ALIGNED_CACHE_LINE;
+
 };
 
 /**
@@ -109,6 +162,46 @@ struct guac_fifo {
 void guac_fifo_init(guac_fifo* fifo, void* items,
         size_t max_items, size_t item_size);
 
+/**
+ * Initializes the given guac_fifo as a bounded, lock-free MPMC ring buffer.
+ * Unlike FIFOs initialized with guac_fifo_init(), enqueue and dequeue
+ * operations do not serialize on the FIFO's state flag: items are claimed
+ * with atomic compare-and-swap operations on the ring head/tail, with
+ * per-slot sequence stamps tracking slot readiness, and the state flag is
+ * used only to sleep when the FIFO is empty (or full). This is preferable for
+ * FIFOs on hot producer/consumer paths, where many threads enqueue and
+ * dequeue small items at high rates.
+ *
+ * As with guac_fifo_init(), this function MUST be invoked once (and ONLY
+ * once) for each guac_fifo being used, and MUST be invoked before any such
+ * FIFO is used. Note that lock-free FIFOs allocate internal storage for their
+ * sequence stamps and, unlike FIFOs initialized with guac_fifo_init(), may
+ * NOT be placed in memory shared by multiple processes.
+ *
+ * Calls to guac_fifo_lock() and guac_fifo_unlock() retain their meaning for
+ * lock-free FIFOs, and the "_and_lock" variants of enqueue/dequeue still
+ * acquire the state flag before returning, but enqueue/dequeue operations of
+ * other threads are no longer excluded by holding the lock.
+ *
+ * The FIFO is empty upon initialization.
+ *
+ * @param fifo
+ *     The FIFO to initialize.
+ *
+ * @param items
+ *     The storage that the implementation should use for queued items. This
+ *     storage MUST be large enough to contain the maximum number of items as
+ *     a contiguous array.
+ *
+ * @param max_items
+ *     The maximum number of items supported by the provided storage.
+ *
+ * @param item_size
+ *     The number of bytes required for each individual item in storage.
+ */
+void guac_fifo_init_lockfree(guac_fifo* fifo, void* items,
+        size_t max_items, size_t item_size);
+
 /**
  * Releases all underlying resources used by the given guac_fifo, such as
  * pthread mutexes and conditions. The given guac_fifo MAY NOT be used after
@@ -219,6 +312,26 @@ int guac_fifo_enqueue(guac_fifo* fifo, const void* item);
  */
 int guac_fifo_enqueue_and_lock(guac_fifo* fifo, const void* item);
 
+/**
+ * Adds a copy of the given item to the end of the given FIFO, and signals any
+ * waiting threads that the FIFO is now non-empty. Unlike guac_fifo_enqueue(),
+ * this function never blocks: if there is insufficient space in the FIFO, the
+ * item is simply not added. This allows producers which cannot afford to wait
+ * (and which can tolerate losing the item) to feed a FIFO that may be drained
+ * by a slower consumer.
+ *
+ * @param fifo
+ *     The FIFO to add an item to.
+ *
+ * @param item
+ *     The item to add.
+ *
+ * @return
+ *     Non-zero if the item was successfully added, zero if the item could not
+ *     be added because the FIFO is full or has been invalidated.
+ */
+int guac_fifo_try_enqueue(guac_fifo* fifo, const void* item);
+
 /**
  * Removes the oldest (first) item from the FIFO, storing a copy of that item
  * within the provided buffer. If the FIFO is currently empty, this function
@@ -306,6 +419,61 @@ int guac_fifo_timed_dequeue(guac_fifo* fifo,
 int guac_fifo_timed_dequeue_and_lock(guac_fifo* fifo,
         void* item, int msec_timeout);
 
+/**
+ * Removes up to max_items of the oldest items from the FIFO, storing copies
+ * of those items sequentially within the provided buffer. If the FIFO is
+ * currently empty, this function will block until at least one item has been
+ * added to the FIFO or until the FIFO becomes invalid. Once at least one item
+ * is present, all immediately-available items are removed, up to the given
+ * limit, without further blocking. Dequeueing items in batches allows
+ * consumers that can process multiple items at a time to drain a busy FIFO
+ * without acquiring the FIFO's lock once per item.
+ *
+ * @param fifo
+ *     The FIFO to remove items from.
+ *
+ * @param items
+ *     The buffer that should receive copies of the removed items. This
+ *     buffer must be large enough to hold max_items items.
+ *
+ * @param max_items
+ *     The maximum number of items to remove.
+ *
+ * @return
+ *     The number of items successfully removed (which will be at least one),
+ *     or zero if items cannot be removed from the FIFO because the FIFO has
+ *     been invalidated.
+ */
+int guac_fifo_dequeue_batch(guac_fifo* fifo, void* items, int max_items);
+
+/**
+ * Atomically removes up to max_items of the oldest items from the FIFO,
+ * storing copies of those items sequentially within the provided buffer. If
+ * this function successfully removes at least one item, the FIFO is left
+ * locked after this function returns. If the FIFO is currently empty, this
+ * function will block until at least one item has been added to the FIFO or
+ * until the FIFO becomes invalid. Once at least one item is present, all
+ * immediately-available items are removed, up to the given limit, without
+ * further blocking.
+ *
+ * @param fifo
+ *     The FIFO to remove items from.
+ *
+ * @param items
+ *     The buffer that should receive copies of the removed items. This
+ *     buffer must be large enough to hold max_items items.
+ *
+ * @param max_items
+ *     The maximum number of items to remove.
+ *
+ * @return
+ *     The number of items successfully removed (which will be at least one),
+ *     or zero if items cannot be removed from the FIFO because the FIFO has
+ *     been invalidated.
+ */
+int guac_fifo_dequeue_batch_and_lock(guac_fifo* fifo, void* items,
+        int max_items);
+
 /**
  * @}
  */
@@ -409,5 +409,119 @@
  */
 #define guac_mem_free_const(mem) PRIV_guac_mem_free((void*) (mem))
 
+/**
+ * A snapshot of the memory usage of the current process, as tracked across
+ * all allocations made through guac_mem_alloc() and similar. As guacd
+ * dedicates a process to each connection, this usage is effectively
+ * per-connection usage within those processes.
+ *
+ * Usage is measured at allocation time via malloc_usable_size(). On
+ * platforms lacking malloc_usable_size(), usage is not tracked, and all
+ * reported values will be zero.
+ */
+typedef struct guac_mem_stats {
+
+    /**
+     * The number of bytes currently allocated, including allocator overhead
+     * within each block.
+     */
+    size_t used;
+
+    /**
+     * The maximum number of bytes that have been simultaneously allocated
+     * over the life of the process.
+     */
+    size_t peak;
+
+    /**
+     * The configured soft limit on total allocated bytes, as set through
+     * guac_mem_set_limit(), or zero if no limit is set.
+     */
+    size_t limit;
+
+} guac_mem_stats;
+
+/**
+ * Stores a snapshot of current process-wide memory usage within the given
+ * guac_mem_stats structure. Only memory allocated through guac_mem_alloc()
+ * and similar is tracked.
+ *
+ * @param stats
+ *     The guac_mem_stats structure that should receive the snapshot of
+ *     current memory usage.
+ */
+void guac_mem_get_stats(guac_mem_stats* stats);
+
+/**
+ * Sets a soft limit on the total number of bytes that may be simultaneously
+ * allocated through guac_mem_alloc() and similar within the current process.
+ * Allocations that would exceed this limit fail with GUAC_STATUS_NO_MEMORY,
+ * exactly as if the underlying allocation itself had failed, while all
+ * existing allocations remain untouched. A limit of zero (the default)
+ * disables enforcement.
+ *
+ * On platforms where usage is not tracked (those lacking
+ * malloc_usable_size()), the limit has no effect.
+ *
+ * @param limit
+ *     The maximum number of bytes that may be simultaneously allocated, or
+ *     zero to disable enforcement.
+ */
+void guac_mem_set_limit(size_t limit);
+
+/**
+ * Enables or disables requesting transparent huge page backing for large
+ * allocations within the current process. When enabled, callers that allocate
+ * large, long-lived buffers (such as the framebuffers maintained for each
+ * layer of a guac_display) may additionally invoke
+ * guac_mem_advise_huge_pages() to request that the kernel back those buffers
+ * with huge pages, reducing TLB pressure. Huge page backing is disabled by
+ * default.
+ *
+ * On platforms lacking madvise() and MADV_HUGEPAGE, this setting has no
+ * effect.
+ *
+ * @param enabled
+ *     Non-zero if large allocations should be backed by transparent huge
+ *     pages where possible, zero otherwise.
+ */
+void guac_mem_set_huge_pages(int enabled);
+
+/**
+ * Advises the kernel that the given block of memory would benefit from being
+ * backed by transparent huge pages. This function has no effect unless huge
+ * page backing has been enabled via guac_mem_set_huge_pages(), the platform
+ * provides madvise() and MADV_HUGEPAGE, and the given block spans at least
+ * one entire huge-page-aligned region. Any failure of the underlying
+ * madvise() call is ignored, as huge page backing is strictly an
+ * optimization.
+ *
+ * @param mem
+ *     The block of memory that would benefit from huge page backing.
+ *
+ * @param length
+ *     The length of the block of memory, in bytes.
+ */
+void guac_mem_advise_huge_pages(void* mem, size_t length);
+
+/**
+ * Advises the kernel that the contents of the given block of memory are no
+ * longer needed and that the physical pages backing it may be reclaimed. The
+ * block remains allocated and may be freely written to again at any time, but
+ * its contents after this call are undefined (on Linux, subsequent reads will
+ * return zeroes). This function has no effect unless the platform provides
+ * madvise() and MADV_DONTNEED, and only the whole pages contained entirely
+ * within the block are affected. Any failure of the underlying madvise() call
+ * is ignored, as releasing backing pages is strictly a memory usage
+ * optimization.
+ *
+ * @param mem
+ *     The block of memory whose contents are no longer needed.
+ *
+ * @param length
+ *     The length of the block of memory, in bytes.
+ */
+void guac_mem_advise_unneeded(void* mem, size_t length);
+
 #endif
 
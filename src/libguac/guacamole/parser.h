@@ -73,6 +73,15 @@ struct guac_parser {
      */
     char* __instructionbuf_unparsed_start;
 
+    /**
+     * Pointer to the first character of the instruction currently being
+     * parsed, which may precede the unparsed region if part of the
+     * instruction has already been consumed by the parser. This is tracked
+     * across calls such that parsing of a partially received instruction can
+     * resume after guac_parser_read() returns due to a timeout.
+     */
+    char* __instructionbuf_parse_start;
+
     /**
      * Pointer to the first unused section of the instruction buffer.
      */
@@ -85,6 +94,22 @@ struct guac_parser {
      */
     char __instructionbuf[32768];
 
+    /**
+     * The number of received but undrained bytes within the spill buffer.
+     */
+    int __spill_length;
+
+    /**
+     * Secondary buffer which receives data beyond the free space of the
+     * instruction buffer when the buffers are filled with a single scatter
+     * read. Filling both buffers with one read keeps read operations large
+     * even when little contiguous space remains within the instruction
+     * buffer, reducing the number of underlying read operations needed for
+     * bulk input. Spilled data is drained into the instruction buffer as
+     * parsing frees space.
+     */
+    char __spillbuf[GUAC_INSTRUCTION_MAX_LENGTH];
+
 };
 
 /**
@@ -111,6 +136,19 @@ guac_parser* guac_parser_alloc();
  */
 int guac_parser_append(guac_parser* parser, void* buffer, int length);
 
+/**
+ * Resets the state of the given parser such that parsing of a new instruction
+ * may begin. Any buffered unparsed data is retained, but all parsed elements
+ * of the previous instruction are discarded, and any element pointers exposed
+ * through the parser (opcode, argv) become invalid. This function must be
+ * invoked after each completed instruction when driving the parser directly
+ * through guac_parser_append(); guac_parser_read() resets the parser
+ * automatically.
+ *
+ * @param parser The parser to reset.
+ */
+void guac_parser_reset(guac_parser* parser);
+
 /**
  * Returns the number of unparsed bytes stored in the given parser's internal
  * buffers.
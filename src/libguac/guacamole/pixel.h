@@ -0,0 +1,93 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_PIXEL_H
+#define GUAC_PIXEL_H
+
+/**
+ * Bulk pixel format conversion functions, as needed when moving image data
+ * between Cairo surfaces (32 bits per pixel, blue in the lowest-order byte)
+ * and image codecs which work with packed 24-bit RGB (libjpeg) or which
+ * require a defined alpha channel (libwebp). Where supported by the CPU, the
+ * bulk of each conversion is performed with vector instructions.
+ *
+ * @file pixel.h
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Copies the given run of 32-bit pixels, forcing the alpha channel of every
+ * copied pixel to fully opaque. This converts pixel data in Cairo's RGB24
+ * format (in which the high-order byte is undefined) into valid ARGB32 pixel
+ * data. The source and destination may be the same buffer, but must not
+ * otherwise overlap.
+ *
+ * @param dst
+ *     The buffer to write the converted pixels to.
+ *
+ * @param src
+ *     The pixels to convert.
+ *
+ * @param count
+ *     The number of pixels to convert.
+ */
+void guac_pixel_fill_alpha(uint32_t* dst, const uint32_t* src, size_t count);
+
+/**
+ * Converts the given run of 32-bit pixels in Cairo's RGB24 / ARGB32 format
+ * into tightly-packed 24-bit RGB, discarding the alpha channel. Each
+ * converted pixel occupies exactly three bytes (red, green, and blue, in that
+ * order) within the destination buffer, which must be at least count * 3
+ * bytes in length. The source and destination must not overlap.
+ *
+ * @param dst
+ *     The buffer to write the packed 24-bit RGB pixels to.
+ *
+ * @param src
+ *     The 32-bit pixels to convert.
+ *
+ * @param count
+ *     The number of pixels to convert.
+ */
+void guac_pixel_pack_rgb(unsigned char* dst, const uint32_t* src,
+        size_t count);
+
+/**
+ * Converts the given run of tightly-packed 24-bit RGB pixels (red, green, and
+ * blue, in that order, each pixel occupying exactly three bytes) into 32-bit
+ * pixels in Cairo's ARGB32 format, with the alpha channel of every converted
+ * pixel set to fully opaque. The source buffer must be at least count * 3
+ * bytes in length. The source and destination must not overlap.
+ *
+ * @param dst
+ *     The buffer to write the converted 32-bit pixels to.
+ *
+ * @param src
+ *     The packed 24-bit RGB pixels to convert.
+ *
+ * @param count
+ *     The number of pixels to convert.
+ */
+void guac_pixel_unpack_rgb(uint32_t* dst, const unsigned char* src,
+        size_t count);
+
+#endif
+
@@ -30,6 +30,7 @@
 #include "pool-types.h"
 
 #include <pthread.h>
+#include <stdint.h>
 
 struct guac_pool {
 
@@ -52,17 +53,45 @@ struct guac_pool {
     int __next_value;
 
     /**
-     * The first integer in the pool, if any.
+     * The number of integers covered by the lock-free free list. Integers
+     * below this value are freed and reused without acquiring the pool's
+     * lock, while larger integers fall back to the locked overflow list.
+     * For internal use only.
+     */
+    int __fast_capacity;
+
+    /**
+     * The lock-free free list of integers below __fast_capacity, threaded
+     * through this array: for each integer currently in the list, the entry
+     * at that index holds the next free integer plus one, or zero if no
+     * further integers follow. Entries for integers not in the list are
+     * meaningless. For internal use only.
+     */
+    int* __free_next;
+
+    /**
+     * The head of the lock-free free list, packing a tag (incremented with
+     * each update to guard against the "ABA" problem) in the upper 32 bits
+     * and the first free integer plus one in the lower 32 bits, where zero
+     * denotes an empty list. Accessed only via atomic operations. For
+     * internal use only.
+     */
+    uint64_t __free_head;
+
+    /**
+     * The first integer in the locked overflow list, if any. Only integers
+     * too large for the lock-free free list are stored here.
      */
     guac_pool_int* __head;
 
     /**
-     * The last integer in the pool, if any.
+     * The last integer in the locked overflow list, if any.
      */
     guac_pool_int* __tail;
 
     /**
-     * Lock which is acquired when the pool is being modified or accessed.
+     * Lock which is acquired when the overflow list is being modified or
+     * accessed.
      */
     pthread_mutex_t __lock;
 
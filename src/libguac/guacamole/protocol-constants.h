@@ -49,6 +49,17 @@
  */
 #define GUAC_PROTOCOL_BLOB_MAX_LENGTH 6048
 
+/**
+ * The pseudo image mimetype which clients declare among their supported image
+ * mimetypes during the connection handshake to advertise support for the
+ * cells instruction. Unlike true image mimetypes, this mimetype does not
+ * describe an image format, but rather the packed text-cell run format
+ * accepted by guac_protocol_send_cells().
+ *
+ * @see guac_protocol_send_cells()
+ */
+#define GUAC_PROTOCOL_CELLS_MIMETYPE "text/x-guac-cells"
+
 /**
  * The name of the layer parameter defining the number of simultaneous points
  * of contact supported by a layer. This parameter should be set to a non-zero
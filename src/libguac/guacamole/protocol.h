@@ -630,6 +630,74 @@ int guac_protocol_send_arc(guac_socket* socket, const guac_layer* layer,
         int x, int y, int radius, double startAngle, double endAngle,
         int negative);
 
+/**
+ * Sends a cells instruction over the given guac_socket connection. The cells
+ * instruction draws runs of uniformly-colored text cells within a character
+ * grid, sending foreground color, background color, and Unicode codepoints
+ * rather than pixels. The client rasterizes the described text itself, using
+ * its own copy of the font. Text-heavy content (such as terminal screen
+ * updates) can thus be sent using a small fraction of the bandwidth required
+ * by image data, without any server-side rasterization.
+ *
+ * Support for the cells instruction is negotiated during the connection
+ * handshake: clients which understand the instruction declare the
+ * GUAC_PROTOCOL_CELLS_MIMETYPE pseudo mimetype among their supported image
+ * mimetypes. This instruction MUST NOT be sent to users which have not
+ * declared support, as verified with guac_user_supports_cell_runs() or (for
+ * broadcast sockets) guac_client_supports_cell_runs().
+ *
+ * The data provided must be a packed sequence of runs, where each run
+ * consists of the following big-endian, unsigned values:
+ *
+ *   - 2 bytes: the column of the first cell of the run, in cells, relative
+ *     to the left edge of the grid
+ *   - 2 bytes: the row of the run, in cells, relative to the top edge of the
+ *     grid
+ *   - 2 bytes: the number of characters within the run
+ *   - 3 bytes: the RGB foreground color of all characters within the run
+ *   - 3 bytes: the RGB background color of all cells within the run
+ *   - 3 bytes for each character within the run: the Unicode codepoint of
+ *     that character
+ *
+ * Each character occupies one cell, with successive characters of a run
+ * occupying successive columns of the same row.
+ *
+ * If an error occurs sending the instruction, a non-zero value is
+ * returned, and guac_error is set appropriately.
+ *
+ * @param socket
+ *     The guac_socket connection to use.
+ *
+ * @param layer
+ *     The destination layer.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the character grid within
+ *     the destination layer, in pixels.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the character grid within
+ *     the destination layer, in pixels.
+ *
+ * @param cell_width
+ *     The width of each cell of the character grid, in pixels.
+ *
+ * @param cell_height
+ *     The height of each cell of the character grid, in pixels.
+ *
+ * @param data
+ *     The packed runs of text cells to draw, in the format described above.
+ *
+ * @param count
+ *     The number of bytes of packed run data provided.
+ *
+ * @return
+ *     Zero on success, non-zero on error.
+ */
+int guac_protocol_send_cells(guac_socket* socket, const guac_layer* layer,
+        int x, int y, int cell_width, int cell_height,
+        const void* data, int count);
+
 /**
  * Sends a cfill instruction over the given guac_socket connection.
  *
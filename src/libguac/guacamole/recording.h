@@ -22,6 +22,8 @@
 
 #include <guacamole/client.h>
 
+#include <stddef.h>
+
 /**
  * Provides functions and structures to be use for session recording.
  *
@@ -162,6 +164,96 @@ guac_recording* guac_recording_create(guac_client* client,
         int include_output, int include_mouse, int include_touch,
         int include_keys, int allow_write_existing);
 
+/**
+ * Replaces the socket of the given client such that all further Guacamole
+ * protocol output will be copied into files within the given path, identical
+ * in behavior to guac_recording_create() except that the recording may be
+ * split across multiple segment files which are rotated once they reach the
+ * given size and/or cover the given duration.
+ *
+ * When segmentation is enabled (either limit is non-zero), the named
+ * recording file serves as the segment manifest, with the actual recorded
+ * instructions written to segment files formed by appending a sequential,
+ * zero-padded index to the manifest name (NAME.000000, NAME.000001, etc.). A
+ * segment which is still being written additionally carries a ".part" suffix.
+ * When a segment reaches a configured limit, it is rotated at the next
+ * instruction boundary: the segment is synced to disk, atomically renamed to
+ * strip the ".part" suffix, and its name is appended to the manifest. Every
+ * finalized segment therefore contains only whole instructions and may be
+ * processed independently (and in parallel) by tools like guacenc and
+ * guaclog, while a crash mid-session can corrupt at most the single segment
+ * that was still in progress.
+ *
+ * If both limits are zero, the recording is written as a single file, exactly
+ * as with guac_recording_create().
+ *
+ * @param client
+ *     The client whose output should be copied to a recording file.
+ *
+ * @param path
+ *     The full absolute path to a directory in which the recording files
+ *     should be created.
+ *
+ * @param name
+ *     The base name to use for the recording manifest created within the
+ *     specified path, from which the name of each segment is derived.
+ *
+ * @param create_path
+ *     Zero if the specified path MUST exist for the recording files to be
+ *     written, or non-zero if the path should be created if it does not yet
+ *     exist.
+ *
+ * @param include_output
+ *     Non-zero if output which is broadcast to each connected client
+ *     (graphics, streams, etc.) should be included in the session recording,
+ *     zero otherwise. Including output is necessary for any recording which
+ *     must later be viewable as video.
+ *
+ * @param include_mouse
+ *     Non-zero if changes to mouse state, such as position and buttons pressed
+ *     or released, should be included in the session recording, zero
+ *     otherwise. Including mouse state is necessary for the mouse cursor to be
+ *     rendered in any resulting video.
+ *
+ * @param include_touch
+ *     Non-zero if touch events should be included in the session recording,
+ *     zero otherwise. Depending on whether the remote desktop will
+ *     automatically provide graphical feedback for touches, including touch
+ *     events may be necessary for multi-touch interactions to be rendered in
+ *     any resulting video.
+ *
+ * @param include_keys
+ *     Non-zero if keys pressed and released should be included in the session
+ *     recording, zero otherwise. Including key events within the recording may
+ *     be necessary in certain auditing contexts, but should only be done with
+ *     caution. Key events can easily contain sensitive information, such as
+ *     passwords, credit card numbers, etc.
+ *
+ * @param allow_write_existing
+ *     Non-zero if writing to an existing file should be allowed, or zero
+ *     otherwise.
+ *
+ * @param max_segment_size
+ *     The maximum size of each recording segment, in bytes, or zero if
+ *     segments should not be rotated based on size. As rotation occurs only
+ *     on instruction boundaries, a segment may exceed this size by up to one
+ *     instruction.
+ *
+ * @param max_segment_duration
+ *     The maximum duration covered by each recording segment, in seconds, or
+ *     zero if segments should not be rotated based on time.
+ *
+ * @return
+ *     A new guac_recording structure representing the in-progress
+ *     recording if the recording files have been successfully created and a
+ *     recording will be written, NULL otherwise.
+ */
+guac_recording* guac_recording_create_segmented(guac_client* client,
+        const char* path, const char* name, int create_path,
+        int include_output, int include_mouse, int include_touch,
+        int include_keys, int allow_write_existing,
+        size_t max_segment_size, int max_segment_duration);
+
 /**
  * Frees the resources associated with the given in-progress recording. Note
  * that, due to the manner that recordings are attached to the guac_client, the
@@ -203,6 +203,45 @@ void guac_rect_extend(guac_rect* rect, const guac_rect* min);
  */
 void guac_rect_constrain(guac_rect* rect, const guac_rect* max);
 
+/**
+ * Collapses each rectangle in the given array such that it exists only within
+ * the bounds of the given maximum rectangle, as if guac_rect_constrain() had
+ * been invoked for each in turn. Processing the rectangles as a single batch
+ * allows the constraint to be applied branchlessly across the whole array,
+ * which compilers can reduce to vector min/max operations.
+ *
+ * @param rects
+ *     The array of rectangles to collapse.
+ *
+ * @param count
+ *     The number of rectangles within the given array.
+ *
+ * @param max
+ *     The maximum area in which each of the given rectangles can exist.
+ */
+void guac_rect_constrain_all(guac_rect* rects, size_t count,
+        const guac_rect* max);
+
+/**
+ * Extends the given rectangle such that it contains at least every non-empty
+ * rectangle in the given array, as if guac_rect_extend() had been invoked for
+ * each in turn. Processing the rectangles as a single batch allows the union
+ * to be computed branchlessly across the whole array, which compilers can
+ * reduce to vector min/max operations.
+ *
+ * @param rect
+ *     The rectangle to extend.
+ *
+ * @param rects
+ *     The array of rectangles that must each be contained within the given
+ *     rectangle. Empty rectangles within this array are ignored.
+ *
+ * @param count
+ *     The number of rectangles within the given array.
+ */
+void guac_rect_extend_all(guac_rect* rect, const guac_rect* rects,
+        size_t count);
+
 /**
  * Reduces the size of the given rectangle such that it does not exceed the
  * given width and height. The aspect ratio of the given rectangle is
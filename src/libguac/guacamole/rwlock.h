@@ -21,6 +21,7 @@
 #define __GUAC_RWLOCK_H
 
 #include <pthread.h>
+#include <stdint.h>
 
 /**
  * This file implements reentrant read-write locks using thread-local storage
@@ -59,11 +60,51 @@ typedef struct guac_rwlock {
      */
     pthread_key_t key;
 
+    /**
+     * A unique, non-zero serial number assigned to this lock when it was
+     * initialized. This value is used internally to validate the per-thread
+     * cache of lock state, and has no other meaning.
+     */
+    uintptr_t serial;
+
+    /**
+     * The number of times the underlying read lock has been acquired.
+     * Reentrant acquisitions by threads already holding the lock are not
+     * counted. This value is updated with relaxed atomics and is intended
+     * for monitoring only.
+     */
+    uint64_t read_acquires;
+
+    /**
+     * The number of times the underlying write lock has been acquired.
+     * Reentrant acquisitions by threads already holding the lock are not
+     * counted. This value is updated with relaxed atomics and is intended
+     * for monitoring only.
+     */
+    uint64_t write_acquires;
+
+    /**
+     * The number of read acquisitions which could not be satisfied
+     * immediately and had to wait, typically because a writer held the lock
+     * or was waiting for it. This value is updated with relaxed atomics and
+     * is intended for monitoring only.
+     */
+    uint64_t read_contended;
+
+    /**
+     * The number of write acquisitions which could not be satisfied
+     * immediately and had to wait for readers or another writer. This value
+     * is updated with relaxed atomics and is intended for monitoring only.
+     */
+    uint64_t write_contended;
+
 } guac_rwlock;
 
 /**
  * Initialize the provided guac reentrant rwlock. The lock will be configured to be
- * visible to child processes.
+ * visible to child processes. Where the threading implementation supports it,
+ * the lock will prefer waiting writers over new readers, such that a steady
+ * stream of readers cannot starve a writer indefinitely.
  *
  * @param lock
  *     The guac reentrant rwlock to be initialized.
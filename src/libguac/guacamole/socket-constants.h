@@ -48,5 +48,28 @@
  */
 #define GUAC_SOCKET_BASE64_ENCODED_BUFFER_SIZE 1024
 
+/**
+ * The maximum number of bytes which may be queued within a guac_socket
+ * created with guac_socket_queued() before further writes block waiting for
+ * the writer thread to catch up.
+ */
+#define GUAC_SOCKET_QUEUED_MAX_BYTES 4194304
+
+/**
+ * The maximum amount of time to wait for space within the queue of a
+ * guac_socket created with guac_socket_queued(), in milliseconds. If the
+ * queue remains full beyond this interval, the socket enters a permanent
+ * error state and all future writes fail.
+ */
+#define GUAC_SOCKET_QUEUED_TIMEOUT 15000
+
+/**
+ * The maximum number of spooled writes which may be pending within a
+ * guac_socket created with guac_socket_tee_async() before the secondary
+ * socket is abandoned. Each spooled write holds at most one write's worth of
+ * data (typically no larger than GUAC_SOCKET_OUTPUT_BUFFER_SIZE bytes).
+ */
+#define GUAC_SOCKET_TEE_SPOOL_SIZE 512
+
 #endif
 
@@ -28,6 +28,7 @@
 
 #include "socket-types.h"
 
+#include <sys/uio.h>
 #include <unistd.h>
 
 /**
@@ -43,6 +44,22 @@
 typedef ssize_t guac_socket_read_handler(guac_socket* socket,
         void* buf, size_t count);
 
+/**
+ * Generic scatter read handler for socket read operations, modeled after the
+ * standard POSIX readv() function. When set within a guac_socket, a handler of
+ * this type will be called when data needs to be read into multiple buffers
+ * with a single underlying read operation. Sockets which cannot usefully
+ * implement scatter reads may simply leave this handler unset, in which case
+ * reads will be limited to single buffers.
+ *
+ * @param socket The guac_socket being read from.
+ * @param iov The array of buffers to populate with data, in order.
+ * @param iovcnt The number of buffers within the given array.
+ * @return The number of bytes read, or -1 if an error occurs.
+ */
+typedef ssize_t guac_socket_readv_handler(guac_socket* socket,
+        const struct iovec* iov, int iovcnt);
+
 /**
  * Generic write handler for socket write operations, modeled after the standard
  * POSIX write() function. When set within a guac_socket, a handler of this type
@@ -56,6 +73,27 @@ typedef ssize_t guac_socket_read_handler(guac_socket* socket,
 typedef ssize_t guac_socket_write_handler(guac_socket* socket,
         const void* buf, size_t count);
 
+/**
+ * Handler for by-reference socket write operations. When set within a
+ * guac_socket, a handler of this type will be called when a shared,
+ * pre-serialized buffer of complete instructions needs to be written to the
+ * socket, and is expected to take a reference to the given buffer rather than
+ * copy its contents. Sockets which cannot usefully queue buffers by reference
+ * may simply leave this handler unset, in which case the buffer contents will
+ * be copied via the normal write handler.
+ *
+ * @param socket
+ *     The guac_socket being written to.
+ *
+ * @param buf
+ *     The shared buffer to be written.
+ *
+ * @return
+ *     Zero on success, or non-zero if an error occurs.
+ */
+typedef ssize_t guac_socket_write_shared_handler(guac_socket* socket,
+        guac_socket_shared_buffer* buf);
+
 /**
  * Generic handler for socket select operations, similar to the POSIX select()
  * function. When guac_socket_select() is called on a guac_socket, its
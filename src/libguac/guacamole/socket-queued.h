@@ -0,0 +1,62 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_SOCKET_QUEUED_H
+#define GUAC_SOCKET_QUEUED_H
+
+/**
+ * Provides an implementation of guac_socket which wraps another guac_socket,
+ * queueing all written instructions in a bounded in-memory queue which is
+ * drained by a dedicated writer thread. Threads writing to the socket thus
+ * never block on the underlying I/O, and one slow connection cannot stall
+ * writers which also serve other connections (such as the broadcast socket
+ * of a shared session).
+ *
+ * @file socket-queued.h
+ */
+
+#include "socket-types.h"
+
+/**
+ * Creates a new guac_socket which queues all written instructions in a
+ * bounded in-memory queue, writing and flushing them to the given socket
+ * asynchronously from a dedicated writer thread. Instructions are queued as
+ * indivisible units, so writes to the underlying socket interleave only at
+ * instruction boundaries, exactly as if the underlying socket were written
+ * directly.
+ *
+ * If the queue remains full (because the underlying connection cannot keep
+ * up) for longer than GUAC_SOCKET_QUEUED_TIMEOUT milliseconds, the socket
+ * enters a permanent error state and all future writes fail, allowing the
+ * lagging connection to be cleanly dropped by its writers.
+ *
+ * Reads are passed directly through to the given socket. Freeing the
+ * returned socket automatically frees the given socket, as well.
+ *
+ * @param underlying
+ *     The guac_socket to which queued instructions should be written.
+ *
+ * @return
+ *     A newly-allocated guac_socket which writes to the given socket from a
+ *     dedicated writer thread, or NULL if the writer thread could not be
+ *     created.
+ */
+guac_socket* guac_socket_queued(guac_socket* underlying);
+
+#endif
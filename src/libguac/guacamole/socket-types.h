@@ -32,6 +32,13 @@
  */
 typedef struct guac_socket guac_socket;
 
+/**
+ * A reference-counted buffer containing one or more complete, pre-serialized
+ * Guacamole protocol instructions, allowing the same block of output to be
+ * queued on several sockets without being copied for each.
+ */
+typedef struct guac_socket_shared_buffer guac_socket_shared_buffer;
+
 /**
  * Possible current states of a guac_socket.
  */
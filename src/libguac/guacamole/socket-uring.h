@@ -0,0 +1,57 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_SOCKET_URING_H
+#define GUAC_SOCKET_URING_H
+
+/**
+ * Provides an io_uring implementation of guac_socket which submits writes
+ * asynchronously, such that threads writing to the socket do not block on the
+ * underlying file descriptor. This header will only be available if libguac
+ * was built with io_uring support.
+ *
+ * @file socket-uring.h
+ */
+
+#include "socket-types.h"
+
+/**
+ * Creates a new guac_socket which will submit all writes to the given file
+ * descriptor asynchronously through io_uring, using registered buffers.
+ * Threads writing to the socket will block only if all write buffers are
+ * awaiting completion of in-flight writes. Reads are performed synchronously,
+ * as with the guac_socket returned by guac_socket_open(). Freeing this
+ * guac_socket will wait for all in-flight writes to complete and will
+ * automatically close the associated file descriptor.
+ *
+ * If the io_uring cannot be set up (for example, if io_uring is unsupported
+ * by the running kernel), NULL is returned and guac_error is set
+ * appropriately. Callers should fall back to guac_socket_open() in that case.
+ *
+ * @param fd
+ *     The file descriptor to use for the connection underlying the created
+ *     guac_socket.
+ *
+ * @return
+ *     A newly-allocated guac_socket which performs all writes asynchronously
+ *     through io_uring, or NULL if the io_uring could not be set up.
+ */
+guac_socket* guac_socket_uring(int fd);
+
+#endif
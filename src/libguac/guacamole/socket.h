@@ -48,11 +48,27 @@ struct guac_socket {
      */
     guac_socket_read_handler* read_handler;
 
+    /**
+     * Handler which will be called when data needs to be read from the socket
+     * into multiple buffers with a single underlying read operation. This
+     * handler is optional; if NULL, guac_socket_readv() falls back to reading
+     * into only the first buffer via read_handler.
+     */
+    guac_socket_readv_handler* readv_handler;
+
     /**
      * Handler which will be called whenever data is written to this socket.
      */
     guac_socket_write_handler* write_handler;
 
+    /**
+     * Handler which will be called whenever a shared, pre-serialized buffer
+     * of complete instructions is written to this socket. This handler is
+     * optional; if NULL, guac_socket_write_shared() falls back to copying the
+     * buffer contents via write_handler.
+     */
+    guac_socket_write_shared_handler* write_shared_handler;
+
     /**
      * Handler which will be called whenever this socket needs to be flushed.
      */
@@ -92,6 +108,14 @@ struct guac_socket {
      */
     guac_timestamp last_write_timestamp;
 
+    /**
+     * The total number of milliseconds that writes and flushes against this
+     * guac_socket have spent blocked waiting on the underlying transport.
+     * This value increases monotonically while the socket is open and should
+     * be accessed via guac_socket_get_write_stall().
+     */
+    uint64_t __write_stall_ms;
+
     /**
      * The number of bytes present in the base64 "ready" buffer.
      */
@@ -114,12 +138,83 @@ struct guac_socket {
     int __keep_alive_enabled;
 
     /**
-     * The keep-alive thread.
+     * The next socket within the process-wide registry of sockets requiring
+     * automatic keep-alive, or NULL if this socket is the last such socket
+     * (or is not registered). All sockets requiring keep-alive are serviced
+     * by a single shared thread.
      */
-    pthread_t __keep_alive_thread;
+    guac_socket* __keep_alive_next;
 
 };
 
+struct guac_socket_shared_buffer {
+
+    /**
+     * The pre-serialized instruction data contained within this buffer.
+     */
+    char* buffer;
+
+    /**
+     * The number of bytes within buffer.
+     */
+    size_t length;
+
+    /**
+     * Lock which protects the reference count.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * The number of outstanding references to this buffer. Once this count
+     * reaches zero, the buffer (and its data) is freed.
+     */
+    unsigned int refs;
+
+};
+
+/**
+ * Allocates a new guac_socket_shared_buffer containing the given
+ * pre-serialized instruction data, which must consist only of complete
+ * Guacamole protocol instructions. Ownership of the given data (which must
+ * have been allocated with guac_mem_alloc() or equivalent) passes to the
+ * returned buffer, and the data will be automatically freed along with the
+ * buffer once all references have been released.
+ *
+ * The returned buffer has a single reference, which must eventually be
+ * released by the caller with guac_socket_shared_buffer_unref().
+ *
+ * @param buffer
+ *     The pre-serialized instruction data that the allocated buffer should
+ *     contain.
+ *
+ * @param length
+ *     The number of bytes within the given data.
+ *
+ * @return
+ *     A newly-allocated guac_socket_shared_buffer containing the given data.
+ */
+guac_socket_shared_buffer* guac_socket_shared_buffer_alloc(char* buffer,
+        size_t length);
+
+/**
+ * Acquires an additional reference to the given shared buffer. Each reference
+ * acquired must eventually be released with
+ * guac_socket_shared_buffer_unref().
+ *
+ * @param buf
+ *     The shared buffer to acquire a reference to.
+ */
+void guac_socket_shared_buffer_ref(guac_socket_shared_buffer* buf);
+
+/**
+ * Releases a reference to the given shared buffer, freeing the buffer and
+ * its data once no references remain.
+ *
+ * @param buf
+ *     The shared buffer to release a reference to.
+ */
+void guac_socket_shared_buffer_unref(guac_socket_shared_buffer* buf);
+
 /**
  * Allocates a new, completely blank guac_socket. This guac_socket will do
  * absolutely nothing when used unless its handlers are defined.
@@ -146,6 +241,28 @@ void guac_socket_free(guac_socket* socket);
  */
 void guac_socket_require_keep_alive(guac_socket* socket);
 
+/**
+ * Returns the total number of milliseconds that writes and flushes against
+ * the given socket have spent blocked waiting on the underlying transport,
+ * since the socket was allocated. A connection that is keeping up with the
+ * data written to it will leave this value nearly static, while a backed-up
+ * connection will cause it to advance in step with wall-clock time.
+ *
+ * Callers interested in backpressure should sample this value periodically
+ * and compare its growth against the sampling interval, throttling their own
+ * data source when a significant fraction of the interval was spent blocked.
+ * The value read is approximate if other threads are concurrently writing to
+ * the socket.
+ *
+ * @param socket
+ *     The guac_socket to retrieve the total write stall of.
+ *
+ * @return
+ *     The total number of milliseconds spent blocked on writes to the given
+ *     socket.
+ */
+uint64_t guac_socket_get_write_stall(guac_socket* socket);
+
 /**
  * Marks the beginning of a Guacamole protocol instruction.
  *
@@ -233,6 +350,45 @@ guac_socket* guac_socket_nest(guac_socket* parent, int index);
  */
 guac_socket* guac_socket_tee(guac_socket* primary, guac_socket* secondary);
 
+/**
+ * Allocates and initializes a new guac_socket which behaves identically to a
+ * socket returned by guac_socket_tee(), except that data is duplicated to the
+ * secondary socket asynchronously. Written data is spooled within a bounded,
+ * lock-free queue which is drained by a dedicated thread, guaranteeing that
+ * writes and flushes of the returned socket never wait on I/O performed
+ * against the secondary socket, no matter how slow that socket may be.
+ *
+ * If the spool fills (because the secondary socket cannot keep up), or if a
+ * write to the secondary socket fails, the secondary socket is permanently
+ * abandoned: no further data will be duplicated, and the primary socket
+ * continues unaffected. As with guac_socket_tee(), errors from the secondary
+ * socket are never exposed to callers.
+ *
+ * If an error occurs while allocating the guac_socket object or creating the
+ * thread which drains the spool, NULL is returned, guac_error is set
+ * appropriately, and neither provided socket is freed.
+ *
+ * @param primary
+ *     The primary guac_socket to which all socket operations should be
+ *     delegated. The error codes returned by socket operations, if any, will
+ *     always come from this socket. This socket will also be the only socket
+ *     locked when instructions begin (or unlocked when instructions end).
+ *
+ * @param secondary
+ *     The secondary guac_socket to which all data written to the primary
+ *     guac_socket should be copied asynchronously. If an error prevents
+ *     writes from succeeding, or if this socket cannot keep up with the
+ *     volume of data written, this socket will cease receiving data, and
+ *     only the primary socket will continue to be used.
+ *
+ * @return
+ *     A newly allocated guac_socket object associated with the given primary
+ *     and secondary sockets, or NULL if an error occurs while allocating the
+ *     guac_socket object or creating its drain thread.
+ */
+guac_socket* guac_socket_tee_async(guac_socket* primary,
+        guac_socket* secondary);
+
 /**
  * Allocates and initializes a new guac_socket which duplicates all
  * instructions written across the sockets of each connected user of the
@@ -285,6 +441,60 @@ guac_socket* guac_socket_broadcast(guac_client* client);
  */
 guac_socket* guac_socket_broadcast_pending(guac_client* client);
 
+/**
+ * Allocates and initializes a new guac_socket which duplicates all
+ * instructions written across the sockets of each non-pending connected user
+ * of the given guac_client that declared support for WebP during the
+ * handshake. The returned socket is a write-only socket. Attempts to read
+ * from the socket will fail. If a write occurs while no such users are
+ * connected, that write will simply be dropped.
+ *
+ * Return values (error codes) from each user's socket will not affect the
+ * in-progress write, but each failing user will be forcibly stopped with
+ * guac_user_stop().
+ *
+ * If an error occurs while allocating the guac_socket object, NULL is returned,
+ * and guac_error is set appropriately.
+ *
+ * @param client
+ *     The client whose WebP-capable users should receive duplicates of all
+ *     instructions written.
+ *
+ * @return
+ *     A write-only guac_socket object which broadcasts copies of all
+ *     instructions written across all WebP-capable, non-pending connected
+ *     users of the given guac_client, or NULL if an error occurs while
+ *     allocating the guac_socket object.
+ */
+guac_socket* guac_socket_broadcast_webp(guac_client* client);
+
+/**
+ * Allocates and initializes a new guac_socket which duplicates all
+ * instructions written across the sockets of each non-pending connected user
+ * of the given guac_client that did NOT declare support for WebP during the
+ * handshake. The returned socket is a write-only socket. Attempts to read
+ * from the socket will fail. If a write occurs while no such users are
+ * connected, that write will simply be dropped.
+ *
+ * Return values (error codes) from each user's socket will not affect the
+ * in-progress write, but each failing user will be forcibly stopped with
+ * guac_user_stop().
+ *
+ * If an error occurs while allocating the guac_socket object, NULL is returned,
+ * and guac_error is set appropriately.
+ *
+ * @param client
+ *     The client whose users lacking WebP support should receive duplicates
+ *     of all instructions written.
+ *
+ * @return
+ *     A write-only guac_socket object which broadcasts copies of all
+ *     instructions written across all non-pending connected users of the
+ *     given guac_client that lack WebP support, or NULL if an error occurs
+ *     while allocating the guac_socket object.
+ */
+guac_socket* guac_socket_broadcast_non_webp(guac_client* client);
+
 /**
  * Writes the given unsigned int to the given guac_socket object. The data
  * written may be buffered until the buffer is flushed automatically or
@@ -345,6 +555,33 @@ ssize_t guac_socket_write_base64(guac_socket* socket, const void* buf, size_t co
  */
 ssize_t guac_socket_write(guac_socket* socket, const void* buf, size_t count);
 
+/**
+ * Writes the given shared buffer of pre-serialized instructions to the
+ * specified socket. Sockets which support queueing output by reference will
+ * take a reference to the given buffer rather than copy its contents,
+ * allowing the same buffer to be written to many sockets while being
+ * serialized (and stored) only once. All other sockets simply receive a copy
+ * of the buffer contents, exactly as if written with guac_socket_write().
+ *
+ * As the buffer must contain only complete instructions, this function may
+ * only be called while exclusive access to the socket is held (between calls
+ * to guac_socket_instruction_begin() and guac_socket_instruction_end()).
+ *
+ * If an error occurs while writing, a non-zero value is returned, and
+ * guac_error is set appropriately.
+ *
+ * @param socket
+ *     The guac_socket object to write to.
+ *
+ * @param buf
+ *     The shared buffer to write.
+ *
+ * @return
+ *     Zero on success, or non-zero if an error occurs while writing.
+ */
+ssize_t guac_socket_write_shared(guac_socket* socket,
+        guac_socket_shared_buffer* buf);
+
 /**
  * Attempts to read data from the socket, filling up to the specified number
  * of bytes in the given buffer.
@@ -360,6 +597,24 @@ ssize_t guac_socket_write(guac_socket* socket, const void* buf, size_t count);
  */
 ssize_t guac_socket_read(guac_socket* socket, void* buf, size_t count);
 
+/**
+ * Attempts to read data from the socket, filling the given buffers in order
+ * with a single underlying read operation where the socket implementation
+ * supports doing so. If the socket implementation does not support scatter
+ * reads, only the first buffer will be filled.
+ *
+ * If an error occurs while reading, a negative value is returned, and
+ * guac_error is set appropriately.
+ *
+ * @param socket The guac_socket to read from.
+ * @param iov The array of buffers to read bytes into, in order.
+ * @param iovcnt The number of buffers within the given array.
+ * @return The number of bytes read, or a negative value if an error occurs
+ *         while reading.
+ */
+ssize_t guac_socket_readv(guac_socket* socket, const struct iovec* iov,
+        int iovcnt);
+
 /**
  * Flushes the base64 buffer, writing padding characters as necessary.
  *
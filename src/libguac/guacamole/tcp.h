@@ -37,6 +37,11 @@
  * eventually be freed with a call to close(). If this function fails,
  * guac_error will be set appropriately.
  *
+ * If the hostname resolves to multiple addresses, connection attempts are
+ * made against each in parallel, staggered by a short delay and alternating
+ * between address families where possible (RFC 8305 "Happy Eyeballs"), with
+ * the first attempt to succeed winning.
+ *
  * @param hostname
  *     The hostname or IP address to which to attempt connections.
  *
@@ -44,7 +49,8 @@
  *     The TCP port to which to attempt to connect.
  *
  * @param timeout
- *     The number of seconds to try the TCP connection before timing out.
+ *     The maximum number of seconds to spend attempting to connect, across
+ *     all resolved addresses, before timing out.
  *
  * @return
  *     A valid socket if the connection succeeds, or a negative integer if it
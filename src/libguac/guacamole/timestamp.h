@@ -39,6 +39,27 @@
  */
 guac_timestamp guac_timestamp_current();
 
+/**
+ * Returns an arbitrary timestamp from a cheaper but less accurate source
+ * than guac_timestamp_current(). Timestamps returned by this function use
+ * the same epoch as guac_timestamp_current() and may be freely compared with
+ * its return values, but may lag behind the precise time by a few
+ * milliseconds (one kernel tick). On platforms maintaining a coarse clock,
+ * reading that clock avoids reading the underlying hardware counter
+ * entirely; on all other platforms, this function is identical to
+ * guac_timestamp_current().
+ *
+ * This function is intended for hot paths that merely need to know roughly
+ * what time it is, such as idle checks against multi-second thresholds.
+ * Measurements of short durations (frame timing and the like) should use
+ * guac_timestamp_current().
+ *
+ * @return
+ *     An arbitrary millisecond timestamp, possibly lagging the precise time
+ *     by a few milliseconds.
+ */
+guac_timestamp guac_timestamp_current_coarse();
+
 /**
  * Sleeps for the given number of milliseconds.
  *
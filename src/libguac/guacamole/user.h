@@ -893,6 +893,38 @@ int guac_user_supports_required(guac_user* user);
  */
 int guac_user_supports_webp(guac_user* user);
 
+/**
+ * Returns whether the given user supports the cells instruction, as declared
+ * by the presence of the GUAC_PROTOCOL_CELLS_MIMETYPE pseudo mimetype within
+ * the list of supported image mimetypes provided by that user during the
+ * connection handshake.
+ *
+ * @param user
+ *     The Guacamole user to check for cells instruction support.
+ *
+ * @return
+ *     Non-zero if the given user claims to support the cells instruction,
+ *     zero otherwise.
+ */
+int guac_user_supports_cell_runs(guac_user* user);
+
+/**
+ * Returns whether the given user supports receiving video streams of the
+ * given mimetype, as declared by the list of supported video mimetypes
+ * provided by that user during the connection handshake.
+ *
+ * @param user
+ *     The user to check.
+ *
+ * @param mimetype
+ *     The video mimetype to check for, such as "video/h264".
+ *
+ * @return
+ *     Non-zero if the given user claims to support video streams of the
+ *     given mimetype, zero otherwise.
+ */
+int guac_user_supports_video(guac_user* user, const char* mimetype);
+
 /**
  * Automatically handles a single argument received from a joining user,
  * returning a newly-allocated string containing that value. If the argument
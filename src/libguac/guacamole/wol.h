@@ -27,8 +27,37 @@
  * @file wol.h
  */
 
+#include "client-types.h"
 #include "wol-constants.h"
 
+/**
+ * An asynchronous attempt to wake a remote host with Wake-on-LAN and wait for
+ * it to become reachable, as started by guac_wol_wake_and_wait_async(). The
+ * outcome of the attempt is collected with guac_wol_wake_and_wait_result().
+ */
+typedef struct guac_wol_wait guac_wol_wait;
+
+/**
+ * Initializes a registry of the wake state of recently-woken remote hosts,
+ * shared between the calling process and all processes later forked from it.
+ * Once initialized, concurrent wake attempts for a single host coalesce into
+ * one wake cycle: only the first attempt sends magic Wake-on-LAN packets,
+ * with the remaining attempts simply polling until the host becomes
+ * reachable, and attempts for hosts that have just been observed reachable
+ * succeed immediately without probing the host again.
+ *
+ * This function is intended to be invoked once by daemons (such as guacd)
+ * that fork a process per connection, before any connection processes are
+ * forked. Without a registry, each wake attempt independently sends its own
+ * packets and polls on its own, exactly as if no registry existed.
+ *
+ * @return
+ *     Zero if the registry was successfully initialized (or was already
+ *     initialized), non-zero if shared memory for the registry could not be
+ *     allocated.
+ */
+int guac_wol_init_registry(void);
+
 /**
  * Send the wake-up packet to the specified destination, returning zero if the
  * wake was sent successfully, or non-zero if an error occurs sending the
@@ -96,5 +125,73 @@ int guac_wol_wake_and_wait(const char* mac_addr, const char* broadcast_addr,
         const unsigned short udp_port, int wait_time, int retries,
         const char* hostname, const char* port, const int timeout);
 
+/**
+ * Sends the wake-up packet and polls the remote host in a background thread,
+ * rather than blocking the calling thread for the full duration of the wait.
+ * If the remote host is already reachable, no wake-up packet is sent at all.
+ * Progress is logged against the given client as polling proceeds, and the
+ * wait is abandoned early if that client stops running (such as when its
+ * users disconnect before the host has woken).
+ *
+ * The returned guac_wol_wait must eventually be provided to
+ * guac_wol_wake_and_wait_result(), which collects the outcome of the wake
+ * attempt and frees all associated resources.
+ *
+ * @param client
+ *     The client on whose behalf the remote host is being woken, or NULL if
+ *     the wait is not associated with any client.
+ *
+ * @param mac_addr
+ *     The MAC address to place in the magic Wake-on-LAN packet.
+ *
+ * @param broadcast_addr
+ *     The broadcast address to which to send the magic Wake-on-LAN packet.
+ *
+ * @param udp_port
+ *     The UDP port to use when sending the WoL packet.
+ *
+ * @param wait_time
+ *     The number of seconds to wait between connection attempts after the WOL
+ *     packet has been sent.
+ *
+ * @param retries
+ *     The number of attempts to make to connect to the system before giving up
+ *     on the connection.
+ *
+ * @param hostname
+ *     The hostname or IP address of the system that has been woken up and to
+ *     to which the connection will be attempted.
+ *
+ * @param port
+ *     The TCP port of the remote system on which the connection will be
+ *     attempted after the system has been woken.
+ *
+ * @param timeout
+ *     The number of seconds to wait when attempting the connection to the
+ *     remote system when checking to see if it is awake.
+ *
+ * @return
+ *     A new guac_wol_wait tracking the background wake attempt, or NULL if
+ *     the background thread could not be started.
+ */
+guac_wol_wait* guac_wol_wake_and_wait_async(guac_client* client,
+        const char* mac_addr, const char* broadcast_addr,
+        const unsigned short udp_port, int wait_time, int retries,
+        const char* hostname, const char* port, const int timeout);
+
+/**
+ * Waits for the given background wake attempt to complete, returning zero if
+ * the remote host became reachable and non-zero otherwise. All resources
+ * associated with the given guac_wol_wait are freed by this function.
+ *
+ * @param wait
+ *     The background wake attempt to collect the result of.
+ *
+ * @return
+ *     Zero if the remote host became reachable before the configured number
+ *     of attempts was exhausted, non-zero otherwise.
+ */
+int guac_wol_wake_and_wait_result(guac_wol_wait* wait);
+
 #endif /* GUAC_WOL_H */
 
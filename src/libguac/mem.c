@@ -17,6 +17,8 @@
  * under the License.
  */
 
+#include "config.h"
+
 #include "guacamole/assert.h"
 #include "guacamole/error.h"
 #include "guacamole/mem.h"
@@ -26,6 +28,15 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#if defined(HAVE_MALLOC_USABLE_SIZE) && defined(HAVE_MALLOC_H)
+#include <malloc.h>
+#endif
+
+#if defined(HAVE_MADVISE)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 /*
  * ============================================================================
  *
@@ -45,6 +56,186 @@
  * ============================================================================
  */
 
+/**
+ * The number of bytes currently allocated through guac_mem_alloc() and
+ * similar, as measured at allocation time via malloc_usable_size(). Accessed
+ * only through atomic builtins. Remains zero on platforms lacking
+ * malloc_usable_size().
+ */
+static size_t guac_mem_used = 0;
+
+/**
+ * The maximum value observed for guac_mem_used over the life of the process.
+ * Accessed only through atomic builtins.
+ */
+static size_t guac_mem_peak = 0;
+
+/**
+ * The configured soft limit on the total number of bytes that may be
+ * allocated through guac_mem_alloc() and similar, or zero if no limit is
+ * enforced. Accessed only through atomic builtins.
+ */
+static size_t guac_mem_limit = 0;
+
+/**
+ * Records that the given block of memory has been allocated, adding its
+ * usable size to the running total and updating the observed peak. If the
+ * given block is NULL, or the platform lacks malloc_usable_size(), this
+ * function has no effect.
+ *
+ * @param mem
+ *     The block of memory that has been allocated.
+ */
+static void guac_mem_track_alloc(void* mem) {
+
+#if defined(HAVE_MALLOC_USABLE_SIZE) && defined(HAVE_MALLOC_H)
+    if (mem == NULL)
+        return;
+
+    size_t used = __atomic_add_fetch(&guac_mem_used,
+            malloc_usable_size(mem), __ATOMIC_RELAXED);
+
+    /* Update peak usage if the current usage exceeds it */
+    size_t peak = __atomic_load_n(&guac_mem_peak, __ATOMIC_RELAXED);
+    while (used > peak && !__atomic_compare_exchange_n(&guac_mem_peak,
+                &peak, used, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+#endif
+
+}
+
+/**
+ * Records that the given block of memory is being freed, subtracting its
+ * usable size from the running total. If the given block is NULL, or the
+ * platform lacks malloc_usable_size(), this function has no effect.
+ *
+ * @param mem
+ *     The block of memory being freed.
+ */
+static void guac_mem_track_free(void* mem) {
+
+#if defined(HAVE_MALLOC_USABLE_SIZE) && defined(HAVE_MALLOC_H)
+    if (mem == NULL)
+        return;
+
+    __atomic_sub_fetch(&guac_mem_used, malloc_usable_size(mem),
+            __ATOMIC_RELAXED);
+#endif
+
+}
+
+/**
+ * Returns whether allocating the given number of additional bytes would
+ * exceed the configured soft memory limit. If no limit is configured, or
+ * usage is not tracked on this platform, allocations never exceed the limit.
+ *
+ * @param size
+ *     The size of the proposed allocation, in bytes.
+ *
+ * @return
+ *     Non-zero if the proposed allocation would exceed the configured limit,
+ *     zero otherwise.
+ */
+static int guac_mem_exceeds_limit(size_t size) {
+
+    size_t limit = __atomic_load_n(&guac_mem_limit, __ATOMIC_RELAXED);
+    if (limit == 0)
+        return 0;
+
+    size_t used = __atomic_load_n(&guac_mem_used, __ATOMIC_RELAXED);
+    return size > limit || used > limit - size;
+
+}
+
+void guac_mem_get_stats(guac_mem_stats* stats) {
+    stats->used  = __atomic_load_n(&guac_mem_used,  __ATOMIC_RELAXED);
+    stats->peak  = __atomic_load_n(&guac_mem_peak,  __ATOMIC_RELAXED);
+    stats->limit = __atomic_load_n(&guac_mem_limit, __ATOMIC_RELAXED);
+}
+
+void guac_mem_set_limit(size_t limit) {
+    __atomic_store_n(&guac_mem_limit, limit, __ATOMIC_RELAXED);
+}
+
+/**
+ * The size of a transparent huge page, in bytes. The kernel will only back a
+ * region of memory with a huge page if that region covers an entire
+ * huge-page-aligned extent of this size. While huge page sizes technically
+ * vary between architectures, 2 MB is by far the most common.
+ */
+#define GUAC_MEM_HUGE_PAGE_SIZE 2097152
+
+/**
+ * Whether large allocations should be backed by transparent huge pages where
+ * possible, as configured through guac_mem_set_huge_pages(). Accessed only
+ * through atomic builtins.
+ */
+static int guac_mem_huge_pages = 0;
+
+void guac_mem_set_huge_pages(int enabled) {
+    __atomic_store_n(&guac_mem_huge_pages, enabled, __ATOMIC_RELAXED);
+}
+
+void guac_mem_advise_huge_pages(void* mem, size_t length) {
+
+#if defined(HAVE_MADVISE) && defined(MADV_HUGEPAGE)
+
+    if (!__atomic_load_n(&guac_mem_huge_pages, __ATOMIC_RELAXED))
+        return;
+
+    if (mem == NULL)
+        return;
+
+    /* The kernel will only use huge pages for huge-page-aligned extents, so
+     * round the start of the region up and the end of the region down to the
+     * nearest huge page boundary */
+    uintptr_t start = ((uintptr_t) mem + GUAC_MEM_HUGE_PAGE_SIZE - 1)
+        & ~((uintptr_t) GUAC_MEM_HUGE_PAGE_SIZE - 1);
+    uintptr_t end = ((uintptr_t) mem + length)
+        & ~((uintptr_t) GUAC_MEM_HUGE_PAGE_SIZE - 1);
+
+    /* Do nothing if the region does not cover at least one entire aligned
+     * huge page */
+    if (end <= start)
+        return;
+
+    /* Failure here is acceptable - huge page backing is strictly an
+     * optimization, and the memory behaves identically without it */
+    madvise((void*) start, end - start, MADV_HUGEPAGE);
+
+#endif
+
+}
+
+void guac_mem_advise_unneeded(void* mem, size_t length) {
+
+#if defined(HAVE_MADVISE) && defined(MADV_DONTNEED)
+
+    if (mem == NULL)
+        return;
+
+    /* Only whole pages can be reclaimed, so round the start of the region up
+     * and the end of the region down to the nearest page boundary. Partial
+     * pages at either end may be shared with neighboring allocations or
+     * allocator metadata, whose contents must be preserved */
+    size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+    uintptr_t start = ((uintptr_t) mem + page_size - 1)
+        & ~((uintptr_t) page_size - 1);
+    uintptr_t end = ((uintptr_t) mem + length)
+        & ~((uintptr_t) page_size - 1);
+
+    /* Do nothing if the region does not cover at least one entire page */
+    if (end <= start)
+        return;
+
+    /* Failure here is acceptable - releasing backing pages is strictly a
+     * memory usage optimization, and the region remains valid and writable
+     * regardless */
+    madvise((void*) start, end - start, MADV_DONTNEED);
+
+#endif
+
+}
+
 int PRIV_guac_mem_ckd_mul(size_t* result, size_t factor_count, const size_t* factors) {
 
     /* Consider calculation invalid if no factors are provided at all */
@@ -166,6 +357,13 @@ void* PRIV_guac_mem_alloc(size_t factor_count, const size_t* factors) {
     else if (size == 0)
         return NULL;
 
+    /* Refuse allocations that would exceed the configured soft limit */
+    if (guac_mem_exceeds_limit(size)) {
+        guac_error = GUAC_STATUS_NO_MEMORY;
+        guac_error_message = "Session memory limit exceeded";
+        return NULL;
+    }
+
     void* mem = malloc(size);
     if (mem == NULL) {
         /* C does not require that malloc() set errno (though POSIX does). For
@@ -174,6 +372,7 @@ void* PRIV_guac_mem_alloc(size_t factor_count, const size_t* factors) {
         guac_error = GUAC_STATUS_NO_MEMORY;
     }
 
+    guac_mem_track_alloc(mem);
     return mem;
 
 }
@@ -189,6 +388,13 @@ void* PRIV_guac_mem_zalloc(size_t factor_count, const size_t* factors) {
     else if (size == 0)
         return NULL;
 
+    /* Refuse allocations that would exceed the configured soft limit */
+    if (guac_mem_exceeds_limit(size)) {
+        guac_error = GUAC_STATUS_NO_MEMORY;
+        guac_error_message = "Session memory limit exceeded";
+        return NULL;
+    }
+
     void* mem = calloc(1, size);
     if (mem == NULL) {
         /* C does not require that calloc() set errno (though POSIX does). For
@@ -197,6 +403,7 @@ void* PRIV_guac_mem_zalloc(size_t factor_count, const size_t* factors) {
         guac_error = GUAC_STATUS_NO_MEMORY;
     }
 
+    guac_mem_track_alloc(mem);
     return mem;
 
 }
@@ -216,14 +423,29 @@ void* PRIV_guac_mem_realloc(void* mem, size_t factor_count, const size_t* factor
         return NULL;
     }
 
+    /* Refuse reallocations that would exceed the configured soft limit (the
+     * existing block is intentionally not subtracted here, as the old and
+     * new blocks may briefly coexist during realloc()) */
+    if (guac_mem_exceeds_limit(size)) {
+        guac_error = GUAC_STATUS_NO_MEMORY;
+        guac_error_message = "Session memory limit exceeded";
+        return NULL;
+    }
+
+    guac_mem_track_free(mem);
     void* resized_mem = realloc(mem, size);
     if (resized_mem == NULL) {
         /* C does not require that realloc() set errno (though POSIX does). For
          * portability, we set guac_error here regardless of the underlying
          * behavior of realloc(). */
         guac_error = GUAC_STATUS_NO_MEMORY;
+
+        /* The original block remains allocated if realloc() fails */
+        guac_mem_track_alloc(mem);
+        return NULL;
     }
 
+    guac_mem_track_alloc(resized_mem);
     return resized_mem;
 
 }
@@ -243,6 +465,13 @@ void* PRIV_guac_mem_realloc_or_die(void* mem, size_t factor_count, const size_t*
 }
 
 void PRIV_guac_mem_free(void* mem) {
+
+    /* NOTE: Blocks allocated through guac_mem_alloc() but released through
+     * the standard free() (as permitted for compatibility) bypass this
+     * accounting, and reported usage will be correspondingly high. Such
+     * usages are rare and small. */
+    guac_mem_track_free(mem);
     free(mem);
+
 }
 
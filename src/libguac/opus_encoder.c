@@ -0,0 +1,202 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "guacamole/mem.h"
+#include "guacamole/audio.h"
+#include "guacamole/client.h"
+#include "guacamole/protocol.h"
+#include "guacamole/socket.h"
+#include "guacamole/user.h"
+#include "opus_encoder.h"
+
+#include <opus/opus.h>
+
+#include <stdio.h>
+#include <string.h>
+
+int opus_encoder_supports(int rate, int channels, int bps) {
+
+    /* Opus accepts only 16-bit PCM in mono or stereo */
+    if (bps != 16 || channels < 1 || channels > 2)
+        return 0;
+
+    /* Opus accepts only a fixed set of sample rates */
+    return rate == 8000  || rate == 12000 || rate == 16000
+        || rate == 24000 || rate == 48000;
+
+}
+
+/**
+ * Sends the "audio" instruction which associates the audio stream of the
+ * given guac_audio_stream with the Opus mimetype, along with the rate and
+ * number of channels of the underlying PCM data.
+ *
+ * @param audio
+ *     The guac_audio_stream to announce.
+ *
+ * @param socket
+ *     The guac_socket over which the "audio" instruction should be sent.
+ */
+static void opus_encoder_send_audio(guac_audio_stream* audio,
+        guac_socket* socket) {
+
+    char mimetype[256];
+
+    /* Produce mimetype string from format info */
+    snprintf(mimetype, sizeof(mimetype), "audio/opus;rate=%i,channels=%i",
+            audio->rate, audio->channels);
+
+    /* Associate stream */
+    guac_protocol_send_audio(socket, audio->stream, mimetype);
+
+}
+
+/**
+ * Encodes the single complete Opus frame stored within the PCM buffer of the
+ * given encoder state, sending the resulting Opus packet as a blob. The PCM
+ * buffer must contain exactly one full frame of samples.
+ *
+ * @param audio
+ *     The guac_audio_stream associated with the frame being encoded.
+ */
+static void opus_encoder_encode_frame(guac_audio_stream* audio) {
+
+    opus_encoder_state* state = (opus_encoder_state*) audio->data;
+    unsigned char packet[GUAC_OPUS_ENCODER_MAX_PACKET_SIZE];
+
+    /* Encode buffered frame as single Opus packet */
+    opus_int32 length = opus_encode(state->opus, state->pcm_buffer,
+            state->frame_size, packet, sizeof(packet));
+
+    /* Send packet as its own blob, relying on the protocol to preserve blob
+     * boundaries (and thus packet boundaries) */
+    if (length > 0)
+        guac_protocol_send_blob(audio->client->socket, audio->stream,
+                packet, length);
+
+    /* All buffered samples have been consumed */
+    state->pcm_buffered = 0;
+
+}
+
+static void opus_encoder_begin_handler(guac_audio_stream* audio) {
+
+    opus_encoder_state* state;
+    int opus_error;
+
+    /* Broadcast existence of stream */
+    opus_encoder_send_audio(audio, audio->client->socket);
+
+    /* Allocate and init encoder state */
+    audio->data = state = guac_mem_alloc(sizeof(opus_encoder_state));
+    state->frame_size = audio->rate * GUAC_OPUS_ENCODER_FRAME_DURATION / 1000;
+    state->pcm_buffered = 0;
+
+    state->pcm_buffer = guac_mem_alloc(guac_mem_ckd_mul_or_die(
+            state->frame_size, audio->channels, sizeof(opus_int16)));
+
+    /* Init libopus encoder for provided PCM format */
+    state->opus = opus_encoder_create(audio->rate, audio->channels,
+            OPUS_APPLICATION_AUDIO, &opus_error);
+
+    /* Apply target bitrate */
+    opus_encoder_ctl(state->opus, OPUS_SET_BITRATE(GUAC_OPUS_ENCODER_BITRATE));
+
+}
+
+static void opus_encoder_join_handler(guac_audio_stream* audio,
+        guac_user* user) {
+
+    /* Notify user of existence of stream */
+    opus_encoder_send_audio(audio, user->socket);
+
+}
+
+static void opus_encoder_end_handler(guac_audio_stream* audio) {
+
+    opus_encoder_state* state = (opus_encoder_state*) audio->data;
+
+    /* Encode any partial final frame, padded with silence */
+    if (state->pcm_buffered > 0) {
+
+        int samples = state->frame_size * audio->channels;
+        memset(state->pcm_buffer + state->pcm_buffered, 0,
+                (samples - state->pcm_buffered) * sizeof(opus_int16));
+
+        opus_encoder_encode_frame(audio);
+
+    }
+
+    /* Send end of stream */
+    guac_protocol_send_end(audio->client->socket, audio->stream);
+
+    /* Free state information */
+    opus_encoder_destroy(state->opus);
+    guac_mem_free(state->pcm_buffer);
+    guac_mem_free(state);
+
+}
+
+static void opus_encoder_write_handler(guac_audio_stream* audio,
+        const unsigned char* pcm_data, int length) {
+
+    opus_encoder_state* state = (opus_encoder_state*) audio->data;
+
+    /* Available samples, counting each channel separately */
+    int samples = length / sizeof(opus_int16);
+    int frame_samples = state->frame_size * audio->channels;
+
+    while (samples > 0) {
+
+        /* Copy no more samples than will fit within the current frame */
+        int chunk_size = frame_samples - state->pcm_buffered;
+        if (chunk_size > samples)
+            chunk_size = samples;
+
+        /* Copy block of PCM data into frame buffer */
+        memcpy(state->pcm_buffer + state->pcm_buffered, pcm_data,
+                chunk_size * sizeof(opus_int16));
+
+        /* Advance to next block */
+        state->pcm_buffered += chunk_size;
+        pcm_data += chunk_size * sizeof(opus_int16);
+        samples -= chunk_size;
+
+        /* Encode and send frame once complete */
+        if (state->pcm_buffered == frame_samples)
+            opus_encoder_encode_frame(audio);
+
+    }
+
+}
+
+/* Opus encoder handlers */
+guac_audio_encoder _opus_encoder = {
+    .mimetype      = "audio/opus",
+    .begin_handler = opus_encoder_begin_handler,
+    .write_handler = opus_encoder_write_handler,
+    .join_handler  = opus_encoder_join_handler,
+    .end_handler   = opus_encoder_end_handler
+};
+
+/* Actual encoder definition */
+guac_audio_encoder* opus_encoder = &_opus_encoder;
+
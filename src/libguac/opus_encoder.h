@@ -0,0 +1,110 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_OPUS_ENCODER_H
+#define GUAC_OPUS_ENCODER_H
+
+#include "config.h"
+
+#include "guacamole/audio.h"
+
+#include <opus/opus.h>
+
+/**
+ * The duration of each Opus frame, in milliseconds. All PCM data is encoded
+ * in frames of exactly this duration, with each encoded frame sent as its own
+ * blob. The Guacamole protocol preserves blob boundaries, and thus no
+ * additional packet framing is required.
+ */
+#define GUAC_OPUS_ENCODER_FRAME_DURATION 20
+
+/**
+ * The maximum size of any single encoded Opus packet, in bytes. Opus
+ * recommends 4000 bytes as sufficient for the largest packet the reference
+ * encoder will produce.
+ */
+#define GUAC_OPUS_ENCODER_MAX_PACKET_SIZE 4000
+
+/**
+ * The target bitrate of the Opus encoder, in bits per second. Opus at this
+ * bitrate is effectively transparent for most content, while requiring
+ * roughly one fifteenth the bandwidth of 16-bit 48kHz stereo PCM.
+ */
+#define GUAC_OPUS_ENCODER_BITRATE 96000
+
+/**
+ * The current state of the Opus encoder. PCM data is buffered only until a
+ * full Opus frame has accumulated, at which point that frame is encoded and
+ * sent as a blob.
+ */
+typedef struct opus_encoder_state {
+
+    /**
+     * The libopus encoder which will be used to encode all provided PCM
+     * data.
+     */
+    OpusEncoder* opus;
+
+    /**
+     * The number of samples (per channel) within each Opus frame.
+     */
+    int frame_size;
+
+    /**
+     * Buffer of not-yet-encoded 16-bit PCM samples. This buffer is large
+     * enough to hold exactly one Opus frame.
+     */
+    opus_int16* pcm_buffer;
+
+    /**
+     * The current number of samples stored within the PCM buffer, counting
+     * each channel of a multi-channel sample separately.
+     */
+    int pcm_buffered;
+
+} opus_encoder_state;
+
+/**
+ * Returns whether the Opus encoder supports the given PCM format. Opus
+ * accepts only 16-bit PCM at one of a fixed set of sample rates, in mono or
+ * stereo.
+ *
+ * @param rate
+ *     The rate of the PCM format, in samples per second.
+ *
+ * @param channels
+ *     The number of channels within the PCM format.
+ *
+ * @param bps
+ *     The number of bits per sample within the PCM format.
+ *
+ * @return
+ *     Non-zero if the Opus encoder supports the given PCM format, zero
+ *     otherwise.
+ */
+int opus_encoder_supports(int rate, int channels, int bps);
+
+/**
+ * Audio encoder which encodes PCM data as Opus, sending each encoded Opus
+ * packet as its own blob.
+ */
+extern guac_audio_encoder* opus_encoder;
+
+#endif
+
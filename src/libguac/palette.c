@@ -31,6 +31,21 @@
 
 guac_palette* guac_palette_alloc(cairo_surface_t* surface) {
 
+    /* Allocate palette */
+    guac_palette* palette = (guac_palette*) guac_mem_alloc(sizeof(guac_palette));
+
+    /* Free palette and fail if surface exceeds palette capacity */
+    if (guac_palette_init(palette, surface)) {
+        guac_palette_free(palette);
+        return NULL;
+    }
+
+    return palette;
+
+}
+
+int guac_palette_init(guac_palette* palette, cairo_surface_t* surface) {
+
     int x, y;
 
     int width = cairo_image_surface_get_width(surface);
@@ -38,8 +53,8 @@ guac_palette* guac_palette_alloc(cairo_surface_t* surface) {
     int stride = cairo_image_surface_get_stride(surface);
     unsigned char* data = cairo_image_surface_get_data(surface);
 
-    /* Allocate palette */
-    guac_palette* palette = (guac_palette*) guac_mem_zalloc(sizeof(guac_palette));
+    /* Reset palette (the given storage may be reused across images) */
+    memset(palette, 0, sizeof(guac_palette));
 
     for (y=0; y<height; y++) {
         for (x=0; x<width; x++) {
@@ -63,10 +78,8 @@ guac_palette* guac_palette_alloc(cairo_surface_t* surface) {
                     png_color* c;
 
                     /* Stop if already at capacity */
-                    if (palette->size == 256) {
-                        guac_palette_free(palette);
-                        return NULL;
-                    }
+                    if (palette->size == 256)
+                        return -1;
 
                     /* Store in palette */
                     c = &(palette->colors[palette->size]);
@@ -97,7 +110,7 @@ guac_palette* guac_palette_alloc(cairo_surface_t* surface) {
 
     }
 
-    return palette;
+    return 0;
 
 }
 
@@ -29,7 +29,61 @@
 #include <stdio.h>
 #include <string.h>
 
-static void guac_parser_reset(guac_parser* parser) {
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/**
+ * Counts the number of UTF-8 characters which begin within the given 16-byte
+ * chunk of data, using vector instructions where available. As UTF-8
+ * continuation bytes always match the bit pattern 10xxxxxx, this is the
+ * number of bytes within the chunk which do not match that pattern.
+ *
+ * @param chunk
+ *     The 16-byte chunk of UTF-8 data to scan.
+ *
+ * @return
+ *     The number of UTF-8 characters beginning within the given chunk.
+ */
+static int guac_parser_count_utf8_chars(const char* chunk) {
+
+#if defined(__SSE2__)
+
+    /* Produce a bitmask identifying all continuation bytes within the
+     * chunk */
+    __m128i data = _mm_loadu_si128((const __m128i*) chunk);
+    __m128i continuation = _mm_cmpeq_epi8(
+            _mm_and_si128(data, _mm_set1_epi8((char) 0xC0)),
+            _mm_set1_epi8((char) 0x80));
+
+    return 16 - __builtin_popcount(_mm_movemask_epi8(continuation));
+
+#elif defined(__ARM_NEON)
+
+    /* Produce a vector of 0x01 for each continuation byte within the
+     * chunk */
+    uint8x16_t data = vld1q_u8((const uint8_t*) chunk);
+    uint8x16_t continuation = vandq_u8(
+            vceqq_u8(vandq_u8(data, vdupq_n_u8(0xC0)), vdupq_n_u8(0x80)),
+            vdupq_n_u8(0x01));
+
+    return 16 - vaddvq_u8(continuation);
+
+#else
+
+    int chars = 0;
+    for (int i = 0; i < 16; i++)
+        chars += ((unsigned char) chunk[i] & 0xC0) != 0x80;
+
+    return chars;
+
+#endif
+
+}
+
+void guac_parser_reset(guac_parser* parser) {
     parser->opcode = NULL;
     parser->argc = 0;
     parser->state = GUAC_PARSE_LENGTH;
@@ -50,6 +104,10 @@ guac_parser* guac_parser_alloc() {
     /* Init parse start/end markers */
     parser->__instructionbuf_unparsed_start = parser->__instructionbuf;
     parser->__instructionbuf_unparsed_end = parser->__instructionbuf;
+    parser->__instructionbuf_parse_start = parser->__instructionbuf;
+
+    /* No data spilled beyond the instruction buffer yet */
+    parser->__spill_length = 0;
 
     guac_parser_reset(parser);
     return parser;
@@ -111,6 +169,66 @@ int guac_parser_append(guac_parser* parser, void* buffer, int length) {
     /* Parse element content */
     if (parser->state == GUAC_PARSE_CONTENT) {
 
+        /* Skip over element content in 16-byte chunks while enough
+         * characters certainly remain that neither the element terminator
+         * nor the end of the element can lie within the chunk. Characters
+         * are counted by their lead bytes, so chunk boundaries need not
+         * align with character boundaries here. */
+        int bulk_start = bytes_parsed;
+        while (parser->__element_length > 16 && bytes_parsed + 16 <= length) {
+            parser->__element_length -=
+                guac_parser_count_utf8_chars(char_buffer);
+            char_buffer += 16;
+            bytes_parsed += 16;
+        }
+
+        /* If bulk scanning stopped in the middle of a multi-byte character,
+         * back up to the lead byte of that character, which will be counted
+         * again by the character-at-a-time loop below. The byte following the
+         * scanned region may be consulted only if it lies within the provided
+         * data. */
+        if (bytes_parsed > bulk_start && bytes_parsed < length
+                && ((unsigned char) *char_buffer & 0xC0) == 0x80) {
+
+            do {
+                char_buffer--;
+                bytes_parsed--;
+            } while (bytes_parsed > bulk_start
+                    && ((unsigned char) *char_buffer & 0xC0) == 0x80);
+
+            parser->__element_length++;
+
+        }
+
+        /* If bulk scanning instead consumed all provided data, the provided
+         * data itself may end mid-character. Un-consume any trailing
+         * incomplete character (restoring its count) so that it is
+         * reexamined in full once its remaining bytes arrive, exactly as the
+         * character-at-a-time loop below does upon encountering an
+         * incomplete character */
+        else if (bytes_parsed > bulk_start && bytes_parsed == length) {
+
+            /* Locate the lead byte of the final character within the data */
+            int tail_length = 1;
+            while (bytes_parsed - tail_length > bulk_start
+                    && ((unsigned char) char_buffer[-tail_length] & 0xC0) == 0x80)
+                tail_length++;
+
+            /* Un-consume the final character if its lead byte (which the
+             * bulk scan counted) declares more bytes than are actually
+             * present */
+            unsigned char lead = (unsigned char) char_buffer[-tail_length];
+            if ((lead & 0xC0) != 0x80
+                    && guac_utf8_charsize(lead) > tail_length) {
+
+                char_buffer -= tail_length;
+                bytes_parsed -= tail_length;
+                parser->__element_length++;
+
+            }
+
+        }
+
         while (bytes_parsed < length && parser->__element_length >= 0) {
 
             /* Get length of current character */
@@ -168,13 +286,34 @@ int guac_parser_read(guac_parser* parser, guac_socket* socket, int usec_timeout)
 
     char* unparsed_end   = parser->__instructionbuf_unparsed_end;
     char* unparsed_start = parser->__instructionbuf_unparsed_start;
-    char* instr_start    = parser->__instructionbuf_unparsed_start;
     char* buffer_end     = parser->__instructionbuf + sizeof(parser->__instructionbuf);
 
-    /* Begin next instruction if previous was ended */
+    /* If resuming a partially parsed instruction (possible only if a prior
+     * call returned due to a timeout), the instruction being parsed began
+     * before the current unparsed region */
+    char* instr_start;
     if (parser->state == GUAC_PARSE_COMPLETE)
+        instr_start = unparsed_start;
+    else
+        instr_start = parser->__instructionbuf_parse_start;
+
+    /* Begin next instruction if previous was ended */
+    if (parser->state == GUAC_PARSE_COMPLETE) {
+
         guac_parser_reset(parser);
 
+        /* If every received byte has been parsed, the next instruction can
+         * reuse the buffer from the beginning. Without this, the buffer
+         * would fill over the course of many instructions and eventually
+         * force unparsed data to be shifted backward mid-instruction. */
+        if (unparsed_start == unparsed_end) {
+            unparsed_start = parser->__instructionbuf;
+            unparsed_end   = parser->__instructionbuf;
+            instr_start    = parser->__instructionbuf;
+        }
+
+    }
+
     while (parser->state != GUAC_PARSE_COMPLETE
         && parser->state != GUAC_PARSE_ERROR) {
 
@@ -219,14 +358,52 @@ int guac_parser_read(guac_parser* parser, guac_socket* socket, int usec_timeout)
 
             }
 
+            /* Drain previously spilled data into the freed space before
+             * reading from the socket again */
+            if (parser->__spill_length > 0) {
+
+                int drained = parser->__spill_length;
+                if (drained > buffer_end - unparsed_end)
+                    drained = buffer_end - unparsed_end;
+
+                memcpy(unparsed_end, parser->__spillbuf, drained);
+                unparsed_end += drained;
+
+                /* Retain any data which still does not fit */
+                parser->__spill_length -= drained;
+                memmove(parser->__spillbuf, parser->__spillbuf + drained,
+                        parser->__spill_length);
+
+                continue;
+
+            }
+
             /* No instruction yet? Get more data ... */
             retval = guac_socket_select(socket, usec_timeout);
-            if (retval <= 0)
+            if (retval <= 0) {
+
+                /* Preserve buffer state such that parsing of a partially
+                 * received instruction resumes correctly if the caller
+                 * retries after a timeout */
+                parser->__instructionbuf_parse_start = instr_start;
+                parser->__instructionbuf_unparsed_start = unparsed_start;
+                parser->__instructionbuf_unparsed_end = unparsed_end;
+
                 return -1;
-           
-            /* Attempt to fill buffer */
-            retval = guac_socket_read(socket, unparsed_end,
-                    buffer_end - unparsed_end);
+
+            }
+
+            /* Attempt to fill both the remaining instruction buffer space
+             * and the spill buffer with a single read, such that bulk input
+             * is received in few underlying read operations even when little
+             * contiguous space remains */
+            int space = buffer_end - unparsed_end;
+            struct iovec iov[2] = {
+                { .iov_base = unparsed_end,        .iov_len = space },
+                { .iov_base = parser->__spillbuf,  .iov_len = sizeof(parser->__spillbuf) }
+            };
+
+            retval = guac_socket_readv(socket, iov, 2);
 
             /* Set guac_error if read unsuccessful */
             if (retval < 0) {
@@ -243,8 +420,14 @@ int guac_parser_read(guac_parser* parser, guac_socket* socket, int usec_timeout)
                 return -1;
             }
 
-            /* Update internal buffer */
-            unparsed_end += retval;
+            /* Update internal buffer, tracking any data received beyond the
+             * instruction buffer for later draining */
+            if (retval > space) {
+                parser->__spill_length = retval - space;
+                unparsed_end = buffer_end;
+            }
+            else
+                unparsed_end += retval;
 
         }
 
@@ -290,7 +473,7 @@ int guac_parser_length(guac_parser* parser) {
     char* unparsed_end   = parser->__instructionbuf_unparsed_end;
     char* unparsed_start = parser->__instructionbuf_unparsed_start;
 
-    return unparsed_end - unparsed_start;
+    return (unparsed_end - unparsed_start) + parser->__spill_length;
 
 }
 
@@ -304,12 +487,30 @@ int guac_parser_shift(guac_parser* parser, void* buffer, int length) {
         copy_end = copy_start + length;
 
     /* Copy buffer */
-    length = copy_end - copy_start;
-    memcpy(buffer, copy_start, length);
+    int copied = copy_end - copy_start;
+    memcpy(buffer, copy_start, copied);
 
     parser->__instructionbuf_unparsed_start = copy_end;
 
-    return length;
+    /* Continue with any data received beyond the instruction buffer once the
+     * buffered region is exhausted */
+    if (copied < length && parser->__spill_length > 0) {
+
+        int drained = parser->__spill_length;
+        if (drained > length - copied)
+            drained = length - copied;
+
+        memcpy((char*) buffer + copied, parser->__spillbuf, drained);
+        copied += drained;
+
+        /* Retain any data not yet shifted out */
+        parser->__spill_length -= drained;
+        memmove(parser->__spillbuf, parser->__spillbuf + drained,
+                parser->__spill_length);
+
+    }
+
+    return copied;
 
 }
 
@@ -0,0 +1,326 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "guacamole/pixel.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define GUAC_PIXEL_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define GUAC_PIXEL_NEON 1
+#include <arm_neon.h>
+#endif
+
+/**
+ * Bulk implementation of guac_pixel_fill_alpha() leveraging vector
+ * instructions, or NULL if the current CPU supports no such implementation.
+ * Bulk implementations are free to process fewer pixels than requested,
+ * returning the number of pixels actually processed. Remaining pixels are
+ * processed by the scalar implementation.
+ */
+static size_t (*__guac_pixel_fill_alpha_bulk)(uint32_t* dst,
+        const uint32_t* src, size_t count) = NULL;
+
+/**
+ * Bulk implementation of guac_pixel_pack_rgb() leveraging vector
+ * instructions, or NULL if the current CPU supports no such implementation.
+ */
+static size_t (*__guac_pixel_pack_rgb_bulk)(unsigned char* dst,
+        const uint32_t* src, size_t count) = NULL;
+
+/**
+ * Bulk implementation of guac_pixel_unpack_rgb() leveraging vector
+ * instructions, or NULL if the current CPU supports no such implementation.
+ */
+static size_t (*__guac_pixel_unpack_rgb_bulk)(uint32_t* dst,
+        const unsigned char* src, size_t count) = NULL;
+
+/**
+ * Flag which ensures the selection of bulk implementations occurs exactly
+ * once.
+ */
+static pthread_once_t __guac_pixel_bulk_selected = PTHREAD_ONCE_INIT;
+
+#ifdef GUAC_PIXEL_X86
+
+/**
+ * Bulk implementation of guac_pixel_fill_alpha() using SSE vector
+ * instructions. Four pixels are processed per iteration.
+ */
+__attribute__((target("ssse3")))
+static size_t __guac_pixel_fill_alpha_ssse3(uint32_t* dst,
+        const uint32_t* src, size_t count) {
+
+    size_t processed = 0;
+
+    const __m128i opaque = _mm_set1_epi32(0xFF000000);
+
+    while (count - processed >= 4) {
+
+        __m128i pixels = _mm_loadu_si128((const __m128i*) (src + processed));
+        _mm_storeu_si128((__m128i*) (dst + processed),
+                _mm_or_si128(pixels, opaque));
+
+        processed += 4;
+
+    }
+
+    return processed;
+
+}
+
+/**
+ * Bulk implementation of guac_pixel_pack_rgb() using SSSE3 vector
+ * instructions. Four pixels are processed per iteration, with each iteration
+ * producing twelve bytes of packed RGB data. As each sixteen-byte store
+ * clobbers four bytes beyond the twelve bytes actually produced, at least two
+ * further pixels must remain to be converted after each iteration (their
+ * destination space covers the clobbered bytes, and they are subsequently
+ * rewritten), so slightly more of the tail is left to the scalar
+ * implementation than vector width alone would require.
+ */
+__attribute__((target("ssse3")))
+static size_t __guac_pixel_pack_rgb_ssse3(unsigned char* dst,
+        const uint32_t* src, size_t count) {
+
+    size_t processed = 0;
+
+    /* Select the red, green, and blue channels of four BGRX pixels, packing
+     * them into the low twelve bytes */
+    const __m128i shuffle = _mm_setr_epi8(
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    while (count - processed >= 6) {
+
+        __m128i pixels = _mm_loadu_si128((const __m128i*) (src + processed));
+        _mm_storeu_si128((__m128i*) dst, _mm_shuffle_epi8(pixels, shuffle));
+
+        processed += 4;
+        dst += 12;
+
+    }
+
+    return processed;
+
+}
+
+/**
+ * Bulk implementation of guac_pixel_unpack_rgb() using SSSE3 vector
+ * instructions. Four pixels are processed per iteration, with each iteration
+ * consuming twelve bytes of packed RGB data. As each sixteen-byte load reads
+ * four bytes beyond the twelve bytes actually consumed, at least two further
+ * pixels must remain to be converted after each iteration (guaranteeing that
+ * the bytes read beyond the current group are within the source buffer), so
+ * slightly more of the tail is left to the scalar implementation than vector
+ * width alone would require.
+ */
+__attribute__((target("ssse3")))
+static size_t __guac_pixel_unpack_rgb_ssse3(uint32_t* dst,
+        const unsigned char* src, size_t count) {
+
+    size_t processed = 0;
+
+    /* Expand four packed RGB pixels into BGRX layout, zeroing the high-order
+     * byte of each pixel (it is subsequently forced to 0xFF) */
+    const __m128i shuffle = _mm_setr_epi8(
+            2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+
+    const __m128i opaque = _mm_set1_epi32(0xFF000000);
+
+    while (count - processed >= 6) {
+
+        __m128i pixels = _mm_loadu_si128((const __m128i*) src);
+        _mm_storeu_si128((__m128i*) (dst + processed),
+                _mm_or_si128(_mm_shuffle_epi8(pixels, shuffle), opaque));
+
+        processed += 4;
+        src += 12;
+
+    }
+
+    return processed;
+
+}
+
+#endif /* GUAC_PIXEL_X86 */
+
+#ifdef GUAC_PIXEL_NEON
+
+/**
+ * Bulk implementation of guac_pixel_fill_alpha() using NEON vector
+ * instructions. Four pixels are processed per iteration.
+ */
+static size_t __guac_pixel_fill_alpha_neon(uint32_t* dst,
+        const uint32_t* src, size_t count) {
+
+    size_t processed = 0;
+
+    const uint32x4_t opaque = vdupq_n_u32(0xFF000000);
+
+    while (count - processed >= 4) {
+        vst1q_u32(dst + processed,
+                vorrq_u32(vld1q_u32(src + processed), opaque));
+        processed += 4;
+    }
+
+    return processed;
+
+}
+
+/**
+ * Bulk implementation of guac_pixel_pack_rgb() using NEON vector
+ * instructions. Sixteen pixels are processed per iteration by deinterleaving
+ * the four channels of the source pixels and storing only the red, green, and
+ * blue channels, reinterleaved in packed RGB order.
+ */
+static size_t __guac_pixel_pack_rgb_neon(unsigned char* dst,
+        const uint32_t* src, size_t count) {
+
+    size_t processed = 0;
+
+    while (count - processed >= 16) {
+
+        const uint8x16x4_t bgrx =
+            vld4q_u8((const uint8_t*) (src + processed));
+
+        const uint8x16x3_t rgb = {{ bgrx.val[2], bgrx.val[1], bgrx.val[0] }};
+        vst3q_u8(dst, rgb);
+
+        processed += 16;
+        dst += 48;
+
+    }
+
+    return processed;
+
+}
+
+/**
+ * Bulk implementation of guac_pixel_unpack_rgb() using NEON vector
+ * instructions. Sixteen pixels are processed per iteration by deinterleaving
+ * the three channels of the packed source pixels and storing them
+ * reinterleaved in BGRX order, with a fully-opaque alpha channel.
+ */
+static size_t __guac_pixel_unpack_rgb_neon(uint32_t* dst,
+        const unsigned char* src, size_t count) {
+
+    size_t processed = 0;
+
+    const uint8x16_t opaque = vdupq_n_u8(0xFF);
+
+    while (count - processed >= 16) {
+
+        const uint8x16x3_t rgb = vld3q_u8(src);
+
+        const uint8x16x4_t bgrx =
+            {{ rgb.val[2], rgb.val[1], rgb.val[0], opaque }};
+        vst4q_u8((uint8_t*) (dst + processed), bgrx);
+
+        processed += 16;
+        src += 48;
+
+    }
+
+    return processed;
+
+}
+
+#endif /* GUAC_PIXEL_NEON */
+
+/**
+ * Selects the bulk conversion implementations to use based on the
+ * capabilities of the current CPU. If the CPU supports none of the available
+ * vector implementations, the bulk implementation pointers remain NULL and
+ * only the scalar implementations will be used.
+ */
+static void __guac_pixel_select_bulk(void) {
+
+#if defined(GUAC_PIXEL_X86)
+    if (__builtin_cpu_supports("ssse3")) {
+        __guac_pixel_fill_alpha_bulk = __guac_pixel_fill_alpha_ssse3;
+        __guac_pixel_pack_rgb_bulk = __guac_pixel_pack_rgb_ssse3;
+        __guac_pixel_unpack_rgb_bulk = __guac_pixel_unpack_rgb_ssse3;
+    }
+#elif defined(GUAC_PIXEL_NEON)
+    __guac_pixel_fill_alpha_bulk = __guac_pixel_fill_alpha_neon;
+    __guac_pixel_pack_rgb_bulk = __guac_pixel_pack_rgb_neon;
+    __guac_pixel_unpack_rgb_bulk = __guac_pixel_unpack_rgb_neon;
+#endif
+
+}
+
+void guac_pixel_fill_alpha(uint32_t* dst, const uint32_t* src, size_t count) {
+
+    size_t processed = 0;
+
+    /* Convert the bulk of the run with vector instructions, if the CPU
+     * supports doing so */
+    pthread_once(&__guac_pixel_bulk_selected, __guac_pixel_select_bulk);
+    if (__guac_pixel_fill_alpha_bulk != NULL)
+        processed = __guac_pixel_fill_alpha_bulk(dst, src, count);
+
+    for (; processed < count; processed++)
+        dst[processed] = src[processed] | 0xFF000000;
+
+}
+
+void guac_pixel_pack_rgb(unsigned char* dst, const uint32_t* src,
+        size_t count) {
+
+    size_t processed = 0;
+
+    pthread_once(&__guac_pixel_bulk_selected, __guac_pixel_select_bulk);
+    if (__guac_pixel_pack_rgb_bulk != NULL) {
+        processed = __guac_pixel_pack_rgb_bulk(dst, src, count);
+        dst += processed * 3;
+    }
+
+    for (; processed < count; processed++) {
+        uint32_t pixel = src[processed];
+        *(dst++) = (pixel >> 16) & 0xFF;
+        *(dst++) = (pixel >>  8) & 0xFF;
+        *(dst++) = (pixel      ) & 0xFF;
+    }
+
+}
+
+void guac_pixel_unpack_rgb(uint32_t* dst, const unsigned char* src,
+        size_t count) {
+
+    size_t processed = 0;
+
+    pthread_once(&__guac_pixel_bulk_selected, __guac_pixel_select_bulk);
+    if (__guac_pixel_unpack_rgb_bulk != NULL) {
+        processed = __guac_pixel_unpack_rgb_bulk(dst, src, count);
+        src += processed * 3;
+    }
+
+    for (; processed < count; processed++) {
+        uint32_t r = *(src++);
+        uint32_t g = *(src++);
+        uint32_t b = *(src++);
+        dst[processed] = 0xFF000000 | (r << 16) | (g << 8) | b;
+    }
+
+}
+
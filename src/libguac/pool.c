@@ -24,8 +24,36 @@
 #include "guacamole/pool.h"
 
 #include <limits.h>
+#include <sched.h>
+#include <stdint.h>
 #include <stdlib.h>
 
+/**
+ * The minimum number of integers covered by the lock-free free list of each
+ * guac_pool. Pools with a larger minimum size cover at least their minimum
+ * size instead. Integers beyond this range are rare in practice and fall back
+ * to a mutex-guarded overflow list.
+ */
+#define GUAC_POOL_FAST_SIZE 1024
+
+/**
+ * Extracts the tag from the given packed free list head.
+ */
+#define GUAC_POOL_HEAD_TAG(head) ((uint32_t) ((head) >> 32))
+
+/**
+ * Extracts the first free integer from the given packed free list head, or -1
+ * if the free list is empty.
+ */
+#define GUAC_POOL_HEAD_VALUE(head) (((int) (uint32_t) (head)) - 1)
+
+/**
+ * Packs the given tag and first free integer into a free list head, where a
+ * value of -1 denotes an empty list.
+ */
+#define GUAC_POOL_HEAD(tag, value) \
+    ((((uint64_t) (uint32_t) (tag)) << 32) | (uint32_t) ((value) + 1))
+
 guac_pool* guac_pool_alloc(int size) {
 
     pthread_mutexattr_t lock_attributes;
@@ -42,6 +70,13 @@ guac_pool* guac_pool_alloc(int size) {
     pool->__head = NULL;
     pool->__tail = NULL;
 
+    /* Initialize empty lock-free free list, covering at least the minimum
+     * size of the pool */
+    pool->__fast_capacity = size > GUAC_POOL_FAST_SIZE ? size : GUAC_POOL_FAST_SIZE;
+    pool->__free_next = guac_mem_alloc(guac_mem_ckd_mul_or_die(
+                pool->__fast_capacity, sizeof(int)));
+    pool->__free_head = GUAC_POOL_HEAD(0, -1);
+
     /* Init lock */
     pthread_mutexattr_init(&lock_attributes);
     pthread_mutexattr_setpshared(&lock_attributes, PTHREAD_PROCESS_SHARED);
@@ -53,7 +88,7 @@ guac_pool* guac_pool_alloc(int size) {
 
 void guac_pool_free(guac_pool* pool) {
 
-    /* Free all ints in pool */
+    /* Free all ints in overflow list */
     guac_pool_int* current = pool->__head;
     while (current != NULL) {
 
@@ -63,6 +98,9 @@ void guac_pool_free(guac_pool* pool) {
         guac_mem_free(old);
     }
 
+    /* Free lock-free free list */
+    guac_mem_free(pool->__free_next);
+
     /* Destroy lock */
     pthread_mutex_destroy(&(pool->__lock));
 
@@ -72,43 +110,100 @@ void guac_pool_free(guac_pool* pool) {
 }
 
 /**
- * Returns the next available integer from the given guac_pool. All integers
- * returned are non-negative, and are returned in sequence, starting from 0.
- *
- * Unlike the public guac_pool_next_int() function, this function is NOT atomic
- * and depends on the caller having already acquired the pool's lock.
+ * Atomically removes and returns the first integer in the lock-free free list
+ * of the given guac_pool, returning -1 instead if the list is empty. The tag
+ * packed alongside the list head guarantees that a concurrent removal and
+ * reinsertion of the same integer cannot be mistaken for an unchanged list.
  *
  * @param pool
- *     The guac_pool to retrieve an integer from.
+ *     The guac_pool to remove an integer from.
  *
  * @return
- *     The next available integer, which may be either an integer not yet
- *     returned by a call to guac_pool_next_int, or an integer which was
- *     previously returned but has since been freed.
+ *     The integer removed from the free list, or -1 if the free list is
+ *     empty.
  */
-static int __guac_pool_next_int(guac_pool* pool) {
+static int __guac_pool_fast_pop(guac_pool* pool) {
 
-    int value;
+    uint64_t head = __atomic_load_n(&pool->__free_head, __ATOMIC_ACQUIRE);
+    for (;;) {
 
-    /* It's unlikely that any usage of guac_pool will ever manage to reach
-     * INT_MAX concurrent requests for integers, but we definitely should bail
-     * out if ever this does happen. Tracing this sort of issue down would be
-     * extremely difficult without fail-fast behavior. */
-    GUAC_ASSERT(pool->__next_value < INT_MAX);
-    GUAC_ASSERT(pool->active < INT_MAX);
+        /* Bail out if no previously-freed integers are available */
+        int value = GUAC_POOL_HEAD_VALUE(head);
+        if (value < 0)
+            return -1;
 
-    pool->active++;
+        /* Attempt to advance the list head past the first integer, retrying
+         * against the updated head if another thread got there first */
+        int next = __atomic_load_n(&pool->__free_next[value], __ATOMIC_RELAXED) - 1;
+        uint64_t new_head = GUAC_POOL_HEAD(GUAC_POOL_HEAD_TAG(head) + 1, next);
+        if (__atomic_compare_exchange_n(&pool->__free_head, &head, new_head,
+                    0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            return value;
 
-    /* If more integers are needed, return a new one. */
-    if (pool->__head == NULL || pool->__next_value < pool->min_size)
-        value = pool->__next_value++;
+    }
 
-    /* Otherwise, reuse a previously freed integer */
-    else {
+}
+
+/**
+ * Atomically prepends the given integer to the lock-free free list of the
+ * given guac_pool. The given integer MUST be less than the fast capacity of
+ * the pool and MUST NOT already be in the free list.
+ *
+ * @param pool
+ *     The guac_pool to return the given integer to.
+ *
+ * @param value
+ *     The integer to return to the free list.
+ */
+static void __guac_pool_fast_push(guac_pool* pool, int value) {
+
+    uint64_t head = __atomic_load_n(&pool->__free_head, __ATOMIC_RELAXED);
+    for (;;) {
+
+        /* Link the rest of the list behind the integer being freed, retrying
+         * against the updated head if another thread updated the list */
+        __atomic_store_n(&pool->__free_next[value],
+                GUAC_POOL_HEAD_VALUE(head) + 1, __ATOMIC_RELAXED);
+
+        uint64_t new_head = GUAC_POOL_HEAD(GUAC_POOL_HEAD_TAG(head) + 1, value);
+        if (__atomic_compare_exchange_n(&pool->__free_head, &head, new_head,
+                    0, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            return;
+
+    }
+
+}
+
+/**
+ * Removes and returns the first integer in the locked overflow list of the
+ * given guac_pool, returning -1 instead if the list is empty. Only integers
+ * too large for the lock-free free list are ever stored in the overflow list,
+ * so this function will not acquire the pool's lock at all unless such
+ * integers have actually been freed.
+ *
+ * @param pool
+ *     The guac_pool to remove an integer from.
+ *
+ * @return
+ *     The integer removed from the overflow list, or -1 if the overflow list
+ *     is empty.
+ */
+static int __guac_pool_overflow_pop(guac_pool* pool) {
+
+    int value = -1;
+
+    /* Avoid touching the lock entirely in the common case that no integers
+     * beyond the fast capacity have ever been freed */
+    if (__atomic_load_n(&pool->__head, __ATOMIC_ACQUIRE) == NULL)
+        return -1;
+
+    pthread_mutex_lock(&(pool->__lock));
+
+    if (pool->__head != NULL) {
 
         value = pool->__head->value;
 
-        /* If only one element exists, reset pool to empty. */
+        /* If only one element exists, reset list to empty. */
         if (pool->__tail == pool->__head) {
             guac_mem_free(pool->__head);
             pool->__head = NULL;
@@ -124,47 +219,149 @@ static int __guac_pool_next_int(guac_pool* pool) {
 
     }
 
-    /* Again, this should never happen and would be a sign of some fairly
-     * fundamental assumption failing. It's important for such things to fail
-     * fast. */
-    GUAC_ASSERT(value >= 0);
+    pthread_mutex_unlock(&(pool->__lock));
 
     return value;
 
 }
 
-int guac_pool_next_int(guac_pool* pool) {
+/**
+ * Atomically claims and returns an integer which has not yet been returned by
+ * the given guac_pool, or -1 if no such integer below the given limit
+ * remains.
+ *
+ * @param pool
+ *     The guac_pool to claim a new integer from.
+ *
+ * @param limit
+ *     The exclusive upper bound to enforce on the claimed integer, or INT_MAX
+ *     if the caller does not impose a limit of its own.
+ *
+ * @return
+ *     An integer which has never been returned by the given guac_pool, or -1
+ *     if all such integers would be at or above the given limit.
+ */
+static int __guac_pool_next_fresh(guac_pool* pool, int limit) {
 
-    pthread_mutex_lock(&(pool->__lock));
-    int value = __guac_pool_next_int(pool);
-    pthread_mutex_unlock(&(pool->__lock));
+    int next = __atomic_load_n(&pool->__next_value, __ATOMIC_RELAXED);
+    while (next < limit) {
+        if (__atomic_compare_exchange_n(&pool->__next_value, &next, next + 1,
+                    0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            return next;
+    }
 
-    return value;
+    /* It's unlikely that any usage of guac_pool will ever manage to reach
+     * INT_MAX concurrent requests for integers, but we definitely should bail
+     * out if ever this does happen. Tracing this sort of issue down would be
+     * extremely difficult without fail-fast behavior. */
+    GUAC_ASSERT(limit != INT_MAX);
 
-}
+    return -1;
 
-int guac_pool_next_int_below(guac_pool* pool, int limit) {
+}
 
-    pthread_mutex_lock(&(pool->__lock));
+/**
+ * Returns the next available integer from the given guac_pool that is below
+ * the given limit, or -1 if all integers below that limit are already in use.
+ * All integers returned are non-negative, and are returned in sequence,
+ * starting from 0.
+ *
+ * Unlike earlier revisions of guac_pool, retrieval does not serialize on the
+ * pool's lock: in-use accounting and the free list are maintained with atomic
+ * operations, and the lock is involved only for the rarely-used overflow
+ * list.
+ *
+ * @param pool
+ *     The guac_pool to retrieve an integer from.
+ *
+ * @param limit
+ *     The exclusive upper bound to enforce on all integers returned, or
+ *     INT_MAX if the caller does not impose a limit of its own.
+ *
+ * @return
+ *     The next available integer, which may be either an integer not yet
+ *     returned by a call to guac_pool_next_int, or an integer which was
+ *     previously returned but has since been freed. If no integer can be
+ *     returned without reaching the given limit, -1 is returned.
+ */
+static int __guac_pool_next_int(guac_pool* pool, int limit) {
 
     int value;
 
-    /* Explicitly bail out now if there we would need to return a new integer,
-     * but can't without reaching the given limit */
-    if (pool->active >= limit || (pool->__next_value >= limit && pool->__head == NULL)) {
-        value = -1;
+    /* Reserve a slot within the limit before claiming any particular integer.
+     * Because the in-use count is only decremented after a freed integer has
+     * actually been returned to a free list, a successful reservation
+     * guarantees that some integer below the limit is (or is about to become)
+     * available. */
+    int active = __atomic_fetch_add(&pool->active, 1, __ATOMIC_RELAXED);
+
+    /* It's unlikely that any usage of guac_pool will ever manage to reach
+     * INT_MAX concurrent requests for integers, but we definitely should bail
+     * out if ever this does happen. Tracing this sort of issue down would be
+     * extremely difficult without fail-fast behavior. */
+    GUAC_ASSERT(active < INT_MAX);
+
+    if (active >= limit) {
+        __atomic_fetch_sub(&pool->active, 1, __ATOMIC_RELAXED);
+        return -1;
     }
 
-    /* In all other cases, attempt to obtain the requested integer (either
-     * reusing a freed integer or allocating a new one), but verify that some
-     * fundamental misuse of guac_pool hasn't resulted in values defying
-     * expectations */
-    else {
-        value = __guac_pool_next_int(pool);
-        GUAC_ASSERT(value < limit);
+    /* Prefer integers which have not yet been returned until the pool has
+     * grown to its minimum size */
+    if (__atomic_load_n(&pool->__next_value, __ATOMIC_RELAXED) < pool->min_size) {
+        value = __guac_pool_next_fresh(pool, limit);
+        if (value >= 0)
+            return value;
     }
 
-    pthread_mutex_unlock(&(pool->__lock));
+    for (;;) {
+
+        /* Reuse a previously freed integer, if any */
+        value = __guac_pool_fast_pop(pool);
+        if (value >= 0)
+            return value;
+
+        value = __guac_pool_overflow_pop(pool);
+        if (value >= 0)
+            return value;
+
+        /* Otherwise, claim an integer which has not yet been returned */
+        value = __guac_pool_next_fresh(pool, limit);
+        if (value >= 0)
+            return value;
+
+        /* All integers are accounted for, but the reservation above
+         * guarantees that a concurrent call to guac_pool_free_int() is just
+         * about to finish returning an integer to a free list. Yield and
+         * retry until it lands. */
+        sched_yield();
+
+    }
+
+}
+
+int guac_pool_next_int(guac_pool* pool) {
+
+    int value = __guac_pool_next_int(pool, INT_MAX);
+
+    /* Again, this should never happen and would be a sign of some fairly
+     * fundamental assumption failing. It's important for such things to fail
+     * fast. */
+    GUAC_ASSERT(value >= 0);
+
+    return value;
+
+}
+
+int guac_pool_next_int_below(guac_pool* pool, int limit) {
+
+    int value = __guac_pool_next_int(pool, limit);
+
+    /* Verify that some fundamental misuse of guac_pool (such as freeing an
+     * integer into a pool that it was not retrieved from) hasn't resulted in
+     * values defying expectations */
+    if (value >= 0)
+        GUAC_ASSERT(value < limit);
 
     return value;
 
@@ -184,29 +381,36 @@ int guac_pool_next_int_below_or_die(guac_pool* pool, int limit) {
 
 void guac_pool_free_int(guac_pool* pool, int value) {
 
-    /* Allocate and initialize new returned value */
-    guac_pool_int* pool_int = guac_mem_alloc(sizeof(guac_pool_int));
-    pool_int->value = value;
-    pool_int->__next = NULL;
+    /* Return the integer to the lock-free free list if it is small enough */
+    if (value < pool->__fast_capacity)
+        __guac_pool_fast_push(pool, value);
 
-    /* Acquire exclusive access */
-    pthread_mutex_lock(&(pool->__lock));
+    /* Append integers beyond the fast capacity to the overflow list */
+    else {
 
-    GUAC_ASSERT(pool->active > 0);
-    pool->active--;
+        guac_pool_int* pool_int = guac_mem_alloc(sizeof(guac_pool_int));
+        pool_int->value = value;
+        pool_int->__next = NULL;
 
-    /* If pool empty, store as sole entry. */
-    if (pool->__tail == NULL)
-        pool->__head = pool->__tail = pool_int;
+        pthread_mutex_lock(&(pool->__lock));
+
+        /* If list empty, store as sole entry. */
+        if (pool->__tail == NULL)
+            pool->__head = pool->__tail = pool_int;
+
+        /* Otherwise, append to end of list. */
+        else {
+            pool->__tail->__next = pool_int;
+            pool->__tail = pool_int;
+        }
+
+        pthread_mutex_unlock(&(pool->__lock));
 
-    /* Otherwise, append to end of pool. */
-    else {
-        pool->__tail->__next = pool_int;
-        pool->__tail = pool_int;
     }
 
-    /* Value has been freed */
-    pthread_mutex_unlock(&(pool->__lock));
+    /* Mark the integer as no longer in use only once it is actually available
+     * for reuse (see the reservation within __guac_pool_next_int()) */
+    int active = __atomic_fetch_sub(&pool->active, 1, __ATOMIC_RELEASE);
+    GUAC_ASSERT(active > 0);
 
 }
-
@@ -26,12 +26,14 @@
 #include "guacamole/protocol-types.h"
 #include "guacamole/socket.h"
 #include "guacamole/stream.h"
+#include "guacamole/string.h"
 #include "guacamole/unicode.h"
 #include "palette.h"
 
 #include <cairo/cairo.h>
 
 #include <inttypes.h>
+#include <pthread.h>
 #include <setjmp.h>
 #include <stdarg.h>
 #include <stdint.h>
@@ -71,6 +73,92 @@ guac_protocol_version_mapping guac_protocol_version_table[] = {
 
 /* Output formatting functions */
 
+/**
+ * The number of small, non-negative integer values for which the full
+ * length-prefixed Guacamole protocol element encoding ("1.5", "2.42", etc.)
+ * is precomputed. Layer indices, stream indices, and most coordinates fall
+ * within this range, allowing the elements of steady-state frame traffic to
+ * be serialized with a single memcpy() rather than repeated integer
+ * formatting.
+ */
+#define GUAC_PROTOCOL_CACHED_INT_VALUES 1024
+
+/**
+ * The precomputed, length-prefixed Guacamole protocol element encoding of a
+ * small integer value.
+ */
+typedef struct guac_protocol_cached_int {
+
+    /**
+     * The full element encoding, including length prefix and "." separator.
+     * This buffer is NOT null-terminated.
+     */
+    char text[8];
+
+    /**
+     * The number of bytes in the element encoding.
+     */
+    unsigned char length;
+
+} guac_protocol_cached_int;
+
+/**
+ * The precomputed element encodings of all integer values between 0 and
+ * GUAC_PROTOCOL_CACHED_INT_VALUES (exclusive). This table is built once by
+ * guac_protocol_build_cached_ints() and is read-only thereafter.
+ */
+static guac_protocol_cached_int guac_protocol_cached_ints[GUAC_PROTOCOL_CACHED_INT_VALUES];
+
+static pthread_once_t guac_protocol_cached_ints_init = PTHREAD_ONCE_INIT;
+
+/**
+ * Builds the table of precomputed element encodings for small integer
+ * values. This function is invoked exactly once via pthread_once().
+ */
+static void guac_protocol_build_cached_ints() {
+
+    for (int i = 0; i < GUAC_PROTOCOL_CACHED_INT_VALUES; i++) {
+
+        guac_protocol_cached_int* entry = &guac_protocol_cached_ints[i];
+
+        /* The length of the decimal representation is both the byte length
+         * and the character length of the element (all characters are
+         * digits) */
+        char digits[GUAC_ITOA64_BUFFER_SIZE];
+        int length = guac_itoa64(digits, i);
+
+        /* Assemble full "LENGTH.DIGITS" element encoding */
+        entry->length = (unsigned char) guac_itoa64(entry->text, length);
+        entry->text[entry->length++] = '.';
+        memcpy(entry->text + entry->length, digits, length);
+        entry->length += length;
+
+    }
+
+}
+
+/**
+ * Returns the precomputed element encoding of the given integer value, or
+ * NULL if the value is outside the precomputed range. The table of
+ * precomputed encodings is built on first use.
+ *
+ * @param i
+ *     The integer value whose element encoding should be returned.
+ *
+ * @return
+ *     The precomputed element encoding of the given value, or NULL if the
+ *     value is outside the precomputed range.
+ */
+static const guac_protocol_cached_int* guac_protocol_get_cached_int(int64_t i) {
+
+    if (i < 0 || i >= GUAC_PROTOCOL_CACHED_INT_VALUES)
+        return NULL;
+
+    pthread_once(&guac_protocol_cached_ints_init, guac_protocol_build_cached_ints);
+    return &guac_protocol_cached_ints[i];
+
+}
+
 ssize_t __guac_socket_write_length_string(guac_socket* socket, const char* str) {
 
     return
@@ -82,9 +170,21 @@ ssize_t __guac_socket_write_length_string(guac_socket* socket, const char* str)
 
 ssize_t __guac_socket_write_length_int(guac_socket* socket, int64_t i) {
 
-    char buffer[128];
-    snprintf(buffer, sizeof(buffer), "%"PRIi64, i);
-    return __guac_socket_write_length_string(socket, buffer);
+    /* Serialize small values (layer/stream indices, most coordinates) from
+     * the table of precomputed element encodings */
+    const guac_protocol_cached_int* cached = guac_protocol_get_cached_int(i);
+    if (cached != NULL)
+        return guac_socket_write(socket, cached->text, cached->length);
+
+    /* The length of the decimal representation is returned by guac_itoa64(),
+     * and (being all digits) is both the byte length and the character
+     * length of the element, so no later strlen() pass is needed */
+    char buffer[GUAC_ITOA64_BUFFER_SIZE];
+    int length = guac_itoa64(buffer, i);
+
+    return guac_socket_write_int(socket, length)
+        || guac_socket_write_string(socket, ".")
+        || guac_socket_write(socket, buffer, length);
 
 }
 
@@ -96,6 +196,224 @@ ssize_t __guac_socket_write_length_double(guac_socket* socket, double d) {
 
 }
 
+/**
+ * The size of the scratch buffer used to serialize each Guacamole instruction
+ * before it is written to the socket. Any instruction that fits within this
+ * buffer is handed to the socket as a single write.
+ */
+#define GUAC_PROTOCOL_SCRATCH_SIZE 1024
+
+/**
+ * A scratch buffer into which a complete Guacamole instruction is serialized
+ * before being written to a socket. Serializing the instruction into a single
+ * buffer allows the instruction to be handed to the socket with one write,
+ * rather than acquiring the socket's underlying locks once for each element
+ * of the instruction.
+ */
+typedef struct guac_protocol_scratch {
+
+    /**
+     * The socket to which the serialized instruction will be written.
+     */
+    guac_socket* socket;
+
+    /**
+     * The number of bytes currently stored in the scratch buffer.
+     */
+    int length;
+
+    /**
+     * The buffer into which the instruction is serialized.
+     */
+    char buffer[GUAC_PROTOCOL_SCRATCH_SIZE];
+
+} guac_protocol_scratch;
+
+/**
+ * Writes all data currently stored in the given scratch buffer to the
+ * underlying socket, emptying the scratch buffer. Returns zero on success,
+ * non-zero on error.
+ *
+ * @param scratch
+ *     The scratch buffer to flush.
+ *
+ * @return
+ *     Zero on success, non-zero on error.
+ */
+static ssize_t guac_protocol_scratch_flush(guac_protocol_scratch* scratch) {
+
+    if (scratch->length == 0)
+        return 0;
+
+    int length = scratch->length;
+    scratch->length = 0;
+
+    return guac_socket_write(scratch->socket, scratch->buffer, length);
+
+}
+
+/**
+ * Appends the given data to the given scratch buffer, flushing the scratch
+ * buffer to the underlying socket as necessary to make room. Data too large
+ * to ever fit within the scratch buffer is written through to the socket
+ * directly. Returns zero on success, non-zero on error.
+ *
+ * @param scratch
+ *     The scratch buffer to append the given data to.
+ *
+ * @param buffer
+ *     The data to append.
+ *
+ * @param length
+ *     The number of bytes to append.
+ *
+ * @return
+ *     Zero on success, non-zero on error.
+ */
+static ssize_t guac_protocol_scratch_write(guac_protocol_scratch* scratch,
+        const char* buffer, int length) {
+
+    /* Write data that cannot possibly fit in the scratch buffer straight
+     * through to the socket */
+    if (length > GUAC_PROTOCOL_SCRATCH_SIZE)
+        return guac_protocol_scratch_flush(scratch)
+            || guac_socket_write(scratch->socket, buffer, length);
+
+    /* Flush scratch buffer if insufficient space remains */
+    if (scratch->length + length > GUAC_PROTOCOL_SCRATCH_SIZE
+            && guac_protocol_scratch_flush(scratch))
+        return -1;
+
+    memcpy(scratch->buffer + scratch->length, buffer, length);
+    scratch->length += length;
+    return 0;
+
+}
+
+/**
+ * Appends the given null-terminated string to the given scratch buffer. The
+ * string is appended as-is, without any length prefix. Returns zero on
+ * success, non-zero on error.
+ *
+ * @param scratch
+ *     The scratch buffer to append the given string to.
+ *
+ * @param str
+ *     The string to append.
+ *
+ * @return
+ *     Zero on success, non-zero on error.
+ */
+static ssize_t guac_protocol_scratch_write_string(
+        guac_protocol_scratch* scratch, const char* str) {
+
+    return guac_protocol_scratch_write(scratch, str, strlen(str));
+
+}
+
+/**
+ * Appends the decimal representation of the given integer to the given
+ * scratch buffer, without any length prefix. Returns zero on success,
+ * non-zero on error.
+ *
+ * @param scratch
+ *     The scratch buffer to append the given integer to.
+ *
+ * @param i
+ *     The integer to append.
+ *
+ * @return
+ *     Zero on success, non-zero on error.
+ */
+static ssize_t guac_protocol_scratch_write_int(guac_protocol_scratch* scratch,
+        int64_t i) {
+
+    char buffer[GUAC_ITOA64_BUFFER_SIZE];
+    int length = guac_itoa64(buffer, i);
+    return guac_protocol_scratch_write(scratch, buffer, length);
+
+}
+
+/**
+ * Appends the given string to the given scratch buffer as a Guacamole
+ * protocol element, prefixed with its length in characters. Returns zero on
+ * success, non-zero on error.
+ *
+ * @param scratch
+ *     The scratch buffer to append the given element to.
+ *
+ * @param str
+ *     The string value of the element to append.
+ *
+ * @return
+ *     Zero on success, non-zero on error.
+ */
+static ssize_t guac_protocol_scratch_write_length_string(
+        guac_protocol_scratch* scratch, const char* str) {
+
+    return guac_protocol_scratch_write_int(scratch, guac_utf8_strlen(str))
+        || guac_protocol_scratch_write(scratch, ".", 1)
+        || guac_protocol_scratch_write_string(scratch, str);
+
+}
+
+/**
+ * Appends the given integer to the given scratch buffer as a Guacamole
+ * protocol element, prefixed with its length in characters. Returns zero on
+ * success, non-zero on error.
+ *
+ * @param scratch
+ *     The scratch buffer to append the given element to.
+ *
+ * @param i
+ *     The integer value of the element to append.
+ *
+ * @return
+ *     Zero on success, non-zero on error.
+ */
+static ssize_t guac_protocol_scratch_write_length_int(
+        guac_protocol_scratch* scratch, int64_t i) {
+
+    /* Serialize small values (layer/stream indices, most coordinates) from
+     * the table of precomputed element encodings */
+    const guac_protocol_cached_int* cached = guac_protocol_get_cached_int(i);
+    if (cached != NULL)
+        return guac_protocol_scratch_write(scratch, cached->text, cached->length);
+
+    /* The length returned by guac_itoa64() is both the byte length and the
+     * character length of the element, so no later strlen() pass is needed */
+    char buffer[GUAC_ITOA64_BUFFER_SIZE];
+    int length = guac_itoa64(buffer, i);
+
+    return guac_protocol_scratch_write_int(scratch, length)
+        || guac_protocol_scratch_write(scratch, ".", 1)
+        || guac_protocol_scratch_write(scratch, buffer, length);
+
+}
+
+/**
+ * Appends the given double to the given scratch buffer as a Guacamole
+ * protocol element, prefixed with its length in characters. Returns zero on
+ * success, non-zero on error.
+ *
+ * @param scratch
+ *     The scratch buffer to append the given element to.
+ *
+ * @param d
+ *     The double value of the element to append.
+ *
+ * @return
+ *     Zero on success, non-zero on error.
+ */
+static ssize_t guac_protocol_scratch_write_length_double(
+        guac_protocol_scratch* scratch, double d) {
+
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer), "%.16g", d);
+    return guac_protocol_scratch_write_length_string(scratch, buffer);
+
+}
+
 /**
  * Loop through the provided NULL-terminated array, writing the values in the
  * array to the given socket. Values are written as a series of Guacamole
@@ -134,16 +452,18 @@ int guac_protocol_send_ack(guac_socket* socket, guac_stream* stream,
         const char* error, guac_protocol_status status) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "3.ack,")
-        || __guac_socket_write_length_int(socket, stream->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_string(socket, error)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, status)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "3.ack,")
+        || guac_protocol_scratch_write_length_int(&scratch, stream->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_string(&scratch, error)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, status)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -182,16 +502,18 @@ int guac_protocol_send_argv(guac_socket* socket, guac_stream* stream,
         const char* mimetype, const char* name) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "4.argv,")
-        || __guac_socket_write_length_int(socket, stream->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_string(socket, mimetype)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_string(socket, name)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "4.argv,")
+        || guac_protocol_scratch_write_length_int(&scratch, stream->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_string(&scratch, mimetype)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_string(&scratch, name)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -203,24 +525,26 @@ int guac_protocol_send_arc(guac_socket* socket, const guac_layer* layer,
         int negative) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "3.arc,")
-        || __guac_socket_write_length_int(socket, layer->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, x)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, y)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, radius)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_double(socket, startAngle)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_double(socket, endAngle)
-        || guac_socket_write_string(socket, ",")
-        || guac_socket_write_string(socket, negative ? "1.1" : "1.0")
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "3.arc,")
+        || guac_protocol_scratch_write_length_int(&scratch, layer->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, x)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, y)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, radius)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_double(&scratch, startAngle)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_double(&scratch, endAngle)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_string(&scratch, negative ? "1.1" : "1.0")
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
     guac_socket_instruction_end(socket);
 
     return ret_val;
@@ -231,14 +555,16 @@ int guac_protocol_send_audio(guac_socket* socket, const guac_stream* stream,
         const char* mimetype) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val = 
-           guac_socket_write_string(socket, "5.audio,")
-        || __guac_socket_write_length_int(socket, stream->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_string(socket, mimetype)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "5.audio,")
+        || guac_protocol_scratch_write_length_int(&scratch, stream->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_string(&scratch, mimetype)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
     guac_socket_instruction_end(socket);
 
     return ret_val;
@@ -251,14 +577,16 @@ int guac_protocol_send_blob(guac_socket* socket, const guac_stream* stream,
     int base64_length = (count + 2) / 3 * 4;
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "4.blob,")
-        || __guac_socket_write_length_int(socket, stream->index)
-        || guac_socket_write_string(socket, ",")
-        || guac_socket_write_int(socket, base64_length)
-        || guac_socket_write_string(socket, ".")
+           guac_protocol_scratch_write_string(&scratch, "4.blob,")
+        || guac_protocol_scratch_write_length_int(&scratch, stream->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_int(&scratch, base64_length)
+        || guac_protocol_scratch_write_string(&scratch, ".")
+        || guac_protocol_scratch_flush(&scratch)
         || guac_socket_write_base64(socket, data, count)
         || guac_socket_flush_base64(socket)
         || guac_socket_write_string(socket, ";");
@@ -299,17 +627,53 @@ int guac_protocol_send_body(guac_socket* socket, const guac_object* object,
         const guac_stream* stream, const char* mimetype, const char* name) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
+
+    guac_socket_instruction_begin(socket);
+    ret_val =
+           guac_protocol_scratch_write_string(&scratch, "4.body,")
+        || guac_protocol_scratch_write_length_int(&scratch, object->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, stream->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_string(&scratch, mimetype)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_string(&scratch, name)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
+
+    guac_socket_instruction_end(socket);
+    return ret_val;
+
+}
+
+int guac_protocol_send_cells(guac_socket* socket, const guac_layer* layer,
+        int x, int y, int cell_width, int cell_height,
+        const void* data, int count) {
+
+    int base64_length = (count + 2) / 3 * 4;
+
+    int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "4.body,")
-        || __guac_socket_write_length_int(socket, object->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, stream->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_string(socket, mimetype)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_string(socket, name)
+           guac_protocol_scratch_write_string(&scratch, "5.cells,")
+        || guac_protocol_scratch_write_length_int(&scratch, layer->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, x)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, y)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, cell_width)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, cell_height)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_int(&scratch, base64_length)
+        || guac_protocol_scratch_write_string(&scratch, ".")
+        || guac_protocol_scratch_flush(&scratch)
+        || guac_socket_write_base64(socket, data, count)
+        || guac_socket_flush_base64(socket)
         || guac_socket_write_string(socket, ";");
 
     guac_socket_instruction_end(socket);
@@ -322,22 +686,24 @@ int guac_protocol_send_cfill(guac_socket* socket,
         int r, int g, int b, int a) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "5.cfill,")
-        || __guac_socket_write_length_int(socket, mode)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, layer->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, r)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, g)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, b)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, a)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "5.cfill,")
+        || guac_protocol_scratch_write_length_int(&scratch, mode)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, layer->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, r)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, g)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, b)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, a)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -347,12 +713,14 @@ int guac_protocol_send_cfill(guac_socket* socket,
 int guac_protocol_send_close(guac_socket* socket, const guac_layer* layer) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "5.close,")
-        || __guac_socket_write_length_int(socket, layer->index)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "5.close,")
+        || guac_protocol_scratch_write_length_int(&scratch, layer->index)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -386,12 +754,14 @@ int guac_protocol_send_connect(guac_socket* socket, const char** args) {
 int guac_protocol_send_clip(guac_socket* socket, const guac_layer* layer) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "4.clip,")
-        || __guac_socket_write_length_int(socket, layer->index)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "4.clip,")
+        || guac_protocol_scratch_write_length_int(&scratch, layer->index)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -402,14 +772,16 @@ int guac_protocol_send_clipboard(guac_socket* socket, const guac_stream* stream,
         const char* mimetype) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "9.clipboard,")
-        || __guac_socket_write_length_int(socket, stream->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_string(socket, mimetype)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "9.clipboard,")
+        || guac_protocol_scratch_write_length_int(&scratch, stream->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_string(&scratch, mimetype)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -421,28 +793,30 @@ int guac_protocol_send_copy(guac_socket* socket,
         guac_composite_mode mode, const guac_layer* dstl, int dstx, int dsty) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "4.copy,")
-        || __guac_socket_write_length_int(socket, srcl->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, srcx)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, srcy)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, w)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, h)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, mode)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, dstl->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, dstx)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, dsty)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "4.copy,")
+        || guac_protocol_scratch_write_length_int(&scratch, srcl->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, srcx)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, srcy)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, w)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, h)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, mode)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, dstl->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, dstx)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, dsty)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -455,28 +829,30 @@ int guac_protocol_send_cstroke(guac_socket* socket,
         int r, int g, int b, int a) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "7.cstroke,")
-        || __guac_socket_write_length_int(socket, mode)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, layer->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, cap)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, join)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, thickness)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, r)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, g)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, b)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, a)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "7.cstroke,")
+        || guac_protocol_scratch_write_length_int(&scratch, mode)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, layer->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, cap)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, join)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, thickness)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, r)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, g)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, b)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, a)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -486,24 +862,26 @@ int guac_protocol_send_cstroke(guac_socket* socket,
 int guac_protocol_send_cursor(guac_socket* socket, int x, int y,
         const guac_layer* srcl, int srcx, int srcy, int w, int h) {
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "6.cursor,")
-        || __guac_socket_write_length_int(socket, x)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, y)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, srcl->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, srcx)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, srcy)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, w)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, h)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "6.cursor,")
+        || guac_protocol_scratch_write_length_int(&scratch, x)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, y)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, srcl->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, srcx)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, srcy)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, w)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, h)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -514,24 +892,26 @@ int guac_protocol_send_curve(guac_socket* socket, const guac_layer* layer,
         int cp1x, int cp1y, int cp2x, int cp2y, int x, int y) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "5.curve,")
-        || __guac_socket_write_length_int(socket, layer->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, cp1x)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, cp1y)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, cp2x)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, cp2y)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, x)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, y)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "5.curve,")
+        || guac_protocol_scratch_write_length_int(&scratch, layer->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, cp1x)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, cp1y)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, cp2x)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, cp2y)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, x)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, y)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -551,12 +931,14 @@ int guac_protocol_send_disconnect(guac_socket* socket) {
 int guac_protocol_send_dispose(guac_socket* socket, const guac_layer* layer) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "7.dispose,")
-        || __guac_socket_write_length_int(socket, layer->index)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "7.dispose,")
+        || guac_protocol_scratch_write_length_int(&scratch, layer->index)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -568,24 +950,26 @@ int guac_protocol_send_distort(guac_socket* socket, const guac_layer* layer,
         double d, double e, double f) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val = 
-           guac_socket_write_string(socket, "7.distort,")
-        || __guac_socket_write_length_int(socket, layer->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_double(socket, a)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_double(socket, b)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_double(socket, c)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_double(socket, d)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_double(socket, e)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_double(socket, f)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "7.distort,")
+        || guac_protocol_scratch_write_length_int(&scratch, layer->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_double(&scratch, a)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_double(&scratch, b)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_double(&scratch, c)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_double(&scratch, d)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_double(&scratch, e)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_double(&scratch, f)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -595,12 +979,14 @@ int guac_protocol_send_distort(guac_socket* socket, const guac_layer* layer,
 int guac_protocol_send_end(guac_socket* socket, const guac_stream* stream) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "3.end,")
-        || __guac_socket_write_length_int(socket, stream->index)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "3.end,")
+        || guac_protocol_scratch_write_length_int(&scratch, stream->index)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -611,14 +997,16 @@ int guac_protocol_send_error(guac_socket* socket, const char* error,
         guac_protocol_status status) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "5.error,")
-        || __guac_socket_write_length_string(socket, error)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, status)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "5.error,")
+        || guac_protocol_scratch_write_length_string(&scratch, error)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, status)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -629,6 +1017,7 @@ int vguac_protocol_send_log(guac_socket* socket, const char* format,
         va_list args) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     /* Copy log message into buffer */
     char message[4096];
@@ -637,9 +1026,10 @@ int vguac_protocol_send_log(guac_socket* socket, const char* format,
     /* Log to instruction */
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "3.log,")
-        || __guac_socket_write_length_string(socket, message)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "3.log,")
+        || guac_protocol_scratch_write_length_string(&scratch, message)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -680,16 +1070,18 @@ int guac_protocol_send_file(guac_socket* socket, const guac_stream* stream,
         const char* mimetype, const char* name) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "4.file,")
-        || __guac_socket_write_length_int(socket, stream->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_string(socket, mimetype)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_string(socket, name)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "4.file,")
+        || guac_protocol_scratch_write_length_int(&scratch, stream->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_string(&scratch, mimetype)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_string(&scratch, name)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -700,14 +1092,16 @@ int guac_protocol_send_filesystem(guac_socket* socket,
         const guac_object* object, const char* name) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "10.filesystem,")
-        || __guac_socket_write_length_int(socket, object->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_string(socket, name)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "10.filesystem,")
+        || guac_protocol_scratch_write_length_int(&scratch, object->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_string(&scratch, name)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -717,12 +1111,14 @@ int guac_protocol_send_filesystem(guac_socket* socket,
 int guac_protocol_send_identity(guac_socket* socket, const guac_layer* layer) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "8.identity,")
-        || __guac_socket_write_length_int(socket, layer->index)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "8.identity,")
+        || guac_protocol_scratch_write_length_int(&scratch, layer->index)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -733,14 +1129,16 @@ int guac_protocol_send_key(guac_socket* socket, int keysym, int pressed,
         guac_timestamp timestamp) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "3.key,")
-        || __guac_socket_write_length_int(socket, keysym)
-        || guac_socket_write_string(socket, pressed ? ",1.1," : ",1.0,")
-        || __guac_socket_write_length_int(socket, timestamp)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "3.key,")
+        || guac_protocol_scratch_write_length_int(&scratch, keysym)
+        || guac_protocol_scratch_write_string(&scratch, pressed ? ",1.1," : ",1.0,")
+        || guac_protocol_scratch_write_length_int(&scratch, timestamp)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -752,16 +1150,18 @@ int guac_protocol_send_lfill(guac_socket* socket,
         const guac_layer* srcl) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "5.lfill,")
-        || __guac_socket_write_length_int(socket, mode)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, layer->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, srcl->index)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "5.lfill,")
+        || guac_protocol_scratch_write_length_int(&scratch, mode)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, layer->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, srcl->index)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -772,16 +1172,18 @@ int guac_protocol_send_line(guac_socket* socket, const guac_layer* layer,
         int x, int y) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "4.line,")
-        || __guac_socket_write_length_int(socket, layer->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, x)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, y)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "4.line,")
+        || guac_protocol_scratch_write_length_int(&scratch, layer->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, x)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, y)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -794,22 +1196,24 @@ int guac_protocol_send_lstroke(guac_socket* socket,
         const guac_layer* srcl) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "7.lstroke,")
-        || __guac_socket_write_length_int(socket, mode)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, layer->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, cap)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, join)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, thickness)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, srcl->index)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "7.lstroke,")
+        || guac_protocol_scratch_write_length_int(&scratch, mode)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, layer->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, cap)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, join)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, thickness)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, srcl->index)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -820,18 +1224,20 @@ int guac_protocol_send_mouse(guac_socket* socket, int x, int y,
         int button_mask, guac_timestamp timestamp) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "5.mouse,")
-        || __guac_socket_write_length_int(socket, x)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, y)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, button_mask)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, timestamp)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "5.mouse,")
+        || guac_protocol_scratch_write_length_int(&scratch, x)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, y)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, button_mask)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, timestamp)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -843,26 +1249,28 @@ int guac_protocol_send_touch(guac_socket* socket, int id, int x, int y,
         guac_timestamp timestamp) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "5.touch,")
-        || __guac_socket_write_length_int(socket, id)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, x)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, y)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, x_radius)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, y_radius)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_double(socket, angle)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_double(socket, force)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, timestamp)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "5.touch,")
+        || guac_protocol_scratch_write_length_int(&scratch, id)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, x)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, y)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, x_radius)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, y_radius)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_double(&scratch, angle)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_double(&scratch, force)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, timestamp)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -873,20 +1281,22 @@ int guac_protocol_send_move(guac_socket* socket, const guac_layer* layer,
         const guac_layer* parent, int x, int y, int z) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "4.move,")
-        || __guac_socket_write_length_int(socket, layer->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, parent->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, x)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, y)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, z)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "4.move,")
+        || guac_protocol_scratch_write_length_int(&scratch, layer->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, parent->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, x)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, y)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, z)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -896,12 +1306,14 @@ int guac_protocol_send_move(guac_socket* socket, const guac_layer* layer,
 int guac_protocol_send_name(guac_socket* socket, const char* name) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "4.name,")
-        || __guac_socket_write_length_string(socket, name)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "4.name,")
+        || guac_protocol_scratch_write_length_string(&scratch, name)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -912,14 +1324,16 @@ int guac_protocol_send_nest(guac_socket* socket, int index,
         const char* data) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "4.nest,")
-        || __guac_socket_write_length_int(socket, index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_string(socket, data)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "4.nest,")
+        || guac_protocol_scratch_write_length_int(&scratch, index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_string(&scratch, data)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -942,16 +1356,18 @@ int guac_protocol_send_pipe(guac_socket* socket, const guac_stream* stream,
         const char* mimetype, const char* name) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "4.pipe,")
-        || __guac_socket_write_length_int(socket, stream->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_string(socket, mimetype)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_string(socket, name)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "4.pipe,")
+        || guac_protocol_scratch_write_length_int(&scratch, stream->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_string(&scratch, mimetype)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_string(&scratch, name)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -963,22 +1379,24 @@ int guac_protocol_send_img(guac_socket* socket, const guac_stream* stream,
         const char* mimetype, int x, int y) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "3.img,")
-        || __guac_socket_write_length_int(socket, stream->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, mode)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, layer->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_string(socket, mimetype)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, x)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, y)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "3.img,")
+        || guac_protocol_scratch_write_length_int(&scratch, stream->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, mode)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, layer->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_string(&scratch, mimetype)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, x)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, y)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -988,12 +1406,14 @@ int guac_protocol_send_img(guac_socket* socket, const guac_stream* stream,
 int guac_protocol_send_pop(guac_socket* socket, const guac_layer* layer) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "3.pop,")
-        || __guac_socket_write_length_int(socket, layer->index)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "3.pop,")
+        || guac_protocol_scratch_write_length_int(&scratch, layer->index)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -1003,12 +1423,14 @@ int guac_protocol_send_pop(guac_socket* socket, const guac_layer* layer) {
 int guac_protocol_send_push(guac_socket* socket, const guac_layer* layer) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "4.push,")
-        || __guac_socket_write_length_int(socket, layer->index)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "4.push,")
+        || guac_protocol_scratch_write_length_int(&scratch, layer->index)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -1018,12 +1440,14 @@ int guac_protocol_send_push(guac_socket* socket, const guac_layer* layer) {
 int guac_protocol_send_ready(guac_socket* socket, const char* id) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "5.ready,")
-        || __guac_socket_write_length_string(socket, id)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "5.ready,")
+        || guac_protocol_scratch_write_length_string(&scratch, id)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -1034,20 +1458,22 @@ int guac_protocol_send_rect(guac_socket* socket,
         const guac_layer* layer, int x, int y, int width, int height) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "4.rect,")
-        || __guac_socket_write_length_int(socket, layer->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, x)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, y)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, width)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, height)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "4.rect,")
+        || guac_protocol_scratch_write_length_int(&scratch, layer->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, x)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, y)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, width)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, height)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -1074,12 +1500,14 @@ int guac_protocol_send_required(guac_socket* socket, const char** required) {
 int guac_protocol_send_reset(guac_socket* socket, const guac_layer* layer) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "5.reset,")
-        || __guac_socket_write_length_int(socket, layer->index)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "5.reset,")
+        || guac_protocol_scratch_write_length_int(&scratch, layer->index)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -1090,16 +1518,18 @@ int guac_protocol_send_set(guac_socket* socket, const guac_layer* layer,
         const char* name, const char* value) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "3.set,")
-        || __guac_socket_write_length_int(socket, layer->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_string(socket, name)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_string(socket, value)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "3.set,")
+        || guac_protocol_scratch_write_length_int(&scratch, layer->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_string(&scratch, name)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_string(&scratch, value)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -1110,16 +1540,18 @@ int guac_protocol_send_set_int(guac_socket* socket, const guac_layer* layer,
         const char* name, int value) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "3.set,")
-        || __guac_socket_write_length_int(socket, layer->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_string(socket, name)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, value)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "3.set,")
+        || guac_protocol_scratch_write_length_int(&scratch, layer->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_string(&scratch, name)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, value)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -1129,12 +1561,14 @@ int guac_protocol_send_set_int(guac_socket* socket, const guac_layer* layer,
 int guac_protocol_send_select(guac_socket* socket, const char* protocol) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "6.select,")
-        || __guac_socket_write_length_string(socket, protocol)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "6.select,")
+        || guac_protocol_scratch_write_length_string(&scratch, protocol)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -1145,14 +1579,16 @@ int guac_protocol_send_shade(guac_socket* socket, const guac_layer* layer,
         int a) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "5.shade,")
-        || __guac_socket_write_length_int(socket, layer->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, a)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "5.shade,")
+        || guac_protocol_scratch_write_length_int(&scratch, layer->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, a)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -1163,16 +1599,18 @@ int guac_protocol_send_size(guac_socket* socket, const guac_layer* layer,
         int w, int h) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "4.size,")
-        || __guac_socket_write_length_int(socket, layer->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, w)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, h)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "4.size,")
+        || guac_protocol_scratch_write_length_int(&scratch, layer->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, w)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, h)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -1183,16 +1621,18 @@ int guac_protocol_send_start(guac_socket* socket, const guac_layer* layer,
         int x, int y) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "5.start,")
-        || __guac_socket_write_length_int(socket, layer->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, x)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, y)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "5.start,")
+        || guac_protocol_scratch_write_length_int(&scratch, layer->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, x)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, y)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -1203,14 +1643,16 @@ int guac_protocol_send_sync(guac_socket* socket, guac_timestamp timestamp,
         int frames) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val = 
-           guac_socket_write_string(socket, "4.sync,")
-        || __guac_socket_write_length_int(socket, timestamp)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, frames)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "4.sync,")
+        || guac_protocol_scratch_write_length_int(&scratch, timestamp)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, frames)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -1222,28 +1664,30 @@ int guac_protocol_send_transfer(guac_socket* socket,
         guac_transfer_function fn, const guac_layer* dstl, int dstx, int dsty) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "8.transfer,")
-        || __guac_socket_write_length_int(socket, srcl->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, srcx)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, srcy)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, w)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, h)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, fn)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, dstl->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, dstx)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, dsty)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "8.transfer,")
+        || guac_protocol_scratch_write_length_int(&scratch, srcl->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, srcx)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, srcy)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, w)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, h)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, fn)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, dstl->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, dstx)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, dsty)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -1255,24 +1699,26 @@ int guac_protocol_send_transform(guac_socket* socket, const guac_layer* layer,
         double d, double e, double f) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val = 
-           guac_socket_write_string(socket, "9.transform,")
-        || __guac_socket_write_length_int(socket, layer->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_double(socket, a)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_double(socket, b)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_double(socket, c)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_double(socket, d)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_double(socket, e)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_double(socket, f)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "9.transform,")
+        || guac_protocol_scratch_write_length_int(&scratch, layer->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_double(&scratch, a)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_double(&scratch, b)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_double(&scratch, c)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_double(&scratch, d)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_double(&scratch, e)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_double(&scratch, f)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -1283,12 +1729,14 @@ int guac_protocol_send_undefine(guac_socket* socket,
         const guac_object* object) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val =
-           guac_socket_write_string(socket, "8.undefine,")
-        || __guac_socket_write_length_int(socket, object->index)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "8.undefine,")
+        || guac_protocol_scratch_write_length_int(&scratch, object->index)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
 
     guac_socket_instruction_end(socket);
     return ret_val;
@@ -1299,16 +1747,18 @@ int guac_protocol_send_video(guac_socket* socket, const guac_stream* stream,
         const guac_layer* layer, const char* mimetype) {
 
     int ret_val;
+    guac_protocol_scratch scratch = { .socket = socket };
 
     guac_socket_instruction_begin(socket);
     ret_val = 
-           guac_socket_write_string(socket, "5.video,")
-        || __guac_socket_write_length_int(socket, stream->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_int(socket, layer->index)
-        || guac_socket_write_string(socket, ",")
-        || __guac_socket_write_length_string(socket, mimetype)
-        || guac_socket_write_string(socket, ";");
+           guac_protocol_scratch_write_string(&scratch, "5.video,")
+        || guac_protocol_scratch_write_length_int(&scratch, stream->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_int(&scratch, layer->index)
+        || guac_protocol_scratch_write_string(&scratch, ",")
+        || guac_protocol_scratch_write_length_string(&scratch, mimetype)
+        || guac_protocol_scratch_write_string(&scratch, ";")
+        || guac_protocol_scratch_flush(&scratch);
     guac_socket_instruction_end(socket);
 
     return ret_val;
@@ -55,6 +55,8 @@ static void raw_encoder_begin_handler(guac_audio_stream* audio) {
     /* Allocate and init encoder state */
     audio->data = state = guac_mem_alloc(sizeof(raw_encoder_state));
     state->written = 0;
+    state->bytes_per_ms = guac_mem_ckd_mul_or_die((size_t) audio->rate,
+            audio->channels, audio->bps) / 8 / 1000;
     state->length = guac_mem_ckd_mul_or_die(GUAC_RAW_ENCODER_BUFFER_SIZE,
             audio->rate, audio->channels, audio->bps) / 8 / 1000;
 
@@ -62,6 +64,38 @@ static void raw_encoder_begin_handler(guac_audio_stream* audio) {
 
 }
 
+/**
+ * Returns the number of buffered PCM bytes beyond which buffered data should
+ * be automatically flushed. The threshold adapts to the processing lag
+ * reported by connected clients through their sync responses, growing from
+ * GUAC_RAW_ENCODER_MIN_BUFFER_SIZE up to the full PCM buffer
+ * (GUAC_RAW_ENCODER_BUFFER_SIZE) as clients fall behind, such that
+ * responsive clients receive audio with minimal latency while lagging
+ * clients receive larger packets that are less likely to underrun.
+ *
+ * @param audio
+ *     The audio stream for which the current flush threshold should be
+ *     calculated.
+ *
+ * @return
+ *     The number of buffered PCM bytes beyond which buffered data should be
+ *     flushed.
+ */
+static size_t raw_encoder_flush_threshold(guac_audio_stream* audio) {
+
+    raw_encoder_state* state = (raw_encoder_state*) audio->data;
+
+    /* Grow threshold with client processing lag, up to the buffer size */
+    int threshold_ms = GUAC_RAW_ENCODER_MIN_BUFFER_SIZE
+        + guac_client_get_processing_lag(audio->client);
+
+    if (threshold_ms > GUAC_RAW_ENCODER_BUFFER_SIZE)
+        threshold_ms = GUAC_RAW_ENCODER_BUFFER_SIZE;
+
+    return threshold_ms * state->bytes_per_ms;
+
+}
+
 static void raw_encoder_join_handler(guac_audio_stream* audio,
         guac_user* user) {
 
@@ -113,6 +147,11 @@ static void raw_encoder_write_handler(guac_audio_stream* audio,
 
     }
 
+    /* Flush automatically once sufficient data has accumulated, sizing
+     * packets to the responsiveness of connected clients */
+    if (state->written >= raw_encoder_flush_threshold(audio))
+        guac_audio_stream_flush(audio);
+
 }
 
 static void raw_encoder_flush_handler(guac_audio_stream* audio) {
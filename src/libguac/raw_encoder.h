@@ -32,10 +32,22 @@
 /**
  * The size of the raw encoder output PCM buffer, in milliseconds. The
  * equivalent size in bytes will vary by PCM rate, number of channels, and bits
- * per sample.
+ * per sample. This is also the maximum amount of PCM data which will
+ * accumulate before a flush is forced, regardless of client responsiveness.
  */
 #define GUAC_RAW_ENCODER_BUFFER_SIZE 250
 
+/**
+ * The minimum amount of PCM data which must accumulate before buffered data
+ * is automatically flushed, in milliseconds. The actual flush threshold
+ * adapts between this value and GUAC_RAW_ENCODER_BUFFER_SIZE depending on
+ * the processing lag reported by connected clients through their sync
+ * responses: responsive clients receive smaller, more frequent packets
+ * (minimizing latency), while lagging clients receive larger, less frequent
+ * packets (avoiding underruns).
+ */
+#define GUAC_RAW_ENCODER_MIN_BUFFER_SIZE 50
+
 /**
  * The current state of the raw encoder. The raw encoder performs very minimal
  * processing, buffering provided PCM data only as necessary to ensure audio
@@ -58,6 +70,13 @@ typedef struct raw_encoder_state {
      */
     int written;
 
+    /**
+     * The number of bytes of PCM data which represent one millisecond of
+     * audio at the rate, number of channels, and bits per sample of the
+     * associated audio stream.
+     */
+    size_t bytes_per_ms;
+
 } raw_encoder_state;
 
 /**
@@ -19,9 +19,12 @@
 
 #include "guacamole/mem.h"
 #include "guacamole/client.h"
+#include "guacamole/error.h"
 #include "guacamole/protocol.h"
 #include "guacamole/recording.h"
 #include "guacamole/socket.h"
+#include "guacamole/socket-queued.h"
+#include "guacamole/string.h"
 #include "guacamole/timestamp.h"
 
 #ifdef __MINGW32__
@@ -32,6 +35,8 @@
 #include <sys/types.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -66,13 +71,18 @@
  *     Non-zero if writing to an existing file should be allowed, or zero
  *     otherwise.
  *
+ * @param append
+ *     Non-zero if the file should be opened in append mode, such that all
+ *     writes are atomically appended to the end of the file, or zero if
+ *     writes should begin at the start of the file.
+ *
  * @return
  *     The file descriptor of the open data file if open succeeded, or -1 on
  *     failure.
  */
 static int guac_recording_open(const char* path,
         const char* name, char* basename, int basename_size,
-        int allow_write_existing) {
+        int allow_write_existing, int append) {
 
     int i;
 
@@ -89,7 +99,9 @@ static int guac_recording_open(const char* path,
     }
 
     /* Require the file not exist already if allow_write_existing not set */
-    int flags = O_CREAT | O_WRONLY | (allow_write_existing ? 0 : O_EXCL);
+    int flags = O_CREAT | O_WRONLY
+        | (allow_write_existing ? 0 : O_EXCL)
+        | (append ? O_APPEND : 0);
 
     /* Attempt to open recording */
     int fd = open(basename, flags, S_IRUSR | S_IWUSR | S_IRGRP);
@@ -141,11 +153,547 @@ static int guac_recording_open(const char* path,
 
 }
 
+/**
+ * The maximum number of bytes required for the suffix appended to the
+ * recording base path to produce the name of a segment, including the
+ * ".part" suffix carried by a segment which is still being written and the
+ * NULL terminator.
+ */
+#define GUAC_RECORDING_SEGMENT_SUFFIX_LENGTH 24
+
+/**
+ * The state of the segmenting layer of a segmented recording, dividing the
+ * single logical stream of recorded instructions into multiple segment files
+ * on instruction boundaries.
+ */
+typedef struct guac_recording_segmenter {
+
+    /**
+     * The full path of the recording, as produced by guac_recording_open().
+     * This path refers to the segment manifest, with the name of each segment
+     * being formed by appending a sequential, zero-padded index to this path.
+     */
+    char base_path[GUAC_COMMON_RECORDING_MAX_NAME_LENGTH];
+
+    /**
+     * The file descriptor of the open manifest file. The name of each segment
+     * is appended to the manifest (and the manifest synced to disk) only
+     * after that segment has been finalized.
+     */
+    int manifest_fd;
+
+    /**
+     * The guac_socket which writes to the segment currently being written, or
+     * NULL if the segmenter has been shut down.
+     */
+    guac_socket* segment;
+
+    /**
+     * The file descriptor underlying the current segment socket, stored
+     * separately such that the segment can be synced to disk prior to
+     * finalization.
+     */
+    int segment_fd;
+
+    /**
+     * The index of the segment currently being written. The first segment of
+     * a recording has index zero.
+     */
+    int segment_index;
+
+    /**
+     * The number of bytes which have been written to the current segment so
+     * far.
+     */
+    uint64_t segment_written;
+
+    /**
+     * The time that the current segment was opened.
+     */
+    guac_timestamp segment_start;
+
+    /**
+     * The number of bytes after which a segment becomes eligible for
+     * rotation, or zero if segments should not be rotated based on size. As
+     * rotation may occur only on an instruction boundary, segments may exceed
+     * this size by up to one instruction.
+     */
+    uint64_t max_bytes;
+
+    /**
+     * The duration in milliseconds after which a segment becomes eligible for
+     * rotation, or zero if segments should not be rotated based on time.
+     */
+    uint64_t max_duration;
+
+    /**
+     * Non-zero if the scanner is currently within the value of a protocol
+     * element (including its trailing terminator), or zero if the scanner is
+     * currently within the decimal length prefix of the next element.
+     */
+    int scan_in_value;
+
+    /**
+     * The number of bytes remaining in the current element value, including
+     * its trailing terminator. Applicable only if scan_in_value is non-zero.
+     */
+    uint64_t scan_remaining;
+
+    /**
+     * The value of the decimal length prefix parsed so far. Applicable only
+     * if scan_in_value is zero.
+     */
+    uint64_t scan_length;
+
+    /**
+     * Lock which guards the scanner state and segment rotation against
+     * concurrent writes.
+     */
+    pthread_mutex_t lock;
+
+} guac_recording_segmenter;
+
+/**
+ * Produces the name of the recording segment having the given index within
+ * the given buffer.
+ *
+ * @param segmenter
+ *     The segmenter associated with the recording.
+ *
+ * @param index
+ *     The index of the segment.
+ *
+ * @param in_progress
+ *     Non-zero if the name of the in-progress (not yet finalized) form of the
+ *     segment should be produced, or zero for the finalized name.
+ *
+ * @param buffer
+ *     The buffer in which the segment name should be stored.
+ *
+ * @param buffer_size
+ *     The number of bytes available within the provided buffer.
+ */
+static void guac_recording_segment_name(guac_recording_segmenter* segmenter,
+        int index, int in_progress, char* buffer, int buffer_size) {
+
+    snprintf(buffer, buffer_size, "%s.%06i%s", segmenter->base_path, index,
+            in_progress ? ".part" : "");
+
+}
+
+/**
+ * Opens the recording segment having the given index, returning a file
+ * descriptor which appends to that segment. The segment is created with its
+ * in-progress (".part") name and is locked for writing by the current
+ * process, exactly as is done for a non-segmented recording.
+ *
+ * @param segmenter
+ *     The segmenter associated with the recording.
+ *
+ * @param index
+ *     The index of the segment to open.
+ *
+ * @return
+ *     The file descriptor of the open segment if open succeeded, or -1 on
+ *     failure.
+ */
+static int guac_recording_segment_open_fd(guac_recording_segmenter* segmenter,
+        int index) {
+
+    char segment_path[GUAC_COMMON_RECORDING_MAX_NAME_LENGTH
+        + GUAC_RECORDING_SEGMENT_SUFFIX_LENGTH];
+
+    guac_recording_segment_name(segmenter, index, 1, segment_path,
+            sizeof(segment_path));
+
+    /* Segments are always created fresh - a leftover in-progress segment from
+     * a prior crash must not be silently appended to */
+    int fd = open(segment_path, O_CREAT | O_WRONLY | O_APPEND | O_EXCL,
+            S_IRUSR | S_IWUSR | S_IRGRP);
+    if (fd == -1)
+        return -1;
+
+/* Explicit file locks are required only on POSIX platforms */
+#ifndef __MINGW32__
+    /* Lock entire segment for writing by the current process */
+    struct flock file_lock = {
+        .l_type   = F_WRLCK,
+        .l_whence = SEEK_SET,
+        .l_start  = 0,
+        .l_len    = 0,
+        .l_pid    = getpid()
+    };
+
+    if (fcntl(fd, F_SETLK, &file_lock) == -1) {
+        close(fd);
+        return -1;
+    }
+#endif
+
+    return fd;
+
+}
+
+/**
+ * Finalizes the segment currently being written: any buffered data is flushed
+ * and synced to disk, the segment is atomically renamed from its in-progress
+ * (".part") name to its final name, and the finalized name is appended to the
+ * manifest. A segment which does not appear in the manifest (or which still
+ * carries its in-progress name) was not cleanly finalized and may have a
+ * corrupt tail.
+ *
+ * @param segmenter
+ *     The segmenter whose current segment should be finalized.
+ */
+static void guac_recording_segment_finalize(
+        guac_recording_segmenter* segmenter) {
+
+    if (segmenter->segment == NULL)
+        return;
+
+    /* Force all segment contents to disk before the rename publishes the
+     * segment as complete */
+    guac_socket_flush(segmenter->segment);
+#ifndef __MINGW32__
+    fsync(segmenter->segment_fd);
+#endif
+
+    /* Freeing the underlying fd socket closes the segment */
+    guac_socket_free(segmenter->segment);
+    segmenter->segment = NULL;
+
+    char part_path[GUAC_COMMON_RECORDING_MAX_NAME_LENGTH
+        + GUAC_RECORDING_SEGMENT_SUFFIX_LENGTH];
+    char final_path[GUAC_COMMON_RECORDING_MAX_NAME_LENGTH
+        + GUAC_RECORDING_SEGMENT_SUFFIX_LENGTH];
+
+    guac_recording_segment_name(segmenter, segmenter->segment_index, 1,
+            part_path, sizeof(part_path));
+    guac_recording_segment_name(segmenter, segmenter->segment_index, 0,
+            final_path, sizeof(final_path));
+
+    /* Atomically strip the in-progress suffix, marking the segment as
+     * complete. If this fails the segment simply remains in its in-progress
+     * form, to be treated by readers as an unfinalized tail. */
+    if (rename(part_path, final_path))
+        return;
+
+    /* Record the finalized segment in the manifest by name (the manifest
+     * lives in the same directory as its segments) */
+    const char* filename = strrchr(final_path, '/');
+    filename = (filename != NULL) ? filename + 1 : final_path;
+
+    char line[sizeof(final_path) + 2];
+    int length = snprintf(line, sizeof(line), "%s\n", filename);
+
+    if (write(segmenter->manifest_fd, line, length) == length) {
+#ifndef __MINGW32__
+        fsync(segmenter->manifest_fd);
+#endif
+    }
+
+}
+
+/**
+ * Returns whether the segment currently being written has reached the
+ * configured size or duration limit and should be rotated at the next
+ * instruction boundary.
+ *
+ * @param segmenter
+ *     The segmenter to check.
+ *
+ * @return
+ *     Non-zero if the current segment should be rotated, zero otherwise.
+ */
+static int guac_recording_segment_due(guac_recording_segmenter* segmenter) {
+
+    if (segmenter->max_bytes
+            && segmenter->segment_written >= segmenter->max_bytes)
+        return 1;
+
+    if (segmenter->max_duration
+            && guac_timestamp_current() - segmenter->segment_start
+                >= (guac_timestamp) segmenter->max_duration)
+        return 1;
+
+    return 0;
+
+}
+
+/**
+ * Rotates to the next recording segment, finalizing the segment currently
+ * being written. The next segment is opened before the current segment is
+ * finalized such that a failure to open the next segment (disk full,
+ * permissions, etc.) simply leaves the recording appending to the current
+ * segment, with rotation retried at a later instruction boundary.
+ *
+ * @param segmenter
+ *     The segmenter which should rotate to its next segment.
+ */
+static void guac_recording_segment_rotate(
+        guac_recording_segmenter* segmenter) {
+
+    int fd = guac_recording_segment_open_fd(segmenter,
+            segmenter->segment_index + 1);
+    if (fd == -1)
+        return;
+
+    guac_recording_segment_finalize(segmenter);
+
+    segmenter->segment_index++;
+    segmenter->segment = guac_socket_open(fd);
+    segmenter->segment_fd = fd;
+    segmenter->segment_written = 0;
+    segmenter->segment_start = guac_timestamp_current();
+
+}
+
+/**
+ * Callback function which writes the given data to the current recording
+ * segment, scanning the Guacamole protocol stream for instruction boundaries
+ * and rotating to the next segment at the first boundary after the current
+ * segment reaches its configured size or duration limit. Rotating only on
+ * instruction boundaries guarantees that every finalized segment contains
+ * whole instructions and can be parsed in isolation.
+ *
+ * @param socket
+ *     The segmenting socket being written to.
+ *
+ * @param buf
+ *     The buffer of data to write.
+ *
+ * @param count
+ *     The number of bytes in the buffer to be written.
+ *
+ * @return
+ *     The number of bytes written if the write was successful, or -1 if an
+ *     error occurs.
+ */
+static ssize_t __guac_recording_segment_write_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    guac_recording_segmenter* segmenter =
+        (guac_recording_segmenter*) socket->data;
+
+    const char* data = (const char*) buf;
+    size_t offset = 0;
+    size_t flushed = 0;
+
+    pthread_mutex_lock(&(segmenter->lock));
+
+    while (offset < count) {
+
+        /* Skip over the value of the current element without inspecting its
+         * contents (values may contain bytes identical to the terminators) */
+        if (segmenter->scan_in_value) {
+
+            if (segmenter->scan_remaining > 1) {
+
+                size_t skip = segmenter->scan_remaining - 1;
+                if (skip > count - offset)
+                    skip = count - offset;
+
+                offset += skip;
+                segmenter->scan_remaining -= skip;
+                continue;
+
+            }
+
+            /* Consume the terminator following the element value */
+            char terminator = data[offset++];
+            segmenter->scan_in_value = 0;
+            segmenter->scan_length = 0;
+
+            /* Rotate at the instruction boundary if the current segment has
+             * reached its configured limit */
+            if (terminator == ';' && guac_recording_segment_due(segmenter)) {
+
+                /* Write everything up to and including the boundary before
+                 * the current segment is finalized */
+                if (guac_socket_write(segmenter->segment, data + flushed,
+                            offset - flushed))
+                    goto write_failed;
+
+                segmenter->segment_written += offset - flushed;
+                flushed = offset;
+
+                guac_recording_segment_rotate(segmenter);
+
+            }
+
+            continue;
+
+        }
+
+        /* Parse the decimal length prefix of the next element */
+        char c = data[offset++];
+        if (c == '.') {
+            segmenter->scan_in_value = 1;
+            segmenter->scan_remaining = segmenter->scan_length + 1;
+        }
+        else if (c >= '0' && c <= '9')
+            segmenter->scan_length = segmenter->scan_length * 10 + (c - '0');
+
+        /* Malformed data cannot be safely segmented and is simply passed
+         * through, with scanning resuming at the next digit */
+        else
+            segmenter->scan_length = 0;
+
+    }
+
+    /* Write any data remaining after the last rotation */
+    if (offset > flushed) {
+
+        if (guac_socket_write(segmenter->segment, data + flushed,
+                    offset - flushed))
+            goto write_failed;
+
+        segmenter->segment_written += offset - flushed;
+
+    }
+
+    pthread_mutex_unlock(&(segmenter->lock));
+    return count;
+
+write_failed:
+    pthread_mutex_unlock(&(segmenter->lock));
+    return -1;
+
+}
+
+/**
+ * Callback function which flushes the socket of the current recording
+ * segment.
+ *
+ * @param socket
+ *     The segmenting socket to flush.
+ *
+ * @return
+ *     The value returned by guac_socket_flush() when invoked on the current
+ *     segment.
+ */
+static ssize_t __guac_recording_segment_flush_handler(guac_socket* socket) {
+
+    guac_recording_segmenter* segmenter =
+        (guac_recording_segmenter*) socket->data;
+
+    pthread_mutex_lock(&(segmenter->lock));
+    ssize_t result = guac_socket_flush(segmenter->segment);
+    pthread_mutex_unlock(&(segmenter->lock));
+
+    return result;
+
+}
+
+/**
+ * Callback function which finalizes the current recording segment and frees
+ * all resources associated with the segmenting socket, including the
+ * manifest.
+ *
+ * @param socket
+ *     The segmenting socket being freed.
+ *
+ * @return
+ *     Always zero.
+ */
+static int __guac_recording_segment_free_handler(guac_socket* socket) {
+
+    guac_recording_segmenter* segmenter =
+        (guac_recording_segmenter*) socket->data;
+
+    /* Finalize and publish the last segment */
+    guac_recording_segment_finalize(segmenter);
+
+    close(segmenter->manifest_fd);
+    pthread_mutex_destroy(&(segmenter->lock));
+    guac_mem_free(segmenter);
+
+    return 0;
+
+}
+
+/**
+ * Creates a guac_socket which splits the single logical stream of recorded
+ * instructions across multiple segment files, taking ownership of the given
+ * manifest file descriptor. The first segment is opened immediately.
+ *
+ * @param basename
+ *     The full path of the recording, as produced by guac_recording_open().
+ *
+ * @param manifest_fd
+ *     The file descriptor of the open manifest file.
+ *
+ * @param max_size
+ *     The maximum size of each segment, in bytes, or zero if segments should
+ *     not be rotated based on size.
+ *
+ * @param max_duration
+ *     The maximum duration covered by each segment, in seconds, or zero if
+ *     segments should not be rotated based on time.
+ *
+ * @return
+ *     A new segmenting guac_socket if the first segment was successfully
+ *     opened, or NULL on failure.
+ */
+static guac_socket* guac_recording_segment_socket(const char* basename,
+        int manifest_fd, size_t max_size, int max_duration) {
+
+    guac_recording_segmenter* segmenter =
+        guac_mem_zalloc(sizeof(guac_recording_segmenter));
+
+    guac_strlcpy(segmenter->base_path, basename,
+            sizeof(segmenter->base_path));
+
+    segmenter->manifest_fd = manifest_fd;
+    segmenter->max_bytes = max_size;
+    segmenter->max_duration = (uint64_t) max_duration * 1000;
+    pthread_mutex_init(&(segmenter->lock), NULL);
+
+    /* Open the first segment */
+    int fd = guac_recording_segment_open_fd(segmenter, 0);
+    if (fd == -1) {
+        pthread_mutex_destroy(&(segmenter->lock));
+        guac_mem_free(segmenter);
+        return NULL;
+    }
+
+    segmenter->segment = guac_socket_open(fd);
+    segmenter->segment_fd = fd;
+    segmenter->segment_start = guac_timestamp_current();
+
+    /* Associate segmenter with new socket */
+    guac_socket* socket = guac_socket_alloc();
+    socket->data = segmenter;
+
+    /* Assign handlers (the socket is write-only, and reads are refused by
+     * default) */
+    socket->write_handler = __guac_recording_segment_write_handler;
+    socket->flush_handler = __guac_recording_segment_flush_handler;
+    socket->free_handler  = __guac_recording_segment_free_handler;
+
+    return socket;
+
+}
+
 guac_recording* guac_recording_create(guac_client* client,
         const char* path, const char* name, int create_path,
         int include_output, int include_mouse, int include_touch,
         int include_keys, int allow_write_existing) {
 
+    /* Without size or duration limits, the recording is written as a single
+     * file, as before segmented recordings existed */
+    return guac_recording_create_segmented(client, path, name, create_path,
+            include_output, include_mouse, include_touch, include_keys,
+            allow_write_existing, 0, 0);
+
+}
+
+guac_recording* guac_recording_create_segmented(guac_client* client,
+        const char* path, const char* name, int create_path,
+        int include_output, int include_mouse, int include_touch,
+        int include_keys, int allow_write_existing,
+        size_t max_segment_size, int max_segment_duration) {
+
     char filename[GUAC_COMMON_RECORDING_MAX_NAME_LENGTH];
 
     /* Create path if it does not exist, fail if impossible */
@@ -160,32 +708,86 @@ guac_recording* guac_recording_create(guac_client* client,
         return NULL;
     }
 
-    /* Attempt to open recording file */
-    int fd = guac_recording_open(
-            path, name, filename, sizeof(filename), allow_write_existing);
+    int segmented = (max_segment_size > 0 || max_segment_duration > 0);
+
+    /* Attempt to open recording file. For a segmented recording, this file
+     * serves as the segment manifest, and is opened in append mode such that
+     * segment names are atomically appended as segments are finalized. */
+    int fd = guac_recording_open(path, name, filename, sizeof(filename),
+            allow_write_existing, segmented);
     if (fd == -1) {
         guac_client_log(client, GUAC_LOG_ERROR,
                 "Creation of recording failed: %s", strerror(errno));
         return NULL;
     }
 
+    guac_socket* recording_socket;
+
+    /* Split the recording across multiple segment files if so requested */
+    if (segmented) {
+        recording_socket = guac_recording_segment_socket(filename, fd,
+                max_segment_size, max_segment_duration);
+        if (recording_socket == NULL) {
+            guac_client_log(client, GUAC_LOG_ERROR,
+                    "Creation of recording failed: %s", strerror(errno));
+            close(fd);
+            return NULL;
+        }
+    }
+
+    /* Otherwise, write the recording as a single file */
+    else
+        recording_socket = guac_socket_open(fd);
+
     /* Create recording structure with reference to underlying socket */
     guac_recording* recording = guac_mem_alloc(sizeof(guac_recording));
-    recording->socket = guac_socket_open(fd);
+    recording->socket = recording_socket;
+
+    /* Decouple writes to the recording from the live session by draining
+     * them through a dedicated writer thread, such that slow storage cannot
+     * stall the client connection */
+    guac_socket* queued_socket = guac_socket_queued(recording->socket);
+    if (queued_socket != NULL)
+        recording->socket = queued_socket;
+    else
+        guac_client_log(client, GUAC_LOG_WARNING, "Recording will be written "
+                "synchronously: %s", guac_error_message);
+
     recording->include_output = include_output;
     recording->include_mouse = include_mouse;
     recording->include_touch = include_touch;
     recording->include_keys = include_keys;
 
     /* Replace client socket with wrapped recording socket only if including
-     * output within the recording */
-    if (include_output)
-        client->socket = guac_socket_tee(client->socket, recording->socket);
+     * output within the recording, duplicating written data asynchronously
+     * such that the live session never waits on recording I/O */
+    if (include_output) {
+
+        guac_socket* tee_socket = guac_socket_tee_async(client->socket,
+                recording->socket);
+
+        /* Fall back to duplicating writes inline if the asynchronous tee
+         * cannot be created */
+        if (tee_socket == NULL) {
+            guac_client_log(client, GUAC_LOG_WARNING, "Recording will be "
+                    "written inline with the live session: %s",
+                    guac_error_message);
+            tee_socket = guac_socket_tee(client->socket, recording->socket);
+        }
+
+        client->socket = tee_socket;
+
+    }
 
     /* Recording creation succeeded */
-    guac_client_log(client, GUAC_LOG_INFO,
-            "Recording of session will be saved to \"%s\".",
-            filename);
+    if (segmented)
+        guac_client_log(client, GUAC_LOG_INFO, "Recording of session will be "
+                "saved as a series of segments indexed by the manifest "
+                "\"%s\".", filename);
+    else
+        guac_client_log(client, GUAC_LOG_INFO,
+                "Recording of session will be saved to \"%s\".",
+                filename);
 
     return recording;
 
@@ -19,6 +19,8 @@
 
 #include "guacamole/rect.h"
 
+#include <limits.h>
+
 /**
  * Given a bitmask that is one less than a power of two (ie: 0xF, 0x1F, etc.),
  * rounds the given value in the negative direction to the nearest multiple of
@@ -96,6 +98,75 @@ void guac_rect_constrain(guac_rect* rect, const guac_rect* max) {
 
 }
 
+void guac_rect_constrain_all(guac_rect* rects, size_t count,
+        const guac_rect* max) {
+
+    int left   = max->left;
+    int top    = max->top;
+    int right  = max->right;
+    int bottom = max->bottom;
+
+    /* Clamp each edge of each rectangle using only branchless min/max
+     * selections, such that the loop can be reduced to vector min/max
+     * operations over the contiguous array of rectangles */
+    for (size_t i = 0; i < count; i++) {
+        guac_rect* rect = &rects[i];
+        rect->left   = rect->left   > left   ? rect->left   : left;
+        rect->top    = rect->top    > top    ? rect->top    : top;
+        rect->right  = rect->right  < right  ? rect->right  : right;
+        rect->bottom = rect->bottom < bottom ? rect->bottom : bottom;
+    }
+
+}
+
+void guac_rect_extend_all(guac_rect* rect, const guac_rect* rects,
+        size_t count) {
+
+    /* Accumulate the union of all rectangles in the array starting from the
+     * identity of the union operation (an impossible rectangle that every
+     * comparison loses against) */
+    int left   = INT_MAX;
+    int top    = INT_MAX;
+    int right  = INT_MIN;
+    int bottom = INT_MIN;
+
+    for (size_t i = 0; i < count; i++) {
+
+        const guac_rect* min = &rects[i];
+
+        /* Empty rectangles may contain garbage coordinates and must not
+         * affect the union. Substituting the identity keeps the loop
+         * branchless (each substitution and comparison is a simple
+         * min/max selection that compilers can vectorize). */
+        int empty = min->right <= min->left || min->bottom <= min->top;
+        int min_left   = empty ? INT_MAX : min->left;
+        int min_top    = empty ? INT_MAX : min->top;
+        int min_right  = empty ? INT_MIN : min->right;
+        int min_bottom = empty ? INT_MIN : min->bottom;
+
+        left   = min_left   < left   ? min_left   : left;
+        top    = min_top    < top    ? min_top    : top;
+        right  = min_right  > right  ? min_right  : right;
+        bottom = min_bottom > bottom ? min_bottom : bottom;
+
+    }
+
+    /* The given rectangle is unaffected if all rectangles in the array were
+     * empty */
+    if (right <= left || bottom <= top)
+        return;
+
+    guac_rect region = {
+        .left   = left,
+        .top    = top,
+        .right  = right,
+        .bottom = bottom
+    };
+
+    guac_rect_extend(rect, &region);
+
+}
+
 void guac_rect_shrink(guac_rect* rect, int max_width, int max_height) {
 
     int original_width = guac_rect_width(rect);
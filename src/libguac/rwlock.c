@@ -17,9 +17,12 @@
  * under the License.
  */
 
+#include "config.h"
+
 #include <pthread.h>
 #include <stdint.h>
 #include "guacamole/error.h"
+#include "guacamole/mem.h"
 #include "guacamole/rwlock.h"
 
 /**
@@ -38,122 +41,170 @@
  */
 #define GUAC_REENTRANT_LOCK_WRITE_LOCK 2
 
-void guac_rwlock_init(guac_rwlock* lock) {
-
-    /* Configure to allow sharing this lock with child processes */
-    pthread_rwlockattr_t lock_attributes;
-    pthread_rwlockattr_init(&lock_attributes);
-    pthread_rwlockattr_setpshared(&lock_attributes, PTHREAD_PROCESS_SHARED);
-
-    /* Initialize the rwlock */
-    pthread_rwlock_init(&(lock->lock), &lock_attributes);
-
-    /* Initialize the  flags to 0, as threads won't have acquired it yet */
-    pthread_key_create(&(lock->key), (void *) 0);
-
-}
+/**
+ * Keyword applicable to variable declarations that causes the declared
+ * variable to be thread-local. The GCC-style "__thread" keyword is preferred,
+ * as it predates C11 and is more broadly supported by the compilers used to
+ * build guacamole-server.
+ */
+#if defined(__GNUC__)
+#define GUAC_RWLOCK_THREAD_LOCAL __thread
+#else
+#define GUAC_RWLOCK_THREAD_LOCAL _Thread_local
+#endif
 
-void guac_rwlock_destroy(guac_rwlock* lock) {
+/**
+ * The per-thread, per-lock state tracking whether (and how deeply) the
+ * current thread holds a given guac_rwlock. One such structure is lazily
+ * allocated for each thread that uses a given lock, and is freed
+ * automatically when that thread exits.
+ */
+typedef struct guac_rwlock_local_state {
 
-    /* Destroy the rwlock */
-    pthread_rwlock_destroy(&(lock->lock));
+    /**
+     * A flag indicating which lock, if any, is held by the current thread
+     * (one of GUAC_REENTRANT_LOCK_NO_LOCK, GUAC_REENTRANT_LOCK_READ_LOCK, or
+     * GUAC_REENTRANT_LOCK_WRITE_LOCK).
+     */
+    uintptr_t flag;
 
-    /* Destroy the thread-local key */
-    pthread_key_delete(lock->key);
+    /**
+     * The depth of the lock attempt by the current thread, i.e. the number
+     * of lock requests minus unlock requests.
+     */
+    uintptr_t count;
 
-}
+} guac_rwlock_local_state;
 
 /**
- * Clean up and destroy the provided guac reentrant rwlock.
- *
- * @param lock
- *     The guac reentrant rwlock to be destroyed.
+ * The serial number of the guac_rwlock whose local state was most recently
+ * retrieved by the current thread, or zero if no local state has yet been
+ * retrieved. Repeated operations against the same lock (the common case,
+ * particularly for reentrant acquisitions) can then locate their state with a
+ * plain thread-local comparison rather than a pthread key lookup.
  */
-void guac_rwlock_destroy(guac_rwlock* lock);
+static GUAC_RWLOCK_THREAD_LOCAL uintptr_t guac_rwlock_cached_serial = 0;
 
 /**
- * Extract and return the flag indicating which lock is held, if any, from the
- * provided key value. The flag is always stored in the least-significant
- * nibble of the value.
- *
- * @param value
- *     The key value containing the flag.
- *
- * @return
- *     The flag indicating which lock is held, if any.
+ * The local state of the guac_rwlock identified by guac_rwlock_cached_serial.
+ * This value is meaningful only if guac_rwlock_cached_serial is non-zero.
  */
-static uintptr_t get_lock_flag(uintptr_t value) {
-    return value & 0xF;
-}
+static GUAC_RWLOCK_THREAD_LOCAL guac_rwlock_local_state* guac_rwlock_cached_state = NULL;
 
 /**
- * Extract and return the lock count from the provided key. This returned value
- * is the difference between the number of lock and unlock requests made by the
- * current thread. This count is always stored in the remaining value after the
- * least-significant nibble where the flag is stored.
- *
- * @param value
- *     The key value containing the count.
- *
- * @return
- *     The difference between the number of lock and unlock requests made by
- *     the current thread.
+ * The serial number which will be assigned to the next lock initialized via
+ * guac_rwlock_init(). Serial numbers are never reused, guaranteeing that a
+ * stale cache entry for a destroyed lock can never match a newly-initialized
+ * lock that happens to occupy the same memory.
  */
-static uintptr_t get_lock_count(uintptr_t value) {
-    return value >> 4;
-}
+static uintptr_t guac_rwlock_next_serial = 0;
 
 /**
- * Given a flag indicating if and how the current thread controls a lock, and
- * a count of the depth of lock requests, return a value containing the flag
- * in the least-significant nibble, and the count in the rest.
+ * Returns the local state of the given lock for the current thread, lazily
+ * allocating that state if the current thread has not yet used the given
+ * lock. The state is freed automatically when the thread exits.
  *
- * @param flag
- *     A flag indicating which lock, if any, is held by the current thread.
- *
- * @param count
- *     The depth of the lock attempt by the current thread, i.e. the number of
- *     lock requests minus unlock requests.
+ * @param reentrant_rwlock
+ *     The lock whose local state should be retrieved.
  *
  * @return
- *     A value containing the flag in the least-significant nibble, and the
- *     count in the rest, cast to a void* for thread-local storage.
+ *     The local state of the given lock for the current thread, or NULL if
+ *     the state could not be allocated.
  */
-static void* get_value_from_flag_and_count(
-        uintptr_t flag, uintptr_t count) {
-    return (void*) ((flag & 0xF) | count << 4);
+static guac_rwlock_local_state* guac_rwlock_get_local_state(
+        guac_rwlock* reentrant_rwlock) {
+
+    /* Use cached state if this is the lock most recently used by this
+     * thread, avoiding the pthread key lookup entirely */
+    if (guac_rwlock_cached_serial == reentrant_rwlock->serial)
+        return guac_rwlock_cached_state;
+
+    guac_rwlock_local_state* local = (guac_rwlock_local_state*)
+        pthread_getspecific(reentrant_rwlock->key);
+
+    /* Allocate state on first use of this lock by this thread. The state is
+     * freed by the destructor associated with the lock's key when the thread
+     * exits. */
+    if (local == NULL) {
+
+        local = guac_mem_zalloc(sizeof(guac_rwlock_local_state));
+        if (local == NULL) {
+            guac_error = GUAC_STATUS_NO_MEMORY;
+            guac_error_message = "Unable to allocate thread-local state "
+                    "for rwlock";
+            return NULL;
+        }
+
+        pthread_setspecific(reentrant_rwlock->key, local);
+
+    }
+
+    /* Cache for future operations against this same lock */
+    guac_rwlock_cached_serial = reentrant_rwlock->serial;
+    guac_rwlock_cached_state = local;
+
+    return local;
+
 }
 
-/**
- * Return zero if adding one to the current count would overflow the storage
- * allocated to the count, or a non-zero value otherwise.
- *
- * @param current_count
- *     The current count for a lock that the current thread is trying to
- *     reentrantly acquire.
- *
- * @return
- *     Zero if adding one to the current count would overflow the storage
- *     allocated to the count, or a non-zero value otherwise.
- */
-static int would_overflow_count(uintptr_t current_count) {
+void guac_rwlock_init(guac_rwlock* lock) {
 
-    /**
-     * The count will overflow if it's already equal or greater to the maximum
-     * possible value that can be stored in a uintptr_t excluding the first nibble.
-     */
-    return current_count >= (UINTPTR_MAX >> 4);
+    /* Configure to allow sharing this lock with child processes */
+    pthread_rwlockattr_t lock_attributes;
+    pthread_rwlockattr_init(&lock_attributes);
+    pthread_rwlockattr_setpshared(&lock_attributes, PTHREAD_PROCESS_SHARED);
+
+#ifdef PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP
+    /* Prefer waiting writers over new readers where supported, such that a
+     * steady stream of readers (broadcasts to many users, for example)
+     * cannot starve writers (user join/leave) indefinitely. The
+     * non-recursive variant is safe despite the reentrancy provided by these
+     * functions, as reentrant acquisitions are satisfied entirely from the
+     * thread-local depth counter and never touch the underlying rwlock. */
+    pthread_rwlockattr_setkind_np(&lock_attributes,
+            PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+
+    /* Initialize the rwlock */
+    pthread_rwlock_init(&(lock->lock), &lock_attributes);
+
+    /* Create the key for per-thread lock state, such that each thread's
+     * state is freed automatically when that thread exits */
+    pthread_key_create(&(lock->key), PRIV_guac_mem_free);
+
+    /* Assign the unique serial number identifying this lock instance for
+     * the purposes of per-thread caching */
+    lock->serial = __atomic_add_fetch(&guac_rwlock_next_serial, 1,
+            __ATOMIC_RELAXED);
+
+    /* No acquisitions have yet occurred */
+    lock->read_acquires = 0;
+    lock->write_acquires = 0;
+    lock->read_contended = 0;
+    lock->write_contended = 0;
+
+}
+
+void guac_rwlock_destroy(guac_rwlock* lock) {
+
+    /* Destroy the rwlock */
+    pthread_rwlock_destroy(&(lock->lock));
+
+    /* Destroy the thread-local key. The per-thread state of any thread
+     * which used this lock remains allocated until that thread exits. */
+    pthread_key_delete(lock->key);
 
 }
 
 int guac_rwlock_acquire_write_lock(guac_rwlock* reentrant_rwlock) {
 
-    uintptr_t key_value = (uintptr_t) pthread_getspecific(reentrant_rwlock->key);
-    uintptr_t flag = get_lock_flag(key_value);
-    uintptr_t count = get_lock_count(key_value);
+    guac_rwlock_local_state* local =
+        guac_rwlock_get_local_state(reentrant_rwlock);
+    if (local == NULL)
+        return 1;
 
-    /* If acquiring this lock again would overflow the counter storage */
-    if (would_overflow_count(count)) {
+    /* If acquiring this lock again would overflow the depth counter */
+    if (local->count == UINTPTR_MAX) {
 
         guac_error = GUAC_STATUS_TOO_MANY;
         guac_error_message = "Unable to acquire write lock because there's"
@@ -164,9 +215,8 @@ int guac_rwlock_acquire_write_lock(guac_rwlock* reentrant_rwlock) {
     }
 
     /* If the current thread already holds the write lock, increment the count */
-    if (flag == GUAC_REENTRANT_LOCK_WRITE_LOCK) {
-        pthread_setspecific(reentrant_rwlock->key, get_value_from_flag_and_count(
-                flag, count + 1));
+    if (local->flag == GUAC_REENTRANT_LOCK_WRITE_LOCK) {
+        local->count++;
 
         /* This thread already has the lock */
         return 0;
@@ -179,15 +229,21 @@ int guac_rwlock_acquire_write_lock(guac_rwlock* reentrant_rwlock) {
      * write lock by another function without the caller knowing about it. This
      * shouldn't cause any issues, however.
      */
-    if (flag == GUAC_REENTRANT_LOCK_READ_LOCK)
+    if (local->flag == GUAC_REENTRANT_LOCK_READ_LOCK)
         pthread_rwlock_unlock(&(reentrant_rwlock->lock));
 
-    /* Acquire the write lock */
-    pthread_rwlock_wrlock(&(reentrant_rwlock->lock));
+    /* Acquire the write lock, counting acquisitions which had to wait */
+    __atomic_add_fetch(&(reentrant_rwlock->write_acquires), 1,
+            __ATOMIC_RELAXED);
+    if (pthread_rwlock_trywrlock(&(reentrant_rwlock->lock))) {
+        __atomic_add_fetch(&(reentrant_rwlock->write_contended), 1,
+                __ATOMIC_RELAXED);
+        pthread_rwlock_wrlock(&(reentrant_rwlock->lock));
+    }
 
     /* Mark that the current thread has the lock, and increment the count */
-    pthread_setspecific(reentrant_rwlock->key, get_value_from_flag_and_count(
-            GUAC_REENTRANT_LOCK_WRITE_LOCK, count + 1));
+    local->flag = GUAC_REENTRANT_LOCK_WRITE_LOCK;
+    local->count++;
 
     return 0;
 
@@ -195,12 +251,13 @@ int guac_rwlock_acquire_write_lock(guac_rwlock* reentrant_rwlock) {
 
 int guac_rwlock_acquire_read_lock(guac_rwlock* reentrant_rwlock) {
 
-    uintptr_t key_value = (uintptr_t) pthread_getspecific(reentrant_rwlock->key);
-    uintptr_t flag = get_lock_flag(key_value);
-    uintptr_t count = get_lock_count(key_value);
+    guac_rwlock_local_state* local =
+        guac_rwlock_get_local_state(reentrant_rwlock);
+    if (local == NULL)
+        return 1;
 
-    /* If acquiring this lock again would overflow the counter storage */
-    if (would_overflow_count(count)) {
+    /* If acquiring this lock again would overflow the depth counter */
+    if (local->count == UINTPTR_MAX) {
 
         guac_error = GUAC_STATUS_TOO_MANY;
         guac_error_message = "Unable to acquire read lock because there's"
@@ -212,24 +269,29 @@ int guac_rwlock_acquire_read_lock(guac_rwlock* reentrant_rwlock) {
 
     /* The current thread may read if either the read or write lock is held */
     if (
-            flag == GUAC_REENTRANT_LOCK_READ_LOCK ||
-            flag == GUAC_REENTRANT_LOCK_WRITE_LOCK
+            local->flag == GUAC_REENTRANT_LOCK_READ_LOCK ||
+            local->flag == GUAC_REENTRANT_LOCK_WRITE_LOCK
     ) {
 
         /* Increment the depth counter */
-        pthread_setspecific(reentrant_rwlock->key, get_value_from_flag_and_count(
-                flag, count + 1));
+        local->count++;
 
         /* This thread already has the lock */
         return 0;
     }
 
-    /* Acquire the lock */
-    pthread_rwlock_rdlock(&(reentrant_rwlock->lock));
+    /* Acquire the lock, counting acquisitions which had to wait */
+    __atomic_add_fetch(&(reentrant_rwlock->read_acquires), 1,
+            __ATOMIC_RELAXED);
+    if (pthread_rwlock_tryrdlock(&(reentrant_rwlock->lock))) {
+        __atomic_add_fetch(&(reentrant_rwlock->read_contended), 1,
+                __ATOMIC_RELAXED);
+        pthread_rwlock_rdlock(&(reentrant_rwlock->lock));
+    }
 
     /* Set the flag that the current thread has the read lock */
-    pthread_setspecific(reentrant_rwlock->key, get_value_from_flag_and_count(
-                GUAC_REENTRANT_LOCK_READ_LOCK, 1));
+    local->flag = GUAC_REENTRANT_LOCK_READ_LOCK;
+    local->count = 1;
 
     return 0;
 
@@ -237,15 +299,16 @@ int guac_rwlock_acquire_read_lock(guac_rwlock* reentrant_rwlock) {
 
 int guac_rwlock_release_lock(guac_rwlock* reentrant_rwlock) {
 
-    uintptr_t key_value = (uintptr_t) pthread_getspecific(reentrant_rwlock->key);
-    uintptr_t flag = get_lock_flag(key_value);
-    uintptr_t count = get_lock_count(key_value);
+    guac_rwlock_local_state* local =
+        guac_rwlock_get_local_state(reentrant_rwlock);
+    if (local == NULL)
+        return 1;
 
     /*
      * Return an error if an attempt is made to release a lock that the current
      * thread does not control.
      */
-    if (count <= 0) {
+    if (local->count == 0) {
 
         guac_error = GUAC_STATUS_INVALID_ARGUMENT;
         guac_error_message = "Unable to free rwlock because it's not held by"
@@ -256,20 +319,19 @@ int guac_rwlock_release_lock(guac_rwlock* reentrant_rwlock) {
     }
 
     /* Release the lock if this is the last locked level */
-    if (count == 1) {
+    if (local->count == 1) {
 
         pthread_rwlock_unlock(&(reentrant_rwlock->lock));
 
-        /* Set the flag that the current thread holds no locks */
-        pthread_setspecific(reentrant_rwlock->key, get_value_from_flag_and_count(
-                GUAC_REENTRANT_LOCK_NO_LOCK, 0));
+        /* Mark that the current thread holds no locks */
+        local->flag = GUAC_REENTRANT_LOCK_NO_LOCK;
+        local->count = 0;
 
         return 0;
     }
 
     /* Do not release the lock since it's still in use - just decrement */
-    pthread_setspecific(reentrant_rwlock->key, get_value_from_flag_and_count(
-            flag, count - 1));
+    local->count--;
 
     return 0;
 
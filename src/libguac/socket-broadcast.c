@@ -23,10 +23,12 @@
 #include "guacamole/client.h"
 #include "guacamole/error.h"
 #include "guacamole/socket.h"
+#include "guacamole/timestamp.h"
 #include "guacamole/user.h"
 
 #include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
 
 /**
  * A function that will broadcast arbitrary data to a subset of users for
@@ -68,24 +70,24 @@ typedef struct guac_socket_broadcast_data {
      */
     guac_socket_broadcast_handler* broadcast_handler;
 
-} guac_socket_broadcast_data;
-
-/**
- * Single chunk of data, to be broadcast to all users.
- */
-typedef struct __write_chunk {
+    /**
+     * Buffer containing the data written so far for the instruction
+     * currently being written, to be broadcast to all users as a single
+     * shared buffer once the instruction is complete.
+     */
+    char* pending;
 
     /**
-     * The buffer to write.
+     * The number of bytes currently within the pending instruction buffer.
      */
-    const void* buffer;
+    size_t pending_length;
 
     /**
-     * The number of bytes in the buffer.
+     * The current size of the pending instruction buffer, in bytes.
      */
-    size_t length;
+    size_t pending_capacity;
 
-} __write_chunk;
+} guac_socket_broadcast_data;
 
 /**
  * Callback which handles read requests on the broadcast socket. This callback
@@ -114,35 +116,40 @@ static ssize_t __guac_socket_broadcast_read_handler(guac_socket* socket,
 }
 
 /**
- * Callback invoked by the broadcast handler which write a given chunk of
- * data to that user's socket. If the write attempt fails, the user is
- * signalled to stop with guac_user_stop().
+ * Callback invoked by the broadcast handler which writes a shared buffer
+ * containing a completed instruction to the given user's socket. Sockets
+ * which support queueing output by reference will simply take a reference to
+ * the shared buffer, rather than copy its contents. If the write attempt
+ * fails, the user is signalled to stop with guac_user_stop().
  *
  * @param user
- *     The user that the chunk of data should be written to.
+ *     The user that the shared buffer should be written to.
  *
  * @param data
- *     A pointer to a __write_chunk which describes the data to be written.
+ *     A pointer to the guac_socket_shared_buffer to be written.
  *
  * @return
  *     Always NULL.
  */
-static void* __write_chunk_callback(guac_user* user, void* data) {
+static void* __write_shared_callback(guac_user* user, void* data) {
 
-    __write_chunk* chunk = (__write_chunk*) data;
+    guac_socket_shared_buffer* shared = (guac_socket_shared_buffer*) data;
 
     /* Attempt write, disconnect on failure */
-    if (guac_socket_write(user->socket, chunk->buffer, chunk->length))
+    guac_socket_instruction_begin(user->socket);
+    if (guac_socket_write_shared(user->socket, shared))
         guac_user_stop(user);
+    guac_socket_instruction_end(user->socket);
 
     return NULL;
 
 }
 
 /**
- * Socket write handler which operates on each of the sockets of all connected
- * users. This write handler will always succeed, but any failing user-specific
- * writes will invoke guac_user_stop() on the failing user.
+ * Socket write handler which appends the given data to the buffer of the
+ * instruction currently being written. The accumulated instruction is
+ * broadcast to all users as a single shared buffer once complete. This write
+ * handler will always succeed.
  *
  * @param socket
  *     The socket to which the given data must be written.
@@ -164,18 +171,71 @@ static ssize_t __guac_socket_broadcast_write_handler(guac_socket* socket,
     guac_socket_broadcast_data* data =
         (guac_socket_broadcast_data*) socket->data;
 
-    /* Build chunk */
-    __write_chunk chunk;
-    chunk.buffer = buf;
-    chunk.length = count;
+    /* Grow pending buffer as necessary */
+    if (data->pending_length + count > data->pending_capacity) {
+
+        size_t new_capacity = data->pending_capacity;
+        if (new_capacity == 0)
+            new_capacity = GUAC_SOCKET_OUTPUT_BUFFER_SIZE;
+
+        while (data->pending_length + count > new_capacity)
+            new_capacity = guac_mem_ckd_mul_or_die(new_capacity, 2);
+
+        data->pending = guac_mem_realloc_or_die(data->pending, new_capacity);
+        data->pending_capacity = new_capacity;
 
-    /* Broadcast chunk to the users */
-    data->broadcast_handler(data->client, __write_chunk_callback, &chunk);
+    }
+
+    /* Append to pending instruction buffer */
+    memcpy(data->pending + data->pending_length, buf, count);
+    data->pending_length += count;
 
     return count;
 
 }
 
+/**
+ * Broadcasts the contents of the pending instruction buffer (if any) to all
+ * users as a single shared buffer, which each user's socket may queue by
+ * reference rather than copy. The socket lock must be held by the caller.
+ *
+ * @param socket
+ *     The broadcast socket whose pending instruction buffer should be
+ *     broadcast.
+ */
+static void __guac_socket_broadcast_commit(guac_socket* socket) {
+
+    guac_socket_broadcast_data* data =
+        (guac_socket_broadcast_data*) socket->data;
+
+    /* Nothing to do if no data is pending */
+    if (data->pending_length == 0)
+        return;
+
+    /* Hand the accumulated buffer itself to a shared, reference-counted
+     * buffer, leaving the pending buffer to be reallocated by the next
+     * write */
+    guac_socket_shared_buffer* shared = guac_socket_shared_buffer_alloc(
+            data->pending, data->pending_length);
+
+    data->pending = NULL;
+    data->pending_length = 0;
+    data->pending_capacity = 0;
+
+    /* Broadcast the shared buffer to the users, tracking any time spent
+     * blocked (waiting on the output queue of a lagging connection) as write
+     * stall, exactly as for normal writes */
+    socket->last_write_timestamp = guac_timestamp_current_coarse();
+    data->broadcast_handler(data->client, __write_shared_callback, shared);
+    socket->__write_stall_ms += guac_timestamp_current_coarse()
+        - socket->last_write_timestamp;
+
+    /* Release our own reference; the buffer remains allocated only as long
+     * as references queued on user sockets remain */
+    guac_socket_shared_buffer_unref(shared);
+
+}
+
 /**
  * Callback which is invoked by the broadcast handler to flush all
  * pending data on the given user's socket. If an error occurs while flushing
@@ -218,6 +278,13 @@ static ssize_t __guac_socket_broadcast_flush_handler(guac_socket* socket) {
     guac_socket_broadcast_data* data =
         (guac_socket_broadcast_data*) socket->data;
 
+    /* Broadcast any pending instruction data which has not yet been handed
+     * off (writes are expected only within instruction boundaries, so this
+     * is normally a no-op) */
+    pthread_mutex_lock(&(data->socket_lock));
+    __guac_socket_broadcast_commit(socket);
+    pthread_mutex_unlock(&(data->socket_lock));
+
     /* Flush the users */
     data->broadcast_handler(data->client, __flush_callback, NULL);
 
@@ -226,34 +293,13 @@ static ssize_t __guac_socket_broadcast_flush_handler(guac_socket* socket) {
 }
 
 /**
- * Callback which is invoked by the broadcast handler to lock the given
- * user's socket in preparation for the beginning of a Guacamole protocol
- * instruction.
- *
- * @param user
- *     The user whose socket should be locked.
- *
- * @param data
- *     Arbitrary data passed to the broadcast handler. This is not needed
- *     by this callback, and should be left as NULL.
- *
- * @return
- *     Always NULL.
- */
-static void* __lock_callback(guac_user* user, void* data) {
-
-    /* Lock socket */
-    guac_socket_instruction_begin(user->socket);
-
-    return NULL;
-
-}
-
-/**
- * Socket lock handler which acquires the socket locks of all connected users.
- * Socket-level locks are acquired in preparation for the beginning of a new
- * Guacamole instruction to ensure that parallel writes are only interleaved at
- * instruction boundaries.
+ * Socket lock handler which acquires exclusive access to the broadcast
+ * socket in preparation for the beginning of a new Guacamole instruction.
+ * The instruction is accumulated within the pending instruction buffer while
+ * exclusive access is held, and is broadcast to the users as a single shared
+ * buffer once exclusive access is released, ensuring that parallel writes
+ * are only interleaved at instruction boundaries without holding any
+ * user-specific lock while the instruction is produced.
  *
  * @param socket
  *     The broadcast socket to lock.
@@ -266,38 +312,12 @@ static void __guac_socket_broadcast_lock_handler(guac_socket* socket) {
     /* Acquire exclusive access to socket */
     pthread_mutex_lock(&(data->socket_lock));
 
-    /* Lock sockets of the users */
-    data->broadcast_handler(data->client, __lock_callback, NULL);
-
-}
-
-/**
- * Callback which is invoked by the broadcast handler to unlock the given
- * user's socket at the end of a Guacamole protocol instruction.
- *
- * @param user
- *     The user whose socket should be unlocked.
- *
- * @param data
- *     Arbitrary data passed to the broadcast handler. This is not needed
- *     by this callback, and should be left as NULL.
- *
- * @return
- *     Always NULL.
- */
-static void* __unlock_callback(guac_user* user, void* data) {
-
-    /* Unlock socket */
-    guac_socket_instruction_end(user->socket);
-
-    return NULL;
-
 }
 
 /**
- * Socket unlock handler which releases the socket locks of all connected users.
- * Socket-level locks are released after a Guacamole instruction has finished
- * being written.
+ * Socket unlock handler which broadcasts the now-complete instruction to all
+ * users as a single shared buffer and releases exclusive access to the
+ * broadcast socket.
  *
  * @param socket
  *     The broadcast socket to unlock.
@@ -307,8 +327,8 @@ static void __guac_socket_broadcast_unlock_handler(guac_socket* socket) {
     guac_socket_broadcast_data* data =
         (guac_socket_broadcast_data*) socket->data;
 
-    /* Unlock sockets of all users */
-    data->broadcast_handler(data->client, __unlock_callback, NULL);
+    /* Broadcast the instruction which was just completed */
+    __guac_socket_broadcast_commit(socket);
 
     /* Relinquish exclusive access to socket */
     pthread_mutex_unlock(&(data->socket_lock));
@@ -361,6 +381,7 @@ static int __guac_socket_broadcast_free_handler(guac_socket* socket) {
     /* Destroy locks */
     pthread_mutex_destroy(&(data->socket_lock));
 
+    guac_mem_free(data->pending);
     guac_mem_free(data);
     return 0;
 
@@ -388,7 +409,7 @@ static guac_socket* __guac_socket_init(
     /* Allocate socket and associated data */
     guac_socket* socket = guac_socket_alloc();
     guac_socket_broadcast_data* data =
-        guac_mem_alloc(sizeof(guac_socket_broadcast_data));
+        guac_mem_zalloc(sizeof(guac_socket_broadcast_data));
 
     /* Set the provided broadcast handler */
     data->broadcast_handler = broadcast_handler;
@@ -430,3 +451,107 @@ guac_socket* guac_socket_broadcast_pending(guac_client* client) {
 
 }
 
+/**
+ * The callback and data of an in-progress iteration over a capability-based
+ * subset of the connected users of a client.
+ */
+typedef struct __filtered_foreach_state {
+
+    /**
+     * The callback to invoke for each user matching the filter.
+     */
+    guac_user_callback* callback;
+
+    /**
+     * Arbitrary data to pass to the callback.
+     */
+    void* data;
+
+    /**
+     * The required WebP support status. Only users whose WebP support
+     * matches this value will receive the callback.
+     */
+    int webp_supported;
+
+} __filtered_foreach_state;
+
+/**
+ * Callback which invokes the callback of the given __filtered_foreach_state
+ * for the given user only if that user's WebP support matches the state's
+ * filter, skipping the user entirely otherwise.
+ *
+ * @param user
+ *     The user to test against the filter.
+ *
+ * @param data
+ *     A pointer to the __filtered_foreach_state describing the filter and
+ *     the callback to invoke for matching users.
+ *
+ * @return
+ *     The value returned by the wrapped callback, or NULL if the user did
+ *     not match the filter.
+ */
+static void* __filtered_foreach_callback(guac_user* user, void* data) {
+
+    __filtered_foreach_state* state = (__filtered_foreach_state*) data;
+
+    /* Invoke wrapped callback only if WebP support matches the filter */
+    if ((guac_user_supports_webp(user) != 0) == state->webp_supported)
+        return state->callback(user, state->data);
+
+    return NULL;
+
+}
+
+/**
+ * Broadcast handler which invokes the given callback for each non-pending
+ * connected user of the given client that supports WebP.
+ *
+ * @param client
+ *     The guac_client whose WebP-capable users should be iterated.
+ *
+ * @param callback
+ *     The callback to invoke for each WebP-capable user.
+ *
+ * @param data
+ *     Arbitrary data to pass to the callback.
+ */
+static void __guac_client_foreach_webp_user(guac_client* client,
+        guac_user_callback* callback, void* data) {
+    __filtered_foreach_state state = { callback, data, 1 };
+    guac_client_foreach_user(client, __filtered_foreach_callback, &state);
+}
+
+/**
+ * Broadcast handler which invokes the given callback for each non-pending
+ * connected user of the given client that does not support WebP.
+ *
+ * @param client
+ *     The guac_client whose users lacking WebP support should be iterated.
+ *
+ * @param callback
+ *     The callback to invoke for each user lacking WebP support.
+ *
+ * @param data
+ *     Arbitrary data to pass to the callback.
+ */
+static void __guac_client_foreach_non_webp_user(guac_client* client,
+        guac_user_callback* callback, void* data) {
+    __filtered_foreach_state state = { callback, data, 0 };
+    guac_client_foreach_user(client, __filtered_foreach_callback, &state);
+}
+
+guac_socket* guac_socket_broadcast_webp(guac_client* client) {
+
+    /* Broadcast to all connected non-pending users that support WebP */
+    return __guac_socket_init(client, __guac_client_foreach_webp_user);
+
+}
+
+guac_socket* guac_socket_broadcast_non_webp(guac_client* client) {
+
+    /* Broadcast to all connected non-pending users lacking WebP support */
+    return __guac_socket_init(client, __guac_client_foreach_non_webp_user);
+
+}
+
@@ -34,8 +34,19 @@
 
 #ifdef ENABLE_WINSOCK
 #include <winsock2.h>
+#else
+#include <sys/uio.h>
 #endif
 
+/**
+ * The minimum size that a single write must be for it to bypass the output
+ * buffer, being written directly to the underlying file descriptor (along
+ * with any buffered data) using scatter-gather I/O rather than copied into
+ * the output buffer. Writes of this size would overwhelmingly flush the
+ * output buffer anyway, so the intermediate copy is pure overhead.
+ */
+#define GUAC_SOCKET_FD_MIN_DIRECT_WRITE (GUAC_SOCKET_OUTPUT_BUFFER_SIZE / 2)
+
 /**
  * Data associated with an open socket which writes to a file descriptor.
  */
@@ -167,6 +178,101 @@ static ssize_t guac_socket_fd_read_handler(guac_socket* socket,
 
 }
 
+#ifndef ENABLE_WINSOCK
+/**
+ * Attempts to read from the underlying file descriptor of the given
+ * guac_socket, populating the given buffers in order with a single readv()
+ * call.
+ *
+ * @param socket
+ *     The guac_socket being read from.
+ *
+ * @param iov
+ *     The array of buffers to populate with data, in order.
+ *
+ * @param iovcnt
+ *     The number of buffers within the given array.
+ *
+ * @return
+ *     The number of bytes read, or -1 if an error occurs.
+ */
+static ssize_t guac_socket_fd_readv_handler(guac_socket* socket,
+        const struct iovec* iov, int iovcnt) {
+
+    guac_socket_fd_data* data = (guac_socket_fd_data*) socket->data;
+
+    ssize_t retval = readv(data->fd, iov, iovcnt);
+
+    /* Record errors in guac_error */
+    if (retval < 0) {
+        guac_error = GUAC_STATUS_SEE_ERRNO;
+        guac_error_message = "Error reading data from socket";
+    }
+
+    return retval;
+
+}
+#endif
+
+#ifndef ENABLE_WINSOCK
+/**
+ * Writes the entire contents of the given array of iovec structures to the
+ * file descriptor associated with the given socket using writev(), retrying
+ * as necessary until all buffers are fully written, and aborting if an error
+ * occurs.
+ *
+ * @param socket
+ *     The guac_socket associated with the file descriptor to which the given
+ *     buffers should be written.
+ *
+ * @param iov
+ *     The array of iovec structures describing the buffers to write. The
+ *     contents of this array may be modified to track write progress.
+ *
+ * @param iovcnt
+ *     The number of iovec structures within the given array.
+ *
+ * @return
+ *     Zero if all buffers were successfully written, or a negative value if
+ *     an error occurs.
+ */
+static ssize_t guac_socket_fd_writev(guac_socket* socket,
+        struct iovec* iov, int iovcnt) {
+
+    guac_socket_fd_data* data = (guac_socket_fd_data*) socket->data;
+
+    /* Write until all buffers are completely written */
+    while (iovcnt > 0) {
+
+        ssize_t retval = writev(data->fd, iov, iovcnt);
+
+        /* Record errors in guac_error */
+        if (retval < 0) {
+            guac_error = GUAC_STATUS_SEE_ERRNO;
+            guac_error_message = "Error writing data to socket";
+            return retval;
+        }
+
+        /* Skip over any buffers which are now completely written */
+        while (iovcnt > 0 && (size_t) retval >= iov->iov_len) {
+            retval -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+
+        /* Advance within a partially-written buffer */
+        if (iovcnt > 0) {
+            iov->iov_base = (char*) iov->iov_base + retval;
+            iov->iov_len -= retval;
+        }
+
+    }
+
+    return 0;
+
+}
+#endif
+
 /**
  * Flushes the contents of the output buffer of the given socket immediately,
  * without first locking access to the output buffer. This function must ONLY
@@ -250,6 +356,36 @@ static ssize_t guac_socket_fd_write_buffered(guac_socket* socket,
     const char* current = buf;
     guac_socket_fd_data* data = (guac_socket_fd_data*) socket->data;
 
+#ifndef ENABLE_WINSOCK
+    /* Write large payloads directly, gathering any previously-buffered data
+     * into the same writev() call rather than copying the payload through
+     * the output buffer */
+    if (count >= GUAC_SOCKET_FD_MIN_DIRECT_WRITE) {
+
+        struct iovec iov[2] = {
+            { .iov_base = data->out_buf,  .iov_len = data->written },
+            { .iov_base = (void*) current, .iov_len = count }
+        };
+
+        /* Skip empty output buffer */
+        struct iovec* current_iov = iov;
+        int iovcnt = 2;
+        if (data->written == 0) {
+            current_iov++;
+            iovcnt--;
+        }
+
+        /* Abort if error occurs during write */
+        if (guac_socket_fd_writev(socket, current_iov, iovcnt))
+            return -1;
+
+        /* All data (buffered and provided) has been written */
+        data->written = 0;
+        return original_count;
+
+    }
+#endif
+
     /* Append to buffer, flush if necessary */
     while (count > 0) {
 
@@ -440,6 +576,9 @@ guac_socket* guac_socket_open(int fd) {
     
     /* Set read/write handlers */
     socket->read_handler   = guac_socket_fd_read_handler;
+#ifndef ENABLE_WINSOCK
+    socket->readv_handler  = guac_socket_fd_readv_handler;
+#endif
     socket->write_handler  = guac_socket_fd_write_handler;
     socket->select_handler = guac_socket_fd_select_handler;
     socket->lock_handler   = guac_socket_fd_lock_handler;
@@ -0,0 +1,655 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "guacamole/mem.h"
+#include "guacamole/error.h"
+#include "guacamole/socket.h"
+#include "guacamole/socket-queued.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * A single queued unit of output: either a complete instruction (or group of
+ * writes performed within one instruction lock), or a request that the
+ * underlying socket be flushed.
+ */
+typedef struct guac_socket_queued_chunk {
+
+    /**
+     * The data to be written, or NULL if this chunk instead references a
+     * shared buffer or represents a flush request.
+     */
+    char* buffer;
+
+    /**
+     * The shared, reference-counted buffer to be written, or NULL if this
+     * chunk instead owns its data directly (or represents a flush request).
+     * The reference held by this chunk is released once the chunk has been
+     * written.
+     */
+    guac_socket_shared_buffer* shared;
+
+    /**
+     * The number of bytes to be written, regardless of whether those bytes
+     * are owned by this chunk directly or referenced via a shared buffer.
+     */
+    size_t length;
+
+    /**
+     * The next chunk within the queue, or NULL if this is the last chunk.
+     */
+    struct guac_socket_queued_chunk* next;
+
+} guac_socket_queued_chunk;
+
+/**
+ * Data associated with an open socket which queues all written instructions,
+ * writing them to an underlying socket from a dedicated writer thread.
+ */
+typedef struct guac_socket_queued_data {
+
+    /**
+     * The wrapped socket to which all queued data is actually written.
+     */
+    guac_socket* underlying;
+
+    /**
+     * Lock which is acquired when an instruction is being written, and
+     * released when the instruction is finished being written. This lock
+     * also protects the pending instruction buffer.
+     */
+    pthread_mutex_t socket_lock;
+
+    /**
+     * Buffer containing the data written so far for the instruction
+     * currently being written, to be queued as a single chunk once the
+     * instruction is complete.
+     */
+    char* pending;
+
+    /**
+     * The number of bytes currently within the pending instruction buffer.
+     */
+    size_t pending_length;
+
+    /**
+     * The current size of the pending instruction buffer, in bytes.
+     */
+    size_t pending_capacity;
+
+    /**
+     * Lock which protects the queue itself.
+     */
+    pthread_mutex_t queue_lock;
+
+    /**
+     * Condition which is signalled whenever the queue changes, whether due
+     * to chunks being added or removed, an error occurring, or the socket
+     * being freed.
+     */
+    pthread_cond_t queue_modified;
+
+    /**
+     * The first chunk within the queue (the next chunk to be written), or
+     * NULL if the queue is empty.
+     */
+    guac_socket_queued_chunk* head;
+
+    /**
+     * The last chunk within the queue, or NULL if the queue is empty.
+     */
+    guac_socket_queued_chunk* tail;
+
+    /**
+     * The total number of data bytes currently queued.
+     */
+    size_t queued_bytes;
+
+    /**
+     * Non-zero if a write to the underlying socket has failed or if the
+     * queue has overflowed, in which case all future writes will fail
+     * immediately.
+     */
+    int write_error;
+
+    /**
+     * Non-zero if the socket is being freed and the writer thread should
+     * terminate once the queue is drained.
+     */
+    int shutting_down;
+
+    /**
+     * The dedicated writer thread which drains the queue.
+     */
+    pthread_t writer_thread;
+
+} guac_socket_queued_data;
+
+/**
+ * Appends the given chunk to the queue of the given socket, blocking first
+ * if the queue lacks space. The queue lock must NOT be held by the caller.
+ *
+ * @param data
+ *     The queued socket data whose queue should receive the chunk.
+ *
+ * @param chunk
+ *     The chunk to append. Ownership of the chunk (and its buffer) passes to
+ *     the queue on success.
+ *
+ * @return
+ *     Zero if the chunk was successfully queued, non-zero if the socket is
+ *     in an error state or space did not become available within
+ *     GUAC_SOCKET_QUEUED_TIMEOUT milliseconds.
+ */
+static int guac_socket_queued_enqueue(guac_socket_queued_data* data,
+        guac_socket_queued_chunk* chunk) {
+
+    pthread_mutex_lock(&(data->queue_lock));
+
+    /* Wait for space in queue, giving up (and dropping the connection into a
+     * permanent error state) if the writer thread cannot catch up in a
+     * reasonable amount of time */
+    while (!data->write_error && !data->shutting_down
+            && data->queued_bytes + chunk->length
+                > GUAC_SOCKET_QUEUED_MAX_BYTES) {
+
+        struct timespec timeout;
+        clock_gettime(CLOCK_REALTIME, &timeout);
+        timeout.tv_sec  += GUAC_SOCKET_QUEUED_TIMEOUT / 1000;
+        timeout.tv_nsec += (GUAC_SOCKET_QUEUED_TIMEOUT % 1000) * 1000000L;
+        if (timeout.tv_nsec >= 1000000000L) {
+            timeout.tv_sec++;
+            timeout.tv_nsec -= 1000000000L;
+        }
+
+        if (pthread_cond_timedwait(&(data->queue_modified),
+                    &(data->queue_lock), &timeout) != 0) {
+            data->write_error = 1;
+            break;
+        }
+
+    }
+
+    /* Refuse to queue anything further once an error has occurred */
+    if (data->write_error || data->shutting_down) {
+        pthread_mutex_unlock(&(data->queue_lock));
+        guac_error = GUAC_STATUS_BUSY;
+        guac_error_message = "Output queue of lagging connection is full";
+        return 1;
+    }
+
+    /* Append chunk to queue */
+    chunk->next = NULL;
+    if (data->tail != NULL)
+        data->tail->next = chunk;
+    else
+        data->head = chunk;
+    data->tail = chunk;
+    data->queued_bytes += chunk->length;
+
+    pthread_cond_broadcast(&(data->queue_modified));
+    pthread_mutex_unlock(&(data->queue_lock));
+    return 0;
+
+}
+
+/**
+ * The main loop of the dedicated writer thread, which removes chunks from
+ * the queue and writes them to the underlying socket until the socket is
+ * freed and the queue is drained.
+ *
+ * @param arg
+ *     A pointer to the guac_socket_queued_data of the socket served by this
+ *     thread.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guac_socket_queued_writer_thread(void* arg) {
+
+    guac_socket_queued_data* data = (guac_socket_queued_data*) arg;
+
+    pthread_mutex_lock(&(data->queue_lock));
+    for (;;) {
+
+        /* Wait for work (or shutdown) */
+        while (data->head == NULL && !data->shutting_down)
+            pthread_cond_wait(&(data->queue_modified), &(data->queue_lock));
+
+        /* Terminate once the queue is fully drained and the socket is being
+         * freed */
+        if (data->head == NULL)
+            break;
+
+        /* Remove next chunk from queue */
+        guac_socket_queued_chunk* chunk = data->head;
+        data->head = chunk->next;
+        if (data->head == NULL)
+            data->tail = NULL;
+        data->queued_bytes -= chunk->length;
+
+        pthread_cond_broadcast(&(data->queue_modified));
+        pthread_mutex_unlock(&(data->queue_lock));
+
+        /* Perform the actual I/O without holding the queue lock. Chunks
+         * beyond the first failure are silently discarded; the error will be
+         * reported to future writers */
+        if (!data->write_error) {
+
+            int failed;
+            if (chunk->shared != NULL)
+                failed = guac_socket_write(data->underlying,
+                        chunk->shared->buffer, chunk->shared->length) != 0;
+            else if (chunk->buffer != NULL)
+                failed = guac_socket_write(data->underlying, chunk->buffer,
+                        chunk->length) != 0;
+            else
+                failed = guac_socket_flush(data->underlying) != 0;
+
+            if (failed)
+                data->write_error = 1;
+
+        }
+
+        if (chunk->shared != NULL)
+            guac_socket_shared_buffer_unref(chunk->shared);
+
+        guac_mem_free(chunk->buffer);
+        guac_mem_free(chunk);
+
+        pthread_mutex_lock(&(data->queue_lock));
+
+    }
+    pthread_mutex_unlock(&(data->queue_lock));
+
+    return NULL;
+
+}
+
+/**
+ * Queues the contents of the pending instruction buffer (if any) as a single
+ * chunk. The socket lock must be held by the caller.
+ *
+ * @param data
+ *     The queued socket data whose pending instruction buffer should be
+ *     queued.
+ *
+ * @return
+ *     Zero if the pending data was successfully queued (or if there was no
+ *     pending data), non-zero otherwise.
+ */
+static int guac_socket_queued_commit_pending(guac_socket_queued_data* data) {
+
+    /* Nothing to do if no data is pending */
+    if (data->pending_length == 0)
+        return 0;
+
+    guac_socket_queued_chunk* chunk =
+        guac_mem_alloc(sizeof(guac_socket_queued_chunk));
+
+    /* Hand the accumulated buffer itself to the queue, leaving the pending
+     * buffer to be reallocated by the next write */
+    chunk->buffer = data->pending;
+    chunk->shared = NULL;
+    chunk->length = data->pending_length;
+
+    data->pending = NULL;
+    data->pending_length = 0;
+    data->pending_capacity = 0;
+
+    if (guac_socket_queued_enqueue(data, chunk)) {
+        guac_mem_free(chunk->buffer);
+        guac_mem_free(chunk);
+        return 1;
+    }
+
+    return 0;
+
+}
+
+/**
+ * Appends the given data to the pending instruction buffer of the given
+ * socket, which will be queued for writing once the current instruction is
+ * complete.
+ *
+ * @param socket
+ *     The guac_socket being written to.
+ *
+ * @param buf
+ *     The arbitrary buffer containing the data to be written.
+ *
+ * @param count
+ *     The number of bytes contained within the buffer.
+ *
+ * @return
+ *     The number of bytes written, or -1 if an error occurs.
+ */
+static ssize_t guac_socket_queued_write_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    guac_socket_queued_data* data = (guac_socket_queued_data*) socket->data;
+
+    /* Fail fast if the connection is already known to be broken */
+    if (data->write_error) {
+        guac_error = GUAC_STATUS_BUSY;
+        guac_error_message = "Output queue of lagging connection is full";
+        return -1;
+    }
+
+    /* Grow pending buffer as necessary */
+    if (data->pending_length + count > data->pending_capacity) {
+
+        size_t new_capacity = data->pending_capacity;
+        if (new_capacity == 0)
+            new_capacity = GUAC_SOCKET_OUTPUT_BUFFER_SIZE;
+
+        while (data->pending_length + count > new_capacity)
+            new_capacity = guac_mem_ckd_mul_or_die(new_capacity, 2);
+
+        data->pending = guac_mem_realloc_or_die(data->pending, new_capacity);
+        data->pending_capacity = new_capacity;
+
+    }
+
+    /* Append to pending instruction buffer */
+    memcpy(data->pending + data->pending_length, buf, count);
+    data->pending_length += count;
+
+    return count;
+
+}
+
+/**
+ * Queues the given shared buffer of pre-serialized instructions for writing,
+ * taking a reference to the buffer rather than copying its contents. As
+ * required by guac_socket_write_shared(), exclusive access to the socket must
+ * be held by the caller.
+ *
+ * @param socket
+ *     The guac_socket being written to.
+ *
+ * @param buf
+ *     The shared buffer to be written.
+ *
+ * @return
+ *     Zero on success, or non-zero if an error occurs.
+ */
+static ssize_t guac_socket_queued_write_shared_handler(guac_socket* socket,
+        guac_socket_shared_buffer* buf) {
+
+    guac_socket_queued_data* data = (guac_socket_queued_data*) socket->data;
+
+    /* Fail fast if the connection is already known to be broken */
+    if (data->write_error) {
+        guac_error = GUAC_STATUS_BUSY;
+        guac_error_message = "Output queue of lagging connection is full";
+        return -1;
+    }
+
+    /* Queue any earlier data written for the current instruction ahead of
+     * the shared buffer */
+    if (guac_socket_queued_commit_pending(data))
+        return -1;
+
+    /* Queue a chunk referencing the shared buffer, rather than copying its
+     * contents */
+    guac_socket_queued_chunk* chunk =
+        guac_mem_alloc(sizeof(guac_socket_queued_chunk));
+
+    chunk->buffer = NULL;
+    chunk->shared = buf;
+    chunk->length = buf->length;
+    guac_socket_shared_buffer_ref(buf);
+
+    if (guac_socket_queued_enqueue(data, chunk)) {
+        guac_socket_shared_buffer_unref(buf);
+        guac_mem_free(chunk);
+        return -1;
+    }
+
+    return 0;
+
+}
+
+/**
+ * Queues any pending instruction data, followed by a request that the
+ * underlying socket be flushed.
+ *
+ * @param socket
+ *     The guac_socket to flush.
+ *
+ * @return
+ *     Zero if the flush request was successfully queued, non-zero otherwise.
+ */
+static ssize_t guac_socket_queued_flush_handler(guac_socket* socket) {
+
+    guac_socket_queued_data* data = (guac_socket_queued_data*) socket->data;
+    int retval;
+
+    /* Serialize with any instruction currently being written */
+    pthread_mutex_lock(&(data->socket_lock));
+    retval = guac_socket_queued_commit_pending(data);
+    pthread_mutex_unlock(&(data->socket_lock));
+
+    if (retval)
+        return retval;
+
+    /* Queue flush request */
+    guac_socket_queued_chunk* chunk =
+        guac_mem_alloc(sizeof(guac_socket_queued_chunk));
+    chunk->buffer = NULL;
+    chunk->shared = NULL;
+    chunk->length = 0;
+
+    if (guac_socket_queued_enqueue(data, chunk)) {
+        guac_mem_free(chunk);
+        return 1;
+    }
+
+    return 0;
+
+}
+
+/**
+ * Passes read requests through to the underlying socket.
+ *
+ * @param socket
+ *     The guac_socket being read from.
+ *
+ * @param buf
+ *     The arbitrary buffer which we must populate with data.
+ *
+ * @param count
+ *     The maximum number of bytes to read into the buffer.
+ *
+ * @return
+ *     The number of bytes read, or -1 if an error occurs.
+ */
+static ssize_t guac_socket_queued_read_handler(guac_socket* socket,
+        void* buf, size_t count) {
+
+    guac_socket_queued_data* data = (guac_socket_queued_data*) socket->data;
+    return guac_socket_read(data->underlying, buf, count);
+
+}
+
+/**
+ * Passes select requests through to the underlying socket.
+ *
+ * @param socket
+ *     The guac_socket to wait for.
+ *
+ * @param usec_timeout
+ *     The maximum amount of time to wait for data, in microseconds, or -1 to
+ *     potentially wait forever.
+ *
+ * @return
+ *     A positive value on success, zero if the timeout elapsed and no data
+ *     is available, or a negative value if an error occurs.
+ */
+static int guac_socket_queued_select_handler(guac_socket* socket,
+        int usec_timeout) {
+
+    guac_socket_queued_data* data = (guac_socket_queued_data*) socket->data;
+    return guac_socket_select(data->underlying, usec_timeout);
+
+}
+
+/**
+ * Acquires exclusive access to the given socket, marking the beginning of a
+ * new instruction.
+ *
+ * @param socket
+ *     The guac_socket to which exclusive access is required.
+ */
+static void guac_socket_queued_lock_handler(guac_socket* socket) {
+
+    guac_socket_queued_data* data = (guac_socket_queued_data*) socket->data;
+
+    /* Acquire exclusive access to socket */
+    pthread_mutex_lock(&(data->socket_lock));
+
+}
+
+/**
+ * Queues the now-complete instruction for writing and relinquishes exclusive
+ * access to the given socket.
+ *
+ * @param socket
+ *     The guac_socket to which exclusive access is no longer required.
+ */
+static void guac_socket_queued_unlock_handler(guac_socket* socket) {
+
+    guac_socket_queued_data* data = (guac_socket_queued_data*) socket->data;
+
+    /* Queue the instruction which was just completed */
+    guac_socket_queued_commit_pending(data);
+
+    /* Relinquish exclusive access to socket */
+    pthread_mutex_unlock(&(data->socket_lock));
+
+}
+
+/**
+ * Frees all implementation-specific data associated with the given socket,
+ * but not the socket object itself, first waiting for the writer thread to
+ * drain any remaining queued data.
+ *
+ * @param socket
+ *     The guac_socket whose associated data should be freed.
+ *
+ * @return
+ *     Zero if the data was successfully freed, non-zero otherwise. This
+ *     implementation always succeeds, and will always return zero.
+ */
+static int guac_socket_queued_free_handler(guac_socket* socket) {
+
+    guac_socket_queued_data* data = (guac_socket_queued_data*) socket->data;
+
+    /* Queue any partially-written instruction (writers are gone by the time
+     * the socket is freed) */
+    pthread_mutex_lock(&(data->socket_lock));
+    guac_socket_queued_commit_pending(data);
+    pthread_mutex_unlock(&(data->socket_lock));
+
+    /* Signal writer thread to terminate once the queue is drained */
+    pthread_mutex_lock(&(data->queue_lock));
+    data->shutting_down = 1;
+    pthread_cond_broadcast(&(data->queue_modified));
+    pthread_mutex_unlock(&(data->queue_lock));
+
+    pthread_join(data->writer_thread, NULL);
+
+    /* Free any chunks which remain queued (possible only if an error
+     * occurred) */
+    guac_socket_queued_chunk* chunk = data->head;
+    while (chunk != NULL) {
+        guac_socket_queued_chunk* next = chunk->next;
+        if (chunk->shared != NULL)
+            guac_socket_shared_buffer_unref(chunk->shared);
+        guac_mem_free(chunk->buffer);
+        guac_mem_free(chunk);
+        chunk = next;
+    }
+
+    /* Free the wrapped socket */
+    guac_socket_free(data->underlying);
+
+    /* Destroy synchronization primitives */
+    pthread_mutex_destroy(&(data->socket_lock));
+    pthread_mutex_destroy(&(data->queue_lock));
+    pthread_cond_destroy(&(data->queue_modified));
+
+    guac_mem_free(data->pending);
+    guac_mem_free(data);
+    return 0;
+
+}
+
+guac_socket* guac_socket_queued(guac_socket* underlying) {
+
+    /* Allocate socket and associated data */
+    guac_socket* socket = guac_socket_alloc();
+    guac_socket_queued_data* data =
+        guac_mem_zalloc(sizeof(guac_socket_queued_data));
+
+    data->underlying = underlying;
+    socket->data = data;
+
+    /* Init locks and condition */
+    pthread_mutex_init(&(data->socket_lock), NULL);
+    pthread_mutex_init(&(data->queue_lock), NULL);
+    pthread_cond_init(&(data->queue_modified), NULL);
+
+    /* Start dedicated writer thread */
+    if (pthread_create(&(data->writer_thread), NULL,
+                guac_socket_queued_writer_thread, data)) {
+
+        guac_error = GUAC_STATUS_INTERNAL_ERROR;
+        guac_error_message = "Unable to start writer thread of queued socket";
+
+        pthread_mutex_destroy(&(data->socket_lock));
+        pthread_mutex_destroy(&(data->queue_lock));
+        pthread_cond_destroy(&(data->queue_modified));
+
+        guac_mem_free(data);
+        socket->data = NULL;
+        guac_socket_free(socket);
+        return NULL;
+
+    }
+
+    /* Set handlers */
+    socket->read_handler   = guac_socket_queued_read_handler;
+    socket->write_handler  = guac_socket_queued_write_handler;
+    socket->write_shared_handler = guac_socket_queued_write_shared_handler;
+    socket->select_handler = guac_socket_queued_select_handler;
+    socket->lock_handler   = guac_socket_queued_lock_handler;
+    socket->unlock_handler = guac_socket_queued_unlock_handler;
+    socket->flush_handler  = guac_socket_queued_flush_handler;
+    socket->free_handler   = guac_socket_queued_free_handler;
+
+    return socket;
+
+}
@@ -27,6 +27,7 @@
 
 #include <pthread.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include <openssl/ssl.h>
 
@@ -68,6 +69,44 @@ static ssize_t __guac_socket_ssl_write_handler(guac_socket* socket,
 
 }
 
+#ifdef SSL_OP_ENABLE_KTLS
+/**
+ * Writes data directly to the file descriptor underlying the given secure
+ * socket. This handler is used in place of __guac_socket_ssl_write_handler()
+ * when the kernel has accepted the negotiated TLS keys (kTLS), in which case
+ * the kernel encrypts written data itself and userspace OpenSSL (and its
+ * buffer copies) can be bypassed entirely on the write path.
+ *
+ * @param socket
+ *     The guac_socket being written to.
+ *
+ * @param buf
+ *     The buffer of data to write.
+ *
+ * @param count
+ *     The number of bytes within the given buffer.
+ *
+ * @return
+ *     The number of bytes written, or a negative value if an error occurs.
+ */
+static ssize_t __guac_socket_ssl_ktls_write_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    guac_socket_ssl_data* data = (guac_socket_ssl_data*) socket->data;
+
+    int retval = write(data->fd, buf, count);
+
+    /* Record errors in guac_error */
+    if (retval < 0) {
+        guac_error = GUAC_STATUS_SEE_ERRNO;
+        guac_error_message = "Error writing data to secure socket";
+    }
+
+    return retval;
+
+}
+#endif
+
 static int __guac_socket_ssl_select_handler(guac_socket* socket, int usec_timeout) {
 
     guac_socket_ssl_data* data = (guac_socket_ssl_data*) socket->data;
@@ -150,6 +189,13 @@ guac_socket* guac_socket_open_secure(SSL_CTX* context, int fd) {
     data->ssl = ssl;
     SSL_set_fd(data->ssl, fd);
 
+#ifdef SSL_OP_ENABLE_KTLS
+    /* Request that the negotiated keys be pushed into the kernel (kTLS) once
+     * the handshake completes, if supported by both OpenSSL and the running
+     * kernel (this is purely advisory and has no effect if unsupported) */
+    SSL_set_options(ssl, SSL_OP_ENABLE_KTLS);
+#endif
+
     /* Accept SSL connection, handle errors */
     if (SSL_accept(ssl) <= 0) {
 
@@ -179,6 +225,17 @@ guac_socket* guac_socket_open_secure(SSL_CTX* context, int fd) {
     socket->lock_handler   = __guac_socket_ssl_lock_handler;
     socket->unlock_handler = __guac_socket_ssl_unlock_handler;
 
+#ifdef SSL_OP_ENABLE_KTLS
+    /* If the kernel accepted the negotiated keys for the send direction,
+     * write directly to the file descriptor, bypassing userspace encryption
+     * and its buffer copies entirely. Reads intentionally remain with
+     * SSL_read() such that post-handshake control records (key updates,
+     * alerts, etc.) are still processed by OpenSSL; received application data
+     * is decrypted by the kernel regardless. */
+    if (BIO_get_ktls_send(SSL_get_wbio(ssl)))
+        socket->write_handler = __guac_socket_ssl_ktls_write_handler;
+#endif
+
     return socket;
 
 }
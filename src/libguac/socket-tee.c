@@ -19,10 +19,14 @@
 
 #include "config.h"
 
+#include "guacamole/error.h"
+#include "guacamole/fifo.h"
 #include "guacamole/mem.h"
 #include "guacamole/socket.h"
 
+#include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
 
 /**
  * Data specific to the tee implementation of guac_socket.
@@ -232,3 +236,539 @@ guac_socket* guac_socket_tee(guac_socket* primary, guac_socket* secondary) {
 
 }
 
+/**
+ * The maximum number of spooled items to remove and process in one pass of
+ * the drain thread of an asynchronous tee socket. Flush requests within a
+ * single pass are coalesced into at most one flush of the secondary socket.
+ */
+#define GUAC_SOCKET_TEE_SPOOL_BATCH 32
+
+/**
+ * A spooled item represents data to be written to the secondary socket.
+ */
+#define GUAC_SOCKET_TEE_SPOOL_DATA 0
+
+/**
+ * A spooled item represents a request that the secondary socket be flushed.
+ */
+#define GUAC_SOCKET_TEE_SPOOL_FLUSH 1
+
+/**
+ * A spooled item represents a request that the drain thread terminate. The
+ * socket is being freed, and no further items will follow.
+ */
+#define GUAC_SOCKET_TEE_SPOOL_SHUTDOWN 2
+
+/**
+ * A single unit of work spooled for the drain thread of an asynchronous tee
+ * socket: data to be written to the secondary socket, a request that the
+ * secondary socket be flushed, or a request that the drain thread terminate.
+ */
+typedef struct guac_socket_tee_spool_item {
+
+    /**
+     * The data to be written, or NULL if this item instead references a
+     * shared buffer or does not carry data at all.
+     */
+    char* buffer;
+
+    /**
+     * The shared, reference-counted buffer to be written, or NULL if this
+     * item instead owns its data directly (or does not carry data at all).
+     * The reference held by this item is released once the item has been
+     * processed.
+     */
+    guac_socket_shared_buffer* shared;
+
+    /**
+     * The number of bytes to be written, if this item carries data.
+     */
+    size_t length;
+
+    /**
+     * The type of this item (one of GUAC_SOCKET_TEE_SPOOL_DATA,
+     * GUAC_SOCKET_TEE_SPOOL_FLUSH, or GUAC_SOCKET_TEE_SPOOL_SHUTDOWN).
+     */
+    int type;
+
+} guac_socket_tee_spool_item;
+
+/**
+ * Data specific to the asynchronous tee implementation of guac_socket.
+ */
+typedef struct guac_socket_tee_async_data {
+
+    /**
+     * The guac_socket to which all socket operations should be delegated.
+     */
+    guac_socket* primary;
+
+    /**
+     * The guac_socket to which all write and flush operations should be
+     * duplicated, asynchronously, by the drain thread.
+     */
+    guac_socket* secondary;
+
+    /**
+     * Lock-free spool of items awaiting processing by the drain thread.
+     * Writers add items without ever blocking; if the spool is full, the
+     * secondary socket is abandoned instead.
+     */
+    guac_fifo spool;
+
+    /**
+     * Storage for the items of the spool.
+     */
+    guac_socket_tee_spool_item items[GUAC_SOCKET_TEE_SPOOL_SIZE];
+
+    /**
+     * Non-zero if the secondary socket has been abandoned, whether because a
+     * write to that socket failed or because the spool overflowed. Once set,
+     * no further data is duplicated. This flag is written by both the drain
+     * thread and writers of the tee socket, but transitions only from zero
+     * to non-zero, and is consulted purely as an optimization (any race
+     * merely spools or writes slightly more data than necessary).
+     */
+    int secondary_error;
+
+    /**
+     * The dedicated thread which drains the spool, writing its contents to
+     * the secondary socket.
+     */
+    pthread_t drain_thread;
+
+} guac_socket_tee_async_data;
+
+/**
+ * Spools the given item for eventual processing by the drain thread. If the
+ * spool lacks space, the item is NOT spooled, and the secondary socket is
+ * instead permanently abandoned. This function never blocks.
+ *
+ * @param data
+ *     The asynchronous tee data whose spool should receive the item.
+ *
+ * @param item
+ *     The item to spool. Ownership of any buffer (or shared buffer
+ *     reference) held by the item passes to the spool on success. On
+ *     failure, ownership remains with the caller.
+ *
+ * @return
+ *     Zero if the item was successfully spooled, non-zero if the spool is
+ *     full and the secondary socket has been abandoned.
+ */
+static int __guac_socket_tee_async_spool(guac_socket_tee_async_data* data,
+        guac_socket_tee_spool_item* item) {
+
+    if (guac_fifo_try_enqueue(&data->spool, item))
+        return 0;
+
+    /* Abandon the secondary socket rather than ever make the primary wait
+     * for the drain thread to catch up */
+    data->secondary_error = 1;
+    return 1;
+
+}
+
+/**
+ * The main loop of the drain thread of an asynchronous tee socket, which
+ * removes spooled items in batches and applies them to the secondary socket
+ * until a shutdown request is received. All data within a batch is written
+ * back-to-back, and any flush requests within a batch are coalesced into a
+ * single flush performed after the last write of the batch.
+ *
+ * @param arg
+ *     A pointer to the guac_socket_tee_async_data of the socket served by
+ *     this thread.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* __guac_socket_tee_async_drain_thread(void* arg) {
+
+    guac_socket_tee_async_data* data = (guac_socket_tee_async_data*) arg;
+
+    for (;;) {
+
+        guac_socket_tee_spool_item items[GUAC_SOCKET_TEE_SPOOL_BATCH];
+        int count = guac_fifo_dequeue_batch(&data->spool, items,
+                GUAC_SOCKET_TEE_SPOOL_BATCH);
+
+        /* Bail out entirely if the spool has somehow been invalidated (the
+         * spool outlives this thread in all normal shutdown paths) */
+        if (count == 0)
+            return NULL;
+
+        int pending_flush = 0;
+        int shutting_down = 0;
+
+        for (int i = 0; i < count; i++) {
+
+            guac_socket_tee_spool_item* item = &items[i];
+            switch (item->type) {
+
+                /* Write spooled data, ignoring (but remembering) any
+                 * failure, as with the synchronous tee implementation */
+                case GUAC_SOCKET_TEE_SPOOL_DATA:
+
+                    if (!data->secondary_error) {
+
+                        const char* buffer = item->buffer;
+                        if (item->shared != NULL)
+                            buffer = item->shared->buffer;
+
+                        if (guac_socket_write(data->secondary, buffer,
+                                    item->length))
+                            data->secondary_error = 1;
+
+                    }
+
+                    if (item->shared != NULL)
+                        guac_socket_shared_buffer_unref(item->shared);
+
+                    guac_mem_free(item->buffer);
+                    break;
+
+                /* Defer flushes to the end of the batch, such that repeated
+                 * flushes of the tee socket coalesce into fewer (larger)
+                 * writes against the secondary socket */
+                case GUAC_SOCKET_TEE_SPOOL_FLUSH:
+                    pending_flush = 1;
+                    break;
+
+                /* Terminate only after processing the remainder of the
+                 * batch (no items can follow a shutdown request) */
+                case GUAC_SOCKET_TEE_SPOOL_SHUTDOWN:
+                default:
+                    shutting_down = 1;
+                    break;
+
+            }
+
+        }
+
+        /* Perform at most one flush per batch */
+        if (pending_flush && !data->secondary_error
+                && guac_socket_flush(data->secondary))
+            data->secondary_error = 1;
+
+        if (shutting_down)
+            return NULL;
+
+    }
+
+}
+
+/**
+ * Callback function which reads only from the primary socket.
+ *
+ * @param socket
+ *     The tee socket to read from.
+ *
+ * @param buf
+ *     The buffer to read data into.
+ *
+ * @param count
+ *     The maximum number of bytes to read into the given buffer.
+ *
+ * @return
+ *     The value returned by guac_socket_read() when invoked on the primary
+ *     socket with the given parameters.
+ */
+static ssize_t __guac_socket_tee_async_read_handler(guac_socket* socket,
+        void* buf, size_t count) {
+
+    guac_socket_tee_async_data* data =
+        (guac_socket_tee_async_data*) socket->data;
+
+    /* Delegate read to wrapped socket */
+    return guac_socket_read(data->primary, buf, count);
+
+}
+
+/**
+ * Callback function which writes the given data to the primary socket,
+ * spooling a copy of that data for asynchronous duplication to the secondary
+ * socket. The result of the write against the primary socket alone is
+ * returned, and the primary socket never waits on I/O performed against the
+ * secondary socket.
+ *
+ * @param socket
+ *     The tee socket to write through.
+ *
+ * @param buf
+ *     The buffer of data to write.
+ *
+ * @param count
+ *     The number of bytes in the buffer to be written.
+ *
+ * @return
+ *     The number of bytes written if the write was successful, or -1 if an
+ *     error occurs.
+ */
+static ssize_t __guac_socket_tee_async_write_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    guac_socket_tee_async_data* data =
+        (guac_socket_tee_async_data*) socket->data;
+
+    /* Spool a copy of the data for the drain thread (ignoring failure, as
+     * with the synchronous tee implementation) */
+    if (!data->secondary_error) {
+
+        guac_socket_tee_spool_item item = {
+            .buffer = guac_mem_alloc(count),
+            .shared = NULL,
+            .length = count,
+            .type   = GUAC_SOCKET_TEE_SPOOL_DATA
+        };
+
+        memcpy(item.buffer, buf, count);
+
+        if (__guac_socket_tee_async_spool(data, &item))
+            guac_mem_free(item.buffer);
+
+    }
+
+    /* Delegate write to wrapped socket */
+    if (guac_socket_write(data->primary, buf, count))
+        return -1;
+
+    /* All data written successfully */
+    return count;
+
+}
+
+/**
+ * Callback function which writes the given shared buffer to the primary
+ * socket, spooling an additional reference to that buffer for asynchronous
+ * duplication to the secondary socket. Unlike the plain write handler, no
+ * copy of the data is made. As required by guac_socket_write_shared(),
+ * exclusive access to the socket must be held by the caller.
+ *
+ * @param socket
+ *     The tee socket to write through.
+ *
+ * @param buf
+ *     The shared buffer to be written.
+ *
+ * @return
+ *     Zero if the write against the primary socket succeeded, or non-zero if
+ *     an error occurs.
+ */
+static ssize_t __guac_socket_tee_async_write_shared_handler(
+        guac_socket* socket, guac_socket_shared_buffer* buf) {
+
+    guac_socket_tee_async_data* data =
+        (guac_socket_tee_async_data*) socket->data;
+
+    /* Spool a reference to the shared buffer for the drain thread (ignoring
+     * failure, as with the synchronous tee implementation) */
+    if (!data->secondary_error) {
+
+        guac_socket_tee_spool_item item = {
+            .buffer = NULL,
+            .shared = buf,
+            .length = buf->length,
+            .type   = GUAC_SOCKET_TEE_SPOOL_DATA
+        };
+
+        guac_socket_shared_buffer_ref(buf);
+
+        if (__guac_socket_tee_async_spool(data, &item))
+            guac_socket_shared_buffer_unref(buf);
+
+    }
+
+    /* Delegate write to wrapped socket */
+    return guac_socket_write_shared(data->primary, buf);
+
+}
+
+/**
+ * Callback function which flushes the primary socket, spooling a request
+ * that the secondary socket eventually be flushed, as well. Only the result
+ * from the primary socket is returned.
+ *
+ * @param socket
+ *     The tee socket to flush.
+ *
+ * @return
+ *     The value returned by guac_socket_flush() when invoked on the primary
+ *     socket.
+ */
+static ssize_t __guac_socket_tee_async_flush_handler(guac_socket* socket) {
+
+    guac_socket_tee_async_data* data =
+        (guac_socket_tee_async_data*) socket->data;
+
+    /* Request asynchronous flush of secondary socket (ignoring failure) */
+    if (!data->secondary_error) {
+
+        guac_socket_tee_spool_item item = {
+            .buffer = NULL,
+            .shared = NULL,
+            .length = 0,
+            .type   = GUAC_SOCKET_TEE_SPOOL_FLUSH
+        };
+
+        __guac_socket_tee_async_spool(data, &item);
+
+    }
+
+    /* Delegate flush to wrapped socket */
+    return guac_socket_flush(data->primary);
+
+}
+
+/**
+ * Callback function which delegates the lock operation to the primary socket
+ * alone. The secondary socket is written only by the drain thread, and thus
+ * requires no locking by writers of the tee socket.
+ *
+ * @param socket
+ *     The tee socket on which guac_socket_instruction_begin() was invoked.
+ */
+static void __guac_socket_tee_async_lock_handler(guac_socket* socket) {
+
+    guac_socket_tee_async_data* data =
+        (guac_socket_tee_async_data*) socket->data;
+
+    /* Delegate lock to primary socket */
+    guac_socket_instruction_begin(data->primary);
+
+}
+
+/**
+ * Callback function which delegates the unlock operation to the primary
+ * socket alone.
+ *
+ * @param socket
+ *     The tee socket on which guac_socket_instruction_end() was invoked.
+ */
+static void __guac_socket_tee_async_unlock_handler(guac_socket* socket) {
+
+    guac_socket_tee_async_data* data =
+        (guac_socket_tee_async_data*) socket->data;
+
+    /* Delegate unlock to primary socket */
+    guac_socket_instruction_end(data->primary);
+
+}
+
+/**
+ * Callback function which delegates the select operation to the primary
+ * socket alone.
+ *
+ * @param socket
+ *     The tee socket on which guac_socket_select() was invoked.
+ *
+ * @param usec_timeout
+ *     The timeout to specify when invoking guac_socket_select() on the
+ *     primary socket.
+ *
+ * @return
+ *     The value returned by guac_socket_select() when invoked with the
+ *     given parameters on the primary socket.
+ */
+static int __guac_socket_tee_async_select_handler(guac_socket* socket,
+        int usec_timeout) {
+
+    guac_socket_tee_async_data* data =
+        (guac_socket_tee_async_data*) socket->data;
+
+    /* Delegate select to wrapped socket */
+    return guac_socket_select(data->primary, usec_timeout);
+
+}
+
+/**
+ * Callback function which frees all underlying data associated with the
+ * given asynchronous tee socket, including both primary and secondary
+ * sockets, first waiting for the drain thread to process any remaining
+ * spooled data.
+ *
+ * @param socket
+ *     The tee socket being freed.
+ *
+ * @return
+ *     Always zero.
+ */
+static int __guac_socket_tee_async_free_handler(guac_socket* socket) {
+
+    guac_socket_tee_async_data* data =
+        (guac_socket_tee_async_data*) socket->data;
+
+    /* Signal drain thread to terminate once the spool is empty. Waiting for
+     * spool space here is safe: writers are gone by the time the socket is
+     * freed, and the drain thread continues consuming items even after
+     * abandoning the secondary socket */
+    guac_socket_tee_spool_item item = {
+        .buffer = NULL,
+        .shared = NULL,
+        .length = 0,
+        .type   = GUAC_SOCKET_TEE_SPOOL_SHUTDOWN
+    };
+
+    if (!guac_fifo_enqueue(&data->spool, &item))
+        guac_fifo_invalidate(&data->spool);
+
+    pthread_join(data->drain_thread, NULL);
+    guac_fifo_destroy(&data->spool);
+
+    /* Free underlying sockets */
+    guac_socket_free(data->primary);
+    guac_socket_free(data->secondary);
+
+    /* Freeing the tee socket always succeeds */
+    guac_mem_free(data);
+    return 0;
+
+}
+
+guac_socket* guac_socket_tee_async(guac_socket* primary,
+        guac_socket* secondary) {
+
+    /* Set up socket to split out into a file, spooling the duplicated data
+     * rather than writing it inline */
+    guac_socket_tee_async_data* data =
+        guac_mem_alloc(sizeof(guac_socket_tee_async_data));
+
+    data->primary = primary;
+    data->secondary = secondary;
+    data->secondary_error = 0;
+
+    guac_fifo_init_lockfree(&data->spool, data->items,
+            GUAC_SOCKET_TEE_SPOOL_SIZE, sizeof(guac_socket_tee_spool_item));
+
+    /* Start dedicated drain thread */
+    if (pthread_create(&data->drain_thread, NULL,
+                __guac_socket_tee_async_drain_thread, data)) {
+
+        guac_error = GUAC_STATUS_INTERNAL_ERROR;
+        guac_error_message = "Unable to start drain thread of tee socket";
+
+        guac_fifo_invalidate(&data->spool);
+        guac_fifo_destroy(&data->spool);
+        guac_mem_free(data);
+        return NULL;
+
+    }
+
+    /* Associate tee-specific data with new socket */
+    guac_socket* socket = guac_socket_alloc();
+    socket->data = data;
+
+    /* Assign handlers */
+    socket->read_handler   = __guac_socket_tee_async_read_handler;
+    socket->write_handler  = __guac_socket_tee_async_write_handler;
+    socket->write_shared_handler = __guac_socket_tee_async_write_shared_handler;
+    socket->select_handler = __guac_socket_tee_async_select_handler;
+    socket->flush_handler  = __guac_socket_tee_async_flush_handler;
+    socket->lock_handler   = __guac_socket_tee_async_lock_handler;
+    socket->unlock_handler = __guac_socket_tee_async_unlock_handler;
+    socket->free_handler   = __guac_socket_tee_async_free_handler;
+
+    return socket;
+
+}
+
@@ -0,0 +1,582 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "guacamole/mem.h"
+#include "guacamole/error.h"
+#include "guacamole/socket.h"
+#include "guacamole/socket-uring.h"
+#include "wait-fd.h"
+
+#include <liburing.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/**
+ * The number of write buffers registered with the io_uring of each socket.
+ * Writing threads block only if all of these buffers are in flight, so this
+ * bounds the amount of data which may be buffered ahead of a slow connection.
+ */
+#define GUAC_SOCKET_URING_BUFFER_POOL_SIZE 8
+
+/**
+ * The number of submission queue entries requested for the io_uring of each
+ * socket. As at most one write is in flight at any time, this needs only
+ * minimal headroom.
+ */
+#define GUAC_SOCKET_URING_QUEUE_DEPTH 8
+
+/**
+ * Data associated with an open socket which submits writes asynchronously to
+ * a file descriptor through io_uring.
+ *
+ * Buffers are filled and submitted strictly in round-robin order, and at most
+ * one write is in flight at any time, guaranteeing that data reaches the file
+ * descriptor in the order it was written to the socket.
+ */
+typedef struct guac_socket_uring_data {
+
+    /**
+     * The associated file descriptor.
+     */
+    int fd;
+
+    /**
+     * The io_uring through which all writes are submitted.
+     */
+    struct io_uring ring;
+
+    /**
+     * The pool of write buffers, registered with the io_uring as fixed
+     * buffers.
+     */
+    char buffers[GUAC_SOCKET_URING_BUFFER_POOL_SIZE][GUAC_SOCKET_OUTPUT_BUFFER_SIZE];
+
+    /**
+     * The number of bytes filled within each buffer of the pool.
+     */
+    int lengths[GUAC_SOCKET_URING_BUFFER_POOL_SIZE];
+
+    /**
+     * The index of the buffer currently being filled by writes to the socket.
+     */
+    int fill_index;
+
+    /**
+     * The index of the oldest buffer which has been handed off for writing
+     * (submitted, or queued behind the current in-flight write) but whose
+     * completion has not yet been reaped. Meaningful only if queued is
+     * non-zero.
+     */
+    int head_index;
+
+    /**
+     * The number of buffers which have been handed off for writing but whose
+     * completions have not yet been reaped, including the in-flight buffer.
+     */
+    int queued;
+
+    /**
+     * The number of bytes of the in-flight buffer which have already been
+     * written by previously-completed (short) writes.
+     */
+    int in_flight_offset;
+
+    /**
+     * Whether a write is currently in flight.
+     */
+    int in_flight;
+
+    /**
+     * Non-zero if a previously-submitted write has failed. Once a write
+     * fails, all subsequent writes and flushes fail immediately.
+     */
+    int write_error;
+
+    /**
+     * Lock which is acquired when an instruction is being written, and
+     * released when the instruction is finished being written.
+     */
+    pthread_mutex_t socket_lock;
+
+    /**
+     * Lock which protects access to the buffer pool and io_uring of this
+     * socket, guaranteeing atomicity of writes and flushes.
+     */
+    pthread_mutex_t buffer_lock;
+
+} guac_socket_uring_data;
+
+/**
+ * Submits a write of the buffer at head_index, beginning at
+ * in_flight_offset, marking that buffer as in flight. The buffer lock must
+ * be held.
+ *
+ * @param data
+ *     The io_uring socket data whose head buffer should be submitted.
+ *
+ * @return
+ *     Zero if the write was successfully submitted, non-zero otherwise.
+ */
+static int guac_socket_uring_submit_head(guac_socket_uring_data* data) {
+
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&data->ring);
+    if (sqe == NULL) {
+        guac_error = GUAC_STATUS_INTERNAL_ERROR;
+        guac_error_message = "Submission queue of io_uring socket exhausted";
+        return 1;
+    }
+
+    io_uring_prep_write_fixed(sqe, data->fd,
+            data->buffers[data->head_index] + data->in_flight_offset,
+            data->lengths[data->head_index] - data->in_flight_offset,
+            0, data->head_index);
+
+    if (io_uring_submit(&data->ring) < 0) {
+        guac_error = GUAC_STATUS_SEE_ERRNO;
+        guac_error_message = "Unable to submit write to io_uring";
+        return 1;
+    }
+
+    data->in_flight = 1;
+    return 0;
+
+}
+
+/**
+ * Processes a single completion from the io_uring of the given socket,
+ * recycling the completed buffer and submitting the next queued buffer, if
+ * any. Short writes are resubmitted for their remainder. The buffer lock
+ * must be held.
+ *
+ * @param data
+ *     The io_uring socket data whose completions should be processed.
+ *
+ * @param wait
+ *     Non-zero if this function should block until a completion is
+ *     available, or zero to return immediately if none is pending.
+ *
+ * @return
+ *     Zero if a completion was successfully processed or if no completion
+ *     was pending and wait was zero, non-zero if an error occurs.
+ */
+static int guac_socket_uring_reap(guac_socket_uring_data* data, int wait) {
+
+    struct io_uring_cqe* cqe;
+    int retval;
+
+    if (!data->in_flight)
+        return 0;
+
+    /* Retrieve next completion, blocking only if requested */
+    if (wait)
+        retval = io_uring_wait_cqe(&data->ring, &cqe);
+    else {
+        retval = io_uring_peek_cqe(&data->ring, &cqe);
+        if (retval == -EAGAIN)
+            return 0;
+    }
+
+    if (retval < 0) {
+        guac_error = GUAC_STATUS_SEE_ERRNO;
+        guac_error_message = "Unable to retrieve io_uring completion";
+        return 1;
+    }
+
+    retval = cqe->res;
+    io_uring_cqe_seen(&data->ring, cqe);
+    data->in_flight = 0;
+
+    /* Record errors, aborting all future writes */
+    if (retval < 0) {
+        data->write_error = 1;
+        guac_error = GUAC_STATUS_SEE_ERRNO;
+        guac_error_message = "Error writing data to socket";
+        return 1;
+    }
+
+    /* Resubmit remainder of buffer if write was short */
+    data->in_flight_offset += retval;
+    if (data->in_flight_offset < data->lengths[data->head_index])
+        return guac_socket_uring_submit_head(data);
+
+    /* Buffer is fully written and may be recycled */
+    data->lengths[data->head_index] = 0;
+    data->in_flight_offset = 0;
+    data->head_index = (data->head_index + 1)
+        % GUAC_SOCKET_URING_BUFFER_POOL_SIZE;
+    data->queued--;
+
+    /* Begin writing next queued buffer, if any */
+    if (data->queued > 0)
+        return guac_socket_uring_submit_head(data);
+
+    return 0;
+
+}
+
+/**
+ * Hands off the buffer currently being filled for asynchronous writing,
+ * advancing fill_index to the next buffer of the pool and blocking until a
+ * buffer is available if the entire pool is pending. The buffer lock must be
+ * held.
+ *
+ * @param data
+ *     The io_uring socket data whose current buffer should be handed off.
+ *
+ * @return
+ *     Zero if the buffer was successfully handed off, non-zero otherwise.
+ */
+static int guac_socket_uring_queue_buffer(guac_socket_uring_data* data) {
+
+    /* Ignore empty buffers */
+    if (data->lengths[data->fill_index] == 0)
+        return 0;
+
+    data->queued++;
+
+    /* Begin writing immediately if no write is in flight */
+    if (!data->in_flight && guac_socket_uring_submit_head(data))
+        return 1;
+
+    data->fill_index = (data->fill_index + 1)
+        % GUAC_SOCKET_URING_BUFFER_POOL_SIZE;
+
+    /* If the entire pool is now pending, block until the oldest write
+     * completes */
+    while (data->queued == GUAC_SOCKET_URING_BUFFER_POOL_SIZE) {
+        if (guac_socket_uring_reap(data, 1))
+            return 1;
+    }
+
+    return 0;
+
+}
+
+/**
+ * Appends the provided data to the buffer pool for future asynchronous
+ * writing, handing off buffers for submission as they fill.
+ *
+ * @param socket
+ *     The guac_socket being written to.
+ *
+ * @param buf
+ *     The arbitrary buffer containing the data to be written.
+ *
+ * @param count
+ *     The number of bytes contained within the buffer.
+ *
+ * @return
+ *     The number of bytes written, or -1 if an error occurs.
+ */
+static ssize_t guac_socket_uring_write_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    guac_socket_uring_data* data = (guac_socket_uring_data*) socket->data;
+    size_t original_count = count;
+    const char* current = buf;
+
+    pthread_mutex_lock(&(data->buffer_lock));
+
+    /* Opportunistically reap any completions which have already arrived */
+    if (data->write_error || guac_socket_uring_reap(data, 0)) {
+        pthread_mutex_unlock(&(data->buffer_lock));
+        return -1;
+    }
+
+    /* Append to current buffer, handing off full buffers for submission */
+    while (count > 0) {
+
+        int chunk_size;
+        int remaining = GUAC_SOCKET_OUTPUT_BUFFER_SIZE
+            - data->lengths[data->fill_index];
+
+        /* If no space left in current buffer, hand it off and retry */
+        if (remaining == 0) {
+
+            if (guac_socket_uring_queue_buffer(data)) {
+                pthread_mutex_unlock(&(data->buffer_lock));
+                return -1;
+            }
+
+            continue;
+
+        }
+
+        /* Calculate size of chunk to be written to buffer */
+        chunk_size = count;
+        if (chunk_size > remaining)
+            chunk_size = remaining;
+
+        /* Update current buffer */
+        memcpy(data->buffers[data->fill_index]
+                + data->lengths[data->fill_index], current, chunk_size);
+        data->lengths[data->fill_index] += chunk_size;
+
+        /* Update provided buffer */
+        current += chunk_size;
+        count   -= chunk_size;
+
+    }
+
+    pthread_mutex_unlock(&(data->buffer_lock));
+    return original_count;
+
+}
+
+/**
+ * Hands off all buffered data for asynchronous writing. Unlike the flush
+ * handler of the file descriptor implementation of guac_socket, this does
+ * not wait for the data to reach the file descriptor; it guarantees only
+ * that the data will be written without further action by the caller.
+ *
+ * @param socket
+ *     The guac_socket to flush.
+ *
+ * @return
+ *     Zero if the flush operation was successful, non-zero otherwise.
+ */
+static ssize_t guac_socket_uring_flush_handler(guac_socket* socket) {
+
+    guac_socket_uring_data* data = (guac_socket_uring_data*) socket->data;
+    int retval;
+
+    pthread_mutex_lock(&(data->buffer_lock));
+
+    /* Opportunistically reap any completions which have already arrived */
+    if (data->write_error || guac_socket_uring_reap(data, 0)) {
+        pthread_mutex_unlock(&(data->buffer_lock));
+        return 1;
+    }
+
+    retval = guac_socket_uring_queue_buffer(data);
+
+    pthread_mutex_unlock(&(data->buffer_lock));
+    return retval;
+
+}
+
+/**
+ * Attempts to read from the underlying file descriptor of the given
+ * guac_socket, populating the given buffer. Reads are synchronous, exactly
+ * as with the file descriptor implementation of guac_socket.
+ *
+ * @param socket
+ *     The guac_socket being read from.
+ *
+ * @param buf
+ *     The arbitrary buffer which we must populate with data.
+ *
+ * @param count
+ *     The maximum number of bytes to read into the buffer.
+ *
+ * @return
+ *     The number of bytes read, or -1 if an error occurs.
+ */
+static ssize_t guac_socket_uring_read_handler(guac_socket* socket,
+        void* buf, size_t count) {
+
+    guac_socket_uring_data* data = (guac_socket_uring_data*) socket->data;
+
+    int retval = read(data->fd, buf, count);
+
+    /* Record errors in guac_error */
+    if (retval < 0) {
+        guac_error = GUAC_STATUS_SEE_ERRNO;
+        guac_error_message = "Error reading data from socket";
+    }
+
+    return retval;
+
+}
+
+/**
+ * Waits for data on the underlying file descriptor of the given socket to
+ * become available such that the next read operation will not block.
+ *
+ * @param socket
+ *     The guac_socket to wait for.
+ *
+ * @param usec_timeout
+ *     The maximum amount of time to wait for data, in microseconds, or -1 to
+ *     potentially wait forever.
+ *
+ * @return
+ *     A positive value on success, zero if the timeout elapsed and no data is
+ *     available, or a negative value if an error occurs.
+ */
+static int guac_socket_uring_select_handler(guac_socket* socket,
+        int usec_timeout) {
+
+    guac_socket_uring_data* data = (guac_socket_uring_data*) socket->data;
+    int retval = guac_wait_for_fd(data->fd, usec_timeout);
+
+    /* Properly set guac_error */
+    if (retval <  0) {
+        guac_error = GUAC_STATUS_SEE_ERRNO;
+        guac_error_message = "Error while waiting for data on socket";
+    }
+
+    else if (retval == 0) {
+        guac_error = GUAC_STATUS_TIMEOUT;
+        guac_error_message = "Timeout while waiting for data on socket";
+    }
+
+    return retval;
+
+}
+
+/**
+ * Frees all implementation-specific data associated with the given socket,
+ * but not the socket object itself, waiting for all in-flight writes to
+ * complete beforehand.
+ *
+ * @param socket
+ *     The guac_socket whose associated data should be freed.
+ *
+ * @return
+ *     Zero if the data was successfully freed, non-zero otherwise. This
+ *     implementation always succeeds, and will always return zero.
+ */
+static int guac_socket_uring_free_handler(guac_socket* socket) {
+
+    guac_socket_uring_data* data = (guac_socket_uring_data*) socket->data;
+
+    /* Wait for all pending writes, ignoring any errors (the socket is being
+     * torn down regardless) */
+    while (data->queued > 0 && !data->write_error) {
+        if (guac_socket_uring_reap(data, 1))
+            break;
+    }
+
+    io_uring_queue_exit(&data->ring);
+
+    /* Destroy locks */
+    pthread_mutex_destroy(&(data->socket_lock));
+    pthread_mutex_destroy(&(data->buffer_lock));
+
+    /* Close file descriptor */
+    close(data->fd);
+
+    guac_mem_free(data);
+    return 0;
+
+}
+
+/**
+ * Acquires exclusive access to the given socket.
+ *
+ * @param socket
+ *     The guac_socket to which exclusive access is required.
+ */
+static void guac_socket_uring_lock_handler(guac_socket* socket) {
+
+    guac_socket_uring_data* data = (guac_socket_uring_data*) socket->data;
+
+    /* Acquire exclusive access to socket */
+    pthread_mutex_lock(&(data->socket_lock));
+
+}
+
+/**
+ * Relinquishes exclusive access to the given socket.
+ *
+ * @param socket
+ *     The guac_socket to which exclusive access is no longer required.
+ */
+static void guac_socket_uring_unlock_handler(guac_socket* socket) {
+
+    guac_socket_uring_data* data = (guac_socket_uring_data*) socket->data;
+
+    /* Relinquish exclusive access to socket */
+    pthread_mutex_unlock(&(data->socket_lock));
+
+}
+
+guac_socket* guac_socket_uring(int fd) {
+
+    pthread_mutexattr_t lock_attributes;
+    struct iovec iov[GUAC_SOCKET_URING_BUFFER_POOL_SIZE];
+    int i;
+
+    /* Allocate associated data */
+    guac_socket_uring_data* data =
+        guac_mem_zalloc(sizeof(guac_socket_uring_data));
+    if (data == NULL)
+        return NULL;
+
+    data->fd = fd;
+
+    /* Set up io_uring, failing cleanly if unsupported by the kernel */
+    if (io_uring_queue_init(GUAC_SOCKET_URING_QUEUE_DEPTH,
+                &data->ring, 0) < 0) {
+        guac_error = GUAC_STATUS_SEE_ERRNO;
+        guac_error_message = "Unable to set up io_uring";
+        guac_mem_free(data);
+        return NULL;
+    }
+
+    /* Register the buffer pool as fixed buffers */
+    for (i = 0; i < GUAC_SOCKET_URING_BUFFER_POOL_SIZE; i++) {
+        iov[i].iov_base = data->buffers[i];
+        iov[i].iov_len = GUAC_SOCKET_OUTPUT_BUFFER_SIZE;
+    }
+
+    if (io_uring_register_buffers(&data->ring, iov,
+                GUAC_SOCKET_URING_BUFFER_POOL_SIZE) < 0) {
+        guac_error = GUAC_STATUS_SEE_ERRNO;
+        guac_error_message = "Unable to register io_uring buffers";
+        io_uring_queue_exit(&data->ring);
+        guac_mem_free(data);
+        return NULL;
+    }
+
+    /* Allocate socket */
+    guac_socket* socket = guac_socket_alloc();
+    if (socket == NULL) {
+        io_uring_queue_exit(&data->ring);
+        guac_mem_free(data);
+        return NULL;
+    }
+
+    socket->data = data;
+
+    pthread_mutexattr_init(&lock_attributes);
+    pthread_mutexattr_setpshared(&lock_attributes, PTHREAD_PROCESS_SHARED);
+
+    /* Init locks */
+    pthread_mutex_init(&(data->socket_lock), &lock_attributes);
+    pthread_mutex_init(&(data->buffer_lock), &lock_attributes);
+
+    /* Set read/write handlers */
+    socket->read_handler   = guac_socket_uring_read_handler;
+    socket->write_handler  = guac_socket_uring_write_handler;
+    socket->select_handler = guac_socket_uring_select_handler;
+    socket->lock_handler   = guac_socket_uring_lock_handler;
+    socket->unlock_handler = guac_socket_uring_unlock_handler;
+    socket->flush_handler  = guac_socket_uring_flush_handler;
+    socket->free_handler   = guac_socket_uring_free_handler;
+
+    return socket;
+
+}
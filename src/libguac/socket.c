@@ -23,6 +23,7 @@
 #include "guacamole/error.h"
 #include "guacamole/protocol.h"
 #include "guacamole/socket.h"
+#include "guacamole/string.h"
 #include "guacamole/timestamp.h"
 
 #include <inttypes.h>
@@ -35,6 +36,14 @@
 #include <time.h>
 #include <unistd.h>
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#define GUAC_SOCKET_BASE64_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define GUAC_SOCKET_BASE64_NEON 1
+#include <arm_neon.h>
+#endif
+
 char __guac_socket_BASE64_CHARACTERS[64] = {
     'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O',
     'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z', 'a', 'b', 'c', 'd',
@@ -43,36 +52,132 @@ char __guac_socket_BASE64_CHARACTERS[64] = {
     '8', '9', '+', '/'
 };
 
+/**
+ * The process-wide registry of all sockets requiring automatic keep-alive.
+ * All registered sockets are serviced by a single shared thread, rather than
+ * a dedicated thread per socket.
+ */
+typedef struct guac_socket_keep_alive_registry {
+
+    /**
+     * Whether the shared keep-alive thread has been started. The thread is
+     * started when the first socket is registered and runs (detached) for the
+     * remaining life of the process, sleeping whenever the registry is empty.
+     */
+    int started;
+
+    /**
+     * The head of the linked list of all registered sockets, or NULL if no
+     * sockets are currently registered.
+     */
+    guac_socket* sockets;
+
+    /**
+     * Lock which protects multi-threaded access to this entire registry,
+     * including the condition used to signal registration changes.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Condition which is signalled whenever a socket is registered, waking
+     * the keep-alive thread if it is sleeping on an empty registry.
+     */
+    pthread_cond_t changed;
+
+} guac_socket_keep_alive_registry;
+
+/**
+ * Statically-allocated, shared registry of all sockets requiring automatic
+ * keep-alive.
+ */
+static guac_socket_keep_alive_registry __guac_socket_keep_alive = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .changed = PTHREAD_COND_INITIALIZER
+};
+
+/**
+ * Removes the given socket from the keep-alive registry, if registered. This
+ * function must be invoked only while the registry lock is held.
+ *
+ * @param socket
+ *     The socket to remove from the keep-alive registry.
+ */
+static void __guac_socket_keep_alive_remove(guac_socket* socket) {
+
+    guac_socket** current = &__guac_socket_keep_alive.sockets;
+    while (*current != NULL) {
+
+        if (*current == socket) {
+            *current = socket->__keep_alive_next;
+            socket->__keep_alive_next = NULL;
+            return;
+        }
+
+        current = &(*current)->__keep_alive_next;
+
+    }
+
+}
+
+/**
+ * The single shared thread which services keep-alive for all registered
+ * sockets, sending a periodic NOP over any socket that has been idle for
+ * longer than the keep-alive interval. Sockets whose keep-alive sends fail
+ * are removed from the registry (the underlying connection is already dead
+ * and will be cleaned up by its owner).
+ *
+ * @param data
+ *     Unused.
+ *
+ * @return
+ *     Always NULL.
+ */
 static void* __guac_socket_keep_alive_thread(void* data) {
 
-    int old_cancelstate;
+    pthread_mutex_lock(&__guac_socket_keep_alive.lock);
+    for (;;) {
 
-    /* Calculate sleep interval */
-    struct timespec interval;
-    interval.tv_sec  =  GUAC_SOCKET_KEEP_ALIVE_INTERVAL / 1000;
-    interval.tv_nsec = (GUAC_SOCKET_KEEP_ALIVE_INTERVAL % 1000) * 1000000L;
+        /* Sleep (released lock) until a socket is registered */
+        while (__guac_socket_keep_alive.sockets == NULL)
+            pthread_cond_wait(&__guac_socket_keep_alive.changed,
+                    &__guac_socket_keep_alive.lock);
 
-    /* Socket keep-alive loop */
-    guac_socket* socket = (guac_socket*) data;
-    while (socket->state == GUAC_SOCKET_OPEN) {
+        /* Send NOP keep-alive over each registered socket for which it's
+         * been a while since the last output */
+        guac_timestamp timestamp = guac_timestamp_current_coarse();
+        guac_socket* socket = __guac_socket_keep_alive.sockets;
+        while (socket != NULL) {
 
-        /* Send NOP keep-alive if it's been a while since the last output */
-        guac_timestamp timestamp = guac_timestamp_current();
-        if (timestamp - socket->last_write_timestamp >
-                GUAC_SOCKET_KEEP_ALIVE_INTERVAL) {
+            guac_socket* next = socket->__keep_alive_next;
 
-            /* Send NOP */
-            if (guac_protocol_send_nop(socket)
-                || guac_socket_flush(socket))
-                break;
+            if (socket->state == GUAC_SOCKET_OPEN
+                    && timestamp - socket->last_write_timestamp >
+                        GUAC_SOCKET_KEEP_ALIVE_INTERVAL) {
 
+                /* Send NOP, ceasing keep-alive for the socket if the send
+                 * fails */
+                if (guac_protocol_send_nop(socket)
+                    || guac_socket_flush(socket))
+                    __guac_socket_keep_alive_remove(socket);
+
+            }
+
+            socket = next;
+
+        }
+
+        /* Sleep (released lock) until the next keep-alive check */
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec  += GUAC_SOCKET_KEEP_ALIVE_INTERVAL / 1000;
+        deadline.tv_nsec += (GUAC_SOCKET_KEEP_ALIVE_INTERVAL % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
         }
 
-        /* Sleep until next keep-alive check, but allow thread cancellation
-         * during that sleep */
-        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
-        nanosleep(&interval, NULL);
-        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
+        pthread_cond_timedwait(&__guac_socket_keep_alive.changed,
+                &__guac_socket_keep_alive.lock, &deadline);
 
     }
 
@@ -83,12 +188,25 @@ static void* __guac_socket_keep_alive_thread(void* data) {
 static ssize_t __guac_socket_write(guac_socket* socket,
         const void* buf, size_t count) {
 
-    /* Update timestamp of last write */
-    socket->last_write_timestamp = guac_timestamp_current();
+    /* Update timestamp of last write (the coarse time source is used here,
+     * as this function runs for every chunk of output and the timestamp is
+     * only ever compared against multi-second keep-alive thresholds) */
+    socket->last_write_timestamp = guac_timestamp_current_coarse();
 
     /* If handler defined, call it. */
-    if (socket->write_handler)
-        return socket->write_handler(socket, buf, count);
+    if (socket->write_handler) {
+
+        ssize_t retval = socket->write_handler(socket, buf, count);
+
+        /* Record any time spent blocked on the underlying transport (writes
+         * that complete without blocking will not advance the clock by a
+         * measurable amount) */
+        socket->__write_stall_ms += guac_timestamp_current_coarse()
+            - socket->last_write_timestamp;
+
+        return retval;
+
+    }
 
     /* Otherwise, pretend everything was written. */
     return count;
@@ -118,6 +236,64 @@ ssize_t guac_socket_write(guac_socket* socket,
 
 }
 
+guac_socket_shared_buffer* guac_socket_shared_buffer_alloc(char* buffer,
+        size_t length) {
+
+    guac_socket_shared_buffer* buf =
+        guac_mem_alloc(sizeof(guac_socket_shared_buffer));
+
+    buf->buffer = buffer;
+    buf->length = length;
+    buf->refs = 1;
+    pthread_mutex_init(&(buf->lock), NULL);
+
+    return buf;
+
+}
+
+void guac_socket_shared_buffer_ref(guac_socket_shared_buffer* buf) {
+    pthread_mutex_lock(&(buf->lock));
+    buf->refs++;
+    pthread_mutex_unlock(&(buf->lock));
+}
+
+void guac_socket_shared_buffer_unref(guac_socket_shared_buffer* buf) {
+
+    pthread_mutex_lock(&(buf->lock));
+    unsigned int remaining = --buf->refs;
+    pthread_mutex_unlock(&(buf->lock));
+
+    /* Free the buffer once the last reference has been released */
+    if (remaining == 0) {
+        pthread_mutex_destroy(&(buf->lock));
+        guac_mem_free(buf->buffer);
+        guac_mem_free(buf);
+    }
+
+}
+
+ssize_t guac_socket_write_shared(guac_socket* socket,
+        guac_socket_shared_buffer* buf) {
+
+    /* Sockets which support queueing output by reference take a reference to
+     * the shared buffer rather than copy its contents */
+    if (socket->write_shared_handler) {
+
+        /* Track time spent blocked, exactly as for normal writes */
+        socket->last_write_timestamp = guac_timestamp_current_coarse();
+        ssize_t retval = socket->write_shared_handler(socket, buf);
+        socket->__write_stall_ms += guac_timestamp_current_coarse()
+            - socket->last_write_timestamp;
+
+        return retval;
+
+    }
+
+    /* All other sockets simply receive a copy of the buffer contents */
+    return guac_socket_write(socket, buf->buffer, buf->length);
+
+}
+
 ssize_t guac_socket_read(guac_socket* socket, void* buf, size_t count) {
 
     /* If handler defined, call it. */
@@ -129,6 +305,21 @@ ssize_t guac_socket_read(guac_socket* socket, void* buf, size_t count) {
 
 }
 
+ssize_t guac_socket_readv(guac_socket* socket, const struct iovec* iov,
+        int iovcnt) {
+
+    /* If scatter read handler defined, call it. */
+    if (socket->readv_handler)
+        return socket->readv_handler(socket, iov, iovcnt);
+
+    /* Otherwise, fall back to reading into the first buffer only. */
+    if (iovcnt > 0)
+        return guac_socket_read(socket, iov[0].iov_base, iov[0].iov_len);
+
+    return 0;
+
+}
+
 int guac_socket_select(guac_socket* socket, int usec_timeout) {
 
     /* Call select handler if defined */
@@ -154,14 +345,18 @@ guac_socket* guac_socket_alloc() {
     socket->__ready = 0;
     socket->data = NULL;
     socket->state = GUAC_SOCKET_OPEN;
-    socket->last_write_timestamp = guac_timestamp_current();
+    socket->last_write_timestamp = guac_timestamp_current_coarse();
+    socket->__write_stall_ms = 0;
 
     /* No keep alive ping by default */
     socket->__keep_alive_enabled = 0;
+    socket->__keep_alive_next = NULL;
 
     /* No handlers yet */
     socket->read_handler   = NULL;
+    socket->readv_handler  = NULL;
     socket->write_handler  = NULL;
+    socket->write_shared_handler = NULL;
     socket->select_handler = NULL;
     socket->free_handler   = NULL;
     socket->flush_handler  = NULL;
@@ -174,10 +369,33 @@ guac_socket* guac_socket_alloc() {
 
 void guac_socket_require_keep_alive(guac_socket* socket) {
 
-    /* Start keep-alive thread */
+    pthread_mutex_lock(&__guac_socket_keep_alive.lock);
+
+    /* Start the shared keep-alive thread if this is the first socket ever
+     * registered within this process */
+    if (!__guac_socket_keep_alive.started) {
+
+        pthread_t keep_alive_thread;
+        pthread_attr_t thread_attributes;
+        pthread_attr_init(&thread_attributes);
+        pthread_attr_setdetachstate(&thread_attributes,
+                PTHREAD_CREATE_DETACHED);
+
+        pthread_create(&keep_alive_thread, &thread_attributes,
+                __guac_socket_keep_alive_thread, NULL);
+
+        pthread_attr_destroy(&thread_attributes);
+        __guac_socket_keep_alive.started = 1;
+
+    }
+
+    /* Register socket with the shared keep-alive thread */
     socket->__keep_alive_enabled = 1;
-    pthread_create(&(socket->__keep_alive_thread), NULL,
-                __guac_socket_keep_alive_thread, (void*) socket);
+    socket->__keep_alive_next = __guac_socket_keep_alive.sockets;
+    __guac_socket_keep_alive.sockets = socket;
+
+    pthread_cond_signal(&__guac_socket_keep_alive.changed);
+    pthread_mutex_unlock(&__guac_socket_keep_alive.lock);
 
 }
 
@@ -208,10 +426,13 @@ void guac_socket_free(guac_socket* socket) {
     /* Mark as closed */
     socket->state = GUAC_SOCKET_CLOSED;
 
-    /* Stop keep-alive thread, if enabled */
+    /* Cease keep-alive for the socket, if enabled (removal blocks until any
+     * in-progress keep-alive pass completes, ensuring the shared keep-alive
+     * thread cannot still be using the socket once it is freed) */
     if (socket->__keep_alive_enabled) {
-        pthread_cancel(socket->__keep_alive_thread);
-        pthread_join(socket->__keep_alive_thread, NULL);
+        pthread_mutex_lock(&__guac_socket_keep_alive.lock);
+        __guac_socket_keep_alive_remove(socket);
+        pthread_mutex_unlock(&__guac_socket_keep_alive.lock);
     }
 
     guac_mem_free(socket);
@@ -219,11 +440,11 @@ void guac_socket_free(guac_socket* socket) {
 
 ssize_t guac_socket_write_int(guac_socket* socket, int64_t i) {
 
-    char buffer[128];
+    char buffer[GUAC_ITOA64_BUFFER_SIZE];
     int length;
 
     /* Write provided integer as a string */
-    length = snprintf(buffer, sizeof(buffer), "%"PRIi64, i);
+    length = guac_itoa64(buffer, i);
     return guac_socket_write(socket, buffer, length);
 
 }
@@ -312,12 +533,294 @@ ssize_t __guac_socket_encode_base64(int a, int b, int c, char* output) {
     return 0;
 }
 
+/**
+ * The bulk base64 encoding implementation most appropriate for the current
+ * CPU, or NULL if only the scalar implementation is available. This pointer
+ * is assigned exactly once by __guac_socket_base64_select_bulk().
+ *
+ * Each bulk implementation encodes as many leading bytes of the given buffer
+ * as its vector width allows, writing the corresponding base64 characters to
+ * the given output buffer, and returns the number of input bytes consumed
+ * (always a multiple of three). Exactly four output characters are written
+ * for every three input bytes consumed; bytes beyond the returned count,
+ * including any final partial group, are left for the scalar code.
+ */
+static size_t (*__guac_socket_base64_bulk)(const unsigned char* src,
+        size_t count, char* output) = NULL;
+
+/**
+ * Pthread initialization routine which selects the bulk base64 implementation
+ * to use for the current CPU, if any.
+ */
+static pthread_once_t __guac_socket_base64_bulk_selected = PTHREAD_ONCE_INIT;
+
+#ifdef GUAC_SOCKET_BASE64_X86
+
+/**
+ * Translates each of the sixteen 6-bit base64 index values in the given
+ * vector to the corresponding base64 character. The translation is performed
+ * arithmetically, classifying each index into one of the contiguous character
+ * ranges of the base64 alphabet and adding the offset of that range.
+ *
+ * @param indices
+ *     A vector of sixteen 6-bit base64 index values.
+ *
+ * @return
+ *     A vector of the sixteen corresponding base64 characters.
+ */
+__attribute__((target("ssse3")))
+static __m128i __guac_socket_base64_lookup_ssse3(__m128i indices) {
+
+    /* Reduce each index to a range classifier usable as a shuffle index:
+     * 0 for 0-51 (letters), (index - 51) for 52-63 (digits and symbols),
+     * with 13 substituted for indices below 26 (uppercase letters) */
+    __m128i result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+
+    /* Per-range offsets from index value to ASCII character */
+    const __m128i offsets = _mm_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+        '/' - 63, 'A',      0,        0
+    );
+
+    return _mm_add_epi8(_mm_shuffle_epi8(offsets, result), indices);
+
+}
+
+/**
+ * Splits the twelve data bytes in the low portion of the given vector (which
+ * must have already been shuffled such that each 32-bit word contains one
+ * three-byte group in the byte order expected by this function) into sixteen
+ * 6-bit base64 index values, one per byte.
+ *
+ * @param in
+ *     A vector of four three-byte groups, each shuffled into one 32-bit word
+ *     as bytes [b1, b0, b2, b1].
+ *
+ * @return
+ *     A vector of sixteen 6-bit base64 index values.
+ */
+__attribute__((target("ssse3")))
+static __m128i __guac_socket_base64_split_ssse3(__m128i in) {
+
+    /* Isolate the first and third 6-bit fields of each group and shift both
+     * into place with a single 16-bit multiply-high */
+    const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00));
+    const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+
+    /* Isolate the second and fourth 6-bit fields of each group and shift both
+     * into place with a single 16-bit multiply-low */
+    const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003F03F0));
+    const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+
+    return _mm_or_si128(t1, t3);
+
+}
+
+/**
+ * Bulk base64 encoding implementation using SSSE3 vector instructions. Twelve
+ * input bytes are encoded per iteration.
+ */
+__attribute__((target("ssse3")))
+static size_t __guac_socket_base64_bulk_ssse3(const unsigned char* src,
+        size_t count, char* output) {
+
+    size_t consumed = 0;
+
+    /* Distribute each three-byte group into its own 32-bit word as bytes
+     * [b1, b0, b2, b1] */
+    const __m128i shuf = _mm_set_epi8(
+        10, 11,  9, 10,
+         7,  8,  6,  7,
+         4,  5,  3,  4,
+         1,  2,  0,  1
+    );
+
+    /* Encode groups of twelve bytes for as long as a full 16-byte load is
+     * possible */
+    while (count - consumed >= 16) {
+
+        __m128i in = _mm_loadu_si128((const __m128i*) (src + consumed));
+        in = _mm_shuffle_epi8(in, shuf);
+
+        const __m128i indices = __guac_socket_base64_split_ssse3(in);
+        const __m128i encoded = __guac_socket_base64_lookup_ssse3(indices);
+
+        _mm_storeu_si128((__m128i*) output, encoded);
+
+        consumed += 12;
+        output += 16;
+
+    }
+
+    return consumed;
+
+}
+
+/**
+ * Bulk base64 encoding implementation using AVX2 vector instructions.
+ * Twenty-four input bytes are encoded per iteration.
+ */
+__attribute__((target("avx2")))
+static size_t __guac_socket_base64_bulk_avx2(const unsigned char* src,
+        size_t count, char* output) {
+
+    size_t consumed = 0;
+
+    /* As with the SSSE3 implementation, distribute each three-byte group into
+     * its own 32-bit word as bytes [b1, b0, b2, b1], independently within
+     * each 128-bit lane */
+    const __m256i shuf = _mm256_set_epi8(
+        10, 11,  9, 10,
+         7,  8,  6,  7,
+         4,  5,  3,  4,
+         1,  2,  0,  1,
+        10, 11,  9, 10,
+         7,  8,  6,  7,
+         4,  5,  3,  4,
+         1,  2,  0,  1
+    );
+
+    /* Encode groups of 24 bytes for as long as the trailing 16-byte load
+     * (which begins 12 bytes in) remains within the buffer */
+    while (count - consumed >= 32) {
+
+        /* Load twelve bytes into each 128-bit lane */
+        const __m128i lo = _mm_loadu_si128((const __m128i*) (src + consumed));
+        const __m128i hi = _mm_loadu_si128((const __m128i*) (src + consumed + 12));
+        __m256i in = _mm256_set_m128i(hi, lo);
+        in = _mm256_shuffle_epi8(in, shuf);
+
+        /* Split into 6-bit indices (see __guac_socket_base64_split_ssse3) */
+        const __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00));
+        const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        const __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0));
+        const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+        const __m256i indices = _mm256_or_si256(t1, t3);
+
+        /* Translate indices to base64 characters (see
+         * __guac_socket_base64_lookup_ssse3) */
+        __m256i result = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        const __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        result = _mm256_or_si256(result, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+
+        const __m256i offsets = _mm256_setr_epi8(
+            'a' - 26, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+            '/' - 63, 'A',      0,        0,
+            'a' - 26, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+            '/' - 63, 'A',      0,        0
+        );
+
+        const __m256i encoded = _mm256_add_epi8(
+                _mm256_shuffle_epi8(offsets, result), indices);
+
+        _mm256_storeu_si256((__m256i*) output, encoded);
+
+        consumed += 24;
+        output += 32;
+
+    }
+
+    return consumed;
+
+}
+
+#endif /* GUAC_SOCKET_BASE64_X86 */
+
+#ifdef GUAC_SOCKET_BASE64_NEON
+
+/**
+ * Bulk base64 encoding implementation using NEON vector instructions.
+ * Forty-eight input bytes are encoded per iteration.
+ */
+static size_t __guac_socket_base64_bulk_neon(const unsigned char* src,
+        size_t count, char* output) {
+
+    size_t consumed = 0;
+
+    /* Load the full base64 alphabet as a 64-byte table lookup */
+    const uint8x16x4_t alphabet = {{
+        vld1q_u8((const uint8_t*) __guac_socket_BASE64_CHARACTERS),
+        vld1q_u8((const uint8_t*) __guac_socket_BASE64_CHARACTERS + 16),
+        vld1q_u8((const uint8_t*) __guac_socket_BASE64_CHARACTERS + 32),
+        vld1q_u8((const uint8_t*) __guac_socket_BASE64_CHARACTERS + 48)
+    }};
+
+    const uint8x16_t mask = vdupq_n_u8(0x3F);
+
+    /* Encode sixteen three-byte groups per iteration */
+    while (count - consumed >= 48) {
+
+        const uint8x16x3_t in = vld3q_u8(src + consumed);
+
+        uint8x16x4_t encoded;
+        encoded.val[0] = vqtbl4q_u8(alphabet, vshrq_n_u8(in.val[0], 2));
+        encoded.val[1] = vqtbl4q_u8(alphabet, vandq_u8(vorrq_u8(
+                vshlq_n_u8(in.val[0], 4), vshrq_n_u8(in.val[1], 4)), mask));
+        encoded.val[2] = vqtbl4q_u8(alphabet, vandq_u8(vorrq_u8(
+                vshlq_n_u8(in.val[1], 2), vshrq_n_u8(in.val[2], 6)), mask));
+        encoded.val[3] = vqtbl4q_u8(alphabet, vandq_u8(in.val[2], mask));
+
+        vst4q_u8((uint8_t*) output, encoded);
+
+        consumed += 48;
+        output += 64;
+
+    }
+
+    return consumed;
+
+}
+
+#endif /* GUAC_SOCKET_BASE64_NEON */
+
+/**
+ * Selects the bulk base64 encoding implementation to use for all sockets
+ * based on the capabilities of the current CPU. If the CPU supports none of
+ * the available vector implementations, __guac_socket_base64_bulk remains
+ * NULL and only the scalar implementation will be used.
+ */
+static void __guac_socket_base64_select_bulk(void) {
+
+#if defined(GUAC_SOCKET_BASE64_X86)
+    if (__builtin_cpu_supports("avx2"))
+        __guac_socket_base64_bulk = __guac_socket_base64_bulk_avx2;
+    else if (__builtin_cpu_supports("ssse3"))
+        __guac_socket_base64_bulk = __guac_socket_base64_bulk_ssse3;
+#elif defined(GUAC_SOCKET_BASE64_NEON)
+    __guac_socket_base64_bulk = __guac_socket_base64_bulk_neon;
+#endif
+
+}
+
 ssize_t guac_socket_flush_base64(guac_socket* socket) {
     const unsigned char* src = socket->__ready_buf;
 
     int encodedCount = 0;
     int remaining = socket->__ready;
 
+    /* Encode the bulk of the buffer with vector instructions, if the CPU
+     * supports doing so */
+    pthread_once(&__guac_socket_base64_bulk_selected,
+            __guac_socket_base64_select_bulk);
+    if (__guac_socket_base64_bulk != NULL) {
+
+        size_t consumed = __guac_socket_base64_bulk(src, remaining,
+                socket->__encoded_buf);
+
+        src += consumed;
+        remaining -= consumed;
+        encodedCount += consumed / 3 * 4;
+
+    }
+
     /* Encode bytes in groups of three */
     while (remaining > 2) {
         __guac_socket_encode_base64(src[0], src[1], src[2], socket->__encoded_buf + encodedCount);
@@ -382,10 +885,23 @@ ssize_t guac_socket_write_base64(guac_socket* socket, const void* buf, size_t co
 ssize_t guac_socket_flush(guac_socket* socket) {
 
     /* If handler defined, call it. */
-    if (socket->flush_handler)
-        return socket->flush_handler(socket);
+    if (socket->flush_handler) {
+
+        guac_timestamp start = guac_timestamp_current();
+        ssize_t retval = socket->flush_handler(socket);
+
+        /* Record any time spent blocked on the underlying transport */
+        socket->__write_stall_ms += guac_timestamp_current() - start;
+
+        return retval;
+
+    }
 
     /* Otherwise, do nothing */
     return 0;
 
 }
+
+uint64_t guac_socket_get_write_stall(guac_socket* socket) {
+    return socket->__write_stall_ms;
+}
@@ -20,8 +20,10 @@
 #include "config.h"
 
 #include "guacamole/mem.h"
+#include "guacamole/string.h"
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -45,20 +47,66 @@
  */
 #define REMAINING(n, length) (((n) < (length)) ? 0 : ((n) - (length)))
 
-int guac_itoa(char* restrict dest, unsigned int integer) {
+/**
+ * Lookup table containing the two-character decimal representations of all
+ * values from 00 through 99, in order. Converting values two digits at a
+ * time halves the number of divisions required relative to the common
+ * digit-at-a-time approach.
+ */
+static const char guac_itoa_digit_pairs[200] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+int guac_itoa64(char* restrict dest, int64_t value) {
+
+    /* Operate on the magnitude of the given value, noting its sign. As the
+     * magnitude of INT64_MIN does not fit within int64_t, the magnitude must
+     * be taken after conversion to unsigned */
+    uint64_t remaining = (uint64_t) value;
+    if (value < 0)
+        remaining = -remaining;
+
+    /* Generate digits in reverse order, two digits at a time */
+    char digits[GUAC_ITOA64_BUFFER_SIZE];
+    char* current = digits + sizeof(digits);
+    while (remaining >= 100) {
+        current -= 2;
+        memcpy(current, guac_itoa_digit_pairs + (remaining % 100) * 2, 2);
+        remaining /= 100;
+    }
+
+    /* Write the remaining most-significant digit(s) */
+    if (remaining >= 10) {
+        current -= 2;
+        memcpy(current, guac_itoa_digit_pairs + remaining * 2, 2);
+    }
+    else
+        *(--current) = '0' + remaining;
 
-    /* Determine size of string. */
-    int str_size = snprintf(dest, 0, "%i", integer);
+    if (value < 0)
+        *(--current) = '-';
 
-    /* If an error occurs, just return that and skip the conversion. */
-    if (str_size < 0)
-        return str_size;
+    /* Shift the produced string to the start of the destination buffer */
+    int length = digits + sizeof(digits) - current;
+    memcpy(dest, current, length);
+    dest[length] = '\0';
 
-    /* Do the conversion and return. */
-    return snprintf(dest, (str_size + 1), "%i", integer);
+    return length;
 
 }
 
+int guac_itoa(char* restrict dest, unsigned int integer) {
+    return guac_itoa64(dest, integer);
+}
+
 size_t guac_strlcpy(char* restrict dest, const char* restrict src, size_t n) {
 
 #ifdef HAVE_STRLCPY
@@ -19,27 +19,111 @@
 
 #include "config.h"
 #include "guacamole/error.h"
+#include "guacamole/mem.h"
 #include "guacamole/tcp.h"
+#include "guacamole/timestamp.h"
 
 #include <errno.h>
 #include <fcntl.h>
 #include <netdb.h>
 #include <netinet/in.h>
-#include <sys/select.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
+/**
+ * The number of milliseconds to wait for an in-progress connection attempt
+ * before additionally starting an attempt against the next resolved address
+ * in parallel (the "Connection Attempt Delay" of RFC 8305). The first attempt
+ * to complete wins, and all others are abandoned. This bounds the latency
+ * added by an unresponsive address (such as an advertised IPv6 address which
+ * is not actually routable) to a fraction of a second, rather than a full
+ * connection timeout per dead address.
+ */
+#define GUAC_TCP_CONNECT_ATTEMPT_DELAY 250
+
+/**
+ * The state of a single connection attempt against one of the addresses
+ * resolved for the requested hostname.
+ */
+typedef struct guac_tcp_connect_attempt {
+
+    /**
+     * The file descriptor of the socket for this attempt, or -1 if this
+     * attempt has failed or has not yet been started.
+     */
+    int fd;
+
+    /**
+     * The file status flags of the socket prior to being switched to
+     * non-blocking, as retrieved with fcntl(). These flags are restored on
+     * the winning socket before it is returned.
+     */
+    int flags;
+
+} guac_tcp_connect_attempt;
+
+/**
+ * Begins a non-blocking connection attempt against the given address,
+ * populating the given attempt state. If the attempt cannot be started, or
+ * fails immediately, the file descriptor of the attempt is set to -1.
+ *
+ * @param attempt
+ *     The attempt state to populate.
+ *
+ * @param address
+ *     The address to connect to.
+ *
+ * @return
+ *     Non-zero if the connection completed immediately, zero if the attempt
+ *     is still in progress or could not be started.
+ */
+static int guac_tcp_connect_begin(guac_tcp_connect_attempt* attempt,
+        const struct addrinfo* address) {
+
+    attempt->fd = -1;
+
+    int fd = socket(address->ai_family, SOCK_STREAM, 0);
+    if (fd < 0)
+        return 0;
+
+    /* Set socket to non-blocking, saving its original flags such that they
+     * can be restored if this attempt wins */
+    if ((attempt->flags = fcntl(fd, F_GETFL, NULL)) < 0
+            || fcntl(fd, F_SETFL, attempt->flags | O_NONBLOCK) < 0) {
+        close(fd);
+        return 0;
+    }
+
+    /* Begin connection attempt, which will typically complete in the
+     * background */
+    if (connect(fd, address->ai_addr, address->ai_addrlen) < 0) {
+
+        /* Abandon this attempt immediately if outright refused */
+        if (errno != EINPROGRESS) {
+            close(fd);
+            return 0;
+        }
+
+        attempt->fd = fd;
+        return 0;
+
+    }
+
+    /* Connection completed immediately (typical for loopback and local
+     * addresses) */
+    attempt->fd = fd;
+    return 1;
+
+}
+
 int guac_tcp_connect(const char* hostname, const char* port, const int timeout) {
 
     int retval;
 
-    int fd = EBADFD;
     struct addrinfo* addresses;
     struct addrinfo* current_address;
 
-    char connected_address[1024];
-    char connected_port[64];
-
     struct addrinfo hints = {
         .ai_family   = AF_UNSPEC,
         .ai_socktype = SOCK_STREAM,
@@ -50,111 +134,169 @@ int guac_tcp_connect(const char* hostname, const char* port, const int timeout)
     if ((retval = getaddrinfo(hostname, port, &hints, &addresses))) {
         guac_error = GUAC_STATUS_INVALID_ARGUMENT;
         guac_error_message = "Error parsing address or port.";
-        return retval;
+        return -1;
     }
 
-    /* Attempt connection to each address until success */
-    for (current_address = addresses; current_address != NULL; current_address = current_address->ai_next) {
+    /* Count resolved addresses */
+    int total = 0;
+    for (current_address = addresses; current_address != NULL;
+            current_address = current_address->ai_next)
+        total++;
 
-        /* Resolve hostname */
-        if ((retval = getnameinfo(current_address->ai_addr,
-                current_address->ai_addrlen,
-                connected_address, sizeof(connected_address),
-                connected_port, sizeof(connected_port),
-                NI_NUMERICHOST | NI_NUMERICSERV))) {
+    /* Partition addresses by family, preserving resolver order within each
+     * partition, such that attempts can alternate between families (RFC 8305
+     * "Happy Eyeballs"). This ensures that a host which advertises
+     * unresponsive addresses of one family delays attempts against the other
+     * family by no more than the attempt delay. */
+    const struct addrinfo** ordered = guac_mem_alloc(guac_mem_ckd_mul_or_die(
+                total, sizeof(const struct addrinfo*)));
 
-            guac_error = GUAC_STATUS_INVALID_ARGUMENT;
-            guac_error_message = "Error resolving host.";
-            continue;
-        }
+    int num_first = 0;
+    int num_second = 0;
+    int first_family = addresses->ai_family;
+    for (current_address = addresses; current_address != NULL;
+            current_address = current_address->ai_next) {
+        if (current_address->ai_family == first_family)
+            ordered[num_first++] = current_address;
+        else
+            ordered[total - (++num_second)] = current_address;
+    }
 
-        /* Get socket or return the error. */
-        fd = socket(current_address->ai_family, SOCK_STREAM, 0);
-        if (fd < 0) {
-            freeaddrinfo(addresses);
-            return fd;
-        }
+    guac_tcp_connect_attempt* attempts = guac_mem_alloc(guac_mem_ckd_mul_or_die(
+                total, sizeof(guac_tcp_connect_attempt)));
 
-        /* Variable to store current socket options. */
-        int opt;
+    int connected_fd = -1;
+    int started = 0;
+    int pending = 0;
 
-        /* Get current socket options */
-        if ((opt = fcntl(fd, F_GETFL, NULL)) < 0) {
-            guac_error = GUAC_STATUS_INVALID_ARGUMENT;
-            guac_error_message = "Failed to retrieve socket options.";
-            close(fd);
-            continue;
+    /* Progress through each family partition (the second partition was
+     * stored in reverse, from the end of the ordered array inward) */
+    int next_first = 0;
+    int next_second = 0;
+
+    guac_timestamp start = guac_timestamp_current();
+    guac_timestamp next_attempt = start;
+
+    /* Assume failure to connect to anything unless an attempt succeeds */
+    guac_error = GUAC_STATUS_REFUSED;
+    guac_error_message = "Unable to connect to remote host.";
+
+    while (connected_fd == -1) {
+
+        guac_timestamp now = guac_timestamp_current();
+        guac_timestamp remaining = (guac_timestamp) timeout * 1000 - (now - start);
+
+        /* Stop trying once the overall timeout has elapsed */
+        if (remaining <= 0) {
+            guac_error = GUAC_STATUS_REFUSED;
+            guac_error_message = "Timeout connecting via socket.";
+            break;
         }
 
-        /* Set socket to non-blocking */
-        if (fcntl(fd, F_SETFL, opt | O_NONBLOCK) < 0) {
-            guac_error = GUAC_STATUS_INVALID_ARGUMENT;
-            guac_error_message = "Failed to set non-blocking socket.";
-            close(fd);
+        /* Begin the next staggered attempt once its delay has elapsed (or
+         * immediately, if there are no attempts in progress to wait for) */
+        if (started < total && (pending == 0 || now >= next_attempt)) {
+
+            /* Alternate between the two family partitions established
+             * above, falling back to whichever still has addresses left */
+            int index;
+            if ((started % 2 == 0 && next_first < num_first)
+                    || next_second >= num_second)
+                index = next_first++;
+            else
+                index = total - 1 - (next_second++);
+
+            guac_tcp_connect_attempt* attempt = &(attempts[started]);
+            if (guac_tcp_connect_begin(attempt, ordered[index])) {
+                connected_fd = attempt->fd;
+                fcntl(connected_fd, F_SETFL, attempt->flags);
+                started++;
+                break;
+            }
+
+            if (attempt->fd != -1)
+                pending++;
+
+            started++;
+            next_attempt = now + GUAC_TCP_CONNECT_ATTEMPT_DELAY;
             continue;
+
         }
 
-        /* Structure that stores our timeout setting. */
-        struct timeval tv;
-        tv.tv_sec = timeout;
-        tv.tv_usec = 0;
-
-        /* Connect and wait for timeout */
-        if ((retval = connect(fd, current_address->ai_addr, current_address->ai_addrlen)) < 0) {
-            if (errno == EINPROGRESS) {
-                /* Set up timeout. */
-                fd_set fdset;
-                FD_ZERO(&fdset);
-                FD_SET(fd, &fdset);
-                
-                retval = select(fd + 1, NULL, &fdset, NULL, &tv);
-            }
-            
-            else {
-                guac_error = GUAC_STATUS_REFUSED;
-                guac_error_message = "Unable to connect via socket.";
-                close(fd);
-                continue;
+        /* Give up if every attempt has been made and has failed */
+        if (pending == 0 && started == total)
+            break;
+
+        /* Wait for any in-progress attempt to complete, but no longer than
+         * the start of the next staggered attempt or the overall timeout */
+        guac_timestamp wait = remaining;
+        if (started < total && next_attempt - now < wait)
+            wait = next_attempt - now;
+
+        struct pollfd* fds = guac_mem_alloc(guac_mem_ckd_mul_or_die(pending,
+                    sizeof(struct pollfd)));
+
+        int num_fds = 0;
+        for (int i = 0; i < started; i++) {
+            if (attempts[i].fd != -1) {
+                fds[num_fds].fd = attempts[i].fd;
+                fds[num_fds].events = POLLOUT;
+                fds[num_fds].revents = 0;
+                num_fds++;
             }
         }
 
-        /* Successful connection */
+        retval = poll(fds, num_fds, (int) wait);
+
+        /* Check the outcome of each completed attempt, accepting the first
+         * successful connection */
         if (retval > 0) {
-            /* Restore previous socket options. */
-            if (fcntl(fd, F_SETFL, opt) < 0) {
-                guac_error = GUAC_STATUS_INVALID_ARGUMENT;
-                guac_error_message = "Failed to reset socket options.";
+            for (int i = 0, j = 0; i < started; i++) {
+
+                int fd = attempts[i].fd;
+                if (fd == -1)
+                    continue;
+
+                short revents = fds[j++].revents;
+                if (!(revents & (POLLOUT | POLLERR | POLLHUP)))
+                    continue;
+
+                /* Determine whether the background connection attempt
+                 * actually succeeded */
+                int error = 0;
+                socklen_t error_len = sizeof(error);
+                if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error,
+                            &error_len) == 0 && error == 0) {
+
+                    /* Restore previous socket options of winning socket */
+                    connected_fd = fd;
+                    fcntl(connected_fd, F_SETFL, attempts[i].flags);
+                    break;
+
+                }
+
+                /* Attempt failed - abandon its socket */
                 close(fd);
-                continue;
-            }
+                attempts[i].fd = -1;
+                pending--;
 
-            break;
+            }
         }
 
-        if (retval == 0) {
-            guac_error = GUAC_STATUS_REFUSED;
-            guac_error_message = "Timeout connecting via socket.";
-        }
-        else {
-            guac_error = GUAC_STATUS_INVALID_ARGUMENT;
-            guac_error_message = "Error attempting to connect via socket.";
-        }
+        guac_mem_free(fds);
 
-        /* Some error has occurred - free resources before next iteration. */
-        close(fd);
+    }
 
+    /* Abandon all attempts other than the winning connection, if any */
+    for (int i = 0; i < started; i++) {
+        if (attempts[i].fd != -1 && attempts[i].fd != connected_fd)
+            close(attempts[i].fd);
     }
 
-    /* Free addrinfo */
+    guac_mem_free(attempts);
+    guac_mem_free(ordered);
     freeaddrinfo(addresses);
 
-    /* If unable to connect to anything, set error status. */
-    if (current_address == NULL) {
-        guac_error = GUAC_STATUS_REFUSED;
-        guac_error_message = "Unable to connect to remote host.";
-    }
-
-    /* Return the fd, or the error message if the socket connection failed. */
-    return fd;
+    return connected_fd;
 
 }
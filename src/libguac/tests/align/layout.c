@@ -0,0 +1,65 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <CUnit/CUnit.h>
+#include <guacamole/align.h>
+#include <guacamole/assert.h>
+#include <guacamole/client.h>
+#include <guacamole/fifo.h>
+
+#include <stddef.h>
+
+/* The layout constraints verified here are compile-time properties, so the
+ * bulk of this "test" is static assertions: if any of the cache-line
+ * separations below are violated by a structure change, the build fails
+ * rather than the contention silently returning. The runtime test function
+ * below exists only so that the harness is visible in the test report. */
+
+/* The head and tail positions of a lock-free guac_fifo are updated constantly
+ * by consumers and producers respectively, and must not share a cache line
+ * with each other or with the configuration members that both sides read on
+ * every operation */
+GUAC_STATIC_ASSERT(offsetof(guac_fifo, ring_head) % GUAC_CACHE_LINE_SIZE == 0);
+GUAC_STATIC_ASSERT(offsetof(guac_fifo, ring_tail) % GUAC_CACHE_LINE_SIZE == 0);
+GUAC_STATIC_ASSERT(offsetof(guac_fifo, ring_tail)
+        - offsetof(guac_fifo, ring_head) >= GUAC_CACHE_LINE_SIZE);
+GUAC_STATIC_ASSERT(offsetof(guac_fifo, ring_head)
+        - offsetof(guac_fifo, max_items) >= GUAC_CACHE_LINE_SIZE);
+
+/* The users lock of a guac_client is acquired by every user's I/O threads and
+ * must not share a cache line with the pending-users lock */
+GUAC_STATIC_ASSERT(offsetof(guac_client, __users_lock) % GUAC_CACHE_LINE_SIZE == 0);
+GUAC_STATIC_ASSERT(offsetof(guac_client, __pending_users_lock) % GUAC_CACHE_LINE_SIZE == 0);
+GUAC_STATIC_ASSERT(offsetof(guac_client, __pending_users_lock)
+        - offsetof(guac_client, __users_lock) >= GUAC_CACHE_LINE_SIZE);
+
+/**
+ * Test which verifies the cache-line layout of structures shared between
+ * threads. The actual verification is performed at compile time by the static
+ * assertions above; this function merely confirms the same offsets at
+ * runtime for visibility in the test report.
+ */
+void test_align__layout() {
+
+    CU_ASSERT_EQUAL(offsetof(guac_fifo, ring_head) % GUAC_CACHE_LINE_SIZE, 0);
+    CU_ASSERT_EQUAL(offsetof(guac_fifo, ring_tail) % GUAC_CACHE_LINE_SIZE, 0);
+    CU_ASSERT_EQUAL(offsetof(guac_client, __users_lock) % GUAC_CACHE_LINE_SIZE, 0);
+    CU_ASSERT_EQUAL(offsetof(guac_client, __pending_users_lock) % GUAC_CACHE_LINE_SIZE, 0);
+
+}
@@ -296,3 +296,44 @@ void test_fifo__interleaved() {
 
 }
 
+/**
+ * Verify that batch dequeue removes all immediately-available events in order,
+ * honoring the provided limit on the number of events removed.
+ */
+void test_fifo__batch() {
+
+    test_fifo fifo;
+    test_event events[TEST_FIFO_MAX_ITEMS];
+
+    test_fifo_init(&fifo, TEST_VALUES);
+
+    /* Fill the fifo to capacity */
+    for (unsigned int i = 0; i < TEST_FIFO_MAX_ITEMS; i++) {
+        test_event event = {
+            .test_value = TEST_VALUES[i]
+        };
+        CU_ASSERT_TRUE_FATAL(guac_fifo_enqueue((guac_fifo*) &fifo, &event));
+    }
+
+    /* A batch limited to fewer items than are available should remove exactly
+     * that many items */
+    CU_ASSERT_EQUAL(guac_fifo_dequeue_batch((guac_fifo*) &fifo, events, 2), 2);
+    CU_ASSERT_EQUAL(events[0].test_value, TEST_VALUES[0]);
+    CU_ASSERT_EQUAL(events[1].test_value, TEST_VALUES[1]);
+
+    /* A batch limited to more items than are available should remove only the
+     * items actually present, continuing in order from the previous batch */
+    CU_ASSERT_EQUAL(guac_fifo_dequeue_batch((guac_fifo*) &fifo, events,
+                TEST_FIFO_MAX_ITEMS), TEST_FIFO_MAX_ITEMS - 2);
+    CU_ASSERT_EQUAL(events[0].test_value, TEST_VALUES[2]);
+    CU_ASSERT_EQUAL(events[1].test_value, TEST_VALUES[3]);
+
+    /* Batch dequeue must fail immediately once the fifo is invalidated */
+    guac_fifo_invalidate((guac_fifo*) &fifo);
+    CU_ASSERT_FALSE(guac_fifo_dequeue_batch((guac_fifo*) &fifo, events,
+                TEST_FIFO_MAX_ITEMS));
+
+    test_fifo_destroy(&fifo);
+
+}
+
@@ -0,0 +1,257 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <CUnit/CUnit.h>
+#include <guacamole/fifo.h>
+
+#include <pthread.h>
+
+/**
+ * The maximum number of milliseconds a consumer will wait for an item before
+ * concluding that all producers have finished.
+ */
+#define LOCKFREE_TEST_TIMEOUT 250
+
+/**
+ * The maximum number of items permitted in the lock-free fifo being tested.
+ * This is intentionally small relative to the number of items sent, such that
+ * the fifo repeatedly fills and producers must block.
+ */
+#define LOCKFREE_MAX_ITEMS 16
+
+/**
+ * The number of threads that will concurrently enqueue items during the MPMC
+ * test.
+ */
+#define LOCKFREE_PRODUCERS 4
+
+/**
+ * The number of threads that will concurrently dequeue items during the MPMC
+ * test.
+ */
+#define LOCKFREE_CONSUMERS 4
+
+/**
+ * The number of items each producer will enqueue during the MPMC test.
+ */
+#define LOCKFREE_ITEMS_PER_PRODUCER 5000
+
+/**
+ * Test item for the lock-free fifo, identifying the producer that sent it and
+ * its position within that producer's sequence of sent items.
+ */
+typedef struct lockfree_test_item {
+
+    /**
+     * The index of the producer that enqueued this item.
+     */
+    int producer;
+
+    /**
+     * The position of this item within the sequence of items enqueued by its
+     * producer, starting from zero.
+     */
+    int sequence;
+
+} lockfree_test_item;
+
+/**
+ * Test fifo that extends the guac_fifo base with storage for
+ * lockfree_test_items.
+ */
+typedef struct lockfree_test_fifo {
+
+    /**
+     * The base fifo implementation.
+     */
+    guac_fifo base;
+
+    /**
+     * Storage for all items in this fifo.
+     */
+    lockfree_test_item items[LOCKFREE_MAX_ITEMS];
+
+} lockfree_test_fifo;
+
+/**
+ * Shared state for all producer and consumer threads of the MPMC test.
+ */
+typedef struct lockfree_test_state {
+
+    /**
+     * The lock-free fifo being tested.
+     */
+    lockfree_test_fifo fifo;
+
+    /**
+     * The total number of items received by all consumers. Accessed only via
+     * atomic operations.
+     */
+    int received;
+
+    /**
+     * The number of ordering violations observed by all consumers, where a
+     * violation is any pair of items from the same producer arriving at the
+     * same consumer out of order. Accessed only via atomic operations.
+     */
+    int violations;
+
+} lockfree_test_state;
+
+/**
+ * The lockfree_test_state shared by all threads of the MPMC test. Producer
+ * threads receive their own index as their thread argument, so the shared
+ * state is provided via this variable instead.
+ */
+static lockfree_test_state* producer_state;
+
+/**
+ * Thread which enqueues LOCKFREE_ITEMS_PER_PRODUCER sequenced items into the
+ * shared fifo, blocking as necessary when the fifo is full.
+ *
+ * @param data
+ *     The index of this producer, cast to void*.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* lockfree_producer_thread(void* data) {
+
+    int producer = (int) (long) data;
+
+    for (int i = 0; i < LOCKFREE_ITEMS_PER_PRODUCER; i++) {
+
+        lockfree_test_item item = {
+            .producer = producer,
+            .sequence = i
+        };
+
+        CU_ASSERT_TRUE_FATAL(guac_fifo_enqueue(
+                    (guac_fifo*) &producer_state->fifo, &item));
+
+    }
+
+    return NULL;
+
+}
+
+/**
+ * Thread which dequeues items from the shared fifo until no further items
+ * arrive within LOCKFREE_TEST_TIMEOUT milliseconds, verifying that items from
+ * any single producer arrive in the order they were sent.
+ *
+ * @param data
+ *     The lockfree_test_state shared by all threads.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* lockfree_consumer_thread(void* data) {
+
+    lockfree_test_state* state = (lockfree_test_state*) data;
+
+    /* The most recent sequence number received from each producer, or -1 if
+     * no items have yet been received from that producer */
+    int last_sequence[LOCKFREE_PRODUCERS];
+    for (int i = 0; i < LOCKFREE_PRODUCERS; i++)
+        last_sequence[i] = -1;
+
+    lockfree_test_item item;
+    while (guac_fifo_timed_dequeue((guac_fifo*) &state->fifo, &item,
+                LOCKFREE_TEST_TIMEOUT)) {
+
+        /* Items from any single producer must arrive in the order sent */
+        if (item.producer < 0 || item.producer >= LOCKFREE_PRODUCERS
+                || item.sequence <= last_sequence[item.producer])
+            __atomic_fetch_add(&state->violations, 1, __ATOMIC_RELAXED);
+        else
+            last_sequence[item.producer] = item.sequence;
+
+        __atomic_fetch_add(&state->received, 1, __ATOMIC_RELAXED);
+
+    }
+
+    return NULL;
+
+}
+
+/**
+ * Test which verifies that a lock-free fifo behaves as a FIFO under
+ * concurrent use by multiple producers and consumers, with no items lost,
+ * duplicated, or reordered relative to their producer.
+ */
+void test_fifo__lockfree_mpmc() {
+
+    lockfree_test_state state = { 0 };
+    producer_state = &state;
+
+    guac_fifo_init_lockfree((guac_fifo*) &state.fifo, &state.fifo.items,
+            LOCKFREE_MAX_ITEMS, sizeof(lockfree_test_item));
+
+    pthread_t producers[LOCKFREE_PRODUCERS];
+    pthread_t consumers[LOCKFREE_CONSUMERS];
+
+    for (int i = 0; i < LOCKFREE_CONSUMERS; i++)
+        CU_ASSERT_EQUAL_FATAL(0, pthread_create(&consumers[i], NULL,
+                    lockfree_consumer_thread, &state));
+
+    for (int i = 0; i < LOCKFREE_PRODUCERS; i++)
+        CU_ASSERT_EQUAL_FATAL(0, pthread_create(&producers[i], NULL,
+                    lockfree_producer_thread, (void*) (long) i));
+
+    for (int i = 0; i < LOCKFREE_PRODUCERS; i++)
+        pthread_join(producers[i], NULL);
+
+    for (int i = 0; i < LOCKFREE_CONSUMERS; i++)
+        pthread_join(consumers[i], NULL);
+
+    /* Every item sent must have been received exactly once, in order */
+    CU_ASSERT_EQUAL(state.received,
+            LOCKFREE_PRODUCERS * LOCKFREE_ITEMS_PER_PRODUCER);
+    CU_ASSERT_EQUAL(state.violations, 0);
+
+    guac_fifo_destroy((guac_fifo*) &state.fifo);
+
+}
+
+/**
+ * Test which verifies that invalidation of a lock-free fifo wakes and fails
+ * all pending operations, including producers blocked on a full fifo.
+ */
+void test_fifo__lockfree_invalidate() {
+
+    lockfree_test_fifo fifo;
+    lockfree_test_item item = { 0 };
+
+    guac_fifo_init_lockfree((guac_fifo*) &fifo, &fifo.items,
+            LOCKFREE_MAX_ITEMS, sizeof(lockfree_test_item));
+
+    /* Fill the fifo to capacity */
+    for (int i = 0; i < LOCKFREE_MAX_ITEMS; i++)
+        CU_ASSERT_TRUE_FATAL(guac_fifo_enqueue((guac_fifo*) &fifo, &item));
+
+    /* Invalidation must fail all further operations immediately, even though
+     * the fifo is full and non-empty */
+    guac_fifo_invalidate((guac_fifo*) &fifo);
+    CU_ASSERT_FALSE(guac_fifo_enqueue((guac_fifo*) &fifo, &item));
+    CU_ASSERT_FALSE(guac_fifo_dequeue((guac_fifo*) &fifo, &item));
+
+    guac_fifo_destroy((guac_fifo*) &fifo);
+
+}
@@ -0,0 +1,93 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include <CUnit/CUnit.h>
+#include <guacamole/mem.h>
+#include <stdint.h>
+
+/**
+ * Test which verifies that guac_mem_get_stats() reports allocations made
+ * through guac_mem_alloc(), where such tracking is supported by the platform.
+ */
+void test_mem__stats_tracks_usage() {
+
+#if defined(HAVE_MALLOC_USABLE_SIZE) && defined(HAVE_MALLOC_H)
+
+    guac_mem_stats before, during, after;
+    guac_mem_get_stats(&before);
+
+    void* ptr = guac_mem_alloc(123456);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(ptr);
+
+    /* Usage must grow by at least the requested size, and the peak must
+     * cover current usage */
+    guac_mem_get_stats(&during);
+    CU_ASSERT(during.used >= before.used + 123456);
+    CU_ASSERT(during.peak >= during.used);
+
+    guac_mem_free(ptr);
+
+    /* Usage must return to its prior level once the block is freed, while
+     * the peak is retained */
+    guac_mem_get_stats(&after);
+    CU_ASSERT_EQUAL(after.used, before.used);
+    CU_ASSERT(after.peak >= during.used);
+
+#endif
+
+}
+
+/**
+ * Test which verifies that allocations beyond the limit set through
+ * guac_mem_set_limit() fail, that allocations within the limit succeed, and
+ * that enforcement can be disabled again, where usage tracking is supported
+ * by the platform.
+ */
+void test_mem__stats_limit() {
+
+#if defined(HAVE_MALLOC_USABLE_SIZE) && defined(HAVE_MALLOC_H)
+
+    guac_mem_stats stats;
+    guac_mem_get_stats(&stats);
+
+    /* Reported limit should reflect the limit set */
+    guac_mem_set_limit(stats.used + 1048576);
+    guac_mem_get_stats(&stats);
+    CU_ASSERT_EQUAL(stats.limit, stats.used + 1048576);
+
+    /* Allocations far beyond the limit must fail */
+    CU_ASSERT_PTR_NULL(guac_mem_alloc(16777216));
+
+    /* Allocations within the limit must succeed */
+    void* ptr = guac_mem_alloc(1024);
+    CU_ASSERT_PTR_NOT_NULL(ptr);
+    guac_mem_free(ptr);
+
+    /* A limit of zero disables enforcement */
+    guac_mem_set_limit(0);
+    ptr = guac_mem_alloc(16777216);
+    CU_ASSERT_PTR_NOT_NULL(ptr);
+    guac_mem_free(ptr);
+
+#endif
+
+}
+
@@ -0,0 +1,94 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <CUnit/CUnit.h>
+#include <guacamole/parser.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * Test which verifies that guac_parser correctly handles a multi-byte UTF-8
+ * character which is split across two calls to guac_parser_append() exactly
+ * at the end of a 16-byte bulk scanning chunk. The incomplete character must
+ * be un-consumed (not counted) by the call which receives only its lead byte,
+ * and parsed normally by the call which receives the remainder.
+ */
+void test_parser__append_boundary() {
+
+    /* Allocate parser */
+    guac_parser* parser = guac_parser_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(parser);
+
+    /* Instruction input, containing a three-byte UTF-8 character whose lead
+     * byte is the 16th byte of element content (the last byte of the first
+     * bulk scanning chunk) */
+    char buffer[] = "2.ab,20.aaaaaaaaaaaaaaa\xe2\x82\xac" "bbbb;";
+    char* current = buffer;
+
+    /* Provide data only up to and including the lead byte of the split
+     * character */
+    int remaining = 24;
+    while (remaining > 0) {
+
+        /* Parse more data */
+        int parsed = guac_parser_append(parser, current, remaining);
+        if (parsed == 0)
+            break;
+
+        current += parsed;
+        remaining -= parsed;
+
+    }
+
+    /* All data except the incomplete trailing character should have been
+     * consumed, without error */
+    CU_ASSERT_EQUAL(remaining, 1);
+    CU_ASSERT_EQUAL(parser->state, GUAC_PARSE_CONTENT);
+
+    /* Provide the remainder of the instruction, beginning with the
+     * un-consumed lead byte */
+    remaining = sizeof(buffer) - 1 - (current - buffer);
+    while (remaining > 0) {
+
+        /* Parse more data */
+        int parsed = guac_parser_append(parser, current, remaining);
+        if (parsed == 0)
+            break;
+
+        current += parsed;
+        remaining -= parsed;
+
+    }
+
+    /* Parse of instruction should be complete */
+    CU_ASSERT_EQUAL(remaining, 0);
+    CU_ASSERT_EQUAL(parser->state, GUAC_PARSE_COMPLETE);
+
+    /* Validate resulting structure */
+    CU_ASSERT_EQUAL(parser->argc, 1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(parser->opcode);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(parser->argv[0]);
+
+    /* Validate resulting content */
+    CU_ASSERT_STRING_EQUAL(parser->opcode,  "ab");
+    CU_ASSERT_STRING_EQUAL(parser->argv[0], "aaaaaaaaaaaaaaa\xe2\x82\xac" "bbbb");
+
+}
@@ -0,0 +1,82 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <CUnit/CUnit.h>
+#include <guacamole/parser.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * A 58-character (64-byte) element value containing several multi-byte UTF-8
+ * characters, positioned such that character boundaries do not align with
+ * the 16-byte chunks used by any bulk scanning path within the parser.
+ */
+#define LONG_VALUE \
+        "abcdefghijklmn\xe7\x8a\xac" \
+        "opqrstuvwxyz\xf0\x90\xac\x80" \
+        "0123456789012\xc3\xa1" \
+        "abcdefghijklmnop"
+
+/**
+ * Test which verifies that guac_parser correctly parses instructions
+ * containing elements long enough to engage bulk content scanning, including
+ * multi-byte UTF-8 characters which straddle scanning chunk boundaries.
+ */
+void test_parser__append_long() {
+
+    /* Allocate parser */
+    guac_parser* parser = guac_parser_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(parser);
+
+    /* Instruction input */
+    char buffer[] = "4.test,58." LONG_VALUE ",58." LONG_VALUE ";";
+    char* current = buffer;
+
+    /* While data remains */
+    int remaining = sizeof(buffer)-1;
+    while (remaining > 0) {
+
+        /* Parse more data */
+        int parsed = guac_parser_append(parser, current, remaining);
+        if (parsed == 0)
+            break;
+
+        current += parsed;
+        remaining -= parsed;
+
+    }
+
+    /* Parse of instruction should be complete */
+    CU_ASSERT_EQUAL(remaining, 0);
+    CU_ASSERT_EQUAL(parser->state, GUAC_PARSE_COMPLETE);
+
+    /* Validate resulting structure */
+    CU_ASSERT_EQUAL(parser->argc, 2);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(parser->opcode);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(parser->argv[0]);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(parser->argv[1]);
+
+    /* Validate resulting content */
+    CU_ASSERT_STRING_EQUAL(parser->opcode,  "test");
+    CU_ASSERT_STRING_EQUAL(parser->argv[0], LONG_VALUE);
+    CU_ASSERT_STRING_EQUAL(parser->argv[1], LONG_VALUE);
+
+}
@@ -0,0 +1,164 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <CUnit/CUnit.h>
+#include <guacamole/error.h>
+#include <guacamole/parser.h>
+#include <guacamole/socket.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * The number of bulk instructions to write and verify. The instructions are
+ * sized such that the series is significantly larger than the instruction
+ * buffer of the parser, forcing received data to spill beyond that buffer
+ * when the entire series is available to be read at once.
+ */
+#define BULK_INSTRUCTION_COUNT 16
+
+/**
+ * The length of the single element of each bulk instruction, in bytes.
+ */
+#define BULK_ELEMENT_LENGTH 4000
+
+/**
+ * Writes a series of large Guacamole instructions as raw bytes to the given
+ * file descriptor, closing the file descriptor once all instructions are
+ * written. Each instruction has the opcode "blob" and a single element of
+ * BULK_ELEMENT_LENGTH bytes, the content of which is derived from the index
+ * of the instruction within the series.
+ *
+ * @param fd
+ *     The file descriptor to write instructions to.
+ */
+static void write_bulk_instructions(int fd) {
+
+    int i;
+    for (i = 0; i < BULK_INSTRUCTION_COUNT; i++) {
+
+        char element[BULK_ELEMENT_LENGTH];
+        memset(element, 'A' + i, sizeof(element));
+
+        char instruction[BULK_ELEMENT_LENGTH + 64];
+        int length = snprintf(instruction, sizeof(instruction), "4.blob,%i.%.*s;",
+                BULK_ELEMENT_LENGTH, BULK_ELEMENT_LENGTH, element);
+
+        char* current = instruction;
+        int remaining = length;
+
+        /* Write all bytes of instruction */
+        while (remaining > 0) {
+
+            /* Bail out immediately if write fails (test will fail in parent
+             * process due to failure to read) */
+            int written = write(fd, current, remaining);
+            if (written <= 0)
+                break;
+
+            current += written;
+            remaining -= written;
+
+        }
+
+    }
+
+    /* Done writing */
+    close(fd);
+
+}
+
+/**
+ * Reads and parses instructions from the given file descriptor using a
+ * guac_socket and guac_parser, verifying that those instructions match the
+ * series of instructions expected to be written by write_bulk_instructions().
+ * The given file descriptor is automatically closed as a result of calling
+ * this function.
+ *
+ * @param fd
+ *     The file descriptor to read data from.
+ */
+static void read_expected_bulk_instructions(int fd) {
+
+    /* Open guac socket */
+    guac_socket* socket = guac_socket_open(fd);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(socket);
+
+    /* Allocate parser */
+    guac_parser* parser = guac_parser_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(parser);
+
+    int i;
+    for (i = 0; i < BULK_INSTRUCTION_COUNT; i++) {
+
+        char expected[BULK_ELEMENT_LENGTH + 1];
+        memset(expected, 'A' + i, BULK_ELEMENT_LENGTH);
+        expected[BULK_ELEMENT_LENGTH] = '\0';
+
+        /* Read and validate instruction */
+        CU_ASSERT_EQUAL_FATAL(guac_parser_read(parser, socket, 1000000), 0);
+        CU_ASSERT_STRING_EQUAL(parser->opcode, "blob");
+        CU_ASSERT_EQUAL_FATAL(parser->argc, 1);
+        CU_ASSERT_STRING_EQUAL(parser->argv[0], expected);
+
+    }
+
+    /* Done */
+    guac_parser_free(parser);
+    guac_socket_free(socket);
+
+}
+
+/**
+ * Tests that guac_parser_read() correctly reads and parses a bulk series of
+ * large instructions, the total size of which exceeds the parser's internal
+ * instruction buffer, such that received data must spill beyond that buffer
+ * and later be drained as parsing progresses. A child process is forked to
+ * write the series of instructions, which is allowed to accumulate within the
+ * pipe before the parent process begins reading.
+ */
+void test_parser__read_bulk() {
+
+    int fd[2];
+
+    /* Create pipe */
+    CU_ASSERT_EQUAL_FATAL(pipe(fd), 0);
+
+    int read_fd = fd[0];
+    int write_fd = fd[1];
+
+    /* Fork into writer process (child) and reader process (parent) */
+    int childpid;
+    CU_ASSERT_NOT_EQUAL_FATAL((childpid = fork()), -1);
+
+    /* Attempt to write a series of instructions within the child process */
+    if (childpid == 0) {
+        close(read_fd);
+        write_bulk_instructions(write_fd);
+        exit(0);
+    }
+
+    /* Read and verify the expected instructions within the parent process */
+    close(write_fd);
+    read_expected_bulk_instructions(read_fd);
+
+}
+
@@ -0,0 +1,121 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <CUnit/CUnit.h>
+#include <guacamole/pixel.h>
+
+#include <stdint.h>
+
+/**
+ * The number of pixels used for each conversion test. This is intentionally
+ * not a multiple of any vector width, such that both the vectorized bulk of
+ * each conversion and the scalar handling of the remainder are exercised.
+ */
+#define TEST_PIXEL_COUNT 1027
+
+/**
+ * Produces an arbitrary but deterministic 32-bit pixel value for the given
+ * index.
+ *
+ * @param i
+ *     The index of the pixel.
+ *
+ * @return
+ *     A 32-bit pixel value which varies in all four channels as the index
+ *     varies.
+ */
+static uint32_t test_pixel(int i) {
+    return ((uint32_t) (i * 2654435761u)) ^ (uint32_t) i;
+}
+
+/**
+ * Verifies that guac_pixel_fill_alpha() copies pixels verbatim except for
+ * forcing the alpha channel to fully opaque, including for run lengths that
+ * are not a multiple of the vector width.
+ */
+void test_pixel__fill_alpha() {
+
+    uint32_t src[TEST_PIXEL_COUNT];
+    uint32_t dst[TEST_PIXEL_COUNT];
+
+    for (int i = 0; i < TEST_PIXEL_COUNT; i++)
+        src[i] = test_pixel(i);
+
+    guac_pixel_fill_alpha(dst, src, TEST_PIXEL_COUNT);
+
+    for (int i = 0; i < TEST_PIXEL_COUNT; i++)
+        CU_ASSERT_EQUAL(dst[i], src[i] | 0xFF000000);
+
+}
+
+/**
+ * Verifies that guac_pixel_pack_rgb() packs the red, green, and blue
+ * channels of each 32-bit pixel into exactly three bytes, in that order,
+ * including for run lengths that are not a multiple of the vector width.
+ */
+void test_pixel__pack_rgb() {
+
+    uint32_t src[TEST_PIXEL_COUNT];
+    unsigned char dst[TEST_PIXEL_COUNT * 3];
+
+    for (int i = 0; i < TEST_PIXEL_COUNT; i++)
+        src[i] = test_pixel(i);
+
+    guac_pixel_pack_rgb(dst, src, TEST_PIXEL_COUNT);
+
+    for (int i = 0; i < TEST_PIXEL_COUNT; i++) {
+        CU_ASSERT_EQUAL(dst[i * 3],     (src[i] >> 16) & 0xFF);
+        CU_ASSERT_EQUAL(dst[i * 3 + 1], (src[i] >>  8) & 0xFF);
+        CU_ASSERT_EQUAL(dst[i * 3 + 2],  src[i]        & 0xFF);
+    }
+
+}
+
+/**
+ * Verifies that guac_pixel_unpack_rgb() expands packed 24-bit RGB pixels
+ * into fully-opaque 32-bit pixels, including for run lengths that are not a
+ * multiple of the vector width, and that packing and unpacking round-trip.
+ */
+void test_pixel__unpack_rgb() {
+
+    unsigned char src[TEST_PIXEL_COUNT * 3];
+    uint32_t dst[TEST_PIXEL_COUNT];
+
+    for (int i = 0; i < TEST_PIXEL_COUNT * 3; i++)
+        src[i] = (unsigned char) test_pixel(i);
+
+    guac_pixel_unpack_rgb(dst, src, TEST_PIXEL_COUNT);
+
+    for (int i = 0; i < TEST_PIXEL_COUNT; i++) {
+        uint32_t expected = 0xFF000000
+            | ((uint32_t) src[i * 3]     << 16)
+            | ((uint32_t) src[i * 3 + 1] <<  8)
+            |  (uint32_t) src[i * 3 + 2];
+        CU_ASSERT_EQUAL(dst[i], expected);
+    }
+
+    /* Packing the unpacked pixels must reproduce the original bytes */
+    unsigned char repacked[TEST_PIXEL_COUNT * 3];
+    guac_pixel_pack_rgb(repacked, dst, TEST_PIXEL_COUNT);
+
+    for (int i = 0; i < TEST_PIXEL_COUNT * 3; i++)
+        CU_ASSERT_EQUAL(repacked[i], src[i]);
+
+}
+
@@ -0,0 +1,142 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <CUnit/CUnit.h>
+#include <guacamole/pool.h>
+
+#include <pthread.h>
+
+/**
+ * The number of threads which will concurrently retrieve and free integers
+ * from the guac_pool being tested.
+ */
+#define CONCURRENT_THREADS 8
+
+/**
+ * The number of retrieve/free cycles each thread will perform.
+ */
+#define CONCURRENT_ITERATIONS 10000
+
+/**
+ * The exclusive upper bound enforced on all integers retrieved during the
+ * test. This is intentionally small relative to the number of threads and
+ * iterations, such that freed integers are constantly reused.
+ */
+#define CONCURRENT_LIMIT 64
+
+/**
+ * Shared state for all threads hammering the guac_pool being tested.
+ */
+typedef struct concurrent_test_state {
+
+    /**
+     * The guac_pool being tested.
+     */
+    guac_pool* pool;
+
+    /**
+     * Whether each integer below CONCURRENT_LIMIT is currently claimed by
+     * some thread. Accessed only via atomic operations.
+     */
+    int claimed[CONCURRENT_LIMIT];
+
+    /**
+     * The number of violations observed by all threads, where a violation is
+     * a retrieved integer that is out of bounds or already claimed by another
+     * thread. Accessed only via atomic operations.
+     */
+    int violations;
+
+} concurrent_test_state;
+
+/**
+ * Thread which repeatedly retrieves an integer from the shared guac_pool,
+ * verifies that no other thread currently holds that integer, and frees the
+ * integer back into the pool, counting any violations observed.
+ *
+ * @param data
+ *     The concurrent_test_state shared by all threads.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* concurrent_test_thread(void* data) {
+
+    concurrent_test_state* state = (concurrent_test_state*) data;
+
+    int i;
+    for (i = 0; i < CONCURRENT_ITERATIONS; i++) {
+
+        int value = guac_pool_next_int_below(state->pool, CONCURRENT_LIMIT);
+
+        /* Out-of-bounds values violate the limit contract (note that -1 is
+         * impossible here, as each of the integers below the limit would
+         * accommodate a claim from every thread) */
+        if (value < 0 || value >= CONCURRENT_LIMIT) {
+            __atomic_fetch_add(&state->violations, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        /* No other thread may hold this integer until it is freed again */
+        if (__atomic_exchange_n(&state->claimed[value], 1, __ATOMIC_ACQ_REL))
+            __atomic_fetch_add(&state->violations, 1, __ATOMIC_RELAXED);
+
+        __atomic_store_n(&state->claimed[value], 0, __ATOMIC_RELEASE);
+        guac_pool_free_int(state->pool, value);
+
+    }
+
+    return NULL;
+
+}
+
+/**
+ * Test which verifies that concurrent retrieval and freeing of integers never
+ * produces an integer that is simultaneously held by two threads, and that
+ * the number of active integers is tracked correctly throughout.
+ */
+void test_pool__concurrent() {
+
+    concurrent_test_state state = { 0 };
+
+    pthread_t threads[CONCURRENT_THREADS];
+    int i;
+
+    /* Get pool */
+    state.pool = guac_pool_alloc(0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(state.pool);
+
+    /* Hammer the pool from several threads at once */
+    for (i = 0; i < CONCURRENT_THREADS; i++)
+        CU_ASSERT_EQUAL_FATAL(0, pthread_create(&threads[i], NULL,
+                    concurrent_test_thread, &state));
+
+    for (i = 0; i < CONCURRENT_THREADS; i++)
+        pthread_join(threads[i], NULL);
+
+    /* No integer may ever have been held by two threads at once */
+    CU_ASSERT_EQUAL(0, state.violations);
+
+    /* All integers must have been returned to the pool */
+    CU_ASSERT_EQUAL(0, state.pool->active);
+
+    /* Free pool */
+    guac_pool_free(state.pool);
+
+}
@@ -0,0 +1,59 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <CUnit/CUnit.h>
+#include <guacamole/rect.h>
+
+/**
+ * Test which verifies that guac_rect_constrain_all() restricts each rectangle
+ * in an array to arbitrary bounds, producing the same result as invoking
+ * guac_rect_constrain() on each rectangle individually.
+ */
+void test_rect__constrain_all() {
+
+    guac_rect max;
+    guac_rect_init(&max, 0, 0, 100, 100);
+
+    guac_rect rects[3];
+    guac_rect_init(&rects[0], -10, -10, 110, 110);
+    guac_rect_init(&rects[1], 25, 25, 50, 50);
+    guac_rect_init(&rects[2], 90, 90, 50, 50);
+
+    guac_rect_constrain_all(rects, 3, &max);
+
+    /* Rectangle extending beyond all bounds is clipped on all edges */
+    CU_ASSERT_EQUAL(0, rects[0].left);
+    CU_ASSERT_EQUAL(0, rects[0].top);
+    CU_ASSERT_EQUAL(100, rects[0].right);
+    CU_ASSERT_EQUAL(100, rects[0].bottom);
+
+    /* Rectangle entirely within bounds is unaffected */
+    CU_ASSERT_EQUAL(25, rects[1].left);
+    CU_ASSERT_EQUAL(25, rects[1].top);
+    CU_ASSERT_EQUAL(75, rects[1].right);
+    CU_ASSERT_EQUAL(75, rects[1].bottom);
+
+    /* Rectangle extending beyond the lower-right corner is clipped only on
+     * its right and bottom edges */
+    CU_ASSERT_EQUAL(90, rects[2].left);
+    CU_ASSERT_EQUAL(90, rects[2].top);
+    CU_ASSERT_EQUAL(100, rects[2].right);
+    CU_ASSERT_EQUAL(100, rects[2].bottom);
+
+}
@@ -0,0 +1,70 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <CUnit/CUnit.h>
+#include <guacamole/rect.h>
+
+/**
+ * Test which verifies that guac_rect_extend_all() expands the given rectangle
+ * as necessary to contain every non-empty rectangle in an array, producing the
+ * same result as invoking guac_rect_extend() on each rectangle individually.
+ */
+void test_rect__extend_all() {
+
+    guac_rect rect;
+    guac_rect_init(&rect, 40, 40, 20, 20);
+
+    guac_rect rects[3];
+    guac_rect_init(&rects[0], 10, 10, 20, 20);
+
+    /* Empty rectangles (including those containing garbage coordinates) must
+     * not affect the union */
+    rects[1] = (guac_rect) { .left = 500, .top = 500, .right = 400, .bottom = 400 };
+
+    guac_rect_init(&rects[2], 80, 80, 20, 20);
+
+    guac_rect_extend_all(&rect, rects, 3);
+    CU_ASSERT_EQUAL(10, rect.left);
+    CU_ASSERT_EQUAL(10, rect.top);
+    CU_ASSERT_EQUAL(100, rect.right);
+    CU_ASSERT_EQUAL(100, rect.bottom);
+
+}
+
+/**
+ * Test which verifies that guac_rect_extend_all() leaves the given rectangle
+ * untouched if the given array contains only empty rectangles.
+ */
+void test_rect__extend_all_empty() {
+
+    guac_rect rect;
+    guac_rect_init(&rect, 40, 40, 20, 20);
+
+    guac_rect rects[2] = {
+        { .left = 500, .top = 500, .right = 400, .bottom = 400 },
+        { 0 }
+    };
+
+    guac_rect_extend_all(&rect, rects, 2);
+    CU_ASSERT_EQUAL(40, rect.left);
+    CU_ASSERT_EQUAL(40, rect.top);
+    CU_ASSERT_EQUAL(60, rect.right);
+    CU_ASSERT_EQUAL(60, rect.bottom);
+
+}
@@ -0,0 +1,135 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <CUnit/CUnit.h>
+#include <guacamole/rwlock.h>
+
+#include <pthread.h>
+#include <sched.h>
+
+/**
+ * Verifies that a single thread may acquire a guac_rwlock reentrantly, that
+ * a held read lock may be upgraded to a write lock, and that releasing a
+ * lock more times than it was acquired fails.
+ */
+void test_rwlock__reentrant() {
+
+    guac_rwlock lock;
+    guac_rwlock_init(&lock);
+
+    /* The lock may be acquired reentrantly, including upgrading a held read
+     * lock to a write lock */
+    CU_ASSERT_FALSE(guac_rwlock_acquire_read_lock(&lock));
+    CU_ASSERT_FALSE(guac_rwlock_acquire_read_lock(&lock));
+    CU_ASSERT_FALSE(guac_rwlock_acquire_write_lock(&lock));
+
+    /* Each acquisition must be matched by exactly one release */
+    CU_ASSERT_FALSE(guac_rwlock_release_lock(&lock));
+    CU_ASSERT_FALSE(guac_rwlock_release_lock(&lock));
+    CU_ASSERT_FALSE(guac_rwlock_release_lock(&lock));
+
+    /* Releasing a lock which is not held must fail */
+    CU_ASSERT_NOT_EQUAL(guac_rwlock_release_lock(&lock), 0);
+
+    guac_rwlock_destroy(&lock);
+
+}
+
+/**
+ * Verifies that the monitoring counters of a guac_rwlock count underlying
+ * acquisitions only, with reentrant acquisitions satisfied without touching
+ * the underlying lock.
+ */
+void test_rwlock__counters() {
+
+    guac_rwlock lock;
+    guac_rwlock_init(&lock);
+
+    /* Nested reads perform only one underlying acquisition */
+    CU_ASSERT_FALSE(guac_rwlock_acquire_read_lock(&lock));
+    CU_ASSERT_FALSE(guac_rwlock_acquire_read_lock(&lock));
+    CU_ASSERT_FALSE(guac_rwlock_release_lock(&lock));
+    CU_ASSERT_FALSE(guac_rwlock_release_lock(&lock));
+
+    CU_ASSERT_FALSE(guac_rwlock_acquire_write_lock(&lock));
+    CU_ASSERT_FALSE(guac_rwlock_release_lock(&lock));
+
+    CU_ASSERT_EQUAL(lock.read_acquires, 1);
+    CU_ASSERT_EQUAL(lock.write_acquires, 1);
+
+    /* Nothing can have contended in a single thread */
+    CU_ASSERT_EQUAL(lock.read_contended, 0);
+    CU_ASSERT_EQUAL(lock.write_contended, 0);
+
+    guac_rwlock_destroy(&lock);
+
+}
+
+/**
+ * Thread which acquires and immediately releases the write lock of the given
+ * guac_rwlock.
+ *
+ * @param data
+ *     The guac_rwlock to acquire.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* write_acquiring_thread(void* data) {
+
+    guac_rwlock* lock = (guac_rwlock*) data;
+
+    guac_rwlock_acquire_write_lock(lock);
+    guac_rwlock_release_lock(lock);
+
+    return NULL;
+
+}
+
+/**
+ * Verifies that a write acquisition which must wait for an active reader is
+ * counted as contended.
+ */
+void test_rwlock__contention_counted() {
+
+    guac_rwlock lock;
+    guac_rwlock_init(&lock);
+
+    /* Hold the read lock such that the writer thread must wait */
+    CU_ASSERT_FALSE(guac_rwlock_acquire_read_lock(&lock));
+
+    pthread_t writer;
+    CU_ASSERT_FALSE(pthread_create(&writer, NULL, write_acquiring_thread,
+                &lock));
+
+    /* The writer is guaranteed to observe contention, as the read lock is
+     * not released until the contended counter shows that the writer has
+     * attempted (and failed) immediate acquisition */
+    while (__atomic_load_n(&lock.write_contended, __ATOMIC_RELAXED) == 0)
+        sched_yield();
+
+    CU_ASSERT_FALSE(guac_rwlock_release_lock(&lock));
+    pthread_join(writer, NULL);
+
+    CU_ASSERT_EQUAL(lock.write_acquires, 1);
+    CU_ASSERT_EQUAL(lock.write_contended, 1);
+
+    guac_rwlock_destroy(&lock);
+
+}
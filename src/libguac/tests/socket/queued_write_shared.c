@@ -0,0 +1,165 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <CUnit/CUnit.h>
+#include <guacamole/mem.h>
+#include <guacamole/protocol.h>
+#include <guacamole/socket.h>
+#include <guacamole/socket-queued.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * A pre-serialized Guacamole protocol instruction, as would be shared across
+ * the sockets of multiple connected users by a broadcast socket.
+ */
+#define SHARED_INSTRUCTION "4.sync,5.12345,1.1;"
+
+/**
+ * Writes a normal instruction, a shared pre-serialized instruction (written
+ * by reference via guac_socket_write_shared()), and a final normal
+ * instruction using a queued guac_socket wrapping a normal guac_socket for
+ * the given file descriptor. The instructions written correspond to the
+ * instructions verified by read_expected_instructions(). The given file
+ * descriptor is automatically closed as a result of calling this function.
+ *
+ * @param fd
+ *     The file descriptor to write instructions to.
+ */
+static void write_instructions(int fd) {
+
+    /* Open guac socket */
+    guac_socket* socket = guac_socket_open(fd);
+
+    /* Write nothing if socket cannot be allocated (test will fail in parent
+     * process due to failure to read) */
+    if (socket == NULL) {
+        close(fd);
+        return;
+    }
+
+    /* Wrap fd socket in queued socket */
+    socket = guac_socket_queued(socket);
+    if (socket == NULL) {
+        close(fd);
+        return;
+    }
+
+    /* Write normal instruction */
+    guac_protocol_send_name(socket, "test");
+
+    /* Wrap a copy of the pre-serialized instruction in a shared buffer,
+     * exactly as a broadcast socket would */
+    char* data = guac_mem_alloc(sizeof(SHARED_INSTRUCTION) - 1);
+    memcpy(data, SHARED_INSTRUCTION, sizeof(SHARED_INSTRUCTION) - 1);
+    guac_socket_shared_buffer* shared = guac_socket_shared_buffer_alloc(data,
+            sizeof(SHARED_INSTRUCTION) - 1);
+
+    /* Write the shared buffer by reference (the queued socket takes its own
+     * reference, which keeps the buffer allocated until written) */
+    guac_socket_instruction_begin(socket);
+    guac_socket_write_shared(socket, shared);
+    guac_socket_instruction_end(socket);
+    guac_socket_shared_buffer_unref(shared);
+
+    /* Write final normal instruction */
+    guac_protocol_send_sync(socket, 99999, 2);
+    guac_socket_flush(socket);
+
+    /* Close and free socket */
+    guac_socket_free(socket);
+
+}
+
+/**
+ * Reads raw bytes from the given file descriptor until no further bytes
+ * remain, verifying that those bytes represent the series of Guacamole
+ * instructions expected to be written by write_instructions(). The given
+ * file descriptor is automatically closed as a result of calling this
+ * function.
+ *
+ * @param fd
+ *     The file descriptor to read data from.
+ */
+static void read_expected_instructions(int fd) {
+
+    char expected[] =
+        "4.name,4.test;"
+        SHARED_INSTRUCTION
+        "4.sync,5.99999,1.2;";
+
+    int numread;
+    char buffer[1024];
+    int offset = 0;
+
+    /* Read everything available into buffer */
+    while ((numread = read(fd, &(buffer[offset]),
+                    sizeof(buffer) - offset)) > 0) {
+        offset += numread;
+    }
+
+    /* Verify length of read data */
+    CU_ASSERT_EQUAL(offset, strlen(expected));
+
+    /* Add NULL terminator */
+    buffer[offset] = '\0';
+
+    /* Read value should be equal to expected value */
+    CU_ASSERT_STRING_EQUAL(buffer, expected);
+
+    /* File descriptor is no longer needed */
+    close(fd);
+
+}
+
+/**
+ * Tests that the queued implementation of guac_socket properly implements
+ * writing of shared pre-serialized buffers via guac_socket_write_shared(),
+ * writing the shared data to the wrapped socket in order relative to
+ * normally-written instructions. A child process is forked to write a series
+ * of instructions which are read and verified by the parent process.
+ */
+void test_socket__queued_write_shared() {
+
+    int fd[2];
+
+    /* Create pipe */
+    CU_ASSERT_EQUAL_FATAL(pipe(fd), 0);
+
+    int read_fd = fd[0];
+    int write_fd = fd[1];
+
+    /* Fork into writer process (child) and reader process (parent) */
+    int childpid;
+    CU_ASSERT_NOT_EQUAL_FATAL((childpid = fork()), -1);
+
+    /* Attempt to write a series of instructions within the child process */
+    if (childpid == 0) {
+        close(read_fd);
+        write_instructions(write_fd);
+        exit(0);
+    }
+
+    /* Read and verify the expected instructions within the parent process */
+    close(write_fd);
+    read_expected_instructions(read_fd);
+
+}
@@ -0,0 +1,156 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <CUnit/CUnit.h>
+#include <guacamole/protocol.h>
+#include <guacamole/socket.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * Test string which contains exactly four Unicode characters encoded in UTF-8.
+ * This particular test string uses several characters which encode to multiple
+ * bytes in UTF-8.
+ */
+#define UTF8_4 "\xe7\x8a\xac\xf0\x90\xac\x80z\xc3\xa1"
+
+/**
+ * Writes a series of Guacamole instructions using an asynchronous tee
+ * guac_socket wrapping a pair of normal guac_sockets for the given file
+ * descriptors. The instructions written correspond to the instructions
+ * verified by read_expected_instructions(). The given file descriptors are
+ * automatically closed as a result of calling this function.
+ *
+ * @param primary_fd
+ *     The file descriptor to write instructions to via the primary socket.
+ *
+ * @param secondary_fd
+ *     The file descriptor which should asynchronously receive a copy of all
+ *     written instructions via the secondary socket.
+ */
+static void write_instructions(int primary_fd, int secondary_fd) {
+
+    /* Open guac sockets */
+    guac_socket* primary = guac_socket_open(primary_fd);
+    guac_socket* secondary = guac_socket_open(secondary_fd);
+
+    /* Write nothing if sockets cannot be allocated (test will fail in parent
+     * process due to failure to read) */
+    if (primary == NULL || secondary == NULL) {
+        close(primary_fd);
+        close(secondary_fd);
+        return;
+    }
+
+    /* Wrap both sockets in asynchronous tee socket */
+    guac_socket* socket = guac_socket_tee_async(primary, secondary);
+    if (socket == NULL) {
+        close(primary_fd);
+        close(secondary_fd);
+        return;
+    }
+
+    /* Write instructions */
+    guac_protocol_send_name(socket, "a" UTF8_4 "b" UTF8_4 "c");
+    guac_protocol_send_sync(socket, 12345, 1);
+    guac_socket_flush(socket);
+
+    /* Close and free socket (blocks until the spool has been drained) */
+    guac_socket_free(socket);
+
+}
+
+/**
+ * Reads raw bytes from the given file descriptor until no further bytes
+ * remain, verifying that those bytes represent the series of Guacamole
+ * instructions expected to be written by write_instructions(). The given
+ * file descriptor is automatically closed as a result of calling this
+ * function.
+ *
+ * @param fd
+ *     The file descriptor to read data from.
+ */
+static void read_expected_instructions(int fd) {
+
+    char expected[] =
+        "4.name,11.a" UTF8_4 "b" UTF8_4 "c;"
+        "4.sync,5.12345,1.1;";
+
+    int numread;
+    char buffer[1024];
+    int offset = 0;
+
+    /* Read everything available into buffer */
+    while ((numread = read(fd, &(buffer[offset]),
+                    sizeof(buffer) - offset)) > 0) {
+        offset += numread;
+    }
+
+    /* Verify length of read data */
+    CU_ASSERT_EQUAL(offset, strlen(expected));
+
+    /* Add NULL terminator */
+    buffer[offset] = '\0';
+
+    /* Read value should be equal to expected value */
+    CU_ASSERT_STRING_EQUAL(buffer, expected);
+
+    /* File descriptor is no longer needed */
+    close(fd);
+
+}
+
+/**
+ * Tests that the asynchronous tee implementation of guac_socket properly
+ * implements writing of instructions, writing each instruction to both the
+ * primary and secondary sockets exactly as it would have been written
+ * directly. A child process is forked to write a series of instructions
+ * which are read and verified by the parent process.
+ */
+void test_socket__tee_async_send_instruction() {
+
+    int primary[2];
+    int secondary[2];
+
+    /* Create pipes */
+    CU_ASSERT_EQUAL_FATAL(pipe(primary), 0);
+    CU_ASSERT_EQUAL_FATAL(pipe(secondary), 0);
+
+    /* Fork into writer process (child) and reader process (parent) */
+    int childpid;
+    CU_ASSERT_NOT_EQUAL_FATAL((childpid = fork()), -1);
+
+    /* Attempt to write a series of instructions within the child process */
+    if (childpid == 0) {
+        close(primary[0]);
+        close(secondary[0]);
+        write_instructions(primary[1], secondary[1]);
+        exit(0);
+    }
+
+    /* Read and verify that the expected instructions were received by both
+     * the primary and secondary sockets within the parent process */
+    close(primary[1]);
+    close(secondary[1]);
+    read_expected_instructions(primary[0]);
+    read_expected_instructions(secondary[0]);
+
+}
@@ -0,0 +1,99 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "guacamole/string.h"
+
+#include <CUnit/CUnit.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Verifies that guac_itoa64() produces the same string for the given value
+ * as the equivalent call to snprintf(), and that the returned length matches
+ * the length of that string.
+ *
+ * @param value
+ *     The value to convert.
+ */
+static void verify_conversion(int64_t value) {
+
+    char expected[GUAC_ITOA64_BUFFER_SIZE];
+    snprintf(expected, sizeof(expected), "%"PRIi64, value);
+
+    char buffer[GUAC_ITOA64_BUFFER_SIZE];
+    int length = guac_itoa64(buffer, value);
+
+    CU_ASSERT_STRING_EQUAL(buffer, expected);
+    CU_ASSERT_EQUAL(length, strlen(expected));
+
+}
+
+/**
+ * Test which verifies that guac_itoa64() correctly converts values having
+ * every possible number of digits, both positive and negative.
+ */
+void test_string__itoa64_digit_boundaries() {
+
+    verify_conversion(0);
+
+    /* Verify conversion of the smallest and largest values having each
+     * possible number of digits */
+    for (int64_t boundary = 1; boundary <= INT64_MAX / 10; boundary *= 10) {
+
+        verify_conversion(boundary);
+        verify_conversion(boundary - 1);
+        verify_conversion(boundary + 1);
+
+        verify_conversion(-boundary);
+        verify_conversion(-(boundary - 1));
+        verify_conversion(-(boundary + 1));
+
+    }
+
+}
+
+/**
+ * Test which verifies that guac_itoa64() correctly converts the extreme
+ * values of the 64-bit integer range.
+ */
+void test_string__itoa64_extremes() {
+    verify_conversion(INT64_MAX);
+    verify_conversion(INT64_MAX - 1);
+    verify_conversion(INT64_MIN);
+    verify_conversion(INT64_MIN + 1);
+}
+
+/**
+ * Test which verifies that guac_itoa64() correctly converts a representative
+ * spread of arbitrary values.
+ */
+void test_string__itoa64_arbitrary() {
+
+    verify_conversion(42);
+    verify_conversion(-42);
+    verify_conversion(100);
+    verify_conversion(1024);
+    verify_conversion(65535);
+    verify_conversion(-65536);
+    verify_conversion(1000000007);
+    verify_conversion(-987654321012345678);
+
+}
@@ -55,5 +55,14 @@ void test_unicode__utf8_strlen() {
     CU_ASSERT_EQUAL(3, guac_utf8_strlen(UTF8_3b UTF8_4b UTF8_2b));
     CU_ASSERT_EQUAL(5, guac_utf8_strlen("hello"));
     CU_ASSERT_EQUAL(9, guac_utf8_strlen("guacamole"));
+
+    /* Strings longer than eight bytes, including multi-byte characters which
+     * straddle eight-byte boundaries */
+    CU_ASSERT_EQUAL(26, guac_utf8_strlen("abcdefghijklmnopqrstuvwxyz"));
+    CU_ASSERT_EQUAL(8, guac_utf8_strlen(UTF8_1b UTF8_2b UTF8_3b UTF8_4b
+                UTF8_4b UTF8_3b UTF8_2b UTF8_1b));
+    CU_ASSERT_EQUAL(10, guac_utf8_strlen("guacamole" UTF8_4b));
+    CU_ASSERT_EQUAL(11, guac_utf8_strlen("1234567" UTF8_3b UTF8_3b
+                UTF8_2b UTF8_4b));
 }
 
@@ -57,6 +57,31 @@ guac_timestamp guac_timestamp_current() {
 
 }
 
+guac_timestamp guac_timestamp_current_coarse() {
+
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC_COARSE)
+
+    struct timespec current;
+
+    /* Get current time from the kernel-cached coarse clock, which shares the
+     * epoch of CLOCK_MONOTONIC but is simply read from memory (it is updated
+     * by the kernel once per tick, and reading it does not touch the
+     * underlying hardware counter) */
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &current);
+
+    /* Calculate milliseconds */
+    return (guac_timestamp) current.tv_sec * 1000 + current.tv_nsec / 1000000;
+
+#else
+
+    /* Fall back to the precise time source on platforms that do not maintain
+     * a coarse clock */
+    return guac_timestamp_current();
+
+#endif
+
+}
+
 void guac_timestamp_msleep(int duration) {
 
     /* Split milliseconds into equivalent seconds + nanoseconds */
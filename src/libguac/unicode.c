@@ -22,6 +22,8 @@
 #include "guacamole/unicode.h"
 
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 
 size_t guac_utf8_charsize(unsigned char c) {
 
@@ -38,30 +40,48 @@ size_t guac_utf8_charsize(unsigned char c) {
 
 size_t guac_utf8_strlen(const char* str) {
 
-    /* The current length of the string */
-    int length = 0;
+    /* The number of characters in a UTF-8 string is the number of bytes which
+     * are NOT continuation bytes (bytes of the form 10xxxxxx). Determine the
+     * overall length in bytes up front such that the remaining bytes can be
+     * counted a word at a time. */
+    size_t remaining = strlen(str);
 
-    /* Number of characters before start of next character */
-    int skip = 0;
+    /* The current length of the string, in characters */
+    size_t length = 0;
 
-    while (*str != 0) {
+    /* Count continuation bytes eight at a time. A byte is a continuation byte
+     * if and only if its most-significant bit is set and the bit below it is
+     * clear, so shifting the word left by one bit aligns each byte's second
+     * bit with its own most-significant bit, and a mask then isolates one
+     * flag bit per continuation byte. */
+    while (remaining >= 8) {
 
-        /* If skipping, then skip */
-        if (skip > 0) skip--;
+        uint64_t word;
+        memcpy(&word, str, sizeof(word));
 
-        /* Otherwise, determine next skip value, and increment length */
-        else {
+        uint64_t continuations = word & ~(word << 1)
+            & UINT64_C(0x8080808080808080);
 
-            /* Get next character */
-            unsigned char c = (unsigned char) *str;
+        /* Sum the per-byte flag bits to get the number of continuation bytes
+         * within this word */
+        uint64_t count =
+            ((continuations >> 7) * UINT64_C(0x0101010101010101)) >> 56;
 
-            /* Determine skip value (size in bytes of rest of character) */
-            skip = guac_utf8_charsize(c) - 1;
+        length += 8 - count;
+        str += 8;
+        remaining -= 8;
 
+    }
+
+    /* Count any remaining bytes individually */
+    while (remaining > 0) {
+
+        unsigned char c = (unsigned char) *(str++);
+        if ((c & 0xC0) != 0x80)
             length++;
-        }
 
-        str++;
+        remaining--;
+
     }
 
     return length;
@@ -30,6 +30,7 @@
 #include "user-handlers.h"
 
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -104,11 +105,14 @@ static int64_t __guac_parse_int(const char* str) {
 /* Guacamole instruction handlers */
 
 int __guac_handle_sync(guac_user* user, int argc, char** argv) {
+    return __guac_handle_sync_parsed(user, __guac_parse_int(argv[0]));
+}
+
+int __guac_handle_sync_parsed(guac_user* user, guac_timestamp timestamp) {
 
     int frame_duration;
 
-    guac_timestamp current = guac_timestamp_current();
-    guac_timestamp timestamp = __guac_parse_int(argv[0]);
+    guac_timestamp current = guac_timestamp_current_coarse();
 
     /* Error if timestamp is in future */
     if (timestamp > user->client->last_sent_timestamp)
@@ -757,18 +761,99 @@ void guac_free_mimetypes(char** mimetypes) {
 
 }
 
+/**
+ * A dispatch table indexing the entries of a handler map by the first
+ * character of their opcodes. Each entry is the head of a chain of mappings
+ * sharing that first character (linked through their __next_same_first
+ * members), or NULL if the map contains no opcode beginning with that
+ * character.
+ */
+typedef __guac_instruction_handler_mapping*
+    __guac_instruction_dispatch_table[256];
+
+/**
+ * Dispatch table indexing __guac_instruction_handler_map by first character.
+ */
+static __guac_instruction_dispatch_table __guac_instruction_dispatch;
+
+/**
+ * Dispatch table indexing __guac_handshake_handler_map by first character.
+ */
+static __guac_instruction_dispatch_table __guac_handshake_dispatch;
+
+/**
+ * Ensures that the dispatch tables for both handler maps have been built.
+ *
+ * @see __guac_build_dispatch_tables()
+ */
+static pthread_once_t __guac_dispatch_tables_built = PTHREAD_ONCE_INIT;
+
+/**
+ * Builds the given dispatch table from the given handler map, chaining
+ * together all entries of the map whose opcodes share the same first
+ * character. The relative order of chained entries matches their order
+ * within the map.
+ *
+ * @param table
+ *     The dispatch table to build.
+ *
+ * @param map
+ *     The NULL-terminated handler map to index.
+ */
+static void __guac_build_dispatch_table(
+        __guac_instruction_dispatch_table table,
+        __guac_instruction_handler_mapping* map) {
+
+    /* Count entries within map */
+    int length = 0;
+    while (map[length].opcode != NULL)
+        length++;
+
+    /* Prepend each entry to the chain for its first character, iterating in
+     * reverse such that each chain preserves the order of the map */
+    for (int i = length - 1; i >= 0; i--) {
+        unsigned char first = (unsigned char) map[i].opcode[0];
+        map[i].__next_same_first = table[first];
+        table[first] = &map[i];
+    }
+
+}
+
+/**
+ * Builds the dispatch tables for both the main instruction handler map and
+ * the handshake handler map. This function is invoked exactly once per
+ * process, upon the first dispatch of any opcode.
+ */
+static void __guac_build_dispatch_tables() {
+    __guac_build_dispatch_table(__guac_instruction_dispatch,
+            __guac_instruction_handler_map);
+    __guac_build_dispatch_table(__guac_handshake_dispatch,
+            __guac_handshake_handler_map);
+}
+
 int __guac_user_call_opcode_handler(__guac_instruction_handler_mapping* map,
         guac_user* user, const char* opcode, int argc, char** argv) {
 
-    /* For each defined instruction */
-    __guac_instruction_handler_mapping* current = map;
-    while (current->opcode != NULL) {
+    pthread_once(&__guac_dispatch_tables_built, __guac_build_dispatch_tables);
+
+    unsigned char first = (unsigned char) opcode[0];
+
+    /* Consider only the chain of opcodes sharing the received instruction's
+     * first character (at most a few entries), rather than scanning the
+     * entire map for every received instruction */
+    __guac_instruction_handler_mapping* current;
+    if (map == __guac_instruction_handler_map)
+        current = __guac_instruction_dispatch[first];
+    else
+        current = __guac_handshake_dispatch[first];
+
+    while (current != NULL) {
 
         /* If recognized, call handler */
         if (strcmp(opcode, current->opcode) == 0)
             return current->handler(user, argc, argv);
 
-        current++;
+        current = current->__next_same_first;
     }
 
     /* If unrecognized, log and ignore */
@@ -68,6 +68,15 @@ typedef struct __guac_instruction_handler_mapping {
      */
     __guac_instruction_handler* handler;
 
+    /**
+     * The next mapping within the same handler map whose opcode shares the
+     * same first character, or NULL if there is no such mapping. This chain
+     * is built once per process when an opcode is first dispatched, allowing
+     * dispatch to consider only the handful of opcodes sharing the received
+     * instruction's first character rather than scanning the entire map.
+     */
+    struct __guac_instruction_handler_mapping* __next_same_first;
+
 } __guac_instruction_handler_mapping;
 
 /**
@@ -77,6 +86,24 @@ typedef struct __guac_instruction_handler_mapping {
  */
 __guac_instruction_handler __guac_handle_sync;
 
+/**
+ * Processes a sync instruction whose timestamp has already been parsed,
+ * updating the lag estimates of the given user and invoking the user's sync
+ * handler, if any. This is the common implementation underlying
+ * __guac_handle_sync() and the input fast lane, which parses the timestamp
+ * of buffered sync instructions without producing an argument array.
+ *
+ * @param user
+ *     The user that the sync instruction was received from.
+ *
+ * @param timestamp
+ *     The timestamp contained within the sync instruction.
+ *
+ * @return
+ *     Zero if the sync was processed successfully, non-zero otherwise.
+ */
+int __guac_handle_sync_parsed(guac_user* user, guac_timestamp timestamp);
+
 /**
  * Internal initial handler for the mouse instruction. When a mouse instruction
  * is received, this handler will be called. The client's mouse handler will
@@ -287,8 +314,10 @@ char** guac_copy_mimetypes(char** mimetypes, int count);
  * no match is found, it is silently ignored.
  *
  * @param map
- *     The array that holds the opcode to handler mappings.
- * 
+ *     The array that holds the opcode to handler mappings. This must be
+ *     either __guac_instruction_handler_map or __guac_handshake_handler_map;
+ *     dispatch is performed through a per-map index built on first use.
+ *
  * @param user
  *     The user whose handlers should be called.
  *
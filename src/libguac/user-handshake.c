@@ -91,6 +91,178 @@ static void guac_user_log_guac_error(guac_user* user,
 
 }
 
+/**
+ * Attempts to recognize and dispatch a single complete "mouse", "key", or
+ * "sync" instruction directly from the unparsed data already buffered within
+ * the given parser. These three opcodes dominate client-to-server traffic and
+ * have fixed small shapes consisting entirely of decimal elements, so they
+ * can be matched against their exact framing and dispatched with
+ * stack-allocated integer arguments, bypassing the generic element array and
+ * opcode dispatch entirely.
+ *
+ * Anything that does not exactly match one of the expected shapes (including
+ * partially-received instructions) is left untouched for the generic parser.
+ * Mouse instructions are also left to the generic path whenever the client
+ * has opted into mouse event coalescing, which operates on parsed
+ * instructions.
+ *
+ * @param user
+ *     The user that input is being received from.
+ *
+ * @param parser
+ *     The parser buffering that user's received data.
+ *
+ * @return
+ *     A positive value if an instruction was recognized and dispatched
+ *     successfully, zero if no instruction was recognized (and the generic
+ *     parser must be used), or a negative value if an instruction was
+ *     recognized but its handler failed.
+ */
+static int guac_user_try_input_fast_lane(guac_user* user,
+        guac_parser* parser) {
+
+    /* The fast lane applies only between instructions, never while an
+     * instruction is partially parsed */
+    if (parser->state != GUAC_PARSE_COMPLETE)
+        return 0;
+
+    char* start = parser->__instructionbuf_unparsed_start;
+    size_t available = parser->__instructionbuf_unparsed_end - start;
+
+    const char* opcode;
+    int expected_argc;
+    char* current;
+
+    /* Identify the instruction by its fixed framing prefix */
+    if (available >= 8 && memcmp(start, "5.mouse,", 8) == 0) {
+
+        /* Mouse coalescing consumes runs of parsed mouse instructions and
+         * must see every mouse event via the generic path */
+        if (user->client->coalesce_mouse_events)
+            return 0;
+
+        opcode = "mouse";
+        expected_argc = 3;
+        current = start + 8;
+
+    }
+    else if (available >= 6 && memcmp(start, "3.key,", 6) == 0) {
+        opcode = "key";
+        expected_argc = 2;
+        current = start + 6;
+    }
+    else if (available >= 7 && memcmp(start, "4.sync,", 7) == 0) {
+        opcode = "sync";
+        expected_argc = 1;
+        current = start + 7;
+    }
+    else
+        return 0;
+
+    char* end = start + available;
+    int64_t argv[3] = { 0 };
+    int argc = 0;
+
+    /* Parse the expected series of purely-decimal elements (as all accepted
+     * characters are single-byte, each element's declared length in
+     * characters is also its length in bytes) */
+    for (;;) {
+
+        /* Parse element length (a signed 64-bit decimal value spans at most
+         * 20 characters, so longer elements cannot be numeric arguments) */
+        int declared_length = 0;
+        int length_digits = 0;
+        while (current != end && *current >= '0' && *current <= '9'
+                && length_digits < GUAC_INSTRUCTION_MAX_DIGITS) {
+            declared_length = declared_length * 10 + *current - '0';
+            length_digits++;
+            current++;
+        }
+
+        if (current == end || *current != '.'
+                || length_digits == 0 || declared_length > 20)
+            return 0;
+        current++;
+
+        /* The entire element (and its terminator) must already be buffered */
+        if ((size_t) (end - current) < (size_t) declared_length + 1)
+            return 0;
+
+        /* Parse element value, which must be entirely decimal (with an
+         * optional leading sign) */
+        char* value_end = current + declared_length;
+        int64_t value = 0;
+        int negate = 0;
+
+        if (current != value_end && *current == '-') {
+            negate = 1;
+            current++;
+        }
+
+        if (current == value_end)
+            return 0;
+
+        while (current != value_end) {
+            if (*current < '0' || *current > '9')
+                return 0;
+            value = value * 10 + *current - '0';
+            current++;
+        }
+
+        argv[argc++] = negate ? -value : value;
+
+        /* Elements continue until the instruction terminator, which must
+         * arrive exactly at the expected element count */
+        char terminator = *(current++);
+        if (terminator == ';') {
+            if (argc != expected_argc)
+                return 0;
+            break;
+        }
+        if (terminator != ',' || argc == expected_argc)
+            return 0;
+
+    }
+
+    /* The instruction has been fully recognized and can now be consumed */
+    parser->__instructionbuf_unparsed_start = current;
+
+    /* Reset guac_error and guac_error_message (user/client handlers are not
+     * guaranteed to set these) */
+    guac_error = GUAC_STATUS_SUCCESS;
+    guac_error_message = NULL;
+
+    /* Invoke the relevant handler with the parsed arguments */
+    int result = 0;
+    if (expected_argc == 3) {
+        if (user->mouse_handler)
+            result = user->mouse_handler(user, (int) argv[0], (int) argv[1],
+                    (int) argv[2]);
+    }
+    else if (expected_argc == 2) {
+        if (user->key_handler)
+            result = user->key_handler(user, (int) argv[0], (int) argv[1]);
+    }
+    else
+        result = __guac_handle_sync_parsed(user, (guac_timestamp) argv[0]);
+
+    /* Stop on error as with the generic dispatch path */
+    if (result) {
+
+        guac_user_log_guac_error(user, GUAC_LOG_WARNING,
+                "User connection aborted");
+
+        guac_user_log(user, GUAC_LOG_DEBUG, "Failing instruction handler "
+                "in user was \"%s\"", opcode);
+
+        return -1;
+
+    }
+
+    return 1;
+
+}
+
 /**
  * Logs a reasonable explanatory message regarding handshake failure based on
  * the current value of guac_error.
@@ -141,6 +313,16 @@ static void* guac_user_input_thread(void* data) {
     /* Guacamole user input loop */
     while (client->state == GUAC_CLIENT_RUNNING && user->active) {
 
+        /* Dispatch buffered mouse/key/sync instructions directly, without
+         * involving the generic parser or dispatch table */
+        int fast_result = guac_user_try_input_fast_lane(user, parser);
+        if (fast_result > 0)
+            continue;
+        if (fast_result < 0) {
+            guac_user_stop(user);
+            return NULL;
+        }
+
         /* Read instruction, stop on error */
         if (guac_parser_read(parser, socket, usec_timeout)) {
 
@@ -162,8 +344,78 @@ static void* guac_user_input_thread(void* data) {
         guac_error = GUAC_STATUS_SUCCESS;
         guac_error_message = NULL;
 
+        /* If the client has opted in, collapse runs of mouse events which
+         * report only movement (leaving the button mask unchanged) to the
+         * latest received position, dispatching a single event for the whole
+         * run rather than one per received instruction */
+        if (client->coalesce_mouse_events
+                && strcmp(parser->opcode, "mouse") == 0 && parser->argc >= 3) {
+
+            int x = atoi(parser->argv[0]);
+            int y = atoi(parser->argv[1]);
+            int mask = atoi(parser->argv[2]);
+
+            /* Consume any further instructions already received, stopping at
+             * the first which is not a pure mouse movement */
+            int pending = 0;
+            while (client->state == GUAC_CLIENT_RUNNING && user->active) {
+
+                /* Stop coalescing once all received input has been consumed
+                 * (a zero-length timeout reads only buffered instructions) */
+                if (guac_parser_read(parser, socket, 0)) {
+
+                    if (guac_error != GUAC_STATUS_TIMEOUT) {
+                        if (guac_error != GUAC_STATUS_CLOSED)
+                            guac_user_log_guac_error(user, GUAC_LOG_WARNING,
+                                    "Guacamole connection failure");
+                        guac_user_stop(user);
+                        return NULL;
+                    }
+
+                    break;
+
+                }
+
+                /* Absorb mouse events which only update the position */
+                if (strcmp(parser->opcode, "mouse") == 0 && parser->argc >= 3
+                        && atoi(parser->argv[2]) == mask) {
+                    x = atoi(parser->argv[0]);
+                    y = atoi(parser->argv[1]);
+                    continue;
+                }
+
+                /* Any other instruction ends the run and must be dispatched
+                 * normally after the coalesced mouse event */
+                pending = 1;
+                break;
+
+            }
+
+            /* Dispatch the coalesced mouse event, stopping on error as with
+             * any other handler */
+            if (user->mouse_handler
+                    && user->mouse_handler(user, x, y, mask)) {
+
+                guac_user_log_guac_error(user, GUAC_LOG_WARNING,
+                        "User connection aborted");
+
+                guac_user_log(user, GUAC_LOG_DEBUG, "Failing instruction "
+                        "handler in user was \"mouse\"");
+
+                guac_user_stop(user);
+                return NULL;
+
+            }
+
+            /* If the run ended because all received input was consumed,
+             * there is no further instruction to dispatch */
+            if (!pending)
+                continue;
+
+        }
+
         /* Call handler, stop on error */
-        if (__guac_user_call_opcode_handler(__guac_instruction_handler_map, 
+        if (__guac_user_call_opcode_handler(__guac_instruction_handler_map,
                 user, parser->opcode, parser->argc, parser->argv)) {
 
             /* Log error */
@@ -304,9 +556,19 @@ int guac_user_handle_connection(guac_user* user, int usec_timeout) {
     int num_args;
     for (num_args = 0; client->args[num_args] != NULL; num_args++);
     
-    /* Send args */
-    if (guac_protocol_send_args(socket, client->args)
-            || guac_socket_flush(socket)) {
+    /* Send args, reusing the instruction rendered when the client plugin was
+     * loaded rather than rebuilding it for each new user */
+    int args_error;
+    if (client->__cached_args != NULL) {
+        guac_socket_instruction_begin(socket);
+        args_error = guac_socket_write(socket, client->__cached_args,
+                client->__cached_args_length);
+        guac_socket_instruction_end(socket);
+    }
+    else
+        args_error = guac_protocol_send_args(socket, client->args);
+
+    if (args_error || guac_socket_flush(socket)) {
 
         /* Log error */
         guac_user_log_handshake_failure(user);
@@ -27,6 +27,7 @@
 #include "guacamole/object.h"
 #include "guacamole/pool.h"
 #include "guacamole/protocol.h"
+#include "guacamole/protocol-constants.h"
 #include "guacamole/socket.h"
 #include "guacamole/stream.h"
 #include "guacamole/string.h"
@@ -52,7 +53,7 @@ guac_user* guac_user_alloc() {
         return NULL;
     }
 
-    user->last_received_timestamp = guac_timestamp_current();
+    user->last_received_timestamp = guac_timestamp_current_coarse();
     user->last_frame_duration = 0;
     user->processing_lag = 0;
     user->active = 1;
@@ -360,6 +361,49 @@ int guac_user_supports_webp(guac_user* user) {
 
 }
 
+int guac_user_supports_cell_runs(guac_user* user) {
+
+    const char** mimetype = user->info.image_mimetypes;
+
+    /* Search for cells pseudo mimetype in list of supported image
+     * mimetypes */
+    while (*mimetype != NULL) {
+
+        /* If cells mimetype found, no need to search further */
+        if (strcmp(*mimetype, GUAC_PROTOCOL_CELLS_MIMETYPE) == 0)
+            return 1;
+
+        /* Next mimetype */
+        mimetype++;
+
+    }
+
+    /* User does not support the cells instruction */
+    return 0;
+
+}
+
+int guac_user_supports_video(guac_user* user, const char* mimetype) {
+
+    const char** video_mimetype = user->info.video_mimetypes;
+
+    /* Search for given mimetype in list of supported video mimetypes */
+    while (*video_mimetype != NULL) {
+
+        /* If mimetype found, no need to search further */
+        if (strcmp(*video_mimetype, mimetype) == 0)
+            return 1;
+
+        /* Next mimetype */
+        video_mimetype++;
+
+    }
+
+    /* User does not support the given video mimetype */
+    return 0;
+
+}
+
 char* guac_user_parse_args_string(guac_user* user, const char** arg_names,
         const char** argv, int index, const char* default_value) {
 
@@ -19,19 +19,396 @@
 
 #include "config.h"
 
+#include "guacamole/client.h"
 #include "guacamole/error.h"
+#include "guacamole/mem.h"
+#include "guacamole/string.h"
 #include "guacamole/tcp.h"
 #include "guacamole/timestamp.h"
 #include "guacamole/wol.h"
 
+#include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 
+/**
+ * The number of entries within the shared Wake-on-LAN registry. Each entry
+ * tracks the wake state of one remote host. The registry is a small,
+ * fixed-size table, as only hosts woken within the last few minutes are
+ * relevant; older entries are simply reused.
+ */
+#define GUAC_WOL_REGISTRY_SIZE 8
+
+/**
+ * The maximum length of the key identifying a remote host within the shared
+ * Wake-on-LAN registry, in bytes, including the null terminator. The key is
+ * the hostname and TCP port being polled. Hosts whose keys would exceed this
+ * length bypass the registry entirely.
+ */
+#define GUAC_WOL_REGISTRY_KEY_LENGTH 256
+
+/**
+ * The amount of time after a magic Wake-on-LAN packet has been sent to a
+ * remote host during which further wake attempts for that same host will not
+ * send additional packets, in milliseconds. Concurrent connections to a
+ * single parked host thus coalesce into one wake cycle, with all connections
+ * simply polling for the host to come up.
+ */
+#define GUAC_WOL_WAKE_COALESCE_INTERVAL 60000
+
+/**
+ * The amount of time after a remote host has been observed reachable during
+ * which further wake attempts for that same host succeed immediately, without
+ * probing the host again, in milliseconds. This is kept short, as hosts that
+ * were recently reachable can nonetheless go down at any time.
+ */
+#define GUAC_WOL_REACHABLE_INTERVAL 5000
+
+/**
+ * The wake state of a single remote host within the shared Wake-on-LAN
+ * registry.
+ */
+typedef struct guac_wol_registry_entry {
+
+    /**
+     * The key identifying the remote host (the hostname and TCP port being
+     * polled, separated by a slash), or an empty string if this entry is
+     * unused.
+     */
+    char key[GUAC_WOL_REGISTRY_KEY_LENGTH];
+
+    /**
+     * The time that a magic Wake-on-LAN packet was last sent to this host by
+     * any process sharing the registry, or zero if no packet has been sent.
+     */
+    guac_timestamp last_wake;
+
+    /**
+     * The time that this host was last observed reachable by any process
+     * sharing the registry, or zero if the host has not been observed
+     * reachable.
+     */
+    guac_timestamp last_reachable;
+
+} guac_wol_registry_entry;
+
+/**
+ * A registry of the wake state of recently-woken remote hosts, shared between
+ * all processes forked after the registry was initialized.
+ */
+typedef struct guac_wol_registry {
+
+    /**
+     * Process-shared lock guarding all entries of this registry. Processes
+     * sharing the registry hold this lock only briefly, never during network
+     * operations.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * The entries of this registry, each tracking the wake state of one
+     * remote host.
+     */
+    guac_wol_registry_entry entries[GUAC_WOL_REGISTRY_SIZE];
+
+} guac_wol_registry;
+
+/**
+ * The shared Wake-on-LAN registry, or NULL if guac_wol_init_registry() has
+ * not been invoked within this process or an ancestor of this process.
+ */
+static guac_wol_registry* guac_wol_registry_state = NULL;
+
+int guac_wol_init_registry(void) {
+
+    /* Nothing to do if the registry has already been initialized */
+    if (guac_wol_registry_state != NULL)
+        return 0;
+
+    /* The registry must reside in shared memory, such that it remains common
+     * to all processes later forked from this one */
+    guac_wol_registry* registry = mmap(NULL, sizeof(guac_wol_registry),
+            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (registry == MAP_FAILED) {
+        guac_error = GUAC_STATUS_SEE_ERRNO;
+        guac_error_message = "Unable to allocate shared memory for "
+            "Wake-on-LAN registry";
+        return -1;
+    }
+
+    /* The lock guarding the registry must likewise work across process
+     * boundaries and, where supported, must be recoverable if a process dies
+     * while holding it */
+    pthread_mutexattr_t lock_attributes;
+    pthread_mutexattr_init(&lock_attributes);
+    pthread_mutexattr_setpshared(&lock_attributes, PTHREAD_PROCESS_SHARED);
+#ifdef PTHREAD_MUTEX_ROBUST
+    pthread_mutexattr_setrobust(&lock_attributes, PTHREAD_MUTEX_ROBUST);
+#endif
+    pthread_mutex_init(&registry->lock, &lock_attributes);
+    pthread_mutexattr_destroy(&lock_attributes);
+
+    guac_wol_registry_state = registry;
+    return 0;
+
+}
+
+/**
+ * Acquires the lock guarding the shared Wake-on-LAN registry, recovering the
+ * lock if the process that previously held it died before releasing it.
+ *
+ * @param registry
+ *     The registry to lock.
+ *
+ * @return
+ *     Zero if the lock was successfully acquired, non-zero otherwise.
+ */
+static int guac_wol_registry_lock(guac_wol_registry* registry) {
+
+    int retval = pthread_mutex_lock(&registry->lock);
+
+#ifdef PTHREAD_MUTEX_ROBUST
+    /* Recover the lock if its previous holder died while holding it (the
+     * registry contents are simple timestamps that are never left in an
+     * inconsistent state) */
+    if (retval == EOWNERDEAD) {
+        pthread_mutex_consistent(&registry->lock);
+        retval = 0;
+    }
+#endif
+
+    return retval;
+
+}
+
+/**
+ * Produces the key identifying the given remote host within the shared
+ * Wake-on-LAN registry.
+ *
+ * @param key
+ *     The buffer that should receive the key, which must be at least
+ *     GUAC_WOL_REGISTRY_KEY_LENGTH bytes.
+ *
+ * @param hostname
+ *     The hostname or IP address of the remote host.
+ *
+ * @param port
+ *     The TCP port of the remote host that is polled to determine whether
+ *     the host is awake.
+ *
+ * @return
+ *     Zero if the key was successfully produced, non-zero if the hostname
+ *     and port do not fit within a key.
+ */
+static int guac_wol_registry_key(char key[GUAC_WOL_REGISTRY_KEY_LENGTH],
+        const char* hostname, const char* port) {
+
+    int length = snprintf(key, GUAC_WOL_REGISTRY_KEY_LENGTH, "%s/%s",
+            hostname, port);
+
+    return length < 0 || length >= GUAC_WOL_REGISTRY_KEY_LENGTH;
+
+}
+
+/**
+ * Returns the entry of the shared Wake-on-LAN registry tracking the wake
+ * state of the host with the given key, or NULL if no such entry exists. The
+ * lock guarding the registry must already be held by the caller.
+ *
+ * @param registry
+ *     The registry to search.
+ *
+ * @param key
+ *     The key identifying the remote host, as produced by
+ *     guac_wol_registry_key().
+ *
+ * @return
+ *     The entry tracking the wake state of the host with the given key, or
+ *     NULL if no such entry exists.
+ */
+static guac_wol_registry_entry* guac_wol_registry_find(
+        guac_wol_registry* registry, const char* key) {
+
+    for (int i = 0; i < GUAC_WOL_REGISTRY_SIZE; i++) {
+        guac_wol_registry_entry* entry = &registry->entries[i];
+        if (strcmp(entry->key, key) == 0)
+            return entry;
+    }
+
+    return NULL;
+
+}
+
+/**
+ * Returns the entry of the shared Wake-on-LAN registry tracking the wake
+ * state of the host with the given key, allocating an entry if necessary by
+ * reusing the entry whose wake is least recent. The lock guarding the
+ * registry must already be held by the caller.
+ *
+ * @param registry
+ *     The registry to search.
+ *
+ * @param key
+ *     The key identifying the remote host, as produced by
+ *     guac_wol_registry_key().
+ *
+ * @return
+ *     The entry tracking the wake state of the host with the given key. If
+ *     the entry had to be reused from another host, its timestamps will have
+ *     been reset to zero.
+ */
+static guac_wol_registry_entry* guac_wol_registry_get(
+        guac_wol_registry* registry, const char* key) {
+
+    /* Use the existing entry for this host, if any */
+    guac_wol_registry_entry* entry = guac_wol_registry_find(registry, key);
+    if (entry != NULL)
+        return entry;
+
+    /* Otherwise, prefer reusing unused entries, followed by the entry whose
+     * wake is least recent */
+    guac_wol_registry_entry* oldest = &registry->entries[0];
+    for (int i = 0; i < GUAC_WOL_REGISTRY_SIZE; i++) {
+
+        entry = &registry->entries[i];
+
+        if (entry->key[0] == '\0') {
+            oldest = entry;
+            break;
+        }
+
+        if (entry->last_wake < oldest->last_wake)
+            oldest = entry;
+
+    }
+
+    strncpy(oldest->key, key, GUAC_WOL_REGISTRY_KEY_LENGTH - 1);
+    oldest->key[GUAC_WOL_REGISTRY_KEY_LENGTH - 1] = '\0';
+    oldest->last_wake = 0;
+    oldest->last_reachable = 0;
+
+    return oldest;
+
+}
+
+/**
+ * Returns whether the given remote host has recently been observed reachable
+ * by any process sharing the Wake-on-LAN registry, in which case the host
+ * need not be probed nor woken at all.
+ *
+ * @param hostname
+ *     The hostname or IP address of the remote host.
+ *
+ * @param port
+ *     The TCP port of the remote host that is polled to determine whether
+ *     the host is awake.
+ *
+ * @return
+ *     Non-zero if the host has recently been observed reachable, zero
+ *     otherwise (including if no registry is available).
+ */
+static int guac_wol_registry_is_reachable(const char* hostname,
+        const char* port) {
+
+    guac_wol_registry* registry = guac_wol_registry_state;
+    char key[GUAC_WOL_REGISTRY_KEY_LENGTH];
+
+    if (registry == NULL || guac_wol_registry_key(key, hostname, port)
+            || guac_wol_registry_lock(registry))
+        return 0;
+
+    guac_wol_registry_entry* entry = guac_wol_registry_find(registry, key);
+    int reachable = entry != NULL && entry->last_reachable != 0
+        && guac_timestamp_current() - entry->last_reachable
+            < GUAC_WOL_REACHABLE_INTERVAL;
+
+    pthread_mutex_unlock(&registry->lock);
+    return reachable;
+
+}
+
+/**
+ * Records within the shared Wake-on-LAN registry that the given remote host
+ * has been observed reachable, such that other processes attempting to wake
+ * the same host can succeed immediately.
+ *
+ * @param hostname
+ *     The hostname or IP address of the remote host.
+ *
+ * @param port
+ *     The TCP port of the remote host that was successfully reached.
+ */
+static void guac_wol_registry_note_reachable(const char* hostname,
+        const char* port) {
+
+    guac_wol_registry* registry = guac_wol_registry_state;
+    char key[GUAC_WOL_REGISTRY_KEY_LENGTH];
+
+    if (registry == NULL || guac_wol_registry_key(key, hostname, port)
+            || guac_wol_registry_lock(registry))
+        return;
+
+    guac_wol_registry_entry* entry = guac_wol_registry_get(registry, key);
+    entry->last_reachable = guac_timestamp_current();
+
+    pthread_mutex_unlock(&registry->lock);
+
+}
+
+/**
+ * Claims responsibility for sending the magic Wake-on-LAN packet for the
+ * given remote host, returning whether the caller should actually send the
+ * packet. If another process sharing the registry has sent a packet for the
+ * same host recently enough that the host should already be waking, the
+ * claim fails, and the caller should skip sending the packet and simply poll
+ * the host.
+ *
+ * @param hostname
+ *     The hostname or IP address of the remote host to be woken.
+ *
+ * @param port
+ *     The TCP port of the remote host that is polled to determine whether
+ *     the host is awake.
+ *
+ * @return
+ *     Non-zero if the caller should send the magic Wake-on-LAN packet, zero
+ *     if a packet has already been sent recently by another process.
+ */
+static int guac_wol_registry_claim_wake(const char* hostname,
+        const char* port) {
+
+    guac_wol_registry* registry = guac_wol_registry_state;
+    char key[GUAC_WOL_REGISTRY_KEY_LENGTH];
+
+    /* Without a registry (or for hosts that cannot be tracked), each wake
+     * attempt is independent and must send its own packet */
+    if (registry == NULL || guac_wol_registry_key(key, hostname, port)
+            || guac_wol_registry_lock(registry))
+        return 1;
+
+    guac_wol_registry_entry* entry = guac_wol_registry_get(registry, key);
+    guac_timestamp now = guac_timestamp_current();
+
+    /* Skip sending the packet if another process has woken this host
+     * recently enough that the host should already be waking */
+    int claimed = entry->last_wake == 0
+        || now - entry->last_wake >= GUAC_WOL_WAKE_COALESCE_INTERVAL;
+
+    if (claimed)
+        entry->last_wake = now;
+
+    pthread_mutex_unlock(&registry->lock);
+    return claimed;
+
+}
+
 /**
  * Generate the magic Wake-on-LAN (WoL) packet for the specified MAC address
  * and place it in the character array.
@@ -203,20 +580,30 @@ int guac_wol_wake_and_wait(const char* mac_addr, const char* broadcast_addr,
         const unsigned short udp_port, int wait_time, int retries,
         const char* hostname, const char* port, const int timeout) {
 
+    /* If the host has just been observed reachable by another connection,
+     * there is no need to probe or wake it again. */
+    if (guac_wol_registry_is_reachable(hostname, port))
+        return 0;
+
     /* Attempt to connect, first. */
     int sockfd = guac_tcp_connect(hostname, port, timeout);
 
     /* If connection succeeds, no need to wake the system. */
     if (sockfd > 0) {
         close(sockfd);
+        guac_wol_registry_note_reachable(hostname, port);
         return 0;
     }
 
     /* Close the fd to avoid resource leak. */
     close(sockfd);
 
-    /* Send the magic WOL packet and store return value. */
-    int retval = guac_wol_wake(mac_addr, broadcast_addr, udp_port);
+    /* Send the magic WOL packet, unless another connection has already woken
+     * this host recently enough that the host should already be waking, and
+     * store the return value. */
+    int retval = 0;
+    if (guac_wol_registry_claim_wake(hostname, port))
+        retval = guac_wol_wake(mac_addr, broadcast_addr, udp_port);
 
     /* If sending WOL packet fails, just return the received return value. */
     if (retval)
@@ -230,6 +617,7 @@ int guac_wol_wake_and_wait(const char* mac_addr, const char* broadcast_addr,
         /* Connection succeeded - close socket and exit. */
         if (sockfd > 0) {
             close(sockfd);
+            guac_wol_registry_note_reachable(hostname, port);
             return 0;
         }
 
@@ -247,3 +635,219 @@ int guac_wol_wake_and_wait(const char* mac_addr, const char* broadcast_addr,
     return -1;
 
 }
+
+struct guac_wol_wait {
+
+    /**
+     * The client on whose behalf the remote host is being woken, or NULL if
+     * the wait is not associated with any client. If non-NULL, progress is
+     * logged against this client, and the wait is abandoned early if the
+     * client stops running.
+     */
+    guac_client* client;
+
+    /**
+     * The MAC address to place in the magic Wake-on-LAN packet.
+     */
+    char* mac_addr;
+
+    /**
+     * The broadcast address to which to send the magic Wake-on-LAN packet.
+     */
+    char* broadcast_addr;
+
+    /**
+     * The hostname or IP address of the system being woken up.
+     */
+    char* hostname;
+
+    /**
+     * The TCP port on which the system being woken up is polled.
+     */
+    char* port;
+
+    /**
+     * The UDP port to use when sending the Wake-on-LAN packet.
+     */
+    unsigned short udp_port;
+
+    /**
+     * The number of seconds to wait between connection attempts after the
+     * Wake-on-LAN packet has been sent.
+     */
+    int wait_time;
+
+    /**
+     * The number of connection attempts to make before giving up.
+     */
+    int retries;
+
+    /**
+     * The number of seconds to wait for each connection attempt.
+     */
+    int timeout;
+
+    /**
+     * The result of the wake attempt: zero if the remote host became
+     * reachable, non-zero otherwise.
+     */
+    int result;
+
+    /**
+     * The thread performing the wake and polling the remote host.
+     */
+    pthread_t thread;
+
+};
+
+/**
+ * Frees all resources associated with the given Wake-on-LAN wait. The
+ * associated thread must already have terminated.
+ *
+ * @param wait
+ *     The Wake-on-LAN wait to free.
+ */
+static void guac_wol_wait_free(guac_wol_wait* wait) {
+    guac_mem_free(wait->mac_addr);
+    guac_mem_free(wait->broadcast_addr);
+    guac_mem_free(wait->hostname);
+    guac_mem_free(wait->port);
+    guac_mem_free(wait);
+}
+
+/**
+ * Thread which wakes the remote host and polls it until it becomes reachable,
+ * the configured number of attempts is exhausted, or the associated client
+ * stops running. The eventual result is stored within the guac_wol_wait
+ * structure, to be collected via guac_wol_wake_and_wait_result().
+ *
+ * @param data
+ *     A pointer to the guac_wol_wait structure describing the wake attempt.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guac_wol_wait_thread(void* data) {
+
+    guac_wol_wait* wait = (guac_wol_wait*) data;
+    guac_client* client = wait->client;
+
+    /* If the host has just been observed reachable by another connection,
+     * there is no need to probe or wake it again. */
+    if (guac_wol_registry_is_reachable(wait->hostname, wait->port)) {
+        wait->result = 0;
+        return NULL;
+    }
+
+    /* Attempt to connect, first. If connection succeeds, there is no need to
+     * wake the system. */
+    int sockfd = guac_tcp_connect(wait->hostname, wait->port, wait->timeout);
+    if (sockfd > 0) {
+        close(sockfd);
+        guac_wol_registry_note_reachable(wait->hostname, wait->port);
+        wait->result = 0;
+        return NULL;
+    }
+
+    /* Close the fd to avoid resource leak. */
+    close(sockfd);
+
+    /* Send the magic WOL packet, unless another connection has already woken
+     * this host recently enough that the host should already be waking,
+     * giving up immediately if the packet cannot be sent at all. */
+    if (guac_wol_registry_claim_wake(wait->hostname, wait->port)
+            && guac_wol_wake(wait->mac_addr, wait->broadcast_addr,
+                wait->udp_port)) {
+        if (client != NULL)
+            guac_client_log(client, GUAC_LOG_WARNING,
+                    "Unable to send Wake-on-LAN packet for host \"%s\".",
+                    wait->hostname);
+        return NULL;
+    }
+
+    /* Try to connect on the specified TCP port and hostname or IP. */
+    for (int i = 0; i < wait->retries; i++) {
+
+        /* Abandon the wait if the connection is being closed */
+        if (client != NULL && client->state != GUAC_CLIENT_RUNNING)
+            return NULL;
+
+        if (client != NULL)
+            guac_client_log(client, GUAC_LOG_INFO, "Waiting for host \"%s\" "
+                    "to wake (attempt %i of %i).", wait->hostname, i + 1,
+                    wait->retries);
+
+        sockfd = guac_tcp_connect(wait->hostname, wait->port, wait->timeout);
+
+        /* Connection succeeded - close socket and exit. */
+        if (sockfd > 0) {
+            close(sockfd);
+            guac_wol_registry_note_reachable(wait->hostname, wait->port);
+            wait->result = 0;
+            return NULL;
+        }
+
+        /* Connection did not succeed - close the socket and sleep before
+         * retrying, checking periodically whether the client has stopped. */
+        close(sockfd);
+        for (int elapsed = 0; elapsed < wait->wait_time; elapsed++) {
+
+            if (client != NULL && client->state != GUAC_CLIENT_RUNNING)
+                return NULL;
+
+            guac_timestamp_msleep(1000);
+
+        }
+
+    }
+
+    return NULL;
+
+}
+
+guac_wol_wait* guac_wol_wake_and_wait_async(guac_client* client,
+        const char* mac_addr, const char* broadcast_addr,
+        const unsigned short udp_port, int wait_time, int retries,
+        const char* hostname, const char* port, const int timeout) {
+
+    guac_wol_wait* wait = guac_mem_zalloc(sizeof(guac_wol_wait));
+
+    wait->client = client;
+    wait->mac_addr = guac_strdup(mac_addr);
+    wait->broadcast_addr = guac_strdup(broadcast_addr);
+    wait->hostname = guac_strdup(hostname);
+    wait->port = guac_strdup(port);
+    wait->udp_port = udp_port;
+    wait->wait_time = wait_time;
+    wait->retries = retries;
+    wait->timeout = timeout;
+
+    /* The wake attempt is considered failed until the host responds */
+    wait->result = -1;
+
+    if (pthread_create(&(wait->thread), NULL, guac_wol_wait_thread, wait)) {
+        guac_error = GUAC_STATUS_SEE_ERRNO;
+        guac_error_message = "Unable to start Wake-on-LAN thread";
+        guac_wol_wait_free(wait);
+        return NULL;
+    }
+
+    return wait;
+
+}
+
+int guac_wol_wake_and_wait_result(guac_wol_wait* wait) {
+
+    /* Wait for polling of the remote host to complete */
+    pthread_join(wait->thread, NULL);
+
+    int result = wait->result;
+    if (result) {
+        guac_error = GUAC_STATUS_REFUSED;
+        guac_error_message = "Unable to connect to remote host.";
+    }
+
+    guac_wol_wait_free(wait);
+    return result;
+
+}
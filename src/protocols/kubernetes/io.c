@@ -39,10 +39,28 @@ void guac_kubernetes_receive_data(guac_client* client,
 
     switch (channel) {
 
-        /* Write STDOUT / STDERR directly to terminal as output */
+        /* Aggregate STDOUT / STDERR data for later bulk writing to the
+         * terminal */
         case GUAC_KUBERNETES_CHANNEL_STDOUT:
         case GUAC_KUBERNETES_CHANNEL_STDERR:
-            guac_terminal_write(kubernetes_client->term, buffer, length);
+
+            /* Flush any buffered data if the current fragment will not fit */
+            if (kubernetes_client->inbound_buffer_length + (int) length
+                    > GUAC_KUBERNETES_INBOUND_BUFFER_SIZE)
+                guac_kubernetes_flush_received_data(client);
+
+            /* Write fragments too large for the buffer directly to the
+             * terminal (the buffer is known to be empty here) */
+            if ((int) length > GUAC_KUBERNETES_INBOUND_BUFFER_SIZE) {
+                guac_terminal_write(kubernetes_client->term, buffer, length);
+                break;
+            }
+
+            /* Append fragment to buffered data */
+            memcpy(kubernetes_client->inbound_buffer
+                        + kubernetes_client->inbound_buffer_length,
+                    buffer, length);
+            kubernetes_client->inbound_buffer_length += length;
             break;
 
         /* Ignore data on other channels */
@@ -54,6 +72,23 @@ void guac_kubernetes_receive_data(guac_client* client,
 
 }
 
+void guac_kubernetes_flush_received_data(guac_client* client) {
+
+    guac_kubernetes_client* kubernetes_client =
+        (guac_kubernetes_client*) client->data;
+
+    /* Write all buffered output to the terminal as a single contiguous
+     * block, invoking the terminal (and its lock) only once regardless of
+     * the number of fragments received */
+    if (kubernetes_client->inbound_buffer_length > 0) {
+        guac_terminal_write(kubernetes_client->term,
+                kubernetes_client->inbound_buffer,
+                kubernetes_client->inbound_buffer_length);
+        kubernetes_client->inbound_buffer_length = 0;
+    }
+
+}
+
 void guac_kubernetes_send_message(guac_client* client,
         int channel, const char* data, int length) {
 
@@ -99,6 +99,17 @@ typedef struct guac_kubernetes_message {
 void guac_kubernetes_receive_data(guac_client* client,
         const char* buffer, size_t length);
 
+/**
+ * Writes all STDOUT/STDERR data buffered by guac_kubernetes_receive_data()
+ * to the terminal as a single contiguous block, emptying the inbound buffer.
+ * If no data is buffered, this function has no effect. This function MUST be
+ * invoked only from the thread driving the libwebsockets event loop.
+ *
+ * @param client
+ *     The guac_client associated with the connection to Kubernetes.
+ */
+void guac_kubernetes_flush_received_data(guac_client* client);
+
 /**
  * Requests that the given data be sent along the given channel to the
  * Kubernetes server when the WebSocket connection is next available for
@@ -357,6 +357,10 @@ void* guac_kubernetes_client_thread(void* data) {
                     GUAC_KUBERNETES_SERVICE_INTERVAL) < 0)
             break;
 
+        /* Write any output received during this iteration of the event loop
+         * to the terminal in bulk */
+        guac_kubernetes_flush_received_data(client);
+
     }
 
     /* Kill client and Wait for input thread to die */
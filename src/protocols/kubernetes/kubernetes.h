@@ -50,6 +50,14 @@
  */
 #define GUAC_KUBERNETES_SERVICE_INTERVAL 1000
 
+/**
+ * The size of the buffer aggregating STDOUT/STDERR data received from
+ * Kubernetes, in bytes. Received WebSocket fragments accumulate within this
+ * buffer and are written to the terminal in bulk, rather than invoking the
+ * terminal once per fragment.
+ */
+#define GUAC_KUBERNETES_INBOUND_BUFFER_SIZE 8192
+
 /**
  * Kubernetes-specific client data.
  */
@@ -97,6 +105,19 @@ typedef struct guac_kubernetes_client {
      */
     pthread_mutex_t outbound_message_lock;
 
+    /**
+     * Buffer of STDOUT/STDERR data that has been received from Kubernetes
+     * but not yet written to the terminal. This buffer is accessed only from
+     * the thread driving the libwebsockets event loop and thus requires no
+     * lock.
+     */
+    char inbound_buffer[GUAC_KUBERNETES_INBOUND_BUFFER_SIZE];
+
+    /**
+     * The number of bytes currently stored within the inbound buffer.
+     */
+    int inbound_buffer_length;
+
     /**
      * The Kubernetes client thread.
      */
@@ -0,0 +1,158 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "bitmap.h"
+#include "color.h"
+#include "rdp.h"
+
+#include <freerdp/codec/color.h>
+#include <freerdp/freerdp.h>
+#include <freerdp/gdi/gdi.h>
+#include <guacamole/client.h>
+#include <guacamole/display.h>
+#include <guacamole/mem.h>
+#include <guacamole/rect.h>
+#include <winpr/wtypes.h>
+
+/**
+ * Allocates a cell of the client-side bitmap cache layer, creating the cache
+ * and its layer on first use and growing the layer by whole rows of cells as
+ * needed. The contents of previously-allocated cells are preserved across
+ * such growth.
+ *
+ * @param rdp_client
+ *     The guac_rdp_client associated with the current RDP session.
+ *
+ * @return
+ *     The index of the allocated cell, or -1 if the cache layer is full.
+ */
+static int guac_rdp_bitmap_cache_alloc_cell(guac_rdp_client* rdp_client) {
+
+    /* Create the cache and its backing layer on first use (the layer cannot
+     * be created any earlier, as the display is not associated with the
+     * FreeRDP instance until the connection is underway) */
+    guac_rdp_bitmap_cache* cache = rdp_client->bitmap_cache;
+    if (cache == NULL) {
+        cache = guac_mem_zalloc(sizeof(guac_rdp_bitmap_cache));
+        cache->layer = guac_display_alloc_buffer(rdp_client->display, 1);
+        rdp_client->bitmap_cache = cache;
+    }
+
+    /* Reuse the cell of an evicted bitmap if possible (the stale contents of
+     * the cell are simply overwritten by the new occupant) */
+    if (cache->num_free > 0)
+        return cache->free_cells[--cache->num_free];
+
+    if (cache->num_cells >= GUAC_RDP_BITMAP_CACHE_MAX_CELLS)
+        return -1;
+
+    int cell = cache->num_cells++;
+
+    /* Grow the cache layer to cover the new cell's row of cells */
+    int rows = (cache->num_cells + GUAC_RDP_BITMAP_CACHE_COLS - 1)
+        / GUAC_RDP_BITMAP_CACHE_COLS;
+    guac_display_layer_resize(cache->layer,
+            GUAC_RDP_BITMAP_CACHE_COLS * GUAC_RDP_BITMAP_CACHE_CELL,
+            rows * GUAC_RDP_BITMAP_CACHE_CELL);
+
+    return cell;
+
+}
+
+BOOL guac_rdp_bitmap_new(rdpContext* context, rdpBitmap* bitmap) {
+
+    guac_client* client = ((rdp_freerdp_context*) context)->client;
+    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+    guac_rdp_bitmap* guac_bitmap = (guac_rdp_bitmap*) bitmap;
+
+    /* The GDI renders all drawing orders in software against its own copy of
+     * the cached bitmap, and must do so regardless of whether the bitmap is
+     * also mirrored client-side */
+    if (rdp_client->gdi_bitmap.New != NULL
+            && !rdp_client->gdi_bitmap.New(context, bitmap))
+        return FALSE;
+
+    /* Until successfully stored, the bitmap has no cache layer cell */
+    guac_bitmap->cache_cell = -1;
+
+    /* Mirror only bitmaps that fit within a cache cell (in practice, all
+     * bitmaps stored within the RDP bitmap cache do) */
+    if (bitmap->data == NULL
+            || bitmap->width > GUAC_RDP_BITMAP_CACHE_CELL
+            || bitmap->height > GUAC_RDP_BITMAP_CACHE_CELL)
+        return TRUE;
+
+    int cell = guac_rdp_bitmap_cache_alloc_cell(rdp_client);
+    if (cell < 0)
+        return TRUE;
+
+    guac_rdp_bitmap_cache* cache = rdp_client->bitmap_cache;
+
+    guac_rect dst_rect;
+    guac_rect_init(&dst_rect,
+            (cell % GUAC_RDP_BITMAP_CACHE_COLS) * GUAC_RDP_BITMAP_CACHE_CELL,
+            (cell / GUAC_RDP_BITMAP_CACHE_COLS) * GUAC_RDP_BITMAP_CACHE_CELL,
+            bitmap->width, bitmap->height);
+
+    guac_display_layer_raw_context* dst_context = guac_display_layer_open_raw(cache->layer);
+    guac_rect_constrain(&dst_rect, &dst_context->bounds);
+
+    /* Store the bitmap within its assigned cell, converting to the native
+     * format of the display if necessary */
+    freerdp_image_copy(GUAC_DISPLAY_LAYER_RAW_BUFFER(dst_context, dst_rect),
+            guac_rdp_get_native_pixel_format(FALSE), dst_context->stride,
+            0, 0, guac_rect_width(&dst_rect), guac_rect_height(&dst_rect),
+            bitmap->data, bitmap->format, 0, 0, 0, &context->gdi->palette,
+            FREERDP_FLIP_NONE);
+
+    guac_rect_extend(&dst_context->dirty, &dst_rect);
+    guac_display_layer_close_raw(cache->layer, dst_context);
+
+    guac_bitmap->cache_cell = cell;
+
+    return TRUE;
+
+}
+
+void guac_rdp_bitmap_free(rdpContext* context, rdpBitmap* bitmap) {
+
+    guac_client* client = ((rdp_freerdp_context*) context)->client;
+    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+    guac_rdp_bitmap* guac_bitmap = (guac_rdp_bitmap*) bitmap;
+
+    /* Return the bitmap's cell to the cache for reuse, if any */
+    guac_rdp_bitmap_cache* cache = rdp_client->bitmap_cache;
+    if (cache != NULL && guac_bitmap->cache_cell >= 0)
+        cache->free_cells[cache->num_free++] = guac_bitmap->cache_cell;
+
+    /* NOTE: FreeRDP-allocated memory for the rdpBitmap itself will be
+     * automatically released after this free handler is invoked */
+    if (rdp_client->gdi_bitmap.Free != NULL)
+        rdp_client->gdi_bitmap.Free(context, bitmap);
+
+}
+
+void guac_rdp_bitmap_cache_free(guac_client* client) {
+
+    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+
+    guac_mem_free(rdp_client->bitmap_cache);
+    rdp_client->bitmap_cache = NULL;
+
+}
@@ -0,0 +1,149 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_RDP_BITMAP_H
+#define GUAC_RDP_BITMAP_H
+
+#include "config.h"
+
+#include <freerdp/freerdp.h>
+#include <freerdp/gdi/gdi.h>
+#include <guacamole/client.h>
+#include <guacamole/display.h>
+#include <winpr/wtypes.h>
+
+/**
+ * The dimensions of each cell of the client-side bitmap cache layer, in
+ * pixels. Bitmaps stored within the RDP bitmap cache are at most 64x64, and
+ * each cached bitmap occupies exactly one cell.
+ */
+#define GUAC_RDP_BITMAP_CACHE_CELL 64
+
+/**
+ * The number of cache cells in each row of the bitmap cache layer.
+ */
+#define GUAC_RDP_BITMAP_CACHE_COLS 16
+
+/**
+ * The maximum number of cells that the bitmap cache layer may contain,
+ * bounding the layer at 1024x4096 pixels (16 MB of 32-bit image data,
+ * allocated only as rows of cells are actually used). Bitmaps cached by the
+ * RDP server beyond this limit are simply not mirrored client-side, and
+ * blits of those bitmaps proceed through the normal diff+encode path.
+ */
+#define GUAC_RDP_BITMAP_CACHE_MAX_CELLS 1024
+
+/**
+ * A client-side mirror of the RDP server's bitmap cache, stored within an
+ * offscreen guac_display buffer divided into fixed-size cells. Each cached
+ * bitmap is uploaded to its cell once, when the server stores it in the
+ * cache, allowing subsequent blits of that bitmap to be sent to connected
+ * users as copy instructions rather than repeatedly re-encoded image data.
+ */
+typedef struct guac_rdp_bitmap_cache {
+
+    /**
+     * The offscreen buffer containing the cached bitmaps, arranged in a grid
+     * of GUAC_RDP_BITMAP_CACHE_CELL x GUAC_RDP_BITMAP_CACHE_CELL cells with
+     * GUAC_RDP_BITMAP_CACHE_COLS cells per row.
+     */
+    guac_display_layer* layer;
+
+    /**
+     * The number of cells allocated so far. The cache layer is grown by
+     * whole rows of cells as this count increases.
+     */
+    int num_cells;
+
+    /**
+     * A stack of the indices of cells whose bitmaps have since been evicted
+     * from the server-side cache and which may be reused.
+     */
+    int free_cells[GUAC_RDP_BITMAP_CACHE_MAX_CELLS];
+
+    /**
+     * The number of cell indices currently stored within free_cells.
+     */
+    int num_free;
+
+} guac_rdp_bitmap_cache;
+
+/**
+ * Guacamole-specific rdpBitmap data. The wrapped gdiBitmap MUST be the first
+ * member of this structure, as the chained FreeRDP GDI bitmap handlers expect
+ * to receive the rdpBitmap they themselves allocated state for.
+ */
+typedef struct guac_rdp_bitmap {
+
+    /**
+     * The FreeRDP GDI bitmap data. The GDI continues to render all drawing
+     * orders in software, including blits of cached bitmaps, and its
+     * handling of each bitmap is preserved by chaining to its handlers.
+     */
+    gdiBitmap gdi;
+
+    /**
+     * The index of the cell of the bitmap cache layer mirroring this bitmap
+     * client-side, or -1 if this bitmap is not mirrored (as will be the case
+     * if the bitmap is too large for a cell or the cache layer is full).
+     */
+    int cache_cell;
+
+} guac_rdp_bitmap;
+
+/**
+ * Caches the given bitmap within the client-side bitmap cache layer, if
+ * possible, first chaining to the FreeRDP GDI implementation such that
+ * software rendering of the bitmap continues to function.
+ *
+ * @param context
+ *     The rdpContext associated with the current RDP session.
+ *
+ * @param bitmap
+ *     The bitmap being stored within the RDP bitmap cache.
+ *
+ * @return
+ *     TRUE if successful, FALSE otherwise.
+ */
+BOOL guac_rdp_bitmap_new(rdpContext* context, rdpBitmap* bitmap);
+
+/**
+ * Releases the cache layer cell mirroring the given bitmap, if any, making
+ * that cell available to bitmaps subsequently stored within the cache, and
+ * chains to the FreeRDP GDI implementation to release its own resources.
+ *
+ * @param context
+ *     The rdpContext associated with the current RDP session.
+ *
+ * @param bitmap
+ *     The bitmap being evicted from the RDP bitmap cache.
+ */
+void guac_rdp_bitmap_free(rdpContext* context, rdpBitmap* bitmap);
+
+/**
+ * Frees the bookkeeping associated with the client-side bitmap cache of the
+ * given guac_client, if any. The underlying cache layer is freed by
+ * guac_display_free() and is not touched by this function.
+ *
+ * @param client
+ *     The guac_client whose bitmap cache bookkeeping should be freed.
+ */
+void guac_rdp_bitmap_cache_free(guac_client* client);
+
+#endif
@@ -33,6 +33,7 @@
 #include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 /**
@@ -551,6 +552,28 @@ void guac_rdp_audio_buffer_write(guac_rdp_audio_buffer* audio_buffer,
 
     int out_bps = audio_buffer->out_format.bps;
 
+    /* If the input and output formats are identical, no resampling nor
+     * conversion is needed, and the received PCM data can be copied into the
+     * outbound packet as-is rather than pushed through the per-sample
+     * conversion loop */
+    if (audio_buffer->in_format.rate == audio_buffer->out_format.rate
+            && audio_buffer->in_format.channels == audio_buffer->out_format.channels
+            && audio_buffer->in_format.bps == out_bps) {
+
+        memcpy(audio_buffer->packet + audio_buffer->bytes_written,
+                buffer, length);
+
+        /* Update byte counters */
+        audio_buffer->bytes_written += length;
+        audio_buffer->total_bytes_sent += length;
+        audio_buffer->total_bytes_received += length;
+
+        pthread_cond_broadcast(&(audio_buffer->modified));
+        pthread_mutex_unlock(&(audio_buffer->lock));
+        return;
+
+    }
+
     /* Continuously write packets until no data remains */
     while (guac_rdp_audio_buffer_read_sample(audio_buffer,
                 buffer, length, &sample) > 0) {
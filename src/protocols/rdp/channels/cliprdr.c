@@ -39,6 +39,15 @@
 #include <stdlib.h>
 #include <string.h>
 
+/**
+ * The number of bytes of converted clipboard data to buffer per iteration
+ * when streaming clipboard data received from the RDP server to connected
+ * clients. Converting through a small, reused buffer (rather than a buffer
+ * sized to fit the entire clipboard) bounds the memory required to process a
+ * paste regardless of the amount of data the RDP server sends.
+ */
+#define GUAC_RDP_CLIPRDR_CHUNK_SIZE 4096
+
 #ifdef FREERDP_CLIPRDR_CALLBACKS_REQUIRE_CONST
 /**
  * FreeRDP 2.0.0-rc4 and newer requires the final argument for all CLIPRDR
@@ -470,11 +479,8 @@ static UINT guac_rdp_cliprdr_format_data_response(CliprdrClientContext* cliprdr,
         return CHANNEL_RC_OK;
     }
 
-    char received_data[GUAC_COMMON_CLIPBOARD_MAX_LENGTH];
-
     guac_iconv_read* remote_reader;
     const char* input = (char*) format_data_response->requestedFormatData;
-    char* output = received_data;
 
     /* Find correct source encoding */
     switch (clipboard->requested_format) {
@@ -509,16 +515,45 @@ static UINT guac_rdp_cliprdr_format_data_response(CliprdrClientContext* cliprdr,
     data_len = format_data_response->dataLen;
     #endif
 
-    /* Convert, store, and forward the clipboard data received from RDP
-     * server */
-    if (guac_iconv(remote_reader, &input, data_len,
-            GUAC_WRITE_UTF8, &output, sizeof(received_data))) {
-        int length = strnlen(received_data, sizeof(received_data));
-        guac_common_clipboard_reset(clipboard->clipboard, "text/plain");
-        guac_common_clipboard_append(clipboard->clipboard, received_data, length);
-        guac_common_clipboard_send(clipboard->clipboard, client);
+    /* Convert, store, and forward the clipboard data received from the RDP
+     * server, streaming the conversion through a small, reused buffer rather
+     * than converting through an intermediate buffer sized to fit the entire
+     * clipboard. Conversion stops as soon as the local clipboard is full,
+     * bounding both the memory and the processing time spent on a paste
+     * regardless of the amount of data the RDP server sends. */
+    guac_common_clipboard_reset(clipboard->clipboard, "text/plain");
+
+    char chunk[GUAC_RDP_CLIPRDR_CHUNK_SIZE];
+    const char* current = input;
+    int terminated = 0;
+    while (!terminated && data_len - (current - input) > 0) {
+
+        char* output = chunk;
+        terminated = guac_iconv_partial(remote_reader, &current,
+                (int) (data_len - (current - input)), GUAC_WRITE_UTF8,
+                &output, sizeof(chunk));
+
+        /* Exclude the null terminator (and anything following it) from the
+         * data forwarded to connected clients */
+        int converted = output - chunk;
+        if (terminated)
+            converted = strnlen(chunk, converted);
+
+        if (converted > 0)
+            guac_common_clipboard_append(clipboard->clipboard, chunk, converted);
+
+        /* Stop converting once no further data can be stored */
+        if (clipboard->clipboard->length >= clipboard->clipboard->available)
+            break;
+
     }
 
+    /* Forward the converted data to connected clients, unless nothing
+     * usable was received at all (an empty response should not wipe out the
+     * existing clipboard contents) */
+    if (terminated || clipboard->clipboard->length > 0)
+        guac_common_clipboard_send(clipboard->clipboard, client);
+
     return CHANNEL_RC_OK;
 
 }
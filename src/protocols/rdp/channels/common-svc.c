@@ -32,7 +32,7 @@
 #include <stdlib.h>
 
 int guac_rdp_common_svc_load_plugin(rdpContext* context,
-        char* name, ULONG channel_options,
+        char* name, ULONG channel_options, int async,
         guac_rdp_common_svc_connect_handler* connect_handler,
         guac_rdp_common_svc_receive_handler* receive_handler,
         guac_rdp_common_svc_terminate_handler* terminate_handler) {
@@ -42,6 +42,7 @@ int guac_rdp_common_svc_load_plugin(rdpContext* context,
     guac_rdp_common_svc* svc = guac_mem_zalloc(sizeof(guac_rdp_common_svc));
     svc->client = client;
     svc->name = svc->_channel_def.name;
+    svc->_async = async;
     svc->_connect_handler = connect_handler;
     svc->_receive_handler = receive_handler;
     svc->_terminate_handler = terminate_handler;
@@ -23,17 +23,28 @@
 #include <freerdp/freerdp.h>
 #include <freerdp/svc.h>
 #include <guacamole/client.h>
+#include <guacamole/fifo.h>
 #include <guacamole/stream.h>
 #include <winpr/stream.h>
 #include <winpr/wtsapi.h>
 #include <winpr/wtypes.h>
 
+#include <pthread.h>
+
 /**
  * The maximum number of bytes to allow within each channel name, including
  * null terminator.
  */
 #define GUAC_RDP_SVC_MAX_LENGTH 8
 
+/**
+ * The maximum number of reassembled blocks of received data that may be
+ * queued awaiting processing by the receive thread of an SVC that processes
+ * received data asynchronously. If the receive thread falls this far behind,
+ * further receipt of data blocks until the receive thread catches up.
+ */
+#define GUAC_SVC_RECEIVE_QUEUE_SIZE 64
+
 /**
  * The maximum number of bytes that the RDP server will be allowed to send
  * within any single write operation, regardless of the number of chunks that
@@ -47,6 +58,21 @@
  */
 typedef struct guac_rdp_common_svc guac_rdp_common_svc;
 
+/**
+ * A reassembled block of data received along an SVC and queued for
+ * processing by the receive thread of an SVC that processes received data
+ * asynchronously.
+ */
+typedef struct guac_rdp_common_svc_receive_entry {
+
+    /**
+     * The reassembled block of data that was received, or NULL if the
+     * receive thread should terminate.
+     */
+    wStream* stream;
+
+} guac_rdp_common_svc_receive_entry;
+
 /**
  * Handler which is invoked when a CHANNEL_EVENT_CONNECTED event has been
  * processed and the connection/initialization process of the SVC is now
@@ -160,6 +186,40 @@ struct guac_rdp_common_svc {
      */
     wStream* _input_stream;
 
+    /**
+     * Non-zero if received data should be processed asynchronously by a
+     * dedicated receive thread rather than inline within FreeRDP's message
+     * pump, as specified when the channel was loaded via
+     * guac_rdp_common_svc_load_plugin().
+     */
+    int _async;
+
+    /**
+     * Non-zero if the receive thread of this SVC has been started. This will
+     * only ever be the case for channels that process received data
+     * asynchronously, and only once the channel has actually connected.
+     */
+    int _receive_thread_started;
+
+    /**
+     * FIFO of all reassembled blocks of received data that are awaiting
+     * processing by the receive thread. Used only by channels that process
+     * received data asynchronously.
+     */
+    guac_fifo _receive_queue;
+
+    /**
+     * Storage for the items within the receive FIFO.
+     */
+    guac_rdp_common_svc_receive_entry _receive_queue_items[GUAC_SVC_RECEIVE_QUEUE_SIZE];
+
+    /**
+     * The thread that processes received data for this SVC, invoking the
+     * receive handler for each reassembled block in the order received. Used
+     * only by channels that process received data asynchronously.
+     */
+    pthread_t _receive_thread;
+
 };
 
 /**
@@ -188,6 +248,16 @@ struct guac_rdp_common_svc {
  *     whether specified here, the CHANNEL_OPTION_INTIALIZED and
  *     CHANNEL_OPTION_ENCRYPT_RDP flags will automatically be set.
  *
+ * @param async
+ *     Non-zero if received data should be processed by a dedicated receive
+ *     thread rather than inline within FreeRDP's message pump, zero
+ *     otherwise. Asynchronous processing is appropriate for channels whose
+ *     receive handlers may block on slow operations (such as disk I/O) that
+ *     would otherwise stall processing of graphical updates, and requires
+ *     that those handlers are safe to invoke concurrently with FreeRDP's
+ *     message pump. Blocks of received data are always processed in the
+ *     order received, regardless of this setting.
+ *
  * @param connect_handler
  *     The function to invoke when the SVC has been connected.
  *
@@ -204,7 +274,7 @@ struct guac_rdp_common_svc {
  *     not be loaded.
  */
 int guac_rdp_common_svc_load_plugin(rdpContext* context,
-        char* name, ULONG channel_options,
+        char* name, ULONG channel_options, int async,
         guac_rdp_common_svc_connect_handler* connect_handler,
         guac_rdp_common_svc_receive_handler* receive_handler,
         guac_rdp_common_svc_terminate_handler* terminate_handler);
@@ -48,7 +48,7 @@ void guac_rdp_pipe_svc_send_pipes(
     guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
 
     if (rdp_client->available_svc != NULL) {
-        guac_common_list_lock(rdp_client->available_svc);
+        guac_common_list_lock_read(rdp_client->available_svc);
 
         /* Send pipe for each allocated SVC's output stream */
         guac_common_list_element* current = rdp_client->available_svc->head;
@@ -79,7 +79,7 @@ guac_rdp_pipe_svc* guac_rdp_pipe_svc_get(guac_client* client, const char* name)
     guac_rdp_pipe_svc* found = NULL;
 
     /* For each available SVC */
-    guac_common_list_lock(rdp_client->available_svc);
+    guac_common_list_lock_read(rdp_client->available_svc);
     current = rdp_client->available_svc->head;
     while (current != NULL) {
 
@@ -224,7 +224,7 @@ void guac_rdp_pipe_svc_load_plugin(rdpContext* context, char* name) {
 
     /* Attempt to load support for static channel */
     guac_rdp_common_svc_load_plugin(context, name, CHANNEL_OPTION_COMPRESS_RDP,
-            guac_rdp_pipe_svc_process_connect,
+            0, guac_rdp_pipe_svc_process_connect,
             guac_rdp_pipe_svc_process_receive,
             guac_rdp_pipe_svc_process_terminate);
 
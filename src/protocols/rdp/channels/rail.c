@@ -28,7 +28,9 @@
 #include <freerdp/rail.h>
 #include <freerdp/window.h>
 #include <guacamole/client.h>
+#include <guacamole/display.h>
 #include <guacamole/mem.h>
+#include <guacamole/rect.h>
 #include <winpr/wtypes.h>
 #include <winpr/wtsapi.h>
 
@@ -244,6 +246,252 @@ static UINT guac_rdp_rail_handshake_ex(RailClientContext* rail,
     return guac_rdp_rail_complete_handshake(rail);
 }
 
+/**
+ * Returns the window geometry tracking entry associated with the given RAIL
+ * window ID, associating an unused entry with that window if the window is
+ * not yet tracked. If the window is not tracked and no unused entries remain,
+ * NULL is returned.
+ *
+ * @param tracker
+ *     The window geometry tracking state of the current RDP connection.
+ *
+ * @param window_id
+ *     The server-assigned ID of the window being looked up.
+ *
+ * @return
+ *     The tracking entry associated with the given window, or NULL if the
+ *     window is not tracked and no unused entries remain.
+ */
+static guac_rdp_rail_window* guac_rdp_rail_get_window(
+        guac_rdp_rail_window_tracker* tracker, UINT32 window_id) {
+
+    guac_rdp_rail_window* available = NULL;
+
+    /* Search for an existing entry, noting the first unused entry */
+    for (int i = 0; i < GUAC_RDP_RAIL_MAX_WINDOWS; i++) {
+
+        guac_rdp_rail_window* window = &(tracker->windows[i]);
+        if (window->tracked) {
+            if (window->window_id == window_id)
+                return window;
+        }
+        else if (available == NULL)
+            available = window;
+
+    }
+
+    /* Window is not yet tracked - claim an unused entry, if any */
+    if (available != NULL) {
+        available->tracked = 1;
+        available->window_id = window_id;
+        guac_rect_init(&available->bounds, 0, 0, 0, 0);
+    }
+
+    return available;
+
+}
+
+/**
+ * Communicates the given window movement to the display as a copy hint.
+ * Window orders are delivered by the same thread that brackets GDI drawing
+ * with BeginPaint/EndPaint, so if a paint is currently underway, the hint is
+ * applied to the open raw context directly. Otherwise, the movement is queued
+ * and will be applied when the next paint begins (see
+ * guac_rdp_rail_apply_pending_moves()).
+ *
+ * @param rdp_client
+ *     The guac_rdp_client associated with the RDP connection.
+ *
+ * @param src
+ *     The region of the screen that the window covered prior to the move.
+ *
+ * @param dst
+ *     The region of the screen that the window covers after the move.
+ */
+static void guac_rdp_rail_hint_move(guac_rdp_client* rdp_client,
+        const guac_rect* src, const guac_rect* dst) {
+
+    /* Apply hint immediately if a paint is underway */
+    if (rdp_client->current_context != NULL) {
+        guac_display_layer_raw_context_hint_copy(rdp_client->current_context,
+                src, dst);
+        return;
+    }
+
+    /* Otherwise, queue the movement for the next paint (movements beyond the
+     * capacity of the queue are simply dropped - the hint is purely an
+     * optimization) */
+    guac_rdp_rail_window_tracker* tracker = &(rdp_client->rail_windows);
+    if (tracker->num_pending_moves < GUAC_RDP_RAIL_MAX_WINDOWS) {
+        guac_rdp_rail_window_move* move =
+            &(tracker->pending_moves[tracker->num_pending_moves++]);
+        move->src = *src;
+        move->dst = *dst;
+    }
+
+}
+
+void guac_rdp_rail_apply_pending_moves(guac_client* client,
+        guac_display_layer_raw_context* context) {
+
+    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+    guac_rdp_rail_window_tracker* tracker = &(rdp_client->rail_windows);
+
+    for (int i = 0; i < tracker->num_pending_moves; i++) {
+        guac_rdp_rail_window_move* move = &(tracker->pending_moves[i]);
+        guac_display_layer_raw_context_hint_copy(context, &move->src,
+                &move->dst);
+    }
+
+    tracker->num_pending_moves = 0;
+
+}
+
+/**
+ * Updates the tracked geometry of the window referred to by the given window
+ * order, hinting the resulting movement to the display if the window has
+ * moved without changing size. Orders that carry no geometry fields are
+ * ignored.
+ *
+ * @param client
+ *     The guac_client associated with the RDP connection.
+ *
+ * @param orderInfo
+ *     A pointer to the data structure that contains information about what
+ *     window was updated and what updates were performed.
+ *
+ * @param windowState
+ *     A pointer to the data structure that contains details of the updates
+ *     to the window, as indicated by flags in the orderInfo field.
+ */
+static void guac_rdp_rail_update_geometry(guac_client* client,
+        RAIL_CONST WINDOW_ORDER_INFO* orderInfo,
+        RAIL_CONST WINDOW_STATE_ORDER* windowState) {
+
+    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+    UINT32 fieldFlags = orderInfo->fieldFlags;
+
+    /* Nothing to do if the order carries no geometry */
+    if (!(fieldFlags & (WINDOW_ORDER_FIELD_WND_OFFSET | WINDOW_ORDER_FIELD_WND_SIZE)))
+        return;
+
+    guac_rdp_rail_window* window =
+        guac_rdp_rail_get_window(&(rdp_client->rail_windows), orderInfo->windowId);
+    if (window == NULL)
+        return;
+
+    /* Apply whichever geometry fields are present over the last known bounds
+     * of the window */
+    int x = window->bounds.left;
+    int y = window->bounds.top;
+    int width = guac_rect_width(&window->bounds);
+    int height = guac_rect_height(&window->bounds);
+
+    if (fieldFlags & WINDOW_ORDER_FIELD_WND_OFFSET) {
+        x = windowState->windowOffsetX;
+        y = windowState->windowOffsetY;
+    }
+
+    if (fieldFlags & WINDOW_ORDER_FIELD_WND_SIZE) {
+        width = windowState->windowWidth;
+        height = windowState->windowHeight;
+    }
+
+    guac_rect new_bounds;
+    guac_rect_init(&new_bounds, x, y, width, height);
+
+    /* If the window has simply moved (same dimensions, different position),
+     * hint to the display that the server's coming repaint of the window at
+     * its new position can largely be satisfied by copying the window's
+     * previous on-screen contents client-side. The display verifies hinted
+     * copies against actual image contents before relying on them, so hints
+     * rendered stale by overlapping or redrawn windows cost nothing beyond
+     * the discarded hint. */
+    if (width > 0 && height > 0
+            && width == guac_rect_width(&window->bounds)
+            && height == guac_rect_height(&window->bounds)
+            && (x != window->bounds.left || y != window->bounds.top))
+        guac_rdp_rail_hint_move(rdp_client, &window->bounds, &new_bounds);
+
+    window->bounds = new_bounds;
+
+}
+
+/**
+ * A callback function that is executed when the RDP server reports the
+ * creation of a RAIL window.
+ *
+ * @param context
+ *     A pointer to the rdpContext structure used by FreeRDP to handle the
+ *     window update.
+ *
+ * @param orderInfo
+ *     A pointer to the data structure that contains information about the
+ *     window that was created.
+ *
+ * @param windowState
+ *     A pointer to the data structure that contains details of the initial
+ *     state of the window, as indicated by flags in the orderInfo field.
+ *
+ * @return
+ *     TRUE if the client-side processing of the creation was successful;
+ *     otherwise FALSE. This implementation always returns TRUE.
+ */
+static BOOL guac_rdp_rail_window_create(rdpContext* context,
+        RAIL_CONST WINDOW_ORDER_INFO* orderInfo,
+        RAIL_CONST WINDOW_STATE_ORDER* windowState) {
+
+    guac_client* client = ((rdp_freerdp_context*) context)->client;
+
+    guac_client_log(client, GUAC_LOG_TRACE, "RAIL window created: %i",
+            (int) orderInfo->windowId);
+
+    /* Record the initial geometry of the new window */
+    guac_rdp_rail_update_geometry(client, orderInfo, windowState);
+
+    return TRUE;
+
+}
+
+/**
+ * A callback function that is executed when the RDP server reports that a
+ * RAIL window has been destroyed.
+ *
+ * @param context
+ *     A pointer to the rdpContext structure used by FreeRDP to handle the
+ *     window update.
+ *
+ * @param orderInfo
+ *     A pointer to the data structure that contains information about the
+ *     window that was destroyed.
+ *
+ * @return
+ *     TRUE if the client-side processing of the deletion was successful;
+ *     otherwise FALSE. This implementation always returns TRUE.
+ */
+static BOOL guac_rdp_rail_window_delete(rdpContext* context,
+        RAIL_CONST WINDOW_ORDER_INFO* orderInfo) {
+
+    guac_client* client = ((rdp_freerdp_context*) context)->client;
+    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+    guac_rdp_rail_window_tracker* tracker = &(rdp_client->rail_windows);
+
+    guac_client_log(client, GUAC_LOG_TRACE, "RAIL window destroyed: %i",
+            (int) orderInfo->windowId);
+
+    /* Cease tracking the geometry of the destroyed window */
+    for (int i = 0; i < GUAC_RDP_RAIL_MAX_WINDOWS; i++) {
+        guac_rdp_rail_window* window = &(tracker->windows[i]);
+        if (window->tracked && window->window_id == orderInfo->windowId) {
+            window->tracked = 0;
+            break;
+        }
+    }
+
+    return TRUE;
+
+}
+
 /**
  * A callback function that is executed when an update for a RAIL window is
  * received from the RDP server.
@@ -292,6 +540,10 @@ static BOOL guac_rdp_rail_window_update(rdpContext* context,
         }
     }
 
+    /* Track window geometry such that window movement can be hinted to the
+     * display as a client-side copy */
+    guac_rdp_rail_update_geometry(client, orderInfo, windowState);
+
     return TRUE;
 
 }
@@ -335,7 +587,9 @@ static void guac_rdp_rail_channel_connected(rdpContext* context,
     rail->ServerExecuteResult = guac_rdp_rail_execute_result;
     rail->ServerHandshake = guac_rdp_rail_handshake;
     rail->ServerHandshakeEx = guac_rdp_rail_handshake_ex;
+    context->update->window->WindowCreate = guac_rdp_rail_window_create;
     context->update->window->WindowUpdate = guac_rdp_rail_window_update;
+    context->update->window->WindowDelete = guac_rdp_rail_window_delete;
 
     guac_client_log(client, GUAC_LOG_DEBUG, "RAIL (RemoteApp) channel "
             "connected.");
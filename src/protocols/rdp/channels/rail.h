@@ -24,6 +24,10 @@
 
 #include <freerdp/freerdp.h>
 #include <freerdp/window.h>
+#include <guacamole/client.h>
+#include <guacamole/display.h>
+#include <guacamole/rect.h>
+#include <winpr/wtypes.h>
 
 #ifdef FREERDP_RAIL_CALLBACKS_REQUIRE_CONST
 /**
@@ -49,6 +53,104 @@
  */
 #define GUAC_RDP_RAIL_WINDOW_STATE_MINIMIZED 0x02
 
+/**
+ * The maximum number of top-level RemoteApp windows whose on-screen geometry
+ * will be tracked simultaneously. Windows beyond this limit simply are not
+ * tracked, and moving them will not benefit from client-side copy hints.
+ */
+#define GUAC_RDP_RAIL_MAX_WINDOWS 16
+
+/**
+ * The last known on-screen geometry of a single top-level RemoteApp window,
+ * as reported by the RDP server through RAIL window orders.
+ */
+typedef struct guac_rdp_rail_window {
+
+    /**
+     * The server-assigned ID of this window.
+     */
+    UINT32 window_id;
+
+    /**
+     * Non-zero if this entry is currently associated with a window, zero if
+     * this entry is unused.
+     */
+    int tracked;
+
+    /**
+     * The region of the screen that was covered by this window when its
+     * geometry was last reported.
+     */
+    guac_rect bounds;
+
+} guac_rdp_rail_window;
+
+/**
+ * A single window movement that has been reported by the RDP server but not
+ * yet communicated to the display as a copy hint.
+ */
+typedef struct guac_rdp_rail_window_move {
+
+    /**
+     * The region of the screen that the window covered prior to the move.
+     */
+    guac_rect src;
+
+    /**
+     * The region of the screen that the window covers after the move.
+     */
+    guac_rect dst;
+
+} guac_rdp_rail_window_move;
+
+/**
+ * Tracking state for the on-screen geometry of all top-level RemoteApp
+ * windows. This state is used to translate server-side window movement into
+ * client-side copy hints: when a window moves without changing size, the
+ * server's repaint of that window at its new position is largely identical to
+ * content already on the client's screen, and hinting this to the display
+ * allows the repaint to be sent as a copy instruction rather than re-encoded
+ * image data.
+ */
+typedef struct guac_rdp_rail_window_tracker {
+
+    /**
+     * The last known geometry of each tracked window.
+     */
+    guac_rdp_rail_window windows[GUAC_RDP_RAIL_MAX_WINDOWS];
+
+    /**
+     * All window movements that have been reported by the RDP server while no
+     * paint was underway, and which are thus pending application to the
+     * display as copy hints when the next paint begins.
+     */
+    guac_rdp_rail_window_move pending_moves[GUAC_RDP_RAIL_MAX_WINDOWS];
+
+    /**
+     * The number of window movements currently stored within pending_moves.
+     */
+    int num_pending_moves;
+
+} guac_rdp_rail_window_tracker;
+
+/**
+ * Applies all window movements that were reported by the RDP server while no
+ * paint was underway to the given raw context as copy hints, emptying the
+ * queue of pending movements. This function must be invoked when a paint
+ * begins, after the raw context of the default layer has been opened. If
+ * RemoteApp is not in use, or no window movements are pending, this function
+ * has no effect.
+ *
+ * @param client
+ *     The guac_client associated with the RDP connection.
+ *
+ * @param context
+ *     The raw context of the default layer, as opened for the paint that is
+ *     now beginning.
+ */
+void guac_rdp_rail_apply_pending_moves(guac_client* client,
+        guac_display_layer_raw_context* context);
+
 /**
  * Initializes RemoteApp support for RDP and handling of the RAIL channel. If
  * failures occur, messages noting the specifics of those failures will be
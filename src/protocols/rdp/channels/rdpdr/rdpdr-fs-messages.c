@@ -470,7 +470,7 @@ void guac_rdpdr_fs_process_query_directory(guac_rdp_common_svc* svc,
     int fs_information_class, initial_query;
     int path_length;
 
-    const char* entry_name;
+    const guac_rdp_fs_dir_entry* entry;
 
     /* Get file */
     file = guac_rdp_fs_get_file((guac_rdp_fs*) device->data, iorequest->file_id);
@@ -516,59 +516,49 @@ void guac_rdpdr_fs_process_query_directory(guac_rdp_common_svc* svc,
             iorequest->file_id, initial_query, file->dir_pattern);
 
     /* Find first matching entry in directory */
-    while ((entry_name = guac_rdp_fs_read_dir((guac_rdp_fs*) device->data,
+    while ((entry = guac_rdp_fs_read_dir_entry((guac_rdp_fs*) device->data,
                     iorequest->file_id)) != NULL) {
 
         /* Convert to absolute path */
         char entry_path[GUAC_RDP_FS_MAX_PATH];
         if (guac_rdp_fs_convert_path(file->absolute_path,
-                    entry_name, entry_path) == 0) {
-
-            int entry_file_id;
+                    entry->name, entry_path) == 0) {
 
             /* Pattern defined and match fails, continue with next file */
             if (guac_rdp_fs_matches(entry_path, file->dir_pattern))
                 continue;
 
-            /* Open directory entry */
-            entry_file_id = guac_rdp_fs_open((guac_rdp_fs*) device->data,
-                    entry_path, FILE_READ_DATA, 0, FILE_OPEN, 0);
-
-            if (entry_file_id >= 0) {
-
-                /* Dispatch to appropriate class-specific handler */
-                switch (fs_information_class) {
-
-                    case FileDirectoryInformation:
-                        guac_rdpdr_fs_process_query_directory_info(svc, device,
-                                iorequest, entry_name, entry_file_id);
-                        break;
-
-                    case FileFullDirectoryInformation:
-                        guac_rdpdr_fs_process_query_full_directory_info(svc,
-                                device, iorequest, entry_name, entry_file_id);
-                        break;
-
-                    case FileBothDirectoryInformation:
-                        guac_rdpdr_fs_process_query_both_directory_info(svc,
-                                device, iorequest, entry_name, entry_file_id);
-                        break;
-
-                    case FileNamesInformation:
-                        guac_rdpdr_fs_process_query_names_info(svc, device,
-                                iorequest, entry_name, entry_file_id);
-                        break;
-
-                    default:
-                        guac_client_log(svc->client, GUAC_LOG_DEBUG,
-                                "Unknown dir information class: 0x%x",
-                                fs_information_class);
-                }
+            /* Dispatch to appropriate class-specific handler */
+            switch (fs_information_class) {
+
+                case FileDirectoryInformation:
+                    guac_rdpdr_fs_process_query_directory_info(svc, device,
+                            iorequest, entry);
+                    break;
+
+                case FileFullDirectoryInformation:
+                    guac_rdpdr_fs_process_query_full_directory_info(svc,
+                            device, iorequest, entry);
+                    break;
+
+                case FileBothDirectoryInformation:
+                    guac_rdpdr_fs_process_query_both_directory_info(svc,
+                            device, iorequest, entry);
+                    break;
+
+                case FileNamesInformation:
+                    guac_rdpdr_fs_process_query_names_info(svc, device,
+                            iorequest, entry);
+                    break;
+
+                default:
+                    guac_client_log(svc->client, GUAC_LOG_DEBUG,
+                            "Unknown dir information class: 0x%x",
+                            fs_information_class);
+            }
 
-                guac_rdp_fs_close((guac_rdp_fs*) device->data, entry_file_id);
-                return;
+            return;
 
-            } /* end if file exists */
         } /* end if path valid */
     } /* end if entry exists */
 
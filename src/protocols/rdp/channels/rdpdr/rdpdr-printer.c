@@ -223,5 +223,9 @@ void guac_rdpdr_register_printer(guac_rdp_common_svc* svc, char* printer_name) {
     device->iorequest_handler = guac_rdpdr_device_printer_iorequest_handler;
     device->free_handler      = guac_rdpdr_device_printer_free_handler;
 
+    /* Start a filter process ahead of the first print job such that the
+     * interpreter startup of the filter does not delay that job */
+    guac_rdp_print_job_prewarm(svc->client);
+
 }
 
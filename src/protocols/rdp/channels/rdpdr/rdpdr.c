@@ -182,9 +182,11 @@ void guac_rdpdr_load_plugin(rdpContext* context) {
 
     guac_client* client = ((rdp_freerdp_context*) context)->client;
 
-    /* Load support for RDPDR */
+    /* Load support for RDPDR, processing received data asynchronously such
+     * that device I/O (bulk file transfers to redirected drives, print jobs)
+     * does not stall processing of graphical updates */
     if (guac_rdp_common_svc_load_plugin(context, "rdpdr",
-                CHANNEL_OPTION_COMPRESS_RDP, guac_rdpdr_process_connect,
+                CHANNEL_OPTION_COMPRESS_RDP, 1, guac_rdpdr_process_connect,
                 guac_rdpdr_process_receive, guac_rdpdr_process_terminate)) {
         guac_client_log(client, GUAC_LOG_WARNING, "Support for the RDPDR "
                 "channel (device redirection) could not be loaded. Drive "
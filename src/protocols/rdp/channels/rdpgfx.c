@@ -24,13 +24,128 @@
 
 #include <freerdp/client/rdpgfx.h>
 #include <freerdp/freerdp.h>
+#include <freerdp/gdi/gdi.h>
 #include <freerdp/gdi/gfx.h>
 #include <freerdp/event.h>
 #include <guacamole/client.h>
+#include <guacamole/layer.h>
+#include <guacamole/mem.h>
+#include <guacamole/protocol.h>
+#include <guacamole/socket.h>
+#include <guacamole/stream.h>
 
 #include <stdlib.h>
 #include <string.h>
 
+guac_rdp_rdpgfx* guac_rdp_rdpgfx_alloc(void) {
+    return guac_mem_zalloc(sizeof(guac_rdp_rdpgfx));
+}
+
+void guac_rdp_rdpgfx_free(guac_rdp_rdpgfx* rdpgfx) {
+    guac_mem_free(rdpgfx);
+}
+
+/**
+ * Forwards the H.264 bitstream of the given AVC420 surface command directly
+ * to all connected clients as part of a "video/h264" stream, bypassing
+ * server-side decoding and re-encoding entirely. The stream is opened upon
+ * the first region received and remains open for the duration of the
+ * connection.
+ *
+ * @param client
+ *     The guac_client associated with the active RDP session.
+ *
+ * @param gfx
+ *     The current state of Guacamole's handling of the RDPGFX channel.
+ *
+ * @param cmd
+ *     The AVC420 surface command whose bitstream should be forwarded.
+ *
+ * @return
+ *     CHANNEL_RC_OK if the bitstream was successfully forwarded,
+ *     ERROR_INVALID_DATA if the surface command is too short to contain a
+ *     valid RFX_AVC420_BITMAP_STREAM.
+ */
+static UINT guac_rdp_rdpgfx_forward_avc420(guac_client* client,
+        guac_rdp_rdpgfx* gfx, const RDPGFX_SURFACE_COMMAND* cmd) {
+
+    guac_socket* socket = client->socket;
+
+    const BYTE* data = cmd->data;
+    UINT32 length = cmd->length;
+
+    /* Skip past the RFX_AVC420_METABLOCK preceding the H.264 bitstream,
+     * which consists of a 32-bit region count followed by an 8-byte
+     * rectangle and a 2-byte quality value for each region (see
+     * [MS-RDPEGFX], sections 2.2.4.4 and 2.2.4.4.2) */
+    if (length < 4)
+        return ERROR_INVALID_DATA;
+
+    UINT32 num_rects = (UINT32) data[0]
+                     | ((UINT32) data[1] << 8)
+                     | ((UINT32) data[2] << 16)
+                     | ((UINT32) data[3] << 24);
+
+    UINT64 meta_length = 4 + (UINT64) num_rects * 10;
+    if (length < meta_length)
+        return ERROR_INVALID_DATA;
+
+    /* Open the video stream upon the first region received */
+    if (gfx->video_stream == NULL) {
+        gfx->video_stream = guac_client_alloc_stream(client);
+        guac_protocol_send_video(socket, gfx->video_stream,
+                GUAC_DEFAULT_LAYER, "video/h264");
+    }
+
+    /* Forward the bitstream as-is. Encoding of graphical changes is entirely
+     * the responsibility of the RDP server here, so the data is flushed
+     * immediately rather than waiting for any frame boundary known to
+     * guac_display. */
+    guac_protocol_send_blob(socket, gfx->video_stream,
+            data + meta_length, length - (UINT32) meta_length);
+    guac_socket_flush(socket);
+
+    return CHANNEL_RC_OK;
+
+}
+
+/**
+ * Callback which replaces the SurfaceCommand handler installed by FreeRDP's
+ * GDI implementation of the Graphics Pipeline when H.264 passthrough is
+ * enabled. H.264 (AVC420) regions are forwarded directly to connected
+ * clients, while all other surface commands continue to be decoded
+ * server-side by the original GDI handler.
+ *
+ * @param context
+ *     The RdpgfxClientContext associated with the active RDPGFX channel.
+ *
+ * @param cmd
+ *     The received surface command.
+ *
+ * @return
+ *     CHANNEL_RC_OK if the command was processed successfully, an
+ *     implementation-specific error code otherwise.
+ */
+static UINT guac_rdp_rdpgfx_surface_command(RdpgfxClientContext* context,
+        const RDPGFX_SURFACE_COMMAND* cmd) {
+
+    /* gdi_graphics_pipeline_init() stores the rdpGdi* within the custom
+     * member of the RdpgfxClientContext, and this handler is only ever
+     * installed after that initialization has succeeded */
+    rdpGdi* gdi = (rdpGdi*) context->custom;
+    guac_client* client = ((rdp_freerdp_context*) gdi->context)->client;
+    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+    guac_rdp_rdpgfx* gfx = rdp_client->rdpgfx;
+
+    /* Forward H.264 regions directly to connected clients */
+    if (cmd->codecId == RDPGFX_CODECID_AVC420)
+        return guac_rdp_rdpgfx_forward_avc420(client, gfx, cmd);
+
+    /* All other codecs continue to be decoded server-side */
+    return gfx->gdi_surface_command(context, cmd);
+
+}
+
 /**
  * Callback which associates handlers specific to Guacamole with the
  * RdpgfxClientContext instance allocated by FreeRDP to deal with received
@@ -65,10 +180,26 @@ static void guac_rdp_rdpgfx_channel_connected(rdpContext* context,
     if (!gdi_graphics_pipeline_init(gdi, rdpgfx))
         guac_client_log(client, GUAC_LOG_WARNING, "Rendering backend for RDPGFX "
                 "channel could not be loaded. Graphics may not render at all!");
-    else
+    else {
+
         guac_client_log(client, GUAC_LOG_DEBUG, "RDPGFX channel will be used for "
                 "the RDP Graphics Pipeline Extension.");
 
+        /* If H.264 passthrough is enabled (and thus H.264 has been
+         * negotiated), intercept surface commands such that AVC420 regions
+         * are forwarded directly to connected clients rather than decoded
+         * and re-encoded server-side */
+        guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+        if (rdp_client->settings->enable_gfx_h264) {
+            rdp_client->rdpgfx->gdi_surface_command = rdpgfx->SurfaceCommand;
+            rdpgfx->SurfaceCommand = guac_rdp_rdpgfx_surface_command;
+            guac_client_log(client, GUAC_LOG_INFO, "H.264 (AVC420) regions "
+                    "will be forwarded directly to connected clients without "
+                    "being re-encoded.");
+        }
+
+    }
+
 }
 
 /**
@@ -96,8 +227,25 @@ static void guac_rdp_rdpgfx_channel_disconnected(rdpContext* context,
     if (strcmp(args->name, RDPGFX_DVC_CHANNEL_NAME) != 0)
         return;
 
-    /* Un-init GDI-backed support for the Graphics Pipeline */
+    /* Restore the original GDI surface command handler and close the video
+     * stream if H.264 passthrough was active */
     RdpgfxClientContext* rdpgfx = (RdpgfxClientContext*) args->pInterface;
+    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+    guac_rdp_rdpgfx* gfx = rdp_client->rdpgfx;
+    if (gfx->gdi_surface_command != NULL) {
+
+        rdpgfx->SurfaceCommand = gfx->gdi_surface_command;
+        gfx->gdi_surface_command = NULL;
+
+        if (gfx->video_stream != NULL) {
+            guac_protocol_send_end(client->socket, gfx->video_stream);
+            guac_client_free_stream(client, gfx->video_stream);
+            gfx->video_stream = NULL;
+        }
+
+    }
+
+    /* Un-init GDI-backed support for the Graphics Pipeline */
     rdpGdi* gdi = context->gdi;
     gdi_graphics_pipeline_uninit(gdi, rdpgfx);
 
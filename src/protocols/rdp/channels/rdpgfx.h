@@ -25,6 +25,51 @@
 #include <freerdp/client/rdpgfx.h>
 #include <freerdp/freerdp.h>
 #include <guacamole/client.h>
+#include <guacamole/stream.h>
+
+/**
+ * The current state of Guacamole's handling of the RDPGFX (Graphics Pipeline)
+ * channel. This state is used only when H.264 (AVC420) passthrough is
+ * enabled, in which case received H.264 regions are forwarded directly to
+ * connected clients as a video stream rather than decoded and re-encoded
+ * server-side.
+ */
+typedef struct guac_rdp_rdpgfx {
+
+    /**
+     * The SurfaceCommand handler originally installed by FreeRDP's GDI
+     * implementation of the Graphics Pipeline, which decodes received
+     * graphics data server-side. Surface commands that are not forwarded
+     * directly to connected clients are passed through to this handler.
+     */
+    UINT (*gdi_surface_command)(RdpgfxClientContext* context,
+            const RDPGFX_SURFACE_COMMAND* cmd);
+
+    /**
+     * The stream over which H.264 data is being forwarded to connected
+     * clients, or NULL if no such stream has yet been opened.
+     */
+    guac_stream* video_stream;
+
+} guac_rdp_rdpgfx;
+
+/**
+ * Allocates storage for the state of Guacamole's handling of the RDPGFX
+ * channel. The returned state must eventually be freed with a call to
+ * guac_rdp_rdpgfx_free().
+ *
+ * @return
+ *     A newly-allocated guac_rdp_rdpgfx.
+ */
+guac_rdp_rdpgfx* guac_rdp_rdpgfx_alloc(void);
+
+/**
+ * Frees the storage allocated by guac_rdp_rdpgfx_alloc().
+ *
+ * @param rdpgfx
+ *     The guac_rdp_rdpgfx to free.
+ */
+void guac_rdp_rdpgfx_free(guac_rdp_rdpgfx* rdpgfx);
 
 /**
  * Adds FreeRDP's "rdpgfx" plugin to the list of dynamic virtual channel plugins
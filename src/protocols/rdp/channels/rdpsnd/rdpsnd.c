@@ -101,7 +101,7 @@ void guac_rdpsnd_load_plugin(rdpContext* context) {
     guac_client* client = ((rdp_freerdp_context*) context)->client;
 
     /* Load support for RDPSND */
-    if (guac_rdp_common_svc_load_plugin(context, "rdpsnd", 0,
+    if (guac_rdp_common_svc_load_plugin(context, "rdpsnd", 0, 0,
                 guac_rdpsnd_process_connect, guac_rdpsnd_process_receive,
                 guac_rdpsnd_process_terminate)) {
         guac_client_log(client, GUAC_LOG_WARNING, "Support for the RDPSND "
@@ -208,6 +208,9 @@ int guac_client_init(guac_client* client, int argc, char** argv) {
     /* Init clipboard */
     rdp_client->clipboard = guac_rdp_clipboard_alloc(client);
 
+    /* Init state of the RDPGFX (Graphics Pipeline) channel */
+    rdp_client->rdpgfx = guac_rdp_rdpgfx_alloc();
+
     /* Init display update module */
     rdp_client->disp = guac_rdp_disp_alloc(client);
 
@@ -225,6 +228,7 @@ int guac_client_init(guac_client* client, int argc, char** argv) {
     /* Init required locks */
     guac_rwlock_init(&(rdp_client->lock));
     pthread_mutex_init(&(rdp_client->message_lock), &(rdp_client->attributes));
+    pthread_mutex_init(&(rdp_client->prewarmed_filter_lock), &(rdp_client->attributes));
 
     /* Set handlers */
     client->join_handler = guac_rdp_user_join_handler;
@@ -232,6 +236,10 @@ int guac_client_init(guac_client* client, int argc, char** argv) {
     client->free_handler = guac_rdp_client_free_handler;
     client->leave_handler = guac_rdp_user_leave_handler;
 
+    /* Mouse events are forwarded to the RDP server as pointer state, so only
+     * the latest position matters for runs of pure movement */
+    client->coalesce_mouse_events = 1;
+
 #ifdef ENABLE_COMMON_SSH
     guac_common_ssh_init(client);
 #endif
@@ -262,6 +270,9 @@ int guac_rdp_client_free_handler(guac_client* client) {
     /* Clean up clipboard */
     guac_rdp_clipboard_free(rdp_client->clipboard);
 
+    /* Clean up state of the RDPGFX channel */
+    guac_rdp_rdpgfx_free(rdp_client->rdpgfx);
+
     /* Free display update module */
     guac_rdp_disp_free(rdp_client->disp);
 
@@ -280,6 +291,9 @@ int guac_rdp_client_free_handler(guac_client* client) {
         rdp_client->active_job = NULL;
     }
 
+    /* Discard pre-warmed print filter process, if any */
+    guac_rdp_print_job_discard_prewarmed(client);
+
 #ifdef ENABLE_COMMON_SSH
     /* Free SFTP filesystem, if loaded */
     if (rdp_client->sftp_filesystem)
@@ -310,6 +324,7 @@ int guac_rdp_client_free_handler(guac_client* client) {
 
     guac_rwlock_destroy(&(rdp_client->lock));
     pthread_mutex_destroy(&(rdp_client->message_lock));
+    pthread_mutex_destroy(&(rdp_client->prewarmed_filter_lock));
 
     /* Free client data */
     guac_mem_free(rdp_client);
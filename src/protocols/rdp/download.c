@@ -37,27 +37,35 @@
 
 #include <stdlib.h>
 
-int guac_rdp_download_ack_handler(guac_user* user, guac_stream* stream,
-        char* message, guac_protocol_status status) {
+/**
+ * Reads from the file associated with the given download and sends blobs to
+ * the user until the window of unacknowledged blobs is full, the file has
+ * been fully read, or a read error occurs. Once the file has been fully read
+ * (or a read error has occurred) and all sent blobs have been acknowledged,
+ * the stream is ended and the download status freed.
+ *
+ * @param user
+ *     The user receiving the downloaded file.
+ *
+ * @param fs
+ *     The filesystem containing the file being downloaded.
+ *
+ * @param stream
+ *     The Guacamole protocol stream along which the file is being sent. The
+ *     data associated with this stream must be a pointer to a
+ *     guac_rdp_download_status.
+ */
+static void guac_rdp_download_fill_window(guac_user* user, guac_rdp_fs* fs,
+        guac_stream* stream) {
 
-    guac_client* client = user->client;
-    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
     guac_rdp_download_status* download_status = (guac_rdp_download_status*) stream->data;
 
-    /* Get filesystem, return error if no filesystem */
-    guac_rdp_fs* fs = rdp_client->filesystem;
-    if (fs == NULL) {
-        guac_protocol_send_ack(user->socket, stream, "FAIL (NO FS)",
-                GUAC_PROTOCOL_STATUS_SERVER_ERROR);
-        guac_socket_flush(user->socket);
-        return 0;
-    }
-
-    /* If successful, read data */
-    if (status == GUAC_PROTOCOL_STATUS_SUCCESS) {
+    /* Keep the window of unacknowledged blobs full */
+    while (!download_status->complete
+            && download_status->outstanding < download_status->window) {
 
         /* Attempt read into buffer */
-        char buffer[4096];
+        char buffer[GUAC_RDP_DOWNLOAD_BLOB_SIZE];
         int bytes_read = guac_rdp_fs_read(fs,
                 download_status->file_id,
                 download_status->offset, buffer, sizeof(buffer));
@@ -65,33 +73,72 @@ int guac_rdp_download_ack_handler(guac_user* user, guac_stream* stream,
         /* If bytes read, send as blob */
         if (bytes_read > 0) {
             download_status->offset += bytes_read;
+            download_status->outstanding++;
             guac_protocol_send_blob(user->socket, stream,
                     buffer, bytes_read);
         }
 
-        /* If EOF, send end */
-        else if (bytes_read == 0) {
-            guac_protocol_send_end(user->socket, stream);
-            guac_user_free_stream(user, stream);
-            guac_mem_free(download_status);
-        }
-
-        /* Otherwise, fail stream */
+        /* If bytes could not be read, note EOF or error condition (the
+         * stream is ended only once all sent blobs have been acknowledged) */
         else {
-            guac_user_log(user, GUAC_LOG_ERROR,
-                    "Error reading file for download");
-            guac_protocol_send_end(user->socket, stream);
-            guac_user_free_stream(user, stream);
-            guac_mem_free(download_status);
+
+            if (bytes_read < 0)
+                guac_user_log(user, GUAC_LOG_ERROR,
+                        "Error reading file for download");
+
+            download_status->complete = 1;
+
         }
 
+    }
+
+    /* End stream once all data has been read and acknowledged */
+    if (download_status->complete && download_status->outstanding == 0) {
+        guac_protocol_send_end(user->socket, stream);
+        guac_user_free_stream(user, stream);
+        guac_mem_free(download_status);
+    }
+
+    guac_socket_flush(user->socket);
+
+}
+
+int guac_rdp_download_ack_handler(guac_user* user, guac_stream* stream,
+        char* message, guac_protocol_status status) {
+
+    guac_client* client = user->client;
+    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+    guac_rdp_download_status* download_status = (guac_rdp_download_status*) stream->data;
+
+    /* Get filesystem, return error if no filesystem */
+    guac_rdp_fs* fs = rdp_client->filesystem;
+    if (fs == NULL) {
+        guac_protocol_send_ack(user->socket, stream, "FAIL (NO FS)",
+                GUAC_PROTOCOL_STATUS_SERVER_ERROR);
         guac_socket_flush(user->socket);
+        return 0;
+    }
+
+    /* If successful, read and send more data */
+    if (status == GUAC_PROTOCOL_STATUS_SUCCESS) {
+
+        if (download_status->outstanding > 0)
+            download_status->outstanding--;
+
+        /* Widen the window of unacknowledged blobs with each received
+         * acknowledgement, up to the maximum */
+        if (download_status->window < GUAC_RDP_DOWNLOAD_MAX_WINDOW)
+            download_status->window++;
+
+        guac_rdp_download_fill_window(user, fs, stream);
 
     }
 
-    /* Otherwise, return stream to user */
-    else
+    /* Otherwise, abort transfer and return stream to user */
+    else {
+        guac_mem_free(download_status);
         guac_user_free_stream(user, stream);
+    }
 
     return 0;
 
@@ -154,9 +201,9 @@ int guac_rdp_download_get_handler(guac_user* user, guac_object* object,
     else if (!fs->disable_download) {
 
         /* Create stream data */
-        guac_rdp_download_status* download_status = guac_mem_alloc(sizeof(guac_rdp_download_status));
+        guac_rdp_download_status* download_status = guac_mem_zalloc(sizeof(guac_rdp_download_status));
         download_status->file_id = file_id;
-        download_status->offset = 0;
+        download_status->window = 1;
 
         /* Allocate stream for body */
         guac_stream* stream = guac_user_alloc_stream(user);
@@ -210,11 +257,11 @@ void* guac_rdp_download_to_user(guac_user* user, void* data) {
 
         /* Associate stream with transfer status */
         guac_stream* stream = guac_user_alloc_stream(user);
-        guac_rdp_download_status* download_status = guac_mem_alloc(sizeof(guac_rdp_download_status));
+        guac_rdp_download_status* download_status = guac_mem_zalloc(sizeof(guac_rdp_download_status));
         stream->data = download_status;
         stream->ack_handler = guac_rdp_download_ack_handler;
         download_status->file_id = file_id;
-        download_status->offset = 0;
+        download_status->window = 1;
 
         guac_user_log(user, GUAC_LOG_DEBUG, "%s: Initiating download "
                 "of \"%s\"", __func__, path);
@@ -28,6 +28,21 @@
 
 #include <stdint.h>
 
+/**
+ * The size of the blobs sent along the Guacamole protocol stream of a file
+ * being downloaded, in bytes.
+ */
+#define GUAC_RDP_DOWNLOAD_BLOB_SIZE 4096
+
+/**
+ * The maximum number of unacknowledged blobs that may be in flight at any
+ * given time during a file download. The window of unacknowledged blobs
+ * starts at one blob and grows with each received acknowledgement, up to this
+ * limit, such that download throughput scales with available bandwidth rather
+ * than being capped at one blob per round trip.
+ */
+#define GUAC_RDP_DOWNLOAD_MAX_WINDOW 16
+
 /**
  * The transfer status of a file being downloaded.
  */
@@ -43,6 +58,26 @@ typedef struct guac_rdp_download_status {
      */
     uint64_t offset;
 
+    /**
+     * The number of sent blobs for which no acknowledgement has yet been
+     * received.
+     */
+    int outstanding;
+
+    /**
+     * The maximum number of blobs that may currently be outstanding. This
+     * window starts at one blob and grows with each received
+     * acknowledgement, up to GUAC_RDP_DOWNLOAD_MAX_WINDOW.
+     */
+    int window;
+
+    /**
+     * Non-zero if the file has been fully read (or a read error has
+     * occurred), such that no further blobs will be sent. The stream will be
+     * ended once all outstanding blobs have been acknowledged.
+     */
+    int complete;
+
 } guac_rdp_download_status;
 
 /**
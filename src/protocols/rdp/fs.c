@@ -17,6 +17,8 @@
  * under the License.
  */
 
+#include "config.h"
+
 #include "fs.h"
 #include "download.h"
 #include "upload.h"
@@ -36,6 +38,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <fnmatch.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -43,6 +46,10 @@
 #include <sys/statvfs.h>
 #include <unistd.h>
 
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+
 guac_rdp_fs* guac_rdp_fs_alloc(guac_client* client, const char* drive_path,
         int create_drive_path, int disable_download, int disable_upload) {
 
@@ -69,11 +76,59 @@ guac_rdp_fs* guac_rdp_fs_alloc(guac_client* client, const char* drive_path,
     fs->disable_download = disable_download;
     fs->disable_upload = disable_upload;
 
+    /* Observe cached directories for changes via inotify, if available. If
+     * inotify is unavailable, directory listings simply are not cached. */
+#ifdef HAVE_SYS_INOTIFY_H
+    fs->notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fs->notify_fd == -1)
+        guac_client_log(client, GUAC_LOG_DEBUG, "Directory listing cache "
+                "disabled: %s", strerror(errno));
+#else
+    fs->notify_fd = -1;
+#endif
+
+    memset(fs->dir_cache, 0, sizeof(fs->dir_cache));
+    fs->dir_cache_next = 0;
+    pthread_mutex_init(&fs->dir_cache_lock, NULL);
+
     return fs;
 
 }
 
+/**
+ * Frees all memory associated with the given directory listing cache entry,
+ * marking it unused. The associated inotify watch, if still established, is
+ * NOT removed.
+ *
+ * @param entry
+ *     The cache entry to free.
+ */
+static void guac_rdp_fs_dir_cache_free_entry(
+        guac_rdp_fs_dir_cache_entry* entry) {
+
+    for (int i = 0; i < entry->num_entries; i++)
+        guac_mem_free(entry->entries[i].name);
+
+    guac_mem_free(entry->entries);
+    entry->entries = NULL;
+    entry->num_entries = 0;
+    entry->real_path[0] = '\0';
+
+}
+
 void guac_rdp_fs_free(guac_rdp_fs* fs) {
+
+    /* Free all cached directory listings */
+    for (int i = 0; i < GUAC_RDP_FS_DIR_CACHE_SIZE; i++) {
+        if (fs->dir_cache[i].entries != NULL)
+            guac_rdp_fs_dir_cache_free_entry(&(fs->dir_cache[i]));
+    }
+
+    if (fs->notify_fd != -1)
+        close(fs->notify_fd);
+
+    pthread_mutex_destroy(&fs->dir_cache_lock);
+
     guac_pool_free(fs->file_id_pool);
     guac_mem_free(fs->drive_path);
     guac_mem_free(fs);
@@ -366,6 +421,9 @@ int guac_rdp_fs_open(guac_rdp_fs* fs, const char* path,
     file->id = file_id;
     file->fd  = fd;
     file->dir = NULL;
+    file->dir_entries = NULL;
+    file->num_dir_entries = 0;
+    file->dir_entries_read = 0;
     file->dir_pattern[0] = '\0';
     file->absolute_path = guac_strdup(normalized_path);
     file->real_path = guac_strdup(real_path);
@@ -571,6 +629,13 @@ void guac_rdp_fs_close(guac_rdp_fs* fs, int file_id) {
     if (file->dir != NULL)
         closedir(file->dir);
 
+    /* Free directory snapshot, if present */
+    if (file->dir_entries != NULL) {
+        for (int i = 0; i < file->num_dir_entries; i++)
+            guac_mem_free(file->dir_entries[i].name);
+        guac_mem_free(file->dir_entries);
+    }
+
     /* Close file */
     close(file->fd);
 
@@ -584,31 +649,316 @@ void guac_rdp_fs_close(guac_rdp_fs* fs, int file_id) {
 
 }
 
-const char* guac_rdp_fs_read_dir(guac_rdp_fs* fs, int file_id) {
+/**
+ * Discards all cached directory listings whose underlying directories have
+ * changed, as reported by pending inotify events. The directory listing cache
+ * lock must already be held by the caller.
+ *
+ * @param fs
+ *     The filesystem whose directory listing cache should be brought up to
+ *     date.
+ */
+static void guac_rdp_fs_dir_cache_drain(guac_rdp_fs* fs) {
 
-    guac_rdp_fs_file* file;
+#ifdef HAVE_SYS_INOTIFY_H
+    char buffer[4096];
+    ssize_t length;
+
+    /* Process all pending change notifications */
+    while ((length = read(fs->notify_fd, buffer, sizeof(buffer))) > 0) {
+
+        ssize_t offset = 0;
+        while (offset < length) {
+
+            struct inotify_event* event =
+                (struct inotify_event*) (buffer + offset);
+
+            /* Discard the cached listing of the changed directory, if still
+             * cached. The watch is not removed if the event is the kernel's
+             * notice that the watch itself is gone. */
+            for (int i = 0; i < GUAC_RDP_FS_DIR_CACHE_SIZE; i++) {
+
+                guac_rdp_fs_dir_cache_entry* entry = &(fs->dir_cache[i]);
+                if (entry->entries == NULL || entry->watch != event->wd)
+                    continue;
+
+                if (!(event->mask & IN_IGNORED))
+                    inotify_rm_watch(fs->notify_fd, entry->watch);
+
+                guac_rdp_fs_dir_cache_free_entry(entry);
+
+            }
+
+            offset += sizeof(struct inotify_event) + event->len;
+
+        }
+
+    }
+#endif
+
+}
+
+/**
+ * Copies the cached listing of the directory associated with the given file
+ * into that file's directory snapshot, if an up-to-date listing is cached.
+ *
+ * @param fs
+ *     The filesystem associated with the given file.
+ *
+ * @param file
+ *     The open directory whose snapshot should be populated from the cache.
+ *
+ * @return
+ *     Non-zero if a cached listing was found and copied, zero otherwise.
+ */
+static int guac_rdp_fs_dir_cache_fetch(guac_rdp_fs* fs,
+        guac_rdp_fs_file* file) {
+
+    int found = 0;
+
+    if (fs->notify_fd == -1)
+        return 0;
+
+    pthread_mutex_lock(&fs->dir_cache_lock);
+
+    /* Discard listings invalidated by filesystem changes before searching */
+    guac_rdp_fs_dir_cache_drain(fs);
+
+    for (int i = 0; i < GUAC_RDP_FS_DIR_CACHE_SIZE; i++) {
+
+        guac_rdp_fs_dir_cache_entry* entry = &(fs->dir_cache[i]);
+        if (entry->entries == NULL
+                || strcmp(entry->real_path, file->real_path) != 0)
+            continue;
+
+        /* Copy cached listing into the snapshot of the open directory (the
+         * snapshot is owned by and freed with the directory handle) */
+        file->dir_entries = guac_mem_alloc(entry->num_entries,
+                sizeof(guac_rdp_fs_dir_entry));
+        file->num_dir_entries = entry->num_entries;
+        file->dir_entries_read = 0;
+
+        for (int j = 0; j < entry->num_entries; j++) {
+            file->dir_entries[j] = entry->entries[j];
+            file->dir_entries[j].name = guac_strdup(entry->entries[j].name);
+        }
+
+        found = 1;
+        break;
+
+    }
+
+    pthread_mutex_unlock(&fs->dir_cache_lock);
+    return found;
+
+}
+
+/**
+ * Stores a copy of the directory snapshot of the given file within the
+ * directory listing cache, establishing an inotify watch which will discard
+ * the cached listing as soon as the underlying directory changes. If the
+ * watch cannot be established, the listing is not cached.
+ *
+ * @param fs
+ *     The filesystem associated with the given file.
+ *
+ * @param file
+ *     The open directory whose snapshot should be cached.
+ */
+static void guac_rdp_fs_dir_cache_store(guac_rdp_fs* fs,
+        guac_rdp_fs_file* file) {
+
+#ifdef HAVE_SYS_INOTIFY_H
+    if (fs->notify_fd == -1)
+        return;
+
+    pthread_mutex_lock(&fs->dir_cache_lock);
+
+    /* Prefer the slot already caching this directory, then any unused slot,
+     * falling back to replacing slots round-robin */
+    guac_rdp_fs_dir_cache_entry* entry = NULL;
+    for (int i = 0; i < GUAC_RDP_FS_DIR_CACHE_SIZE; i++) {
+
+        if (strcmp(fs->dir_cache[i].real_path, file->real_path) == 0) {
+            entry = &(fs->dir_cache[i]);
+            break;
+        }
+
+        if (entry == NULL && fs->dir_cache[i].entries == NULL)
+            entry = &(fs->dir_cache[i]);
+
+    }
+
+    if (entry == NULL) {
+        entry = &(fs->dir_cache[fs->dir_cache_next]);
+        fs->dir_cache_next =
+            (fs->dir_cache_next + 1) % GUAC_RDP_FS_DIR_CACHE_SIZE;
+    }
+
+    /* Evict whatever the chosen slot previously cached */
+    if (entry->entries != NULL) {
+        inotify_rm_watch(fs->notify_fd, entry->watch);
+        guac_rdp_fs_dir_cache_free_entry(entry);
+    }
+
+    /* Cache the listing only if the directory can be watched for changes (a
+     * listing that cannot be invalidated must not be served from memory) */
+    entry->watch = inotify_add_watch(fs->notify_fd, file->real_path,
+            IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE
+            | IN_DELETE_SELF | IN_MOVED_FROM | IN_MOVED_TO | IN_MOVE_SELF);
+
+    if (entry->watch == -1) {
+        pthread_mutex_unlock(&fs->dir_cache_lock);
+        return;
+    }
+
+    /* Store copy of listing (the snapshot itself remains owned by the open
+     * directory handle) */
+    guac_strlcpy(entry->real_path, file->real_path,
+            sizeof(entry->real_path));
+
+    entry->entries = guac_mem_alloc(file->num_dir_entries,
+            sizeof(guac_rdp_fs_dir_entry));
+    entry->num_entries = file->num_dir_entries;
+
+    for (int i = 0; i < file->num_dir_entries; i++) {
+        entry->entries[i] = file->dir_entries[i];
+        entry->entries[i].name = guac_strdup(file->dir_entries[i].name);
+    }
+
+    pthread_mutex_unlock(&fs->dir_cache_lock);
+#endif
+
+}
+
+/**
+ * Enumerates the entire contents of the directory associated with the given
+ * file in one batch, including the file information of each entry, storing
+ * the resulting snapshot within that file. The file information of each
+ * entry is pulled with fstatat() relative to the already-open directory,
+ * avoiding any need to open and stat each file individually as directory
+ * queries are later answered. Listings of directories which have not changed
+ * since they were last enumerated are served from the directory listing
+ * cache without touching the filesystem at all.
+ *
+ * @param fs
+ *     The filesystem associated with the given file.
+ *
+ * @param file
+ *     The open directory whose contents should be enumerated.
+ *
+ * @return
+ *     Zero if enumeration succeeded, non-zero if the directory could not be
+ *     read.
+ */
+static int guac_rdp_fs_load_dir_entries(guac_rdp_fs* fs,
+        guac_rdp_fs_file* file) {
 
     struct dirent* result;
 
+    /* Open directory stream, stop if error */
+    file->dir = fdopendir(file->fd);
+    if (file->dir == NULL)
+        return 1;
+
+    /* Serve repeated listings of unchanged directories from memory */
+    if (guac_rdp_fs_dir_cache_fetch(fs, file))
+        return 0;
+
+    int capacity = 64;
+    file->dir_entries = guac_mem_alloc(capacity,
+            sizeof(guac_rdp_fs_dir_entry));
+    file->num_dir_entries = 0;
+    file->dir_entries_read = 0;
+
+    /* Read all entries, pulling the file information of each as we go */
+    while ((result = readdir(file->dir)) != NULL) {
+
+        /* Grow snapshot as necessary */
+        if (file->num_dir_entries == capacity) {
+            capacity *= 2;
+            file->dir_entries = guac_mem_realloc_or_die(file->dir_entries,
+                    capacity, sizeof(guac_rdp_fs_dir_entry));
+        }
+
+        guac_rdp_fs_dir_entry* entry =
+            &(file->dir_entries[file->num_dir_entries++]);
+
+        entry->name = guac_strdup(result->d_name);
+
+        /* Attempt to pull file information relative to open directory */
+        struct stat entry_stat;
+        if (fstatat(dirfd(file->dir), result->d_name, &entry_stat, 0) == 0) {
+
+            /* Load size and times */
+            entry->size  = entry_stat.st_size;
+            entry->ctime = WINDOWS_TIME(entry_stat.st_ctime);
+            entry->mtime = WINDOWS_TIME(entry_stat.st_mtime);
+            entry->atime = WINDOWS_TIME(entry_stat.st_atime);
+
+            /* Set type */
+            if (S_ISDIR(entry_stat.st_mode))
+                entry->attributes = FILE_ATTRIBUTE_DIRECTORY;
+            else
+                entry->attributes = FILE_ATTRIBUTE_NORMAL;
+
+        }
+
+        /* If information cannot be retrieved, fake it */
+        else {
+
+            /* Init information to 0, lacking any alternative */
+            entry->size  = 0;
+            entry->ctime = 0;
+            entry->mtime = 0;
+            entry->atime = 0;
+            entry->attributes = FILE_ATTRIBUTE_NORMAL;
+
+        }
+
+    }
+
+    /* Keep the fresh listing for future enumerations of this directory */
+    guac_rdp_fs_dir_cache_store(fs, file);
+
+    return 0;
+
+}
+
+const guac_rdp_fs_dir_entry* guac_rdp_fs_read_dir_entry(guac_rdp_fs* fs,
+        int file_id) {
+
+    guac_rdp_fs_file* file;
+
     /* Only read if file ID is valid */
     if (file_id < 0 || file_id >= GUAC_RDP_FS_MAX_FILES)
         return NULL;
 
     file = &(fs->files[file_id]);
 
-    /* Open directory if not yet open, stop if error */
-    if (file->dir == NULL) {
-        file->dir = fdopendir(file->fd);
-        if (file->dir == NULL)
-            return NULL;
-    }
+    /* Enumerate directory contents if not yet enumerated, stop if error */
+    if (file->dir == NULL && guac_rdp_fs_load_dir_entries(fs, file))
+        return NULL;
+
+    /* Stop if no more entries */
+    if (file->dir_entries_read >= file->num_dir_entries)
+        return NULL;
+
+    /* Return next entry within snapshot */
+    return &(file->dir_entries[file->dir_entries_read++]);
+
+}
+
+const char* guac_rdp_fs_read_dir(guac_rdp_fs* fs, int file_id) {
 
     /* Read next entry, stop if error or no more entries */
-    if ((result = readdir(file->dir)) == NULL)
+    const guac_rdp_fs_dir_entry* entry =
+        guac_rdp_fs_read_dir_entry(fs, file_id);
+    if (entry == NULL)
         return NULL;
 
     /* Return filename */
-    return result->d_name;
+    return entry->name;
 
 }
 
@@ -37,6 +37,7 @@
 #include <guacamole/user.h>
 
 #include <dirent.h>
+#include <pthread.h>
 #include <stdint.h>
 
 /**
@@ -54,6 +55,14 @@
  */
 #define GUAC_RDP_MAX_PATH_DEPTH 64
 
+/**
+ * The number of directory listings cached across directory handle closes.
+ * Each cached listing is kept coherent via an inotify watch on the underlying
+ * directory, and is dropped the moment any change occurs within that
+ * directory.
+ */
+#define GUAC_RDP_FS_DIR_CACHE_SIZE 8
+
 /**
  * Error code returned when no more file IDs can be allocated.
  */
@@ -114,6 +123,82 @@
  */
 #define WINDOWS_TIME(t) ((t + ((uint64_t) 11644473600)) * 10000000)
 
+/**
+ * A single entry within a directory, as enumerated in one batch when the
+ * directory is first read. The name and all file information are retrieved
+ * at enumeration time, such that answering each individual directory query
+ * received over RDPDR does not require opening and stat()-ing the underlying
+ * file.
+ */
+typedef struct guac_rdp_fs_dir_entry {
+
+    /**
+     * The filename of this entry, excluding any path information.
+     */
+    char* name;
+
+    /**
+     * Bitwise OR of all associated Windows file attributes.
+     */
+    int attributes;
+
+    /**
+     * The size of this file, in bytes.
+     */
+    uint64_t size;
+
+    /**
+     * The time this file was created, as a Windows timestamp.
+     */
+    uint64_t ctime;
+
+    /**
+     * The time this file was last modified, as a Windows timestamp.
+     */
+    uint64_t mtime;
+
+    /**
+     * The time this file was last accessed, as a Windows timestamp.
+     */
+    uint64_t atime;
+
+} guac_rdp_fs_dir_entry;
+
+/**
+ * A cached directory listing which remains valid after the directory handle
+ * it was enumerated for has been closed. Validity is tracked with an inotify
+ * watch on the underlying directory: any change within the directory causes
+ * the cached listing to be discarded, so repeated listings of an unchanged
+ * directory are served entirely from memory while changed directories are
+ * always re-enumerated.
+ */
+typedef struct guac_rdp_fs_dir_cache_entry {
+
+    /**
+     * The real path of the directory on the local filesystem, or an empty
+     * string if this cache entry is unused.
+     */
+    char real_path[GUAC_RDP_FS_MAX_PATH];
+
+    /**
+     * The inotify watch descriptor observing the directory for changes.
+     * Meaningful only if this cache entry is in use (entries is non-NULL).
+     */
+    int watch;
+
+    /**
+     * The cached entries of the directory, or NULL if this cache entry is
+     * unused.
+     */
+    guac_rdp_fs_dir_entry* entries;
+
+    /**
+     * The number of entries within the entries array.
+     */
+    int num_entries;
+
+} guac_rdp_fs_dir_cache_entry;
+
 /**
  * An arbitrary file on the virtual filesystem of the Guacamole drive.
  */
@@ -145,6 +230,25 @@ typedef struct guac_rdp_fs_file {
      */
     DIR* dir;
 
+    /**
+     * All entries within this directory, enumerated in one batch when the
+     * directory was first read, or NULL if this file is not being used as a
+     * directory or has not yet been read. This snapshot is valid for the
+     * lifetime of the open file and is freed when the file is closed.
+     */
+    guac_rdp_fs_dir_entry* dir_entries;
+
+    /**
+     * The number of entries within the dir_entries array.
+     */
+    int num_dir_entries;
+
+    /**
+     * The index of the next entry within the dir_entries array that will be
+     * returned by a call to guac_rdp_fs_read_dir_entry().
+     */
+    int dir_entries_read;
+
     /**
      * The pattern the check directory contents against, if any.
      */
@@ -216,12 +320,37 @@ typedef struct guac_rdp_fs {
      * If downloads from the remote server to the browser should be disabled.
      */
     int disable_download;
-    
+
     /**
      * If uploads from the browser to the remote server should be disabled.
      */
     int disable_upload;
 
+    /**
+     * The file descriptor of the inotify instance observing all cached
+     * directories for changes, or -1 if inotify is unavailable (in which case
+     * no directory listings are cached).
+     */
+    int notify_fd;
+
+    /**
+     * All cached directory listings.
+     */
+    guac_rdp_fs_dir_cache_entry dir_cache[GUAC_RDP_FS_DIR_CACHE_SIZE];
+
+    /**
+     * The index of the next cache slot to be replaced once all slots are in
+     * use.
+     */
+    int dir_cache_next;
+
+    /**
+     * Lock which protects the directory listing cache, which may be accessed
+     * both by the RDPDR message handlers and by threads serving filesystem
+     * requests of Guacamole users.
+     */
+    pthread_mutex_t dir_cache_lock;
+
 } guac_rdp_fs;
 
 /**
@@ -603,6 +732,27 @@ int guac_rdp_fs_convert_path(const char* parent, const char* rel_path,
  */
 const char* guac_rdp_fs_read_dir(guac_rdp_fs* fs, int file_id);
 
+/**
+ * Returns the next entry within the directory having the given file ID, or
+ * NULL if no more entries remain. The entire directory is enumerated in one
+ * batch the first time it is read, including the file information of each
+ * entry, and subsequent calls simply advance through that snapshot. The
+ * returned entry is valid until the file having the given file ID is closed.
+ *
+ * @param fs
+ *     The filesystem containing the file to read directory entries from.
+ *
+ * @param file_id
+ *     The ID of the file to read directory entries from, as returned by
+ *     guac_rdp_fs_open().
+ *
+ * @return
+ *     The next entry within the directory, or NULL if the last entry in the
+ *     directory has already been returned by a previous call.
+ */
+const guac_rdp_fs_dir_entry* guac_rdp_fs_read_dir_entry(guac_rdp_fs* fs,
+        int file_id);
+
 /**
  * Returns the file having the given ID, or NULL if no such file exists.
  *
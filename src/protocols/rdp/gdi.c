@@ -17,6 +17,8 @@
  * under the License.
  */
 
+#include "bitmap.h"
+#include "channels/rail.h"
 #include "color.h"
 #include "rdp.h"
 #include "settings.h"
@@ -30,9 +32,11 @@
 #include <guacamole/client.h>
 #include <guacamole/display.h>
 #include <guacamole/protocol.h>
+#include <guacamole/socket.h>
 #include <winpr/wtypes.h>
 
 #include <stddef.h>
+#include <stdint.h>
 
 void guac_rdp_gdi_mark_frame(rdpContext* context, int starting) {
 
@@ -61,10 +65,88 @@ BOOL guac_rdp_gdi_surface_frame_marker(rdpContext* context, const SURFACE_FRAME_
     frame_acknowledge = context->settings->FrameAcknowledge;
 #endif
 
-    if (frame_acknowledge > 0)
+    if (frame_acknowledge > 0) {
+
+        guac_client* client = ((rdp_freerdp_context*) context)->client;
+        guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+
+        /* If writes to the user's connection blocked while this frame was
+         * being produced, withhold acknowledgement of the frame to throttle
+         * the RDP server at the source, rather than letting it continue
+         * pumping frames into a stalled pipe. Acknowledgement of a later
+         * frame implicitly covers all earlier frames, so withheld frames
+         * need not be individually acknowledged once the connection catches
+         * up. At least one frame credit is always left available such that
+         * the server continues producing the frame markers that drive this
+         * logic. */
+        uint64_t write_stall = guac_socket_get_write_stall(client->socket);
+        if (write_stall != rdp_client->acked_write_stall
+                && rdp_client->withheld_frame_acks < frame_acknowledge - 1) {
+            rdp_client->acked_write_stall = write_stall;
+            rdp_client->withheld_frame_acks++;
+            return TRUE;
+        }
+
+        rdp_client->acked_write_stall = write_stall;
+        rdp_client->withheld_frame_acks = 0;
+
         IFCALL(context->update->SurfaceFrameAcknowledge, context,
                 surface_frame_marker->frameId);
 
+    }
+
+    return TRUE;
+
+}
+
+BOOL guac_rdp_gdi_memblt(rdpContext* context, MEMBLT_ORDER* memblt) {
+
+    guac_client* client = ((rdp_freerdp_context*) context)->client;
+    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+    guac_rdp_bitmap* bitmap = (guac_rdp_bitmap*) memblt->bitmap;
+
+    /* Render through the GDI as always; the GDI surface remains the
+     * authoritative contents of the display */
+    if (rdp_client->gdi_memblt != NULL
+            && !rdp_client->gdi_memblt(context, memblt))
+        return FALSE;
+
+    /* Only plain copies (raw ROP3 code SRCCOPY) of bitmaps mirrored within
+     * the cache layer can be sent as copy instructions, and only if a paint
+     * is underway (and there is thus an open context to hint through) */
+    guac_display_layer_raw_context* current_context = rdp_client->current_context;
+    if (current_context == NULL || rdp_client->bitmap_cache == NULL
+            || bitmap == NULL || bitmap->cache_cell < 0
+            || memblt->bRop != 0xCC)
+        return TRUE;
+
+    guac_rect dst_rect;
+    guac_rect_init(&dst_rect, memblt->nLeftRect, memblt->nTopRect,
+            memblt->nWidth, memblt->nHeight);
+    guac_rect_constrain(&dst_rect, &current_context->bounds);
+    if (guac_rect_is_empty(&dst_rect))
+        return TRUE;
+
+    /* Locate the blitted region within the bitmap's cell of the cache layer,
+     * accounting for any clipping of the destination */
+    guac_rect src_rect;
+    guac_rect_init(&src_rect,
+            (bitmap->cache_cell % GUAC_RDP_BITMAP_CACHE_COLS)
+                * GUAC_RDP_BITMAP_CACHE_CELL + memblt->nXSrc
+                + (dst_rect.left - memblt->nLeftRect),
+            (bitmap->cache_cell / GUAC_RDP_BITMAP_CACHE_COLS)
+                * GUAC_RDP_BITMAP_CACHE_CELL + memblt->nYSrc
+                + (dst_rect.top - memblt->nTopRect),
+            guac_rect_width(&dst_rect), guac_rect_height(&dst_rect));
+
+    /* Hint that the blitted region was copied from the cache layer. The hint
+     * is verified against the actual contents of the previously-sent frame
+     * before being honored, so a hint rendered stale by intervening draws
+     * simply falls back to the normal diff+encode path. */
+    guac_display_layer_raw_context_hint_copy_from(current_context,
+            rdp_client->bitmap_cache->layer, &src_rect, &dst_rect);
+    guac_rect_extend(&current_context->dirty, &dst_rect);
+
     return TRUE;
 
 }
@@ -87,6 +169,10 @@ BOOL guac_rdp_gdi_begin_paint(rdpContext* context) {
     current_context->stride = gdi->stride;
     guac_rect_init(&current_context->bounds, 0, 0, gdi->width, gdi->height);
 
+    /* Apply any window movement hints queued by RAIL window orders that
+     * arrived while no paint was underway */
+    guac_rdp_rail_apply_pending_moves(client, current_context);
+
     return TRUE;
 
 }
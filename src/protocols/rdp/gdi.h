@@ -71,6 +71,27 @@ BOOL guac_rdp_gdi_frame_marker(rdpContext* context, const FRAME_MARKER_ORDER* fr
  */
 BOOL guac_rdp_gdi_surface_frame_marker(rdpContext* context, const SURFACE_FRAME_MARKER* surface_frame_marker);
 
+/**
+ * Handler called when a region of the display is being blitted from a bitmap
+ * previously stored within the RDP bitmap cache. The FreeRDP GDI
+ * implementation is chained to such that the blit is rendered in software as
+ * always, but blits that are plain copies of bitmaps mirrored within the
+ * client-side bitmap cache layer are additionally hinted to guac_display,
+ * which will send them to connected users as copy instructions rather than
+ * re-encoded image data.
+ *
+ * @param context
+ *     The rdpContext associated with the current RDP session.
+ *
+ * @param memblt
+ *     The MemBlt order being performed, with the cached source bitmap
+ *     already resolved by the FreeRDP bitmap cache.
+ *
+ * @return
+ *     TRUE if successful, FALSE otherwise.
+ */
+BOOL guac_rdp_gdi_memblt(rdpContext* context, MEMBLT_ORDER* memblt);
+
 /**
  * Handler called when a paint operation is beginning. This function is
  * expected to be called by the FreeRDP GDI implementation of RemoteFX when a
@@ -27,6 +27,7 @@
 #include <guacamole/client.h>
 #include <guacamole/mem.h>
 #include <guacamole/rwlock.h>
+#include <guacamole/unicode.h>
 
 #include <stdlib.h>
 
@@ -71,11 +72,103 @@ static int guac_rdp_keyboard_lock_flag(int keysym) {
 }
 
 /**
- * Immediately sends an RDP key event having the given scancode and flags.
+ * Sends all queued RDP input events to the RDP server, in order, acquiring
+ * the lock guarding the RDP message stream exactly once for the entire batch.
+ * If the RDP session is not yet connected, all queued events are dropped.
  *
- * @param rdp_client
- *     The RDP client instance associated with the RDP session along which the
- *     key event should be sent.
+ * @param keyboard
+ *     The guac_rdp_keyboard whose queued events should be sent.
+ */
+static void guac_rdp_keyboard_events_flush(guac_rdp_keyboard* keyboard) {
+
+    guac_client* client = keyboard->client;
+    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+
+    /* The queue is always emptied, even if the events cannot be sent */
+    int num_events = keyboard->num_pending_events;
+    keyboard->num_pending_events = 0;
+
+    if (num_events == 0)
+        return;
+
+    /* Skip if not yet connected */
+    freerdp* rdp_inst = rdp_client->rdp_inst;
+    if (rdp_inst == NULL)
+        return;
+
+    rdpInput* input = GUAC_RDP_CONTEXT(rdp_inst)->input;
+
+    /* Send all queued events as a single batch */
+    pthread_mutex_lock(&(rdp_client->message_lock));
+
+    for (int i = 0; i < num_events; i++) {
+
+        guac_rdp_keyboard_event* event = &keyboard->pending_events[i];
+        switch (event->type) {
+
+            case GUAC_RDP_KEYBOARD_EVENT_KEY:
+                input->KeyboardEvent(input, event->flags, event->value);
+                break;
+
+            case GUAC_RDP_KEYBOARD_EVENT_UNICODE:
+                input->UnicodeKeyboardEvent(input, 0, event->value);
+                break;
+
+            case GUAC_RDP_KEYBOARD_EVENT_SYNCHRONIZE:
+                input->SynchronizeEvent(input, event->value);
+                break;
+
+        }
+
+    }
+
+    pthread_mutex_unlock(&(rdp_client->message_lock));
+
+}
+
+/**
+ * Queues an RDP input event having the given type, flags, and value for
+ * batched transmission to the RDP server. Queued events are sent, in order,
+ * once the outermost keysym update currently in progress has completed. If
+ * the queue is full, all currently queued events are sent immediately to make
+ * room, preserving overall event order.
+ *
+ * @param keyboard
+ *     The guac_rdp_keyboard associated with the current RDP session.
+ *
+ * @param type
+ *     The type of RDP input event to queue.
+ *
+ * @param flags
+ *     Any RDP-specific flags that apply to the event, or zero if the event
+ *     type does not use flags.
+ *
+ * @param value
+ *     The primary value of the event (scancode, codepoint, or lock flags,
+ *     depending on the event type).
+ */
+static void guac_rdp_keyboard_queue_event(guac_rdp_keyboard* keyboard,
+        guac_rdp_keyboard_event_type type, UINT16 flags, UINT32 value) {
+
+    /* Send all pending events immediately if the queue is full */
+    if (keyboard->num_pending_events == GUAC_RDP_KEYBOARD_MAX_PENDING_EVENTS)
+        guac_rdp_keyboard_events_flush(keyboard);
+
+    guac_rdp_keyboard_event* event =
+        &keyboard->pending_events[keyboard->num_pending_events++];
+
+    event->type = type;
+    event->flags = flags;
+    event->value = value;
+
+}
+
+/**
+ * Queues an RDP key event having the given scancode and flags for batched
+ * transmission to the RDP server.
+ *
+ * @param keyboard
+ *     The guac_rdp_keyboard associated with the current RDP session.
  *
  * @param scancode
  *     The scancode of the key to press or release via the RDP key event.
@@ -90,7 +183,7 @@ static int guac_rdp_keyboard_lock_flag(int keysym) {
  * @param pressed
  *     Non-zero if the key is being pressed, zero if the key is being released.
  */
-static void guac_rdp_send_key_event(guac_rdp_client* rdp_client,
+static void guac_rdp_send_key_event(guac_rdp_keyboard* keyboard,
         int scancode, int flags, int pressed) {
 
     /* Determine proper event flag for pressed state */
@@ -100,76 +193,51 @@ static void guac_rdp_send_key_event(guac_rdp_client* rdp_client,
     else
         pressed_flags = KBD_FLAGS_RELEASE;
 
-    /* Skip if not yet connected */
-    freerdp* rdp_inst = rdp_client->rdp_inst;
-    if (rdp_inst == NULL)
-        return;
-
-    /* Send actual key */
-    pthread_mutex_lock(&(rdp_client->message_lock));
-    GUAC_RDP_CONTEXT(rdp_inst)->input->KeyboardEvent(
-            GUAC_RDP_CONTEXT(rdp_inst)->input, flags | pressed_flags, scancode);
-    pthread_mutex_unlock(&(rdp_client->message_lock));
+    guac_rdp_keyboard_queue_event(keyboard, GUAC_RDP_KEYBOARD_EVENT_KEY,
+            flags | pressed_flags, scancode);
 
 }
 
 /**
- * Immediately sends an RDP Unicode event having the given Unicode codepoint.
- * Unlike key events, RDP Unicode events do have not a pressed or released
- * state. They represent strictly the input of a single character, and are
- * technically independent of the keyboard.
+ * Queues an RDP Unicode event having the given Unicode codepoint for batched
+ * transmission to the RDP server. Unlike key events, RDP Unicode events do
+ * have not a pressed or released state. They represent strictly the input of
+ * a single character, and are technically independent of the keyboard.
  *
- * @param rdp_client
- *     The RDP client instance associated with the RDP session along which the
- *     Unicode event should be sent.
+ * @param keyboard
+ *     The guac_rdp_keyboard associated with the current RDP session.
  *
  * @param codepoint
  *     The Unicode codepoint of the character being input via the Unicode
  *     event.
  */
-static void guac_rdp_send_unicode_event(guac_rdp_client* rdp_client,
+static void guac_rdp_send_unicode_event(guac_rdp_keyboard* keyboard,
         int codepoint) {
 
-    /* Skip if not yet connected */
-    freerdp* rdp_inst = rdp_client->rdp_inst;
-    if (rdp_inst == NULL)
-        return;
-
-    /* Send Unicode event */
-    pthread_mutex_lock(&(rdp_client->message_lock));
-    GUAC_RDP_CONTEXT(rdp_inst)->input->UnicodeKeyboardEvent(
-            GUAC_RDP_CONTEXT(rdp_inst)->input, 0, codepoint);
-    pthread_mutex_unlock(&(rdp_client->message_lock));
+    guac_rdp_keyboard_queue_event(keyboard, GUAC_RDP_KEYBOARD_EVENT_UNICODE,
+            0, codepoint);
 
 }
 
 /**
- * Immediately sends an RDP synchronize event having the given flags. An RDP
- * synchronize event sets the state of remote lock keys absolutely, where a
- * lock key will be active only if its corresponding flag is set in the event.
+ * Queues an RDP synchronize event having the given flags for batched
+ * transmission to the RDP server. An RDP synchronize event sets the state of
+ * remote lock keys absolutely, where a lock key will be active only if its
+ * corresponding flag is set in the event.
  *
- * @param rdp_client
- *     The RDP client instance associated with the RDP session along which the
- *     synchronize event should be sent.
+ * @param keyboard
+ *     The guac_rdp_keyboard associated with the current RDP session.
  *
  * @param flags
  *     Bitwise OR of the flags representing the lock keys which should be set,
  *     if any, as dictated by the RDP protocol. If no flags are set, then no
  *     lock keys will be active.
  */
-static void guac_rdp_send_synchronize_event(guac_rdp_client* rdp_client,
+static void guac_rdp_send_synchronize_event(guac_rdp_keyboard* keyboard,
         UINT32 flags) {
 
-    /* Skip if not yet connected */
-    freerdp* rdp_inst = rdp_client->rdp_inst;
-    if (rdp_inst == NULL)
-        return;
-
-    /* Synchronize lock key states */
-    pthread_mutex_lock(&(rdp_client->message_lock));
-    GUAC_RDP_CONTEXT(rdp_inst)->input->SynchronizeEvent(
-            GUAC_RDP_CONTEXT(rdp_inst)->input, flags);
-    pthread_mutex_unlock(&(rdp_client->message_lock));
+    guac_rdp_keyboard_queue_event(keyboard,
+            GUAC_RDP_KEYBOARD_EVENT_SYNCHRONIZE, 0, flags);
 
 }
 
@@ -518,9 +586,6 @@ unsigned int guac_rdp_keyboard_get_modifier_flags(guac_rdp_keyboard* keyboard) {
 static const guac_rdp_keysym_desc* guac_rdp_keyboard_send_defined_key(guac_rdp_keyboard* keyboard,
         guac_rdp_key* key, int pressed) {
 
-    guac_client* client = keyboard->client;
-    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
-
     const guac_rdp_keysym_desc* keysym_desc = guac_rdp_keyboard_get_definition(keyboard, key);
     if (keysym_desc->scancode == 0)
         return NULL;
@@ -538,7 +603,7 @@ static const guac_rdp_keysym_desc* guac_rdp_keyboard_send_defined_key(guac_rdp_k
     }
 
     /* Fire actual key event for target key */
-    guac_rdp_send_key_event(rdp_client, keysym_desc->scancode,
+    guac_rdp_send_key_event(keyboard, keysym_desc->scancode,
             keysym_desc->flags, pressed);
 
     return keysym_desc;
@@ -561,7 +626,6 @@ static void guac_rdp_keyboard_send_missing_key(guac_rdp_keyboard* keyboard,
         int keysym) {
 
     guac_client* client = keyboard->client;
-    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
 
     /* Attempt to type using dead keys */
     if (!guac_rdp_decompose_keysym(keyboard, keysym))
@@ -583,22 +647,19 @@ static void guac_rdp_keyboard_send_missing_key(guac_rdp_keyboard* keyboard,
     }
 
     /* Send as Unicode event */
-    guac_rdp_send_unicode_event(rdp_client, codepoint);
+    guac_rdp_send_unicode_event(keyboard, codepoint);
 
 }
 
 void guac_rdp_keyboard_update_locks(guac_rdp_keyboard* keyboard,
         unsigned int set_flags, unsigned int clear_flags) {
 
-    guac_client* client = keyboard->client;
-    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
-
     /* Calculate updated lock flags */
     unsigned int lock_flags = (keyboard->lock_flags | set_flags) & ~clear_flags;
 
     /* Synchronize remote side only if lock flags have changed */
     if (lock_flags != keyboard->lock_flags) {
-        guac_rdp_send_synchronize_event(rdp_client, lock_flags);
+        guac_rdp_send_synchronize_event(keyboard, lock_flags);
         keyboard->lock_flags = lock_flags;
     }
 
@@ -641,14 +702,16 @@ void guac_rdp_keyboard_update_modifiers(guac_rdp_keyboard* keyboard,
 int guac_rdp_keyboard_update_keysym(guac_rdp_keyboard* keyboard,
         int keysym, int pressed, guac_rdp_key_source source) {
 
+    /* Track nesting depth such that all events generated on behalf of this
+     * update (including any recursive updates of modifiers, locks, etc.) are
+     * sent as a single batch once the outermost update returns */
+    keyboard->update_depth++;
+
     /* Synchronize lock keys states, if this has not yet been done */
     if (!keyboard->synchronized) {
 
-        guac_client* client = keyboard->client;
-        guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
-
         /* Synchronize remote lock key states with local state */
-        guac_rdp_send_synchronize_event(rdp_client, keyboard->lock_flags);
+        guac_rdp_send_synchronize_event(keyboard, keyboard->lock_flags);
         keyboard->synchronized = 1;
 
     }
@@ -701,10 +764,97 @@ int guac_rdp_keyboard_update_keysym(guac_rdp_keyboard* keyboard,
     if (source == GUAC_RDP_KEY_SOURCE_CLIENT && keyboard->user_pressed_keys == 0)
         guac_rdp_keyboard_reset(keyboard);
 
+    /* Send all generated events once the outermost update has completed */
+    if (--keyboard->update_depth == 0)
+        guac_rdp_keyboard_events_flush(keyboard);
+
     return 0;
 
 }
 
+/**
+ * Translates the given Unicode codepoint into the X11 keysym that would be
+ * produced by typing the corresponding character. If the codepoint represents
+ * a control character that cannot be typed, zero is returned.
+ *
+ * @param codepoint
+ *     The Unicode codepoint to translate.
+ *
+ * @return
+ *     The X11 keysym that corresponds to the given codepoint, or zero if the
+ *     codepoint cannot be typed.
+ */
+static int guac_rdp_keyboard_get_keysym(int codepoint) {
+
+    /* Newlines and tabs are typed using their corresponding keys */
+    if (codepoint == '\n')
+        return GUAC_RDP_KEYSYM_RETURN;
+
+    if (codepoint == '\t')
+        return GUAC_RDP_KEYSYM_TAB;
+
+    /* All other control characters cannot be typed */
+    if (codepoint < 0x20 || (codepoint >= 0x7F && codepoint < 0xA0))
+        return 0;
+
+    /* Keysyms for Basic Latin and Latin-1 Supplement are identical to their
+     * Unicode codepoints */
+    if (codepoint <= 0xFF)
+        return codepoint;
+
+    /* All other characters are mapped through the Unicode keysym range */
+    return 0x01000000 | codepoint;
+
+}
+
+int guac_rdp_keyboard_type_text(guac_rdp_keyboard* keyboard,
+        const char* text, int length) {
+
+    int offset = 0;
+
+    /* Track nesting depth manually such that the events generated for ALL
+     * characters within the provided text are batched together, rather than
+     * flushed (with the associated lock acquisition) after each individual
+     * character */
+    keyboard->update_depth++;
+
+    while (offset < length) {
+
+        /* Stop short of any incomplete multi-byte character at the end of
+         * the buffer (the caller may receive the remaining bytes later) */
+        int codepoint;
+        int bytes = guac_utf8_read(text + offset, length - offset, &codepoint);
+        if (bytes == 0)
+            break;
+
+        offset += bytes;
+
+        /* Skip carriage returns entirely, such that both "\r\n" and "\n"
+         * line endings are typed using exactly one press of Return */
+        if (codepoint == '\r')
+            continue;
+
+        int keysym = guac_rdp_keyboard_get_keysym(codepoint);
+        if (keysym == 0)
+            continue;
+
+        /* Type the character by pressing and releasing its key */
+        guac_rdp_keyboard_update_keysym(keyboard, keysym, 1,
+                GUAC_RDP_KEY_SOURCE_SYNTHETIC);
+        guac_rdp_keyboard_update_keysym(keyboard, keysym, 0,
+                GUAC_RDP_KEY_SOURCE_SYNTHETIC);
+
+    }
+
+    /* Send any events which have not already been sent due to the queue
+     * filling */
+    if (--keyboard->update_depth == 0)
+        guac_rdp_keyboard_events_flush(keyboard);
+
+    return offset;
+
+}
+
 void guac_rdp_keyboard_reset(guac_rdp_keyboard* keyboard) {
 
     /* Release all pressed keys */
@@ -56,6 +56,68 @@ typedef enum guac_rdp_key_source {
 
 } guac_rdp_key_source;
 
+/**
+ * The maximum number of RDP input events that may be queued for batched
+ * transmission before the queue must be flushed. A single Guacamole key event
+ * may expand into several RDP events (synchronize events, modifier presses,
+ * dead key sequences, etc.), all of which are sent together while holding the
+ * lock guarding the RDP message stream exactly once.
+ */
+#define GUAC_RDP_KEYBOARD_MAX_PENDING_EVENTS 64
+
+/**
+ * All types of RDP input events that may be queued for batched transmission
+ * by guac_rdp_keyboard.
+ */
+typedef enum guac_rdp_keyboard_event_type {
+
+    /**
+     * An RDP key event, pressing or releasing a single scancode.
+     */
+    GUAC_RDP_KEYBOARD_EVENT_KEY,
+
+    /**
+     * An RDP Unicode event, typing a single character independently of the
+     * keyboard layout.
+     */
+    GUAC_RDP_KEYBOARD_EVENT_UNICODE,
+
+    /**
+     * An RDP synchronize event, absolutely setting the state of all remote
+     * lock keys.
+     */
+    GUAC_RDP_KEYBOARD_EVENT_SYNCHRONIZE
+
+} guac_rdp_keyboard_event_type;
+
+/**
+ * A single RDP input event that has been queued for batched transmission to
+ * the RDP server.
+ */
+typedef struct guac_rdp_keyboard_event {
+
+    /**
+     * The type of RDP input event to be sent.
+     */
+    guac_rdp_keyboard_event_type type;
+
+    /**
+     * Any RDP-specific flags that apply to the event. For key events, these
+     * are the keyboard event flags (KBD_FLAGS_DOWN, KBD_FLAGS_EXTENDED,
+     * etc.). For Unicode and synchronize events, this value is unused and
+     * will be zero.
+     */
+    UINT16 flags;
+
+    /**
+     * The primary value of the event: the scancode of a key event, the
+     * codepoint of a Unicode event, or the lock key flags of a synchronize
+     * event.
+     */
+    UINT32 value;
+
+} guac_rdp_keyboard_event;
+
 /**
  * A representation of a single key within the overall local keyboard,
  * including the definition of that key within the RDP server's keymap and
@@ -154,6 +216,29 @@ typedef struct guac_rdp_keyboard {
      */
     int user_pressed_keys;
 
+    /**
+     * The current nesting depth of calls to
+     * guac_rdp_keyboard_update_keysym(). Keysym updates may recursively
+     * trigger further keysym updates (pressing required modifiers, typing
+     * dead key sequences, releasing automatically-pressed keys, etc.), and
+     * queued events are sent only once the outermost update returns.
+     */
+    int update_depth;
+
+    /**
+     * The number of events currently queued within pending_events.
+     */
+    int num_pending_events;
+
+    /**
+     * All RDP input events that have been generated while handling the
+     * current keysym update but have not yet been sent to the RDP server.
+     * Queued events are sent in order while holding the lock guarding the
+     * RDP message stream exactly once, rather than acquiring and releasing
+     * that lock for each individual event.
+     */
+    guac_rdp_keyboard_event pending_events[GUAC_RDP_KEYBOARD_MAX_PENDING_EVENTS];
+
 } guac_rdp_keyboard;
 
 /**
@@ -299,6 +384,37 @@ void guac_rdp_keyboard_update_modifiers(guac_rdp_keyboard* keyboard,
 int guac_rdp_keyboard_update_keysym(guac_rdp_keyboard* keyboard,
         int keysym, int pressed, guac_rdp_key_source source);
 
+/**
+ * Types the given block of UTF-8 text, precomputing the full sequence of RDP
+ * input events required to type each contained character and sending those
+ * events in large batches. Unlike invoking
+ * guac_rdp_keyboard_update_keysym() separately for each character (which
+ * acquires the lock guarding the RDP message stream once per character), the
+ * events generated for the entire block are sent while acquiring that lock
+ * only once per GUAC_RDP_KEYBOARD_MAX_PENDING_EVENTS events.
+ *
+ * Each character is typed exactly as if its key were pressed and released,
+ * including any dead key or Unicode event fallbacks that would apply.
+ * Newlines are typed using the Return key and tabs using the Tab key. All
+ * other control characters are ignored.
+ *
+ * @param keyboard
+ *     The guac_rdp_keyboard associated with the current RDP session.
+ *
+ * @param text
+ *     The UTF-8 text to type.
+ *
+ * @param length
+ *     The length of the provided text, in bytes.
+ *
+ * @return
+ *     The number of bytes processed, which will be less than the given length
+ *     only if the provided buffer ends with an incomplete multi-byte
+ *     character.
+ */
+int guac_rdp_keyboard_type_text(guac_rdp_keyboard* keyboard,
+        const char* text, int length);
+
 /**
  * Releases all currently pressed keys, sending key release events to the RDP
  * server as necessary. Lock states (Caps Lock, etc.) are not affected.
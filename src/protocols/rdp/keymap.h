@@ -77,6 +77,16 @@
  */
 #define GUAC_RDP_KEYSYM_ALTGR 0xFE03
 
+/**
+ * The X11 keysym for Return (Enter).
+ */
+#define GUAC_RDP_KEYSYM_RETURN 0xFF0D
+
+/**
+ * The X11 keysym for Tab.
+ */
+#define GUAC_RDP_KEYSYM_TAB 0xFF09
+
 /**
  * Bitwise flag value representing the Shift modifier.
  */
@@ -154,7 +164,11 @@ typedef struct guac_rdp_keysym_desc {
 } guac_rdp_keysym_desc;
 
 /**
- * Hierarchical keysym mapping
+ * Hierarchical keysym mapping. The parent chain of a keymap exists only as a
+ * compact representation for the generated tables: it is walked exactly once,
+ * when the keyboard for a connection is allocated, and flattened into the
+ * keys_by_keysym lookup table of guac_rdp_keyboard. Per-keystroke resolution
+ * is a single array index into that table and never touches this structure.
  */
 typedef struct guac_rdp_keymap guac_rdp_keymap;
 struct guac_rdp_keymap {
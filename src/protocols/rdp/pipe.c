@@ -0,0 +1,171 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "channels/pipe-svc.h"
+#include "keyboard.h"
+#include "pipe.h"
+#include "rdp.h"
+
+#include <guacamole/client.h>
+#include <guacamole/mem.h>
+#include <guacamole/protocol.h>
+#include <guacamole/rwlock.h>
+#include <guacamole/socket.h>
+#include <guacamole/unicode.h>
+#include <guacamole/user.h>
+
+#include <string.h>
+
+/**
+ * Per-stream state for an inbound STDIN pipe stream. As the boundaries of the
+ * blobs making up a pipe stream are arbitrary, a multi-byte UTF-8 character
+ * may be split across two blobs. Any such incomplete trailing character is
+ * stored here until the blob containing its remaining bytes is received.
+ */
+typedef struct guac_rdp_stdin_stream {
+
+    /**
+     * The bytes of the incomplete UTF-8 character that terminated the most
+     * recently received blob, if any.
+     */
+    char partial[4];
+
+    /**
+     * The number of bytes currently stored within partial.
+     */
+    int partial_length;
+
+} guac_rdp_stdin_stream;
+
+/**
+ * Handler for "blob" instructions which types the UTF-8 text of received
+ * blobs into the RDP session via the keyboard.
+ *
+ * @see guac_user_blob_handler
+ */
+static int guac_rdp_stdin_blob_handler(guac_user* user, guac_stream* stream,
+        void* data, int length) {
+
+    guac_client* client = user->client;
+    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+    guac_rdp_stdin_stream* stdin_stream = (guac_rdp_stdin_stream*) stream->data;
+
+    char* input = (char*) data;
+
+    guac_rwlock_acquire_read_lock(&(rdp_client->lock));
+
+    /* Refuse to type if keyboard not yet ready */
+    guac_rdp_keyboard* keyboard = rdp_client->keyboard;
+    if (keyboard == NULL) {
+
+        guac_rwlock_release_lock(&(rdp_client->lock));
+
+        guac_protocol_send_ack(user->socket, stream,
+                "Keyboard not yet ready.",
+                GUAC_PROTOCOL_STATUS_RESOURCE_CONFLICT);
+
+        guac_socket_flush(user->socket);
+        return 0;
+
+    }
+
+    /* Complete any multi-byte character that was split across blobs before
+     * processing the remainder of the received data */
+    if (stdin_stream->partial_length > 0) {
+
+        int required = (int) guac_utf8_charsize((unsigned char) stdin_stream->partial[0]);
+        while (stdin_stream->partial_length < required && length > 0) {
+            stdin_stream->partial[stdin_stream->partial_length++] = *(input++);
+            length--;
+        }
+
+        if (stdin_stream->partial_length == required) {
+            guac_rdp_keyboard_type_text(keyboard, stdin_stream->partial,
+                    stdin_stream->partial_length);
+            stdin_stream->partial_length = 0;
+        }
+
+    }
+
+    /* Type all complete characters within the received blob, storing any
+     * trailing incomplete character until the next blob arrives */
+    int typed = guac_rdp_keyboard_type_text(keyboard, input, length);
+    if (typed < length) {
+        memcpy(stdin_stream->partial, input + typed, length - typed);
+        stdin_stream->partial_length = length - typed;
+    }
+
+    guac_rwlock_release_lock(&(rdp_client->lock));
+
+    /* Acknowledge receipt of data */
+    guac_protocol_send_ack(user->socket, stream,
+            "Text typed into RDP session.",
+            GUAC_PROTOCOL_STATUS_SUCCESS);
+
+    guac_socket_flush(user->socket);
+    return 0;
+
+}
+
+/**
+ * Handler for "end" instructions which frees the state associated with the
+ * STDIN pipe stream.
+ *
+ * @see guac_user_end_handler
+ */
+static int guac_rdp_stdin_end_handler(guac_user* user, guac_stream* stream) {
+
+    guac_mem_free(stream->data);
+    stream->data = NULL;
+
+    guac_user_log(user, GUAC_LOG_DEBUG, "Inbound STDIN stream closed.");
+
+    return 0;
+
+}
+
+int guac_rdp_pipe_handler(guac_user* user, guac_stream* stream,
+        char* mimetype, char* name) {
+
+    /* Type received text via the keyboard if pipe has required name */
+    if (strcmp(name, GUAC_RDP_STDIN_PIPE_NAME) == 0) {
+
+        guac_rdp_stdin_stream* stdin_stream =
+            guac_mem_zalloc(sizeof(guac_rdp_stdin_stream));
+
+        stream->data = stdin_stream;
+        stream->blob_handler = guac_rdp_stdin_blob_handler;
+        stream->end_handler = guac_rdp_stdin_end_handler;
+
+        guac_user_log(user, GUAC_LOG_DEBUG, "Now typing the contents of an "
+                "inbound stream into the RDP session.");
+
+        guac_protocol_send_ack(user->socket, stream,
+                "Now typing from stream.",
+                GUAC_PROTOCOL_STATUS_SUCCESS);
+
+        guac_socket_flush(user->socket);
+        return 0;
+
+    }
+
+    /* All other pipe names refer to static virtual channels */
+    return guac_rdp_pipe_svc_pipe_handler(user, stream, mimetype, name);
+
+}
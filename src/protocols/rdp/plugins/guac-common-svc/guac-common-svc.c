@@ -22,13 +22,53 @@
 
 #include <freerdp/svc.h>
 #include <guacamole/client.h>
+#include <guacamole/fifo.h>
 #include <guacamole/mem.h>
 #include <winpr/stream.h>
 #include <winpr/wtsapi.h>
 #include <winpr/wtypes.h>
 
+#include <pthread.h>
 #include <stdlib.h>
 
+/**
+ * Thread which processes received data for an SVC that processes received
+ * data asynchronously, invoking the receive handler of the SVC for each
+ * reassembled block of data in the order received. The thread terminates
+ * when a NULL stream is dequeued (enqueued during channel termination) or
+ * the receive FIFO is invalidated.
+ *
+ * @param data
+ *     A pointer to the guac_rdp_common_svc structure representing the
+ *     channel.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guac_rdp_common_svc_receive_thread(void* data) {
+
+    guac_rdp_common_svc* svc = (guac_rdp_common_svc*) data;
+
+    guac_rdp_common_svc_receive_entry entry;
+    while (guac_fifo_dequeue(&svc->_receive_queue, &entry)) {
+
+        /* A NULL stream signals that the channel is terminating and no
+         * further data will be received */
+        if (entry.stream == NULL)
+            break;
+
+        /* Handle channel-specific data receipt tasks, if any */
+        if (svc->_receive_handler)
+            svc->_receive_handler(svc, entry.stream);
+
+        Stream_Free(entry.stream, TRUE);
+
+    }
+
+    return NULL;
+
+}
+
 /**
  * Event handler for events which deal with data transmitted over an open SVC,
  * including receipt of inbound data and completion of outbound writes.
@@ -145,6 +185,20 @@ static VOID guac_rdp_common_svc_handle_open_event(LPVOID user_param,
         Stream_SealLength(svc->_input_stream);
         Stream_SetPosition(svc->_input_stream, 0);
 
+        /* Hand the reassembled block off to the receive thread if this SVC
+         * processes received data asynchronously, such that slow processing
+         * (disk I/O and the like) does not stall the thread pumping FreeRDP
+         * messages. Ownership of the stream passes to the receive thread. */
+        if (svc->_receive_thread_started) {
+            guac_rdp_common_svc_receive_entry entry = {
+                .stream = svc->_input_stream
+            };
+            if (guac_fifo_enqueue(&svc->_receive_queue, &entry)) {
+                svc->_input_stream = NULL;
+                return;
+            }
+        }
+
         /* Handle channel-specific data receipt tasks, if any */
         if (svc->_receive_handler)
             svc->_receive_handler(svc, svc->_input_stream);
@@ -183,6 +237,31 @@ static void guac_rdp_common_svc_process_connect(guac_rdp_common_svc* svc) {
     if (svc->_connect_handler)
         svc->_connect_handler(svc);
 
+    /* Start the receive thread if this SVC processes received data
+     * asynchronously. The thread is started only after the connect handler
+     * has finished, such that it can never observe partially-initialized
+     * channel-specific state (received data cannot yet have been queued, as
+     * data receipt events are delivered by the same thread processing this
+     * connect event). */
+    if (svc->_async) {
+
+        guac_fifo_init(&svc->_receive_queue, svc->_receive_queue_items,
+                GUAC_SVC_RECEIVE_QUEUE_SIZE,
+                sizeof(guac_rdp_common_svc_receive_entry));
+
+        if (pthread_create(&svc->_receive_thread, NULL,
+                    guac_rdp_common_svc_receive_thread, svc)) {
+            guac_client_log(svc->client, GUAC_LOG_WARNING, "Unable to start "
+                    "receive thread for SVC \"%s\". Received data will be "
+                    "processed synchronously.", svc->name);
+            guac_fifo_invalidate(&svc->_receive_queue);
+            guac_fifo_destroy(&svc->_receive_queue);
+        }
+        else
+            svc->_receive_thread_started = 1;
+
+    }
+
     /* Channel is now ready */
     guac_client_log(svc->client, GUAC_LOG_DEBUG, "SVC \"%s\" connected.",
             svc->name);
@@ -198,6 +277,20 @@ static void guac_rdp_common_svc_process_connect(guac_rdp_common_svc* svc) {
  */
 static void guac_rdp_common_svc_process_terminate(guac_rdp_common_svc* svc) {
 
+    /* Stop the receive thread, if any, allowing it to finish processing all
+     * data received prior to termination */
+    if (svc->_receive_thread_started) {
+
+        guac_rdp_common_svc_receive_entry stop = { .stream = NULL };
+        if (!guac_fifo_enqueue(&svc->_receive_queue, &stop))
+            guac_fifo_invalidate(&svc->_receive_queue);
+
+        pthread_join(svc->_receive_thread, NULL);
+        guac_fifo_invalidate(&svc->_receive_queue);
+        guac_fifo_destroy(&svc->_receive_queue);
+
+    }
+
     /* Handle channel-specific termination tasks, if any */
     if (svc->_terminate_handler)
         svc->_terminate_handler(svc);
@@ -69,9 +69,10 @@ static void guac_rdp_print_job_set_state(guac_rdp_print_job* job,
 
     pthread_mutex_lock(&(job->state_lock));
 
-    /* Update stream state, signalling modification */
+    /* Update stream state, signalling modification (multiple threads may be
+     * waiting on the state, including threads waiting for buffer space) */
     job->state = state;
-    pthread_cond_signal(&(job->state_modified));
+    pthread_cond_broadcast(&(job->state_modified));
 
     pthread_mutex_unlock(&(job->state_lock));
 
@@ -434,8 +435,8 @@ static void* guac_rdp_print_job_output_thread(void* data) {
     guac_client_for_user(job->client, job->user,
             guac_rdp_print_job_end_stream, job);
 
-    /* Ensure all associated file descriptors are closed */
-    close(job->input_fd);
+    /* Ensure the output file descriptor is closed (the input file descriptor
+     * is owned by the input thread) */
     close(job->output_fd);
 
     guac_client_log(job->client, GUAC_LOG_DEBUG, "Print job completed.");
@@ -443,6 +444,135 @@ static void* guac_rdp_print_job_output_thread(void* data) {
 
 }
 
+/**
+ * Thread which continuously transfers buffered print data to the input file
+ * descriptor of the print filter process, unblocking any threads waiting for
+ * buffer space as data is consumed. The input side of the filter process is
+ * closed once all data has been received and consumed, and the thread
+ * terminates. Writes to the filter process deliberately happen on this thread
+ * such that receipt of print data over the RDP virtual channel never blocks
+ * on the filter process itself.
+ *
+ * @param data
+ *     A pointer to the guac_rdp_print_job whose buffered input should be
+ *     written to the print filter process.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guac_rdp_print_job_input_thread(void* data) {
+
+    guac_rdp_print_job* job = (guac_rdp_print_job*) data;
+    char buffer[6048];
+
+    pthread_mutex_lock(&(job->state_lock));
+
+    while (job->state != GUAC_RDP_PRINT_JOB_CLOSED) {
+
+        /* Wait for further buffered data unless the job has received all
+         * data it ever will */
+        if (job->input_buffer_written == 0) {
+
+            if (job->input_closed)
+                break;
+
+            pthread_cond_wait(&(job->state_modified), &(job->state_lock));
+            continue;
+
+        }
+
+        /* Pull next chunk of buffered data, unblocking any threads waiting
+         * for buffer space */
+        int length = job->input_buffer_written;
+        if (length > (int) sizeof(buffer))
+            length = sizeof(buffer);
+
+        memcpy(buffer, job->input_buffer, length);
+
+        job->input_buffer_written -= length;
+        memmove(job->input_buffer, job->input_buffer + length,
+                job->input_buffer_written);
+
+        pthread_cond_broadcast(&(job->state_modified));
+
+        /* Write chunk to filter process without holding the state lock (this
+         * may block for quite some time if the filter process is slow to
+         * consume data) */
+        pthread_mutex_unlock(&(job->state_lock));
+        int written = write(job->input_fd, buffer, length);
+        pthread_mutex_lock(&(job->state_lock));
+
+        /* Stop writing if the filter process cannot accept further data */
+        if (written < 0) {
+            guac_client_log(job->client, GUAC_LOG_DEBUG, "Unable to write to "
+                    "filter process: %s", strerror(errno));
+            break;
+        }
+
+    }
+
+    pthread_mutex_unlock(&(job->state_lock));
+
+    /* No further input will be written to the filter process */
+    close(job->input_fd);
+
+    return NULL;
+
+}
+
+void guac_rdp_print_job_prewarm(guac_client* client) {
+
+    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+
+    pthread_mutex_lock(&(rdp_client->prewarmed_filter_lock));
+
+    /* Nothing to do if a pre-warmed filter process is already available */
+    if (rdp_client->prewarmed_filter.pid != 0) {
+        pthread_mutex_unlock(&(rdp_client->prewarmed_filter_lock));
+        return;
+    }
+
+    /* Fork the filter process now such that its interpreter starts up in the
+     * background, ahead of the next print job */
+    int input_fd, output_fd;
+    pid_t pid = guac_rdp_create_filter_process(client, &input_fd, &output_fd);
+    if (pid != -1) {
+
+        rdp_client->prewarmed_filter.pid = pid;
+        rdp_client->prewarmed_filter.input_fd = input_fd;
+        rdp_client->prewarmed_filter.output_fd = output_fd;
+
+        guac_client_log(client, GUAC_LOG_DEBUG, "Pre-warmed PDF filter "
+                "process for next print job (PID=%i).", pid);
+
+    }
+
+    pthread_mutex_unlock(&(rdp_client->prewarmed_filter_lock));
+
+}
+
+void guac_rdp_print_job_discard_prewarmed(guac_client* client) {
+
+    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+
+    pthread_mutex_lock(&(rdp_client->prewarmed_filter_lock));
+
+    /* Kill the pre-warmed filter process and release associated pipes, if a
+     * pre-warmed filter process exists */
+    if (rdp_client->prewarmed_filter.pid != 0) {
+
+        kill(rdp_client->prewarmed_filter.pid, SIGKILL);
+        close(rdp_client->prewarmed_filter.input_fd);
+        close(rdp_client->prewarmed_filter.output_fd);
+
+        rdp_client->prewarmed_filter.pid = 0;
+
+    }
+
+    pthread_mutex_unlock(&(rdp_client->prewarmed_filter_lock));
+
+}
+
 void* guac_rdp_print_job_alloc(guac_user* user, void* data) {
 
     /* Allocate nothing if user does not exist */
@@ -472,9 +602,25 @@ void* guac_rdp_print_job_alloc(guac_user* user, void* data) {
     stream->ack_handler = guac_rdp_print_filter_ack_handler;
     stream->data = job;
 
-    /* Create print filter process */
-    job->filter_pid = guac_rdp_create_filter_process(job->client,
-            &job->input_fd, &job->output_fd);
+    /* Use the pre-warmed filter process if one is available, as its
+     * interpreter will already have finished (or at least begun) starting up */
+    guac_rdp_client* rdp_client = (guac_rdp_client*) job->client->data;
+    pthread_mutex_lock(&(rdp_client->prewarmed_filter_lock));
+    if (rdp_client->prewarmed_filter.pid != 0) {
+        job->filter_pid = rdp_client->prewarmed_filter.pid;
+        job->input_fd = rdp_client->prewarmed_filter.input_fd;
+        job->output_fd = rdp_client->prewarmed_filter.output_fd;
+        rdp_client->prewarmed_filter.pid = 0;
+    }
+    else
+        job->filter_pid = -1;
+    pthread_mutex_unlock(&(rdp_client->prewarmed_filter_lock));
+
+    /* Create print filter process on demand if no pre-warmed process was
+     * available */
+    if (job->filter_pid == -1)
+        job->filter_pid = guac_rdp_create_filter_process(job->client,
+                &job->input_fd, &job->output_fd);
 
     /* Abort if print filter process cannot be created */
     if (job->filter_pid == -1) {
@@ -483,12 +629,24 @@ void* guac_rdp_print_job_alloc(guac_user* user, void* data) {
         return NULL;
     }
 
+    /* Warm a replacement filter process for the next job while this job
+     * runs */
+    guac_rdp_print_job_prewarm(job->client);
+
     /* Init stream state signal and lock */
     job->state = GUAC_RDP_PRINT_JOB_WAITING_FOR_ACK;
     pthread_cond_init(&job->state_modified, NULL);
     pthread_mutex_init(&job->state_lock, NULL);
 
-    /* Start output thread */
+    /* Init buffer of received print data not yet consumed by the filter
+     * process */
+    job->input_buffer = guac_mem_alloc(GUAC_RDP_PRINT_JOB_INPUT_BUFFER_SIZE);
+    job->input_buffer_written = 0;
+    job->input_closed = 0;
+
+    /* Start input and output threads */
+    pthread_create(&job->input_thread, NULL,
+            guac_rdp_print_job_input_thread, job);
     pthread_create(&job->output_thread, NULL,
             guac_rdp_print_job_output_thread, job);
 
@@ -622,18 +780,55 @@ int guac_rdp_print_job_write(guac_rdp_print_job* job,
     /* Update counter of bytes received */
     job->bytes_received += length;
 
-    /* Write data to filter process, unblocking any threads waiting on the
-     * generic RDP message lock as this may be a lengthy operation that depends
-     * on other threads sending outstanding messages (resulting in deadlock if
-     * those messages are blocked) */
+    /* Buffer data for the input thread, unblocking any threads waiting on the
+     * generic RDP message lock as this may block if the buffer is full
+     * (resulting in deadlock if outstanding messages from other threads are
+     * also blocked) */
     int unlock_status = pthread_mutex_unlock(&(rdp_client->message_lock));
-    int write_status = write(job->input_fd, buffer, length);
+
+    int written = 0;
+    char* current = buffer;
+
+    pthread_mutex_lock(&(job->state_lock));
+    while (written < length) {
+
+        /* Abort if job is closed (the buffered data will never be consumed) */
+        if (job->state == GUAC_RDP_PRINT_JOB_CLOSED) {
+            written = -1;
+            break;
+        }
+
+        /* Wait for the input thread to free up buffer space if full */
+        int available = GUAC_RDP_PRINT_JOB_INPUT_BUFFER_SIZE
+            - job->input_buffer_written;
+
+        if (available == 0) {
+            pthread_cond_wait(&(job->state_modified), &(job->state_lock));
+            continue;
+        }
+
+        /* Append as much data as space allows, signalling the input thread
+         * that data is available */
+        int chunk = length - written;
+        if (chunk > available)
+            chunk = available;
+
+        memcpy(job->input_buffer + job->input_buffer_written,
+                current + written, chunk);
+
+        job->input_buffer_written += chunk;
+        written += chunk;
+
+        pthread_cond_broadcast(&(job->state_modified));
+
+    }
+    pthread_mutex_unlock(&(job->state_lock));
 
     /* Restore RDP message lock state */
     if (!unlock_status)
         pthread_mutex_lock(&(rdp_client->message_lock));
 
-    return write_status;
+    return written;
 
 }
 
@@ -643,13 +838,17 @@ void guac_rdp_print_job_free(guac_rdp_print_job* job) {
     guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
 
     /* No more input will be provided */
-    close(job->input_fd);
+    pthread_mutex_lock(&(job->state_lock));
+    job->input_closed = 1;
+    pthread_cond_broadcast(&(job->state_modified));
+    pthread_mutex_unlock(&(job->state_lock));
 
     /* Wait for job to terminate, unblocking any threads waiting on the generic
      * RDP message lock as this may be a lengthy operation that depends on
      * other threads sending outstanding messages (resulting in deadlock if
      * those messages are blocked) */
     int unlock_status = pthread_mutex_unlock(&(rdp_client->message_lock));
+    pthread_join(job->input_thread, NULL);
     pthread_join(job->output_thread, NULL);
 
     /* Restore RDP message lock state */
@@ -659,7 +858,8 @@ void guac_rdp_print_job_free(guac_rdp_print_job* job) {
     /* Destroy lock */
     pthread_mutex_destroy(&(job->state_lock));
 
-    /* Free base structure */
+    /* Free buffered input and base structure */
+    guac_mem_free(job->input_buffer);
     guac_mem_free(job);
 
 }
@@ -45,6 +45,43 @@
  */
 #define GUAC_RDP_PRINT_JOB_TITLE_SEARCH_LENGTH 2048
 
+/**
+ * The maximum number of bytes of received print data that may be buffered
+ * while waiting for the print filter process to consume that data. Receipt of
+ * print data will block only once this limit has been reached, bounding the
+ * amount of memory consumed by a print job regardless of the size of the
+ * printed document.
+ */
+#define GUAC_RDP_PRINT_JOB_INPUT_BUFFER_SIZE 4194304
+
+/**
+ * A print filter process (PostScript to PDF) that has been started ahead of
+ * need. Starting the filter process before any document is printed allows the
+ * lengthy interpreter startup of the filter to complete in the background,
+ * rather than adding seconds of latency to the start of each print job.
+ */
+typedef struct guac_rdp_print_filter {
+
+    /**
+     * The PID of the pre-warmed filter process, or zero if no pre-warmed
+     * filter process is available.
+     */
+    pid_t pid;
+
+    /**
+     * File descriptor to which the PostScript input of the filter process
+     * should be written.
+     */
+    int input_fd;
+
+    /**
+     * File descriptor from which the PDF output of the filter process should
+     * be read.
+     */
+    int output_fd;
+
+} guac_rdp_print_filter;
+
 /**
  * The current state of an RDP print job.
  */
@@ -141,6 +178,30 @@ typedef struct guac_rdp_print_job {
      */
     pthread_t output_thread;
 
+    /**
+     * Thread which transfers buffered print data to the print filter process.
+     */
+    pthread_t input_thread;
+
+    /**
+     * Buffer of received print data that has not yet been consumed by the
+     * print filter process. Data within this buffer is always stored at the
+     * beginning of the buffer.
+     */
+    char* input_buffer;
+
+    /**
+     * The number of bytes currently stored within input_buffer.
+     */
+    int input_buffer_written;
+
+    /**
+     * Whether the print job has received all data that will ever be received.
+     * Once all buffered data has been consumed by the print filter process,
+     * the input side of the filter will be closed.
+     */
+    int input_closed;
+
     /**
      * The number of bytes received in the current print job.
      */
@@ -192,8 +253,10 @@ void* guac_rdp_print_job_alloc(guac_user* user, void* data);
 /**
  * Writes PostScript print data to the given active print job. The print job
  * will automatically convert this data to PDF, streaming the result to the
- * Guacamole user associated with the print job. This function may block if
- * the print job is not yet ready for more data.
+ * Guacamole user associated with the print job. The data is buffered and
+ * consumed by the print filter process asynchronously. This function will
+ * block only if the amount of buffered data has reached
+ * GUAC_RDP_PRINT_JOB_INPUT_BUFFER_SIZE.
  *
  * @param job
  *     The print job to write to.
@@ -232,5 +295,32 @@ void guac_rdp_print_job_free(guac_rdp_print_job* job);
  */
 void guac_rdp_print_job_kill(guac_rdp_print_job* job);
 
+/**
+ * Starts a print filter process ahead of need, if one is not already
+ * available, such that the next print job can begin streaming output without
+ * first waiting for the filter's interpreter to start up. This function
+ * returns immediately after the filter process has been forked; the
+ * interpreter of the forked process continues starting up in the background.
+ * If the filter process cannot be created, the failure is logged and the next
+ * print job will simply fall back to creating its filter process on demand.
+ *
+ * @param client
+ *     The guac_client associated with the RDP session for which a filter
+ *     process should be pre-warmed.
+ */
+void guac_rdp_print_job_prewarm(guac_client* client);
+
+/**
+ * Kills and cleans up the pre-warmed print filter process, if any. This
+ * function must be invoked during cleanup of the RDP client to avoid leaking
+ * the filter process. If no pre-warmed filter process exists, this function
+ * has no effect.
+ *
+ * @param client
+ *     The guac_client associated with the RDP session whose pre-warmed filter
+ *     process should be discarded.
+ */
+void guac_rdp_print_job_discard_prewarmed(guac_client* client);
+
 #endif
 
@@ -206,6 +206,17 @@ static BOOL rdp_freerdp_pre_connect(freerdp* instance) {
     pointer.SetDefault = guac_rdp_pointer_set_default;
     graphics_register_pointer(graphics, &pointer);
 
+    /* Mirror bitmaps stored within the RDP bitmap cache in a client-side
+     * cache layer, such that repeated blits of those bitmaps can be sent as
+     * copy instructions. The GDI bitmap handlers registered by gdi_init()
+     * are preserved and chained to, keeping software rendering intact. */
+    rdp_client->gdi_bitmap = *graphics->Bitmap_Prototype;
+    rdpBitmap bitmap = *graphics->Bitmap_Prototype;
+    bitmap.size = sizeof(guac_rdp_bitmap);
+    bitmap.New = guac_rdp_bitmap_new;
+    bitmap.Free = guac_rdp_bitmap_free;
+    graphics_register_bitmap(graphics, &bitmap);
+
     /* Beep on receipt of Play Sound PDU */
     GUAC_RDP_CONTEXT(instance)->update->PlaySound = guac_rdp_beep_play_sound;
 
@@ -217,6 +228,13 @@ static BOOL rdp_freerdp_pre_connect(freerdp* instance) {
     GUAC_RDP_CONTEXT(instance)->update->BeginPaint = guac_rdp_gdi_begin_paint;
     GUAC_RDP_CONTEXT(instance)->update->EndPaint = guac_rdp_gdi_end_paint;
 
+    /* Rewrite blits of cached bitmaps as client-side copies where possible,
+     * chaining to the GDI MemBlt handler registered by gdi_init(). The
+     * FreeRDP bitmap cache will later wrap this handler with its own cache
+     * index resolution. */
+    rdp_client->gdi_memblt = GUAC_RDP_CONTEXT(instance)->update->primary->MemBlt;
+    GUAC_RDP_CONTEXT(instance)->update->primary->MemBlt = guac_rdp_gdi_memblt;
+
     GUAC_RDP_CONTEXT(instance)->update->SurfaceFrameMarker = guac_rdp_gdi_surface_frame_marker;
     GUAC_RDP_CONTEXT(instance)->update->altsec->FrameMarker = guac_rdp_gdi_frame_marker;
 
@@ -676,6 +694,11 @@ static int guac_rdp_handle_connection(guac_client* client) {
     freerdp_free(rdp_inst);
     rdp_client->rdp_inst = NULL;
 
+    /* Free bitmap cache bookkeeping (the cache layer itself was freed along
+     * with the display, and all cells were released as FreeRDP freed its
+     * bitmap cache during context cleanup) */
+    guac_rdp_bitmap_cache_free(client);
+
     /* Free SVC list */
     guac_common_list_free(rdp_client->available_svc, NULL);
     rdp_client->available_svc = NULL;
@@ -722,15 +745,19 @@ void* guac_rdp_client_thread(void* data) {
                 return NULL;
             }
 
-            /* Send the Wake-on-LAN request and wait until the server is responsive. */
-            if (guac_wol_wake_and_wait(settings->wol_mac_addr,
+            /* Send the Wake-on-LAN request and poll in the background until
+             * the server is responsive, aborting early on disconnect. */
+            guac_wol_wait* wol_wait = guac_wol_wake_and_wait_async(client,
+                    settings->wol_mac_addr,
                     settings->wol_broadcast_addr,
                     settings->wol_udp_port,
                     settings->wol_wait_time,
                     GUAC_WOL_DEFAULT_CONNECT_RETRIES,
                     settings->hostname,
                     (const char *) str_port,
-                    GUAC_WOL_DEFAULT_CONNECTION_TIMEOUT)) {
+                    GUAC_WOL_DEFAULT_CONNECTION_TIMEOUT);
+
+            if (wol_wait == NULL || guac_wol_wake_and_wait_result(wol_wait)) {
                 guac_client_log(client, GUAC_LOG_ERROR, "Failed to send WOL packet, or server failed to wake up.");
                 guac_mem_free(str_port);
                 return NULL;
@@ -20,10 +20,13 @@
 #ifndef GUAC_RDP_H
 #define GUAC_RDP_H
 
+#include "bitmap.h"
 #include "channels/audio-input/audio-buffer.h"
 #include "channels/cliprdr.h"
 #include "channels/disp.h"
+#include "channels/rail.h"
 #include "channels/rdpei.h"
+#include "channels/rdpgfx.h"
 #include "common/clipboard.h"
 #include "common/list.h"
 #include "config.h"
@@ -114,12 +117,54 @@ typedef struct guac_rdp_client {
      */
     guac_display_layer_raw_context* current_context;
 
+    /**
+     * The client-side mirror of the RDP server's bitmap cache, or NULL if no
+     * bitmap has yet been cached. Blits of bitmaps mirrored here are sent to
+     * connected users as copy instructions rather than re-encoded image
+     * data.
+     */
+    guac_rdp_bitmap_cache* bitmap_cache;
+
+    /**
+     * A copy of the FreeRDP GDI bitmap handlers, as registered prior to
+     * Guacamole's own bitmap handlers. Guacamole's handlers chain to these
+     * such that the GDI's software rendering of cached bitmaps continues to
+     * function.
+     */
+    rdpBitmap gdi_bitmap;
+
+    /**
+     * The FreeRDP GDI MemBlt handler, as registered prior to Guacamole's own
+     * MemBlt handler. Guacamole's handler chains to this such that the GDI
+     * surface remains the authoritative contents of the display.
+     */
+    pMemBlt gdi_memblt;
+
     /**
      * The current instance of the guac_display render thread. If the thread
      * has not yet been started, this will be NULL.
      */
     guac_display_render_thread* render_thread;
 
+    /**
+     * The total time that writes to the client socket had spent blocked, in
+     * milliseconds, as of the last surface frame acknowledgement sent to the
+     * RDP server. If this value has advanced when the next frame completes,
+     * the connection to the user is backed up, and acknowledgement of that
+     * frame may be withheld to throttle the RDP server.
+     */
+    uint64_t acked_write_stall;
+
+    /**
+     * The number of consecutive surface frame acknowledgements that have been
+     * withheld due to writes to the client socket blocking. To guarantee the
+     * RDP server always has at least one unacknowledged frame credit (and
+     * thus continues to produce the frame markers that drive this logic),
+     * this value is never allowed to reach the negotiated frame
+     * acknowledgement limit.
+     */
+    int withheld_frame_acks;
+
     /**
      * The current state of the keyboard with respect to the RDP session.
      */
@@ -150,6 +195,18 @@ typedef struct guac_rdp_client {
      */
     guac_rdp_print_job* active_job;
 
+    /**
+     * The print filter process that has been started ahead of need for the
+     * next print job, if any. Access to this member must be synchronized
+     * using prewarmed_filter_lock.
+     */
+    guac_rdp_print_filter prewarmed_filter;
+
+    /**
+     * Lock which synchronizes access to prewarmed_filter.
+     */
+    pthread_mutex_t prewarmed_filter_lock;
+
 #ifdef ENABLE_COMMON_SSH
     /**
      * The user and credentials used to authenticate for SFTP.
@@ -183,6 +240,12 @@ typedef struct guac_rdp_client {
      */
     guac_rdp_rdpei* rdpei;
 
+    /**
+     * The current state of Guacamole's handling of the RDPGFX (Graphics
+     * Pipeline) channel.
+     */
+    guac_rdp_rdpgfx* rdpgfx;
+
     /**
      * List of all available static virtual channels.
      */
@@ -213,6 +276,13 @@ typedef struct guac_rdp_client {
      */
     RailClientContext* rail_interface;
 
+    /**
+     * Tracking state for the on-screen geometry of all top-level RemoteApp
+     * windows, used to translate server-side window movement into client-side
+     * copy hints. Unused (and empty) if RemoteApp is not in use.
+     */
+    guac_rdp_rail_window_tracker rail_windows;
+
 } guac_rdp_client;
 
 /**
@@ -97,6 +97,7 @@ const char* GUAC_RDP_CLIENT_ARGS[] = {
     "disable-offscreen-caching",
     "disable-glyph-caching",
     "disable-gfx",
+    "enable-gfx-h264",
     "preconnection-id",
     "preconnection-blob",
     "timezone",
@@ -418,6 +419,17 @@ enum RDP_ARGS_IDX {
      */
     IDX_DISABLE_GFX,
 
+    /**
+     * "true" if H.264 (AVC420) should be negotiated for the RDP Graphics
+     * Pipeline Extension and received H.264 regions should be forwarded
+     * directly to connected clients as a video stream, "false" or blank if
+     * all graphics should be decoded and re-encoded server-side. This has no
+     * effect if the Graphics Pipeline Extension is disabled, and is
+     * automatically disabled if any connected client lacks support for H.264
+     * video streams.
+     */
+    IDX_ENABLE_GFX_H264,
+
     /**
      * The preconnection ID to send within the preconnection PDU when
      * initiating an RDP connection, if any.
@@ -1239,6 +1251,32 @@ guac_rdp_settings* guac_rdp_parse_args(guac_user* user,
         !guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
                 IDX_DISABLE_GFX, 0);
 
+    /* H.264 (AVC420) passthrough enable/disable */
+    settings->enable_gfx_h264 =
+        guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
+                IDX_ENABLE_GFX_H264, 0);
+
+    /* H.264 passthrough requires the Graphics Pipeline Extension, as well as
+     * support for H.264 video streams on the part of the connected client */
+    if (settings->enable_gfx_h264) {
+
+        if (!settings->enable_gfx) {
+            guac_user_log(user, GUAC_LOG_WARNING, "H.264 passthrough cannot "
+                    "be enabled, as the RDP Graphics Pipeline Extension is "
+                    "disabled.");
+            settings->enable_gfx_h264 = 0;
+        }
+
+        else if (!guac_user_supports_video(user, "video/h264")) {
+            guac_user_log(user, GUAC_LOG_WARNING, "H.264 passthrough cannot "
+                    "be enabled, as the connected client does not support "
+                    "H.264 video streams. Graphics will be decoded and "
+                    "re-encoded server-side.");
+            settings->enable_gfx_h264 = 0;
+        }
+
+    }
+
     /* Session color depth */
     settings->color_depth =
         guac_user_parse_args_int(user, GUAC_RDP_CLIENT_ARGS, argv,
@@ -1549,6 +1587,16 @@ void guac_rdp_push_settings(guac_client* client,
         freerdp_settings_set_uint32(rdp_settings, FreeRDP_ColorDepth, RDP_GFX_REQUIRED_DEPTH);
         freerdp_settings_set_bool(rdp_settings, FreeRDP_SoftwareGdi, TRUE);
 
+        /* Negotiate H.264 (AVC420) only if received H.264 regions will be
+         * forwarded directly to connected clients. AVC444 is explicitly
+         * disabled, as its auxiliary chroma stream cannot be represented
+         * within a standard H.264 video stream. */
+        if (guac_settings->enable_gfx_h264) {
+            freerdp_settings_set_bool(rdp_settings, FreeRDP_GfxH264, TRUE);
+            freerdp_settings_set_bool(rdp_settings, FreeRDP_GfxAVC444, FALSE);
+            freerdp_settings_set_bool(rdp_settings, FreeRDP_GfxAVC444v2, FALSE);
+        }
+
     }
 
     /* Set individual flags - some FreeRDP versions overwrite flags set by guac_rdp_get_performance_flags() above */
@@ -1795,6 +1843,16 @@ void guac_rdp_push_settings(guac_client* client,
         rdp_settings->ColorDepth = RDP_GFX_REQUIRED_DEPTH;
         rdp_settings->SoftwareGdi = TRUE;
 
+        /* Negotiate H.264 (AVC420) only if received H.264 regions will be
+         * forwarded directly to connected clients. AVC444 is explicitly
+         * disabled, as its auxiliary chroma stream cannot be represented
+         * within a standard H.264 video stream. */
+        if (guac_settings->enable_gfx_h264) {
+            rdp_settings->GfxH264 = TRUE;
+            rdp_settings->GfxAVC444 = FALSE;
+            rdp_settings->GfxAVC444v2 = FALSE;
+        }
+
     }
 
     /* Set individual flags - some FreeRDP versions overwrite flags set by guac_rdp_get_performance_flags() above */
@@ -606,6 +606,15 @@ typedef struct guac_rdp_settings {
      */
     int enable_gfx;
 
+    /**
+     * Whether H.264 (AVC420) should be negotiated for the RDP Graphics
+     * Pipeline Extension, with received H.264 regions forwarded directly to
+     * connected clients as a video stream rather than decoded and re-encoded
+     * server-side. This is only possible if the Graphics Pipeline Extension
+     * is enabled and all connected clients support H.264 video streams.
+     */
+    int enable_gfx_h264;
+
     /**
      * Whether multi-touch support is enabled.
      */
@@ -22,6 +22,7 @@
 #include "channels/pipe-svc.h"
 #include "config.h"
 #include "input.h"
+#include "pipe.h"
 #include "rdp.h"
 #include "settings.h"
 #include "upload.h"
@@ -102,8 +103,8 @@ int guac_rdp_user_join_handler(guac_user* user, int argc, char** argv) {
         /* Set generic (non-filesystem) file upload handler */
         user->file_handler = guac_rdp_user_file_handler;
 
-        /* Inbound arbitrary named pipes */
-        user->pipe_handler = guac_rdp_pipe_svc_pipe_handler;
+        /* Inbound arbitrary named pipes (including STDIN typing) */
+        user->pipe_handler = guac_rdp_pipe_handler;
         
         /* If we own it, register handler for updating parameters during connection. */
         if (user->owner)
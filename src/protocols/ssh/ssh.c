@@ -208,13 +208,53 @@ void* ssh_input_thread(void* data) {
 
     /* Write all data read */
     while ((bytes_read = guac_terminal_read_stdin(ssh_client->term, buffer, sizeof(buffer))) > 0) {
-        pthread_mutex_lock(&(ssh_client->term_channel_lock));
-        libssh2_channel_write(ssh_client->term_channel, buffer, bytes_read);
-        pthread_mutex_unlock(&(ssh_client->term_channel_lock));
+
+        /* Write the full batch of input to the terminal channel. As the
+         * session is nonblocking, writes may complete partially or not at
+         * all, particularly for large pastes, and any remainder must be
+         * retried rather than dropped. */
+        char* current = buffer;
+        while (bytes_read > 0) {
+
+            pthread_mutex_lock(&(ssh_client->term_channel_lock));
+            ssize_t written = libssh2_channel_write(ssh_client->term_channel,
+                    current, bytes_read);
+            pthread_mutex_unlock(&(ssh_client->term_channel_lock));
+
+            /* Wait for the channel to become writable again before
+             * retrying, without holding the channel lock */
+            if (written == LIBSSH2_ERROR_EAGAIN) {
+
+                struct pollfd fds[] = {{
+                    .fd      = ssh_client->session->fd,
+                    .events  = POLLOUT,
+                    .revents = 0,
+                }};
+
+                if (poll(fds, 1, GUAC_SSH_DEFAULT_POLL_TIMEOUT) < 0)
+                    break;
+
+                written = 0;
+
+            }
+
+            /* Abort on any other error */
+            else if (written < 0)
+                break;
+
+            current += written;
+            bytes_read -= written;
+
+            /* Make sure ssh_input_thread can be terminated anyway */
+            if (client->state == GUAC_CLIENT_STOPPING)
+                break;
+
+        }
 
         /* Make sure ssh_input_thread can be terminated anyway */
-        if (client->state == GUAC_CLIENT_STOPPING)
+        if (bytes_read > 0 || client->state == GUAC_CLIENT_STOPPING)
             break;
+
     }
 
     /* Stop the client so that ssh_client_thread can be terminated */
@@ -244,15 +284,19 @@ void* ssh_client_thread(void* data) {
             guac_client_log(client, GUAC_LOG_DEBUG, "Sending Wake-on-LAN packet, "
                     "and pausing for %d seconds.", settings->wol_wait_time);
 
-            /* Send the Wake-on-LAN request and wait until the server is responsive. */
-            if (guac_wol_wake_and_wait(settings->wol_mac_addr,
+            /* Send the Wake-on-LAN request and poll in the background until
+             * the server is responsive, aborting early on disconnect. */
+            guac_wol_wait* wol_wait = guac_wol_wake_and_wait_async(client,
+                    settings->wol_mac_addr,
                     settings->wol_broadcast_addr,
                     settings->wol_udp_port,
                     settings->wol_wait_time,
                     GUAC_WOL_DEFAULT_CONNECT_RETRIES,
                     settings->hostname,
                     settings->port,
-                    settings->timeout)) {
+                    settings->timeout);
+
+            if (wol_wait == NULL || guac_wol_wake_and_wait_result(wol_wait)) {
                 guac_client_log(client, GUAC_LOG_ERROR, "Failed to send WOL packet or connect to remote server.");
                 return NULL;
             }
@@ -386,7 +430,12 @@ void* ssh_client_thread(void* data) {
     /* Start SFTP session as well, if enabled */
     if (settings->enable_sftp) {
 
-        /* Create SSH session specific for SFTP */
+        /*
+         * Create an SSH session specific to SFTP. The terminal session cannot
+         * be reused here: SFTP operations are driven by user threads while
+         * terminal I/O runs on the client thread, and libssh2 sessions are
+         * not safe for concurrent use by multiple threads.
+         */
         guac_client_log(client, GUAC_LOG_DEBUG, "Reconnecting for SFTP...");
         ssh_client->sftp_session =
             guac_common_ssh_create_session(client, settings->hostname,
@@ -503,12 +552,26 @@ void* ssh_client_thread(void* data) {
 
         /* Send keepalive at configured interval */
         if (settings->server_alive_interval > 0) {
+
             timeout = 0;
-            if (libssh2_keepalive_send(ssh_client->session->session, &timeout) > 0) {
+            int keepalive_result =
+                libssh2_keepalive_send(ssh_client->session->session, &timeout);
+
+            /* Bail out if the keepalive cannot be sent at all (the session is
+             * nonblocking, so a send that would merely block is retried on
+             * the next iteration) */
+            if (keepalive_result < 0 && keepalive_result != LIBSSH2_ERROR_EAGAIN) {
                 pthread_mutex_unlock(&(ssh_client->term_channel_lock));
                 break;
             }
+
             timeout *= 1000;
+
+            /* Avoid busy-waiting if the time until the next keepalive is
+             * unknown, as will be the case if the send was deferred */
+            if (timeout <= 0)
+                timeout = GUAC_SSH_DEFAULT_POLL_TIMEOUT;
+
         }
         /* If keepalive is not configured, sleep for the default of 1 second */
         else
@@ -264,6 +264,42 @@ static void guac_telnet_search(guac_client* client, const char* buffer, int size
 
 }
 
+/**
+ * Writes any buffered terminal output to the terminal, additionally testing
+ * that output against the login automation regexes if any such search is
+ * still in progress. Consecutive data events fired by libtelnet while parsing
+ * a single receive are coalesced within the data buffer, and this function
+ * must be invoked once parsing of that receive has completed. If the data
+ * buffer is empty, this function has no effect.
+ *
+ * @param client
+ *     The guac_client associated with the telnet session.
+ */
+static void __guac_telnet_flush_data(guac_client* client) {
+
+    guac_telnet_client* telnet_client = (guac_telnet_client*) client->data;
+    guac_telnet_settings* settings = telnet_client->settings;
+
+    if (telnet_client->data_buffer_length == 0)
+        return;
+
+    guac_terminal_write(telnet_client->term, telnet_client->data_buffer,
+            telnet_client->data_buffer_length);
+
+    /* Search for login prompts only while login automation is still in
+     * progress (all searches are freed once authentication completes, and
+     * session output need not be scanned thereafter) */
+    if (settings->username_regex != NULL
+            || settings->password_regex != NULL
+            || settings->login_success_regex != NULL
+            || settings->login_failure_regex != NULL)
+        guac_telnet_search(client, telnet_client->data_buffer,
+                telnet_client->data_buffer_length);
+
+    telnet_client->data_buffer_length = 0;
+
+}
+
 /**
  * Event handler, as defined by libtelnet. This function is passed to
  * telnet_init() and will be called for every event fired by libtelnet,
@@ -277,10 +313,19 @@ static void __guac_telnet_event_handler(telnet_t* telnet, telnet_event_t* event,
 
     switch (event->type) {
 
-        /* Terminal output received */
+        /* Terminal output received (coalesced with any further data events
+         * fired while parsing the same receive, and flushed to the terminal
+         * once parsing of that receive completes) */
         case TELNET_EV_DATA:
-            guac_terminal_write(telnet_client->term, event->data.buffer, event->data.size);
-            guac_telnet_search(client, event->data.buffer, event->data.size);
+
+            /* Flush early if the received data cannot fit within the buffer */
+            if (telnet_client->data_buffer_length + event->data.size
+                    > sizeof(telnet_client->data_buffer))
+                __guac_telnet_flush_data(client);
+
+            memcpy(telnet_client->data_buffer + telnet_client->data_buffer_length,
+                    event->data.buffer, event->data.size);
+            telnet_client->data_buffer_length += event->data.size;
             break;
 
         /* Data destined for remote end */
@@ -504,15 +549,19 @@ void* guac_telnet_client_thread(void* data) {
             guac_client_log(client, GUAC_LOG_DEBUG, "Sending Wake-on-LAN packet, "
                     "and pausing for %d seconds.", settings->wol_wait_time);
 
-            /* Send the Wake-on-LAN request and wait until the server is responsive. */
-            if (guac_wol_wake_and_wait(settings->wol_mac_addr,
+            /* Send the Wake-on-LAN request and poll in the background until
+             * the server is responsive, aborting early on disconnect. */
+            guac_wol_wait* wol_wait = guac_wol_wake_and_wait_async(client,
+                    settings->wol_mac_addr,
                     settings->wol_broadcast_addr,
                     settings->wol_udp_port,
                     settings->wol_wait_time,
                     GUAC_WOL_DEFAULT_CONNECT_RETRIES,
                     settings->hostname,
                     settings->port,
-                    settings->timeout)) {
+                    settings->timeout);
+
+            if (wol_wait == NULL || guac_wol_wake_and_wait_result(wol_wait)) {
                 guac_client_log(client, GUAC_LOG_ERROR, "Failed to send WOL packet or connect to remote server.");
                 return NULL;
             }
@@ -613,6 +662,10 @@ void* guac_telnet_client_thread(void* data) {
 
         telnet_recv(telnet_client->telnet, buffer, bytes_read);
 
+        /* Write all terminal output coalesced while parsing the received
+         * data with a single call */
+        __guac_telnet_flush_data(client);
+
     }
 
     /* Kill client and Wait for input thread to die */
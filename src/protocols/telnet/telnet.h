@@ -29,6 +29,15 @@
 
 #include <stdint.h>
 
+/**
+ * The size of the buffer used to coalesce the data events fired by libtelnet
+ * while parsing received data, in bytes. As libtelnet fires a separate data
+ * event for each run of bytes between IAC sequences, a single receive may
+ * otherwise result in many small writes to the terminal. This value must be
+ * at least as large as the receive buffer used by the telnet client thread.
+ */
+#define GUAC_TELNET_DATA_BUFFER_SIZE 8192
+
 /**
  * Telnet-specific client data.
  */
@@ -71,6 +80,19 @@ typedef struct guac_telnet_client {
      */
     guac_terminal* term;
 
+    /**
+     * Buffer of terminal output that has been received via libtelnet data
+     * events but not yet written to the terminal. Consecutive data events
+     * fired while parsing a single receive are coalesced here and written to
+     * the terminal with a single call once parsing of the receive completes.
+     */
+    char data_buffer[GUAC_TELNET_DATA_BUFFER_SIZE];
+
+    /**
+     * The number of bytes currently stored within data_buffer.
+     */
+    int data_buffer_length;
+
     /**
      * The in-progress session recording, or NULL if no recording is in
      * progress.
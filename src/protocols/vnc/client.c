@@ -124,6 +124,10 @@ int guac_client_init(guac_client* client) {
     client->leave_handler = guac_vnc_user_leave_handler;
     client->free_handler = guac_vnc_client_free_handler;
 
+    /* Mouse events are forwarded to the VNC server as pointer state, so only
+     * the latest position matters for runs of pure movement */
+    client->coalesce_mouse_events = 1;
+
     return 0;
 }
 
@@ -198,6 +202,9 @@ int guac_vnc_client_free_handler(guac_client* client) {
     if (vnc_client->display != NULL)
         guac_display_free(vnc_client->display);
 
+    /* Free cached color translation table */
+    guac_mem_free(vnc_client->color_table);
+
 #ifdef ENABLE_PULSE
     /* If audio enabled, stop streaming */
     if (vnc_client->audio)
@@ -32,6 +32,26 @@
  */
 #define GUAC_VNC_MESSAGE_CHECK_INTERVAL 1000
 
+/**
+ * The maximum amount of time that may be spent draining further pending
+ * messages from the VNC server after the first message of a batch has been
+ * handled, in milliseconds. Draining coalesces runs of small updates from
+ * chatty VNC servers into a single frame, but occurs while the underlying
+ * display context is held open, so the drain window must be kept short enough
+ * that a server producing a continuous stream of updates cannot hold off
+ * frame flushes indefinitely.
+ */
+#define GUAC_VNC_MESSAGE_MAX_DRAIN_INTERVAL 10
+
+/**
+ * The amount of time to delay reading further messages from the VNC server
+ * when the display pipeline is saturated, in milliseconds. As libvncclient
+ * sends its incremental framebuffer update requests only while processing
+ * received messages, pausing reads both paces those requests and applies TCP
+ * backpressure to the server.
+ */
+#define GUAC_VNC_MESSAGE_PACING_DELAY 50
+
 /**
  * The number of milliseconds to wait between connection attempts.
  */
@@ -43,8 +43,61 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <syslog.h>
 
+/**
+ * Returns a lookup table mapping every possible pixel value of the VNC
+ * client's current pixel format to the corresponding 32-bit ARGB value,
+ * building or rebuilding that table if necessary. The table is cached within
+ * the guac_vnc_client and reused until the pixel format changes. Only 8- and
+ * 16-bit pixel formats may be translated through such a table; this function
+ * must not be invoked for other formats.
+ *
+ * @param vnc_client
+ *     The guac_vnc_client associated with the VNC session.
+ *
+ * @param client
+ *     The VNC client whose current pixel format should be used to build the
+ *     table.
+ *
+ * @return
+ *     A lookup table mapping every possible pixel value of the VNC client's
+ *     current pixel format to the corresponding 32-bit ARGB value.
+ */
+static const uint32_t* guac_vnc_get_color_table(guac_vnc_client* vnc_client,
+        rfbClient* client) {
+
+    /* Reuse the previously-built table if the pixel format has not changed */
+    if (vnc_client->color_table != NULL && !memcmp(&vnc_client->color_table_format,
+                &client->format, sizeof(rfbPixelFormat)))
+        return vnc_client->color_table;
+
+    size_t table_size = (size_t) 1 << client->format.bitsPerPixel;
+
+    guac_mem_free(vnc_client->color_table);
+    uint32_t* table = guac_mem_alloc(table_size, sizeof(uint32_t));
+
+    /* Translate each possible pixel value to 32-bit ARGB in advance */
+    for (size_t v = 0; v < table_size; v++) {
+
+        uint8_t red   = (v >> client->format.redShift)   * 0x100 / (client->format.redMax   + 1);
+        uint8_t green = (v >> client->format.greenShift) * 0x100 / (client->format.greenMax + 1);
+        uint8_t blue  = (v >> client->format.blueShift)  * 0x100 / (client->format.blueMax  + 1);
+
+        if (vnc_client->settings->swap_red_blue)
+            table[v] = 0xFF000000 | (blue << 16) | (green << 8) | red;
+        else
+            table[v] = 0xFF000000 | (red  << 16) | (green << 8) | blue;
+
+    }
+
+    vnc_client->color_table = table;
+    vnc_client->color_table_format = client->format;
+    return table;
+
+}
+
 void guac_vnc_update(rfbClient* client, int x, int y, int w, int h) {
 
     guac_client* gc = rfbClientGetClientData(client, GUAC_VNC_CLIENT_KEY);
@@ -74,6 +127,13 @@ void guac_vnc_update(rfbClient* client, int x, int y, int w, int h) {
         /* Ensure draw is within current bounds of the pending frame */
         guac_rect_constrain(&op_bounds, &context->bounds);
 
+        /* All possible pixel values of 8- and 16-bit formats are translated in
+         * advance via a lookup table, leaving only a single table lookup per
+         * pixel here */
+        const uint32_t* color_table = NULL;
+        if (vnc_bpp <= 2)
+            color_table = guac_vnc_get_color_table(vnc_client, client);
+
         const unsigned char* vnc_current_row = GUAC_RECT_CONST_BUFFER(op_bounds, client->frameBuffer, vnc_stride, vnc_bpp);
         unsigned char* layer_current_row = GUAC_RECT_MUTABLE_BUFFER(op_bounds, context->buffer, context->stride, GUAC_DISPLAY_LAYER_RAW_BPP);
         for (int dy = op_bounds.top; dy < op_bounds.bottom; dy++) {
@@ -101,16 +161,23 @@ void guac_vnc_update(rfbClient* client, int x, int y, int w, int h) {
 
                 }
 
-                /* Translate value to 32-bit RGB */
-                uint8_t red   = (v >> client->format.redShift)   * 0x100 / (client->format.redMax   + 1);
-                uint8_t green = (v >> client->format.greenShift) * 0x100 / (client->format.greenMax + 1);
-                uint8_t blue  = (v >> client->format.blueShift)  * 0x100 / (client->format.blueMax  + 1);
+                /* Translate value to 32-bit RGB via the prebuilt table if
+                 * possible, falling back to translating in place */
+                if (color_table != NULL)
+                    *(layer_current_pixel++) = color_table[v];
+
+                else {
+
+                    uint8_t red   = (v >> client->format.redShift)   * 0x100 / (client->format.redMax   + 1);
+                    uint8_t green = (v >> client->format.greenShift) * 0x100 / (client->format.greenMax + 1);
+                    uint8_t blue  = (v >> client->format.blueShift)  * 0x100 / (client->format.blueMax  + 1);
 
-                /* Output RGB */
-                if (vnc_client->settings->swap_red_blue)
-                    *(layer_current_pixel++) = 0xFF000000 | (blue << 16) | (green << 8) | red;
-                else
-                    *(layer_current_pixel++) = 0xFF000000 | (red  << 16) | (green << 8) | blue;
+                    if (vnc_client->settings->swap_red_blue)
+                        *(layer_current_pixel++) = 0xFF000000 | (blue << 16) | (green << 8) | red;
+                    else
+                        *(layer_current_pixel++) = 0xFF000000 | (red  << 16) | (green << 8) | blue;
+
+                }
 
                 /* Advance to next pixel in VNC framebuffer */
                 vnc_current_pixel += vnc_bpp;
@@ -144,6 +211,15 @@ void guac_vnc_copyrect(rfbClient* client, int src_x, int src_y, int w, int h, in
      * libvncclient's display buffer */
     vnc_client->rfb_GotCopyRect(client, src_x, src_y, w, h, dest_x, dest_y);
 
+    /* Pass the source and destination of the copy through to the scroll/copy
+     * optimization such that the affected region can be sent as a copy
+     * instruction rather than re-encoded image data */
+    guac_rect src_rect, dest_rect;
+    guac_rect_init(&src_rect, src_x, src_y, w, h);
+    guac_rect_init(&dest_rect, dest_x, dest_y, w, h);
+    guac_display_layer_raw_context_hint_copy(vnc_client->current_context,
+            &src_rect, &dest_rect);
+
 }
 
 #ifdef LIBVNC_HAS_RESIZE_SUPPORT
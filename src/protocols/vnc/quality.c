@@ -0,0 +1,130 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "quality.h"
+#include "vnc.h"
+
+#include <guacamole/client.h>
+#include <guacamole/display.h>
+#include <guacamole/timestamp.h>
+#include <rfb/rfbclient.h>
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
+
+void guac_vnc_quality_init(guac_client* client) {
+
+    guac_vnc_client* vnc_client = (guac_vnc_client*) client->data;
+    rfbClient* rfb_client = vnc_client->rfb_client;
+
+    /* The levels in effect at connect time (whether from settings or from
+     * libvncclient defaults) are the levels that should be maintained
+     * whenever the connection is keeping up */
+    vnc_client->target_quality = rfb_client->appData.qualityLevel;
+    vnc_client->target_compress = rfb_client->appData.compressLevel;
+    vnc_client->current_quality = vnc_client->target_quality;
+    vnc_client->current_compress = vnc_client->target_compress;
+
+    vnc_client->quality_last_evaluated = guac_timestamp_current();
+    guac_display_get_stats(vnc_client->display, &vnc_client->quality_last_stats);
+
+}
+
+void guac_vnc_update_quality(guac_client* client) {
+
+    guac_vnc_client* vnc_client = (guac_vnc_client*) client->data;
+    rfbClient* rfb_client = vnc_client->rfb_client;
+
+    /* Evaluate only periodically */
+    guac_timestamp now = guac_timestamp_current();
+    uint64_t interval = now - vnc_client->quality_last_evaluated;
+    if (interval < GUAC_VNC_QUALITY_EVAL_INTERVAL)
+        return;
+
+    vnc_client->quality_last_evaluated = now;
+
+    /* Determine how much of the evaluation interval was spent blocked in the
+     * end-of-frame socket flush */
+    guac_display_stats stats;
+    guac_display_get_stats(vnc_client->display, &stats);
+
+    uint64_t flush_ms = stats.flush_duration_ms
+        - vnc_client->quality_last_stats.flush_duration_ms;
+
+    vnc_client->quality_last_stats = stats;
+
+    int quality = vnc_client->current_quality;
+    int compress = vnc_client->current_compress;
+
+    /* Trade fidelity for throughput while connected users cannot consume
+     * frames as fast as they are produced */
+    if (flush_ms * 100 >= interval * GUAC_VNC_QUALITY_DEGRADE_PERCENT) {
+
+        /* Also begin pacing reads of further server messages until the
+         * pipeline recovers */
+        vnc_client->display_backlogged = 1;
+
+        quality -= 2;
+        if (quality < 0)
+            quality = 0;
+
+        compress = 9;
+
+    }
+
+    /* Gradually restore the configured levels once the connection has caught
+     * up (including while idle) */
+    else if (flush_ms * 100 <= interval * GUAC_VNC_QUALITY_RECOVER_PERCENT) {
+
+        vnc_client->display_backlogged = 0;
+
+        if (quality < vnc_client->target_quality)
+            quality++;
+        else
+            compress = vnc_client->target_compress;
+
+    }
+
+    /* Renegotiate with the VNC server only if the desired levels actually
+     * changed */
+    if (quality == vnc_client->current_quality
+            && compress == vnc_client->current_compress)
+        return;
+
+    vnc_client->current_quality = quality;
+    vnc_client->current_compress = compress;
+
+    rfb_client->appData.qualityLevel = quality;
+    rfb_client->appData.compressLevel = compress;
+
+    /* Acquire the lock for sending messages to the server */
+    pthread_mutex_lock(&(vnc_client->message_lock));
+    SetFormatAndEncodings(rfb_client);
+    pthread_mutex_unlock(&(vnc_client->message_lock));
+
+    guac_client_log(client, GUAC_LOG_DEBUG, "Renegotiated VNC quality level "
+            "to %i and compression level to %i (%" PRIu64 "ms of the last "
+            "%" PRIu64 "ms was spent blocked on frame flush)", quality,
+            compress, flush_ms, interval);
+
+}
+
@@ -0,0 +1,82 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_VNC_QUALITY_H
+#define GUAC_VNC_QUALITY_H
+
+#include "config.h"
+
+#include <guacamole/client.h>
+
+/**
+ * The minimum amount of time that must elapse between evaluations of the
+ * adaptive quality feedback loop, in milliseconds.
+ */
+#define GUAC_VNC_QUALITY_EVAL_INTERVAL 2000
+
+/**
+ * The percentage of wall-clock time that must have been spent blocked in the
+ * end-of-frame socket flush since the last evaluation for the connection to
+ * be considered saturated, causing the requested VNC quality to be reduced.
+ */
+#define GUAC_VNC_QUALITY_DEGRADE_PERCENT 50
+
+/**
+ * The percentage of wall-clock time spent blocked in the end-of-frame socket
+ * flush below which the connection is considered healthy, allowing any
+ * previous reduction in requested VNC quality to be gradually reverted.
+ */
+#define GUAC_VNC_QUALITY_RECOVER_PERCENT 10
+
+/**
+ * Initializes the state of the adaptive quality feedback loop for the given
+ * VNC session, recording the configured quality and compression levels as
+ * the levels that the feedback loop should maintain when the connection is
+ * keeping up. This function must be invoked once, after the VNC connection
+ * has been established and the initial quality and compression levels have
+ * been applied, before guac_vnc_update_quality() may be used.
+ *
+ * @param client
+ *     The guac_client associated with the VNC session.
+ */
+void guac_vnc_quality_init(guac_client* client);
+
+/**
+ * Evaluates the adaptive quality feedback loop for the given VNC session,
+ * renegotiating the quality and compression levels requested of the VNC
+ * server if the display pipeline is falling behind (or has since recovered).
+ * This function is intended to be invoked repeatedly from the main VNC
+ * message loop and will do nothing if insufficient time has elapsed since
+ * the last evaluation.
+ *
+ * Saturation is measured using the rendering statistics of the underlying
+ * guac_display: if the bulk of wall-clock time is being spent blocked in the
+ * end-of-frame socket flush, connected users cannot consume frames as fast
+ * as they are being produced, and fidelity is traded for throughput by
+ * lowering the requested quality level and raising the requested compression
+ * level. Once the connection catches up, the configured levels are restored
+ * one step at a time.
+ *
+ * @param client
+ *     The guac_client associated with the VNC session.
+ */
+void guac_vnc_update_quality(guac_client* client);
+
+#endif
+
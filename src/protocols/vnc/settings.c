@@ -56,6 +56,8 @@ const char* GUAC_VNC_CLIENT_ARGS[] = {
 #ifdef ENABLE_PULSE
     "enable-audio",
     "audio-servername",
+    "audio-rate",
+    "audio-channels",
 #endif
 
 #ifdef ENABLE_VNC_LISTEN
@@ -202,6 +204,22 @@ enum VNC_ARGS_IDX {
      * default sink of the local machine will be used as the source for audio.
      */
     IDX_AUDIO_SERVERNAME,
+
+    /**
+     * The rate of the audio to stream, in Hz. If left blank, the default rate
+     * will be used. PulseAudio will resample as necessary, and thus lower
+     * rates may be requested to reduce the bandwidth required by the audio
+     * stream.
+     */
+    IDX_AUDIO_RATE,
+
+    /**
+     * The number of channels of audio to stream. If left blank, the default
+     * number of channels will be used. PulseAudio will remix as necessary,
+     * and thus mono may be requested to reduce the bandwidth required by the
+     * audio stream.
+     */
+    IDX_AUDIO_CHANNELS,
 #endif
 
 #ifdef ENABLE_VNC_LISTEN
@@ -562,6 +580,15 @@ guac_vnc_settings* guac_vnc_parse_args(guac_user* user,
         settings->pa_servername =
             guac_user_parse_args_string(user, GUAC_VNC_CLIENT_ARGS, argv,
                     IDX_AUDIO_SERVERNAME, NULL);
+
+    /* Audio rate and channels (zero selects the defaults) */
+    settings->audio_rate =
+        guac_user_parse_args_int(user, GUAC_VNC_CLIENT_ARGS, argv,
+                IDX_AUDIO_RATE, 0);
+
+    settings->audio_channels =
+        guac_user_parse_args_int(user, GUAC_VNC_CLIENT_ARGS, argv,
+                IDX_AUDIO_CHANNELS, 0);
 #endif
 
     /* Set clipboard encoding if specified */
@@ -145,6 +145,17 @@ typedef struct guac_vnc_settings {
      * The name of the PulseAudio server to connect to.
      */
     char* pa_servername;
+
+    /**
+     * The rate of audio to stream, in Hz, or zero to use the default rate.
+     */
+    int audio_rate;
+
+    /**
+     * The number of channels of audio to stream, or zero to use the default
+     * number of channels.
+     */
+    int audio_channels;
 #endif
 
     /**
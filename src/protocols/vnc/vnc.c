@@ -26,6 +26,7 @@
 #include "cursor.h"
 #include "display.h"
 #include "log.h"
+#include "quality.h"
 #include "settings.h"
 #include "vnc.h"
 
@@ -295,6 +296,22 @@ static rfbBool guac_vnc_handle_messages(guac_client* client) {
      * guac_display, resizing the display buffer, etc.) */
     rfbBool retval = HandleRFBServerMessage(rfb_client);
 
+    /* Drain any further messages that have already arrived, coalescing runs
+     * of small updates from chatty VNC servers into a single frame rather
+     * than each tiny rect cutting a frame of its own. As the display context
+     * is held open for the duration, the drain window is bounded such that a
+     * continuous stream of updates cannot hold off frame flushes */
+    guac_timestamp drain_started = guac_timestamp_current();
+    while (retval && guac_vnc_wait_for_messages(rfb_client, 0) > 0) {
+
+        retval = HandleRFBServerMessage(rfb_client);
+
+        if (guac_timestamp_current() - drain_started
+                >= GUAC_VNC_MESSAGE_MAX_DRAIN_INTERVAL)
+            break;
+
+    }
+
     /* Use the buffer of libvncclient directly if it matches the guac_display
      * format */
     unsigned int vnc_bpp = rfb_client->format.bitsPerPixel / 8;
@@ -371,15 +388,19 @@ void* guac_vnc_client_thread(void* data) {
                 return NULL;
             }
 
-            /* Send the Wake-on-LAN request and wait until the server is responsive. */
-            if (guac_wol_wake_and_wait(settings->wol_mac_addr,
+            /* Send the Wake-on-LAN request and poll in the background until
+             * the server is responsive, aborting early on disconnect. */
+            guac_wol_wait* wol_wait = guac_wol_wake_and_wait_async(client,
+                    settings->wol_mac_addr,
                     settings->wol_broadcast_addr,
                     settings->wol_udp_port,
                     settings->wol_wait_time,
                     GUAC_WOL_DEFAULT_CONNECT_RETRIES,
                     settings->hostname,
                     (const char *) str_port,
-                    GUAC_WOL_DEFAULT_CONNECTION_TIMEOUT)) {
+                    GUAC_WOL_DEFAULT_CONNECTION_TIMEOUT);
+
+            if (wol_wait == NULL || guac_wol_wake_and_wait_result(wol_wait)) {
                 guac_client_log(client, GUAC_LOG_ERROR, "Failed to send WOL packet or connect to remote system.");
                 guac_mem_free(str_port);
                 return NULL;
@@ -436,8 +457,9 @@ void* guac_vnc_client_thread(void* data) {
 #ifdef ENABLE_PULSE
     /* If audio is enabled, start streaming via PulseAudio */
     if (settings->audio_enabled)
-        vnc_client->audio = guac_pa_stream_alloc(client, 
-                settings->pa_servername);
+        vnc_client->audio = guac_pa_stream_alloc(client,
+                settings->pa_servername, settings->audio_rate,
+                settings->audio_channels);
 #endif
 
 #ifdef ENABLE_COMMON_SSH
@@ -624,9 +646,21 @@ void* guac_vnc_client_thread(void* data) {
 
     vnc_client->render_thread = guac_display_render_thread_create(vnc_client->display);
 
+    /* Record the configured quality/compression levels as the levels that the
+     * adaptive quality feedback loop should maintain */
+    guac_vnc_quality_init(client);
+
     /* Handle messages from VNC server while client is running */
     while (client->state == GUAC_CLIENT_RUNNING) {
 
+        /* If the display pipeline is saturated, briefly delay reading further
+         * messages. The libvncclient library sends its incremental
+         * framebuffer update requests only while processing received
+         * messages, so pausing reads both paces those requests and applies
+         * TCP backpressure to the VNC server */
+        if (vnc_client->display_backlogged)
+            guac_timestamp_msleep(GUAC_VNC_MESSAGE_PACING_DELAY);
+
         /* Wait for data and construct a reasonable frame */
         int wait_result = guac_vnc_wait_for_messages(rfb_client, GUAC_VNC_MESSAGE_CHECK_INTERVAL);
         if (wait_result > 0) {
@@ -645,6 +679,10 @@ void* guac_vnc_client_thread(void* data) {
         else if (wait_result < 0)
             guac_client_abort(client, GUAC_PROTOCOL_STATUS_UPSTREAM_ERROR, "Connection closed.");
 
+        /* Trade fidelity for throughput if the display pipeline is falling
+         * behind, recovering once the connection has caught up */
+        guac_vnc_update_quality(client);
+
     }
 
     /* Stop render loop */
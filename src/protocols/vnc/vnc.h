@@ -30,6 +30,7 @@
 #include <guacamole/client.h>
 #include <guacamole/display.h>
 #include <guacamole/layer.h>
+#include <guacamole/timestamp.h>
 #include <rfb/rfbclient.h>
 
 #ifdef ENABLE_PULSE
@@ -45,6 +46,7 @@
 #include <guacamole/recording.h>
 
 #include <pthread.h>
+#include <stdint.h>
 
 /**
  * The ID of the RFB client screen. If multi-screen support is added, more than
@@ -113,6 +115,68 @@ typedef struct guac_vnc_client {
      */
     guac_display_layer_raw_context* current_context;
 
+    /**
+     * Lookup table mapping every possible pixel value of the current 8- or
+     * 16-bit VNC pixel format to the corresponding 32-bit ARGB value, or NULL
+     * if no such table has been built. This table is built on demand the
+     * first time an update in an 8- or 16-bit format must be converted, and
+     * is rebuilt if the pixel format changes.
+     */
+    uint32_t* color_table;
+
+    /**
+     * The VNC pixel format that was in use when color_table was built. If
+     * the current pixel format differs, the table is stale and must be
+     * rebuilt before use.
+     */
+    rfbPixelFormat color_table_format;
+
+    /**
+     * The quality level that the adaptive quality feedback loop should
+     * maintain when the connection is keeping up. This is the level in
+     * effect when the connection was established.
+     */
+    int target_quality;
+
+    /**
+     * The compression level that the adaptive quality feedback loop should
+     * maintain when the connection is keeping up. This is the level in
+     * effect when the connection was established.
+     */
+    int target_compress;
+
+    /**
+     * The quality level most recently requested of the VNC server by the
+     * adaptive quality feedback loop.
+     */
+    int current_quality;
+
+    /**
+     * The compression level most recently requested of the VNC server by the
+     * adaptive quality feedback loop.
+     */
+    int current_compress;
+
+    /**
+     * The time that the adaptive quality feedback loop last ran.
+     */
+    guac_timestamp quality_last_evaluated;
+
+    /**
+     * A snapshot of the rendering statistics of the underlying guac_display
+     * as of the last run of the adaptive quality feedback loop.
+     */
+    guac_display_stats quality_last_stats;
+
+    /**
+     * Non-zero if the most recent evaluation of the adaptive quality feedback
+     * loop found the display pipeline to be saturated, zero otherwise. While
+     * this flag is set, reads of further messages from the VNC server are
+     * delayed, pacing the incremental update requests that libvncclient sends
+     * as it processes those messages.
+     */
+    int display_backlogged;
+
     /**
      * The current instance of the guac_display render thread. If the thread
      * has not yet been started, this will be NULL.
@@ -184,10 +184,11 @@ static void __context_get_sink_info_callback(pa_context* context,
     guac_client_log(client, GUAC_LOG_INFO, "Starting streaming from \"%s\"",
             info->description);
 
-    /* Set format */
+    /* Set format, deferring any necessary resampling or remixing to
+     * PulseAudio */
     spec.format   = PA_SAMPLE_S16LE;
-    spec.rate     = GUAC_PULSE_AUDIO_RATE;
-    spec.channels = GUAC_PULSE_AUDIO_CHANNELS;
+    spec.rate     = guac_stream->rate;
+    spec.channels = guac_stream->channels;
 
     attr.maxlength = -1;
     attr.fragsize  = GUAC_PULSE_AUDIO_FRAGMENT_SIZE;
@@ -302,11 +303,16 @@ static void __context_state_callback(pa_context* context, void* data) {
 }
 
 guac_pa_stream* guac_pa_stream_alloc(guac_client* client,
-        const char* server_name) {
+        const char* server_name, int rate, int channels) {
+
+    /* Use default rate/channels if not explicitly requested */
+    if (rate <= 0)
+        rate = GUAC_PULSE_AUDIO_RATE;
+    if (channels <= 0)
+        channels = GUAC_PULSE_AUDIO_CHANNELS;
 
     guac_audio_stream* audio = guac_audio_stream_alloc(client, NULL,
-            GUAC_PULSE_AUDIO_RATE, GUAC_PULSE_AUDIO_CHANNELS,
-            GUAC_PULSE_AUDIO_BPS);
+            rate, channels, GUAC_PULSE_AUDIO_BPS);
 
     /* Abort if audio stream cannot be created */
     if (audio == NULL)
@@ -317,6 +323,8 @@ guac_pa_stream* guac_pa_stream_alloc(guac_client* client,
     stream->client = client;
     stream->audio = audio;
     stream->pa_mainloop = pa_threaded_mainloop_new();
+    stream->rate = rate;
+    stream->channels = channels;
 
     /* Create context */
     pa_context* context = pa_context_new(
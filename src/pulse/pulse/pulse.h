@@ -40,12 +40,15 @@
 #define GUAC_PULSE_PCM_WRITE_RATE 49152
 
 /**
- * Rate of audio to stream, in Hz.
+ * The default rate of audio to stream, in Hz, used when no rate is explicitly
+ * requested. PulseAudio will resample as necessary to provide audio at this
+ * rate, which is one of the rates accepted directly by the Opus encoder.
  */
-#define GUAC_PULSE_AUDIO_RATE 44100
+#define GUAC_PULSE_AUDIO_RATE 48000
 
 /**
- * The number of channels to stream.
+ * The default number of channels to stream, used when no channel count is
+ * explicitly requested.
  */
 #define GUAC_PULSE_AUDIO_CHANNELS 2
 
@@ -75,6 +78,20 @@ typedef struct guac_pa_stream {
      */
     pa_threaded_mainloop* pa_mainloop;
 
+    /**
+     * The rate of audio being streamed, in Hz. Audio is requested from
+     * PulseAudio at this rate, with PulseAudio resampling as necessary before
+     * the audio is delivered.
+     */
+    int rate;
+
+    /**
+     * The number of channels being streamed. Audio is requested from
+     * PulseAudio with this number of channels, with PulseAudio remixing as
+     * necessary before the audio is delivered.
+     */
+    int channels;
+
 } guac_pa_stream;
 
 /**
@@ -88,12 +105,25 @@ typedef struct guac_pa_stream {
  *     The hostname of the PulseAudio server to connect to, or NULL to connect
  *     to the default (local) server.
  *
+ * @param rate
+ *     The rate at which audio should be streamed, in Hz, or a non-positive
+ *     value to use the default rate (GUAC_PULSE_AUDIO_RATE). PulseAudio will
+ *     resample as necessary, and thus lower rates may be requested to reduce
+ *     the bandwidth required by the audio stream.
+ *
+ * @param channels
+ *     The number of channels which should be streamed, or a non-positive
+ *     value to use the default number of channels
+ *     (GUAC_PULSE_AUDIO_CHANNELS). PulseAudio will remix as necessary, and
+ *     thus mono may be requested to reduce the bandwidth required by the
+ *     audio stream.
+ *
  * @return
  *     A newly-allocated PulseAudio stream, or NULL if audio cannot be
  *     streamed.
  */
 guac_pa_stream* guac_pa_stream_alloc(guac_client* client,
-        const char* server_name);
+        const char* server_name, int rate, int channels);
 
 /**
  * Notifies the given PulseAudio stream that a user has joined the connection.
@@ -35,13 +35,61 @@
  */
 #define GUAC_TERMINAL_BUFFER_ROW_MIN_SIZE 256
 
+/**
+ * The number of rows of scrollback nearest the visible terminal area which
+ * are always kept uncompressed. Rows scrolling beyond this window are
+ * compressed to reduce the memory footprint of large scrollback buffers, and
+ * are transparently decompressed when accessed again.
+ */
+#define GUAC_TERMINAL_BUFFER_HOT_ROWS 512
+
+/**
+ * The maximum number of characters which may be covered by a single run
+ * within the compressed form of a buffer row.
+ */
+#define GUAC_TERMINAL_BUFFER_MAX_RUN 65535
+
+/**
+ * The number of bytes used to store a single character within the compressed
+ * form of a buffer row: the codepoint, followed by the width in columns.
+ */
+#define GUAC_TERMINAL_BUFFER_PACKED_CHAR_SIZE (sizeof(int) + 1)
+
+/**
+ * The header describing a single run of characters within the compressed form
+ * of a buffer row. Each run covers a series of characters sharing the same
+ * attributes, and is followed by the codepoint and width of either the single
+ * character repeated throughout the run or each individual character within
+ * the run, depending on whether the run is repeated.
+ */
+typedef struct guac_terminal_buffer_run_header {
+
+    /**
+     * The attributes shared by all characters within the run.
+     */
+    guac_terminal_attributes attributes;
+
+    /**
+     * The number of characters covered by the run.
+     */
+    unsigned short count;
+
+    /**
+     * Whether the run consists of a single character repeated count times,
+     * rather than count distinct characters.
+     */
+    bool repeated;
+
+} guac_terminal_buffer_run_header;
+
 /**
  * A single variable-length row of terminal data.
  */
 typedef struct guac_terminal_buffer_row {
 
     /**
-     * Array of guac_terminal_char representing the contents of the row.
+     * Array of guac_terminal_char representing the contents of the row, or
+     * NULL if this row is currently stored in compressed form.
      */
     guac_terminal_char* characters;
 
@@ -54,10 +102,19 @@ typedef struct guac_terminal_buffer_row {
 
     /**
      * The number of elements in the characters array. After the length
-     * equals this value, the array must be resized.
+     * equals this value, the array must be resized. This will be zero if the
+     * row is currently stored in compressed form.
      */
     unsigned int available;
 
+    /**
+     * The compressed form of this row, or NULL if this row is currently
+     * stored uncompressed. While a row is compressed, its characters array
+     * is freed, and the row must be decompressed before its contents may be
+     * accessed.
+     */
+    unsigned char* compressed;
+
     /**
      * True if the current row has been wrapped to avoid going off the screen.
      * False otherwise.
@@ -95,10 +152,23 @@ struct guac_terminal_buffer {
 
     /**
      * The number of rows in the buffer. This is the total capacity
-     * of the buffer.
+     * of the buffer. This value is always a power of two, such that row
+     * indices can be normalized into the ring buffer with a bitmask rather
+     * than a division.
      */
     unsigned int available;
 
+    /**
+     * Bitmask which normalizes any row index into the bounds of the ring
+     * buffer. This is always one less than the available row capacity, which
+     * is a power of two. Unlike the modulo operator, masking produces the
+     * mathematically-correct ring index even when the unsigned arithmetic
+     * producing that index has wrapped around zero (as happens when
+     * addressing scrollback rows below the current top of a buffer that has
+     * cycled).
+     */
+    unsigned int mask;
+
 };
 
 guac_terminal_buffer* guac_terminal_buffer_alloc(int rows,
@@ -111,22 +181,30 @@ guac_terminal_buffer* guac_terminal_buffer_alloc(int rows,
     int i;
     guac_terminal_buffer_row* row;
 
+    /* Round the requested capacity up to the nearest power of two such that
+     * ring indices can be normalized with a simple bitmask */
+    unsigned int available = 1;
+    while (available < rows)
+        available <<= 1;
+
     /* Init scrollback data */
     buffer->default_character = *default_character;
-    buffer->available = rows;
+    buffer->available = available;
+    buffer->mask = available - 1;
     buffer->top = 0;
     buffer->length = 0;
     buffer->rows = guac_mem_alloc(sizeof(guac_terminal_buffer_row), buffer->available);
 
     /* Init scrollback rows */
     row = buffer->rows;
-    for (i=0; i<rows; i++) {
+    for (i=0; i<buffer->available; i++) {
 
         /* Allocate row  */
         row->available = GUAC_TERMINAL_BUFFER_ROW_MIN_SIZE;
         row->length = 0;
         row->wrapped_row = false;
         row->characters = guac_mem_alloc(sizeof(guac_terminal_char), row->available);
+        row->compressed = NULL;
 
         /* Next row */
         row++;
@@ -145,6 +223,7 @@ void guac_terminal_buffer_free(guac_terminal_buffer* buffer) {
     /* Free all rows */
     for (i=0; i<buffer->available; i++) {
         guac_mem_free(row->characters);
+        guac_mem_free(row->compressed);
         row++;
     }
 
@@ -159,9 +238,12 @@ void guac_terminal_buffer_reset(guac_terminal_buffer* buffer) {
     buffer->length = 0;
 }
 
+static void guac_terminal_buffer_row_decompress(guac_terminal_buffer_row* row);
+
 /**
  * Returns the row at the given location. The row returned is guaranteed to be at least the given
- * width.
+ * width. If the row is currently stored in compressed form, it is
+ * transparently decompressed before being returned.
  *
  * @param buffer
  *     The buffer to retrieve a row from.
@@ -179,9 +261,17 @@ static guac_terminal_buffer_row* guac_terminal_buffer_get_row(guac_terminal_buff
     if (abs(row) >= buffer->available)
         return NULL;
 
-    /* Normalize row index into a scrollback buffer index */
-    unsigned int index = (buffer->top + row) % buffer->available;
-    return &(buffer->rows[index]);
+    /* Normalize row index into a scrollback buffer index. As the buffer
+     * capacity is a power of two, masking here is exact even when the
+     * unsigned addition wraps around zero for negative (scrollback) row
+     * indices. */
+    unsigned int index = (buffer->top + row) & buffer->mask;
+    guac_terminal_buffer_row* buffer_row = &(buffer->rows[index]);
+
+    /* Restore contents of cold rows on access */
+    guac_terminal_buffer_row_decompress(buffer_row);
+
+    return buffer_row;
 
 }
 
@@ -210,6 +300,238 @@ static unsigned int guac_terminal_buffer_row_length(int value) {
 
 }
 
+/**
+ * Returns whether the two given attribute sets are identical in all respects.
+ *
+ * @param a
+ *     The first attribute set to compare.
+ *
+ * @param b
+ *     The second attribute set to compare.
+ *
+ * @return
+ *     true if the given attribute sets are identical, false otherwise.
+ */
+static bool guac_terminal_buffer_attributes_equal(
+        const guac_terminal_attributes* a, const guac_terminal_attributes* b) {
+
+    return a->bold        == b->bold
+        && a->half_bright == b->half_bright
+        && a->cursor      == b->cursor
+        && a->reverse     == b->reverse
+        && a->underscore  == b->underscore
+        && guac_terminal_colorcmp(&a->foreground, &b->foreground) == 0
+        && guac_terminal_colorcmp(&a->background, &b->background) == 0;
+
+}
+
+/**
+ * Returns whether the two given characters are identical in all respects,
+ * including attributes.
+ *
+ * @param a
+ *     The first character to compare.
+ *
+ * @param b
+ *     The second character to compare.
+ *
+ * @return
+ *     true if the given characters are identical, false otherwise.
+ */
+static bool guac_terminal_buffer_char_identical(const guac_terminal_char* a,
+        const guac_terminal_char* b) {
+
+    return a->value == b->value
+        && a->width == b->width
+        && guac_terminal_buffer_attributes_equal(&a->attributes, &b->attributes);
+
+}
+
+/**
+ * Appends the codepoint and width of the given character to the compressed
+ * form of a buffer row, returning the updated output position.
+ *
+ * @param out
+ *     The position within the compressed data at which the character should
+ *     be written.
+ *
+ * @param character
+ *     The character to write.
+ *
+ * @return
+ *     The position within the compressed data immediately following the
+ *     written character.
+ */
+static unsigned char* guac_terminal_buffer_pack_char(unsigned char* out,
+        const guac_terminal_char* character) {
+
+    memcpy(out, &character->value, sizeof(int));
+    out += sizeof(int);
+
+    *out = (unsigned char) character->width;
+    return out + 1;
+
+}
+
+/**
+ * Compresses the contents of the given row, freeing its characters array in
+ * favor of a compact series of runs. Runs of characters sharing the same
+ * attributes are stored as a single header followed by their codepoints,
+ * with repeated characters (such as the blank tails of most rows) collapsed
+ * into a single entry. If the compressed form would not actually be smaller
+ * than the memory it frees, the row is left uncompressed.
+ *
+ * @param row
+ *     The row to compress.
+ */
+static void guac_terminal_buffer_row_compress(guac_terminal_buffer_row* row) {
+
+    /* Nothing to do if already compressed or there is nothing to compress */
+    if (row->compressed != NULL || row->length == 0)
+        return;
+
+    /* In the worst case, every character requires its own run */
+    size_t max_size = guac_mem_ckd_mul_or_die(row->length,
+            sizeof(guac_terminal_buffer_run_header)
+            + GUAC_TERMINAL_BUFFER_PACKED_CHAR_SIZE);
+
+    unsigned char* data = guac_mem_alloc(max_size);
+    unsigned char* out = data;
+
+    unsigned int i = 0;
+    while (i < row->length) {
+
+        const guac_terminal_char* first = &(row->characters[i]);
+
+        /* Determine extent of run of identical characters */
+        unsigned int run_end = i + 1;
+        while (run_end < row->length
+                && run_end - i < GUAC_TERMINAL_BUFFER_MAX_RUN
+                && guac_terminal_buffer_char_identical(
+                    &(row->characters[run_end]), first))
+            run_end++;
+
+        guac_terminal_buffer_run_header header = {
+            .attributes = first->attributes,
+            .repeated = (run_end - i > 1)
+        };
+
+        /* Collapse identical characters into a single repeated entry */
+        if (header.repeated) {
+            header.count = run_end - i;
+            memcpy(out, &header, sizeof(header));
+            out += sizeof(header);
+            out = guac_terminal_buffer_pack_char(out, first);
+        }
+
+        /* Otherwise, gather distinct characters sharing the same attributes
+         * into a single literal run, stopping short of any upcoming pair of
+         * identical characters (which will begin a repeated run) */
+        else {
+
+            while (run_end < row->length
+                    && run_end - i < GUAC_TERMINAL_BUFFER_MAX_RUN
+                    && guac_terminal_buffer_attributes_equal(
+                        &(row->characters[run_end].attributes),
+                        &first->attributes)
+                    && !(run_end + 1 < row->length
+                        && guac_terminal_buffer_char_identical(
+                            &(row->characters[run_end]),
+                            &(row->characters[run_end + 1]))))
+                run_end++;
+
+            header.count = run_end - i;
+            memcpy(out, &header, sizeof(header));
+            out += sizeof(header);
+
+            for (unsigned int j = i; j < run_end; j++)
+                out = guac_terminal_buffer_pack_char(out, &(row->characters[j]));
+
+        }
+
+        i = run_end;
+
+    }
+
+    /* Leave row uncompressed if compression would not actually save memory */
+    size_t size = out - data;
+    if (size >= guac_mem_ckd_mul_or_die(sizeof(guac_terminal_char), row->available)) {
+        guac_mem_free(data);
+        return;
+    }
+
+    /* Replace characters array with compressed form */
+    row->compressed = guac_mem_realloc_or_die(data, size);
+    guac_mem_free(row->characters);
+    row->characters = NULL;
+    row->available = 0;
+
+}
+
+/**
+ * Restores the characters array of the given row from its compressed form,
+ * freeing the compressed data. If the given row is not currently compressed,
+ * this function has no effect.
+ *
+ * @param row
+ *     The row to decompress.
+ */
+static void guac_terminal_buffer_row_decompress(guac_terminal_buffer_row* row) {
+
+    /* Nothing to do if not actually compressed */
+    if (row->compressed == NULL)
+        return;
+
+    /* Restore characters array, leaving cells beyond the row length to be
+     * initialized if and when the row is expanded */
+    row->available = guac_terminal_buffer_row_length(row->length);
+    row->characters = guac_mem_alloc(sizeof(guac_terminal_char), row->available);
+
+    const unsigned char* in = row->compressed;
+
+    unsigned int i = 0;
+    while (i < row->length) {
+
+        guac_terminal_buffer_run_header header;
+        memcpy(&header, in, sizeof(header));
+        in += sizeof(header);
+
+        guac_terminal_char character = {
+            .attributes = header.attributes
+        };
+
+        /* Expand single repeated entry into individual characters */
+        if (header.repeated) {
+
+            memcpy(&character.value, in, sizeof(int));
+            in += sizeof(int);
+            character.width = *in++;
+
+            for (unsigned short j = 0; j < header.count; j++)
+                row->characters[i++] = character;
+
+        }
+
+        /* Unpack each character of literal runs individually */
+        else {
+            for (unsigned short j = 0; j < header.count; j++) {
+
+                memcpy(&character.value, in, sizeof(int));
+                in += sizeof(int);
+                character.width = *in++;
+
+                row->characters[i++] = character;
+
+            }
+        }
+
+    }
+
+    guac_mem_free(row->compressed);
+    row->compressed = NULL;
+
+}
+
 /**
  * Expands the amount of space allocated for the given row such that it
  * may contain at least the given number of characters, if possible. If the row
@@ -432,12 +754,25 @@ void guac_terminal_buffer_scroll_up(guac_terminal_buffer* buffer, int amount) {
     if (amount <= 0)
         return;
 
-    buffer->top = (buffer->top + amount) % buffer->available;
+    buffer->top = (buffer->top + amount) & buffer->mask;
 
     buffer->length += amount;
     if (buffer->length > buffer->available)
         buffer->length = buffer->available;
 
+    /* Compress rows which have just scrolled beyond the hot window, freeing
+     * the bulk of the memory used by cold scrollback */
+    for (int i = 0; i < amount; i++) {
+
+        unsigned int offset = GUAC_TERMINAL_BUFFER_HOT_ROWS + 1 + i;
+        if (offset >= buffer->available || offset > buffer->length)
+            break;
+
+        unsigned int index = (buffer->top - offset) & buffer->mask;
+        guac_terminal_buffer_row_compress(&(buffer->rows[index]));
+
+    }
+
 }
 
 void guac_terminal_buffer_scroll_down(guac_terminal_buffer* buffer, int amount) {
@@ -445,7 +780,7 @@ void guac_terminal_buffer_scroll_down(guac_terminal_buffer* buffer, int amount)
     if (amount <= 0)
         return;
 
-    buffer->top = (buffer->top - amount) % buffer->available;
+    buffer->top = (buffer->top - amount) & buffer->mask;
 
 }
 
@@ -24,6 +24,7 @@
 
 #include <stdbool.h>
 #include <unistd.h>
+#include <wchar.h>
 
 int guac_terminal_fit_to_range(int value, int min, int max) {
 
@@ -91,6 +92,26 @@ bool guac_terminal_has_glyph(int codepoint) {
         && codepoint != GUAC_CHAR_CONTINUATION;
 }
 
+int guac_terminal_wcwidth(int codepoint) {
+
+    /* The printable ASCII and Latin-1 ranges cover the overwhelming majority
+     * of terminal output (including all output of the non-Unicode character
+     * mappings) and are always one column wide, with no need to consult the
+     * current locale via wcwidth() */
+    if ((codepoint >= 0x20 && codepoint <= 0x7E)
+            || (codepoint >= 0xA0 && codepoint <= 0xFF))
+        return 1;
+
+    /* Calculate width of all other codepoints using wcwidth(), treating
+     * codepoints of indeterminate width as one column wide */
+    int width = wcwidth(codepoint);
+    if (width < 0)
+        width = 1;
+
+    return width;
+
+}
+
 int guac_terminal_write_all(int fd, const char* buffer, int size) {
 
     int remaining = size;
@@ -20,6 +20,7 @@
 #include "common/surface.h"
 #include "terminal/common.h"
 #include "terminal/display.h"
+#include "terminal/glyph-atlas.h"
 #include "terminal/palette.h"
 #include "terminal/terminal.h"
 #include "terminal/terminal-priv.h"
@@ -99,13 +100,65 @@ int __guac_terminal_set_colors(guac_terminal_display* display,
 }
 
 /**
- * Sends the given character to the terminal at the given row and column,
- * rendering the character immediately. This bypasses the guac_terminal_display
- * mechanism and is intended for flushing of updates only.
+ * Invalidates all entries within the glyph cache of the given display, freeing
+ * any cached renderings. This must be called whenever the font or character
+ * dimensions change, as cached renderings are valid only for the font and
+ * dimensions they were rendered with.
+ */
+static void __guac_terminal_display_clear_glyph_cache(
+        guac_terminal_display* display) {
+
+    for (int i = 0; i < GUAC_TERMINAL_GLYPH_CACHE_SIZE; i++) {
+
+        guac_terminal_glyph* glyph = &display->glyph_cache[i];
+
+        /* Free cached rendering, if any */
+        if (glyph->surface != NULL) {
+            cairo_surface_destroy(glyph->surface);
+            glyph->surface = NULL;
+        }
+
+    }
+
+}
+
+/**
+ * Marks the entire record of the last flushed frame as unknown, such that no
+ * future operation will be discarded as having no visible effect. This must be
+ * called whenever the on-screen appearance of characters may have changed for
+ * reasons other than the operations themselves, such as palette changes.
  */
-int __guac_terminal_set(guac_terminal_display* display, int row, int col, int codepoint) {
+static void __guac_terminal_display_forget_frame(
+        guac_terminal_display* display) {
+
+    if (display->last_frame != NULL)
+        memset(display->last_frame, 0, guac_mem_ckd_mul_or_die(display->width,
+                    display->height, sizeof(guac_terminal_char)));
 
-    int width;
+}
+
+/**
+ * Returns a rendering of the given character using the current display
+ * attributes (as set by __guac_terminal_set_colors()), rendering the
+ * character via Pango only if no identical rendering is already cached. The
+ * returned surface is owned by the glyph cache and must not be freed by the
+ * caller. It remains valid only until another glyph is rendered or the font
+ * changes.
+ *
+ * @param display
+ *     The display with respect to which the character should be rendered.
+ *
+ * @param codepoint
+ *     The Unicode codepoint of the character to render.
+ *
+ * @param width
+ *     The width of the character, in columns.
+ *
+ * @return
+ *     A surface containing the rendered character.
+ */
+static cairo_surface_t* __guac_terminal_render_glyph(
+        guac_terminal_display* display, int codepoint, int width) {
 
     int bytes;
     char utf8[4];
@@ -119,19 +172,22 @@ int __guac_terminal_set(guac_terminal_display* display, int row, int col, int co
     cairo_surface_t* surface;
     cairo_t* cairo;
     int surface_width, surface_height;
-   
+
     PangoLayout* layout;
     int layout_width, layout_height;
     int ideal_layout_width, ideal_layout_height;
 
-    /* Calculate width in columns */
-    width = wcwidth(codepoint);
-    if (width < 0)
-        width = 1;
+    /* Reuse cached rendering if the same glyph was recently rendered with the
+     * same colors (all other attributes are already folded into the effective
+     * colors by __guac_terminal_set_colors()) */
+    guac_terminal_glyph* glyph =
+        &display->glyph_cache[__guac_terminal_hash_codepoint(codepoint)];
 
-    /* Do nothing if glyph is empty */
-    if (width == 0)
-        return 0;
+    if (glyph->surface != NULL
+            && glyph->codepoint == codepoint
+            && guac_terminal_colorcmp(&glyph->foreground, color) == 0
+            && guac_terminal_colorcmp(&glyph->background, background) == 0)
+        return glyph->surface;
 
     /* Convert to UTF-8 */
     bytes = guac_terminal_encode_utf8(codepoint, utf8);
@@ -145,64 +201,208 @@ int __guac_terminal_set(guac_terminal_display* display, int row, int col, int co
     /* Prepare surface */
     surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24,
                                          surface_width, surface_height);
-    cairo = cairo_create(surface);
 
-    /* Fill background */
-    cairo_set_source_rgb(cairo,
-            background->red   / 255.0,
-            background->green / 255.0,
-            background->blue  / 255.0);
+    /* Reuse an identical rendering already rasterized by another terminal
+     * within this process family, if the shared atlas has one */
+    if (guac_terminal_glyph_atlas_get(display->glyph_atlas_font_hash,
+                codepoint, color, background,
+                cairo_image_surface_get_data(surface),
+                surface_width, surface_height,
+                cairo_image_surface_get_stride(surface)) == 0) {
+        cairo_surface_mark_dirty(surface);
+    }
 
-    cairo_rectangle(cairo, 0, 0, surface_width, surface_height); 
-    cairo_fill(cairo);
+    /* Otherwise rasterize the glyph via Pango, publishing the result for
+     * reuse by other terminals */
+    else {
 
-    /* Get layout */
-    layout = pango_cairo_create_layout(cairo);
-    pango_layout_set_font_description(layout, display->font_desc);
-    pango_layout_set_text(layout, utf8, bytes);
-    pango_layout_set_alignment(layout, PANGO_ALIGN_CENTER);
+        cairo = cairo_create(surface);
 
-    pango_layout_get_size(layout, &layout_width, &layout_height);
+        /* Fill background */
+        cairo_set_source_rgb(cairo,
+                background->red   / 255.0,
+                background->green / 255.0,
+                background->blue  / 255.0);
 
-    /* If layout bigger than available space, scale it back */
-    if (layout_width > ideal_layout_width || layout_height > ideal_layout_height) {
+        cairo_rectangle(cairo, 0, 0, surface_width, surface_height);
+        cairo_fill(cairo);
 
-        double scale = fmin(ideal_layout_width  / (double) layout_width,
-                            ideal_layout_height / (double) layout_height);
+        /* Reuse the persistent layout, which retains the fallback fonts
+         * already resolved for previously-rendered glyphs */
+        layout = display->glyph_layout;
+        pango_layout_set_text(layout, utf8, bytes);
 
-        cairo_scale(cairo, scale, scale);
+        /* Reset any constraints applied by a previous scaled rendering */
+        pango_layout_set_width(layout, -1);
+        pango_layout_set_height(layout, -1);
 
-        /* Update layout to reflect scaled surface */
-        pango_layout_set_width(layout, ideal_layout_width / scale);
-        pango_layout_set_height(layout, ideal_layout_height / scale);
         pango_cairo_update_layout(cairo, layout);
 
+        pango_layout_get_size(layout, &layout_width, &layout_height);
+
+        /* If layout bigger than available space, scale it back */
+        if (layout_width > ideal_layout_width || layout_height > ideal_layout_height) {
+
+            double scale = fmin(ideal_layout_width  / (double) layout_width,
+                                ideal_layout_height / (double) layout_height);
+
+            cairo_scale(cairo, scale, scale);
+
+            /* Update layout to reflect scaled surface */
+            pango_layout_set_width(layout, ideal_layout_width / scale);
+            pango_layout_set_height(layout, ideal_layout_height / scale);
+            pango_cairo_update_layout(cairo, layout);
+
+        }
+
+        /* Draw */
+        cairo_set_source_rgb(cairo,
+                color->red   / 255.0,
+                color->green / 255.0,
+                color->blue  / 255.0);
+
+        cairo_move_to(cairo, 0.0, 0.0);
+        pango_cairo_show_layout(cairo, layout);
+
+        cairo_destroy(cairo);
+
+        /* Publish the rasterized glyph for reuse by other terminals in this
+         * process family */
+        cairo_surface_flush(surface);
+        guac_terminal_glyph_atlas_put(display->glyph_atlas_font_hash,
+                codepoint, color, background,
+                cairo_image_surface_get_data(surface),
+                surface_width, surface_height,
+                cairo_image_surface_get_stride(surface));
+
     }
 
-    /* Draw */
-    cairo_set_source_rgb(cairo,
-            color->red   / 255.0,
-            color->green / 255.0,
-            color->blue  / 255.0);
+    /* Cache the rendered surface for future occurrences of the same glyph,
+     * replacing any previous occupant of the same cache entry (the layout is
+     * persistent and owned by the display) */
 
-    cairo_move_to(cairo, 0.0, 0.0);
-    pango_cairo_show_layout(cairo, layout);
+    if (glyph->surface != NULL)
+        cairo_surface_destroy(glyph->surface);
 
-    /* Draw */
-    guac_common_surface_draw(display->display_surface,
-        display->char_width * col,
-        display->char_height * row,
-        surface);
+    glyph->surface = surface;
+    glyph->codepoint = codepoint;
+    glyph->foreground = *color;
+    glyph->background = *background;
 
-    /* Free all */
-    g_object_unref(layout);
-    cairo_destroy(cairo);
-    cairo_surface_destroy(surface);
+    return surface;
+
+}
+
+/**
+ * Sends the given character to the terminal at the given row and column,
+ * rendering the character immediately. This bypasses the guac_terminal_display
+ * mechanism and is intended for flushing of updates only. If local is
+ * non-zero, only the server-side copy of the display surface is updated (the
+ * character having already been sent as text via the cells instruction).
+ */
+int __guac_terminal_set(guac_terminal_display* display, int row, int col,
+        int codepoint, int local) {
+
+    /* Calculate width in columns */
+    int width = guac_terminal_wcwidth(codepoint);
+
+    /* Do nothing if glyph is empty */
+    if (width == 0)
+        return 0;
+
+    /* Draw rendered glyph at given location */
+    cairo_surface_t* glyph =
+        __guac_terminal_render_glyph(display, codepoint, width);
+
+    if (local)
+        guac_common_surface_draw_local(display->display_surface,
+            display->char_width * col,
+            display->char_height * row,
+            glyph);
+    else
+        guac_common_surface_draw(display->display_surface,
+            display->char_width * col,
+            display->char_height * row,
+            glyph);
 
     return 0;
 
 }
 
+/**
+ * Renders a run of single-column characters sharing the same attributes,
+ * sending the result to the terminal at the given row and column. The
+ * rendering of the entire run is assembled within a single surface and drawn
+ * in one operation, rather than drawn (and tracked as a pending update)
+ * per-character. As with __guac_terminal_set(), the display attributes must
+ * have already been set via __guac_terminal_set_colors().
+ *
+ * @param display
+ *     The display receiving the characters.
+ *
+ * @param row
+ *     The row at which the run begins.
+ *
+ * @param col
+ *     The column at which the run begins.
+ *
+ * @param operations
+ *     The pending operations containing the characters of the run, one
+ *     operation per column.
+ *
+ * @param length
+ *     The number of characters within the run.
+ *
+ * @param local
+ *     Non-zero if only the server-side copy of the display surface should be
+ *     updated (the run having already been sent as text via the cells
+ *     instruction), zero otherwise.
+ */
+static void __guac_terminal_set_run(guac_terminal_display* display, int row,
+        int col, guac_terminal_operation* operations, int length, int local) {
+
+    /* Assemble rendering of entire run within a single surface */
+    cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24,
+            length * display->char_width, display->char_height);
+    cairo_t* cairo = cairo_create(surface);
+
+    for (int i = 0; i < length; i++) {
+
+        int codepoint = operations[i].character.value;
+
+        /* Use space if no glyph */
+        if (!guac_terminal_has_glyph(codepoint))
+            codepoint = ' ';
+
+        /* Copy rendered glyph into position within run */
+        cairo_set_source_surface(cairo,
+                __guac_terminal_render_glyph(display, codepoint, 1),
+                i * display->char_width, 0);
+
+        cairo_rectangle(cairo, i * display->char_width, 0,
+                display->char_width, display->char_height);
+
+        cairo_fill(cairo);
+
+    }
+
+    /* Draw entire run in one operation */
+    if (local)
+        guac_common_surface_draw_local(display->display_surface,
+            display->char_width * col,
+            display->char_height * row,
+            surface);
+    else
+        guac_common_surface_draw(display->display_surface,
+            display->char_width * col,
+            display->char_height * row,
+            surface);
+
+    cairo_destroy(cairo);
+    cairo_surface_destroy(surface);
+
+}
+
 /**
  * Calculate the size of margins around the terminal based on DPI.
  *
@@ -229,6 +429,15 @@ guac_terminal_display* guac_terminal_display_alloc(guac_client* client,
     display->font_desc = NULL;
     display->char_width = 0;
     display->char_height = 0;
+    display->glyph_atlas_font_hash = 0;
+
+    /* Characters are sent as image data until the supported mimetypes of
+     * all connected users are known */
+    display->cell_runs_enabled = false;
+    display->cell_run_length = 0;
+
+    /* Initially no cached glyphs */
+    memset(display->glyph_cache, 0, sizeof(display->glyph_cache));
 
     /* Create default surface */
     display->display_layer = guac_client_alloc_layer(client);
@@ -258,9 +467,16 @@ guac_terminal_display* guac_terminal_display_alloc(guac_client* client,
     display->width = 0;
     display->height = 0;
     display->operations = NULL;
+    display->last_frame = NULL;
 
     /* Initially nothing selected */
     display->text_selected = false;
+    display->pending_select_rects = 0;
+    display->pending_select_clear = false;
+
+    /* Pango context and layout are created when the font is first set */
+    display->font_context = NULL;
+    display->glyph_layout = NULL;
 
     /* Attempt to load font */
     if (guac_terminal_display_set_font(display, font_name, font_size, dpi)) {
@@ -276,15 +492,27 @@ guac_terminal_display* guac_terminal_display_alloc(guac_client* client,
 
 void guac_terminal_display_free(guac_terminal_display* display) {
 
-    /* Free font description */
+    /* Free font description and associated Pango context and layout */
     pango_font_description_free(display->font_desc);
 
+    if (display->glyph_layout != NULL)
+        g_object_unref(display->glyph_layout);
+
+    if (display->font_context != NULL)
+        g_object_unref(display->font_context);
+
+    /* Free cached glyph renderings */
+    __guac_terminal_display_clear_glyph_cache(display);
+
     /* Free default palette. */
     guac_mem_free(display->default_palette);
 
     /* Free operations buffers */
     guac_mem_free(display->operations);
 
+    /* Free record of last flushed frame */
+    guac_mem_free(display->last_frame);
+
     /* Free display */
     guac_mem_free(display);
 
@@ -292,6 +520,9 @@ void guac_terminal_display_free(guac_terminal_display* display) {
 
 void guac_terminal_display_reset_palette(guac_terminal_display* display) {
 
+    /* Characters rendered with the old palette may no longer match */
+    __guac_terminal_display_forget_frame(display);
+
     /* Reinitialize palette with default values */
     if (display->default_palette) {
         memcpy(display->palette, *display->default_palette,
@@ -311,6 +542,9 @@ int guac_terminal_display_assign_color(guac_terminal_display* display,
     if (index < 0 || index > 255)
         return 1;
 
+    /* Characters rendered with the old palette entry may no longer match */
+    __guac_terminal_display_forget_frame(display);
+
     /* Copy color components */
     display->palette[index].red   = color->red;
     display->palette[index].green = color->green;
@@ -523,6 +757,13 @@ void guac_terminal_display_resize(guac_terminal_display* display, int width, int
     display->operations = guac_mem_alloc(width, height,
             sizeof(guac_terminal_operation));
 
+    /* Replace record of last flushed frame, with all contents unknown */
+    if (display->last_frame != NULL)
+        guac_mem_free(display->last_frame);
+
+    display->last_frame = guac_mem_zalloc(width, height,
+            sizeof(guac_terminal_char));
+
     /* Init each operation buffer row */
     guac_terminal_operation* current = display->operations;
     for (int y = 0; y < height; y++) {
@@ -822,6 +1063,137 @@ void __guac_terminal_display_flush_clear(guac_terminal_display* display) {
 
 }
 
+/**
+ * Returns whether the two given attribute sets are identical in all respects.
+ */
+static bool __guac_terminal_attributes_equal(const guac_terminal_attributes* a,
+        const guac_terminal_attributes* b) {
+
+    return a->bold        == b->bold
+        && a->half_bright == b->half_bright
+        && a->cursor      == b->cursor
+        && a->reverse     == b->reverse
+        && a->underscore  == b->underscore
+        && guac_terminal_colorcmp(&a->foreground, &b->foreground) == 0
+        && guac_terminal_colorcmp(&a->background, &b->background) == 0;
+
+}
+
+/**
+ * The maximum number of characters which may be described by a single packed
+ * cell run record, given the size of the record header and the capacity of
+ * the cell run buffer.
+ */
+#define GUAC_TERMINAL_CELL_RUN_MAX_CHARS \
+    ((GUAC_TERMINAL_CELL_RUN_MAX_BYTES - 12) / 3)
+
+/**
+ * Sends any packed cell run records currently buffered within the given
+ * display as a single cells instruction, emptying the buffer. If no records
+ * are buffered, this function has no effect.
+ *
+ * @param display
+ *     The display whose buffered cell run records should be sent.
+ */
+static void __guac_terminal_flush_cell_runs(guac_terminal_display* display) {
+
+    if (display->cell_run_length == 0)
+        return;
+
+    guac_protocol_send_cells(display->client->socket, display->display_layer,
+            0, 0, display->char_width, display->char_height,
+            display->cell_run_data, display->cell_run_length);
+
+    display->cell_run_length = 0;
+
+}
+
+/**
+ * Appends packed cell run records describing the given run of single-column
+ * characters to the cell run buffer of the given display, first sending any
+ * buffered records as necessary to make space. The colors of the run must
+ * have already been resolved via __guac_terminal_set_colors(). Runs longer
+ * than the capacity of a single record are split across multiple records.
+ *
+ * @param display
+ *     The display whose cell run buffer should receive the run.
+ *
+ * @param row
+ *     The row at which the run begins.
+ *
+ * @param col
+ *     The column at which the run begins.
+ *
+ * @param operations
+ *     The pending operations containing the characters of the run, one
+ *     operation per column.
+ *
+ * @param length
+ *     The number of characters within the run.
+ */
+static void __guac_terminal_append_cell_run(guac_terminal_display* display,
+        int row, int col, guac_terminal_operation* operations, int length) {
+
+    const guac_terminal_color* foreground = &display->glyph_foreground;
+    const guac_terminal_color* background = &display->glyph_background;
+
+    while (length > 0) {
+
+        int record_chars = length;
+        if (record_chars > GUAC_TERMINAL_CELL_RUN_MAX_CHARS)
+            record_chars = GUAC_TERMINAL_CELL_RUN_MAX_CHARS;
+
+        /* Send previously-buffered records if the current record would not
+         * fit */
+        int record_length = 12 + record_chars * 3;
+        if (display->cell_run_length + record_length
+                > GUAC_TERMINAL_CELL_RUN_MAX_BYTES)
+            __guac_terminal_flush_cell_runs(display);
+
+        unsigned char* record =
+            display->cell_run_data + display->cell_run_length;
+
+        /* Write record header (column, row, character count, and colors, as
+         * documented for guac_protocol_send_cells()) */
+        *(record++) = (col >> 8) & 0xFF;
+        *(record++) = col & 0xFF;
+        *(record++) = (row >> 8) & 0xFF;
+        *(record++) = row & 0xFF;
+        *(record++) = (record_chars >> 8) & 0xFF;
+        *(record++) = record_chars & 0xFF;
+        *(record++) = foreground->red;
+        *(record++) = foreground->green;
+        *(record++) = foreground->blue;
+        *(record++) = background->red;
+        *(record++) = background->green;
+        *(record++) = background->blue;
+
+        /* Write the codepoint of each character within the run */
+        for (int i = 0; i < record_chars; i++) {
+
+            int codepoint = operations[i].character.value;
+
+            /* Use space if no glyph, mirroring the rasterized rendering */
+            if (!guac_terminal_has_glyph(codepoint))
+                codepoint = ' ';
+
+            *(record++) = (codepoint >> 16) & 0xFF;
+            *(record++) = (codepoint >> 8) & 0xFF;
+            *(record++) = codepoint & 0xFF;
+
+        }
+
+        display->cell_run_length += record_length;
+
+        /* Continue with the remainder of the run, if any */
+        col += record_chars;
+        operations += record_chars;
+        length -= record_chars;
+
+    }
+
+}
+
 void __guac_terminal_display_flush_set(guac_terminal_display* display) {
 
     guac_terminal_operation* current = display->operations;
@@ -829,10 +1201,47 @@ void __guac_terminal_display_flush_set(guac_terminal_display* display) {
 
     /* For each operation */
     for (row=0; row<display->height; row++) {
-        for (col=0; col<display->width; col++) {
+        for (col=0; col<display->width;) {
+
+            /* Skip cells with nothing to draw */
+            if (current->type != GUAC_CHAR_SET) {
+                current++;
+                col++;
+                continue;
+            }
+
+            /* Determine length of run of single-column characters sharing
+             * the same attributes, which can be rendered and sent in a
+             * single pass (multi-column characters are sent individually,
+             * as are characters at which the attributes change) */
+            int run = 1;
+            if (current->character.width == 1) {
+                while (col + run < display->width
+                        && current[run].type == GUAC_CHAR_SET
+                        && current[run].character.width == 1
+                        && __guac_terminal_attributes_equal(
+                            &(current[run].character.attributes),
+                            &(current->character.attributes)))
+                    run++;
+            }
 
-            /* Perform given operation */
-            if (current->type == GUAC_CHAR_SET) {
+            /* Set attributes once for the entire run */
+            __guac_terminal_set_colors(display,
+                    &(current->character.attributes));
+
+            /* Send single-column runs as text rather than pixels if all
+             * connected users support the cells instruction. The run is
+             * still rasterized into the server-side copy of the surface,
+             * which remains authoritative for users which join later */
+            int local = 0;
+            if (display->cell_runs_enabled && current->character.width == 1) {
+                __guac_terminal_append_cell_run(display, row, col, current,
+                        run);
+                local = 1;
+            }
+
+            /* Send single characters directly */
+            if (run == 1) {
 
                 int codepoint = current->character.value;
 
@@ -840,33 +1249,146 @@ void __guac_terminal_display_flush_set(guac_terminal_display* display) {
                 if (!guac_terminal_has_glyph(codepoint))
                     codepoint = ' ';
 
-                /* Set attributes */
-                __guac_terminal_set_colors(display,
-                        &(current->character.attributes));
-
                 /* Send character */
-                __guac_terminal_set(display, row, col, codepoint);
-
-                /* Mark operation as handled */
-                current->type = GUAC_CHAR_NOP;
+                __guac_terminal_set(display, row, col, codepoint, local);
 
             }
 
+            /* Send longer runs as a single operation */
+            else
+                __guac_terminal_set_run(display, row, col, current, run,
+                        local);
+
+            /* Mark operations as handled */
+            for (int i = 0; i < run; i++)
+                current[i].type = GUAC_CHAR_NOP;
+
             /* Next operation */
+            current += run;
+            col += run;
+
+        }
+    }
+
+}
+
+/**
+ * Returns whether the two given characters would render identically, taking
+ * all attributes into account. Characters having a width of zero represent
+ * unknown contents and never compare equal.
+ */
+static bool __guac_terminal_char_equal(const guac_terminal_char* a,
+        const guac_terminal_char* b) {
+
+    return a->width >= 1
+        && a->value == b->value
+        && a->width == b->width
+        && __guac_terminal_attributes_equal(&a->attributes, &b->attributes);
+
+}
+
+/**
+ * Discards all pending operations which would have no visible effect, as the
+ * characters they would draw are identical to the characters drawn at the
+ * same locations by the last flush. The record of the last flushed frame is
+ * simultaneously updated to reflect the contents that the remaining
+ * operations will produce. Applications which repaint the entire screen to
+ * change only a small portion (as full-screen terminal applications commonly
+ * do) are thus reduced to redraws of the portions that actually changed.
+ */
+static void __guac_terminal_display_cull_unchanged(
+        guac_terminal_display* display) {
+
+    const guac_terminal_char unknown = { .value = 0, .width = 0 };
+
+    if (display->last_frame == NULL)
+        return;
+
+    /* The previous frame is needed as-is while copy operations remain
+     * unresolved, so the new frame is assembled separately */
+    guac_terminal_char* next_frame = guac_mem_alloc(display->width,
+            display->height, sizeof(guac_terminal_char));
+
+    guac_terminal_operation* current = display->operations;
+    guac_terminal_char* rendered = display->last_frame;
+    guac_terminal_char* next = next_frame;
+
+    /* For each operation */
+    for (int row = 0; row < display->height; row++) {
+
+        /* Number of remaining cells covered by a preceding multi-column
+         * character, the contents of which cannot be known from the
+         * operations alone */
+        int continuation = 0;
+
+        for (int col = 0; col < display->width; col++) {
+
+            switch (current->type) {
+
+                /* Copies pull their contents from the previous frame */
+                case GUAC_CHAR_COPY:
+                    *next = display->last_frame[guac_mem_ckd_add_or_die(
+                            guac_mem_ckd_mul_or_die(current->row, display->width),
+                            current->column)];
+                    break;
+
+                /* Sets with no visible effect are discarded entirely */
+                case GUAC_CHAR_SET:
+                    *next = current->character;
+                    if (__guac_terminal_char_equal(&current->character, rendered))
+                        current->type = GUAC_CHAR_NOP;
+                    else if (current->character.width > 1)
+                        continuation = current->character.width - 1;
+                    break;
+
+                /* Cells not being modified retain their prior contents,
+                 * except where those contents are obscured by a wider
+                 * character drawn to their left */
+                case GUAC_CHAR_NOP:
+                default:
+                    if (continuation > 0)
+                        *next = unknown;
+                    else
+                        *next = *rendered;
+                    break;
+
+            }
+
+            if (continuation > 0)
+                continuation--;
+
             current++;
+            rendered++;
+            next++;
 
         }
+
     }
 
+    /* The assembled frame is now the baseline for the next flush */
+    guac_mem_free(display->last_frame);
+    display->last_frame = next_frame;
+
 }
 
 void guac_terminal_display_flush(guac_terminal_display* display) {
 
+    /* Re-evaluate whether characters may be sent as text (every connected
+     * user must have declared support for the cells instruction) */
+    display->cell_runs_enabled =
+        guac_client_supports_cell_runs(display->client);
+
+    /* Skip operations that would not actually change anything */
+    __guac_terminal_display_cull_unchanged(display);
+
     /* Flush operations, copies first, then clears, then sets. */
     __guac_terminal_display_flush_copy(display);
     __guac_terminal_display_flush_clear(display);
     __guac_terminal_display_flush_set(display);
 
+    /* Send any cell runs which remain buffered */
+    __guac_terminal_flush_cell_runs(display);
+
     /* Flush surface */
     guac_common_surface_flush(display->display_surface);
 
@@ -893,12 +1415,41 @@ void guac_terminal_display_dup(
 
 }
 
+/**
+ * Records a rectangle of the pending selection highlight within the given
+ * display, to be drawn when guac_terminal_display_commit_select() is next
+ * invoked. All coordinates and dimensions are in pixels.
+ *
+ * @param display
+ *     The guac_terminal_display whose pending selection highlight should
+ *     receive the given rectangle.
+ *
+ * @param x
+ *     The X-coordinate of the upper-left corner of the rectangle.
+ *
+ * @param y
+ *     The Y-coordinate of the upper-left corner of the rectangle.
+ *
+ * @param width
+ *     The width of the rectangle.
+ *
+ * @param height
+ *     The height of the rectangle.
+ */
+static void guac_terminal_display_add_select_rect(
+        guac_terminal_display* display, int x, int y, int width, int height) {
+
+    int* rect = display->pending_select_rect[display->pending_select_rects++];
+    rect[0] = x;
+    rect[1] = y;
+    rect[2] = width;
+    rect[3] = height;
+
+}
+
 void guac_terminal_display_select(guac_terminal_display* display,
         int start_row, int start_col, int end_row, int end_col) {
 
-    guac_socket* socket = display->client->socket;
-    guac_layer* select_layer = display->select_layer;
-
     /* Do nothing if selection is unchanged */
     if (display->text_selected
             && display->selection_start_row    == start_row
@@ -915,6 +1466,9 @@ void guac_terminal_display_select(guac_terminal_display* display,
     display->selection_end_row = end_row;
     display->selection_end_column = end_col;
 
+    /* Any previously-recorded rectangles are superseded */
+    display->pending_select_rects = 0;
+
     /* If single row, just need one rectangle */
     if (start_row == end_row) {
 
@@ -926,7 +1480,7 @@ void guac_terminal_display_select(guac_terminal_display* display,
         }
 
         /* Select characters between columns */
-        guac_protocol_send_rect(socket, select_layer,
+        guac_terminal_display_add_select_rect(display,
 
                 start_col * display->char_width,
                 start_row * display->char_height,
@@ -955,7 +1509,7 @@ void guac_terminal_display_select(guac_terminal_display* display,
         }
 
         /* First row */
-        guac_protocol_send_rect(socket, select_layer,
+        guac_terminal_display_add_select_rect(display,
 
                 start_col * display->char_width,
                 start_row * display->char_height,
@@ -964,7 +1518,7 @@ void guac_terminal_display_select(guac_terminal_display* display,
                 display->char_height);
 
         /* Middle */
-        guac_protocol_send_rect(socket, select_layer,
+        guac_terminal_display_add_select_rect(display,
 
                 0,
                 (start_row + 1) * display->char_height,
@@ -973,7 +1527,7 @@ void guac_terminal_display_select(guac_terminal_display* display,
                 (end_row - start_row - 1) * display->char_height);
 
         /* Last row */
-        guac_protocol_send_rect(socket, select_layer,
+        guac_terminal_display_add_select_rect(display,
 
                 0,
                 end_row * display->char_height,
@@ -983,10 +1537,6 @@ void guac_terminal_display_select(guac_terminal_display* display,
 
     }
 
-    /* Draw new selection, erasing old */
-    guac_protocol_send_cfill(socket, GUAC_COMP_SRC, select_layer,
-            0x00, 0x80, 0xFF, 0x60);
-
 }
 
 void guac_terminal_display_clear_select(guac_terminal_display* display) {
@@ -995,15 +1545,46 @@ void guac_terminal_display_clear_select(guac_terminal_display* display) {
     if (!display->text_selected)
         return;
 
+    /* Any previously-recorded rectangles are superseded by the clear */
+    display->pending_select_rects = 0;
+    display->pending_select_clear = true;
+
+    /* Text is no longer selected */
+    display->text_selected = false;
+
+}
+
+void guac_terminal_display_commit_select(guac_terminal_display* display) {
+
     guac_socket* socket = display->client->socket;
     guac_layer* select_layer = display->select_layer;
 
-    guac_protocol_send_rect(socket, select_layer, 0, 0, 1, 1);
-    guac_protocol_send_cfill(socket, GUAC_COMP_SRC, select_layer,
-            0x00, 0x00, 0x00, 0x00);
+    /* Clear the selection layer if the highlight was removed */
+    if (display->pending_select_clear) {
 
-    /* Text is no longer selected */
-    display->text_selected = false;
+        guac_protocol_send_rect(socket, select_layer, 0, 0, 1, 1);
+        guac_protocol_send_cfill(socket, GUAC_COMP_SRC, select_layer,
+                0x00, 0x00, 0x00, 0x00);
+
+        display->pending_select_clear = false;
+
+    }
+
+    /* Draw any pending selection rectangles, erasing the old highlight */
+    if (display->pending_select_rects > 0) {
+
+        for (int i = 0; i < display->pending_select_rects; i++) {
+            int* rect = display->pending_select_rect[i];
+            guac_protocol_send_rect(socket, select_layer,
+                    rect[0], rect[1], rect[2], rect[3]);
+        }
+
+        guac_protocol_send_cfill(socket, GUAC_COMP_SRC, select_layer,
+                0x00, 0x80, 0xFF, 0x60);
+
+        display->pending_select_rects = 0;
+
+    }
 
 }
 
@@ -1070,6 +1651,31 @@ int guac_terminal_display_set_font(guac_terminal_display* display,
     display->font_desc = font_desc;
     pango_font_description_free(old_font_desc);
 
+    /* Glyphs may be shared with other terminals having identical font state */
+    display->glyph_atlas_font_hash = guac_terminal_glyph_atlas_font_hash(
+            font_desc, display->char_width, display->char_height);
+
+    /* Create reusable layout for the new font, retaining the context through
+     * which the font was resolved. Both persist until the font next changes,
+     * such that fallback fonts resolved for glyphs outside the primary font's
+     * coverage (CJK, emoji, etc.) are cached within the context rather than
+     * re-resolved for each rendered glyph. */
+    PangoLayout* layout = pango_layout_new(context);
+    pango_layout_set_font_description(layout, font_desc);
+    pango_layout_set_alignment(layout, PANGO_ALIGN_CENTER);
+
+    if (display->glyph_layout != NULL)
+        g_object_unref(display->glyph_layout);
+
+    if (display->font_context != NULL)
+        g_object_unref(display->font_context);
+
+    display->font_context = context;
+    display->glyph_layout = layout;
+
+    /* Glyphs rendered with the old font are no longer valid */
+    __guac_terminal_display_clear_glyph_cache(display);
+
     /* Recalculate dimensions which will fit within current surface */
     int new_width = pixel_width / display->char_width;
     int new_height = pixel_height / display->char_height;
@@ -0,0 +1,301 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "terminal/glyph-atlas.h"
+#include "terminal/palette.h"
+
+#include <pango/pangocairo.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/**
+ * The metadata of a single entry within the shared glyph atlas. The pixel
+ * data of each entry is stored separately, within the data member of
+ * guac_terminal_glyph_atlas.
+ */
+typedef struct guac_terminal_glyph_atlas_entry {
+
+    /**
+     * Sequence number protecting this entry. A value of zero indicates the
+     * entry has never been written, an odd value indicates a write is in
+     * progress (or was abandoned by a process that died mid-write), and any
+     * other even value indicates the entry is valid. Writers advance the
+     * sequence to an odd value before rewriting an entry and to the following
+     * even value once the rewrite is complete, allowing readers to detect
+     * concurrent rewrites by comparing the sequence before and after reading.
+     */
+    unsigned int sequence;
+
+    /**
+     * The font hash that this glyph was rasterized with, as returned by
+     * guac_terminal_glyph_atlas_font_hash().
+     */
+    uint64_t font_hash;
+
+    /**
+     * The Unicode codepoint of this glyph.
+     */
+    int codepoint;
+
+    /**
+     * The foreground color that this glyph was rasterized with.
+     */
+    guac_terminal_color foreground;
+
+    /**
+     * The background color that this glyph was rasterized with.
+     */
+    guac_terminal_color background;
+
+    /**
+     * The width of the rasterized glyph, in pixels.
+     */
+    int width;
+
+    /**
+     * The height of the rasterized glyph, in pixels.
+     */
+    int height;
+
+    /**
+     * The number of bytes in each row of the rasterized glyph.
+     */
+    int stride;
+
+} guac_terminal_glyph_atlas_entry;
+
+/**
+ * The shared glyph atlas, as mapped into every process within a guacd process
+ * family.
+ */
+typedef struct guac_terminal_glyph_atlas {
+
+    /**
+     * Lock serializing all writes to the atlas across the entire process
+     * family. The lock is robust: if a process dies while publishing a glyph,
+     * the next writer recovers the lock, and the half-written entry is left
+     * with an odd sequence number (ignored by all readers) until rewritten.
+     */
+    pthread_mutex_t writer_lock;
+
+    /**
+     * The metadata of all atlas entries, indexed by glyph hash.
+     */
+    guac_terminal_glyph_atlas_entry entries[GUAC_TERMINAL_GLYPH_ATLAS_SIZE];
+
+    /**
+     * The pixel data of all atlas entries, indexed by glyph hash.
+     */
+    unsigned char data[GUAC_TERMINAL_GLYPH_ATLAS_SIZE][GUAC_TERMINAL_GLYPH_ATLAS_SLOT_BYTES];
+
+} guac_terminal_glyph_atlas;
+
+/**
+ * The mapped shared glyph atlas, or NULL if the atlas could not be mapped (in
+ * which case all atlas operations are no-ops and each terminal simply
+ * rasterizes its own glyphs).
+ */
+static guac_terminal_glyph_atlas* guac_terminal_atlas = NULL;
+
+/**
+ * Maps the shared glyph atlas segment. This constructor runs when the library
+ * is first loaded, which (as guacd preloads protocol plugins) occurs within
+ * the main guacd process prior to forking any connection processes. The
+ * anonymous shared mapping established here is thus inherited by every
+ * process in the family. If the library is instead loaded after forking, the
+ * atlas degrades to a per-process cache, which is harmless.
+ */
+__attribute__((constructor))
+static void guac_terminal_glyph_atlas_map() {
+
+    /* Map shared, zero-filled atlas segment (pages are allocated only as
+     * glyphs are actually published) */
+    guac_terminal_glyph_atlas* atlas = mmap(NULL,
+            sizeof(guac_terminal_glyph_atlas), PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    /* Leave atlas unused if it cannot be mapped */
+    if (atlas == MAP_FAILED)
+        return;
+
+    /* The writer lock must be usable from any process in the family, and
+     * must be recoverable if a process dies while holding it */
+    pthread_mutexattr_t lock_attributes;
+    pthread_mutexattr_init(&lock_attributes);
+    pthread_mutexattr_setpshared(&lock_attributes, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&lock_attributes, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&atlas->writer_lock, &lock_attributes);
+    pthread_mutexattr_destroy(&lock_attributes);
+
+    guac_terminal_atlas = atlas;
+
+}
+
+/**
+ * Returns the index of the atlas entry that the given glyph maps onto.
+ *
+ * @param font_hash
+ *     The font hash that the glyph was (or would be) rasterized with.
+ *
+ * @param codepoint
+ *     The Unicode codepoint of the glyph.
+ *
+ * @param foreground
+ *     The foreground color of the glyph.
+ *
+ * @param background
+ *     The background color of the glyph.
+ *
+ * @return
+ *     The index of the atlas entry that the given glyph maps onto.
+ */
+static unsigned int guac_terminal_glyph_atlas_index(uint64_t font_hash,
+        int codepoint, const guac_terminal_color* foreground,
+        const guac_terminal_color* background) {
+
+    uint64_t hash = font_hash;
+    hash = (hash ^ (uint64_t) codepoint) * UINT64_C(0x100000001B3);
+    hash = (hash ^ ((uint64_t) foreground->red << 16
+                  | (uint64_t) foreground->green << 8
+                  | (uint64_t) foreground->blue)) * UINT64_C(0x100000001B3);
+    hash = (hash ^ ((uint64_t) background->red << 16
+                  | (uint64_t) background->green << 8
+                  | (uint64_t) background->blue)) * UINT64_C(0x100000001B3);
+
+    return (unsigned int) (hash % GUAC_TERMINAL_GLYPH_ATLAS_SIZE);
+
+}
+
+uint64_t guac_terminal_glyph_atlas_font_hash(PangoFontDescription* font_desc,
+        int char_width, int char_height) {
+
+    uint64_t hash = pango_font_description_hash(font_desc);
+    hash = (hash ^ (uint64_t) char_width)  * UINT64_C(0x100000001B3);
+    hash = (hash ^ (uint64_t) char_height) * UINT64_C(0x100000001B3);
+    return hash;
+
+}
+
+int guac_terminal_glyph_atlas_get(uint64_t font_hash, int codepoint,
+        const guac_terminal_color* foreground,
+        const guac_terminal_color* background,
+        unsigned char* data, int width, int height, int stride) {
+
+    /* Rasterize locally if the atlas is unavailable */
+    guac_terminal_glyph_atlas* atlas = guac_terminal_atlas;
+    if (atlas == NULL)
+        return 1;
+
+    /* Rasterize locally if the glyph cannot fit within an atlas entry */
+    size_t length = (size_t) height * stride;
+    if (length > GUAC_TERMINAL_GLYPH_ATLAS_SLOT_BYTES)
+        return 1;
+
+    unsigned int index = guac_terminal_glyph_atlas_index(font_hash,
+            codepoint, foreground, background);
+
+    guac_terminal_glyph_atlas_entry* entry = &atlas->entries[index];
+
+    /* Ignore entries that are empty or in the process of being written */
+    unsigned int sequence = __atomic_load_n(&entry->sequence,
+            __ATOMIC_ACQUIRE);
+    if (sequence == 0 || sequence % 2 != 0)
+        return 1;
+
+    /* Ignore entries rasterized for any other glyph or font state */
+    if (entry->font_hash != font_hash
+            || entry->codepoint != codepoint
+            || entry->width != width
+            || entry->height != height
+            || entry->stride != stride
+            || guac_terminal_colorcmp(&entry->foreground, foreground) != 0
+            || guac_terminal_colorcmp(&entry->background, background) != 0)
+        return 1;
+
+    /* Copy rasterized glyph out of the atlas */
+    memcpy(data, atlas->data[index], length);
+
+    /* The copied data (and the entry metadata compared above) is valid only
+     * if the entry was not concurrently rewritten */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&entry->sequence, __ATOMIC_RELAXED) != sequence)
+        return 1;
+
+    return 0;
+
+}
+
+void guac_terminal_glyph_atlas_put(uint64_t font_hash, int codepoint,
+        const guac_terminal_color* foreground,
+        const guac_terminal_color* background,
+        const unsigned char* data, int width, int height, int stride) {
+
+    /* Do nothing if the atlas is unavailable */
+    guac_terminal_glyph_atlas* atlas = guac_terminal_atlas;
+    if (atlas == NULL)
+        return;
+
+    /* Do nothing if the glyph cannot fit within an atlas entry */
+    size_t length = (size_t) height * stride;
+    if (length > GUAC_TERMINAL_GLYPH_ATLAS_SLOT_BYTES)
+        return;
+
+    /* Publish only if no other process is concurrently publishing (rendering
+     * must never block on the atlas; an unpublished glyph is simply
+     * rasterized again by the next terminal that needs it) */
+    int result = pthread_mutex_trylock(&atlas->writer_lock);
+    if (result == EOWNERDEAD)
+        pthread_mutex_consistent(&atlas->writer_lock);
+    else if (result != 0)
+        return;
+
+    unsigned int index = guac_terminal_glyph_atlas_index(font_hash,
+            codepoint, foreground, background);
+
+    guac_terminal_glyph_atlas_entry* entry = &atlas->entries[index];
+
+    /* Advance sequence to an odd value, warning readers that the entry is
+     * being rewritten */
+    unsigned int sequence = entry->sequence | 1;
+    __atomic_store_n(&entry->sequence, sequence, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    /* Rewrite entry */
+    entry->font_hash = font_hash;
+    entry->codepoint = codepoint;
+    entry->foreground = *foreground;
+    entry->background = *background;
+    entry->width = width;
+    entry->height = height;
+    entry->stride = stride;
+    memcpy(atlas->data[index], data, length);
+
+    /* Advance sequence to the following even value, marking the entry as
+     * valid */
+    __atomic_store_n(&entry->sequence, sequence + 1, __ATOMIC_RELEASE);
+
+    pthread_mutex_unlock(&atlas->writer_lock);
+
+}
@@ -22,6 +22,13 @@
 #include <ctype.h>
 #include <stdlib.h>
 
+/**
+ * The maximum number of bytes in the name of a color, including the
+ * terminating NULL byte. The longest name accepted by xterm
+ * ("lightgoldenrodyellow") is 20 characters.
+ */
+#define GUAC_TERMINAL_COLOR_NAME_LENGTH 24
+
 /**
  * A guac_terminal_color definition associated with a descriptive name.
  */
@@ -34,9 +41,11 @@ typedef struct guac_terminal_named_color {
 
     /**
      * The name of the color. Each name must be lowercase and may not contain
-     * any whitespace.
+     * any whitespace. The name is stored inline rather than as a pointer such
+     * that the color table contains no relocations and can reside entirely
+     * within read-only memory, shared across all guacd processes.
      */
-    const char* name;
+    char name[GUAC_TERMINAL_COLOR_NAME_LENGTH];
 
 } guac_terminal_named_color;
 
@@ -44,7 +53,7 @@ typedef struct guac_terminal_named_color {
  * An array of several colors and their corresponding names. This array must at
  * least contain the color names accepted by xterm.
  */
-const guac_terminal_named_color GUAC_TERMINAL_NAMED_COLORS[] = {
+static const guac_terminal_named_color GUAC_TERMINAL_NAMED_COLORS[] = {
 
     /* Color names supported by xterm */
 
@@ -784,7 +793,7 @@ static int guac_terminal_named_color_search(const void* a, const void* b) {
 int guac_terminal_find_color(const char* name, guac_terminal_color* color) {
 
     /* Search for the color having the given name */
-    guac_terminal_named_color* found = bsearch(name,
+    const guac_terminal_named_color* found = bsearch(name,
             GUAC_TERMINAL_NAMED_COLORS, GUAC_TERMINAL_NAMED_COLORS_LENGTH,
             sizeof(guac_terminal_named_color),
             guac_terminal_named_color_search);
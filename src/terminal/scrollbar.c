@@ -61,6 +61,12 @@ guac_terminal_scrollbar* guac_terminal_scrollbar_alloc(guac_client* client,
     scrollbar->render_state.container_width  = 0;
     scrollbar->render_state.container_height = 0;
 
+    /* No changes are initially pending */
+    scrollbar->container_moved   = false;
+    scrollbar->container_resized = false;
+    scrollbar->handle_moved      = false;
+    scrollbar->handle_resized    = false;
+
     /* Allocate and init layers */
     scrollbar->container = guac_client_alloc_layer(client);
     scrollbar->handle    = guac_client_alloc_layer(client);
@@ -349,9 +355,7 @@ void guac_terminal_scrollbar_dup(guac_terminal_scrollbar* scrollbar,
 
 }
 
-void guac_terminal_scrollbar_flush(guac_terminal_scrollbar* scrollbar) {
-
-    guac_socket* socket = scrollbar->client->socket;
+void guac_terminal_scrollbar_update(guac_terminal_scrollbar* scrollbar) {
 
     /* Get old state */
     int old_value = scrollbar->value;
@@ -366,28 +370,28 @@ void guac_terminal_scrollbar_flush(guac_terminal_scrollbar* scrollbar) {
     if (new_value != old_value && scrollbar->scroll_handler)
         scrollbar->scroll_handler(scrollbar, new_value);
 
-    /* Reposition container if moved */
+    /* Record container reposition if moved */
     if (old_state->container_x != new_state.container_x
      || old_state->container_y != new_state.container_y) {
-        guac_terminal_scrollbar_move_container(scrollbar, &new_state, socket);
+        scrollbar->container_moved = true;
     }
 
-    /* Resize and redraw container if size changed */
+    /* Record container resize if size changed */
     if (old_state->container_width  != new_state.container_width
      || old_state->container_height != new_state.container_height) {
-        guac_terminal_scrollbar_draw_container(scrollbar, &new_state, socket);
+        scrollbar->container_resized = true;
     }
 
-    /* Reposition handle if moved */
+    /* Record handle reposition if moved */
     if (old_state->handle_x != new_state.handle_x
      || old_state->handle_y != new_state.handle_y) {
-        guac_terminal_scrollbar_move_handle(scrollbar, &new_state, socket);
+        scrollbar->handle_moved = true;
     }
 
-    /* Resize and redraw handle if size changed */
+    /* Record handle resize if size changed */
     if (old_state->handle_width  != new_state.handle_width
      || old_state->handle_height != new_state.handle_height) {
-        guac_terminal_scrollbar_draw_handle(scrollbar, &new_state, socket);
+        scrollbar->handle_resized = true;
     }
 
     /* Store current render state */
@@ -395,6 +399,37 @@ void guac_terminal_scrollbar_flush(guac_terminal_scrollbar* scrollbar) {
 
 }
 
+void guac_terminal_scrollbar_flush(guac_terminal_scrollbar* scrollbar) {
+
+    guac_socket* socket = scrollbar->client->socket;
+    guac_terminal_scrollbar_render_state* state = &scrollbar->render_state;
+
+    /* Reposition container if moved */
+    if (scrollbar->container_moved) {
+        guac_terminal_scrollbar_move_container(scrollbar, state, socket);
+        scrollbar->container_moved = false;
+    }
+
+    /* Resize and redraw container if size changed */
+    if (scrollbar->container_resized) {
+        guac_terminal_scrollbar_draw_container(scrollbar, state, socket);
+        scrollbar->container_resized = false;
+    }
+
+    /* Reposition handle if moved */
+    if (scrollbar->handle_moved) {
+        guac_terminal_scrollbar_move_handle(scrollbar, state, socket);
+        scrollbar->handle_moved = false;
+    }
+
+    /* Resize and redraw handle if size changed */
+    if (scrollbar->handle_resized) {
+        guac_terminal_scrollbar_draw_handle(scrollbar, state, socket);
+        scrollbar->handle_resized = false;
+    }
+
+}
+
 void guac_terminal_scrollbar_set_bounds(guac_terminal_scrollbar* scrollbar,
         int min, int max) {
 
@@ -20,6 +20,7 @@
 #include "config.h"
 
 #include "terminal/char-mappings.h"
+#include "terminal/common.h"
 #include "terminal/palette.h"
 #include "terminal/terminal.h"
 #include "terminal/terminal-handlers.h"
@@ -394,9 +395,7 @@ int guac_terminal_echo(guac_terminal* term, unsigned char c) {
                     term->cursor_col,
                     codepoint);
 
-            width = wcwidth(codepoint);
-            if (width < 0)
-                width = 1;
+            width = guac_terminal_wcwidth(codepoint);
 
             /* Advance cursor */
             term->cursor_col += width;
@@ -59,8 +59,11 @@
 static void __guac_terminal_set_columns(guac_terminal* terminal, int row,
         int start_column, int end_column, guac_terminal_char* character) {
 
-    guac_terminal_display_set_columns(terminal->display, row + terminal->scroll_offset,
-            start_column, end_column, character);
+    /* Skip rendering of intermediate display states while flooded (the final
+     * visible state will be rendered from the buffer at the next flush) */
+    if (!terminal->output_flooded)
+        guac_terminal_display_set_columns(terminal->display, row + terminal->scroll_offset,
+                start_column, end_column, character);
 
     guac_terminal_buffer_set_columns(terminal->current_buffer, row,
             start_column, end_column, character);
@@ -385,6 +388,14 @@ guac_terminal* guac_terminal_create(guac_client* client,
     /* Init modified flag and conditional */
     guac_flag_init(&term->modified);
 
+    /* Init output flood tracking */
+    term->unflushed_output_bytes = 0;
+    term->output_flooded = false;
+
+    /* Init resize burst tracking */
+    term->last_resize = 0;
+    term->resize_flooded = false;
+
     /* Maximum and requested scrollback are initially the same */
     term->max_scrollback = options->max_scrollback;
     term->requested_scrollback = options->max_scrollback;
@@ -631,6 +642,13 @@ int guac_terminal_render_frame(guac_terminal* terminal) {
         guac_terminal_flush(terminal);
         guac_terminal_unlock(terminal);
 
+        /* Composite decorations (selection highlight, scrollbar) over the
+         * flushed frame data. These instructions are computed entirely from
+         * state recorded during the flush, and thus need not contend with
+         * output processing for the terminal lock. */
+        guac_terminal_display_commit_select(terminal->display);
+        guac_terminal_scrollbar_flush(terminal->scrollbar);
+
     }
 
     return 0;
@@ -730,12 +748,10 @@ char* guac_terminal_prompt(guac_terminal* terminal, const char* title,
 int guac_terminal_set(guac_terminal* term, int row, int col, int codepoint) {
 
     /* Calculate width in columns */
-    int width = wcwidth(codepoint);
-    if (width < 0)
-        width = 1;
+    int width = guac_terminal_wcwidth(codepoint);
 
     /* Do nothing if glyph is empty */
-    else if (width == 0)
+    if (width == 0)
         return 0;
 
     /* Build character with current attributes */
@@ -799,6 +815,21 @@ void guac_terminal_commit_cursor(guac_terminal* term) {
 int guac_terminal_write(guac_terminal* term, const char* buffer, int length) {
 
     guac_terminal_lock(term);
+
+    /* Track the volume of output received since the last frame flush. If
+     * output is arriving far faster than the frame cadence, stop rendering
+     * intermediate display states and instead apply output to the terminal
+     * buffer only, rendering the final visible state once per frame. */
+    term->unflushed_output_bytes += length;
+    if (!term->output_flooded && term->unflushed_output_bytes >
+            term->term_width * term->term_height * GUAC_TERMINAL_FLOOD_FACTOR) {
+        guac_client_log(term->client, GUAC_LOG_DEBUG, "Terminal output is "
+                "arriving faster than it can be rendered. Rendering of "
+                "intermediate display states will be skipped until output "
+                "slows.");
+        term->output_flooded = true;
+    }
+
     for (int written = 0; written < length; written++) {
 
         /* Read and advance to next character */
@@ -831,8 +862,10 @@ void guac_terminal_scroll_up(guac_terminal* term,
     /* If scrolling entire display, update scroll offset */
     if (start_row == 0 && end_row == term->term_height - 1) {
 
-        /* Scroll up visibly */
-        guac_terminal_display_copy_rows(term->display, start_row + amount, end_row, -amount);
+        /* Scroll up visibly (unless flooded, in which case the final visible
+         * state will be rendered from the buffer at the next flush) */
+        if (!term->output_flooded)
+            guac_terminal_display_copy_rows(term->display, start_row + amount, end_row, -amount);
 
         /* Advance by scroll amount */
         guac_terminal_buffer_scroll_up(term->current_buffer, amount);
@@ -1105,8 +1138,11 @@ void guac_terminal_scroll_display_up(guac_terminal* terminal,
 void guac_terminal_copy_columns(guac_terminal* terminal, int row,
         int start_column, int end_column, int offset) {
 
-    guac_terminal_display_copy_columns(terminal->display, row + terminal->scroll_offset,
-            start_column, end_column, offset);
+    /* Skip rendering of intermediate display states while flooded (the final
+     * visible state will be rendered from the buffer at the next flush) */
+    if (!terminal->output_flooded)
+        guac_terminal_display_copy_columns(terminal->display, row + terminal->scroll_offset,
+                start_column, end_column, offset);
 
     guac_terminal_buffer_copy_columns(terminal->current_buffer, row,
             start_column, end_column, offset);
@@ -1125,8 +1161,11 @@ void guac_terminal_copy_columns(guac_terminal* terminal, int row,
 void guac_terminal_copy_rows(guac_terminal* terminal,
         int start_row, int end_row, int offset) {
 
-    guac_terminal_display_copy_rows(terminal->display,
-            start_row + terminal->scroll_offset, end_row + terminal->scroll_offset, offset);
+    /* Skip rendering of intermediate display states while flooded (the final
+     * visible state will be rendered from the buffer at the next flush) */
+    if (!terminal->output_flooded)
+        guac_terminal_display_copy_rows(terminal->display,
+                start_row + terminal->scroll_offset, end_row + terminal->scroll_offset, offset);
 
     guac_terminal_buffer_copy_rows(terminal->current_buffer,
             start_row, end_row, offset);
@@ -1167,6 +1206,11 @@ static void __guac_terminal_redraw_rect(guac_terminal* term, int start_row, int
 
     int row, col;
 
+    /* Skip rendering of intermediate display states while flooded (the final
+     * visible state will be rendered from the buffer at the next flush) */
+    if (term->output_flooded || term->resize_flooded)
+        return;
+
     /* Redraw region */
     for (row=start_row; row<=end_row; row++) {
 
@@ -1221,8 +1265,12 @@ static void __guac_terminal_resize(guac_terminal* term, int width, int height) {
         /* If the new terminal bottom covers N rows, shift up N rows */
         if (shift_amount > 0) {
 
-            guac_terminal_display_copy_rows(term->display,
-                    shift_amount, term->display->height - 1, -shift_amount);
+            /* Shift up visibly (unless flooded, in which case the final
+             * visible state will be rendered from the buffer at the next
+             * flush) */
+            if (!term->output_flooded && !term->resize_flooded)
+                guac_terminal_display_copy_rows(term->display,
+                        shift_amount, term->display->height - 1, -shift_amount);
 
             /* Update buffer top and cursor row based on shift */
             guac_terminal_buffer_scroll_up(term->current_buffer, shift_amount);
@@ -1290,8 +1338,12 @@ static void __guac_terminal_resize(guac_terminal* term, int width, int height) {
                 /* If anything remains, move screen as necessary */
                 if (shift_amount > 0) {
 
-                    guac_terminal_display_copy_rows(term->display,
-                            0, term->display->height - shift_amount - 1, shift_amount);
+                    /* Shift down visibly (unless flooded, in which case the
+                     * final visible state will be rendered from the buffer at
+                     * the next flush) */
+                    if (!term->output_flooded && !term->resize_flooded)
+                        guac_terminal_display_copy_rows(term->display,
+                                0, term->display->height - shift_amount - 1, shift_amount);
 
                     /* Draw characters at top from scroll */
                     __guac_terminal_redraw_rect(term, 0, 0, shift_amount - 1, width-1);
@@ -1324,6 +1376,23 @@ int guac_terminal_resize(guac_terminal* terminal, int width, int height) {
     /* Acquire exclusive access to terminal */
     guac_terminal_lock(terminal);
 
+    /* Track the rate at which resize events are arriving. Dragging a window
+     * to a new size fires a continuous burst of resizes; once such a burst is
+     * detected, each resize updates terminal and buffer state only, with the
+     * final visible state rendered from the buffer once per frame rather than
+     * re-rendered in full for every intermediate size. */
+    guac_timestamp resize_time = guac_timestamp_current();
+    if (!terminal->resize_flooded && terminal->last_resize != 0
+            && resize_time - terminal->last_resize
+                < GUAC_TERMINAL_RESIZE_FLOOD_INTERVAL) {
+        guac_client_log(client, GUAC_LOG_DEBUG, "Terminal resize events are "
+                "arriving faster than they can be rendered. Rendering of "
+                "intermediate display states will be skipped until the "
+                "terminal size settles.");
+        terminal->resize_flooded = true;
+    }
+    terminal->last_resize = resize_time;
+
     /* Calculate available text display area by character size */
     int rows, columns;
     calculate_rows_and_columns(terminal, height, width, &rows, &columns);
@@ -1378,11 +1447,26 @@ void guac_terminal_flush(guac_terminal* terminal) {
     if (terminal->pipe_stream_flags & GUAC_TERMINAL_PIPE_AUTOFLUSH)
         guac_terminal_pipe_stream_flush(terminal);
 
-    /* Flush display state */
+    /* If rendering of intermediate display states was skipped due to an
+     * output flood or a burst of resizes, render the final state of the
+     * visible region from the buffer before flushing */
+    if (terminal->output_flooded || terminal->resize_flooded) {
+        terminal->output_flooded = false;
+        terminal->resize_flooded = false;
+        __guac_terminal_redraw_rect(terminal, 0, 0,
+                terminal->term_height - 1, terminal->term_width - 1);
+    }
+
+    /* Reset output volume tracking for the next frame */
+    terminal->unflushed_output_bytes = 0;
+
+    /* Flush display state. The selection highlight and scrollbar are only
+     * recalculated here; the resulting decoration instructions are sent by
+     * the render thread after the terminal lock has been released. */
     guac_terminal_select_redraw(terminal);
     guac_terminal_commit_cursor(terminal);
     guac_terminal_display_flush(terminal->display);
-    guac_terminal_scrollbar_flush(terminal->scrollbar);
+    guac_terminal_scrollbar_update(terminal->scrollbar);
 
 }
 
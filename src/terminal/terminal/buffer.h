@@ -43,8 +43,9 @@
 typedef struct guac_terminal_buffer guac_terminal_buffer;
 
 /**
- * Allocates a new buffer having the given maximum number of rows. New character cells will
- * be initialized to the given character.
+ * Allocates a new buffer having at least the given maximum number of rows.
+ * The actual row capacity is rounded up to the nearest power of two. New
+ * character cells will be initialized to the given character.
  */
 guac_terminal_buffer* guac_terminal_buffer_alloc(int rows,
         const guac_terminal_char* default_character);
@@ -48,6 +48,14 @@ int guac_terminal_encode_utf8(int codepoint, char* utf8);
  */
 bool guac_terminal_has_glyph(int codepoint);
 
+/**
+ * Returns the width of the given codepoint in columns, using a direct lookup
+ * for the common case of printable Latin-1 characters and deferring to
+ * wcwidth() for everything else. Codepoints of indeterminate width are
+ * treated as one column wide.
+ */
+int guac_terminal_wcwidth(int codepoint);
+
 /**
  * Similar to write, but automatically retries the write operation until
  * an error occurs.
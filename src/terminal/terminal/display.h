@@ -53,6 +53,55 @@
  */
 #define GUAC_TERMINAL_MM_PER_INCH 25.4
 
+/**
+ * The number of entries in the glyph cache. Codepoints are mapped onto cache
+ * entries by __guac_terminal_hash_codepoint(), which produces values between 0
+ * and 511 inclusive.
+ */
+#define GUAC_TERMINAL_GLYPH_CACHE_SIZE 512
+
+/**
+ * The maximum number of bytes of packed cell run records to accumulate
+ * before sending a cells instruction, chosen such that the resulting
+ * instruction (after base64 encoding of the run data) remains comfortably
+ * within the maximum size of a single Guacamole instruction.
+ */
+#define GUAC_TERMINAL_CELL_RUN_MAX_BYTES 4096
+
+/**
+ * A cached rendering of a single character, including the colors that
+ * rendering was produced with. Each cache entry holds the most-recently
+ * rendered glyph whose codepoint hashes to that entry, and is replaced
+ * whenever a different glyph hashing to the same entry is rendered.
+ */
+typedef struct guac_terminal_glyph {
+
+    /**
+     * The rendered glyph, or NULL if this cache entry is unused. The
+     * dimensions of this surface are determined by the character dimensions
+     * and width in columns of the glyph at the time it was rendered.
+     */
+    cairo_surface_t* surface;
+
+    /**
+     * The Unicode codepoint of the rendered character.
+     */
+    int codepoint;
+
+    /**
+     * The foreground color used to render the glyph, after taking all
+     * applicable attributes into account.
+     */
+    guac_terminal_color foreground;
+
+    /**
+     * The background color used to render the glyph, after taking all
+     * applicable attributes into account.
+     */
+    guac_terminal_color background;
+
+} guac_terminal_glyph;
+
 /**
  * All available terminal operations which affect character cells.
  */
@@ -122,6 +171,15 @@ typedef struct guac_terminal_display {
      */
     guac_terminal_operation* operations;
 
+    /**
+     * The character contents of the visible screen area as of the last
+     * flush, or NULL if the display has not yet been sized. Pending
+     * operations which would not visibly change these contents are discarded
+     * at flush time rather than redrawn. Entries having a width of zero are
+     * considered unknown and never match.
+     */
+    guac_terminal_char* last_frame;
+
     /**
      * The width of the screen, in characters.
      */
@@ -142,6 +200,22 @@ typedef struct guac_terminal_display {
      */
     PangoFontDescription* font_desc;
 
+    /**
+     * The Pango context through which all glyphs are rendered. This context
+     * persists for as long as the current font is in use, allowing fonts
+     * resolved through fontconfig for fallback (CJK, emoji, etc.) to be
+     * served from Pango's context-level cache rather than re-resolved for
+     * each rendered glyph.
+     */
+    PangoContext* font_context;
+
+    /**
+     * The Pango layout reused for all glyph rendering. As with font_context,
+     * reusing a single layout avoids repeating font resolution for each
+     * rendered glyph.
+     */
+    PangoLayout* glyph_layout;
+
     /**
      * The width of each character, in pixels.
      */
@@ -152,6 +226,21 @@ typedef struct guac_terminal_display {
      */
     int char_height;
 
+    /**
+     * Hash of the current font description and character dimensions,
+     * identifying the font state that rasterized glyphs depend upon within
+     * the shared glyph atlas. Glyphs are shared between terminals only if
+     * their font hashes are identical.
+     */
+    uint64_t glyph_atlas_font_hash;
+
+    /**
+     * Cache of recently-rendered glyphs, indexed by hashed codepoint. All
+     * entries are invalidated whenever the font or character dimensions
+     * change.
+     */
+    guac_terminal_glyph glyph_cache[GUAC_TERMINAL_GLYPH_CACHE_SIZE];
+
     /**
      * The current palette.
      */
@@ -190,6 +279,31 @@ typedef struct guac_terminal_display {
      */
     guac_common_surface* display_surface;
 
+    /**
+     * Whether pending characters are currently being sent as text via the
+     * cells instruction rather than as image data. This is re-evaluated at
+     * the start of each flush based on the support declared by all connected
+     * users. Characters sent as text are still rasterized into the local
+     * copy of display_surface, keeping that copy authoritative for users
+     * which join later.
+     */
+    bool cell_runs_enabled;
+
+    /**
+     * Buffer of packed cell run records accumulated during the current
+     * flush, in the format accepted by guac_protocol_send_cells(). The
+     * buffered records are sent (and the buffer emptied) whenever appending
+     * another record would exceed the capacity of this buffer, and at the
+     * end of each flush.
+     */
+    unsigned char cell_run_data[GUAC_TERMINAL_CELL_RUN_MAX_BYTES];
+
+    /**
+     * The number of bytes of packed cell run records currently buffered
+     * within cell_run_data.
+     */
+    int cell_run_length;
+
     /**
      * Layer which contains the actual terminal.
      */
@@ -225,6 +339,28 @@ typedef struct guac_terminal_display {
      */
     int selection_end_column;
 
+    /**
+     * The number of rectangles within pending_select_rects which have yet to
+     * be drawn to the selection layer. Pending rectangles are computed by
+     * guac_terminal_display_select() (which requires the terminal lock) and
+     * drawn by guac_terminal_display_commit_select() (which does not).
+     */
+    int pending_select_rects;
+
+    /**
+     * The rectangles making up the pending selection highlight, in pixels.
+     * Each rectangle is stored as X, Y, width, and height, in that order. At
+     * most three rectangles are ever required (first row, middle rows, and
+     * last row of the selection).
+     */
+    int pending_select_rect[3][4];
+
+    /**
+     * Whether the selection layer must be cleared before any pending
+     * selection rectangles are drawn.
+     */
+    bool pending_select_clear;
+
 } guac_terminal_display;
 
 /**
@@ -355,6 +491,20 @@ void guac_terminal_display_select(guac_terminal_display* display,
  */
 void guac_terminal_display_clear_select(guac_terminal_display* display);
 
+/**
+ * Draws any pending changes to the selection highlight, as recorded by
+ * guac_terminal_display_select() and guac_terminal_display_clear_select().
+ * Unlike those functions, which require the terminal lock to be held, this
+ * function sends only instructions computed from previously-recorded state
+ * and may safely be invoked by the render thread without holding the
+ * terminal lock.
+ *
+ * @param display
+ *     The guac_terminal_display whose pending selection highlight changes
+ *     should be drawn.
+ */
+void guac_terminal_display_commit_select(guac_terminal_display* display);
+
 /**
  * Alters the font of the terminal display. The available display area and the
  * regular grid of character cells will be resized as necessary to compensate
@@ -0,0 +1,157 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_TERMINAL_GLYPH_ATLAS_H
+#define GUAC_TERMINAL_GLYPH_ATLAS_H
+
+#include "palette.h"
+
+#include <pango/pangocairo.h>
+
+#include <stdint.h>
+
+/**
+ * Shared, read-mostly atlas of rasterized glyphs. The atlas is a single
+ * anonymous shared-memory segment mapped when this library is first loaded.
+ * As guacd preloads protocol plugins (and thus this library) prior to forking
+ * connection processes, every terminal within the resulting process family
+ * shares the same mapping, and a glyph rasterized by any one terminal can be
+ * reused by all others without repeating the Pango rasterization or storing
+ * a private copy of identical pixels in each process.
+ *
+ * Each atlas entry is protected by a per-entry sequence number: readers
+ * validate the sequence before and after copying pixels out of the atlas, and
+ * simply rasterize locally if the entry was concurrently rewritten. Writers
+ * serialize through a single process-shared lock, and never block rendering
+ * (a glyph that cannot be published immediately is simply not published).
+ *
+ * @file glyph-atlas.h
+ */
+
+/**
+ * The number of glyph entries within the shared atlas. Glyphs are mapped onto
+ * entries by hash, with colliding glyphs simply replacing one another.
+ */
+#define GUAC_TERMINAL_GLYPH_ATLAS_SIZE 1024
+
+/**
+ * The maximum size of a single rasterized glyph that may be stored within the
+ * shared atlas, in bytes. Glyphs larger than this (unusually large fonts)
+ * bypass the atlas entirely.
+ */
+#define GUAC_TERMINAL_GLYPH_ATLAS_SLOT_BYTES 16384
+
+/**
+ * Returns a hash of the given font description and character cell dimensions,
+ * identifying the font state that a rasterized glyph depends upon. Glyphs are
+ * shared between terminals only if their font hashes are identical.
+ *
+ * @param font_desc
+ *     The Pango font description currently in use.
+ *
+ * @param char_width
+ *     The width of each character cell, in pixels.
+ *
+ * @param char_height
+ *     The height of each character cell, in pixels.
+ *
+ * @return
+ *     A hash of the given font description and character cell dimensions.
+ */
+uint64_t guac_terminal_glyph_atlas_font_hash(PangoFontDescription* font_desc,
+        int char_width, int char_height);
+
+/**
+ * Attempts to copy a previously-rasterized rendering of the given glyph from
+ * the shared atlas into the given pixel buffer. The copy succeeds only if the
+ * atlas contains an entry that was rasterized with an identical font hash,
+ * codepoint, colors, and pixel dimensions, and only if that entry was not
+ * concurrently rewritten during the copy.
+ *
+ * @param font_hash
+ *     The font hash of the requesting terminal, as returned by
+ *     guac_terminal_glyph_atlas_font_hash().
+ *
+ * @param codepoint
+ *     The Unicode codepoint of the glyph.
+ *
+ * @param foreground
+ *     The foreground color of the glyph.
+ *
+ * @param background
+ *     The background color of the glyph.
+ *
+ * @param data
+ *     The pixel buffer to copy the rasterized glyph into.
+ *
+ * @param width
+ *     The width of the pixel buffer, in pixels.
+ *
+ * @param height
+ *     The height of the pixel buffer, in pixels.
+ *
+ * @param stride
+ *     The number of bytes in each row of the pixel buffer.
+ *
+ * @return
+ *     Zero if the glyph was found and copied in full, non-zero if the glyph
+ *     must instead be rasterized by the caller.
+ */
+int guac_terminal_glyph_atlas_get(uint64_t font_hash, int codepoint,
+        const guac_terminal_color* foreground,
+        const guac_terminal_color* background,
+        unsigned char* data, int width, int height, int stride);
+
+/**
+ * Publishes a rasterized rendering of the given glyph to the shared atlas,
+ * making it available to all other terminals within the same process family.
+ * If the atlas is unavailable, the glyph is too large, or another process is
+ * concurrently publishing a glyph, this function has no effect.
+ *
+ * @param font_hash
+ *     The font hash of the publishing terminal, as returned by
+ *     guac_terminal_glyph_atlas_font_hash().
+ *
+ * @param codepoint
+ *     The Unicode codepoint of the glyph.
+ *
+ * @param foreground
+ *     The foreground color of the glyph.
+ *
+ * @param background
+ *     The background color of the glyph.
+ *
+ * @param data
+ *     The rasterized pixels of the glyph.
+ *
+ * @param width
+ *     The width of the rasterized glyph, in pixels.
+ *
+ * @param height
+ *     The height of the rasterized glyph, in pixels.
+ *
+ * @param stride
+ *     The number of bytes in each row of the rasterized glyph.
+ */
+void guac_terminal_glyph_atlas_put(uint64_t font_hash, int codepoint,
+        const guac_terminal_color* foreground,
+        const guac_terminal_color* background,
+        const unsigned char* data, int width, int height, int stride);
+
+#endif
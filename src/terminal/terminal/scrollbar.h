@@ -29,6 +29,8 @@
 #include <guacamole/client.h>
 #include <guacamole/layer.h>
 
+#include <stdbool.h>
+
 /**
  * The width of the scrollbar, in pixels.
  */
@@ -169,6 +171,30 @@ struct guac_terminal_scrollbar {
      */
     guac_terminal_scrollbar_render_state render_state;
 
+    /**
+     * Whether the scrollbar's container has moved since the remote display
+     * was last updated.
+     */
+    bool container_moved;
+
+    /**
+     * Whether the scrollbar's container has been resized since the remote
+     * display was last updated.
+     */
+    bool container_resized;
+
+    /**
+     * Whether the scrollbar's handle has moved since the remote display was
+     * last updated.
+     */
+    bool handle_moved;
+
+    /**
+     * Whether the scrollbar's handle has been resized since the remote
+     * display was last updated.
+     */
+    bool handle_resized;
+
     /**
      * Whether the scrollbar handle is currently being dragged.
      */
@@ -241,9 +267,25 @@ guac_terminal_scrollbar* guac_terminal_scrollbar_alloc(guac_client* client,
  */
 void guac_terminal_scrollbar_free(guac_terminal_scrollbar* scrollbar);
 
+/**
+ * Recalculates the render state of the given scrollbar, invoking the scroll
+ * handler if the scrollbar value has changed and recording which visible
+ * parts of the scrollbar must be redrawn. No instructions are sent to the
+ * remote display by this function; the recorded changes are instead drawn by
+ * guac_terminal_scrollbar_flush(). As this function reads and updates state
+ * shared with the rest of the terminal, the terminal lock must be held when
+ * it is invoked.
+ *
+ * @param scrollbar
+ *     The scrollbar whose render state is to be recalculated.
+ */
+void guac_terminal_scrollbar_update(guac_terminal_scrollbar* scrollbar);
+
 /**
  * Flushes the render state of the given scrollbar, updating the remote display
- * accordingly.
+ * accordingly. Only changes recorded by a previous call to
+ * guac_terminal_scrollbar_update() are drawn, so this function may safely be
+ * invoked by the render thread without holding the terminal lock.
  *
  * This may cause instructions to be written to the client's socket, but the
  * client's socket will not be automatically flushed.
@@ -52,6 +52,27 @@
  */
 typedef int guac_terminal_char_handler(guac_terminal* term, unsigned char c);
 
+/**
+ * The number of full screens of terminal output that may be received within a
+ * single frame before the terminal considers itself flooded. Once flooded,
+ * received output is applied to the terminal buffer only, with rendering of
+ * intermediate display states skipped in favor of rendering the final visible
+ * state once per frame. With output arriving this much faster than the frame
+ * cadence, the vast majority of intermediate states could never be displayed
+ * anyway.
+ */
+#define GUAC_TERMINAL_FLOOD_FACTOR 4
+
+/**
+ * The maximum amount of time that may elapse between consecutive resize
+ * events before the terminal considers itself to be receiving a burst of
+ * resizes (as fired continuously while a browser window is dragged to a new
+ * size), in milliseconds. During such a burst, each resize updates terminal
+ * and buffer state only, with rendering of intermediate display states
+ * skipped in favor of rendering the final visible state once per frame.
+ */
+#define GUAC_TERMINAL_RESIZE_FLOOD_INTERVAL 250
+
 struct guac_terminal {
 
     /**
@@ -100,6 +121,38 @@ struct guac_terminal {
       */
     guac_flag modified;
 
+    /**
+     * The number of bytes of terminal output that have been processed since
+     * the display was last flushed. This value is used to detect output
+     * floods (output arriving far faster than the frame cadence, as with a
+     * runaway log or "yes").
+     */
+    int unflushed_output_bytes;
+
+    /**
+     * Whether output is currently flooding the terminal. While this flag is
+     * set, received output is applied to the terminal buffer only, and
+     * rendering of intermediate display states is skipped. The final visible
+     * state is instead rendered from the buffer when the display is next
+     * flushed.
+     */
+    bool output_flooded;
+
+    /**
+     * The time that the terminal was last resized, or 0 if the terminal has
+     * never been resized. Used to detect bursts of resize events.
+     */
+    guac_timestamp last_resize;
+
+    /**
+     * Whether the terminal is currently receiving a burst of resize events.
+     * While this flag is set, resizes update terminal and buffer state only,
+     * and rendering of intermediate display states is skipped. The final
+     * visible state is instead rendered from the buffer when the display is
+     * next flushed.
+     */
+    bool resize_flooded;
+
     /**
      * Pipe which will be the source of user input. When a terminal code
      * generates synthesized user input, that data will be written to
@@ -29,6 +29,9 @@
 
 #include <guacamole/timestamp.h>
 
+#include <pthread.h>
+#include <stdbool.h>
+
 /**
  * A NULL-terminated string of raw bytes which should be written at the
  * beginning of any typescript.
@@ -74,6 +77,49 @@
  */
 #define GUAC_TERMINAL_TYPESCRIPT_TIMING_SUFFIX "timing"
 
+/**
+ * The number of bytes of raw terminal output to buffer before queuing that
+ * output to be written to the typescript data file.
+ */
+#define GUAC_TERMINAL_TYPESCRIPT_BUFFER_SIZE 4096
+
+/**
+ * The maximum number of flushed-but-unwritten buffers of terminal output
+ * which may be queued awaiting the typescript writer thread. If the
+ * underlying storage is slow enough that this many buffers accumulate,
+ * further flushes will wait for the writer thread to catch up.
+ */
+#define GUAC_TERMINAL_TYPESCRIPT_RING_SIZE 16
+
+/**
+ * A single flushed buffer of terminal output, queued to be written to the
+ * typescript files by the typescript writer thread.
+ */
+typedef struct guac_terminal_typescript_record {
+
+    /**
+     * The line of timing information to be written to the timing file,
+     * describing the delay preceding the associated terminal output.
+     */
+    char timing[32];
+
+    /**
+     * The number of bytes stored within timing.
+     */
+    int timing_length;
+
+    /**
+     * The raw terminal output to be written to the data file.
+     */
+    char data[GUAC_TERMINAL_TYPESCRIPT_BUFFER_SIZE];
+
+    /**
+     * The number of bytes stored within data.
+     */
+    int data_length;
+
+} guac_terminal_typescript_record;
+
 /**
  * An active typescript, consisting of a data file (raw terminal output) and
  * timing file (related timestamps and byte counts).
@@ -84,13 +130,54 @@ typedef struct guac_terminal_typescript {
      * Buffer of raw terminal output which has not yet been written to the
      * data file.
      */
-    char buffer[4096];
+    char buffer[GUAC_TERMINAL_TYPESCRIPT_BUFFER_SIZE];
 
     /**
      * The number of bytes currently stored in the buffer.
      */
     int length;
 
+    /**
+     * Ring buffer of flushed terminal output awaiting the writer thread.
+     * All file I/O is performed by the writer thread such that slow storage
+     * does not stall the terminal I/O path.
+     */
+    guac_terminal_typescript_record records[GUAC_TERMINAL_TYPESCRIPT_RING_SIZE];
+
+    /**
+     * The index within records of the oldest queued record (the next record
+     * to be written by the writer thread).
+     */
+    unsigned int record_head;
+
+    /**
+     * The number of records currently queued awaiting the writer thread.
+     */
+    unsigned int record_count;
+
+    /**
+     * Lock which protects the ring of queued records and the shutting_down
+     * flag.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Condition which is signalled whenever the ring of queued records or
+     * the shutting_down flag changes.
+     */
+    pthread_cond_t modified;
+
+    /**
+     * The thread which performs all writes to the data and timing files.
+     */
+    pthread_t writer_thread;
+
+    /**
+     * Whether the typescript is being freed and the writer thread should
+     * terminate once all queued records have been written.
+     */
+    bool shutting_down;
+
     /**
      * The full path to the file which will contain the raw terminal output for
      * this typescript.
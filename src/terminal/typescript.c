@@ -24,8 +24,10 @@
 #include <guacamole/timestamp.h>
 
 #include <errno.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <sys/types.h>
@@ -112,6 +114,72 @@ static int guac_terminal_typescript_open_data_file(const char* path,
 
 }
 
+/**
+ * Thread which writes all queued typescript records to the data and timing
+ * files, such that file I/O (and any storage slowness) is kept off the
+ * terminal I/O path. Written data is synced to the underlying storage
+ * whenever the queue becomes empty.
+ *
+ * @param data
+ *     A pointer to the guac_terminal_typescript whose queued records should
+ *     be written.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guac_terminal_typescript_write_thread(void* data) {
+
+    guac_terminal_typescript* typescript = (guac_terminal_typescript*) data;
+
+    pthread_mutex_lock(&(typescript->lock));
+    for (;;) {
+
+        /* Wait for records to be queued (or for shutdown) */
+        while (typescript->record_count == 0 && !typescript->shutting_down)
+            pthread_cond_wait(&(typescript->modified), &(typescript->lock));
+
+        /* Terminate only once all queued records have been written */
+        if (typescript->record_count == 0)
+            break;
+
+        guac_terminal_typescript_record* record =
+            &(typescript->records[typescript->record_head]);
+
+        /* Perform all file I/O outside the lock (the record cannot be
+         * overwritten until it is dequeued) */
+        pthread_mutex_unlock(&(typescript->lock));
+
+        /* Write timestamp to timing file */
+        guac_common_write(typescript->timing_fd,
+                record->timing, record->timing_length);
+
+        /* Write terminal output to data file */
+        guac_common_write(typescript->data_fd,
+                record->data, record->data_length);
+
+        pthread_mutex_lock(&(typescript->lock));
+
+        /* Dequeue written record, notifying any flush waiting for space */
+        typescript->record_head = (typescript->record_head + 1)
+            % GUAC_TERMINAL_TYPESCRIPT_RING_SIZE;
+        typescript->record_count--;
+        pthread_cond_broadcast(&(typescript->modified));
+
+        /* Sync written data to storage while otherwise idle */
+        if (typescript->record_count == 0 && !typescript->shutting_down) {
+            pthread_mutex_unlock(&(typescript->lock));
+            fdatasync(typescript->data_fd);
+            fdatasync(typescript->timing_fd);
+            pthread_mutex_lock(&(typescript->lock));
+        }
+
+    }
+    pthread_mutex_unlock(&(typescript->lock));
+
+    return NULL;
+
+}
+
 guac_terminal_typescript* guac_terminal_typescript_alloc(const char* path,
         const char* name, int create_path, int allow_write_existing) {
 
@@ -164,6 +232,24 @@ guac_terminal_typescript* guac_terminal_typescript_alloc(const char* path,
     guac_common_write(typescript->data_fd, GUAC_TERMINAL_TYPESCRIPT_HEADER,
             sizeof(GUAC_TERMINAL_TYPESCRIPT_HEADER) - 1);
 
+    /* Queue of records awaiting the writer thread starts out empty */
+    typescript->record_head = 0;
+    typescript->record_count = 0;
+    typescript->shutting_down = false;
+    pthread_mutex_init(&(typescript->lock), NULL);
+    pthread_cond_init(&(typescript->modified), NULL);
+
+    /* All further file I/O is performed by a dedicated writer thread */
+    if (pthread_create(&(typescript->writer_thread), NULL,
+                guac_terminal_typescript_write_thread, typescript)) {
+        pthread_mutex_destroy(&(typescript->lock));
+        pthread_cond_destroy(&(typescript->modified));
+        close(typescript->data_fd);
+        close(typescript->timing_fd);
+        guac_mem_free(typescript);
+        return NULL;
+    }
+
     return typescript;
 
 }
@@ -195,22 +281,35 @@ void guac_terminal_typescript_flush(guac_terminal_typescript* typescript) {
     if (elapsed_time > GUAC_TERMINAL_TYPESCRIPT_MAX_DELAY)
         elapsed_time = GUAC_TERMINAL_TYPESCRIPT_MAX_DELAY;
 
+    pthread_mutex_lock(&(typescript->lock));
+
+    /* Wait for space if the writer thread has fallen behind */
+    while (typescript->record_count == GUAC_TERMINAL_TYPESCRIPT_RING_SIZE)
+        pthread_cond_wait(&(typescript->modified), &(typescript->lock));
+
+    guac_terminal_typescript_record* record = &(typescript->records[
+            (typescript->record_head + typescript->record_count)
+                % GUAC_TERMINAL_TYPESCRIPT_RING_SIZE]);
+
     /* Produce single line of timestamp output */
-    char timestamp_buffer[32];
-    int timestamp_length = snprintf(timestamp_buffer, sizeof(timestamp_buffer),
+    int timestamp_length = snprintf(record->timing, sizeof(record->timing),
             "%0.6f %i\n", elapsed_time / 1000.0, typescript->length);
 
     /* Calculate actual length of timestamp line */
-    if (timestamp_length > sizeof(timestamp_buffer))
-        timestamp_length = sizeof(timestamp_buffer);
+    if (timestamp_length > sizeof(record->timing))
+        timestamp_length = sizeof(record->timing);
 
-    /* Write timestamp to timing file */
-    guac_common_write(typescript->timing_fd,
-            timestamp_buffer, timestamp_length);
+    record->timing_length = timestamp_length;
 
-    /* Empty buffer into data file */
-    guac_common_write(typescript->data_fd,
-            typescript->buffer, typescript->length);
+    /* Empty buffer into queued record */
+    memcpy(record->data, typescript->buffer, typescript->length);
+    record->data_length = typescript->length;
+
+    /* Hand record off to the writer thread */
+    typescript->record_count++;
+    pthread_cond_broadcast(&(typescript->modified));
+
+    pthread_mutex_unlock(&(typescript->lock));
 
     /* Buffer is now flushed */
     typescript->length = 0;
@@ -227,6 +326,16 @@ void guac_terminal_typescript_free(guac_terminal_typescript* typescript) {
     /* Flush any pending data */
     guac_terminal_typescript_flush(typescript);
 
+    /* Wait for the writer thread to finish writing all queued records */
+    pthread_mutex_lock(&(typescript->lock));
+    typescript->shutting_down = true;
+    pthread_cond_broadcast(&(typescript->modified));
+    pthread_mutex_unlock(&(typescript->lock));
+    pthread_join(typescript->writer_thread, NULL);
+
+    pthread_mutex_destroy(&(typescript->lock));
+    pthread_cond_destroy(&(typescript->modified));
+
     /* Write footer */
     guac_common_write(typescript->data_fd, GUAC_TERMINAL_TYPESCRIPT_FOOTER,
             sizeof(GUAC_TERMINAL_TYPESCRIPT_FOOTER) - 1);